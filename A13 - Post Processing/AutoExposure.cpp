@@ -0,0 +1,106 @@
+#include "AutoExposure.h"
+
+#include <math.h>
+
+unsigned int LuminanceBin(float luminance, const ExposureSettings& settings)
+{
+	if (!(luminance > 0.0f))
+		return 0;
+
+	float range = settings.MaxLogLuminance - settings.MinLogLuminance;
+	float bin = (log2f(luminance) - settings.MinLogLuminance) / range * LuminanceHistogramBins;
+	if (bin < 0.0f)
+		return 0;
+	if (bin >= (float)(LuminanceHistogramBins - 1))
+		return LuminanceHistogramBins - 1;
+	return (unsigned int)bin;
+}
+
+float LuminanceBinCenter(unsigned int bin, const ExposureSettings& settings)
+{
+	float range = settings.MaxLogLuminance - settings.MinLogLuminance;
+	return settings.MinLogLuminance + (bin + 0.5f) * range / LuminanceHistogramBins;
+}
+
+void BuildLuminanceHistogram(
+	const void* luminance,
+	unsigned int width,
+	unsigned int height,
+	unsigned int rowPitch,
+	const ExposureSettings& settings,
+	LuminanceHistogram& histogram)
+{
+	histogram = LuminanceHistogram();
+	for (unsigned int y = 0; y < height; y++)
+	{
+		const float* row = (const float*)((const unsigned char*)luminance + (unsigned long long)y * rowPitch);
+		for (unsigned int x = 0; x < width; x++)
+			histogram.Bins[LuminanceBin(row[x], settings)]++;
+	}
+	histogram.Count = width * height;
+}
+
+float HistogramAverageLogLuminance(const LuminanceHistogram& histogram, const ExposureSettings& settings)
+{
+	// Each bin counts for however much of it is inside the window
+	float low = settings.LowPercent * histogram.Count;
+	float high = settings.HighPercent * histogram.Count;
+	float below = 0.0f;
+	float total = 0.0f;
+	float weight = 0.0f;
+	unsigned int lowBin = 0;
+	for (unsigned int bin = 0; bin < LuminanceHistogramBins; bin++)
+	{
+		float count = (float)histogram.Bins[bin];
+		float start = below > low ? below : low;
+		float end = below + count < high ? below + count : high;
+		if (end > start)
+		{
+			total += (end - start) * LuminanceBinCenter(bin, settings);
+			weight += end - start;
+		}
+		if (below <= low && count > 0.0f)
+			lowBin = bin;
+		below += count;
+	}
+
+	// An empty window is just the bin the low percent is in
+	return weight > 0.0f ? total / weight : LuminanceBinCenter(lowBin, settings);
+}
+
+float ExposureForLogLuminance(float logLuminance, const ExposureSettings& settings)
+{
+	float exposure = settings.KeyValue * exp2f(settings.Compensation - logLuminance);
+	return
+		exposure < settings.MinExposure ? settings.MinExposure :
+		exposure > settings.MaxExposure ? settings.MaxExposure :
+		exposure;
+}
+
+float ExposureController::Update(const LuminanceHistogram& histogram, const ExposureSettings& settings, float deltaTime)
+{
+	if (histogram.Count > 0)
+	{
+		targetLogExposure = log2f(ExposureForLogLuminance(HistogramAverageLogLuminance(histogram, settings), settings));
+		if (!started)
+		{
+			logExposure = targetLogExposure;
+			started = true;
+		}
+	}
+
+	// Exponentially, in stops, so it never overshoots
+	float speed = targetLogExposure < logExposure ? settings.BrighteningSpeed : settings.DarkeningSpeed;
+	logExposure += (targetLogExposure - logExposure) * (1.0f - expf(-deltaTime * speed));
+	return GetExposure();
+}
+
+float ExposureController::GetExposure() const
+{
+	return exp2f(logExposure);
+}
+
+float ExposureController::GetTargetExposure() const
+{
+	return exp2f(targetLogExposure);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// --------------------------------------------------------
+// Auto-exposure from a histogram of the scene's luminance.
+//
+// The scene is drawn in linear HDR.  A small copy of its
+// luminance is read back each frame (a few frames late, so
+// nothing waits on the GPU) and binned by log2 of its value.
+// The middle of the histogram, leaving out the darkest and
+// brightest pixels, is averaged, and the exposure that takes
+// that average to middle grey is where the controller heads.
+// It eases there rather than jumping, quicker when the scene
+// gets brighter than when it gets darker, like an eye.
+//
+// The exposed color is tonemapped as part of the color grade
+// (see ColorGrading.h).
+// --------------------------------------------------------
+
+const unsigned int LuminanceHistogramBins = 64;
+
+struct ExposureSettings
+{
+	float MinLogLuminance = -10.0f;	// log2 at the first bin's bottom; anything darker lands in it
+	float MaxLogLuminance = 6.0f;	// And the last bin's top
+	float LowPercent = 0.5f;		// The darkest fraction of pixels, left out of the average
+	float HighPercent = 0.95f;		// Pixels brighter than this fraction, also left out
+	float KeyValue = 0.18f;			// What the average luminance is exposed to
+	float Compensation = 0.0f;		// In stops, on top of the key value
+	float MinExposure = 1.0f / 64.0f;
+	float MaxExposure = 64.0f;
+	float BrighteningSpeed = 3.0f;	// How quickly it adapts to a brighter scene, per second
+	float DarkeningSpeed = 1.0f;	// And to a darker one
+};
+
+struct LuminanceHistogram
+{
+	unsigned int Bins[LuminanceHistogramBins] = {};
+	unsigned int Count = 0;
+};
+
+// Which bin a luminance lands in, and the log2 luminance at
+// the middle of a bin
+unsigned int LuminanceBin(float luminance, const ExposureSettings& settings);
+float LuminanceBinCenter(unsigned int bin, const ExposureSettings& settings);
+
+// --------------------------------------------------------
+// Bins an image of luminance, one float a pixel.  rowPitch
+// is in bytes, as a mapped texture gives it.
+// --------------------------------------------------------
+void BuildLuminanceHistogram(
+	const void* luminance,
+	unsigned int width,
+	unsigned int height,
+	unsigned int rowPitch,
+	const ExposureSettings& settings,
+	LuminanceHistogram& histogram);
+
+// The average log2 luminance of the pixels between the low and
+// high percents, by their bins' centers
+float HistogramAverageLogLuminance(const LuminanceHistogram& histogram, const ExposureSettings& settings);
+
+// The exposure that takes a log2 luminance to the key value,
+// within the settings' limits
+float ExposureForLogLuminance(float logLuminance, const ExposureSettings& settings);
+
+// --------------------------------------------------------
+// Eases the exposure towards what each histogram asks for.
+// The first histogram is taken as it is, with no easing in.
+// --------------------------------------------------------
+class ExposureController
+{
+public:
+	// deltaTime in seconds.  An empty histogram changes nothing.
+	// Returns the exposure to draw with.
+	float Update(const LuminanceHistogram& histogram, const ExposureSettings& settings, float deltaTime);
+	void Reset() { started = false; }
+
+	float GetExposure() const;
+	float GetTargetExposure() const;
+
+private:
+	bool started = false;
+	float logExposure = 0.0f;		// log2, where it's eased to
+	float targetLogExposure = 0.0f;	// log2, where it's heading
+};
@@ -0,0 +1,179 @@
+#include "Bloom.h"
+
+namespace
+{
+	float LevelScale(unsigned int level)
+	{
+		return 1.0f / (float)(2u << level);
+	}
+}
+
+std::vector<PostEffectPass> BloomPasses(unsigned int levels)
+{
+	std::vector<PostEffectPass> passes(2 * levels);
+	for (unsigned int n = 0; n < levels; n++)
+	{
+		passes[n].Scale = LevelScale(n);
+		passes[n].Inputs[0] = n == 0 ? PostPassInput0 : (int)n - 1;
+	}
+
+	// Up from the smallest, each onto its own level's downsample
+	for (unsigned int n = levels; n < 2 * levels - 1; n++)
+	{
+		unsigned int level = 2 * levels - 2 - n;
+		passes[n].Scale = LevelScale(level);
+		passes[n].Inputs[0] = (int)n - 1;
+		passes[n].Inputs[1] = (int)level;
+		passes[n].InputCount = 2;
+		passes[n].Additive = true;
+	}
+
+	PostEffectPass& composite = passes.back();
+	composite.Inputs[0] = (int)(2 * levels - 2);
+	composite.Inputs[1] = PostPassInput0;
+	composite.InputCount = 2;
+	composite.Additive = true;
+	return passes;
+}
+
+BloomStep BloomPassStep(unsigned int pass, unsigned int levels, unsigned int* level)
+{
+	BloomStep step =
+		pass == 0 ? BloomStep::Prefilter :
+		pass < levels ? BloomStep::Downsample :
+		pass < 2 * levels - 1 ? BloomStep::Upsample :
+		BloomStep::Composite;
+	if (level)
+		*level = step == BloomStep::Upsample ? 2 * levels - 2 - pass : step == BloomStep::Composite ? 0 : pass;
+	return step;
+}
+
+void BloomDownsampleKernel(float offsets[BloomDownsampleTaps][2], float weights[BloomDownsampleTaps])
+{
+	// The pixel's center is a corner between four texels, so a
+	// sample an odd number of texels away is a 2x2 box.  The box
+	// around the center counts for half, and the four around
+	// the ring, overlapping it, an eighth each.
+	const float taps[BloomDownsampleTaps][3] = {
+		{ -1, -1, 0.125f }, { 1, -1, 0.125f }, { -1, 1, 0.125f }, { 1, 1, 0.125f },
+		{ 0, 0, 0.125f },
+		{ 0, -2, 0.0625f }, { -2, 0, 0.0625f }, { 2, 0, 0.0625f }, { 0, 2, 0.0625f },
+		{ -2, -2, 0.03125f }, { 2, -2, 0.03125f }, { -2, 2, 0.03125f }, { 2, 2, 0.03125f } };
+	for (unsigned int t = 0; t < BloomDownsampleTaps; t++)
+	{
+		offsets[t][0] = taps[t][0];
+		offsets[t][1] = taps[t][1];
+		weights[t] = taps[t][2];
+	}
+}
+
+void BloomUpsampleKernel(float offsets[BloomUpsampleTaps][2], float weights[BloomUpsampleTaps])
+{
+	// 1 2 1 across and down
+	for (unsigned int t = 0; t < BloomUpsampleTaps; t++)
+	{
+		int x = (int)(t % 3) - 1;
+		int y = (int)(t / 3) - 1;
+		offsets[t][0] = (float)x;
+		offsets[t][1] = (float)y;
+		weights[t] = (x == 0 ? 2.0f : 1.0f) * (y == 0 ? 2.0f : 1.0f) / 16.0f;
+	}
+}
+
+float BloomNormalization(float spread, unsigned int levels)
+{
+	float total = 0;
+	float weight = 1;
+	for (unsigned int level = 0; level < levels; level++)
+	{
+		total += weight;
+		weight *= spread;
+	}
+	return total;
+}
+
+void BloomPrefilter(const float color[4], float threshold, float out[4])
+{
+	float brightness = color[0] > color[1] ? color[0] : color[1];
+	brightness = brightness > color[2] ? brightness : color[2];
+	float excess = brightness - threshold;
+	float scale = (excess > 0 ? excess : 0) / (brightness > 1e-4f ? brightness : 1e-4f);
+	for (int i = 0; i < 4; i++)
+		out[i] = color[i] * scale;
+}
+
+void BloomDownsampleImage(const BlurImage& source, unsigned int width, unsigned int height, bool prefilter, float threshold, BlurImage& result)
+{
+	float offsets[BloomDownsampleTaps][2];
+	float weights[BloomDownsampleTaps];
+	BloomDownsampleKernel(offsets, weights);
+
+	result.Width = width;
+	result.Height = height;
+	result.Pixels.assign(width * height * 4, 0.0f);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			float u = (x + 0.5f) / width;
+			float v = (y + 0.5f) / height;
+			float* out = &result.Pixels[(y * width + x) * 4];
+			for (unsigned int t = 0; t < BloomDownsampleTaps; t++)
+			{
+				float sample[4];
+				SampleBlurImage(source, u + offsets[t][0] / source.Width, v + offsets[t][1] / source.Height, sample);
+				if (prefilter)
+					BloomPrefilter(sample, threshold, sample);
+				for (int i = 0; i < 4; i++)
+					out[i] += sample[i] * weights[t];
+			}
+		}
+	}
+}
+
+void BloomUpsampleImage(const BlurImage& lower, const BlurImage& base, float weight, BlurImage& result)
+{
+	float offsets[BloomUpsampleTaps][2];
+	float weights[BloomUpsampleTaps];
+	BloomUpsampleKernel(offsets, weights);
+
+	result = base;
+	for (unsigned int y = 0; y < base.Height; y++)
+	{
+		for (unsigned int x = 0; x < base.Width; x++)
+		{
+			float u = (x + 0.5f) / base.Width;
+			float v = (y + 0.5f) / base.Height;
+			float* out = &result.Pixels[(y * base.Width + x) * 4];
+			for (unsigned int t = 0; t < BloomUpsampleTaps; t++)
+			{
+				float sample[4];
+				SampleBlurImage(lower, u + offsets[t][0] / lower.Width, v + offsets[t][1] / lower.Height, sample);
+				for (int i = 0; i < 4; i++)
+					out[i] += sample[i] * weights[t] * weight;
+			}
+		}
+	}
+}
+
+void BloomImage(const BlurImage& source, const BloomSettings& settings, BlurImage& result, unsigned int levels)
+{
+	std::vector<BlurImage> pyramid(levels);
+	for (unsigned int level = 0; level < levels; level++)
+	{
+		PostTarget size = PostTargetSize(source.Width, source.Height, LevelScale(level));
+		BloomDownsampleImage(level == 0 ? source : pyramid[level - 1], size.Width, size.Height, level == 0, settings.Threshold, pyramid[level]);
+	}
+
+	BlurImage upsampled = pyramid[levels - 1];
+	for (unsigned int level = levels - 1; level-- > 0;)
+	{
+		BlurImage next;
+		BloomUpsampleImage(upsampled, pyramid[level], settings.Spread, next);
+		upsampled.Pixels.swap(next.Pixels);
+		upsampled.Width = next.Width;
+		upsampled.Height = next.Height;
+	}
+
+	BloomUpsampleImage(upsampled, source, settings.Intensity / BloomNormalization(settings.Spread, levels), result);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+#include "GaussianBlur.h"
+#include "PostProcessChain.h"
+
+// --------------------------------------------------------
+// Bloom through a mip pyramid rather than one wide blur.
+//
+// The bright parts of the image are downsampled to half size,
+// then again and again, each with a 13 tap filter (4 boxes of
+// 2x2 texels around the center and a wider ring, as bilinear
+// samples).  Coming back up, each level gets the one below it
+// added on through a 3x3 tent, blended straight onto it, and
+// the top is added onto the image.  Every level covers twice
+// the texels of the one above for a quarter of the pixels, so
+// the glow reaches about 2^levels pixels for a third of the
+// screen's worth of pixels in all, however wide it's set.
+//
+// Spread weighs each level over the one above it: towards 1
+// the wide levels count as much as the tight ones.  The CPU
+// copy below follows BloomDownsamplePixelShader.hlsl and
+// BloomUpsamplePixelShader.hlsl, for the tests.
+// --------------------------------------------------------
+
+// Levels of the pyramid, the first at half the screen's size
+const unsigned int BloomLevels = 6;
+
+const unsigned int BloomDownsampleTaps = 13;
+const unsigned int BloomUpsampleTaps = 9;
+
+struct BloomSettings
+{
+	float Threshold = 0.8f;	// Brightest channel where the glow starts
+	float Spread = 0.7f;
+	float Intensity = 0.5f;
+};
+
+// What a pass of the bloom effect does
+enum class BloomStep
+{
+	Prefilter,	// Threshold and downsample the image to level 0
+	Downsample,	// From the level above
+	Upsample,	// Tent of the level below, added onto this one
+	Composite,	// Tent of level 0, added onto the image
+};
+
+// --------------------------------------------------------
+// The effect's passes, for the chain: each level down, each
+// back up, then onto the image (its first input).  The up and
+// composite passes are additive, so they're blended onto what
+// they add to whenever the chain allows it.
+// --------------------------------------------------------
+std::vector<PostEffectPass> BloomPasses(unsigned int levels = BloomLevels);
+
+// What pass n of BloomPasses() does, and at which level
+BloomStep BloomPassStep(unsigned int pass, unsigned int levels = BloomLevels, unsigned int* level = 0);
+
+// The filters, as offsets in the source's texels from the
+// pixel's center and weights that add up to one
+void BloomDownsampleKernel(float offsets[BloomDownsampleTaps][2], float weights[BloomDownsampleTaps]);
+void BloomUpsampleKernel(float offsets[BloomUpsampleTaps][2], float weights[BloomUpsampleTaps]);
+
+// What the upsampled top level is divided by: every level's
+// weight, 1 + spread + spread^2 and so on, so a flat image
+// blooms by exactly its intensity
+float BloomNormalization(float spread, unsigned int levels = BloomLevels);
+
+// A channel's glow past the threshold, scaled so its color
+// keeps its hue
+void BloomPrefilter(const float color[4], float threshold, float out[4]);
+
+// --------------------------------------------------------
+// The passes on the CPU, bilinear and clamped like the GPU.
+// Downsampling makes a width x height image from source;
+// upsampling adds the tent of lower, times weight, onto base.
+// --------------------------------------------------------
+void BloomDownsampleImage(const BlurImage& source, unsigned int width, unsigned int height, bool prefilter, float threshold, BlurImage& result);
+void BloomUpsampleImage(const BlurImage& lower, const BlurImage& base, float weight, BlurImage& result);
+
+// The whole effect, at the sizes the chain would make its
+// targets for an image of this size
+void BloomImage(const BlurImage& source, const BloomSettings& settings, BlurImage& result, unsigned int levels = BloomLevels);
@@ -0,0 +1,51 @@
+
+Texture2D Pixels : register(t0);
+SamplerState ClampSampler : register(s0);
+
+cbuffer BloomDownsample : register(b0)
+{
+    float2 sourceTexel; // One texel of the level above, in UV
+    float threshold;    // Brightest channel where the glow starts
+    int prefilter;      // The first level, read from the image itself
+}
+
+struct VertexToPixel
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+};
+
+// The part of a color past the threshold, keeping its hue
+float4 Prefilter(float4 color)
+{
+    float brightness = max(color.r, max(color.g, color.b));
+    return color * (max(brightness - threshold, 0) / max(brightness, 1e-4));
+}
+
+float4 Tap(float2 uv, float2 offset, float weight)
+{
+    float4 color = Pixels.Sample(ClampSampler, uv + offset * sourceTexel);
+    return (prefilter ? Prefilter(color) : color) * weight;
+}
+
+// --------------------------------------------------------
+// Halves the level above with 13 bilinear taps: 4 boxes of
+// 2x2 texels right around the pixel, and 9 more spread over
+// the ring around them, so a small bright spot doesn't
+// flicker as it moves across texels.  See Bloom.h.
+// --------------------------------------------------------
+float4 main(VertexToPixel input) : SV_TARGET
+{
+    float2 uv = input.uv;
+    float4 total =
+        Tap(uv, float2(-1, -1), 0.125) + Tap(uv, float2(1, -1), 0.125) +
+        Tap(uv, float2(-1, 1), 0.125) + Tap(uv, float2(1, 1), 0.125) +
+        Tap(uv, float2(0, 0), 0.125);
+    total +=
+        Tap(uv, float2(0, -2), 0.0625) + Tap(uv, float2(-2, 0), 0.0625) +
+        Tap(uv, float2(2, 0), 0.0625) + Tap(uv, float2(0, 2), 0.0625);
+    total +=
+        Tap(uv, float2(-2, -2), 0.03125) + Tap(uv, float2(2, -2), 0.03125) +
+        Tap(uv, float2(-2, 2), 0.03125) + Tap(uv, float2(2, 2), 0.03125);
+    return total;
+}
@@ -0,0 +1,44 @@
+
+Texture2D Pixels : register(t0);    // The level below
+Texture2D Base : register(t1);      // What it's added onto, when it can't be blended
+SamplerState ClampSampler : register(s0);
+
+cbuffer BloomUpsample : register(b0)
+{
+    float2 sourceTexel;     // One texel of the level below, in UV
+    float upsampleWeight;   // How much of it to add
+    int addBase;            // Add Base here, rather than through the blend state
+}
+
+struct VertexToPixel
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+};
+
+// --------------------------------------------------------
+// A 3x3 tent of the level below, 1 2 1 across and down, so
+// each level comes back up smoothly.  Usually it's drawn
+// straight onto the level it's added to with an additive
+// blend; otherwise that's read and added here.
+// --------------------------------------------------------
+float4 main(VertexToPixel input) : SV_TARGET
+{
+    float2 uv = input.uv;
+    float4 d = float4(sourceTexel, -sourceTexel.x, 0);
+    float4 total =
+        Pixels.Sample(ClampSampler, uv - d.xy) +
+        Pixels.Sample(ClampSampler, uv - d.wy) * 2 +
+        Pixels.Sample(ClampSampler, uv + d.zy) +
+        Pixels.Sample(ClampSampler, uv + d.zw) * 2 +
+        Pixels.Sample(ClampSampler, uv) * 4 +
+        Pixels.Sample(ClampSampler, uv + d.xw) * 2 +
+        Pixels.Sample(ClampSampler, uv - d.zy) +
+        Pixels.Sample(ClampSampler, uv + d.wy) * 2 +
+        Pixels.Sample(ClampSampler, uv + d.xy);
+    total *= upsampleWeight / 16;
+
+    if (addBase)
+        total += Base.Sample(ClampSampler, uv);
+    return total;
+}
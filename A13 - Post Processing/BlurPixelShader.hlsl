@@ -0,0 +1,38 @@
+
+// The most taps a pass folds its kernel into (MaxBlurTaps in
+// GaussianBlur.h)
+#define MAX_BLUR_TAPS 17
+
+Texture2D Pixels : register(t0);
+SamplerState ClampSampler : register(s0);
+
+// Worked out on the CPU whenever the radius changes
+cbuffer BlurPass : register(b0)
+{
+    float4 blurTaps[MAX_BLUR_TAPS]; // Offset in texels (x) and weight (y), tap 0 being the center
+    float2 texelStep;               // One texel along this pass, in UV
+    int tapCount;
+}
+
+struct VertexToPixel
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+};
+
+// --------------------------------------------------------
+// One direction of a separable Gaussian blur.  Each tap past
+// the first sits between two texels, so the bilinear filter
+// weighs both of them in one sample; see GaussianBlur.h.
+// --------------------------------------------------------
+float4 main(VertexToPixel input) : SV_TARGET
+{
+    float4 total = Pixels.Sample(ClampSampler, input.uv) * blurTaps[0].y;
+    for (int i = 1; i < tapCount; i++)
+    {
+        float2 offset = texelStep * blurTaps[i].x;
+        float4 pair = Pixels.Sample(ClampSampler, input.uv + offset) + Pixels.Sample(ClampSampler, input.uv - offset);
+        total += pair * blurTaps[i].y;
+    }
+    return total;
+}
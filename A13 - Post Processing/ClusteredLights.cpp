@@ -0,0 +1,120 @@
+#include "ClusteredLights.h"
+
+ClusteredLights::ClusteredLights(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context) :
+	device(device),
+	context(context),
+	info(device, context),
+	assignTicks(0)
+{
+}
+
+double ClusteredLights::GetAssignTime() const
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	return assignTicks * 1000.0 / (double)freq.QuadPart;
+}
+
+// --------------------------------------------------------
+// Sorts the lights, bins them and sends everything over.
+// Directional lights go first so the shader can loop over
+// them without the index list.
+// --------------------------------------------------------
+void ClusteredLights::Update(const std::vector<Light>& lights, const Camera& camera, unsigned int width, unsigned int height)
+{
+	sortedLights.clear();
+	for (const Light& light : lights)
+		if (light.Type == LIGHT_TYPE_DIRECTION)
+			sortedLights.push_back(light);
+	unsigned int directionalLights = (unsigned int)sortedLights.size();
+	for (const Light& light : lights)
+		if (light.Type != LIGHT_TYPE_DIRECTION)
+			sortedLights.push_back(light);
+
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+
+	grid.SetProjection(camera.GetProjectionMatrix(), camera.GetNearPlane(), camera.GetFarPlane());
+	grid.Assign(sortedLights.data(), (unsigned int)sortedLights.size(), camera.GetViewMatrix());
+
+	LARGE_INTEGER end;
+	QueryPerformanceCounter(&end);
+	assignTicks = end.QuadPart - start.QuadPart;
+
+	const std::vector<LightClusterRange>& ranges = grid.GetRanges();
+	const std::vector<unsigned int>& indices = grid.GetLightIndices();
+	Upload(lightBuffer, sortedLights.data(), (unsigned int)sortedLights.size(), sizeof(Light));
+	Upload(indexBuffer, indices.data(), (unsigned int)indices.size(), sizeof(unsigned int));
+	Upload(rangeBuffer, ranges.data(), (unsigned int)ranges.size(), sizeof(LightClusterRange));
+
+	info.Data.clusterCounts = DirectX::XMUINT3(grid.GetTilesX(), grid.GetTilesY(), grid.GetSlices());
+	info.Data.directionalLights = directionalLights;
+	info.Data.tileScale = DirectX::XMFLOAT2(
+		width ? (float)grid.GetTilesX() / width : 0.0f,
+		height ? (float)grid.GetTilesY() / height : 0.0f);
+	info.Data.sliceScale = grid.GetSliceScale();
+	info.Data.sliceBias = grid.GetSliceBias();
+	info.Upload();
+}
+
+bool ClusteredLights::BindTo(std::shared_ptr<ISimpleShader> shader)
+{
+	if (!shader || !info.BindTo(shader))
+		return false;
+
+	shader->SetShaderResourceView("Lights", lightBuffer.SRV);
+	shader->SetShaderResourceView("LightIndices", indexBuffer.SRV);
+	shader->SetShaderResourceView("ClusterRanges", rangeBuffer.SRV);
+	return true;
+}
+
+// --------------------------------------------------------
+// Refills a structured buffer, recreating it (at double the
+// size, so a growing scene doesn't reallocate every frame)
+// when the data won't fit.  Empty data still gets a one
+// element buffer so there's always something to bind.
+// --------------------------------------------------------
+bool ClusteredLights::Upload(StructuredBuffer& target, const void* data, unsigned int count, unsigned int stride)
+{
+	if (count > target.Capacity || !target.Buffer)
+	{
+		unsigned int capacity = target.Capacity * 2 > count ? target.Capacity * 2 : count;
+		if (capacity < 64)
+			capacity = 64;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = capacity * stride;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = stride;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = capacity;
+
+		target = StructuredBuffer();
+		if (FAILED(device->CreateBuffer(&desc, 0, target.Buffer.GetAddressOf())) ||
+			FAILED(device->CreateShaderResourceView(target.Buffer.Get(), &srvDesc, target.SRV.GetAddressOf())))
+		{
+			printf("Clustered lights could not create a %u element buffer\n", capacity);
+			target = StructuredBuffer();
+			return false;
+		}
+		target.Capacity = capacity;
+	}
+
+	if (count == 0)
+		return true;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(target.Buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return false;
+
+	memcpy(mapped.pData, data, (size_t)count * stride);
+	context->Unmap(target.Buffer.Get(), 0);
+	return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <d3d11.h>
+#include <memory>
+#include <vector>
+#include <wrl/client.h>
+
+#include "Camera.h"
+#include "ConstantBuffer.h"
+#include "GraphicsAPI.h"
+#include "LightClusters.h"
+#include "ShaderStructs.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Everything the clustered lighting shader reads, kept up
+// to date from a LightClusterGrid each frame:
+// - Lights (t5): every light, directional ones first
+// - LightIndices (t6): the grid's index list
+// - ClusterRanges (t7): each cluster's offset and count
+// - ClusterInfo (b3): grid size and depth slicing
+//
+// The structured buffers are dynamic and only recreated
+// when they need to grow, so any number of lights works.
+// --------------------------------------------------------
+class ClusteredLights
+{
+public:
+	ClusteredLights(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context);
+
+	// Bins the lights for the camera's view and uploads the
+	// results.  width and height are the render target's.
+	void Update(const std::vector<Light>& lights, const Camera& camera, unsigned int width, unsigned int height);
+
+	// Binds the buffers to a shader with the CLUSTERED_LIGHTS
+	// path compiled in.  Returns false if it doesn't have it.
+	bool BindTo(std::shared_ptr<ISimpleShader> shader);
+
+	const LightClusterGrid& GetGrid() const { return grid; }
+
+	// Counters for the last Update()
+	unsigned int GetLightCount() const { return (unsigned int)sortedLights.size(); }
+	unsigned int GetIndexCount() const { return (unsigned int)grid.GetLightIndices().size(); }
+	double GetAssignTime() const;	// Milliseconds
+
+private:
+	std::shared_ptr<IGraphicsDevice> device;
+	std::shared_ptr<IGraphicsContext> context;
+
+	LightClusterGrid grid;
+	std::vector<Light> sortedLights;
+	ConstantBuffer<ClusterInfoConstants> info;
+
+	// A structured buffer and how many elements it can hold
+	struct StructuredBuffer
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> Buffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+		unsigned int Capacity = 0;
+	};
+	StructuredBuffer lightBuffer;
+	StructuredBuffer indexBuffer;
+	StructuredBuffer rangeBuffer;
+
+	bool Upload(StructuredBuffer& target, const void* data, unsigned int count, unsigned int stride);
+
+	long long assignTicks;
+};
@@ -0,0 +1,272 @@
+#include "ColorGrading.h"
+
+#include <atomic>
+#include <emmintrin.h>
+#include <math.h>
+#include <thread>
+
+namespace
+{
+	const float LumaWeights[3] = { 0.2126f, 0.7152f, 0.0722f };	// Rec. 709
+	const float DisplayGamma = 2.2f;
+	static_assert(ColorLutSize % 4 == 0, "Rows are baked four entries at a time");
+
+	float Saturate(float x)
+	{
+		return x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x;
+	}
+
+	// --------------------------------------------------------
+	// The curve on one exposed linear channel, 0 to 1.  Both
+	// are clamped, since they're read past where they reach
+	// white.  Anything not above zero (NaN too) is black.
+	// --------------------------------------------------------
+	float Tonemap(float x, const ColorGradeSettings& settings)
+	{
+		if (!(x > 0.0f))
+			return 0.0f;
+		if (settings.Curve == TonemapCurve::Reinhard)
+		{
+			float white = settings.WhitePoint;
+			return Saturate(x * (1.0f + x / (white * white)) / (1.0f + x));
+		}
+		return Saturate((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f));
+	}
+
+	// --------------------------------------------------------
+	// log2 and exp2, four at a time.  Each splits off the
+	// exponent and fits the rest with a polynomial, close
+	// enough (a few millionths) that an 8-bit result can't
+	// tell them from the real thing.  Log2() treats anything
+	// not above zero as the smallest float.
+	// --------------------------------------------------------
+	__m128 Log2(__m128 x)
+	{
+		x = _mm_max_ps(x, _mm_set1_ps(1.17549435e-38f));
+		__m128i bits = _mm_castps_si128(x);
+		__m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+		__m128 t = _mm_sub_ps(
+			_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000))),
+			_mm_set1_ps(1.0f));
+
+		// log2(1 + t) for t from 0 to 1
+		__m128 p = _mm_set1_ps(-0.0257923478f);
+		p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.121472957f));
+		p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.277341656f));
+		p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.457158126f));
+		p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.718033592f));
+		p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(1.44253478f));
+		return _mm_add_ps(exponent, _mm_mul_ps(p, t));
+	}
+
+	__m128 Exp2(__m128 x)
+	{
+		x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)), _mm_set1_ps(126.0f));
+
+		// Truncation rounds negatives up, so step those back down
+		__m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+		whole = _mm_sub_ps(whole, _mm_and_ps(_mm_cmpgt_ps(whole, x), _mm_set1_ps(1.0f)));
+		__m128 t = _mm_sub_ps(x, whole);
+
+		// 2^t for t from 0 to 1
+		__m128 p = _mm_set1_ps(0.00189510752f);
+		p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.00894621407f));
+		p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.0558632832f));
+		p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.240140770f));
+		p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.693154620f));
+		p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.999999896f));
+
+		__m128i scale = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(whole), _mm_set1_epi32(127)), 23);
+		return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+	}
+
+	__m128 Pow(__m128 x, __m128 power)
+	{
+		return Exp2(_mm_mul_ps(Log2(x), power));
+	}
+
+	__m128 Clamp01(__m128 x)
+	{
+		return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	}
+
+	// --------------------------------------------------------
+	// One row of the table (every red, at one green and blue).
+	// curved holds each channel's tonemapped, tinted value at
+	// every entry, which is all of the grade that doesn't mix
+	// channels.
+	// --------------------------------------------------------
+	void BakeRow(const float curved[3][ColorLutSize], unsigned int green, unsigned int blue,
+		const ColorGradeSettings& settings, unsigned char* row)
+	{
+		const __m128 g = _mm_set1_ps(curved[1][green]);
+		const __m128 b = _mm_set1_ps(curved[2][blue]);
+		const __m128 lumaGB = _mm_set1_ps(LumaWeights[1] * curved[1][green] + LumaWeights[2] * curved[2][blue]);
+		const __m128 lumaR = _mm_set1_ps(LumaWeights[0]);
+		const __m128 saturation = _mm_set1_ps(settings.Saturation);
+		const __m128 toDisplay = _mm_set1_ps(1.0f / DisplayGamma);
+		const __m128 contrast = _mm_set1_ps(settings.Contrast);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 gamma = _mm_set1_ps(1.0f / settings.Gamma);
+		const __m128 scale = _mm_set1_ps(255.0f);
+
+		for (unsigned int red = 0; red < ColorLutSize; red += 4)
+		{
+			__m128 r = _mm_loadu_ps(&curved[0][red]);
+			__m128 luma = _mm_add_ps(_mm_mul_ps(lumaR, r), lumaGB);
+
+			__m128 color[3] = { r, g, b };
+			__m128i packed = _mm_set1_epi32((int)0xFF000000);
+			for (int ch = 0; ch < 3; ch++)
+			{
+				__m128 c = Clamp01(_mm_add_ps(luma, _mm_mul_ps(_mm_sub_ps(color[ch], luma), saturation)));
+				c = Pow(c, toDisplay);
+				c = Clamp01(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(c, half), contrast), half));
+				if (settings.Gamma != 1.0f)
+					c = Pow(c, gamma);
+				__m128i byte = _mm_cvtps_epi32(_mm_mul_ps(c, scale));
+				packed = _mm_or_si128(packed, _mm_sll_epi32(byte, _mm_cvtsi32_si128(8 * ch)));
+			}
+			_mm_storeu_si128((__m128i*)(row + red * 4), packed);
+		}
+	}
+}
+
+bool ColorGradeSettings::operator==(const ColorGradeSettings& other) const
+{
+	return
+		Curve == other.Curve &&
+		WhitePoint == other.WhitePoint &&
+		Tint[0] == other.Tint[0] &&
+		Tint[1] == other.Tint[1] &&
+		Tint[2] == other.Tint[2] &&
+		Saturation == other.Saturation &&
+		Contrast == other.Contrast &&
+		Gamma == other.Gamma;
+}
+
+void GradeColor(const float color[3], const ColorGradeSettings& settings, float out[3])
+{
+	float curved[3];
+	for (int ch = 0; ch < 3; ch++)
+		curved[ch] = Tonemap(color[ch], settings) * settings.Tint[ch];
+
+	float luma = LumaWeights[0] * curved[0] + LumaWeights[1] * curved[1] + LumaWeights[2] * curved[2];
+	for (int ch = 0; ch < 3; ch++)
+	{
+		float c = Saturate(luma + (curved[ch] - luma) * settings.Saturation);
+		c = powf(c, 1.0f / DisplayGamma);
+		c = Saturate((c - 0.5f) * settings.Contrast + 0.5f);
+		out[ch] = powf(c, 1.0f / settings.Gamma);
+	}
+}
+
+float ColorLutShaper(float x)
+{
+	return powf(Saturate(x / ColorLutRange), 1.0f / ColorLutShaperPower);
+}
+
+float ColorLutUnshaper(float u)
+{
+	return ColorLutRange * powf(u, ColorLutShaperPower);
+}
+
+void BakeColorLut(const ColorGradeSettings& settings, std::vector<unsigned char>& lut, unsigned int threadCount)
+{
+	lut.resize(ColorLutSize * ColorLutSize * ColorLutSize * 4);
+
+	// The per channel part of the grade, once per entry along
+	// an axis rather than once per entry of the table
+	float curved[3][ColorLutSize];
+	for (unsigned int i = 0; i < ColorLutSize; i++)
+	{
+		float x = ColorLutUnshaper(i / (float)(ColorLutSize - 1));
+		for (int ch = 0; ch < 3; ch++)
+			curved[ch][i] = Tonemap(x, settings) * settings.Tint[ch];
+	}
+
+	// Threads take the next slice until there are none left
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+	if (threadCount > ColorLutSize)
+		threadCount = ColorLutSize;
+
+	std::atomic<unsigned int> nextSlice(0);
+	auto work = [&]()
+	{
+		for (unsigned int blue = nextSlice++; blue < ColorLutSize; blue = nextSlice++)
+		{
+			for (unsigned int green = 0; green < ColorLutSize; green++)
+				BakeRow(curved, green, blue, settings, &lut[((blue * ColorLutSize) + green) * ColorLutSize * 4]);
+		}
+	};
+
+	// This thread does its share too
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < threadCount; i++)
+		threads.emplace_back(work);
+	work();
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+void BakeColorLutReference(const ColorGradeSettings& settings, std::vector<unsigned char>& lut)
+{
+	lut.resize(ColorLutSize * ColorLutSize * ColorLutSize * 4);
+	unsigned char* entry = lut.data();
+	for (unsigned int blue = 0; blue < ColorLutSize; blue++)
+	{
+		for (unsigned int green = 0; green < ColorLutSize; green++)
+		{
+			for (unsigned int red = 0; red < ColorLutSize; red++)
+			{
+				float color[3] =
+				{
+					ColorLutUnshaper(red / (float)(ColorLutSize - 1)),
+					ColorLutUnshaper(green / (float)(ColorLutSize - 1)),
+					ColorLutUnshaper(blue / (float)(ColorLutSize - 1)),
+				};
+				float graded[3];
+				GradeColor(color, settings, graded);
+				for (int ch = 0; ch < 3; ch++)
+					entry[ch] = (unsigned char)(graded[ch] * 255.0f + 0.5f);
+				entry[3] = 255;
+				entry += 4;
+			}
+		}
+	}
+}
+
+void SampleColorLut(const std::vector<unsigned char>& lut, const float color[3], float out[3])
+{
+	// Each axis: the two entries either side, and how far along
+	unsigned int low[3];
+	float blend[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float position = ColorLutShaper(color[axis]) * (ColorLutSize - 1);
+		low[axis] = (unsigned int)position;
+		if (low[axis] > ColorLutSize - 2)
+			low[axis] = ColorLutSize - 2;
+		blend[axis] = position - low[axis];
+	}
+
+	out[0] = out[1] = out[2] = 0.0f;
+	for (unsigned int corner = 0; corner < 8; corner++)
+	{
+		float weight = 1.0f;
+		unsigned int index[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			bool high = (corner >> axis) & 1;
+			index[axis] = low[axis] + (high ? 1 : 0);
+			weight *= high ? blend[axis] : 1.0f - blend[axis];
+		}
+
+		const unsigned char* entry = &lut[((index[2] * ColorLutSize + index[1]) * ColorLutSize + index[0]) * 4];
+		for (int ch = 0; ch < 3; ch++)
+			out[ch] += weight * entry[ch] / 255.0f;
+	}
+}
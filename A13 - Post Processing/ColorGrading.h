@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// Color grading, baked into a 3D lookup table.
+//
+// Everything done to a color after its exposure - the
+// tonemap curve, tint, saturation, contrast and gamma - is
+// worked out on the CPU for every entry of a table whenever
+// a setting changes, and the post process pass does a single
+// Sample of it per pixel however many of them there are.
+//
+// The table is indexed by exposed linear color through a
+// power shaper, u = (x / ColorLutRange)^(1 / 2.2), so its
+// entries are spread the way the display's gamma spreads
+// them and the graded result is close to straight between
+// any two.  Both curves reach white by ColorLutRange, so
+// clamping there loses nothing.
+// --------------------------------------------------------
+
+const unsigned int ColorLutSize = 32;		// Entries along each axis
+const float ColorLutRange = 16.0f;			// The exposed linear value at the far edge
+const float ColorLutShaperPower = 2.2f;
+
+enum class TonemapCurve
+{
+	ACES,		// Narkowicz's fit of the ACES filmic curve
+	Reinhard,	// x / (1 + x), extended to reach white at the white point
+	Count
+};
+
+struct ColorGradeSettings
+{
+	TonemapCurve Curve = TonemapCurve::ACES;
+	float WhitePoint = 8.0f;		// Reinhard: the exposed value that maps to white, up to ColorLutRange
+	float Tint[3] = { 1.0f, 1.0f, 1.0f };	// Multiplies the tonemapped linear color
+	float Saturation = 1.0f;		// 0 is grey, 1 unchanged
+	float Contrast = 1.0f;			// Around the display's middle value
+	float Gamma = 1.0f;				// On top of the display's 2.2
+
+	bool operator==(const ColorGradeSettings& other) const;
+	bool operator!=(const ColorGradeSettings& other) const { return !(*this == other); }
+};
+
+// --------------------------------------------------------
+// One exposed linear color through every operation, with
+// nothing baked: what the table stands in for.  The result
+// is what goes to the screen, each channel 0 to 1.
+// --------------------------------------------------------
+void GradeColor(const float color[3], const ColorGradeSettings& settings, float out[3]);
+
+// Where an exposed linear value lands along the table, 0 to
+// 1, and the value at a point along it
+float ColorLutShaper(float x);
+float ColorLutUnshaper(float u);
+
+// --------------------------------------------------------
+// Bakes the table as 8-bit RGBA, red fastest, then green,
+// then blue: a 3D texture's layout, with a row pitch of
+// ColorLutSize * 4 bytes and a slice pitch of ColorLutSize^2
+// * 4.  Slices are spread over threadCount threads (0 for
+// one per core) and each row is graded four entries at a
+// time with SSE.
+// --------------------------------------------------------
+void BakeColorLut(const ColorGradeSettings& settings, std::vector<unsigned char>& lut, unsigned int threadCount = 0);
+
+// The same table one entry at a time through GradeColor(),
+// to check and time the bake against
+void BakeColorLutReference(const ColorGradeSettings& settings, std::vector<unsigned char>& lut);
+
+// An exposed linear color looked up in a baked table, with
+// the trilinear filtering the GPU's sampler does
+void SampleColorLut(const std::vector<unsigned char>& lut, const float color[3], float out[3]);
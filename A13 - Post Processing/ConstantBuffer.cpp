@@ -0,0 +1,46 @@
+#include "ConstantBuffer.h"
+
+// --------------------------------------------------------
+// Used whenever a typed buffer is bound, so a header that's
+// out of date with the compiled shaders is caught up front
+// instead of showing up as garbage on screen.  Returns
+// false, after printing what's wrong, if they disagree.
+// --------------------------------------------------------
+bool ShaderMatchesStruct(
+	ISimpleShader* shader,
+	const char* bufferName,
+	const ShaderStructField* fields,
+	size_t fieldCount,
+	unsigned int structSize)
+{
+	const ShaderReflectionData& reflection = shader->GetReflection();
+	for (const ShaderReflectionData::ConstantBuffer& cb : reflection.ConstantBuffers)
+	{
+		if (cb.Name != bufferName)
+			continue;
+
+		if (cb.Size > structSize)
+		{
+			printf("cbuffer %s is %u bytes in a shader, but its struct is %u; regenerate ShaderStructs.h\n", bufferName, cb.Size, structSize);
+			return false;
+		}
+
+		for (const ShaderReflectionData::Variable& var : cb.Variables)
+		{
+			const ShaderStructField* field = 0;
+			for (size_t i = 0; i < fieldCount && !field; i++)
+				if (var.Name == fields[i].Name)
+					field = &fields[i];
+
+			if (!field || field->ByteOffset != var.ByteOffset || field->Size != var.Size)
+			{
+				printf("cbuffer %s: '%s' doesn't match its struct; regenerate ShaderStructs.h\n", bufferName, var.Name.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// The shader doesn't use it at all
+	return false;
+}
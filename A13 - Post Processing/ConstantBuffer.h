@@ -0,0 +1,112 @@
+#pragma once
+
+#include <d3d11.h>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <wrl/client.h>
+
+#include "GraphicsAPI.h"
+#include "HlslPacking.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Checks a shader's reflected cbuffer against a generated
+// struct's field table.  The shader may leave off trailing
+// variables (its buffer can be smaller), but everything it
+// does declare has to be where the struct has it.
+// --------------------------------------------------------
+bool ShaderMatchesStruct(
+	ISimpleShader* shader,
+	const char* bufferName,
+	const ShaderStructField* fields,
+	size_t fieldCount,
+	unsigned int structSize);
+
+// --------------------------------------------------------
+// A constant buffer filled from one of the structs in
+// ShaderStructs.h.  Set members on Data, then Upload()
+// copies the whole struct in one go, so there are no
+// per-variable lookups or copies at all.
+//
+// Unlike SharedConstantBuffer nothing is compared, so this
+// suits data that changes every time it's used, like per
+// object matrices.  With ISimpleShader::BufferRing set each
+// upload goes to a new slice of the ring, bound by offset;
+// otherwise the buffer, which is dynamic, is refilled with
+// a discarding map.  Slices only last a frame, so Upload()
+// in every frame the data is used.
+// --------------------------------------------------------
+template<typename T>
+class ConstantBuffer
+{
+public:
+	ConstantBuffer(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context) :
+		context(context),
+		slice(std::make_shared<ConstantBufferSlice>()),
+		Data{}
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = sizeof(T);
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		if (FAILED(device->CreateBuffer(&desc, 0, buffer.GetAddressOf())))
+			printf("Constant buffer '%s' could not create its buffer\n", T::BufferName);
+	}
+
+	// Sends all of Data to the GPU, rebinding it wherever the
+	// new data is at a different place than the old
+	void Upload()
+	{
+		if (!buffer)
+			return;
+
+		std::shared_ptr<ConstantBufferRing> ring = ISimpleShader::BufferRing;
+		if (ring && ring->Allocate(&Data, sizeof(T), *slice))
+		{
+			ISimpleShader::UploadedBytes += sizeof(T);
+			ISimpleShader::RebindConstantBuffer(buffer.Get());
+			return;
+		}
+
+		// No ring, or it's full this frame
+		bool wasInRing = slice->Buffer != 0;
+		*slice = ConstantBufferSlice();
+		if (wasInRing)
+			ISimpleShader::RebindConstantBuffer(buffer.Get());
+
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(context->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+			return;
+
+		memcpy(mapped.pData, &Data, sizeof(T));
+		context->Unmap(buffer.Get(), 0);
+		ISimpleShader::UploadedBytes += sizeof(T);
+	}
+
+	// Makes the shader use this buffer for its cbuffer of the
+	// same name, if the layouts agree
+	bool BindTo(std::shared_ptr<ISimpleShader> shader)
+	{
+		if (!buffer || !shader)
+			return false;
+		if (!ShaderMatchesStruct(shader.get(), T::BufferName, T::Fields, sizeof(T::Fields) / sizeof(T::Fields[0]), sizeof(T)))
+			return false;
+
+		return shader->SetConstantBuffer(T::BufferName, buffer, slice);
+	}
+
+	bool IsValid() const { return buffer != 0; }
+	unsigned int GetSize() const { return sizeof(T); }
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetBuffer() const { return buffer; }
+	const ConstantBufferSlice& GetSlice() const { return *slice; }
+
+private:
+	std::shared_ptr<IGraphicsContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	std::shared_ptr<ConstantBufferSlice> slice;	// Shared with the shaders it's bound to
+
+public:
+	T Data;
+};
@@ -0,0 +1,271 @@
+#include "ConstantBufferRing.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Largest buffer we'll grow to, from D3D11's resource limit
+static const unsigned int MaxRingSize = D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_A_TERM * 1024 * 1024;
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ RING ALLOCATOR ------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+RingAllocator::RingAllocator(unsigned int capacity, unsigned int alignment) :
+	capacity(capacity / alignment * alignment),
+	alignment(alignment),
+	head(0),
+	used(0),
+	frameBytes(0),
+	wraps(0),
+	lastHead(0),
+	lastBytes(0),
+	lastWrapped(false)
+{
+}
+
+// --------------------------------------------------------
+// Reserves space at the head of the ring.  Allocations are
+// never split, so if there isn't enough room before the end
+// of the region the rest of it is skipped and the
+// allocation starts back at zero.  That padding counts as
+// used until its frame retires.
+//
+// size   - Bytes needed
+// offset - Where they start, if successful
+// --------------------------------------------------------
+bool RingAllocator::Allocate(unsigned int size, unsigned int& offset)
+{
+	unsigned int aligned = (size + alignment - 1) / alignment * alignment;
+	if (aligned == 0)
+		aligned = alignment;
+	if (aligned > capacity)
+		return false;
+
+	// Room between the head and the end of the region?  Also
+	// covers the case where the retired space is ahead of us,
+	// since then everything not used is contiguous.
+	if (aligned <= capacity - head && used + aligned <= capacity)
+	{
+		lastHead = head;
+		lastBytes = aligned;
+		lastWrapped = false;
+
+		offset = head;
+		head += aligned;
+		used += aligned;
+		frameBytes += aligned;
+		return true;
+	}
+
+	// Otherwise skip to the start, if that's free
+	unsigned int padding = capacity - head;
+	if (used + padding + aligned > capacity)
+		return false;
+
+	lastHead = head;
+	lastBytes = padding + aligned;
+	lastWrapped = true;
+
+	offset = 0;
+	head = aligned;
+	used += padding + aligned;
+	frameBytes += padding + aligned;
+	wraps++;
+	return true;
+}
+
+// --------------------------------------------------------
+// Puts the head back where it was before the last
+// allocation, padding and all
+// --------------------------------------------------------
+void RingAllocator::Undo()
+{
+	head = lastHead;
+	used -= lastBytes;
+	frameBytes -= lastBytes;
+	if (lastWrapped)
+		wraps--;
+
+	lastBytes = 0;
+	lastWrapped = false;
+}
+
+void RingAllocator::EndFrame()
+{
+	frames.push_back(frameBytes);
+	frameBytes = 0;
+	lastBytes = 0;
+	lastWrapped = false;
+}
+
+// --------------------------------------------------------
+// Frees everything from the oldest ended frame.  Returns
+// false if there are no ended frames left.
+// --------------------------------------------------------
+bool RingAllocator::RetireFrame()
+{
+	if (frames.empty())
+		return false;
+
+	used -= frames.front();
+	frames.pop_front();
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ CONSTANT BUFFER RING ------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+ConstantBufferRing::ConstantBufferRing(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, unsigned int size) :
+	device(device),
+	context(context),
+	allocator(size),
+	freshBuffer(true),
+	grow(false),
+	generation(1),
+	frameBytes(0),
+	frameAllocations(0),
+	frameFallbacks(0)
+{
+	CreateBuffer(allocator.GetCapacity());
+}
+
+// --------------------------------------------------------
+// Makes the dynamic buffer everything is allocated from
+// --------------------------------------------------------
+void ConstantBufferRing::CreateBuffer(unsigned int size)
+{
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = size;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	buffer.Reset();
+	if (FAILED(device->CreateBuffer(&desc, 0, buffer.GetAddressOf())))
+		printf("Constant buffer ring could not create its %u byte buffer\n", size);
+
+	freshBuffer = true;
+}
+
+// --------------------------------------------------------
+// Gives back the space from any frames the GPU has finished.
+// Without a real device there's nothing to wait on, so
+// every ended frame is done.
+// --------------------------------------------------------
+void ConstantBufferRing::RetireFinishedFrames()
+{
+	ID3D11DeviceContext* d3dContext = context->GetD3DContext();
+	if (!d3dContext)
+	{
+		while (allocator.RetireFrame());
+		return;
+	}
+
+	while (!fences.empty())
+	{
+		// Frames without a fence (query creation failed) are
+		// retired along with the frame before them
+		ID3D11Query* fence = fences.front().Get();
+		if (fence && d3dContext->GetData(fence, 0, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			break;
+
+		fences.pop_front();
+		allocator.RetireFrame();
+	}
+}
+
+// --------------------------------------------------------
+// Starts a new frame.  Slices from earlier frames stop being
+// current, and the buffer is replaced with a bigger one if
+// the last frame didn't fit.
+// --------------------------------------------------------
+void ConstantBufferRing::BeginFrame()
+{
+	generation++;
+	frameBytes = 0;
+	frameAllocations = 0;
+	frameFallbacks = 0;
+
+	if (grow && allocator.GetCapacity() < MaxRingSize)
+	{
+		// The old buffer stays alive for as long as the GPU
+		// still needs it, so its frames can just be dropped
+		unsigned int size = allocator.GetCapacity() * 2 < MaxRingSize ? allocator.GetCapacity() * 2 : MaxRingSize;
+		allocator = RingAllocator(size);
+		fences.clear();
+		CreateBuffer(allocator.GetCapacity());
+	}
+	grow = false;
+
+	RetireFinishedFrames();
+}
+
+// --------------------------------------------------------
+// Ends the frame, fencing it on the GPU timeline
+// --------------------------------------------------------
+void ConstantBufferRing::EndFrame()
+{
+	allocator.EndFrame();
+
+	ID3D11Device* d3dDevice = device->GetD3DDevice();
+	ID3D11DeviceContext* d3dContext = context->GetD3DContext();
+	if (!d3dDevice || !d3dContext)
+		return;
+
+	D3D11_QUERY_DESC desc = {};
+	desc.Query = D3D11_QUERY_EVENT;
+
+	Microsoft::WRL::ComPtr<ID3D11Query> fence;
+	if (SUCCEEDED(d3dDevice->CreateQuery(&desc, fence.GetAddressOf())))
+		d3dContext->End(fence.Get());
+	fences.push_back(fence);
+}
+
+// --------------------------------------------------------
+// Copies data into the next free slice of the ring.  Each
+// slice is its own NO_OVERWRITE map, since D3D11 won't draw
+// from a buffer while it's mapped; those maps are cheap as
+// the driver never has to wait or rename the buffer.
+//
+// data  - Bytes to copy
+// size  - How many
+// slice - Filled in with what to bind, if successful
+// --------------------------------------------------------
+bool ConstantBufferRing::Allocate(const void* data, unsigned int size, ConstantBufferSlice& slice)
+{
+	unsigned int offset = 0;
+	if (!buffer || !allocator.Allocate(size, offset))
+	{
+		grow = buffer != 0;
+		frameFallbacks++;
+		return false;
+	}
+
+	// The very first map has to discard, as there's nothing
+	// for NO_OVERWRITE to preserve yet
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	D3D11_MAP mapType = freshBuffer ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (FAILED(context->Map(buffer.Get(), 0, mapType, 0, &mapped)))
+	{
+		// Nothing was written, so the space isn't taken
+		allocator.Undo();
+		frameFallbacks++;
+		return false;
+	}
+	freshBuffer = false;
+
+	memcpy((unsigned char*)mapped.pData + offset, data, size);
+	context->Unmap(buffer.Get(), 0);
+
+	unsigned int aligned = (size + allocator.GetAlignment() - 1) / allocator.GetAlignment() * allocator.GetAlignment();
+	slice.Buffer = buffer.Get();
+	slice.FirstConstant = offset / 16;
+	slice.NumConstants = aligned / 16;
+	slice.Generation = generation;
+
+	frameBytes += aligned;
+	frameAllocations++;
+	return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <d3d11.h>
+#include <deque>
+#include <memory>
+#include <wrl/client.h>
+
+#include "GraphicsAPI.h"
+
+// --------------------------------------------------------
+// Hands out aligned byte ranges from a fixed-size circular
+// region, one frame at a time.  Knows nothing about the GPU:
+// the owner says when a frame ends and when the oldest one
+// is no longer in use, and that space becomes free again.
+// --------------------------------------------------------
+class RingAllocator
+{
+public:
+	RingAllocator(unsigned int capacity, unsigned int alignment = 256);
+
+	// Reserves size bytes (rounded up to the alignment),
+	// skipping the end of the region if the request doesn't
+	// fit there.  Fails if the space is still in use.
+	bool Allocate(unsigned int size, unsigned int& offset);
+
+	// Gives back the most recent allocation, for when the
+	// caller couldn't use it.  Only the last one can be undone.
+	void Undo();
+
+	// Closes the current frame; everything allocated since the
+	// last EndFrame() is released by one later RetireFrame()
+	void EndFrame();
+	bool RetireFrame();
+
+	unsigned int GetCapacity() const { return capacity; }
+	unsigned int GetAlignment() const { return alignment; }
+	unsigned int GetUsed() const { return used; }
+	unsigned int GetFramesInFlight() const { return (unsigned int)frames.size(); }
+	unsigned int GetWrapCount() const { return wraps; }
+
+private:
+	unsigned int capacity;
+	unsigned int alignment;
+	unsigned int head;			// Where the next allocation starts
+	unsigned int used;			// Bytes not yet retired, padding included
+	unsigned int frameBytes;	// Bytes taken by the open frame
+	unsigned int wraps;
+	std::deque<unsigned int> frames;
+
+	// What the last Allocate() changed, for Undo()
+	unsigned int lastHead;
+	unsigned int lastBytes;
+	bool lastWrapped;
+};
+
+// --------------------------------------------------------
+// A piece of the ring's buffer, ready to bind with the
+// *SetConstantBuffers1 calls.  Only valid during the frame
+// it was allocated in.
+// --------------------------------------------------------
+struct ConstantBufferSlice
+{
+	ID3D11Buffer* Buffer = 0;
+	UINT FirstConstant = 0;		// In 16-byte constants
+	UINT NumConstants = 0;		// Always a multiple of 16
+	unsigned long long Generation = 0;
+};
+
+// --------------------------------------------------------
+// Per-frame constant buffer allocator.  All constant data
+// for a frame is written into one big dynamic buffer and
+// bound by offset, instead of every shader updating its own
+// buffers.  Frames are fenced with event queries so space
+// is only reused once the GPU is done reading it.
+//
+// If a frame runs out of space, Allocate() fails (callers
+// fall back to their own buffers) and the ring doubles in
+// size at the start of the next frame.
+// --------------------------------------------------------
+class ConstantBufferRing
+{
+public:
+	ConstantBufferRing(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, unsigned int size = 1024 * 1024);
+
+	void BeginFrame();
+	void EndFrame();
+
+	// Copies data into a fresh slice of the ring
+	bool Allocate(const void* data, unsigned int size, ConstantBufferSlice& slice);
+	bool IsCurrent(const ConstantBufferSlice& slice) const { return slice.Buffer && slice.Generation == generation; }
+
+	// Counters for the current frame, for the UI
+	unsigned int GetCapacity() const { return allocator.GetCapacity(); }
+	unsigned int GetFrameBytes() const { return frameBytes; }
+	unsigned int GetFrameAllocations() const { return frameAllocations; }
+	unsigned int GetFrameFallbacks() const { return frameFallbacks; }
+	unsigned int GetFramesInFlight() const { return allocator.GetFramesInFlight(); }
+	unsigned int GetWrapCount() const { return allocator.GetWrapCount(); }
+
+private:
+	std::shared_ptr<IGraphicsDevice> device;
+	std::shared_ptr<IGraphicsContext> context;
+
+	RingAllocator allocator;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	bool freshBuffer;			// Not mapped since it was made
+	bool grow;					// Ran out of space this frame
+
+	// One event query per frame the GPU may still be reading,
+	// oldest first (empty without a real device)
+	std::deque<Microsoft::WRL::ComPtr<ID3D11Query>> fences;
+
+	unsigned long long generation;
+	unsigned int frameBytes;
+	unsigned int frameAllocations;
+	unsigned int frameFallbacks;
+
+	void CreateBuffer(unsigned int size);
+	void RetireFinishedFrames();
+};
@@ -0,0 +1,400 @@
+#include "D3D11Backend.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ DEVICE --------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+bool D3D11GraphicsDevice::SupportsConstantBufferOffsets()
+{
+	// Both are needed to sub-allocate constants out of a single
+	// dynamic buffer: binding by offset, and mapping it without
+	// discarding what earlier draws are still reading
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+		return false;
+
+	return options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+}
+
+bool D3D11GraphicsDevice::SupportsPartialConstantBufferUpdates()
+{
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+		return false;
+
+	return options.ConstantBufferPartialUpdate != 0;
+}
+
+HRESULT D3D11GraphicsDevice::CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer)
+{
+	return device->CreateBuffer(desc, initialData, buffer);
+}
+
+HRESULT D3D11GraphicsDevice::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture)
+{
+	return device->CreateTexture2D(desc, initialData, texture);
+}
+
+HRESULT D3D11GraphicsDevice::CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture)
+{
+	return device->CreateTexture3D(desc, initialData, texture);
+}
+
+HRESULT D3D11GraphicsDevice::CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** srv)
+{
+	return device->CreateShaderResourceView(resource, desc, srv);
+}
+
+HRESULT D3D11GraphicsDevice::CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** rtv)
+{
+	return device->CreateRenderTargetView(resource, desc, rtv);
+}
+
+HRESULT D3D11GraphicsDevice::CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** dsv)
+{
+	return device->CreateDepthStencilView(resource, desc, dsv);
+}
+
+HRESULT D3D11GraphicsDevice::CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler)
+{
+	return device->CreateSamplerState(desc, sampler);
+}
+
+HRESULT D3D11GraphicsDevice::CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state)
+{
+	return device->CreateRasterizerState(desc, state);
+}
+
+HRESULT D3D11GraphicsDevice::CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state)
+{
+	return device->CreateDepthStencilState(desc, state);
+}
+
+HRESULT D3D11GraphicsDevice::CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state)
+{
+	return device->CreateBlendState(desc, state);
+}
+
+HRESULT D3D11GraphicsDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const void* bytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout)
+{
+	return device->CreateInputLayout(elements, elementCount, bytecode, bytecodeLength, inputLayout);
+}
+
+HRESULT D3D11GraphicsDevice::CreateVertexShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11VertexShader** shader)
+{
+	return device->CreateVertexShader(bytecode, bytecodeLength, linkage, shader);
+}
+
+HRESULT D3D11GraphicsDevice::CreatePixelShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11PixelShader** shader)
+{
+	return device->CreatePixelShader(bytecode, bytecodeLength, linkage, shader);
+}
+
+HRESULT D3D11GraphicsDevice::CreateDomainShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11DomainShader** shader)
+{
+	return device->CreateDomainShader(bytecode, bytecodeLength, linkage, shader);
+}
+
+HRESULT D3D11GraphicsDevice::CreateHullShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11HullShader** shader)
+{
+	return device->CreateHullShader(bytecode, bytecodeLength, linkage, shader);
+}
+
+HRESULT D3D11GraphicsDevice::CreateGeometryShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader)
+{
+	return device->CreateGeometryShader(bytecode, bytecodeLength, linkage, shader);
+}
+
+HRESULT D3D11GraphicsDevice::CreateGeometryShaderWithStreamOutput(const void* bytecode, SIZE_T bytecodeLength, const D3D11_SO_DECLARATION_ENTRY* soDeclaration, UINT numEntries, const UINT* bufferStrides, UINT numStrides, UINT rasterizedStream, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader)
+{
+	return device->CreateGeometryShaderWithStreamOutput(bytecode, bytecodeLength, soDeclaration, numEntries, bufferStrides, numStrides, rasterizedStream, linkage, shader);
+}
+
+HRESULT D3D11GraphicsDevice::CreateComputeShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11ComputeShader** shader)
+{
+	return device->CreateComputeShader(bytecode, bytecodeLength, linkage, shader);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ CONTEXT -------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+D3D11GraphicsContext::D3D11GraphicsContext(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) : context(context)
+{
+	// Fails on the original 11.0 runtime, in which case the
+	// *SetConstantBuffers1 calls fall back to whole buffers
+	context.As(&context1);
+}
+
+void D3D11GraphicsContext::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	context->IASetInputLayout(inputLayout);
+}
+
+void D3D11GraphicsContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	context->IASetPrimitiveTopology(topology);
+}
+
+void D3D11GraphicsContext::IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	context->IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+}
+
+void D3D11GraphicsContext::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	context->IASetIndexBuffer(buffer, format, offset);
+}
+
+void D3D11GraphicsContext::VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	context->VSSetShader(shader, classInstances, numClassInstances);
+}
+
+void D3D11GraphicsContext::VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	context->VSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::VSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (context1)
+		context1->VSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+	else
+		context->VSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	context->VSSetShaderResources(startSlot, numViews, views);
+}
+
+void D3D11GraphicsContext::VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	context->VSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void D3D11GraphicsContext::PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	context->PSSetShader(shader, classInstances, numClassInstances);
+}
+
+void D3D11GraphicsContext::PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	context->PSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::PSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (context1)
+		context1->PSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+	else
+		context->PSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	context->PSSetShaderResources(startSlot, numViews, views);
+}
+
+void D3D11GraphicsContext::PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	context->PSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void D3D11GraphicsContext::DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	context->DSSetShader(shader, classInstances, numClassInstances);
+}
+
+void D3D11GraphicsContext::DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	context->DSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::DSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (context1)
+		context1->DSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+	else
+		context->DSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	context->DSSetShaderResources(startSlot, numViews, views);
+}
+
+void D3D11GraphicsContext::DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	context->DSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void D3D11GraphicsContext::HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	context->HSSetShader(shader, classInstances, numClassInstances);
+}
+
+void D3D11GraphicsContext::HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	context->HSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::HSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (context1)
+		context1->HSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+	else
+		context->HSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	context->HSSetShaderResources(startSlot, numViews, views);
+}
+
+void D3D11GraphicsContext::HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	context->HSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void D3D11GraphicsContext::GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	context->GSSetShader(shader, classInstances, numClassInstances);
+}
+
+void D3D11GraphicsContext::GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	context->GSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::GSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (context1)
+		context1->GSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+	else
+		context->GSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	context->GSSetShaderResources(startSlot, numViews, views);
+}
+
+void D3D11GraphicsContext::GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	context->GSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void D3D11GraphicsContext::CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	context->CSSetShader(shader, classInstances, numClassInstances);
+}
+
+void D3D11GraphicsContext::CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	context->CSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::CSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (context1)
+		context1->CSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+	else
+		context->CSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11GraphicsContext::CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	context->CSSetShaderResources(startSlot, numViews, views);
+}
+
+void D3D11GraphicsContext::CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	context->CSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void D3D11GraphicsContext::CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* uavs, const UINT* initialCounts)
+{
+	context->CSSetUnorderedAccessViews(startSlot, numUAVs, uavs, initialCounts);
+}
+
+void D3D11GraphicsContext::SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets)
+{
+	context->SOSetTargets(numBuffers, targets, offsets);
+}
+
+void D3D11GraphicsContext::RSSetState(ID3D11RasterizerState* state)
+{
+	context->RSSetState(state);
+}
+
+void D3D11GraphicsContext::RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports)
+{
+	context->RSSetViewports(numViewports, viewports);
+}
+
+void D3D11GraphicsContext::OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv)
+{
+	context->OMSetRenderTargets(numViews, rtvs, dsv);
+}
+
+void D3D11GraphicsContext::OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef)
+{
+	context->OMSetDepthStencilState(state, stencilRef);
+}
+
+void D3D11GraphicsContext::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+	context->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void D3D11GraphicsContext::ClearRenderTargetView(ID3D11RenderTargetView* rtv, const FLOAT color[4])
+{
+	context->ClearRenderTargetView(rtv, color);
+}
+
+void D3D11GraphicsContext::ClearDepthStencilView(ID3D11DepthStencilView* dsv, UINT clearFlags, FLOAT depth, UINT8 stencil)
+{
+	context->ClearDepthStencilView(dsv, clearFlags, depth, stencil);
+}
+
+void D3D11GraphicsContext::UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch)
+{
+	// The 11.0 call requires a null box for constant buffers;
+	// the 11.1 one doesn't, where partial updates are supported
+	if (box && context1)
+		context1->UpdateSubresource1(resource, subresource, box, data, rowPitch, depthPitch, 0);
+	else
+		context->UpdateSubresource(resource, subresource, box, data, rowPitch, depthPitch);
+}
+
+HRESULT D3D11GraphicsContext::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped)
+{
+	return context->Map(resource, subresource, mapType, mapFlags, mapped);
+}
+
+void D3D11GraphicsContext::Unmap(ID3D11Resource* resource, UINT subresource)
+{
+	context->Unmap(resource, subresource);
+}
+
+void D3D11GraphicsContext::CopySubresourceRegion(ID3D11Resource* dest, UINT destSubresource, UINT destX, UINT destY, UINT destZ, ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox)
+{
+	context->CopySubresourceRegion(dest, destSubresource, destX, destY, destZ, source, sourceSubresource, sourceBox);
+}
+
+void D3D11GraphicsContext::Draw(UINT vertexCount, UINT startVertex)
+{
+	context->Draw(vertexCount, startVertex);
+}
+
+void D3D11GraphicsContext::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11GraphicsContext::Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ)
+{
+	context->Dispatch(groupsX, groupsY, groupsZ);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl/client.h>
+#include "GraphicsAPI.h"
+
+// --------------------------------------------------------
+// Device wrapper that forwards straight to Direct3D 11
+// --------------------------------------------------------
+class D3D11GraphicsDevice : public IGraphicsDevice
+{
+public:
+	D3D11GraphicsDevice(Microsoft::WRL::ComPtr<ID3D11Device> device) : device(device) {}
+
+	ID3D11Device* GetD3DDevice() override { return device.Get(); }
+	bool SupportsConstantBufferOffsets() override;
+	bool SupportsPartialConstantBufferUpdates() override;
+
+	HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer) override;
+	HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture) override;
+	HRESULT CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture) override;
+	HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** srv) override;
+	HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** rtv) override;
+	HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** dsv) override;
+
+	HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler) override;
+	HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state) override;
+	HRESULT CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state) override;
+	HRESULT CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state) override;
+
+	HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const void* bytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout) override;
+	HRESULT CreateVertexShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11VertexShader** shader) override;
+	HRESULT CreatePixelShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11PixelShader** shader) override;
+	HRESULT CreateDomainShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11DomainShader** shader) override;
+	HRESULT CreateHullShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11HullShader** shader) override;
+	HRESULT CreateGeometryShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader) override;
+	HRESULT CreateGeometryShaderWithStreamOutput(const void* bytecode, SIZE_T bytecodeLength,
+		const D3D11_SO_DECLARATION_ENTRY* soDeclaration, UINT numEntries, const UINT* bufferStrides, UINT numStrides,
+		UINT rasterizedStream, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader) override;
+	HRESULT CreateComputeShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11ComputeShader** shader) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+};
+
+// --------------------------------------------------------
+// Immediate context wrapper that forwards straight to
+// Direct3D 11
+// --------------------------------------------------------
+class D3D11GraphicsContext : public IGraphicsContext
+{
+public:
+	D3D11GraphicsContext(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	ID3D11DeviceContext* GetD3DContext() override { return context.Get(); }
+
+	void IASetInputLayout(ID3D11InputLayout* inputLayout) override;
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+	void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override;
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override;
+
+	void VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void VSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void PSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void DSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void HSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void GSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void CSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+	void CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* uavs, const UINT* initialCounts) override;
+
+	void SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets) override;
+
+	void RSSetState(ID3D11RasterizerState* state) override;
+	void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports) override;
+
+	void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv) override;
+	void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef) override;
+	void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) override;
+
+	void ClearRenderTargetView(ID3D11RenderTargetView* rtv, const FLOAT color[4]) override;
+	void ClearDepthStencilView(ID3D11DepthStencilView* dsv, UINT clearFlags, FLOAT depth, UINT8 stencil) override;
+
+	void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch) override;
+	HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) override;
+	void Unmap(ID3D11Resource* resource, UINT subresource) override;
+	void CopySubresourceRegion(ID3D11Resource* dest, UINT destSubresource, UINT destX, UINT destY, UINT destZ,
+		ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox) override;
+
+	void Draw(UINT vertexCount, UINT startVertex) override;
+	void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) override;
+	void Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	// 11.1 interface for binding constant buffers by offset,
+	// null on runtimes that don't have it
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;
+};
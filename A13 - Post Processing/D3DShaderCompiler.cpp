@@ -0,0 +1,49 @@
+#include "D3DShaderCompiler.h"
+
+#include <d3dcompiler.h>
+#include <stdio.h>
+#include <wrl/client.h>
+
+#pragma comment(lib, "d3dcompiler.lib")
+
+bool D3DShaderCompiler::Compile(
+	const std::wstring& sourceFile,
+	const char* entryPoint,
+	const char* target,
+	const std::vector<ShaderDefine>& defines,
+	std::vector<unsigned char>& bytecode)
+{
+	// fxc wants a null terminated array of macros
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const ShaderDefine& define : defines)
+		macros.push_back({ define.Name.c_str(), define.Value.c_str() });
+	macros.push_back({ 0, 0 });
+
+	// Match the offline build: optimized, with debug info in debug builds
+	UINT flags = D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#if defined(DEBUG) || defined(_DEBUG)
+	flags = D3DCOMPILE_DEBUG;
+#endif
+
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	Microsoft::WRL::ComPtr<ID3DBlob> errors;
+	HRESULT hr = D3DCompileFromFile(
+		sourceFile.c_str(),
+		macros.data(),
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		entryPoint,
+		target,
+		flags,
+		0,
+		blob.GetAddressOf(),
+		errors.GetAddressOf());
+
+	if (errors && errors->GetBufferSize() > 0)
+		printf("%ls:\n%s\n", sourceFile.c_str(), (const char*)errors->GetBufferPointer());
+	if (FAILED(hr) || !blob)
+		return false;
+
+	const unsigned char* start = (const unsigned char*)blob->GetBufferPointer();
+	bytecode.assign(start, start + blob->GetBufferSize());
+	return true;
+}
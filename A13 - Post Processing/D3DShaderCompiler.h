@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ShaderPermutation.h"
+
+// --------------------------------------------------------
+// Compiles shader variants at run time with fxc, through
+// D3DCompileFromFile.  #includes resolve relative to the
+// source file, as they do in the offline build.
+// --------------------------------------------------------
+class D3DShaderCompiler : public IShaderCompiler
+{
+public:
+	bool Compile(
+		const std::wstring& sourceFile,
+		const char* entryPoint,
+		const char* target,
+		const std::vector<ShaderDefine>& defines,
+		std::vector<unsigned char>& bytecode) override;
+};
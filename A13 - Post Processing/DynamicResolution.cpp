@@ -0,0 +1,120 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace
+{
+	// Steps this close to the min are taken as the min itself,
+	// so rounding can't leave a sliver of a step above it
+	const float StepTolerance = 1e-3f;
+
+	float Clamp(float x, float low, float high)
+	{
+		return x < low ? low : x > high ? high : x;
+	}
+}
+
+float QuantizeRenderScale(float scale, const DynamicResolutionSettings& settings)
+{
+	float low = settings.MinScale;
+	float high = settings.MaxScale > low ? settings.MaxScale : low;
+	scale = Clamp(scale, low, high);
+	if (!(settings.ScaleStep > 0.0f))
+		return scale;
+
+	float snapped = high - roundf((high - scale) / settings.ScaleStep) * settings.ScaleStep;
+	if (snapped < low + StepTolerance * settings.ScaleStep || fabsf(scale - low) < fabsf(scale - snapped))
+		return low;
+	return snapped;
+}
+
+unsigned int RenderScaleSteps(const DynamicResolutionSettings& settings)
+{
+	float low = settings.MinScale;
+	float high = settings.MaxScale > low ? settings.MaxScale : low;
+	if (!(settings.ScaleStep > 0.0f) || high == low)
+		return 1;
+
+	// Every step above the min, then the min
+	unsigned int steps = 1;
+	while (high - steps * settings.ScaleStep >= low + StepTolerance * settings.ScaleStep)
+		steps++;
+	return steps + 1;
+}
+
+float ResolutionController::Update(float frameMs, const DynamicResolutionSettings& settings)
+{
+	float low = settings.MinScale;
+	float high = settings.MaxScale > low ? settings.MaxScale : low;
+
+	// The first frame's time is mostly loading, so it's only
+	// where the controller starts from
+	if (!started || !(frameMs > 0.0f))
+	{
+		if (!started)
+		{
+			smoothScale = high;
+			scale = QuantizeRenderScale(high, settings);
+			started = true;
+		}
+		return scale;
+	}
+
+	// The median of the last few frames, or of as many as
+	// there have been
+	recentMs[frameCount++ % ResolutionFrameWindow] = frameMs;
+	unsigned int count = frameCount < ResolutionFrameWindow ? frameCount : ResolutionFrameWindow;
+	float sorted[ResolutionFrameWindow];
+	std::copy(recentMs, recentMs + count, sorted);
+	std::nth_element(sorted, sorted + count / 2, sorted + count);
+	float measuredMs = sorted[count / 2];
+
+	// Nothing while it's within the band from budget less
+	// headroom up to budget; outside, how far it is from the
+	// band's middle, as a fraction of the budget, and no more
+	// than a frame twice the budget
+	float budget = settings.BudgetMs;
+	bool vsynced = settings.RefreshMs > 0.0f;
+	if (vsynced)
+		budget = fmaxf(1.0f, roundf(budget / settings.RefreshMs)) * settings.RefreshMs;
+	float onBudget = budget * (1.0f - settings.Headroom);
+	float middle = (budget + onBudget) * 0.5f;
+	float error = measuredMs > budget || measuredMs < onBudget ? (middle - measuredMs) / budget : 0.0f;
+
+	// Vsynced frames are never quicker than the budget, and are
+	// only over it by missing a refresh; half an interval late
+	// is past any jitter in when it was presented
+	if (vsynced)
+		error = measuredMs > budget + settings.RefreshMs * 0.5f ? (middle - measuredMs) / budget : 0.0f;
+	error = Clamp(error, -1.0f, 1.0f);
+
+	// Velocity form, so clamping the scale is all the
+	// anti-windup it needs
+	float change = error - lastError;
+	smoothScale += settings.Proportional * change + settings.Integral * error + settings.Derivative * (change - lastChange);
+	smoothScale = Clamp(smoothScale, low, high);
+	lastError = error;
+	lastChange = change;
+
+	// Only move the drawn step once the smooth scale is well
+	// into another, or has run up against either end
+	float stepped = QuantizeRenderScale(smoothScale, settings);
+	float threshold = settings.ScaleStep * (0.5f + settings.StepHysteresis);
+	bool outside = scale < low || scale > high;
+	bool atEnd = smoothScale <= low || smoothScale >= high;
+	if (stepped != scale && (outside || atEnd || fabsf(smoothScale - scale) > threshold))
+	{
+		scale = stepped;
+		changes++;
+	}
+	return scale;
+}
+
+void ResolutionController::Reset()
+{
+	started = false;
+	lastError = 0.0f;
+	lastChange = 0.0f;
+	frameCount = 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// --------------------------------------------------------
+// Dynamic resolution: the scene is drawn at a fraction of the
+// window's size, picked each frame to keep the frame time
+// under a budget, and scaled up to the window by the last
+// pass of the post process chain.
+//
+// A PID controller works out a smooth scale from how far the
+// frame time is from the budget, going by the median of the
+// last few frames so a single long one is ignored.  What's
+// drawn at is that scale snapped to a few fixed steps, so the
+// render target pool only ever sees a handful of sizes.
+//
+// Two kinds of hysteresis keep it from flickering between
+// sizes: frame times a little under the budget count as on
+// it, so it only grows with real headroom, and the drawn step
+// only moves once the smooth scale is well past the middle of
+// the next.  The headroom has to be wider than what a step
+// changes the frame time by (near full size, a 0.05 step is
+// about a tenth of the pixels), or there may be no step that
+// lands within it and the scale never stops moving.
+//
+// It's best driven by the GPU's time for the frame.  A whole
+// frame's time with vsync on includes waiting for the next
+// refresh, so it only comes in whole refresh intervals; given
+// that interval, the budget is rounded to a whole number of
+// them and a frame that made its interval counts as on
+// budget.  Such times can't show any headroom, so the scale
+// then only comes down.
+// --------------------------------------------------------
+
+const unsigned int ResolutionFrameWindow = 5;	// Frames the median is taken over
+
+struct DynamicResolutionSettings
+{
+	float BudgetMs = 16.6f;		// The frame time to stay under
+	float RefreshMs = 0.0f;		// If frame times include waiting on vsync, its interval
+	float Headroom = 0.15f;		// Frames this fraction under the budget count as on it
+	float MinScale = 0.5f;		// Of the window's width and height
+	float MaxScale = 1.0f;
+	float ScaleStep = 0.05f;	// What the drawn scale snaps to, counted down from the max
+	float StepHysteresis = 0.25f;	// Of a step, past halfway, before the drawn scale moves
+
+	// The controller's gains, on the frame time's error as a
+	// fraction of the budget
+	float Proportional = 0.1f;
+	float Integral = 0.05f;
+	float Derivative = 0.02f;
+};
+
+// --------------------------------------------------------
+// A scale snapped to the nearest step down from the max,
+// within the min and max.  The min is a step of its own when
+// the steps don't land on it.
+// --------------------------------------------------------
+float QuantizeRenderScale(float scale, const DynamicResolutionSettings& settings);
+
+// How many different scales QuantizeRenderScale() can give
+unsigned int RenderScaleSteps(const DynamicResolutionSettings& settings);
+
+// --------------------------------------------------------
+// Eases the render scale towards whatever keeps the frame
+// time within its budget.  It starts at the max scale.
+// --------------------------------------------------------
+class ResolutionController
+{
+public:
+	// frameMs is the last frame's time.  Returns the scale
+	// to draw this one at, one of the quantized steps.
+	float Update(float frameMs, const DynamicResolutionSettings& settings);
+	void Reset();
+
+	float GetScale() const { return scale; }
+	float GetSmoothScale() const { return smoothScale; }
+	unsigned int GetChangeCount() const { return changes; }
+
+private:
+	bool started = false;
+	float smoothScale = 1.0f;	// The controller's own output, unsnapped
+	float scale = 1.0f;			// The step drawn at
+	float lastError = 0.0f;
+	float lastChange = 0.0f;	// Of the error, for the derivative
+	float recentMs[ResolutionFrameWindow] = {};
+	unsigned int frameCount = 0;
+	unsigned int changes = 0;	// Times the drawn step has moved
+};
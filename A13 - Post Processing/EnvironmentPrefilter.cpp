@@ -0,0 +1,514 @@
+#include "EnvironmentPrefilter.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+#include <thread>
+
+namespace
+{
+	const float Pi = 3.14159265f;
+	const float MinRoughness = 0.0000001f;	// Same floor as the shader's D_GGX
+
+	// --------------------------------------------------------
+	// Calls work(row) for every row, with threads taking the
+	// next row until there are none left.  The calling thread
+	// does its share too.
+	// --------------------------------------------------------
+	template<typename Work>
+	void ForEachRow(unsigned int rowCount, unsigned int threadCount, const Work& work)
+	{
+		if (threadCount == 0)
+			threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0)
+			threadCount = 1;
+		if (threadCount > rowCount)
+			threadCount = rowCount;
+
+		std::atomic<unsigned int> nextRow(0);
+		auto worker = [&]()
+		{
+			for (unsigned int row = nextRow++; row < rowCount; row = nextRow++)
+				work(row);
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < threadCount; i++)
+			threads.emplace_back(worker);
+		worker();
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	// The i-th of n points spread evenly over the unit square
+	void Hammersley(unsigned int i, unsigned int n, float& x, float& y)
+	{
+		unsigned int bits = i;
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+		bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+		bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+		bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+
+		x = (i + 0.5f) / n;
+		y = bits * 2.3283064365386963e-10f;	// / 2^32
+	}
+
+	// --------------------------------------------------------
+	// A half vector drawn from the GGX distribution around +Z,
+	// using the shader's roughness remap (alpha = roughness^2)
+	// --------------------------------------------------------
+	void ImportanceSampleGGX(float x, float y, float a2, float h[3])
+	{
+		float phi = 2.0f * Pi * x;
+		float cosTheta = sqrtf((1.0f - y) / (1.0f + (a2 - 1.0f) * y));
+		float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+		h[0] = sinTheta * cosf(phi);
+		h[1] = sinTheta * sinf(phi);
+		h[2] = cosTheta;
+	}
+
+	float RoughnessA2(float roughness)
+	{
+		float a = roughness * roughness;
+		return a * a > MinRoughness ? a * a : MinRoughness;
+	}
+
+	// One light direction around +Z, how much it counts and
+	// which source mip to read it from
+	struct PrefilterSample
+	{
+		float L[3];
+		float Weight;
+		float Lod;
+	};
+
+	// --------------------------------------------------------
+	// Bilinear lookup in one mip of one face, clamped at the
+	// face's edges
+	// --------------------------------------------------------
+	void SampleFace(const EnvironmentCubemap& cube, unsigned int face, unsigned int mip, float u, float v, float rgb[3])
+	{
+		unsigned int size = cube.MipSize(mip);
+		const float* texels = cube.Texel(face, mip);
+
+		float fx = (u + 1.0f) * 0.5f * size - 0.5f;
+		float fy = (v + 1.0f) * 0.5f * size - 0.5f;
+		fx = fx < 0 ? 0 : (fx > size - 1 ? (float)(size - 1) : fx);
+		fy = fy < 0 ? 0 : (fy > size - 1 ? (float)(size - 1) : fy);
+
+		unsigned int x0 = (unsigned int)fx;
+		unsigned int y0 = (unsigned int)fy;
+		unsigned int x1 = x0 + 1 < size ? x0 + 1 : x0;
+		unsigned int y1 = y0 + 1 < size ? y0 + 1 : y0;
+		float tx = fx - x0;
+		float ty = fy - y0;
+
+		const float* t00 = texels + ((size_t)y0 * size + x0) * 4;
+		const float* t10 = texels + ((size_t)y0 * size + x1) * 4;
+		const float* t01 = texels + ((size_t)y1 * size + x0) * 4;
+		const float* t11 = texels + ((size_t)y1 * size + x1) * 4;
+		for (int c = 0; c < 3; c++)
+		{
+			float top = t00[c] + (t10[c] - t00[c]) * tx;
+			float bottom = t01[c] + (t11[c] - t01[c]) * tx;
+			rgb[c] = top + (bottom - top) * ty;
+		}
+	}
+
+	// --------------------------------------------------------
+	// Bake files: a four character tag, a version, the key,
+	// two dimensions, then the floats.  Anything else (old
+	// version, different key, wrong length) is a miss.
+	// --------------------------------------------------------
+	const unsigned int BakeFileVersion = 1;
+
+	bool WriteBakeFile(const std::wstring& path, const char tag[4], unsigned long long key, unsigned int a, unsigned int b, const std::vector<float>& data)
+	{
+		std::ofstream file(std::filesystem::path(path), std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		file.write(tag, 4);
+		file.write((const char*)&BakeFileVersion, sizeof(BakeFileVersion));
+		file.write((const char*)&key, sizeof(key));
+		file.write((const char*)&a, sizeof(a));
+		file.write((const char*)&b, sizeof(b));
+		file.write((const char*)data.data(), data.size() * sizeof(float));
+		return file.good();
+	}
+
+	bool ReadBakeHeader(std::ifstream& file, const char tag[4], unsigned long long key, unsigned int& a, unsigned int& b)
+	{
+		char fileTag[4] = {};
+		unsigned int version = 0;
+		unsigned long long fileKey = 0;
+		file.read(fileTag, 4);
+		file.read((char*)&version, sizeof(version));
+		file.read((char*)&fileKey, sizeof(fileKey));
+		file.read((char*)&a, sizeof(a));
+		file.read((char*)&b, sizeof(b));
+		return file.good() && memcmp(fileTag, tag, 4) == 0 && version == BakeFileVersion && fileKey == key;
+	}
+
+	// Reads exactly data.size() floats and nothing more
+	bool ReadBakeData(std::ifstream& file, std::vector<float>& data)
+	{
+		file.read((char*)data.data(), data.size() * sizeof(float));
+		if (!file.good())
+			return false;
+		file.peek();
+		return file.eof();
+	}
+}
+
+void EnvironmentCubemap::Allocate(unsigned int size, unsigned int mipCount)
+{
+	Size = size;
+	MipCount = mipCount;
+	MipOffsets.resize(mipCount);
+
+	FaceStride = 0;
+	for (unsigned int mip = 0; mip < mipCount; mip++)
+	{
+		MipOffsets[mip] = FaceStride;
+		FaceStride += (size_t)MipSize(mip) * MipSize(mip) * 4;
+	}
+	Texels.assign(FaceStride * 6, 0.0f);
+}
+
+bool DecodeCubemap(const CubemapFace faces[6], unsigned int maxSize, EnvironmentCubemap& cube)
+{
+	unsigned int size = faces[0].Width;
+	for (int f = 0; f < 6; f++)
+	{
+		if (!faces[f].Pixels || faces[f].Width != size || faces[f].Height != size ||
+			faces[f].RowPitch < size * 4)
+			return false;
+	}
+	if (size == 0)
+		return false;
+
+	// Halve while it's too big and still divides evenly
+	unsigned int decodedSize = size;
+	while (decodedSize > maxSize && decodedSize % 2 == 0)
+		decodedSize /= 2;
+	unsigned int block = size / decodedSize;
+
+	unsigned int mipCount = 1;
+	while (decodedSize >> mipCount)
+		mipCount++;
+	cube.Allocate(decodedSize, mipCount);
+
+	float toLinear[256];
+	for (int i = 0; i < 256; i++)
+		toLinear[i] = powf(i / 255.0f, 2.2f);
+
+	// Mip 0, averaging a block of the original per texel
+	float blockScale = 1.0f / (block * block);
+	ForEachRow(6 * decodedSize, 0, [&](unsigned int row)
+	{
+		const CubemapFace& face = faces[row / decodedSize];
+		unsigned int y = row % decodedSize;
+		const int red = face.BGRA ? 2 : 0;
+		const int blue = face.BGRA ? 0 : 2;
+
+		float* out = cube.Texel(row / decodedSize, 0) + (size_t)y * decodedSize * 4;
+		for (unsigned int x = 0; x < decodedSize; x++, out += 4)
+		{
+			float sum[3] = {};
+			for (unsigned int by = 0; by < block; by++)
+			{
+				const unsigned char* texel = face.Pixels + (size_t)(y * block + by) * face.RowPitch + (size_t)x * block * 4;
+				for (unsigned int bx = 0; bx < block; bx++, texel += 4)
+				{
+					sum[0] += toLinear[texel[red]];
+					sum[1] += toLinear[texel[1]];
+					sum[2] += toLinear[texel[blue]];
+				}
+			}
+			out[0] = sum[0] * blockScale;
+			out[1] = sum[1] * blockScale;
+			out[2] = sum[2] * blockScale;
+			out[3] = 1.0f;
+		}
+	});
+
+	// The rest of the chain, 2x2 at a time (odd sizes drop
+	// their last row and column)
+	for (unsigned int mip = 1; mip < mipCount; mip++)
+	{
+		unsigned int mipSize = cube.MipSize(mip);
+		unsigned int parentSize = cube.MipSize(mip - 1);
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			const float* parent = cube.Texel(face, mip - 1);
+			float* out = cube.Texel(face, mip);
+			for (unsigned int y = 0; y < mipSize; y++)
+			{
+				for (unsigned int x = 0; x < mipSize; x++, out += 4)
+				{
+					const float* a = parent + ((size_t)(y * 2) * parentSize + x * 2) * 4;
+					const float* b = a + (size_t)parentSize * 4;
+					for (int c = 0; c < 4; c++)
+						out[c] = (a[c] + a[c + 4] + b[c] + b[c + 4]) * 0.25f;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void SampleCubemap(const EnvironmentCubemap& cube, const float dir[3], float lod, float rgb[3])
+{
+	float u, v;
+	unsigned int face = CubemapFaceUV(dir, u, v);
+
+	float maxLod = (float)(cube.MipCount - 1);
+	lod = lod < 0 ? 0 : (lod > maxLod ? maxLod : lod);
+	unsigned int mip = (unsigned int)lod;
+	float blend = lod - mip;
+
+	SampleFace(cube, face, mip, u, v, rgb);
+	if (blend > 0 && mip + 1 < cube.MipCount)
+	{
+		float next[3];
+		SampleFace(cube, face, mip + 1, u, v, next);
+		for (int c = 0; c < 3; c++)
+			rgb[c] += (next[c] - rgb[c]) * blend;
+	}
+}
+
+float SpecularMipRoughness(unsigned int mip, unsigned int mipCount)
+{
+	return mipCount > 1 ? (float)mip / (mipCount - 1) : 0.0f;
+}
+
+bool PrefilterSpecular(
+	const EnvironmentCubemap& source,
+	unsigned int size,
+	unsigned int mipCount,
+	unsigned int sampleCount,
+	EnvironmentCubemap& result,
+	unsigned int threadCount)
+{
+	if (source.Size == 0 || size == 0 || sampleCount == 0)
+		return false;
+
+	unsigned int maxMips = 1;
+	while (size >> maxMips)
+		maxMips++;
+	if (mipCount == 0 || mipCount > maxMips)
+		mipCount = maxMips;
+	result.Allocate(size, mipCount);
+
+	// --------------------------------------------------------
+	// The samples only depend on roughness, so each mip's are
+	// made once, around +Z, and turned to face each texel.
+	// With the view along the normal, a sample's pdf is just
+	// D / 4; the rarer it is, the more of the environment it
+	// stands for, and the blurrier the mip it reads.
+	// --------------------------------------------------------
+	float texelSolidAngle = 4.0f * Pi / (6.0f * source.Size * source.Size);
+	std::vector<std::vector<PrefilterSample>> samples(mipCount);
+	std::vector<float> totalWeights(mipCount, 0.0f);
+	for (unsigned int mip = 1; mip < mipCount; mip++)
+	{
+		float a2 = RoughnessA2(SpecularMipRoughness(mip, mipCount));
+		for (unsigned int i = 0; i < sampleCount; i++)
+		{
+			float x, y, h[3];
+			Hammersley(i, sampleCount, x, y);
+			ImportanceSampleGGX(x, y, a2, h);
+
+			PrefilterSample sample;
+			sample.L[0] = 2.0f * h[2] * h[0];
+			sample.L[1] = 2.0f * h[2] * h[1];
+			sample.L[2] = 2.0f * h[2] * h[2] - 1.0f;
+			sample.Weight = sample.L[2];
+			if (sample.Weight <= 0)
+				continue;
+
+			float denom = h[2] * h[2] * (a2 - 1.0f) + 1.0f;
+			float pdf = a2 / (Pi * denom * denom) * 0.25f;
+			float sampleSolidAngle = 1.0f / (sampleCount * pdf + 0.0001f);
+			sample.Lod = 0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f;
+
+			samples[mip].push_back(sample);
+			totalWeights[mip] += sample.Weight;
+		}
+	}
+
+	// Mip 0 is a mirror, so it's the source at the right size
+	float mirrorLod = log2f((float)source.Size / size);
+
+	// Rows of every mip of every face, biggest mips first so
+	// the last rows handed out are the quick ones
+	std::vector<unsigned int> rowMip;
+	std::vector<unsigned int> rowIndex;
+	for (unsigned int mip = 0; mip < mipCount; mip++)
+	{
+		for (unsigned int row = 0; row < 6 * result.MipSize(mip); row++)
+		{
+			rowMip.push_back(mip);
+			rowIndex.push_back(row);
+		}
+	}
+
+	ForEachRow((unsigned int)rowMip.size(), threadCount, [&](unsigned int item)
+	{
+		unsigned int mip = rowMip[item];
+		unsigned int mipSize = result.MipSize(mip);
+		unsigned int face = rowIndex[item] / mipSize;
+		unsigned int y = rowIndex[item] % mipSize;
+		float v = (y + 0.5f) * 2.0f / mipSize - 1.0f;
+
+		float* out = result.Texel(face, mip) + (size_t)y * mipSize * 4;
+		for (unsigned int x = 0; x < mipSize; x++, out += 4)
+		{
+			float n[3];
+			CubemapDirection(face, (x + 0.5f) * 2.0f / mipSize - 1.0f, v, n);
+			out[3] = 1.0f;
+
+			if (mip == 0)
+			{
+				SampleCubemap(source, n, mirrorLod, out);
+				continue;
+			}
+
+			// Tangent space around the normal
+			float up[3] = { 0, 0, 1 };
+			if (fabsf(n[2]) > 0.999f)
+			{
+				up[0] = 1;
+				up[2] = 0;
+			}
+			float t[3] = { up[1] * n[2] - up[2] * n[1], up[2] * n[0] - up[0] * n[2], up[0] * n[1] - up[1] * n[0] };
+			float tLength = 1.0f / sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+			t[0] *= tLength;
+			t[1] *= tLength;
+			t[2] *= tLength;
+			float b[3] = { n[1] * t[2] - n[2] * t[1], n[2] * t[0] - n[0] * t[2], n[0] * t[1] - n[1] * t[0] };
+
+			float sum[3] = {};
+			for (const PrefilterSample& sample : samples[mip])
+			{
+				float l[3];
+				for (int i = 0; i < 3; i++)
+					l[i] = t[i] * sample.L[0] + b[i] * sample.L[1] + n[i] * sample.L[2];
+
+				float rgb[3];
+				SampleCubemap(source, l, sample.Lod, rgb);
+				sum[0] += rgb[0] * sample.Weight;
+				sum[1] += rgb[1] * sample.Weight;
+				sum[2] += rgb[2] * sample.Weight;
+			}
+
+			float scale = totalWeights[mip] > 0 ? 1.0f / totalWeights[mip] : 0.0f;
+			out[0] = sum[0] * scale;
+			out[1] = sum[1] * scale;
+			out[2] = sum[2] * scale;
+		}
+	});
+	return true;
+}
+
+// --------------------------------------------------------
+// Integrates the specular BRDF (with Fresnel split into a
+// scale and bias on F0) over the GGX lobe.  Smith's G uses
+// the k = alpha / 2 remap meant for image based light, not
+// the (roughness + 1)^2 / 8 the shader uses for lights.
+// --------------------------------------------------------
+void IntegrateBrdfLut(unsigned int size, unsigned int sampleCount, BrdfLut& lut, unsigned int threadCount)
+{
+	lut.Size = size;
+	lut.Texels.assign((size_t)size * size * 2, 0.0f);
+	if (size == 0 || sampleCount == 0)
+		return;
+
+	ForEachRow(size, threadCount, [&](unsigned int y)
+	{
+		float roughness = (y + 0.5f) / size;
+		float a2 = RoughnessA2(roughness);
+		float k = roughness * roughness * 0.5f;
+
+		float* out = lut.Texels.data() + (size_t)y * size * 2;
+		for (unsigned int x = 0; x < size; x++, out += 2)
+		{
+			float NdotV = (x + 0.5f) / size;
+			float view[3] = { sqrtf(1.0f - NdotV * NdotV), 0.0f, NdotV };
+			float G1V = NdotV / (NdotV * (1.0f - k) + k);
+
+			float scale = 0.0f;
+			float bias = 0.0f;
+			for (unsigned int i = 0; i < sampleCount; i++)
+			{
+				float hx, hy, h[3];
+				Hammersley(i, sampleCount, hx, hy);
+				ImportanceSampleGGX(hx, hy, a2, h);
+
+				float VdotH = view[0] * h[0] + view[1] * h[1] + view[2] * h[2];
+				float NdotL = 2.0f * VdotH * h[2] - view[2];
+				if (NdotL <= 0 || VdotH <= 0)
+					continue;
+
+				float G = G1V * NdotL / (NdotL * (1.0f - k) + k);
+				float visibility = G * VdotH / (h[2] * NdotV);
+				float fresnel = powf(1.0f - VdotH, 5.0f);
+				scale += (1.0f - fresnel) * visibility;
+				bias += fresnel * visibility;
+			}
+			out[0] = scale / sampleCount;
+			out[1] = bias / sampleCount;
+		}
+	});
+}
+
+bool SaveEnvironmentCubemap(const std::wstring& path, unsigned long long key, const EnvironmentCubemap& cube)
+{
+	return WriteBakeFile(path, "ENVC", key, cube.Size, cube.MipCount, cube.Texels);
+}
+
+bool LoadEnvironmentCubemap(const std::wstring& path, unsigned long long key, EnvironmentCubemap& cube)
+{
+	std::ifstream file(std::filesystem::path(path), std::ios::binary);
+	unsigned int size = 0;
+	unsigned int mipCount = 0;
+	if (!file.is_open() || !ReadBakeHeader(file, "ENVC", key, size, mipCount) ||
+		size == 0 || size > 16384 || mipCount == 0 || size >> (mipCount - 1) == 0)
+		return false;
+
+	EnvironmentCubemap loaded;
+	loaded.Allocate(size, mipCount);
+	if (!ReadBakeData(file, loaded.Texels))
+		return false;
+
+	cube = std::move(loaded);
+	return true;
+}
+
+bool SaveBrdfLut(const std::wstring& path, unsigned long long key, const BrdfLut& lut)
+{
+	return WriteBakeFile(path, "BRDF", key, lut.Size, 2, lut.Texels);
+}
+
+bool LoadBrdfLut(const std::wstring& path, unsigned long long key, BrdfLut& lut)
+{
+	std::ifstream file(std::filesystem::path(path), std::ios::binary);
+	unsigned int size = 0;
+	unsigned int channels = 0;
+	if (!file.is_open() || !ReadBakeHeader(file, "BRDF", key, size, channels) ||
+		size == 0 || size > 4096 || channels != 2)
+		return false;
+
+	BrdfLut loaded;
+	loaded.Size = size;
+	loaded.Texels.resize((size_t)size * size * 2);
+	if (!ReadBakeData(file, loaded.Texels))
+		return false;
+
+	lut = std::move(loaded);
+	return true;
+}
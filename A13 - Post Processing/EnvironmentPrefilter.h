@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "SphericalHarmonics.h"
+
+// --------------------------------------------------------
+// A cubemap of linear RGBA floats and its mips, in the order
+// D3D wants initial data: each face's whole mip chain, then
+// the next face's (subresource = face * MipCount + mip).
+// --------------------------------------------------------
+struct EnvironmentCubemap
+{
+	unsigned int Size = 0;		// Width and height of mip 0
+	unsigned int MipCount = 0;
+	std::vector<float> Texels;
+
+	// Where each mip of face 0 starts, and how far apart the
+	// faces are, in floats.  Filled by Allocate().
+	std::vector<size_t> MipOffsets;
+	size_t FaceStride = 0;
+
+	unsigned int MipSize(unsigned int mip) const { return Size >> mip ? Size >> mip : 1; }
+	size_t Offset(unsigned int face, unsigned int mip) const { return face * FaceStride + MipOffsets[mip]; }
+	float* Texel(unsigned int face, unsigned int mip) { return Texels.data() + Offset(face, mip); }
+	const float* Texel(unsigned int face, unsigned int mip) const { return Texels.data() + Offset(face, mip); }
+
+	// Sizes Texels for the face size and mip count, all zero
+	void Allocate(unsigned int size, unsigned int mipCount);
+};
+
+// --------------------------------------------------------
+// Decodes 8-bit faces (2.2 gamma, as the shaders use) into
+// linear floats, box filtered down to at most maxSize (a
+// 2048 face would be 400MB as floats), then on down to 1x1.
+// Returns false if the faces aren't square and the same size.
+// --------------------------------------------------------
+bool DecodeCubemap(const CubemapFace faces[6], unsigned int maxSize, EnvironmentCubemap& cube);
+
+// Trilinear lookup along a unit direction, like
+// TextureCube.SampleLevel() (minus filtering across faces)
+void SampleCubemap(const EnvironmentCubemap& cube, const float dir[3], float lod, float rgb[3]);
+
+// --------------------------------------------------------
+// The split sum's first half: the environment convolved with
+// the GGX lobe, one roughness per mip, going linearly from 0
+// at mip 0 to 1 at the last.  A shader picks its mip with
+// roughness * (mipCount - 1).
+//
+// Each texel takes sampleCount GGX importance samples
+// (assuming the view is along the normal), read from the
+// source mip that matches each sample's solid angle so a few
+// hundred samples come out without speckles.  Rows of every
+// face and mip are spread over threadCount threads (0 for
+// one per core).
+// --------------------------------------------------------
+bool PrefilterSpecular(
+	const EnvironmentCubemap& source,
+	unsigned int size,
+	unsigned int mipCount,
+	unsigned int sampleCount,
+	EnvironmentCubemap& result,
+	unsigned int threadCount = 0);
+
+float SpecularMipRoughness(unsigned int mip, unsigned int mipCount);
+
+// --------------------------------------------------------
+// The split sum's second half: how much of the prefiltered
+// light reflects, as F0 * R + G, for N dot V along x and
+// roughness along y (texel centers, so sample it with a
+// clamping sampler).  Texels are RG pairs.
+// --------------------------------------------------------
+struct BrdfLut
+{
+	unsigned int Size = 0;
+	std::vector<float> Texels;
+};
+
+void IntegrateBrdfLut(unsigned int size, unsigned int sampleCount, BrdfLut& lut, unsigned int threadCount = 0);
+
+// Kept on disk under a key, like SaveSH()/LoadSH(); loading
+// fails if the key or anything about the file is off
+bool SaveEnvironmentCubemap(const std::wstring& path, unsigned long long key, const EnvironmentCubemap& cube);
+bool LoadEnvironmentCubemap(const std::wstring& path, unsigned long long key, EnvironmentCubemap& cube);
+bool SaveBrdfLut(const std::wstring& path, unsigned long long key, const BrdfLut& lut);
+bool LoadBrdfLut(const std::wstring& path, unsigned long long key, BrdfLut& lut);
@@ -7,6 +7,11 @@
 
 #define MAX_SPECULAR_EXPONENT 256.0f
 
+// Shadow cascades (see ShadowCascades.h), and how many tiles
+// of the shadow atlas the shaders can read (see ShadowAtlas.h)
+#define SHADOW_CASCADES 4
+#define MAX_SHADOW_TILES 24
+
 // Struct representing a single vertex worth of data
 // - This should match the vertex definition in our C++ code
 // - By "match", I mean the size, order and number of members
@@ -23,6 +28,7 @@ struct VertexShaderInput
     float2 uv : TEXCOORD; // UV position
     float3 normal : NORMAL; // Normal position
     float3 tangent : TANGENT; // Tangent vector
+    float4 occlusion : OCCLUSION_BAKED; // Bent normal and AO, from Mesh's second stream
 };
 
 // Struct to hold lighting data
@@ -36,7 +42,24 @@ struct Light
     float3 Color; // All lights need a color
     float SpotInnerAngle; // Inner cone angle (in radians)  Inside this, full light!
     float SpotOuterAngle; // Outer cone angle (radians)  Outside this, no light!
-    float2 Padding; // Purposefully padding to hit the 16-byte boundary
+    int ShadowTile; // First of its tiles in the shadow atlas, or -1 for none
+    float Padding; // Purposefully padding to hit the 16-byte boundary
+};
+
+// Data that's the same for every draw in a frame
+// - Filled once per frame by a SharedConstantBuffer in C++
+// - Any shader that includes this file and reads from it gets it in b0
+// - b1 is per material data, b2 is per object data
+cbuffer PerFrame : register(b0)
+{
+    matrix view;
+    matrix projection;
+    float4 cascadeSplits; // View depth each cascade ends at
+    float3 cameraPosition;
+    float cascadeBlend; // Share of each cascade's far depth faded into the next
+    float3 ambient;
+    Light lights[5];
+    float4 irradianceSH[9]; // Diffuse light from the sky, see SkyIrradiance()
 };
 
 // Struct representing the data we're sending down the pipeline 
@@ -54,7 +77,7 @@ struct VertexToPixel
     float3 normal : NORMAL;
     float3 worldPosition : POSITION;
     float3 tangent : TANGENT;
-    float4 shadowMapPosition : SHADOW_POSITION;
+    float4 occlusion : OCCLUSION; // World space bent normal (xyz), ambient occlusion (w)
 };
 
 // Struct representing the data we're sending down the pipeline for the Skybox
@@ -10,9 +10,16 @@
 #include "SimpleShader.h"
 #include "Material.h"
 #include "Sky.h"
+#include "ConstantBuffer.h"
+#include "ShaderStructs.h"
+#include "ClusteredLights.h"
+#include "Bloom.h"
+#include "AutoExposure.h"
 
 #include "WICTextureLoader.h"
 #include <DirectXMath.h>
+#include <random>
+#include <algorithm>
 
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
@@ -35,10 +42,7 @@ int selectedStarter = -1; // Index of chosen name
 float windowColor[4] = {0.4f, 0.6f, 0.75f, 1.0f}; // Color Vector
 float clearColor[4] = {0.0f, 0.0f, 0.0f, 1.0f}; // Color Vector
 bool stopConfirmation = 0;
-std::vector<float> shadowResolution = { 8192.0f, 8192.0f };
-bool usePP;
-float blurRad = 0.0f;
-int pixelation = 1000.0f;
+bool captureTrace = false; // Record the next frame to a trace file
 
 // Cameras
 std::shared_ptr<Camera> activeCamera;
@@ -60,8 +64,72 @@ std::vector<std::shared_ptr<Material>> materials;
 std::vector<std::shared_ptr<Mesh>> meshes;
 std::shared_ptr<Sky> skybox;
 XMFLOAT3 ambientColor = { 0.5f, 0.5f, 0.5f };
+bool useSkyIrradiance = true;	// Tint ambient by the sky's baked diffuse light
+bool useSpecularIBL = true;		// Reflect the sky's prefiltered cubemap
+bool useBakedOcclusion = true;	// Darken ambient and reflections by each mesh's baked AO
 std::shared_ptr<SimpleVertexShader> shadowVS;
 
+// Camera, light and ambient data shared by every shader, filled once per frame
+std::shared_ptr<ConstantBuffer<PerFrameConstants>> frameConstants;
+
+// Matrices for whatever is being drawn, refilled every draw
+std::shared_ptr<ConstantBuffer<PerObjectConstants>> objectConstants;
+
+// The tile of the shadow atlas being rendered, refilled for each one
+std::shared_ptr<ConstantBuffer<ShadowPassConstants>> shadowPassConstants;
+
+// Every tile of the shadow atlas, for the lighting shader to sample
+std::shared_ptr<ConstantBuffer<ShadowAtlasConstants>> shadowAtlasConstants;
+
+// The post process chain's effects, by index (see CreatePostEffects())
+enum PostEffectIndex { PostBloom, PostPixelate, PostBlur, PostVignette, PostGrade, PostEffectCount };
+
+// Bloom's settings, by index in its Params
+enum BloomParam { BloomIntensity, BloomThreshold, BloomSpread };
+
+// And the color grade's
+enum GradeParam { GradeCurve, GradeWhitePoint, GradeTintRed, GradeTintGreen, GradeTintBlue, GradeSaturation, GradeContrast, GradeGamma };
+
+// Bits for each effect the fused pass draws (POST_ in PostFusedPixelShader.hlsl)
+const int PostFusedPixelate = 1;
+const int PostFusedVignette = 2;
+const int PostFusedGrade = 4;
+
+// The blur's taps and direction, refilled for each of its passes,
+// and the settings of whichever effects are fused into a pass
+std::shared_ptr<ConstantBuffer<BlurPassConstants>> blurConstants;
+std::shared_ptr<ConstantBuffer<PostFusedConstants>> postFusedConstants;
+
+// Bloom's step down or up the pyramid, refilled for each pass
+std::shared_ptr<ConstantBuffer<BloomDownsampleConstants>> bloomDownsampleConstants;
+std::shared_ptr<ConstantBuffer<BloomUpsampleConstants>> bloomUpsampleConstants;
+
+// The scene's luminance is measured at this size for the
+// exposure, and read back this many frames after it's drawn
+const unsigned int LuminanceWidth = 128;
+const unsigned int LuminanceHeight = 64;
+const unsigned int LuminanceReadbackFrames = 3;
+std::shared_ptr<ConstantBuffer<LuminanceConstants>> luminanceConstants;
+
+// Materials using the PBR lighting shader get variants of it
+// specialized to the scene's lights and their own textures
+std::shared_ptr<SimplePixelShader> lightingPS;
+std::vector<std::shared_ptr<Material>> lightingMaterials;
+ShaderPermutationKey sceneLights;	// Light counts the variants were made for
+bool useShaderVariants = true;
+
+// Lights beyond the five the PerFrame cbuffer holds, binned
+// into clusters so each pixel only pays for the ones near it
+std::shared_ptr<ClusteredLights> clusteredLights;
+std::vector<Light> extraLights;
+bool useClusteredLights = false;
+int extraLightCount = 0;
+
+unsigned long long frameUploadStart = 0;
+unsigned long long lastFrameUploadBytes = 0;
+unsigned long long frameSkipStart = 0;
+unsigned long long lastFrameSkips = 0;
+
 // --------------------------------------------------------
 // Called once per program, after the window and graphics API
 // are initialized but before the game loop begins
@@ -69,48 +137,79 @@ std::shared_ptr<SimpleVertexShader> shadowVS;
 void Game::Initialize()
 {
 	// Initialize ImGui itself & platform/renderer backends
+	// - Headless runs have no window or real device for it
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
-	ImGui_ImplWin32_Init(Window::Handle());
-	ImGui_ImplDX11_Init(Graphics::Device.Get(), Graphics::Context.Get());
+	if (!Graphics::IsHeadless())
+	{
+		ImGui_ImplWin32_Init(Window::Handle());
+		ImGui_ImplDX11_Init(Graphics::Device.Get(), Graphics::Context.Get());
+	}
 
 	// Load Textures and Sampler State
-	CreateWICTextureFromFile(Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		L"Assets/Textures/ice_color.jpg",
-		nullptr,
-		&iceSRV);
-
-	// Bronze
-	CreateWICTextureFromFile(Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		L"Assets/Textures/bronze_albedo.png",
-		nullptr,
-		&bronzeSRV);
-	CreateWICTextureFromFile(Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		L"Assets/Textures/bronze_normals.png",
-		nullptr,
-		&normalSRV);
-	CreateWICTextureFromFile(Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		L"Assets/Textures/bronze_roughness.png",
-		nullptr,
-		&roughSRV);
-	CreateWICTextureFromFile(Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		L"Assets/Textures/bronze_metal.png",
-		nullptr,
-		&metalSRV);
+	// - The WIC loader needs a real device, so headless runs
+	//   leave these null (which binds as "no texture")
+	if (!Graphics::IsHeadless())
+	{
+		CreateWICTextureFromFile(Graphics::Device.Get(),
+			Graphics::Context.Get(),
+			L"Assets/Textures/ice_color.jpg",
+			nullptr,
+			&iceSRV);
+
+		// Bronze
+		CreateWICTextureFromFile(Graphics::Device.Get(),
+			Graphics::Context.Get(),
+			L"Assets/Textures/bronze_albedo.png",
+			nullptr,
+			&bronzeSRV);
+		CreateWICTextureFromFile(Graphics::Device.Get(),
+			Graphics::Context.Get(),
+			L"Assets/Textures/bronze_normals.png",
+			nullptr,
+			&normalSRV);
+		CreateWICTextureFromFile(Graphics::Device.Get(),
+			Graphics::Context.Get(),
+			L"Assets/Textures/bronze_roughness.png",
+			nullptr,
+			&roughSRV);
+		CreateWICTextureFromFile(Graphics::Device.Get(),
+			Graphics::Context.Get(),
+			L"Assets/Textures/bronze_metal.png",
+			nullptr,
+			&metalSRV);
+	}
+
+	// Shaders put their constant data in the shared ring, when there is one
+	ISimpleShader::BufferRing = Graphics::ConstantRing;
+
+	// Dynamic resolution goes by the GPU's time for each frame,
+	// and aims for the display's refresh interval
+	gpuFrameTimer = std::make_shared<GpuFrameTimer>(Graphics::GfxDevice, Graphics::GfxContext);
+	DEVMODE displayMode = {};
+	displayMode.dmSize = sizeof(displayMode);
+	if (!Graphics::IsHeadless() && EnumDisplaySettings(0, ENUM_CURRENT_SETTINGS, &displayMode) && displayMode.dmDisplayFrequency > 1)
+	{
+		refreshMs = 1000.0f / displayMode.dmDisplayFrequency;
+		resolutionSettings.BudgetMs = refreshMs;
+	}
 
 	// Create Shadow Map Texture and Bind it to the Pipeline
-	shadowVS = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"ShadowMapVertexShader.cso").c_str());
+	shadowVS = Graphics::Shaders->GetVertexShader(FixPath(L"ShadowMapVertexShader.cso"));
+	shadowCopyPS = Graphics::Shaders->GetPixelShader(FixPath(L"ShadowCopyPixelShader.cso"));
+	shadowClearPS = Graphics::Shaders->GetPixelShader(FixPath(L"ShadowClearPixelShader.cso"));
 	Game::CreateShadowMap();
 
 	// Create Post Process Resources
-	ppVS = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"FullscreenVertexShader.cso").c_str());
-	ppPS = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"PPPixelShader.cso").c_str());
+	ppVS = Graphics::Shaders->GetVertexShader(FixPath(L"FullscreenVertexShader.cso"));
+	renderTargets = std::make_shared<RenderTargetPool>(Graphics::GfxDevice);
+	blurPS = Graphics::Shaders->GetPixelShader(FixPath(L"BlurPixelShader.cso"));
+	postFusedPS = Graphics::Shaders->GetPixelShader(FixPath(L"PostFusedPixelShader.cso"));
+	bloomDownsamplePS = Graphics::Shaders->GetPixelShader(FixPath(L"BloomDownsamplePixelShader.cso"));
+	bloomUpsamplePS = Graphics::Shaders->GetPixelShader(FixPath(L"BloomUpsamplePixelShader.cso"));
+	luminancePS = Graphics::Shaders->GetPixelShader(FixPath(L"LuminancePixelShader.cso"));
 	CreatePPResources();
+	CreatePostEffects();
 
 	// Create Texture sampler for models
 	samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
@@ -120,7 +219,7 @@ void Game::Initialize()
 	samplerDesc.MaxAnisotropy = 16;
 	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-	Graphics::Device->CreateSamplerState(&samplerDesc, samplerState.GetAddressOf());
+	Graphics::GfxDevice->CreateSamplerState(&samplerDesc, samplerState.GetAddressOf());
 
 	// Dark Color Style
 	ImGui::StyleColorsDark();
@@ -138,12 +237,12 @@ void Game::Initialize()
 	activeCamera = cameras.at(0);
 
 	//Create lights
-	lightProjectionSize = 0.0f;
 	CreateLights();
 
 	// Create Skybox
-	skybox = std::make_shared<Sky>(Sky(std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"SkyVertexShader.cso").c_str()),
-		std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"SkyPixelShader.cso").c_str()),
+	std::shared_ptr<SimpleVertexShader> skyVS = Graphics::Shaders->GetVertexShader(FixPath(L"SkyVertexShader.cso"));
+	skybox = std::make_shared<Sky>(Sky(skyVS,
+		Graphics::Shaders->GetPixelShader(FixPath(L"SkyPixelShader.cso")),
 		meshes[0], samplerState, 
 		FixPath(L"../../Assets/Skyboxes/right.png").c_str(),
 		FixPath(L"../../Assets/Skyboxes/left.png").c_str(),
@@ -157,6 +256,43 @@ void Game::Initialize()
 	//  - You'll be expanding and/or replacing these later
 	CreateGeometry();
 
+	// Share one per frame and one per object buffer between
+	// every shader that reads them
+	frameConstants = std::make_shared<ConstantBuffer<PerFrameConstants>>(Graphics::GfxDevice, Graphics::GfxContext);
+	objectConstants = std::make_shared<ConstantBuffer<PerObjectConstants>>(Graphics::GfxDevice, Graphics::GfxContext);
+	shadowPassConstants = std::make_shared<ConstantBuffer<ShadowPassConstants>>(Graphics::GfxDevice, Graphics::GfxContext);
+	shadowAtlasConstants = std::make_shared<ConstantBuffer<ShadowAtlasConstants>>(Graphics::GfxDevice, Graphics::GfxContext);
+	clusteredLights = std::make_shared<ClusteredLights>(Graphics::GfxDevice, Graphics::GfxContext);
+	for (auto& m : materials)
+	{
+		frameConstants->BindTo(m->GetVS());
+		frameConstants->BindTo(m->GetPS());
+		shadowAtlasConstants->BindTo(m->GetPS());
+		objectConstants->BindTo(m->GetVS());
+	}
+	frameConstants->BindTo(skyVS);
+	objectConstants->BindTo(shadowVS);
+	shadowPassConstants->BindTo(shadowVS);
+	blurConstants = std::make_shared<ConstantBuffer<BlurPassConstants>>(Graphics::GfxDevice, Graphics::GfxContext);
+	postFusedConstants = std::make_shared<ConstantBuffer<PostFusedConstants>>(Graphics::GfxDevice, Graphics::GfxContext);
+	blurConstants->BindTo(blurPS);
+	postFusedConstants->BindTo(postFusedPS);
+	bloomDownsampleConstants = std::make_shared<ConstantBuffer<BloomDownsampleConstants>>(Graphics::GfxDevice, Graphics::GfxContext);
+	bloomUpsampleConstants = std::make_shared<ConstantBuffer<BloomUpsampleConstants>>(Graphics::GfxDevice, Graphics::GfxContext);
+	bloomDownsampleConstants->BindTo(bloomDownsamplePS);
+	bloomUpsampleConstants->BindTo(bloomUpsamplePS);
+	luminanceConstants = std::make_shared<ConstantBuffer<LuminanceConstants>>(Graphics::GfxDevice, Graphics::GfxContext);
+	luminanceConstants->BindTo(luminancePS);
+	UpdateBlurKernel(true);
+
+	// Variants are picked once the first frame knows its lights
+	lightingPS = Graphics::Shaders->GetPixelShader(FixPath(L"PixelShader.cso"));
+	for (auto& m : materials)
+	{
+		if (m->GetPS() == lightingPS)
+			lightingMaterials.push_back(m);
+	}
+
 	// Set initial graphics API state
 	//  - These settings persist until we change them
 	//  - Some of these, like the primitive topology & input layout, probably won't change
@@ -165,7 +301,7 @@ void Game::Initialize()
 		// Tell the input assembler (IA) stage of the pipeline what kind of
 		// geometric primitives (points, lines or triangles) we want to draw.  
 		// Essentially: "What kind of shape should the GPU draw with our vertices?"
-		Graphics::Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		Graphics::GfxContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	}
 }
 
@@ -179,8 +315,11 @@ void Game::Initialize()
 Game::~Game()
 {
 	// ImGui clean up
-	ImGui_ImplDX11_Shutdown();
-	ImGui_ImplWin32_Shutdown();
+	if (!Graphics::IsHeadless())
+	{
+		ImGui_ImplDX11_Shutdown();
+		ImGui_ImplWin32_Shutdown();
+	}
 	ImGui::DestroyContext();
 }
 
@@ -203,20 +342,20 @@ void Game::CreateGeometry()
 	//  - Once you start applying different shaders to different objects,
 	//    these calls will need to happen multiple times per frame
 	materials.push_back(std::make_shared<Material>(Material(white,
-		std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"VertexShader.cso").c_str()),
-		std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"PixelShader.cso").c_str()),
+		Graphics::Shaders->GetVertexShader(FixPath(L"VertexShader.cso")),
+		Graphics::Shaders->GetPixelShader(FixPath(L"PixelShader.cso")),
 		0.5f)));
 	materials.push_back(std::make_shared<Material>(Material(yellow,
-		std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"VertexShader.cso").c_str()),
-		std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"UVPixelShader.cso").c_str()),
+		Graphics::Shaders->GetVertexShader(FixPath(L"VertexShader.cso")),
+		Graphics::Shaders->GetPixelShader(FixPath(L"UVPixelShader.cso")),
 		0.5f)));
 	materials.push_back(std::make_shared<Material>(Material(purple,
-		std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"VertexShader.cso").c_str()),
-		std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"NormalPixelShader.cso").c_str()),
+		Graphics::Shaders->GetVertexShader(FixPath(L"VertexShader.cso")),
+		Graphics::Shaders->GetPixelShader(FixPath(L"NormalPixelShader.cso")),
 		1.0f)));
 	materials.push_back(std::make_shared<Material>(Material(yellow,
-		std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"VertexShader.cso").c_str()),
-		std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"PixelShader.cso").c_str()),
+		Graphics::Shaders->GetVertexShader(FixPath(L"VertexShader.cso")),
+		Graphics::Shaders->GetPixelShader(FixPath(L"PixelShader.cso")),
 		1.0f)));
 
 	materials[0].get()->AddTextureSRV("Albedo", bronzeSRV);
@@ -238,9 +377,11 @@ void Game::CreateGeometry()
 	AddObjects(materials[0], -1.5);
 
 	// Floor
+	// - Only ever shadowed, it's double sided and would shadow itself
 	models->push_back(GameEntity(meshes[4], materials[3]));
 	models->at((int)models->size() - 1).GetTransform()->SetPosition(XMFLOAT3(0.0, -3.0f, 0.0));
 	models->at((int)models->size() - 1).GetTransform()->SetScale(XMFLOAT3(15.0f, 1.0f, 15.0f));
+	models->at((int)models->size() - 1).SetCastsShadows(false);
 
 
 	// Bottom Row with Fancy Shader
@@ -260,7 +401,7 @@ void Game::OnResize()
 		}
 	}
 
-	if (Graphics::Device != NULL) {
+	if (renderTargets) {
 		ResetScreenTargets();
 	}
 	
@@ -272,7 +413,8 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
-	ImGuiRefresh(deltaTime);
+	if (!Graphics::IsHeadless())
+		ImGuiRefresh(deltaTime);
 
 	// Update Camera
 	activeCamera->Update(deltaTime);
@@ -292,118 +434,270 @@ void Game::Draw(float deltaTime, float totalTime)
 	// - These things should happen ONCE PER FRAME
 	// - At the beginning of Game::Draw() before drawing *anything*
 	{
+		// Record every call this frame if a capture was requested
+		if (captureTrace)
+			Graphics::Recorder->BeginCapture();
+
+		// Constant data from here on goes into a fresh frame of the ring
+		if (Graphics::ConstantRing)
+			Graphics::ConstantRing->BeginFrame();
+		frameUploadStart = ISimpleShader::UploadedBytes;
+
+		// Reads back earlier frames' GPU times, and starts this one's
+		gpuFrameTimer->BeginFrame();
+		frameSkipStart = ISimpleShader::SkippedUploads;
+
 		// Clear the back buffer (erase what's on screen) and depth buffer
-		Graphics::Context->ClearRenderTargetView(Graphics::BackBufferRTV.Get(),	windowColor);
-		Graphics::Context->ClearDepthStencilView(Graphics::DepthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-		Graphics::Context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		Graphics::GfxContext->ClearRenderTargetView(Graphics::BackBufferRTV.Get(),	windowColor);
+		Graphics::GfxContext->ClearDepthStencilView(Graphics::DepthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
 	}
 
+	// The size the scene is drawn at this frame
+	UpdateRenderSize(deltaTime);
+
 	// Draw Shadows
-	// Set output merger
+	// - Each cascade's tile of the atlas is filled by copying in
+	//   its cached static depth, and every other tile is cleared
+	//   by a draw, so the atlas itself is never cleared
 	ID3D11RenderTargetView* nullRTV = {};
-	Graphics::Context->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get());
-
-	// Set new viewport
 	D3D11_VIEWPORT viewport = {};
-	viewport.Width = (float)shadowResolution.at(0);
-	viewport.Height = (float)shadowResolution.at(1);
 	viewport.MaxDepth = 1.0f;
-	Graphics::Context->RSSetViewports(1, &viewport);
 
-	CreateLightViewMatrix(lightsData[0]);
-	CreateLightProjectionMatrix(lightsData[0]);
-
-	// Deactivate Pixel Shader
-	Graphics::Context->PSSetShader(0, 0, 0);
+	UpdateShadowCascades();
+	UpdateShadowAtlas();
+
+	// Everything that's the same for the whole frame, sent once
+	PerFrameConstants& frame = frameConstants->Data;
+	frame.view = activeCamera->GetViewMatrix();
+	frame.projection = activeCamera->GetProjectionMatrix();
+	frame.cascadeSplits = XMFLOAT4(
+		shadowCascades.Cascades[0].FarDepth,
+		shadowCascades.Cascades[1].FarDepth,
+		shadowCascades.Cascades[2].FarDepth,
+		shadowCascades.Cascades[3].FarDepth);
+	frame.cascadeBlend = shadowSettings.BlendBand;
+	frame.cameraPosition = activeCamera->GetPosition();
+	frame.ambient = ambientColor;
+
+	// Ambient is scaled by the light the sky sends each way; a
+	// flat white environment leaves it as it is
+	SHL2 irradiance = useSkyIrradiance && skybox->HasRadianceSH() ?
+		ConvolveIrradianceSH(skybox->GetRadianceSH()) : ProjectConstantSH(1.0f, 1.0f, 1.0f);
+	for (int i = 0; i < 9; i++)
+		frame.irradianceSH[i] = XMFLOAT4(irradiance.Coefficients[i][0], irradiance.Coefficients[i][1], irradiance.Coefficients[i][2], 0.0f);
+
+	// Lights are sorted by type, as the shader variants expect
+	ShaderPermutationKey lightCounts;
+	unsigned int lightCount = 0;
+	for (int type : { LIGHT_TYPE_DIRECTION, LIGHT_TYPE_POINT, LIGHT_TYPE_SPOT })
+	{
+		for (size_t i = 0; i < lightsData.size(); i++)
+		{
+			const Light& light = lightsData[i];
+			if (light.Type != type || lightCount == ARRAYSIZE(frame.lights))
+				continue;
+
+			frame.lights[lightCount] = light;
+			frame.lights[lightCount++].ShadowTile = lightShadowTiles[i];
+			if (type == LIGHT_TYPE_DIRECTION) lightCounts.DirectionalLights++;
+			if (type == LIGHT_TYPE_POINT) lightCounts.PointLights++;
+			if (type == LIGHT_TYPE_SPOT) lightCounts.SpotLights++;
+		}
+	}
+	while (lightCount < ARRAYSIZE(frame.lights))
+	{
+		frame.lights[lightCount] = {};
+		frame.lights[lightCount++].ShadowTile = -1;
+	}
+	frameConstants->Upload();
+	shadowAtlasConstants->Upload();
+
+	// Clustered variants get every light, however many
+	lightCounts.ClusteredLights = useClusteredLights;
+	lightCounts.SpecularIBL = useSpecularIBL && skybox->HasSpecularEnvironment();
+	lightCounts.BakedOcclusion = useBakedOcclusion;
+	if (useClusteredLights)
+	{
+		std::vector<Light> allLights = lightsData;
+		allLights.insert(allLights.end(), extraLights.begin(), extraLights.end());
+		for (size_t i = 0; i < allLights.size(); i++)
+			allLights[i].ShadowTile = i < lightShadowTiles.size() ? lightShadowTiles[i] : -1;
+		clusteredLights->Update(allLights, *activeCamera, renderSize.Width, renderSize.Height);
+	}
 
-	Graphics::Context->RSSetState(shadowRasterizer.Get());
-	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", lightViewMatrix);
-	shadowVS->SetMatrix4x4("projection", lightProjectionMatrix);
+	if (lightCounts != sceneLights)
+	{
+		sceneLights = lightCounts;
+		UpdateShaderVariants();
+	}
 
+	// Work out which cascades' caches are still good, and which
+	// casters each one needs drawn
+	UpdateShadowCasters();
 
-	// Loop and draw all entities for the shadow map
-	for (int i = 0; i < models->size() - 1; i++)
+	std::vector<unsigned int> shadowDraws;
+	for (const ShadowView& shadowView : shadowViews)
 	{
-		shadowVS->SetMatrix4x4("world", models->at(i).GetTransform()->GetWorldMatrix());
-		shadowVS->CopyAllBufferData();
-		// Draw the mesh directly to avoid the entity's material
-		// Note: Your code may differ significantly here!
-		//models->at(i).GetMaterial()->GetPS()->SetShaderResourceView("ShadowMap", shadowSRV.Get());
-		models->at(i).GetMesh()->Draw();
+		// Not placed, or the cascade hasn't changed and last frame's
+		// copy in the atlas has nothing drawn over it
+		int c = shadowView.Cascade;
+		if (shadowView.Rect.Size == 0 || (c >= 0 && !shadowCache.NeedsCopy(c)))
+			continue;
+
+		shadowPassConstants->Data.lightViewProjection = XMFLOAT4X4(shadowView.ViewProjection);
+		shadowPassConstants->Upload();
+
+		// Any other light's tile is drawn from scratch every frame,
+		// with whatever reaches into its volume
+		if (c < 0)
+		{
+			FillShadowTile(shadowView.Rect, shadowClearPS);
+			shadowDraws.clear();
+			for (unsigned int i = 0; i < (unsigned int)shadowCasters.size(); i++)
+			{
+				if (shadowCasters[i].CastsShadows && CasterInFrustum(shadowCasters[i], shadowView.ViewProjection))
+					shadowDraws.push_back(i);
+			}
+			DrawShadowCasters(shadowDraws);
+			continue;
+		}
+
+		// Redraw the static casters' depth if it's out of date
+		if (shadowCache.NeedsRedraw(c))
+		{
+			Graphics::GfxContext->ClearDepthStencilView(staticShadowDSVs[c].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+			Graphics::GfxContext->OMSetRenderTargets(1, &nullRTV, staticShadowDSVs[c].Get());
+			viewport.TopLeftX = 0.0f;
+			viewport.TopLeftY = 0.0f;
+			viewport.Width = (float)shadowSettings.Resolution;
+			viewport.Height = (float)shadowSettings.Resolution;
+			Graphics::GfxContext->RSSetViewports(1, &viewport);
+			DrawShadowCasters(shadowCache.GetStaticDraws(c));
+		}
+
+		// Copy it into the cascade's tile, then the dynamic casters
+		// over the top
+		shadowCopyPS->SetShaderResourceView("StaticDepth", staticShadowSRVs[c]);
+		FillShadowTile(shadowView.Rect, shadowCopyPS);
+		shadowCopyPS->SetShaderResourceView("StaticDepth", 0);
+		DrawShadowCasters(shadowCache.GetDynamicDraws(c));
 	}
 
 	// Reset Pipeline
-	viewport.Width = (float)Window::Width();
-	viewport.Height = (float)Window::Height();
-	Graphics::Context->RSSetViewports(1, &viewport);
-	Graphics::Context->OMSetRenderTargets(
-		1,
-		Graphics::BackBufferRTV.GetAddressOf(),
-		Graphics::DepthBufferDSV.Get());
-	Graphics::Context->RSSetState(0);
-
-	if (usePP) {
-		Graphics::Context->ClearRenderTargetView(ppRTV.Get(), clearColor);
-		Graphics::Context->OMSetRenderTargets(1, ppRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
+	Graphics::GfxContext->RSSetState(0);
+
+	// The scene goes wherever the post process chain first reads
+	// it, which is the back buffer if there's nothing to do.  At
+	// less than the window's size it has a depth buffer of its own.
+	// Either way it's drawn at renderSize.
+	UpdatePostChain();
+	viewport.TopLeftX = 0.0f;
+	viewport.TopLeftY = 0.0f;
+	viewport.Width = (float)renderSize.Width;
+	viewport.Height = (float)renderSize.Height;
+	Graphics::GfxContext->RSSetViewports(1, &viewport);
+	if (postPlan.SceneTarget != PostBackBuffer) {
+		ID3D11DepthStencilView* sceneDSV = sceneDepth ? sceneDepth->DSV.Get() : Graphics::DepthBufferDSV.Get();
+		if (sceneDepth)
+			Graphics::GfxContext->ClearDepthStencilView(sceneDSV, D3D11_CLEAR_DEPTH, 1.0f, 0);
+		Graphics::GfxContext->ClearRenderTargetView(ppTargets[postPlan.SceneTarget]->RTV.Get(), clearColor);
+		Graphics::GfxContext->OMSetRenderTargets(1, ppTargets[postPlan.SceneTarget]->RTV.GetAddressOf(), sceneDSV);
 	}
+	else
+		Graphics::GfxContext->OMSetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
 
 	// Draw Meshes
 	for (int i = 0; i < models->size(); i++) {
-		models->at(i).GetMaterial()->GetPS()->SetFloat3("ambient", ambientColor);
-		models->at(i).GetMaterial()->GetPS()->SetData("lights", &lightsData[0], sizeof(Light) * (int)lightsData.size());
-		models->at(i).GetMaterial()->GetVS()->SetMatrix4x4("lightView", lightViewMatrix);
-		models->at(i).GetMaterial()->GetVS()->SetMatrix4x4("lightProjection", lightProjectionMatrix); 
 		models->at(i).GetMaterial()->GetPS()->SetShaderResourceView("ShadowMap", shadowSRV);
 		models->at(i).GetMaterial()->GetPS()->SetSamplerState("ShadowSampler", shadowSampler);
-		models->at(i).Draw(activeCamera);
+		if (useClusteredLights)
+			clusteredLights->BindTo(models->at(i).GetMaterial()->GetPS());
+		if (sceneLights.SpecularIBL)
+			skybox->BindEnvironmentTo(models->at(i).GetMaterial()->GetPS());
+		models->at(i).Draw(objectConstants);
 	}
 
-	skybox->Draw(*activeCamera);
+	// The shadow map is drawn to again next frame (every material
+	// reads it from the same register)
+	if (!models->empty())
+		models->back().GetMaterial()->GetPS()->SetShaderResourceView("ShadowMap", 0);
 
-	// Post Processing
-	if (usePP) {
-		Graphics::Context->OMSetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), 0);
+	skybox->Draw();
 
-		// Activate shaders and bind resources
-		// Also set any required cbuffer data (not shown)
+	// Post Processing
+	// - The exposure is read back before this frame's luminance
+	//   is copied over the oldest in the ring
+	// - Each pass of the plan, the last one to the back buffer
+	UpdateExposure(deltaTime);
+	if (!postPlan.Passes.empty()) {
 		ppVS->SetShader();
-		ppPS->SetShader();
-		ppPS->SetShaderResourceView("Pixels", ppSRV.Get());
-		ppPS->SetSamplerState("ClampSampler", ppSampler.Get());
-		ppPS->SetFloat("pixelWidth", 1.0f / Window::Width());
-		ppPS->SetFloat("pixelHeight", 1.0f / Window::Height());
-		ppPS->SetInt("blurRadius", blurRad);
-		ppPS->SetInt("pixelation", pixelation);
-		ppPS->CopyAllBufferData();
-
-		Graphics::Context->Draw(3, 0); // Draw exactly 3 vertices (one triangle)
+		if (postPlan.SceneTarget != PostBackBuffer)
+			MeasureLuminance(ppTargets[postPlan.SceneTarget]);
+		for (const PostPass& pass : postPlan.Passes)
+			DrawPostPass(pass);
+
+		// Let go of the targets the passes read, so none is still
+		// an input when the pool hands it out as an output
+		luminancePS->SetShaderResourceView("Pixels", 0);
+		bloomDownsamplePS->SetShaderResourceView("Pixels", 0);
+		bloomUpsamplePS->SetShaderResourceView("Pixels", 0);
+		bloomUpsamplePS->SetShaderResourceView("Base", 0);
+		blurPS->SetShaderResourceView("Pixels", 0);
+		postFusedPS->SetShaderResourceView("Pixels", 0);
+		postFusedPS->SetShaderResourceView("GradingLut", 0);
 	}
+	ppTargets.clear();
+	sceneDepth.reset();
+	renderTargets->EndFrame();
 
 	// Draw ImGui
+	if (!Graphics::IsHeadless())
 	{
 		ImGui::Render(); // Turns this frame’s UI into renderable triangles
 		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData()); // Draws it to the screen
+
+		// ImGui restores constant buffers as whole buffers, which
+		// undoes any offsets the state cache thinks are bound
+		Graphics::StateCache->InvalidateConstantBuffers();
 	}
 
 	// Frame END
 	// - These should happen exactly ONCE PER FRAME
 	// - At the very end of the frame (after drawing *everything*)
 	{
-		ID3D11ShaderResourceView* nullSRVs[128] = {};
-		Graphics::Context->PSSetShaderResources(0, 128, nullSRVs);
-		
+		// Everything's been submitted, so that's the end of the GPU's frame
+		gpuFrameTimer->EndFrame();
+
 		// Present at the end of the frame
 		bool vsync = Graphics::VsyncState();
-		Graphics::SwapChain->Present(
-			vsync ? 1 : 0,
-			vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+		if (Graphics::SwapChain)
+		{
+			Graphics::SwapChain->Present(
+				vsync ? 1 : 0,
+				vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+
+			// Presenting unbinds the back buffer behind the state cache's back
+			Graphics::StateCache->InvalidateRenderTargets();
+		}
+
+		// Fence this frame's constant data so the ring can reuse it later
+		if (Graphics::ConstantRing)
+			Graphics::ConstantRing->EndFrame();
+		lastFrameUploadBytes = ISimpleShader::UploadedBytes - frameUploadStart;
+		lastFrameSkips = ISimpleShader::SkippedUploads - frameSkipStart;
 
 		// Re-bind back buffer and depth buffer after presenting
-		Graphics::Context->OMSetRenderTargets(
+		Graphics::GfxContext->OMSetRenderTargets(
 			1,
 			Graphics::BackBufferRTV.GetAddressOf(),
 			Graphics::DepthBufferDSV.Get());
+
+		// Finish the capture, if one is running
+		if (captureTrace)
+		{
+			Graphics::Recorder->EndCapture(FixPath(L"frame.gtrace"));
+			captureTrace = false;
+		}
 	}
 
 
@@ -449,6 +743,22 @@ void Game::BuildUI() {
 		// Replace each %d with the next parameter, and format as decimal integers
 		// The "x" will be printed as-is between the numbers, like so: 800x600
 		ImGui::Text("Window Resolution: %dx%d", Window::Width(), Window::Height());
+
+		// The size the scene's drawn at, and what picks it.  The
+		// controller goes by the GPU's time when there is one, as
+		// the whole frame's includes waiting on vsync.
+		ImGui::Text("Render Resolution: %ux%u (%.0f%%)", renderSize.Width, renderSize.Height, renderScale * 100.0f);
+		ImGui::Checkbox("Dynamic Resolution", &dynamicResolution);
+		if (dynamicResolution) {
+			ImGui::SliderFloat("Frame Budget", &resolutionSettings.BudgetMs, 4.0f, 50.0f, "%.1f ms");
+			ImGui::Text("Frame Time: %.2f ms (%s)", resolutionFrameMs, resolutionGpuTimed ? "GPU" :
+				resolutionSettings.RefreshMs > 0.0f ? "whole frame, vsynced" : "whole frame");
+			ImGui::SliderFloat("Min Scale", &resolutionSettings.MinScale, 0.25f, resolutionSettings.MaxScale);
+			ImGui::Text("Controller: %.3f before quantizing, %u changes", resolutionController.GetSmoothScale(),
+				resolutionController.GetChangeCount());
+		}
+		else
+			ImGui::SliderFloat("Render Scale", &fixedRenderScale, resolutionSettings.MinScale, resolutionSettings.MaxScale);
 	}
 
 	// Camera
@@ -535,6 +845,8 @@ void Game::BuildUI() {
 				ImGui::Text("Triangles: %i", object->GetIndexCount() / 3);
 				ImGui::Text("Vertices: %i", object->GetVertexCount());
 				ImGui::Text("Indices: %i", object->GetIndexCount());
+				ImGui::Text("Occlusion: %s (%.2f ms)", !object->HasBakedOcclusion() ? "not baked" :
+					object->WasOcclusionCached() ? "from cache" : "baked", object->GetOcclusionBakeTime());
 				ImGui::TreePop();
 				ImGui::NewLine();	// Separation buffer
 			}
@@ -569,6 +881,13 @@ void Game::BuildUI() {
 				ImGui::SliderFloat3("Scale", (float*)&scale, 0.0f, 3.0f);
 				ImGui::Text("Mesh Index Count: %i", object->GetIndexCount());
 
+				bool castsShadows = models->at(i).CastsShadows();
+				bool staticCaster = models->at(i).IsStaticCaster();
+				ImGui::Checkbox("Casts Shadows", &castsShadows);
+				ImGui::Checkbox("Static Shadow Caster", &staticCaster);
+				models->at(i).SetCastsShadows(castsShadows);
+				models->at(i).SetStaticCaster(staticCaster);
+
 				// Material Data
 				ImGui::NewLine();
 				ImGui::Text("Material Data");
@@ -658,19 +977,211 @@ void Game::BuildUI() {
 		}
 	}
 
+	// Ambient from the sky's spherical harmonics, reflections
+	// from its prefiltered cubemap, both shadowed by the meshes'
+	// baked occlusion
+	if (ImGui::CollapsingHeader("Sky Lighting", 1))
+	{
+		ImGui::Checkbox("Use Sky Irradiance", &useSkyIrradiance);
+		ImGui::Checkbox("Use Specular IBL", &useSpecularIBL);
+		if (useSpecularIBL && !useShaderVariants)
+			ImGui::Text("Needs the specialized lighting shader");
+		ImGui::Checkbox("Use Baked Occlusion", &useBakedOcclusion);
+		if (!useBakedOcclusion && !useShaderVariants)
+			ImGui::Text("Turning it off needs the specialized lighting shader");
+
+		ImGui::Text("Irradiance: %s", !skybox->HasRadianceSH() ? "not baked, ambient is flat" :
+			skybox->WasRadianceCached() ? "from cache" : "baked");
+		ImGui::Text("Reflections: %s", !skybox->HasSpecularEnvironment() ? "not baked" :
+			skybox->WasSpecularCached() ? "from cache" : "baked");
+		if (skybox->HasSpecularEnvironment())
+			ImGui::Text("Roughness mips: %u", skybox->GetSpecularMipCount());
+		ImGui::Text("Bake time: %.2f ms", skybox->GetBakeTime());
+	}
+
+	// Cascades are refitted every frame, so these apply right away
 	if (ImGui::CollapsingHeader("Shadow Map", 1)) {
+		const ShadowCacheStats& shadowStats = shadowCache.GetFrameStats();
+		ImGui::Text("Shadow draws: %u static, %u dynamic", shadowStats.StaticDraws, shadowStats.DynamicDraws);
+		ImGui::Text("Skipped: %u cached, %u culled", shadowStats.CachedDraws, shadowStats.CulledDraws);
+		ImGui::Text("Cascades redrawn: %u, copied: %u", shadowStats.Invalidations, shadowStats.Copies);
+
+		// Tiles go to the lights that need them most each frame
+		const ShadowAtlasStats& atlasStats = shadowAtlas.GetFrameStats();
+		unsigned int depthBytes = shadowDepth16 ? 2 : 4;
+		ImGui::Text("Atlas: %ux%u, %.1f MB, %.0f%% used", shadowAtlasSize, shadowAtlasSize,
+			(double)shadowAtlasSize * shadowAtlasSize * depthBytes / (1024.0 * 1024.0),
+			100.0 * atlasStats.UsedTexels / ((double)shadowAtlasSize * shadowAtlasSize));
+		ImGui::Text("Tiles: %u kept, %u moved, %u new, %u shrunk, %u dropped",
+			atlasStats.Kept, atlasStats.Moved, atlasStats.Placed, atlasStats.Shrunk, atlasStats.Dropped);
+		if (ImGui::Checkbox("16-bit Shadow Depth", &shadowDepth16))
+			CreateShadowMap();
+		for (size_t i = 0; i < lightShadowTiles.size(); i++)
+		{
+			if (lightShadowTiles[i] < 0)
+				continue;
+			const ShadowAtlasRect& tile = shadowViews[lightShadowTiles[i]].Rect;
+			ImGui::Text("Light %zu: from tile %d, %ux%u at %u, %u", i, lightShadowTiles[i], tile.Size, tile.Size, tile.X, tile.Y);
+		}
+
+		ImGui::SliderFloat("Shadow Distance", &shadowSettings.ShadowDistance, 5.0f, 100.0f);
+		ImGui::SliderFloat("Split Lambda", &shadowSettings.SplitLambda, 0.0f, 1.0f);
+		ImGui::SliderFloat("Blend Band", &shadowSettings.BlendBand, 0.0f, 0.5f);
+		for (unsigned int i = 0; i < ShadowCascadeCount; i++)
+		{
+			const ShadowCascade& cascade = shadowCascades.Cascades[i];
+			ImGui::Text("Cascade %u: %.2f to %.2f, radius %.2f", i, cascade.NearDepth, cascade.FarDepth, cascade.Radius);
+		}
 		ImGui::Image((ImTextureID)shadowSRV.Get(), ImVec2(512, 512));
 	}
 
 	// Post Processing
 	if (ImGui::CollapsingHeader("Post Processing", 1))
 	{
-		ImGui::Checkbox("Use Post Processing", &usePP);
+		// Every effect's settings, as it declares them
+		for (unsigned int e = 0; e < postEffects.size(); e++)
+		{
+			PostEffect& effect = postEffects[e];
+			ImGui::PushID((int)e);
+			if (effect.Required)
+				ImGui::Text("%s", effect.Name);
+			else
+				ImGui::Checkbox(effect.Name, &effect.Enabled);
+			if (effect.Enabled) {
+				for (PostEffectParam& param : effect.Params)
+				{
+					ImGui::SliderFloat(param.Name, &param.Value, param.Min, param.Max, param.Integer ? "%.0f" : "%.2f");
+					if (param.Integer)
+						param.Value = roundf(param.Value);
+				}
+			}
+			ImGui::PopID();
+		}
 
-		if (usePP) {
-			ImGui::SliderFloat("Blur Radius", &blurRad, 0.0f, 20.0f);
-			ImGui::SliderInt("Pixelation", &pixelation, 1.0f, 1000.0f);
+		ImGui::Text("Chain: %u effects in %u passes, %u fused", postPlan.ActiveEffects,
+			(unsigned int)postPlan.Passes.size(), postPlan.FusedEffects);
+		ImGui::Text("Targets: %u, %.1f MB", (unsigned int)postPlan.Targets.size(), postPlan.TargetBytes / (1024.0f * 1024.0f));
+		ImGui::Text("Pool: %u held, %.1f MB, %u made, %u reused", renderTargets->GetTargetCount(),
+			renderTargets->GetBytes() / (1024.0f * 1024.0f), renderTargets->GetCreatedCount(), renderTargets->GetReusedCount());
+
+		// The HDR targets' format, and what the chain would move
+		// each frame in either
+		bool wideTargets = hdrFormat == DXGI_FORMAT_R16G16B16A16_FLOAT;
+		if (ImGui::Checkbox("RGBA16F Targets", &wideTargets))
+			hdrFormat = wideTargets ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R11G11B10_FLOAT;
+		ImGui::Text("Traffic: %.1f MB a frame (R11G11B10: %.1f, RGBA16F: %.1f)",
+			PostChainTraffic(postPlan, Window::Width(), Window::Height(), FormatBitsPerPixel(hdrFormat) / 8, 4) / (1024.0f * 1024.0f),
+			PostChainTraffic(postPlan, Window::Width(), Window::Height(), 4, 4) / (1024.0f * 1024.0f),
+			PostChainTraffic(postPlan, Window::Width(), Window::Height(), 8, 4) / (1024.0f * 1024.0f));
+
+		// Exposure, and the histogram it came from
+		ImGui::Checkbox("Auto Exposure", &autoExposure);
+		ImGui::SliderFloat("Compensation", &exposureSettings.Compensation, -4.0f, 4.0f, "%.1f stops");
+		if (autoExposure) {
+			ImGui::SliderFloat("Brightening Speed", &exposureSettings.BrighteningSpeed, 0.1f, 10.0f);
+			ImGui::SliderFloat("Darkening Speed", &exposureSettings.DarkeningSpeed, 0.1f, 10.0f);
+			ImGui::Text("Exposure: %.3f, heading for %.3f", exposure, exposureController.GetTargetExposure());
+			float bins[LuminanceHistogramBins];
+			for (unsigned int b = 0; b < LuminanceHistogramBins; b++)
+				bins[b] = (float)luminanceHistogram.Bins[b];
+			ImGui::PlotHistogram("Luminance", bins, LuminanceHistogramBins, 0, 0, 0.0f, FLT_MAX, ImVec2(0, 60));
 		}
+		else
+			ImGui::Text("Exposure: %.3f", exposure);
+
+		// Two passes of the folded taps either side of the center,
+		// against every texel of the box the old blur read
+		unsigned int radius = blurKernel.Radius;
+		ImGui::Text("Blur: %u taps a pass, %u samples a pixel (box: %u)", blurKernel.TapCount,
+			2 * (2 * blurKernel.TapCount - 1), (2 * radius + 1) * (2 * radius + 1));
+
+		// However far it spreads, the same levels are drawn
+		PostTarget smallest = PostTargetSize(renderSize.Width, renderSize.Height, 1.0f / (2 << (BloomLevels - 1)));
+		ImGui::Text("Bloom: %u levels, down to %ux%u", BloomLevels, smallest.Width, smallest.Height);
+
+		// Whatever the grade does, it's one sample of this
+		ImGui::Text("Grade: %u^3 table, baked %u times", ColorLutSize, gradingLutBakes);
+	}
+
+	// Frame Trace
+	if (ImGui::CollapsingHeader("Frame Trace", 1))
+	{
+		if (ImGui::Button("Capture Next Frame"))
+			captureTrace = true;
+
+		ImGui::Text("Objects: %u", Graphics::Recorder->GetLastObjectCount());
+		ImGui::Text("Commands: %u", Graphics::Recorder->GetLastCommandCount());
+		ImGui::Text("File Size: %llu bytes", Graphics::Recorder->GetLastFileBytes());
+	}
+
+	// State Cache
+	if (ImGui::CollapsingHeader("State Cache", 1))
+	{
+		bool cacheEnabled = Graphics::StateCache->IsEnabled();
+		if (ImGui::Checkbox("Filter Redundant State", &cacheEnabled))
+			Graphics::StateCache->SetEnabled(cacheEnabled);
+
+		std::shared_ptr<StateCacheStats> cacheStats = Graphics::StateCache->GetStats();
+		ImGui::Text("Hits: %llu", cacheStats->TotalHits());
+		ImGui::Text("Misses: %llu", cacheStats->TotalMisses());
+		ImGui::Text("Forwarded: %llu", cacheStats->TotalForwarded());
+		if (ImGui::Button("Reset Counters"))
+			cacheStats->Reset();
+	}
+
+	// Constant Buffer Ring
+	if (Graphics::ConstantRing && ImGui::CollapsingHeader("Constant Buffer Ring", 1))
+	{
+		bool useRing = ISimpleShader::BufferRing != 0;
+		if (ImGui::Checkbox("Sub-allocate Constant Buffers", &useRing))
+			ISimpleShader::BufferRing = useRing ? Graphics::ConstantRing : 0;
+
+		ImGui::Text("Capacity: %u bytes", Graphics::ConstantRing->GetCapacity());
+		ImGui::Text("Last Frame: %u bytes in %u slices", Graphics::ConstantRing->GetFrameBytes(), Graphics::ConstantRing->GetFrameAllocations());
+		ImGui::Text("Fallbacks: %u", Graphics::ConstantRing->GetFrameFallbacks());
+		ImGui::Text("Frames In Flight: %u", Graphics::ConstantRing->GetFramesInFlight());
+		ImGui::Text("Wraps: %u", Graphics::ConstantRing->GetWrapCount());
+	}
+
+	// Constant data sent to the GPU, split by how often it changes
+	if (ImGui::CollapsingHeader("Constant Uploads", 1))
+	{
+		ImGui::Text("Last Frame: %llu bytes", lastFrameUploadBytes);
+		ImGui::Text("Unchanged Buffers Skipped: %llu", lastFrameSkips);
+		ImGui::Text("Per Frame Buffer: %u bytes", frameConstants->GetSize());
+		ImGui::Text("Per Object Buffer: %u bytes", objectConstants->GetSize());
+		ImGui::Text("Total: %llu bytes", ISimpleShader::UploadedBytes);
+	}
+
+	// Lighting shaders compiled for exactly what each material uses
+	if (ImGui::CollapsingHeader("Shader Variants", 1))
+	{
+		if (ImGui::Checkbox("Specialize Lighting Shader", &useShaderVariants))
+			UpdateShaderVariants();
+
+		ImGui::Text("Lights: %u directional, %u point, %u spot",
+			sceneLights.DirectionalLights, sceneLights.PointLights, sceneLights.SpotLights);
+		ImGui::Text("Variants: %u", Graphics::Permutations->GetVariantCount());
+		ImGui::Text("Compiled: %u", Graphics::Permutations->GetCompileCount());
+		ImGui::Text("From Disk: %u", Graphics::Permutations->GetDiskHitCount());
+		ImGui::Text("Failed: %u", Graphics::Permutations->GetFailureCount());
+	}
+
+	// Any number of lights, culled per cluster on the CPU
+	if (ImGui::CollapsingHeader("Clustered Lights", 1))
+	{
+		ImGui::Checkbox("Use Clustered Lighting", &useClusteredLights);
+		if (ImGui::SliderInt("Extra Lights", &extraLightCount, 0, 4096))
+			CreateExtraLights(extraLightCount);
+
+		if (useClusteredLights && !useShaderVariants)
+			ImGui::Text("Needs the specialized lighting shader");
+
+		const LightClusterGrid& grid = clusteredLights->GetGrid();
+		ImGui::Text("Grid: %u x %u x %u", grid.GetTilesX(), grid.GetTilesY(), grid.GetSlices());
+		ImGui::Text("Lights: %u (%u binned)", clusteredLights->GetLightCount(), grid.GetBinnedLightCount());
+		ImGui::Text("Indices: %u (at most %u in a cluster)", clusteredLights->GetIndexCount(), grid.GetMaxLightsPerCluster());
+		ImGui::Text("Binning: %.3f ms", clusteredLights->GetAssignTime());
 	}
 
 	ImGui::NewLine();	// Separation buffer
@@ -749,6 +1260,87 @@ const char* Game::GetLightType(int Type) {
 	return LightTypeNames[Type];
 }
 
+// --------------------------------------------------------
+// Gives each lighting material the pixel shader variant for
+// its textures and the current light counts, or the general
+// shader if variants are off or one can't be built
+// --------------------------------------------------------
+void Game::UpdateShaderVariants()
+{
+	for (auto& material : lightingMaterials)
+	{
+		std::shared_ptr<SimplePixelShader> ps = lightingPS;
+		if (useShaderVariants)
+		{
+			ShaderPermutationKey key = material->GetShaderFeatures();
+			key.DirectionalLights = sceneLights.DirectionalLights;
+			key.PointLights = sceneLights.PointLights;
+			key.SpotLights = sceneLights.SpotLights;
+			key.ClusteredLights = sceneLights.ClusteredLights;
+			key.SpecularIBL = sceneLights.SpecularIBL;
+			key.BakedOcclusion = sceneLights.BakedOcclusion;
+
+			std::wstring variant = Graphics::Permutations->GetVariant(FixPath(L"../../PixelShader.hlsl"), "main", "ps_5_0", key);
+			std::shared_ptr<SimplePixelShader> variantPS = variant.empty() ? 0 : Graphics::Shaders->GetPixelShader(variant);
+			if (variantPS && variantPS->IsShaderValid())
+				ps = variantPS;
+		}
+
+		if (material->GetPS() != ps)
+		{
+			frameConstants->BindTo(ps);
+			shadowAtlasConstants->BindTo(ps);
+			material->SetPS(ps);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Turns on clustered lighting with a number of extra lights,
+// for headless runs where there's no UI to do it.  Switches
+// the lighting materials to the clustered variant right
+// away rather than on the next frame.
+// --------------------------------------------------------
+void Game::EnableClusteredLighting(unsigned int extraLights)
+{
+	useClusteredLights = true;
+	extraLightCount = (int)extraLights;
+	CreateExtraLights(extraLights);
+
+	sceneLights.ClusteredLights = true;
+	UpdateShaderVariants();
+}
+
+const ClusteredLights* Game::GetClusteredLights() const
+{
+	return clusteredLights.get();
+}
+
+// --------------------------------------------------------
+// Scatters small point and spot lights around the models.
+// Always seeded the same, so runs are repeatable.
+// --------------------------------------------------------
+void Game::CreateExtraLights(unsigned int count)
+{
+	std::mt19937 random(540);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	extraLights.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Light light = {};
+		light.Type = i % 4 == 3 ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT;
+		light.Position = XMFLOAT3(-10.0f + unit(random) * 20.0f, -3.0f + unit(random) * 4.0f, -3.0f + unit(random) * 6.0f);
+		light.Range = 0.5f + unit(random) * 2.0f;
+		light.Color = XMFLOAT3(unit(random), unit(random), unit(random));
+		light.Intensity = 0.5f;
+		light.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+		light.SpotInnerAngle = XMConvertToRadians(15.0f);
+		light.SpotOuterAngle = XMConvertToRadians(35.0f);
+		extraLights.push_back(light);
+	}
+}
+
 void Game::CreateLights() {
 	Light light1 = {};
 	light1.Type = LIGHT_TYPE_DIRECTION;
@@ -795,50 +1387,79 @@ void Game::CreateLights() {
 
 void Game::CreateShadowMap() {
 	// Create the actual texture that will be the shadow map
+	// - 16 bit depth halves its memory, and its precision
 	D3D11_TEXTURE2D_DESC shadowDesc = {};
-	shadowDesc.Width = (int)shadowResolution.at(0); // Ideally a power of 2 (like 1024)
-	shadowDesc.Height = (int)shadowResolution.at(1); // Ideally a power of 2 (like 1024)
+	shadowDesc.Width = shadowAtlasSize;
+	shadowDesc.Height = shadowAtlasSize;
 	shadowDesc.ArraySize = 1;
 	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
 	shadowDesc.CPUAccessFlags = 0;
-	shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	shadowDesc.Format = shadowDepth16 ? DXGI_FORMAT_R16_TYPELESS : DXGI_FORMAT_R32_TYPELESS;
 	shadowDesc.MipLevels = 1;
 	shadowDesc.MiscFlags = 0;
 	shadowDesc.SampleDesc.Count = 1;
 	shadowDesc.SampleDesc.Quality = 0;
 	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
-	Graphics::Device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
+	Graphics::GfxDevice->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
 
 	// Create the depth/stencil view
 	D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-	shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	shadowDSDesc.Format = shadowDepth16 ? DXGI_FORMAT_D16_UNORM : DXGI_FORMAT_D32_FLOAT;
 	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
 	shadowDSDesc.Texture2D.MipSlice = 0;
-	Graphics::Device->CreateDepthStencilView(
+	Graphics::GfxDevice->CreateDepthStencilView(
 		shadowTexture.Get(),
 		&shadowDSDesc,
 		shadowDSV.GetAddressOf());
 
 	// Create the SRV for the shadow map
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.Format = shadowDepth16 ? DXGI_FORMAT_R16_UNORM : DXGI_FORMAT_R32_FLOAT;
 	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Texture2D.MipLevels = 1;
 	srvDesc.Texture2D.MostDetailedMip = 0;
-	Graphics::Device->CreateShaderResourceView(
+	Graphics::GfxDevice->CreateShaderResourceView(
 		shadowTexture.Get(),
 		&srvDesc,
 		shadowSRV.GetAddressOf());
 
+	// One more texture per cascade, a tile in size, for the static
+	// casters' cached depth
+	shadowDesc.Width = shadowSettings.Resolution;
+	shadowDesc.Height = shadowSettings.Resolution;
+	for (unsigned int i = 0; i < ShadowCascadeCount; i++)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> staticTexture;
+		Graphics::GfxDevice->CreateTexture2D(&shadowDesc, 0, staticTexture.GetAddressOf());
+		Graphics::GfxDevice->CreateDepthStencilView(staticTexture.Get(), &shadowDSDesc, staticShadowDSVs[i].GetAddressOf());
+		Graphics::GfxDevice->CreateShaderResourceView(staticTexture.Get(), &srvDesc, staticShadowSRVs[i].GetAddressOf());
+	}
+	shadowCache.Invalidate();
+
+	// Every tile goes with the old texture
+	shadowAtlas.Reset(shadowAtlasSize, 128);
+	for (ShadowAtlasRect& rect : cascadeRects)
+		rect = {};
+	shadowViews.clear();
+	lightShadowTiles.clear();
+
+	// Copying cached depth into a tile, or clearing one, overwrites
+	// whatever's there
+	D3D11_DEPTH_STENCIL_DESC copyDepthDesc = {};
+	copyDepthDesc.DepthEnable = true;
+	copyDepthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	copyDepthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	Graphics::GfxDevice->CreateDepthStencilState(&copyDepthDesc, shadowCopyDepthState.GetAddressOf());
+
 	// Rasterizer
 	D3D11_RASTERIZER_DESC shadowRastDesc = {};
 	shadowRastDesc.FillMode = D3D11_FILL_SOLID;
 	shadowRastDesc.CullMode = D3D11_CULL_BACK;
 	shadowRastDesc.DepthClipEnable = true;
-	shadowRastDesc.DepthBias = 1000; // Min. precision units, not world units!
+	shadowRastDesc.DepthBias = shadowDepth16 ? 8 : 1000; // Min. precision units, not world units!
 	shadowRastDesc.SlopeScaledDepthBias = 1.0f; // Bias more based on slope
-	Graphics::Device->CreateRasterizerState(&shadowRastDesc, &shadowRasterizer);
+	Graphics::GfxDevice->CreateRasterizerState(&shadowRastDesc, &shadowRasterizer);
 
 	// Sampler
 	D3D11_SAMPLER_DESC shadowSampDesc = {};
@@ -848,27 +1469,228 @@ void Game::CreateShadowMap() {
 	shadowSampDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
 	shadowSampDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
 	shadowSampDesc.BorderColor[0] = 1.0f; // Only need the first component
-	Graphics::Device->CreateSamplerState(&shadowSampDesc, &shadowSampler);
+	Graphics::GfxDevice->CreateSamplerState(&shadowSampDesc, &shadowSampler);
+}
+
+// Gathers every entity for the shadow cache, which works out
+// what each cascade needs drawn this frame
+void Game::UpdateShadowCasters() {
+	shadowCasters.resize(models->size());
+	for (size_t i = 0; i < models->size(); i++)
+	{
+		GameEntity& entity = models->at(i);
+		std::shared_ptr<Transform> transform = entity.GetTransform();
+		transform->CreateWorldMatrix();
+		XMFLOAT4X4 world = transform->GetWorldMatrix();
+		XMFLOAT3 boundsMin = entity.GetMesh()->GetBoundsMin();
+		XMFLOAT3 boundsMax = entity.GetMesh()->GetBoundsMax();
+
+		ShadowCaster& caster = shadowCasters[i];
+		memcpy(caster.World, &world, sizeof(caster.World));
+		memcpy(caster.LocalMin, &boundsMin, sizeof(caster.LocalMin));
+		memcpy(caster.LocalMax, &boundsMax, sizeof(caster.LocalMax));
+		caster.CastsShadows = entity.CastsShadows();
+		caster.Static = entity.IsStaticCaster();
+	}
+	shadowCache.Update(shadowCascades, shadowCasters);
 }
 
-void Game::CreateLightViewMatrix(Light light) {
-	XMMATRIX lightView = XMMatrixLookToLH(
-			-XMVECTOR({ light.Direction.x, light.Direction.y, light.Direction.z }) * 20, // Position: "Backing up" 20 units from origin
-			XMVECTOR({ light.Direction.x, light.Direction.y, light.Direction.z }),		 // Direction: light's direction
-			XMVectorSet(0, 1, 0, 0)); // Up: World up vector (Y axis)
-	XMStoreFloat4x4(&lightViewMatrix, lightView);
+// Writes every texel of one tile of the atlas with a full screen
+// depth only shader, the copy or the clear, and leaves the tile
+// set up for casters to be drawn into
+void Game::FillShadowTile(const ShadowAtlasRect& tile, std::shared_ptr<SimplePixelShader> ps) {
+	ID3D11RenderTargetView* nullRTV = {};
+	D3D11_VIEWPORT viewport = {};
+	viewport.TopLeftX = (float)tile.X;
+	viewport.TopLeftY = (float)tile.Y;
+	viewport.Width = (float)tile.Size;
+	viewport.Height = (float)tile.Size;
+	viewport.MaxDepth = 1.0f;
+	Graphics::GfxContext->RSSetViewports(1, &viewport);
+	Graphics::GfxContext->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get());
+	Graphics::GfxContext->OMSetDepthStencilState(shadowCopyDepthState.Get(), 0);
+	Graphics::GfxContext->RSSetState(0);
+	ppVS->SetShader();
+	ps->SetShader();
+	Graphics::GfxContext->Draw(3, 0);
+	Graphics::GfxContext->OMSetDepthStencilState(0, 0);
 }
 
-void Game::CreateLightProjectionMatrix(Light light) {
-	lightProjectionSize = 15.0f; // Tweak for your scene!
-	XMMATRIX lightProjection;
+// Draws entities' meshes with the shadow shaders, into whatever
+// tile's matrix is in the ShadowPass buffer
+void Game::DrawShadowCasters(const std::vector<unsigned int>& casters) {
+	if (casters.empty())
+		return;
+
+	Graphics::GfxContext->PSSetShader(0, 0, 0);
+	Graphics::GfxContext->RSSetState(shadowRasterizer.Get());
+	shadowVS->SetShader();
+	for (unsigned int i : casters)
+	{
+		objectConstants->Data.world = models->at(i).GetTransform()->GetWorldMatrix();
+		objectConstants->Upload();
+		// Draw the mesh directly to avoid the entity's material
+		models->at(i).GetMesh()->Draw();
+	}
+}
 
-	lightProjection = XMMatrixOrthographicLH(
-		lightProjectionSize,
-		lightProjectionSize,
-		1.0f,
-		100.0f);
-	XMStoreFloat4x4(&lightProjectionMatrix, lightProjection);
+// Fits the cascades to the active camera for the first light,
+// which is the one that gets them
+void Game::UpdateShadowCascades() {
+	XMFLOAT4X4 view = activeCamera->GetViewMatrix();
+	FitShadowCascades(
+		&view._11,
+		XMConvertToRadians(activeCamera->GetFOV()),
+		Window::AspectRatio(),
+		activeCamera->GetNearPlane(),
+		&lightsData[0].Direction.x,
+		shadowSettings,
+		shadowCascades);
+}
+
+// --------------------------------------------------------
+// Hands out this frame's tiles of the shadow atlas and works
+// out each one's matrices.  The first light's cascades always
+// come first, then other directional lights, then point and
+// spot lights by how many of the scene's pixels (at the size
+// it's drawn) their range covers, which sizes their tiles
+// too.  A light that doesn't get every tile it asked for
+// goes unshadowed.
+// --------------------------------------------------------
+void Game::UpdateShadowAtlas() {
+	std::vector<Light> allLights = lightsData;
+	if (useClusteredLights)
+		allLights.insert(allLights.end(), extraLights.begin(), extraLights.end());
+	lightShadowTiles.assign(allLights.size(), -1);
+
+	XMFLOAT4X4 view = activeCamera->GetViewMatrix();
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+	float fovY = XMConvertToRadians(activeCamera->GetFOV());
+	float pixelsPerUnit = renderSize.Height * 0.5f / tanf(fovY * 0.5f); // At a distance of one
+
+	struct Candidate
+	{
+		unsigned int Light;
+		float Pixels;	// Across the screen
+	};
+	std::vector<Candidate> candidates;
+	bool cascaded = !lightsData.empty() && lightsData[0].Type == LIGHT_TYPE_DIRECTION;
+	for (unsigned int i = cascaded ? 1 : 0; i < (unsigned int)allLights.size(); i++)
+	{
+		const Light& light = allLights[i];
+		if (light.Intensity <= 0.0f)
+			continue;
+		if (light.Type == LIGHT_TYPE_DIRECTION)
+		{
+			candidates.push_back({ i, D3D11_FLOAT32_MAX });
+			continue;
+		}
+
+		// Nothing to shadow if its range is all behind the camera
+		XMVECTOR position = XMVector3Transform(XMLoadFloat3(&light.Position), viewMatrix);
+		if (light.Range <= 0.0f || XMVectorGetZ(position) + light.Range <= 0.0f)
+			continue;
+		float distance = XMVectorGetX(XMVector3Length(position));
+		candidates.push_back({ i, distance <= light.Range ? D3D11_FLOAT32_MAX : 2.0f * light.Range * pixelsPerUnit / distance });
+	}
+	std::stable_sort(candidates.begin(), candidates.end(),
+		[](const Candidate& a, const Candidate& b) { return a.Pixels > b.Pixels; });
+
+	// Keys are the light's index and which of its tiles it is
+	std::vector<ShadowTileRequest> requests;
+	if (cascaded)
+	{
+		for (unsigned int c = 0; c < ShadowCascadeCount; c++)
+			requests.push_back({ c, shadowSettings.Resolution });
+	}
+	for (const Candidate& candidate : candidates)
+	{
+		// Each cube face of a point light covers about half of it
+		const Light& light = allLights[candidate.Light];
+		unsigned int faces = light.Type == LIGHT_TYPE_POINT ? 6 : 1;
+		if (requests.size() + faces > MaxShadowTiles)
+			continue;
+
+		float pixels = light.Type == LIGHT_TYPE_POINT ? candidate.Pixels * 0.5f : candidate.Pixels;
+		unsigned int size = (unsigned int)min(pixels, (float)shadowSettings.Resolution);
+		for (unsigned int face = 0; face < faces; face++)
+			requests.push_back({ candidate.Light * 8 + face, size });
+	}
+
+	std::vector<ShadowAtlasRect> tiles;
+	shadowAtlas.Allocate(requests, tiles);
+	for (unsigned int r = 0; r < (unsigned int)requests.size(); r++)
+	{
+		if (requests[r].Key % 8 == 0)
+			lightShadowTiles[requests[r].Key / 8] = (int)r;
+	}
+	for (unsigned int r = 0; r < (unsigned int)requests.size(); r++)
+	{
+		if (tiles[r].Size == 0)
+			lightShadowTiles[requests[r].Key / 8] = -1;
+	}
+
+	// Each tile's matrix is fitted to the size it was given
+	ShadowAtlasConstants& atlas = shadowAtlasConstants->Data;
+	atlas = {};
+	shadowViews.assign(requests.size(), ShadowView());
+	for (unsigned int r = 0; r < (unsigned int)requests.size(); r++)
+	{
+		unsigned int lightIndex = requests[r].Key / 8;
+		unsigned int face = requests[r].Key % 8;
+		const Light& light = allLights[lightIndex];
+		const ShadowAtlasRect& tile = tiles[r];
+		ShadowView& shadowView = shadowViews[r];
+		shadowView.Rect = {};
+		shadowView.Cascade = -1;
+		if (lightShadowTiles[lightIndex] < 0)
+			continue;
+
+		bool fitted = true;
+		if (cascaded && lightIndex == 0)
+		{
+			memcpy(shadowView.ViewProjection, shadowCascades.Cascades[face].ViewProjection, sizeof(shadowView.ViewProjection));
+			shadowView.Cascade = (int)face;
+		}
+		else if (light.Type == LIGHT_TYPE_DIRECTION)
+			fitted = FitDirectionalShadow(&view._11, fovY, Window::AspectRatio(), activeCamera->GetNearPlane(),
+				&light.Direction.x, shadowSettings, tile.Size, shadowView.ViewProjection);
+		else if (light.Type == LIGHT_TYPE_SPOT)
+			fitted = SpotShadowMatrix(&light.Position.x, &light.Direction.x, light.SpotOuterAngle, light.Range,
+				tile.Size, shadowView.ViewProjection);
+		else
+			fitted = PointShadowMatrix(&light.Position.x, face, light.Range, tile.Size, shadowView.ViewProjection);
+
+		// Only single tile lights can fail, on a zero direction
+		if (!fitted)
+		{
+			lightShadowTiles[lightIndex] = -1;
+			continue;
+		}
+
+		// Samples stay half a texel inside, so filtering never
+		// reads the tile next door
+		shadowView.Rect = tile;
+		ShadowTileTransform(shadowView.ViewProjection, tile, shadowAtlasSize, &atlas.shadowTileMatrices[r]._11);
+		float texel = 1.0f / shadowAtlasSize;
+		atlas.shadowTileBounds[r] = XMFLOAT4(
+			(tile.X + 0.5f) * texel,
+			(tile.Y + 0.5f) * texel,
+			(tile.X + tile.Size - 0.5f) * texel,
+			(tile.Y + tile.Size - 0.5f) * texel);
+	}
+
+	// Cached depth is only copied in when it changes, so a
+	// cascade that moved to another tile needs it all again
+	bool moved = false;
+	for (unsigned int c = 0; c < ShadowCascadeCount; c++)
+	{
+		ShadowAtlasRect rect = cascaded ? shadowViews[c].Rect : ShadowAtlasRect{};
+		moved |= rect.X != cascadeRects[c].X || rect.Y != cascadeRects[c].Y || rect.Size != cascadeRects[c].Size;
+		cascadeRects[c] = rect;
+	}
+	if (moved)
+		shadowCache.Invalidate();
 }
 
 void Game::CreatePPResources() {
@@ -879,47 +1701,384 @@ void Game::CreatePPResources() {
 	ppSampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
 	ppSampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
 	ppSampDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	Graphics::Device->CreateSamplerState(&ppSampDesc, ppSampler.GetAddressOf());
-
-	// Describe the texture we're creating
-	D3D11_TEXTURE2D_DESC textureDesc = {};
-	textureDesc.Width = Window::Width();
-	textureDesc.Height = Window::Height();
-	textureDesc.ArraySize = 1;
-	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-	textureDesc.CPUAccessFlags = 0;
-	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	textureDesc.MipLevels = 1;
-	textureDesc.MiscFlags = 0;
-	textureDesc.SampleDesc.Count = 1;
-	textureDesc.SampleDesc.Quality = 0;
-	textureDesc.Usage = D3D11_USAGE_DEFAULT;
-
-	// Create the resource (no need to track it after the views are created below)
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> ppTexture;
-	Graphics::Device->CreateTexture2D(&textureDesc, 0, ppTexture.GetAddressOf());
-
-	// Create the Render Target View
-	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-	rtvDesc.Format = textureDesc.Format;
-	rtvDesc.Texture2D.MipSlice = 0;
-	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-	Graphics::Device->CreateRenderTargetView(
-		ppTexture.Get(),
-		&rtvDesc,
-		ppRTV.ReleaseAndGetAddressOf());
-
-	// Create the Shader Resource View
-	// By passing it a null description for the SRV, we
-	// get a "default" SRV that has access to the entire resource
-	Graphics::Device->CreateShaderResourceView(
-		ppTexture.Get(),
-		0,
-		ppSRV.ReleaseAndGetAddressOf());
+	Graphics::GfxDevice->CreateSamplerState(&ppSampDesc, ppSampler.GetAddressOf());
+
+	// Additive blend, for passes drawn onto what they add to
+	D3D11_BLEND_DESC blendDesc = {};
+	blendDesc.RenderTarget[0].BlendEnable = true;
+	blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	Graphics::GfxDevice->CreateBlendState(&blendDesc, ppAdditiveBlend.GetAddressOf());
+
+	// Where the scene's luminance is copied to be read back,
+	// one for each frame a copy is in flight
+	D3D11_TEXTURE2D_DESC readbackDesc = {};
+	readbackDesc.Width = LuminanceWidth;
+	readbackDesc.Height = LuminanceHeight;
+	readbackDesc.MipLevels = 1;
+	readbackDesc.ArraySize = 1;
+	readbackDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	readbackDesc.SampleDesc.Count = 1;
+	readbackDesc.Usage = D3D11_USAGE_STAGING;
+	readbackDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	luminanceReadbacks.resize(LuminanceReadbackFrames);
+	for (Microsoft::WRL::ComPtr<ID3D11Texture2D>& readback : luminanceReadbacks)
+		Graphics::GfxDevice->CreateTexture2D(&readbackDesc, 0, readback.GetAddressOf());
+
+	// The grade's table, filled whenever it's baked
+	D3D11_TEXTURE3D_DESC lutDesc = {};
+	lutDesc.Width = ColorLutSize;
+	lutDesc.Height = ColorLutSize;
+	lutDesc.Depth = ColorLutSize;
+	lutDesc.MipLevels = 1;
+	lutDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	lutDesc.Usage = D3D11_USAGE_DEFAULT;
+	lutDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	Graphics::GfxDevice->CreateTexture3D(&lutDesc, 0, gradingLut.GetAddressOf());
+	Graphics::GfxDevice->CreateShaderResourceView(gradingLut.Get(), 0, gradingLutSRV.GetAddressOf());
 }
 
+// --------------------------------------------------------
+// Nothing's held between frames, so every target is free
+// here; the old sizes are dropped now rather than waiting
+// for the pool to age them out
+// --------------------------------------------------------
 void Game::ResetScreenTargets() {
-	ppRTV.Reset();
-	ppSRV.Reset();
-	CreatePPResources();
+	renderTargets->ReleaseUnused();
+}
+
+// --------------------------------------------------------
+// The effects, in the order they're drawn.  Per pixel ones
+// must stay in the order PostFusedPixelShader.hlsl draws
+// them in, for when they're fused.  Every effect starts at
+// its identity, so nothing but the grade is drawn until one
+// is changed.
+// --------------------------------------------------------
+void Game::CreatePostEffects()
+{
+	postEffects.assign(PostEffectCount, PostEffect());
+
+	// Off until it has some intensity, whatever the rest say
+	PostEffect& bloom = postEffects[PostBloom];
+	BloomSettings bloomDefaults;
+	bloom.Name = "Bloom";
+	bloom.Kind = PostEffectKind::Gather;
+	bloom.Passes = BloomPasses();
+	bloom.Params = {
+		{ "Intensity", 0.0f, 0.0f, 2.0f, 0.0f, false, true },
+		{ "Threshold", bloomDefaults.Threshold, 0.0f, 4.0f, 1.0f, false },
+		{ "Spread", bloomDefaults.Spread, 0.0f, 1.0f, 0.0f, false } };
+
+	PostEffect& pixelate = postEffects[PostPixelate];
+	pixelate.Name = "Pixelate";
+	pixelate.Kind = PostEffectKind::Resample;
+	pixelate.Params = { { "Pixel Size", 1.0f, 1.0f, 32.0f, 1.0f, true } };
+
+	PostEffect& blur = postEffects[PostBlur];
+	blur.Name = "Blur";
+	blur.Kind = PostEffectKind::Gather;
+	blur.Passes.resize(2);	// Across, then down
+	blur.Params = { { "Radius", 0.0f, 0.0f, 20.0f, 0.0f, true } };
+
+	PostEffect& vignette = postEffects[PostVignette];
+	vignette.Name = "Vignette";
+	vignette.Kind = PostEffectKind::PerPixel;
+	vignette.Params = { { "Strength", 0.0f, 0.0f, 2.0f, 0.0f, false } };
+
+	// Takes the HDR scene to the screen, so it's always drawn
+	PostEffect& grade = postEffects[PostGrade];
+	ColorGradeSettings gradeDefaults;
+	grade.Name = "Color Grade";
+	grade.Kind = PostEffectKind::PerPixel;
+	grade.Required = true;
+	grade.Params = {
+		{ "Curve (ACES, Reinhard)", 0.0f, 0.0f, (float)TonemapCurve::Count - 1.0f, 0.0f, true },
+		{ "White Point", gradeDefaults.WhitePoint, 1.0f, ColorLutRange, gradeDefaults.WhitePoint, false },
+		{ "Tint Red", 1.0f, 0.0f, 1.0f, 1.0f, false },
+		{ "Tint Green", 1.0f, 0.0f, 1.0f, 1.0f, false },
+		{ "Tint Blue", 1.0f, 0.0f, 1.0f, 1.0f, false },
+		{ "Saturation", 1.0f, 0.0f, 2.0f, 1.0f, false },
+		{ "Contrast", 1.0f, 0.0f, 2.0f, 1.0f, false },
+		{ "Gamma", 1.0f, 0.5f, 2.0f, 1.0f, false } };
+}
+
+// --------------------------------------------------------
+// Picks the scale to draw the scene at, from the last
+// frame's time when the controller is on.  The grade is
+// required, so there's always a pass to scale it up in.
+//
+// The GPU's time for a frame is the work alone.  Until there
+// is one (or if the timer can't tell) it goes by the whole
+// frame's, which with vsync on is whole refresh intervals.
+// --------------------------------------------------------
+void Game::UpdateRenderSize(float deltaTime)
+{
+	if (dynamicResolution)
+	{
+		resolutionFrameMs = deltaTime * 1000.0f;
+		resolutionGpuTimed = gpuFrameTimer->GetFrameMs(resolutionFrameMs);
+		bool vsynced = !resolutionGpuTimed && Graphics::SwapChain && Graphics::VsyncState();
+		resolutionSettings.RefreshMs = vsynced ? refreshMs : 0.0f;
+		renderScale = resolutionController.Update(resolutionFrameMs, resolutionSettings);
+	}
+	else
+	{
+		renderScale = QuantizeRenderScale(fixedRenderScale, resolutionSettings);
+		resolutionController.Reset();
+	}
+	renderSize = PostTargetSize((unsigned int)Window::Width(), (unsigned int)Window::Height(), renderScale);
+}
+
+// --------------------------------------------------------
+// Plans this frame's chain at the render size, and takes a
+// target of each size it needs from the pool
+// --------------------------------------------------------
+void Game::UpdatePostChain()
+{
+	UpdateBlurKernel();
+	UpdateGradingLut();
+	PlanPostChain(postEffects, renderSize.Width, renderSize.Height, FormatBitsPerPixel(hdrFormat) / 8, postPlan);
+
+	ppTargets.clear();
+	for (const PostTarget& size : postPlan.Targets)
+	{
+		RenderTargetDesc desc;
+		desc.Width = size.Width;
+		desc.Height = size.Height;
+		desc.Format = hdrFormat;
+		ppTargets.push_back(renderTargets->Acquire(desc));
+	}
+
+	// The window's depth buffer only fits a scene its size
+	sceneDepth.reset();
+	if (postPlan.SceneTarget != PostBackBuffer) {
+		const PostTarget& scene = postPlan.Targets[postPlan.SceneTarget];
+		if (scene.Width != (unsigned int)Window::Width() || scene.Height != (unsigned int)Window::Height()) {
+			RenderTargetDesc desc;
+			desc.Width = scene.Width;
+			desc.Height = scene.Height;
+			desc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+			desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+			sceneDepth = renderTargets->Acquire(desc);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Works the blur's weights out again, only when the radius
+// has changed since last time (or to fill the buffer at first)
+// --------------------------------------------------------
+void Game::UpdateBlurKernel(bool force)
+{
+	unsigned int radius = (unsigned int)max(postEffects[PostBlur].Params[0].Value, 0.0f);
+	if (radius == blurKernel.Radius && !force)
+		return;
+
+	ComputeBlurKernel(radius, blurKernel);
+	for (unsigned int t = 0; t < MaxBlurTaps; t++)
+		blurConstants->Data.blurTaps[t] = XMFLOAT4(blurKernel.Offsets[t], blurKernel.Weights[t], 0, 0);
+	blurConstants->Data.tapCount = (int)blurKernel.TapCount;
+}
+
+// --------------------------------------------------------
+// Bakes the grade's table again, only when one of its
+// settings has changed since it was last baked
+// --------------------------------------------------------
+void Game::UpdateGradingLut()
+{
+	const std::vector<PostEffectParam>& params = postEffects[PostGrade].Params;
+	ColorGradeSettings grade;
+	grade.Curve = (TonemapCurve)(int)params[GradeCurve].Value;
+	grade.WhitePoint = params[GradeWhitePoint].Value;
+	grade.Tint[0] = params[GradeTintRed].Value;
+	grade.Tint[1] = params[GradeTintGreen].Value;
+	grade.Tint[2] = params[GradeTintBlue].Value;
+	grade.Saturation = params[GradeSaturation].Value;
+	grade.Contrast = params[GradeContrast].Value;
+	grade.Gamma = params[GradeGamma].Value;
+	if (gradingLutBaked && grade == bakedGrade)
+		return;
+
+	BakeColorLut(grade, gradingLutData);
+	Graphics::GfxContext->UpdateSubresource(gradingLut.Get(), 0, 0, gradingLutData.data(),
+		ColorLutSize * 4, ColorLutSize * ColorLutSize * 4);
+	bakedGrade = grade;
+	gradingLutBaked = true;
+	gradingLutBakes++;
+}
+
+// --------------------------------------------------------
+// One pass of the chain: a step of the bloom's pyramid, the
+// blur in one direction, or every other effect in it through
+// the fused shader
+// --------------------------------------------------------
+void Game::DrawPostPass(const PostPass& pass)
+{
+	PostTarget size = pass.Output == PostBackBuffer ?
+		PostTarget{ (unsigned int)Window::Width(), (unsigned int)Window::Height() } :
+		postPlan.Targets[pass.Output];
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)size.Width;
+	viewport.Height = (float)size.Height;
+	viewport.MaxDepth = 1.0f;
+	Graphics::GfxContext->RSSetViewports(1, &viewport);
+	Graphics::GfxContext->OMSetRenderTargets(1,
+		pass.Output == PostBackBuffer ? Graphics::BackBufferRTV.GetAddressOf() : ppTargets[pass.Output]->RTV.GetAddressOf(), 0);
+
+	const PostTarget& input = postPlan.Targets[pass.Inputs[0]];
+	if (!pass.Effects.empty() && pass.Effects[0] == PostBloom)
+	{
+		const std::vector<PostEffectParam>& params = postEffects[PostBloom].Params;
+		BloomStep step = BloomPassStep(pass.Pass);
+		if (step == BloomStep::Prefilter || step == BloomStep::Downsample)
+		{
+			bloomDownsampleConstants->Data.sourceTexel = XMFLOAT2(1.0f / input.Width, 1.0f / input.Height);
+			bloomDownsampleConstants->Data.threshold = params[BloomThreshold].Value;
+			bloomDownsampleConstants->Data.prefilter = step == BloomStep::Prefilter;
+			bloomDownsampleConstants->Upload();
+
+			bloomDownsamplePS->SetShader();
+			bloomDownsamplePS->SetShaderResourceView("Pixels", ppTargets[pass.Inputs[0]]->SRV);
+			bloomDownsamplePS->SetSamplerState("ClampSampler", ppSampler);
+			Graphics::GfxContext->Draw(3, 0); // Draw exactly 3 vertices (one triangle)
+			return;
+		}
+
+		// Up a level, or onto the image, scaled so the levels add
+		// up to the intensity.  Blended onto its base when the plan
+		// drew it in place, otherwise the base is read and added.
+		float spread = params[BloomSpread].Value;
+		bloomUpsampleConstants->Data.sourceTexel = XMFLOAT2(1.0f / input.Width, 1.0f / input.Height);
+		bloomUpsampleConstants->Data.upsampleWeight = step == BloomStep::Composite ?
+			params[BloomIntensity].Value / BloomNormalization(spread) :
+			spread;
+		bloomUpsampleConstants->Data.addBase = !pass.Additive;
+		bloomUpsampleConstants->Upload();
+
+		bloomUpsamplePS->SetShader();
+		bloomUpsamplePS->SetShaderResourceView("Pixels", ppTargets[pass.Inputs[0]]->SRV);
+		bloomUpsamplePS->SetShaderResourceView("Base", pass.Additive ? 0 : ppTargets[pass.Inputs[1]]->SRV);
+		bloomUpsamplePS->SetSamplerState("ClampSampler", ppSampler);
+		if (pass.Additive)
+			Graphics::GfxContext->OMSetBlendState(ppAdditiveBlend.Get(), 0, 0xFFFFFFFF);
+		Graphics::GfxContext->Draw(3, 0); // Draw exactly 3 vertices (one triangle)
+		if (pass.Additive)
+			Graphics::GfxContext->OMSetBlendState(0, 0, 0xFFFFFFFF);
+		return;
+	}
+
+	if (!pass.Effects.empty() && pass.Effects[0] == PostBlur)
+	{
+		blurConstants->Data.texelStep = pass.Pass == 1 ?
+			XMFLOAT2(0, 1.0f / input.Height) :
+			XMFLOAT2(1.0f / input.Width, 0);
+		blurConstants->Upload();
+
+		blurPS->SetShader();
+		blurPS->SetShaderResourceView("Pixels", ppTargets[pass.Inputs[0]]->SRV);
+		blurPS->SetSamplerState("ClampSampler", ppSampler);
+		Graphics::GfxContext->Draw(3, 0); // Draw exactly 3 vertices (one triangle)
+		return;
+	}
+
+	PostFusedConstants& fused = postFusedConstants->Data;
+	fused.postEffects = 0;
+	for (unsigned int effect : pass.Effects)
+	{
+		const std::vector<PostEffectParam>& params = postEffects[effect].Params;
+		switch (effect)
+		{
+		case PostPixelate:
+			// In the window's pixels, whatever size the scene is drawn at
+			fused.postEffects |= PostFusedPixelate;
+			fused.pixelCells = XMFLOAT2(Window::Width() / params[0].Value, Window::Height() / params[0].Value);
+			break;
+		case PostVignette:
+			fused.postEffects |= PostFusedVignette;
+			fused.vignette = params[0].Value;
+			break;
+		case PostGrade:
+			fused.postEffects |= PostFusedGrade;
+			fused.exposure = exposure;
+			break;
+		}
+	}
+	postFusedConstants->Upload();
+
+	postFusedPS->SetShader();
+	postFusedPS->SetShaderResourceView("Pixels", ppTargets[pass.Inputs[0]]->SRV);
+	postFusedPS->SetShaderResourceView("GradingLut", gradingLutSRV);
+	postFusedPS->SetSamplerState("ClampSampler", ppSampler);
+	Graphics::GfxContext->Draw(3, 0); // Draw exactly 3 vertices (one triangle)
+}
+
+// --------------------------------------------------------
+// Draws the scene's luminance down to a small target and
+// copies it into the oldest texture of the readback ring
+// --------------------------------------------------------
+void Game::MeasureLuminance(std::shared_ptr<PooledRenderTarget> scene)
+{
+	RenderTargetDesc desc;
+	desc.Width = LuminanceWidth;
+	desc.Height = LuminanceHeight;
+	desc.Format = DXGI_FORMAT_R32_FLOAT;
+	std::shared_ptr<PooledRenderTarget> target = renderTargets->Acquire(desc);
+	if (!target || luminanceReadbacks.empty())
+		return;
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)LuminanceWidth;
+	viewport.Height = (float)LuminanceHeight;
+	viewport.MaxDepth = 1.0f;
+	Graphics::GfxContext->RSSetViewports(1, &viewport);
+	Graphics::GfxContext->OMSetRenderTargets(1, target->RTV.GetAddressOf(), 0);
+
+	// Its grid of taps spreads over each pixel's footprint
+	luminanceConstants->Data.tapStep = XMFLOAT2(0.25f / LuminanceWidth, 0.25f / LuminanceHeight);
+	luminanceConstants->Upload();
+
+	luminancePS->SetShader();
+	luminancePS->SetShaderResourceView("Pixels", scene->SRV);
+	luminancePS->SetSamplerState("ClampSampler", ppSampler);
+	Graphics::GfxContext->Draw(3, 0); // Draw exactly 3 vertices (one triangle)
+
+	ID3D11Texture2D* readback = luminanceReadbacks[luminanceCopies % LuminanceReadbackFrames].Get();
+	Graphics::GfxContext->CopySubresourceRegion(readback, 0, 0, 0, 0, target->Texture.Get(), 0, 0);
+	luminanceCopies++;
+}
+
+// --------------------------------------------------------
+// Reads back the oldest luminance copy and eases the exposure
+// towards what its histogram asks for.  Nothing waits on the
+// GPU: if that copy isn't done yet, the exposure keeps easing
+// towards the last histogram instead.
+// --------------------------------------------------------
+void Game::UpdateExposure(float deltaTime)
+{
+	LuminanceHistogram histogram;
+	if (luminanceCopies >= LuminanceReadbackFrames)
+	{
+		ID3D11Texture2D* oldest = luminanceReadbacks[luminanceCopies % LuminanceReadbackFrames].Get();
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (SUCCEEDED(Graphics::GfxContext->Map(oldest, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)))
+		{
+			BuildLuminanceHistogram(mapped.pData, LuminanceWidth, LuminanceHeight, mapped.RowPitch, exposureSettings, histogram);
+			Graphics::GfxContext->Unmap(oldest, 0);
+			luminanceHistogram = histogram;
+		}
+	}
+
+	// By hand, the compensation is the whole exposure
+	if (autoExposure)
+		exposure = exposureController.Update(histogram, exposureSettings, deltaTime);
+	else
+	{
+		exposure = exp2f(exposureSettings.Compensation);
+		exposureController.Reset();
+	}
 }
\ No newline at end of file
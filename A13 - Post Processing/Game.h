@@ -6,6 +6,17 @@
 #include <vector>
 #include "GameEntity.h"
 #include "Lights.h"
+#include "ShadowCasterCache.h"
+#include "ShadowAtlas.h"
+#include "GaussianBlur.h"
+#include "PostProcessChain.h"
+#include "RenderTargetPool.h"
+#include "AutoExposure.h"
+#include "ColorGrading.h"
+#include "DynamicResolution.h"
+#include "GpuFrameTimer.h"
+
+class ClusteredLights;
 
 class Game
 {
@@ -28,11 +39,30 @@ public:
 	void AddObjects(std::shared_ptr<Material> material, float offset);
 	const char* GetLightType(int Type);
 	void CreateLights();
+	void UpdateShaderVariants();
+	void EnableClusteredLighting(unsigned int extraLights);
+	void CreateExtraLights(unsigned int count);
+	const ClusteredLights* GetClusteredLights() const;
 	void CreateShadowMap();
-	void CreateLightViewMatrix(Light light);
-	void CreateLightProjectionMatrix(Light light);
+	void UpdateShadowCascades();
+	void UpdateShadowAtlas();
+	void UpdateShadowCasters();
+	void FillShadowTile(const ShadowAtlasRect& tile, std::shared_ptr<SimplePixelShader> ps);
+	void DrawShadowCasters(const std::vector<unsigned int>& casters);
+	const ShadowCasterCache& GetShadowCache() const { return shadowCache; }
+	const ShadowAtlasAllocator& GetShadowAtlas() const { return shadowAtlas; }
 	void CreatePPResources();
 	void ResetScreenTargets();
+	void CreatePostEffects();
+	void UpdateRenderSize(float deltaTime);
+	void UpdatePostChain();
+	void UpdateBlurKernel(bool force = false);
+	void UpdateGradingLut();
+	void DrawPostPass(const PostPass& pass);
+	void MeasureLuminance(std::shared_ptr<PooledRenderTarget> scene);
+	void UpdateExposure(float deltaTime);
+	const PostChainPlan& GetPostPlan() const { return postPlan; }
+	const RenderTargetPool& GetRenderTargets() const { return *renderTargets; }
 
 private:
 
@@ -55,21 +85,97 @@ private:
 	std::vector<Light> lightsData;
 
 	// Shadow Map Variables
+	// - One atlas holds every shadowed light's tiles, the first
+	//   light's cascades included, see ShadowAtlas.h
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
-	DirectX::XMFLOAT4X4 lightViewMatrix;
-	DirectX::XMFLOAT4X4 lightProjectionMatrix;
-	float lightProjectionSize;
+	ShadowCascadeSettings shadowSettings;
+	ShadowCascades shadowCascades = {};
+	unsigned int shadowAtlasSize = 4096;
+	bool shadowDepth16 = false;	// Half the memory, for less depth precision
+
+	// One tile of the atlas to draw this frame
+	struct ShadowView
+	{
+		float ViewProjection[16];
+		ShadowAtlasRect Rect;
+		int Cascade;	// Or -1, for any other light's tile
+	};
+	ShadowAtlasAllocator shadowAtlas;
+	std::vector<ShadowView> shadowViews;
+	std::vector<int> lightShadowTiles;	// Each light's first tile, or -1, lightsData then extraLights
+	ShadowAtlasRect cascadeRects[ShadowCascadeCount] = {};
+	std::shared_ptr<SimplePixelShader> shadowClearPS;
+
+	// Static casters' depth, one texture per cascade, copied into
+	// the atlas before dynamic casters are drawn over it
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> staticShadowDSVs[ShadowCascadeCount];
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> staticShadowSRVs[ShadowCascadeCount];
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> shadowCopyDepthState;
+	std::shared_ptr<SimplePixelShader> shadowCopyPS;
+	std::vector<ShadowCaster> shadowCasters;	// One per entity, in the same order
+	ShadowCasterCache shadowCache;
 
 	// Resources that are shared among all post processes
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> ppSampler;
 	std::shared_ptr<SimpleVertexShader> ppVS;
 
-	// Resources that are tied to a blur post process
-	std::shared_ptr<SimplePixelShader> ppPS;
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> ppRTV; // For rendering
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ppSRV; // For sampling
+	// The post process chain, and this frame's plan for it.  The
+	// scene is drawn into one of the plan's targets (or straight
+	// to the back buffer), see PostProcessChain.h.  The targets
+	// are taken from the pool each frame and handed back after.
+	std::vector<PostEffect> postEffects;
+	PostChainPlan postPlan;
+	std::shared_ptr<RenderTargetPool> renderTargets;
+	std::vector<std::shared_ptr<PooledRenderTarget>> ppTargets; // By the plan's index
+
+	// Resources that are tied to the effects
+	std::shared_ptr<SimplePixelShader> blurPS;
+	std::shared_ptr<SimplePixelShader> postFusedPS; // Every effect of one sample or less
+	std::shared_ptr<SimplePixelShader> bloomDownsamplePS;
+	std::shared_ptr<SimplePixelShader> bloomUpsamplePS;
+	Microsoft::WRL::ComPtr<ID3D11BlendState> ppAdditiveBlend; // For bloom's levels, added onto each other
+	BlurKernel blurKernel;	// Only recomputed when the radius changes
+
+	// HDR: the scene and every target before the tonemap are in
+	// hdrFormat.  A small copy of the scene's luminance is read
+	// back through a ring of staging textures, a few frames late,
+	// and its histogram sets the exposure the tonemap uses.
+	DXGI_FORMAT hdrFormat = DXGI_FORMAT_R11G11B10_FLOAT;
+	std::shared_ptr<SimplePixelShader> luminancePS;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11Texture2D>> luminanceReadbacks;
+	unsigned int luminanceCopies = 0;	// Copied into the ring so far
+	LuminanceHistogram luminanceHistogram;	// The last one read back
+	ExposureSettings exposureSettings;
+	ExposureController exposureController;
+	bool autoExposure = true;
+	float exposure = 1.0f;
+
+	// The color grade, baked into a 3D table whenever one of its
+	// settings changes (see ColorGrading.h)
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> gradingLut;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> gradingLutSRV;
+	std::vector<unsigned char> gradingLutData;
+	ColorGradeSettings bakedGrade;	// What's in the table now
+	bool gradingLutBaked = false;
+	unsigned int gradingLutBakes = 0;
+
+	// Dynamic resolution: the scene is drawn at renderSize, a
+	// fraction of the window's, and the chain's last pass scales
+	// it up (see DynamicResolution.h).  With the controller off,
+	// it's drawn at a fixed scale instead.
+	DynamicResolutionSettings resolutionSettings;
+	ResolutionController resolutionController;
+	std::shared_ptr<GpuFrameTimer> gpuFrameTimer;
+	float refreshMs = 0.0f;			// The display's refresh interval, if known
+	float resolutionFrameMs = 0.0f;	// What the controller last went by
+	bool resolutionGpuTimed = false;
+	bool dynamicResolution = false;
+	float fixedRenderScale = 1.0f;
+	float renderScale = 1.0f;		// This frame's, quantized
+	PostTarget renderSize = {};
+	std::shared_ptr<PooledRenderTarget> sceneDepth;	// When the scene isn't the window's size
 };
 
@@ -2,28 +2,17 @@
 #include "Graphics.h"
 
 // Draw Entity
-void GameEntity::Draw(std::shared_ptr<Camera> camera) {
+// - Camera and lights are expected to be in the per frame buffer already
+// - objectConstants must already be bound to the material's vertex shader
+void GameEntity::Draw(std::shared_ptr<ConstantBuffer<PerObjectConstants>> objectConstants) {
 	// Prepare Material
 	material->PrepareMaterial();
 	
-	// Fill Shaders
-	std::shared_ptr<SimpleVertexShader> vertexShader = material->GetVS();
-	std::shared_ptr<SimplePixelShader> pixelShader = material->GetPS();
+	// Fill the per object buffer in one go
 	transform->CreateWorldMatrix();
-
-	pixelShader->SetFloat4("colorTint", material->GetTint());
-	pixelShader->SetFloat2("scale", {material->GetUVScale().at(0), material->GetUVScale().at(1)});
-	pixelShader->SetFloat2("offset", {material->GetUVOffset().at(0), material->GetUVOffset().at(1)});
-	pixelShader->SetFloat("roughness", material->GetRoughness());
-	pixelShader->SetFloat3("cameraPosition", camera->GetPosition());
-	vertexShader->SetMatrix4x4("world", transform->GetWorldMatrix());
-	vertexShader->SetMatrix4x4("worldInverseTranspose", transform->GetWorldInverseTransposeMatrix());
-	vertexShader->SetMatrix4x4("view", camera->GetViewMatrix());
-	vertexShader->SetMatrix4x4("projection", camera->GetProjectionMatrix());
-
-	// Copy Buffer Data
-	vertexShader->CopyAllBufferData();
-	pixelShader->CopyAllBufferData();
+	objectConstants->Data.world = transform->GetWorldMatrix();
+	objectConstants->Data.worldInverseTranspose = transform->GetWorldInverseTransposeMatrix();
+	objectConstants->Upload();
 
 	// Activate Shaders
 	material->GetVS()->SetShader();
@@ -6,6 +6,8 @@
 #include "Transform.h"
 #include "Camera.h"
 #include "Material.h"
+#include "ConstantBuffer.h"
+#include "ShaderStructs.h"
 
 class GameEntity {
 public:
@@ -21,12 +23,22 @@ public:
 	std::shared_ptr<Transform> GetTransform() { return transform; }
 	std::shared_ptr<Material> GetMaterial() { return material; }
 
+	// Shadow casting
+	// - Static casters stay in the cached shadow depth, which is
+	//   redrawn when one moves; dynamic ones are drawn every frame
+	bool CastsShadows() const { return castsShadows; }
+	bool IsStaticCaster() const { return staticCaster; }
+	void SetCastsShadows(bool casts) { castsShadows = casts; }
+	void SetStaticCaster(bool isStatic) { staticCaster = isStatic; }
+
 	// Methods
-	void Draw(std::shared_ptr<Camera> camera);
+	void Draw(std::shared_ptr<ConstantBuffer<PerObjectConstants>> objectConstants);
 
 private:
 	// Entity Data
 	std::shared_ptr<Transform> transform;
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
+	bool castsShadows = true;
+	bool staticCaster = true;
 };
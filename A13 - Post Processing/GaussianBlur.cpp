@@ -0,0 +1,219 @@
+#include "GaussianBlur.h"
+
+#include <emmintrin.h>
+#include <math.h>
+
+namespace
+{
+	// Normalized weights of one side of the kernel, center first
+	void GaussianWeights(unsigned int radius, double weights[MaxBlurRadius + 1])
+	{
+		double sigma = radius * 0.5;
+		double total = 0;
+		for (unsigned int i = 0; i <= radius; i++)
+		{
+			weights[i] = sigma > 0 ? exp(-(double)(i * i) / (2.0 * sigma * sigma)) : 1.0;
+			total += i == 0 ? weights[i] : 2.0 * weights[i];
+		}
+		for (unsigned int i = 0; i <= radius; i++)
+			weights[i] /= total;
+	}
+
+	int Clamp(int value, int low, int high)
+	{
+		return value < low ? low : value > high ? high : value;
+	}
+
+	const float* Texel(const BlurImage& image, int x, int y)
+	{
+		x = Clamp(x, 0, (int)image.Width - 1);
+		y = Clamp(y, 0, (int)image.Height - 1);
+		return &image.Pixels[((size_t)y * image.Width + x) * 4];
+	}
+
+	void Resize(const BlurImage& source, BlurImage& result)
+	{
+		result.Width = source.Width;
+		result.Height = source.Height;
+		result.Pixels.assign(source.Pixels.size(), 0.0f);
+	}
+}
+
+void SampleBlurImage(const BlurImage& image, float u, float v, float out[4])
+{
+	float x = u * image.Width - 0.5f;
+	float y = v * image.Height - 0.5f;
+	int x0 = (int)floorf(x);
+	int y0 = (int)floorf(y);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	const float* a = Texel(image, x0, y0);
+	const float* b = Texel(image, x0 + 1, y0);
+	const float* c = Texel(image, x0, y0 + 1);
+	const float* d = Texel(image, x0 + 1, y0 + 1);
+	for (int i = 0; i < 4; i++)
+	{
+		float top = a[i] + (b[i] - a[i]) * fx;
+		float bottom = c[i] + (d[i] - c[i]) * fx;
+		out[i] = top + (bottom - top) * fy;
+	}
+}
+
+void ComputeBlurKernel(unsigned int radius, BlurKernel& kernel)
+{
+	kernel = BlurKernel();
+	kernel.Radius = radius < MaxBlurRadius ? radius : MaxBlurRadius;
+
+	double weights[MaxBlurRadius + 1];
+	GaussianWeights(kernel.Radius, weights);
+	kernel.Weights[0] = (float)weights[0];
+
+	// Then texels 1 and 2 as one tap, 3 and 4, and so on.  An odd
+	// radius leaves the last on its own.
+	for (unsigned int i = 1; i <= kernel.Radius; i += 2)
+	{
+		double a = weights[i];
+		double b = i + 1 <= kernel.Radius ? weights[i + 1] : 0.0;
+		kernel.Offsets[kernel.TapCount] = (float)((i * a + (i + 1) * b) / (a + b));
+		kernel.Weights[kernel.TapCount] = (float)(a + b);
+		kernel.TapCount++;
+	}
+}
+
+void PixelateImage(const BlurImage& source, int pixelation, BlurImage& result)
+{
+	Resize(source, result);
+	float cells = (float)pixelation;
+	for (unsigned int y = 0; y < source.Height; y++)
+	{
+		for (unsigned int x = 0; x < source.Width; x++)
+		{
+			float u = (x + 0.5f) / source.Width;
+			float v = (y + 0.5f) / source.Height;
+			SampleBlurImage(source, roundf(u * cells) / cells, roundf(v * cells) / cells, &result.Pixels[((size_t)y * source.Width + x) * 4]);
+		}
+	}
+}
+
+void BlurImagePass(const BlurImage& source, const BlurKernel& kernel, bool vertical, BlurImage& result, bool allowSimd)
+{
+	Resize(source, result);
+
+	// Pixel centers land on texel centers, so a tap at a
+	// fractional offset only blends two texels along the pass
+	int last = vertical ? (int)source.Height - 1 : (int)source.Width - 1;
+	for (unsigned int y = 0; y < source.Height; y++)
+	{
+		for (unsigned int x = 0; x < source.Width; x++)
+		{
+			int center = vertical ? (int)y : (int)x;
+			auto texel = [&](int along) -> const float*
+			{
+				along = Clamp(along, 0, last);
+				return vertical ? Texel(source, x, along) : Texel(source, along, y);
+			};
+			float* out = &result.Pixels[((size_t)y * source.Width + x) * 4];
+
+			if (allowSimd)
+			{
+				__m128 total = _mm_mul_ps(_mm_loadu_ps(texel(center)), _mm_set1_ps(kernel.Weights[0]));
+				for (unsigned int t = 1; t < kernel.TapCount; t++)
+				{
+					__m128 weight = _mm_set1_ps(kernel.Weights[t]);
+					for (float side : { 1.0f, -1.0f })
+					{
+						float position = center + side * kernel.Offsets[t];
+						int first = (int)floorf(position);
+						__m128 fraction = _mm_set1_ps(position - first);
+						__m128 a = _mm_loadu_ps(texel(first));
+						__m128 b = _mm_loadu_ps(texel(first + 1));
+						__m128 sample = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fraction));
+						total = _mm_add_ps(total, _mm_mul_ps(sample, weight));
+					}
+				}
+				_mm_storeu_ps(out, total);
+				continue;
+			}
+
+			const float* middle = texel(center);
+			for (int i = 0; i < 4; i++)
+				out[i] = middle[i] * kernel.Weights[0];
+			for (unsigned int t = 1; t < kernel.TapCount; t++)
+			{
+				for (float side : { 1.0f, -1.0f })
+				{
+					float position = center + side * kernel.Offsets[t];
+					int first = (int)floorf(position);
+					float fraction = position - first;
+					const float* a = texel(first);
+					const float* b = texel(first + 1);
+					for (int i = 0; i < 4; i++)
+						out[i] += (a[i] + (b[i] - a[i]) * fraction) * kernel.Weights[t];
+				}
+			}
+		}
+	}
+}
+
+void BoxBlurImage(const BlurImage& source, int radius, int pixelation, BlurImage& result)
+{
+	Resize(source, result);
+	float cells = (float)pixelation;
+	for (unsigned int y = 0; y < source.Height; y++)
+	{
+		for (unsigned int x = 0; x < source.Width; x++)
+		{
+			float total[4] = {};
+			int sampleCount = 0;
+			for (int dx = -radius; dx <= radius; dx++)
+			{
+				for (int dy = -radius; dy <= radius; dy++)
+				{
+					float u = (x + 0.5f + dx) / source.Width;
+					float v = (y + 0.5f + dy) / source.Height;
+					float sample[4];
+					SampleBlurImage(source, roundf(u * cells) / cells, roundf(v * cells) / cells, sample);
+					for (int i = 0; i < 4; i++)
+						total[i] += sample[i];
+					sampleCount++;
+				}
+			}
+
+			float* out = &result.Pixels[((size_t)y * source.Width + x) * 4];
+			for (int i = 0; i < 4; i++)
+				out[i] = total[i] / sampleCount;
+		}
+	}
+}
+
+void GaussianBlurImage(const BlurImage& source, unsigned int radius, BlurImage& result)
+{
+	Resize(source, result);
+	radius = radius < MaxBlurRadius ? radius : MaxBlurRadius;
+	double weights[MaxBlurRadius + 1];
+	GaussianWeights(radius, weights);
+
+	int r = (int)radius;
+	for (unsigned int y = 0; y < source.Height; y++)
+	{
+		for (unsigned int x = 0; x < source.Width; x++)
+		{
+			double total[4] = {};
+			for (int dy = -r; dy <= r; dy++)
+			{
+				for (int dx = -r; dx <= r; dx++)
+				{
+					double weight = weights[dx < 0 ? -dx : dx] * weights[dy < 0 ? -dy : dy];
+					const float* texel = Texel(source, (int)x + dx, (int)y + dy);
+					for (int i = 0; i < 4; i++)
+						total[i] += texel[i] * weight;
+				}
+			}
+
+			float* out = &result.Pixels[((size_t)y * source.Width + x) * 4];
+			for (int i = 0; i < 4; i++)
+				out[i] = (float)total[i];
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// A separable Gaussian blur: one pass across the screen and
+// one down it, rather than a box done in a single pass.  Two
+// neighbouring weights share one bilinear sample, placed
+// between their texels by how much each weighs, so a radius
+// r pass reads about r + 1 samples instead of the 2r + 1 it
+// covers, and the whole blur 2(r + 1) instead of (2r + 1)^2.
+//
+// The weights are worked out here whenever the radius changes
+// and uploaded to BlurPixelShader.hlsl.  The rest is a CPU
+// copy of the post process passes (bilinear, clamped, like
+// the sampler they use) so they can be checked without a GPU.
+// --------------------------------------------------------
+
+// Widest blur, in pixels each way, and the most taps a pass
+// folds it into (MAX_BLUR_TAPS in BlurPixelShader.hlsl)
+const unsigned int MaxBlurRadius = 32;
+const unsigned int MaxBlurTaps = MaxBlurRadius / 2 + 1;
+
+// One side of a pass's kernel, mirrored on the other.  Tap 0
+// is the center texel on its own.
+struct BlurKernel
+{
+	unsigned int Radius = 0;
+	unsigned int TapCount = 1;
+	float Offsets[MaxBlurTaps] = {};		// In texels from the center
+	float Weights[MaxBlurTaps] = { 1.0f };	// Of each of the two samples at that offset
+};
+
+// --------------------------------------------------------
+// Gaussian weights out to the radius, normalized to add up to
+// one and folded in pairs.  Sigma is half the radius, which
+// spreads about as far as a box of the same radius.  Radius
+// 0 is a single tap: a straight copy.
+// --------------------------------------------------------
+void ComputeBlurKernel(unsigned int radius, BlurKernel& kernel);
+
+// A float RGBA image, row major
+struct BlurImage
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	std::vector<float> Pixels;	// Four floats a pixel
+};
+
+// A clamped, bilinear sample at a UV, as the GPU takes one
+void SampleBlurImage(const BlurImage& image, float u, float v, float out[4]);
+
+// The pixelation in PostFusedPixelShader.hlsl: each pixel
+// samples the point of a grid, pixelation cells each way,
+// its UV rounds to
+void PixelateImage(const BlurImage& source, int pixelation, BlurImage& result);
+
+// BlurPixelShader.hlsl, across or down.  The SIMD path does a
+// pixel's four channels at once with SSE, which every x64
+// CPU has.
+void BlurImagePass(const BlurImage& source, const BlurKernel& kernel, bool vertical, BlurImage& result, bool allowSimd = true);
+
+// The (2r + 1)^2 box blur the post process used to do, with
+// pixelation rounded into every sample, for comparison
+void BoxBlurImage(const BlurImage& source, int radius, int pixelation, BlurImage& result);
+
+// The same Gaussian done the slow way: in 2D, every texel, no
+// folding.  What the two passes should add up to.
+void GaussianBlurImage(const BlurImage& source, unsigned int radius, BlurImage& result);
@@ -0,0 +1,102 @@
+#include "GpuFrameTimer.h"
+
+GpuFrameTimer::GpuFrameTimer(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context) :
+	device(device),
+	context(context),
+	current(0),
+	timing(false),
+	hasTime(false),
+	lastMs(0.0f)
+{
+	ID3D11Device* d3dDevice = device->GetD3DDevice();
+	if (!d3dDevice)
+		return;
+
+	D3D11_QUERY_DESC disjointDesc = {};
+	disjointDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+	D3D11_QUERY_DESC timestampDesc = {};
+	timestampDesc.Query = D3D11_QUERY_TIMESTAMP;
+	for (FrameQueries& frame : frames)
+	{
+		d3dDevice->CreateQuery(&disjointDesc, frame.Disjoint.GetAddressOf());
+		d3dDevice->CreateQuery(&timestampDesc, frame.Start.GetAddressOf());
+		d3dDevice->CreateQuery(&timestampDesc, frame.End.GetAddressOf());
+	}
+}
+
+// --------------------------------------------------------
+// Reads back whatever frames the GPU has finished, then
+// starts timing this one.  If the GPU is so far behind that
+// this frame's queries are still in use, it goes untimed.
+// --------------------------------------------------------
+void GpuFrameTimer::BeginFrame()
+{
+	timing = false;
+	ID3D11DeviceContext* d3dContext = context->GetD3DContext();
+	if (!d3dContext)
+		return;
+
+	ReadFinishedFrames(d3dContext);
+
+	FrameQueries& frame = frames[current];
+	if (frame.Pending || !frame.Disjoint || !frame.Start || !frame.End)
+		return;
+
+	d3dContext->Begin(frame.Disjoint.Get());
+	d3dContext->End(frame.Start.Get());
+	timing = true;
+}
+
+// --------------------------------------------------------
+// Stops timing the frame; its time is read in a later one
+// --------------------------------------------------------
+void GpuFrameTimer::EndFrame()
+{
+	ID3D11DeviceContext* d3dContext = context->GetD3DContext();
+	if (!d3dContext || !timing)
+		return;
+
+	FrameQueries& frame = frames[current];
+	d3dContext->End(frame.End.Get());
+	d3dContext->End(frame.Disjoint.Get());
+	frame.Pending = true;
+	current = (current + 1) % GpuTimerFrames;
+	timing = false;
+}
+
+bool GpuFrameTimer::GetFrameMs(float& ms) const
+{
+	if (hasTime)
+		ms = lastMs;
+	return hasTime;
+}
+
+// --------------------------------------------------------
+// Goes through the pending frames oldest first, stopping at
+// the first the GPU hasn't finished.  Frames where the clock
+// changed speed or stopped part way are dropped.
+// --------------------------------------------------------
+void GpuFrameTimer::ReadFinishedFrames(ID3D11DeviceContext* d3dContext)
+{
+	for (unsigned int i = 0; i < GpuTimerFrames; i++)
+	{
+		// The frame after the last ended one is the oldest
+		FrameQueries& frame = frames[(current + i) % GpuTimerFrames];
+		if (!frame.Pending)
+			continue;
+
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = {};
+		UINT64 start = 0, end = 0;
+		if (d3dContext->GetData(frame.Disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			d3dContext->GetData(frame.Start.Get(), &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			d3dContext->GetData(frame.End.Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			break;
+
+		frame.Pending = false;
+		if (disjoint.Disjoint || disjoint.Frequency == 0 || end < start)
+			continue;
+
+		lastMs = (float)((double)(end - start) * 1000.0 / (double)disjoint.Frequency);
+		hasTime = true;
+	}
+}
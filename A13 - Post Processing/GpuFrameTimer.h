@@ -0,0 +1,48 @@
+#pragma once
+
+#include <d3d11.h>
+#include <memory>
+#include <wrl/client.h>
+
+#include "GraphicsAPI.h"
+
+// Frames of queries the GPU may still be working through
+const unsigned int GpuTimerFrames = 4;
+
+// --------------------------------------------------------
+// Times whole frames on the GPU with timestamp queries, so
+// what's measured is the work itself and not the time spent
+// waiting on vsync.  Results are read a few frames late and
+// never waited for.  Without a real device, or while the
+// GPU's clock isn't steady, there's no time to give.
+// --------------------------------------------------------
+class GpuFrameTimer
+{
+public:
+	GpuFrameTimer(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context);
+
+	void BeginFrame();
+	void EndFrame();
+
+	// The latest finished frame's time, if there's been one
+	bool GetFrameMs(float& ms) const;
+
+private:
+	std::shared_ptr<IGraphicsDevice> device;
+	std::shared_ptr<IGraphicsContext> context;
+
+	struct FrameQueries
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query> Disjoint;
+		Microsoft::WRL::ComPtr<ID3D11Query> Start;
+		Microsoft::WRL::ComPtr<ID3D11Query> End;
+		bool Pending = false;	// Ended, but not read back
+	};
+	FrameQueries frames[GpuTimerFrames];
+	unsigned int current;		// The frame being timed, or next to be
+	bool timing;				// Whether this frame's queries were started
+	bool hasTime;
+	float lastMs;
+
+	void ReadFinishedFrames(ID3D11DeviceContext* d3dContext);
+};
@@ -1,4 +1,7 @@
 #include "Graphics.h"
+#include "D3D11Backend.h"
+#include "D3DShaderCompiler.h"
+#include "PathHelpers.h"
 #include <dxgi1_6.h>
 
 // Tell the drivers to use high-performance GPU in multi-GPU systems (like laptops)
@@ -15,6 +18,7 @@ namespace Graphics
 	namespace
 	{
 		bool apiInitialized = false;
+		bool headless = false;
 		bool supportsTearing = false;
 		bool vsyncDesired = false;
 		BOOL isFullscreen = false;
@@ -22,13 +26,20 @@ namespace Graphics
 		D3D_FEATURE_LEVEL featureLevel;
 
 		Microsoft::WRL::ComPtr<ID3D11InfoQueue> InfoQueue;
+
+		std::shared_ptr<NullGraphicsStats> nullStats;
 	}
 }
 
 // Getters
 bool Graphics::VsyncState() { return vsyncDesired || !supportsTearing || isFullscreen; }
+bool Graphics::IsHeadless() { return headless; }
+std::shared_ptr<NullGraphicsStats> Graphics::HeadlessStats() { return nullStats; }
 std::wstring Graphics::APIName() 
 { 
+	if (headless)
+		return L"Null";
+
 	switch (featureLevel)
 	{
 	case D3D_FEATURE_LEVEL_10_0: return L"D3D10";
@@ -122,6 +133,16 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 		Context.GetAddressOf());	// Pointer to our Device Context pointer
 	if (FAILED(hr)) return hr;
 
+	// Wrap the API objects for the rest of the engine
+	Recorder = std::make_shared<TraceRecorder>();
+	StateCache = std::make_shared<StateCacheContext>(std::make_shared<D3D11GraphicsContext>(Context), std::make_shared<StateCacheStats>());
+	GfxDevice = std::make_shared<TraceRecordingDevice>(std::make_shared<D3D11GraphicsDevice>(Device), Recorder);
+	GfxContext = std::make_shared<TraceRecordingContext>(StateCache, Recorder);
+	if (GfxDevice->SupportsConstantBufferOffsets())
+		ConstantRing = std::make_shared<ConstantBufferRing>(GfxDevice, GfxContext);
+	Shaders = std::make_shared<ShaderRegistry>(GfxDevice, GfxContext);
+	Permutations = std::make_shared<ShaderPermutationCache>(std::make_shared<D3DShaderCompiler>(), FixPath(L"ShaderCache"));
+
 	// We're set up
 	apiInitialized = true;
 
@@ -142,6 +163,37 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 	return S_OK;
 }
 
+// --------------------------------------------------------
+// Initializes the null backend instead of Direct3D, so the
+// game can run without a window or GPU.  Every call is
+// accepted and counted in HeadlessStats().
+// 
+// width  - Width of the pretend back buffer (and viewport)
+// height - Height of the pretend back buffer (and viewport)
+// --------------------------------------------------------
+HRESULT Graphics::InitializeHeadless(unsigned int width, unsigned int height)
+{
+	// Only initialize once
+	if (apiInitialized)
+		return E_FAIL;
+
+	nullStats = std::make_shared<NullGraphicsStats>();
+	Recorder = std::make_shared<TraceRecorder>();
+	StateCache = std::make_shared<StateCacheContext>(std::make_shared<NullGraphicsContext>(nullStats), std::make_shared<StateCacheStats>());
+	GfxDevice = std::make_shared<TraceRecordingDevice>(std::make_shared<NullGraphicsDevice>(nullStats), Recorder);
+	GfxContext = std::make_shared<TraceRecordingContext>(StateCache, Recorder);
+	ConstantRing = std::make_shared<ConstantBufferRing>(GfxDevice, GfxContext);
+	Shaders = std::make_shared<ShaderRegistry>(GfxDevice, GfxContext);
+	Permutations = std::make_shared<ShaderPermutationCache>(std::make_shared<D3DShaderCompiler>(), FixPath(L"ShaderCache"));
+	featureLevel = D3D_FEATURE_LEVEL_11_0;
+	headless = true;
+
+	// Same resource set up as a real device
+	apiInitialized = true;
+	ResizeBuffers(width, height);
+	return S_OK;
+}
+
 // --------------------------------------------------------
 // Called at the end of the program to clean up any
 // graphics API specific memory. 
@@ -175,24 +227,40 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 	BackBufferRTV.Reset();
 	DepthBufferDSV.Reset();
 
-	// Resize the swap chain buffers
-	SwapChain->ResizeBuffers(
-		2, 
-		width, 
-		height, 
-		DXGI_FORMAT_R8G8B8A8_UNORM, 
-		supportsTearing ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0);
-
 	// Grab the references to the first buffer
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> backBufferTexture;
-	SwapChain->GetBuffer(
-		0,
-		__uuidof(ID3D11Texture2D),
-		(void**)backBufferTexture.GetAddressOf());
+	if (headless)
+	{
+		// No swap chain, so make a stand-in back buffer
+		D3D11_TEXTURE2D_DESC backBufferDesc = {};
+		backBufferDesc.Width = width;
+		backBufferDesc.Height = height;
+		backBufferDesc.MipLevels = 1;
+		backBufferDesc.ArraySize = 1;
+		backBufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		backBufferDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+		backBufferDesc.SampleDesc.Count = 1;
+		GfxDevice->CreateTexture2D(&backBufferDesc, 0, backBufferTexture.GetAddressOf());
+	}
+	else
+	{
+		// Resize the swap chain buffers
+		SwapChain->ResizeBuffers(
+			2,
+			width,
+			height,
+			DXGI_FORMAT_R8G8B8A8_UNORM,
+			supportsTearing ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0);
+
+		SwapChain->GetBuffer(
+			0,
+			__uuidof(ID3D11Texture2D),
+			(void**)backBufferTexture.GetAddressOf());
+	}
 
 	// Now that we have the texture, create a render target view
 	// for the back buffer so we can render into it.
-	Device->CreateRenderTargetView(
+	GfxDevice->CreateRenderTargetView(
 		backBufferTexture.Get(),
 		0,
 		BackBufferRTV.GetAddressOf());
@@ -214,15 +282,15 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 	// Create the depth buffer and its view, then 
 	// release our reference to the texture
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> depthBufferTexture;
-	Device->CreateTexture2D(&depthStencilDesc, 0, &depthBufferTexture);
-	Device->CreateDepthStencilView(
+	GfxDevice->CreateTexture2D(&depthStencilDesc, 0, &depthBufferTexture);
+	GfxDevice->CreateDepthStencilView(
 		depthBufferTexture.Get(),
 		0,
 		DepthBufferDSV.GetAddressOf()); 
 
 	// Bind the views to the pipeline, so rendering properly 
 	// uses their underlying textures
-	Context->OMSetRenderTargets(
+	GfxContext->OMSetRenderTargets(
 		1,
 		BackBufferRTV.GetAddressOf(), // This requires a pointer to a pointer (an array of pointers), so we get the address of the pointer
 		DepthBufferDSV.Get());
@@ -236,10 +304,11 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 	viewport.Height = (float)height;
 	viewport.MinDepth = 0.0f;
 	viewport.MaxDepth = 1.0f;
-	Context->RSSetViewports(1, &viewport);
+	GfxContext->RSSetViewports(1, &viewport);
 
 	// Are we in a fullscreen state?
-	SwapChain->GetFullscreenState(&isFullscreen, 0);
+	if (SwapChain)
+		SwapChain->GetFullscreenState(&isFullscreen, 0);
 }
 
 
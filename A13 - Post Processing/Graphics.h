@@ -2,9 +2,18 @@
 
 #include <Windows.h>
 #include <d3d11.h>
+#include <memory>
 #include <string>
 #include <wrl/client.h>
 
+#include "ConstantBufferRing.h"
+#include "GraphicsAPI.h"
+#include "GraphicsTrace.h"
+#include "NullBackend.h"
+#include "ShaderPermutation.h"
+#include "ShaderRegistry.h"
+#include "StateCache.h"
+
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 
@@ -17,6 +26,31 @@ namespace Graphics
 	inline Microsoft::WRL::ComPtr<ID3D11DeviceContext> Context;
 	inline Microsoft::WRL::ComPtr<IDXGISwapChain> SwapChain;
 
+	// Backend-agnostic device and context that engine code
+	// should use - either D3D11 or the headless null backend
+	inline std::shared_ptr<IGraphicsDevice> GfxDevice;
+	inline std::shared_ptr<IGraphicsContext> GfxContext;
+
+	// Sits between the engine and the backend so any frame
+	// can be captured to a trace file (see GraphicsTrace.h)
+	inline std::shared_ptr<TraceRecorder> Recorder;
+
+	// Filters redundant state changes before they reach the
+	// backend (sits underneath the recorder, so traces still
+	// hold every call the engine made)
+	inline std::shared_ptr<StateCacheContext> StateCache;
+
+	// Per-frame allocator for constant data, or null if the
+	// device can't bind constant buffers by offset
+	inline std::shared_ptr<ConstantBufferRing> ConstantRing;
+
+	// Loads each compiled shader once and shares it
+	inline std::shared_ptr<ShaderRegistry> Shaders;
+
+	// Compiles specialized shader variants on demand, keeping
+	// them on disk between runs
+	inline std::shared_ptr<ShaderPermutationCache> Permutations;
+
 	// Rendering buffers
 	inline Microsoft::WRL::ComPtr<ID3D11RenderTargetView> BackBufferRTV;
 	inline Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV;
@@ -26,9 +60,12 @@ namespace Graphics
 	// Getters
 	bool VsyncState();
 	std::wstring APIName();
+	bool IsHeadless();
+	std::shared_ptr<NullGraphicsStats> HeadlessStats();
 
 	// General functions
 	HRESULT Initialize(unsigned int windowWidth, unsigned int windowHeight, HWND windowHandle, bool vsyncIfPossible);
+	HRESULT InitializeHeadless(unsigned int width, unsigned int height);
 	void ShutDown();
 	void ResizeBuffers(unsigned int width, unsigned int height);
 
@@ -0,0 +1,148 @@
+#include "GraphicsAPI.h"
+
+namespace
+{
+	// Must stay in the same order as the GraphicsCall enum
+	const char* callNames[] =
+	{
+		"CreateBuffer",
+		"CreateTexture2D",
+		"CreateTexture3D",
+		"CreateShaderResourceView",
+		"CreateRenderTargetView",
+		"CreateDepthStencilView",
+		"CreateSamplerState",
+		"CreateRasterizerState",
+		"CreateDepthStencilState",
+		"CreateBlendState",
+		"CreateInputLayout",
+		"CreateVertexShader",
+		"CreatePixelShader",
+		"CreateDomainShader",
+		"CreateHullShader",
+		"CreateGeometryShader",
+		"CreateGeometryShaderWithStreamOutput",
+		"CreateComputeShader",
+		"IASetInputLayout",
+		"IASetPrimitiveTopology",
+		"IASetVertexBuffers",
+		"IASetIndexBuffer",
+		"VSSetShader",
+		"VSSetConstantBuffers",
+		"VSSetConstantBuffers1",
+		"VSSetShaderResources",
+		"VSSetSamplers",
+		"PSSetShader",
+		"PSSetConstantBuffers",
+		"PSSetConstantBuffers1",
+		"PSSetShaderResources",
+		"PSSetSamplers",
+		"DSSetShader",
+		"DSSetConstantBuffers",
+		"DSSetConstantBuffers1",
+		"DSSetShaderResources",
+		"DSSetSamplers",
+		"HSSetShader",
+		"HSSetConstantBuffers",
+		"HSSetConstantBuffers1",
+		"HSSetShaderResources",
+		"HSSetSamplers",
+		"GSSetShader",
+		"GSSetConstantBuffers",
+		"GSSetConstantBuffers1",
+		"GSSetShaderResources",
+		"GSSetSamplers",
+		"CSSetShader",
+		"CSSetConstantBuffers",
+		"CSSetConstantBuffers1",
+		"CSSetShaderResources",
+		"CSSetSamplers",
+		"CSSetUnorderedAccessViews",
+		"SOSetTargets",
+		"RSSetState",
+		"RSSetViewports",
+		"OMSetRenderTargets",
+		"OMSetDepthStencilState",
+		"OMSetBlendState",
+		"ClearRenderTargetView",
+		"ClearDepthStencilView",
+		"UpdateSubresource",
+		"Map",
+		"Unmap",
+		"CopySubresourceRegion",
+		"Draw",
+		"DrawIndexed",
+		"Dispatch",
+	};
+
+	static_assert(sizeof(callNames) / sizeof(callNames[0]) == (size_t)GraphicsCall::Count,
+		"callNames must have one entry per GraphicsCall");
+}
+
+// --------------------------------------------------------
+// Gets a printable name for a graphics call id
+// --------------------------------------------------------
+const char* GraphicsCallName(GraphicsCall call)
+{
+	if (call >= GraphicsCall::Count)
+		return "Unknown";
+
+	return callNames[(size_t)call];
+}
+
+// --------------------------------------------------------
+// Gets the size of a single texel, in bits, for the formats
+// this project creates textures and render targets with
+// --------------------------------------------------------
+unsigned int FormatBitsPerPixel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_UINT:
+	case DXGI_FORMAT_R32G32B32A32_SINT:
+		return 128;
+
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+		return 96;
+
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R32G32_TYPELESS:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		return 64;
+
+	case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+	case DXGI_FORMAT_R16G16_TYPELESS:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R32_TYPELESS:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_R32_UINT:
+	case DXGI_FORMAT_D32_FLOAT:
+	case DXGI_FORMAT_R24G8_TYPELESS:
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+		return 32;
+
+	case DXGI_FORMAT_R16_TYPELESS:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_D16_UNORM:
+	case DXGI_FORMAT_R8G8_UNORM:
+		return 16;
+
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_A8_UNORM:
+		return 8;
+
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <Windows.h>
+#include <d3d11.h>
+
+// --------------------------------------------------------
+// Every device/context entry point the engine uses.  The
+// null backend counts calls by this id, and anything that
+// needs to name a call (stats, traces) shares the same list.
+// --------------------------------------------------------
+enum class GraphicsCall : unsigned char
+{
+	// Device - resource creation
+	CreateBuffer,
+	CreateTexture2D,
+	CreateTexture3D,
+	CreateShaderResourceView,
+	CreateRenderTargetView,
+	CreateDepthStencilView,
+	CreateSamplerState,
+	CreateRasterizerState,
+	CreateDepthStencilState,
+	CreateBlendState,
+	CreateInputLayout,
+	CreateVertexShader,
+	CreatePixelShader,
+	CreateDomainShader,
+	CreateHullShader,
+	CreateGeometryShader,
+	CreateGeometryShaderWithStreamOutput,
+	CreateComputeShader,
+
+	// Context - input assembler
+	IASetInputLayout,
+	IASetPrimitiveTopology,
+	IASetVertexBuffers,
+	IASetIndexBuffer,
+
+	// Context - shader stages
+	VSSetShader,
+	VSSetConstantBuffers,
+	VSSetConstantBuffers1,
+	VSSetShaderResources,
+	VSSetSamplers,
+	PSSetShader,
+	PSSetConstantBuffers,
+	PSSetConstantBuffers1,
+	PSSetShaderResources,
+	PSSetSamplers,
+	DSSetShader,
+	DSSetConstantBuffers,
+	DSSetConstantBuffers1,
+	DSSetShaderResources,
+	DSSetSamplers,
+	HSSetShader,
+	HSSetConstantBuffers,
+	HSSetConstantBuffers1,
+	HSSetShaderResources,
+	HSSetSamplers,
+	GSSetShader,
+	GSSetConstantBuffers,
+	GSSetConstantBuffers1,
+	GSSetShaderResources,
+	GSSetSamplers,
+	CSSetShader,
+	CSSetConstantBuffers,
+	CSSetConstantBuffers1,
+	CSSetShaderResources,
+	CSSetSamplers,
+	CSSetUnorderedAccessViews,
+	SOSetTargets,
+
+	// Context - rasterizer and output merger
+	RSSetState,
+	RSSetViewports,
+	OMSetRenderTargets,
+	OMSetDepthStencilState,
+	OMSetBlendState,
+
+	// Context - resource updates and work submission
+	ClearRenderTargetView,
+	ClearDepthStencilView,
+	UpdateSubresource,
+	Map,
+	Unmap,
+	CopySubresourceRegion,
+	Draw,
+	DrawIndexed,
+	Dispatch,
+
+	Count
+};
+
+// Printable name of a call, for stats windows and logs
+const char* GraphicsCallName(GraphicsCall call);
+
+// Size of one texel of the given format, in bits (0 if unknown/compressed)
+unsigned int FormatBitsPerPixel(DXGI_FORMAT format);
+
+// --------------------------------------------------------
+// Thin interface over ID3D11Device.  Signatures match the
+// D3D11 methods they stand in for, so existing call sites
+// only need to swap which object they call through.
+// --------------------------------------------------------
+class IGraphicsDevice
+{
+public:
+	virtual ~IGraphicsDevice() = default;
+
+	// The real device, or null if there isn't one (headless)
+	virtual ID3D11Device* GetD3DDevice() = 0;
+
+	// Whether constant buffers can be bound by offset (the
+	// *SetConstantBuffers1 calls) and mapped with NO_OVERWRITE
+	virtual bool SupportsConstantBufferOffsets() = 0;
+
+	// Whether UpdateSubresource() accepts a box for constant
+	// buffers, to update just part of one
+	virtual bool SupportsPartialConstantBufferUpdates() = 0;
+
+	// Resources and views
+	virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer) = 0;
+	virtual HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture) = 0;
+	virtual HRESULT CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture) = 0;
+	virtual HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** srv) = 0;
+	virtual HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** rtv) = 0;
+	virtual HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** dsv) = 0;
+
+	// State objects
+	virtual HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler) = 0;
+	virtual HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state) = 0;
+	virtual HRESULT CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state) = 0;
+	virtual HRESULT CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state) = 0;
+
+	// Shaders
+	virtual HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const void* bytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout) = 0;
+	virtual HRESULT CreateVertexShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11VertexShader** shader) = 0;
+	virtual HRESULT CreatePixelShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11PixelShader** shader) = 0;
+	virtual HRESULT CreateDomainShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11DomainShader** shader) = 0;
+	virtual HRESULT CreateHullShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11HullShader** shader) = 0;
+	virtual HRESULT CreateGeometryShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader) = 0;
+	virtual HRESULT CreateGeometryShaderWithStreamOutput(const void* bytecode, SIZE_T bytecodeLength,
+		const D3D11_SO_DECLARATION_ENTRY* soDeclaration, UINT numEntries, const UINT* bufferStrides, UINT numStrides,
+		UINT rasterizedStream, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader) = 0;
+	virtual HRESULT CreateComputeShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11ComputeShader** shader) = 0;
+};
+
+// --------------------------------------------------------
+// Thin interface over ID3D11DeviceContext (immediate context)
+// --------------------------------------------------------
+class IGraphicsContext
+{
+public:
+	virtual ~IGraphicsContext() = default;
+
+	// The real context, or null if there isn't one (headless)
+	virtual ID3D11DeviceContext* GetD3DContext() = 0;
+
+	// Input assembler
+	virtual void IASetInputLayout(ID3D11InputLayout* inputLayout) = 0;
+	virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) = 0;
+	virtual void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) = 0;
+	virtual void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) = 0;
+
+	// Vertex shader stage
+	virtual void VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) = 0;
+	virtual void VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) = 0;
+	virtual void VSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) = 0;
+	virtual void VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) = 0;
+
+	// Pixel shader stage
+	virtual void PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) = 0;
+	virtual void PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) = 0;
+	virtual void PSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) = 0;
+	virtual void PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) = 0;
+
+	// Domain shader stage
+	virtual void DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) = 0;
+	virtual void DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) = 0;
+	virtual void DSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) = 0;
+	virtual void DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) = 0;
+
+	// Hull shader stage
+	virtual void HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) = 0;
+	virtual void HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) = 0;
+	virtual void HSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) = 0;
+	virtual void HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) = 0;
+
+	// Geometry shader stage
+	virtual void GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) = 0;
+	virtual void GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) = 0;
+	virtual void GSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) = 0;
+	virtual void GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) = 0;
+
+	// Compute shader stage
+	virtual void CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) = 0;
+	virtual void CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) = 0;
+	virtual void CSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) = 0;
+	virtual void CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) = 0;
+	virtual void CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* uavs, const UINT* initialCounts) = 0;
+
+	// Stream output
+	virtual void SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets) = 0;
+
+	// Rasterizer
+	virtual void RSSetState(ID3D11RasterizerState* state) = 0;
+	virtual void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports) = 0;
+
+	// Output merger
+	virtual void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv) = 0;
+	virtual void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef) = 0;
+	virtual void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) = 0;
+
+	// Clears
+	virtual void ClearRenderTargetView(ID3D11RenderTargetView* rtv, const FLOAT color[4]) = 0;
+	virtual void ClearDepthStencilView(ID3D11DepthStencilView* dsv, UINT clearFlags, FLOAT depth, UINT8 stencil) = 0;
+
+	// Resource updates
+	virtual void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch) = 0;
+	virtual HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) = 0;
+	virtual void Unmap(ID3D11Resource* resource, UINT subresource) = 0;
+	virtual void CopySubresourceRegion(ID3D11Resource* dest, UINT destSubresource, UINT destX, UINT destY, UINT destZ,
+		ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox) = 0;
+
+	// Work submission
+	virtual void Draw(UINT vertexCount, UINT startVertex) = 0;
+	virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) = 0;
+	virtual void Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ) = 0;
+};
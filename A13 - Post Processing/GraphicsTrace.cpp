@@ -0,0 +1,1850 @@
+#include "GraphicsTrace.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ READ/WRITE HELPERS --------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+void TraceWriter::Write(const void* data, size_t size)
+{
+	if (size == 0)
+		return;
+
+	const unsigned char* bytesIn = (const unsigned char*)data;
+	bytes.insert(bytes.end(), bytesIn, bytesIn + size);
+}
+
+// --------------------------------------------------------
+// Strings are a length, the characters and a terminator, so
+// the reader can hand back a pointer straight into the file
+// --------------------------------------------------------
+void TraceWriter::WriteString(const char* text)
+{
+	unsigned short length = text ? (unsigned short)strlen(text) : 0;
+	Write(length);
+	Write(text, length);
+	Write((char)0);
+}
+
+const void* TraceReader::ReadBytes(size_t size)
+{
+	if (failed || (size_t)(end - cursor) < size)
+	{
+		failed = true;
+		return 0;
+	}
+
+	const void* data = cursor;
+	cursor += size;
+	return data;
+}
+
+const char* TraceReader::ReadString()
+{
+	unsigned short length = Read<unsigned short>();
+	return (const char*)ReadBytes(length + 1);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ OBJECT TAGS ---------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	// Private data slot holding an object's TraceObjectTag
+	const GUID TraceIdGuid = { 0x4f1c7a52, 0x8d2e, 0x4b6a, { 0x9c, 0x31, 0x5e, 0x07, 0xa4, 0x8b, 0x12, 0xd6 } };
+}
+
+// --------------------------------------------------------
+// Minimal COM object hung off each recorded object with
+// SetPrivateDataInterface().  The object holds the only
+// reference, so the tag's final Release() is the object
+// being destroyed, which is when the recorder drops its
+// record.
+// --------------------------------------------------------
+class TraceObjectTag final : public IUnknown
+{
+public:
+	TraceObjectTag(unsigned int id) : Recorder(0), Id(id), refCount(1) {}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+	{
+		if (!object)
+			return E_POINTER;
+		if (riid != __uuidof(IUnknown))
+		{
+			*object = 0;
+			return E_NOINTERFACE;
+		}
+		AddRef();
+		*object = static_cast<IUnknown*>(this);
+		return S_OK;
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++refCount; }
+
+	ULONG STDMETHODCALLTYPE Release() override
+	{
+		ULONG count = --refCount;
+		if (count == 0)
+		{
+			if (Recorder)
+				Recorder->ForgetObject(Id);
+			delete this;
+		}
+		return count;
+	}
+
+	// Null once the recorder itself is gone
+	TraceRecorder* Recorder;
+	unsigned int Id;
+
+private:
+	std::atomic<ULONG> refCount;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ RECORDER ------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+TraceRecorder::TraceRecorder() :
+	capturing(false),
+	realObjects(false),
+	nextId(1),
+	commandCount(0),
+	lastObjectCount(0),
+	lastCommandCount(0),
+	lastFileBytes(0)
+{
+}
+
+// --------------------------------------------------------
+// Objects can outlive the recorder, so their tags are told
+// not to call back into it
+// --------------------------------------------------------
+TraceRecorder::~TraceRecorder()
+{
+	for (auto& tag : tags)
+		tag.second->Recorder = 0;
+}
+
+// --------------------------------------------------------
+// Starts writing context calls.  Usually called right
+// before Game::Draw() so the trace holds exactly one frame.
+// --------------------------------------------------------
+void TraceRecorder::BeginCapture()
+{
+	commands.Clear();
+	commandCount = 0;
+	referenced.clear();
+	referencedFlags.assign(nextId, false);
+	mapMirrors.clear();
+	capturing = true;
+}
+
+// --------------------------------------------------------
+// Stops capturing and writes the trace: every object the
+// captured calls touched (and the resources behind any
+// views), then the calls themselves
+// --------------------------------------------------------
+bool TraceRecorder::EndCapture(const std::wstring& path)
+{
+	if (!capturing)
+		return false;
+	capturing = false;
+
+	// Objects go out dependencies-first
+	TraceWriter objects;
+	unsigned int objectCount = 0;
+	std::vector<bool> written(nextId, false);
+	std::function<void(unsigned int)> writeObject = [&](unsigned int id)
+		{
+			if (id == 0 || id >= written.size() || written[id])
+				return;
+			written[id] = true;
+
+			auto record = records.find(id);
+			if (record == records.end())
+				return; // Never saw how it was made, replays as null
+
+			writeObject(record->second.Dependency);
+			objects.Write((unsigned char)record->second.Call);
+			objects.Write(id);
+			objects.Write((unsigned int)record->second.Payload.size());
+			objects.Write(record->second.Payload.data(), record->second.Payload.size());
+			objectCount++;
+		};
+	for (unsigned int id : referenced)
+		writeObject(id);
+
+	GraphicsTraceHeader header = {};
+	memcpy(header.Magic, "GTRC", 4);
+	header.Version = GraphicsTraceVersion;
+	header.ObjectCount = objectCount;
+	header.CommandCount = commandCount;
+	header.CommandBytes = commands.Bytes().size();
+
+	// Objects destroyed during the capture were only kept
+	// around to be written
+	for (unsigned int id : retired)
+	{
+		records.erase(id);
+		mapMirrors.erase(id);
+	}
+	retired.clear();
+
+	std::ofstream file(std::filesystem::path(path), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)objects.Bytes().data(), objects.Bytes().size());
+	file.write((const char*)commands.Bytes().data(), commands.Bytes().size());
+
+	lastObjectCount = objectCount;
+	lastCommandCount = commandCount;
+	lastFileBytes = sizeof(header) + objects.Bytes().size() + commands.Bytes().size();
+
+	// Don't hold on to the frame's bytes
+	commands.Bytes().clear();
+	commands.Bytes().shrink_to_fit();
+	return file.good();
+}
+
+// --------------------------------------------------------
+// Remembers how an object was made.  D3D hands back the
+// same state object for identical descs, so an object that
+// already has a tag keeps its id.
+// --------------------------------------------------------
+void TraceRecorder::RegisterObject(IUnknown* object, GraphicsCall call, TraceWriter& payload,
+	unsigned int dependency, unsigned long long byteWidth, UINT height, UINT mipLevels, UINT depth)
+{
+	if (!object)
+		return;
+
+	TraceObjectTag* existing = FindTag(object);
+	unsigned int id = existing ? existing->Id : TagObject(object);
+
+	ObjectRecord& record = records[id];
+	record.Call = call;
+	record.Payload = payload.Bytes();
+	record.Dependency = dependency;
+	record.ByteWidth = byteWidth;
+	record.Height = height;
+	record.Depth = depth == 0 ? 1 : depth;
+	record.MipLevels = mipLevels == 0 ? 1 : mipLevels;
+}
+
+// --------------------------------------------------------
+// Gets the trace id for an object, giving unseen objects a
+// new one
+// --------------------------------------------------------
+unsigned int TraceRecorder::FindId(IUnknown* object)
+{
+	if (!object)
+		return 0;
+
+	TraceObjectTag* existing = FindTag(object);
+	if (existing)
+		return existing->Id;
+
+	return AdoptObject(object);
+}
+
+// --------------------------------------------------------
+// Reads back the tag this recorder attached to an object.
+// GetPrivateData() hands out a reference, which is dropped
+// straight away - the object still holds its own.
+// --------------------------------------------------------
+TraceObjectTag* TraceRecorder::FindTag(IUnknown* object)
+{
+	Microsoft::WRL::ComPtr<ID3D11DeviceChild> child;
+	if (FAILED(object->QueryInterface(IID_PPV_ARGS(child.GetAddressOf()))))
+		return 0;
+
+	IUnknown* data = 0;
+	UINT size = sizeof(data);
+	if (FAILED(child->GetPrivateData(TraceIdGuid, &size, &data)) || size != sizeof(data) || !data)
+		return 0;
+
+	TraceObjectTag* tag = static_cast<TraceObjectTag*>(data);
+	data->Release();
+	return tag->Recorder == this ? tag : 0;
+}
+
+// --------------------------------------------------------
+// Gives an object a new id and attaches it.  Anything that
+// can't carry private data still gets an id, just a new one
+// each time it's seen.
+// --------------------------------------------------------
+unsigned int TraceRecorder::TagObject(IUnknown* object)
+{
+	unsigned int id = nextId++;
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceChild> child;
+	if (FAILED(object->QueryInterface(IID_PPV_ARGS(child.GetAddressOf()))))
+		return id;
+
+	// Only hooked up once the object holds it, so a failed
+	// attach doesn't call back in here
+	TraceObjectTag* tag = new TraceObjectTag(id);
+	if (SUCCEEDED(child->SetPrivateDataInterface(TraceIdGuid, tag)))
+	{
+		tag->Recorder = this;
+		tags[id] = tag;
+	}
+	tag->Release();
+	return id;
+}
+
+// --------------------------------------------------------
+// Drops everything known about a destroyed object, unless
+// a capture that may have used it is still running
+// --------------------------------------------------------
+void TraceRecorder::ForgetObject(unsigned int id)
+{
+	tags.erase(id);
+	if (capturing)
+	{
+		retired.push_back(id);
+		return;
+	}
+
+	records.erase(id);
+	mapMirrors.erase(id);
+}
+
+// --------------------------------------------------------
+// Builds a creation record for an object that didn't come
+// through the recording device, by asking the object itself.
+// Only possible with real D3D objects; stand-ins just get
+// an id and replay as null.
+// --------------------------------------------------------
+unsigned int TraceRecorder::AdoptObject(IUnknown* object)
+{
+	unsigned int id = TagObject(object);
+	if (!realObjects)
+		return id;
+
+	TraceWriter payload;
+	ObjectRecord record = {};
+	record.Depth = 1;
+	record.MipLevels = 1;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> volume;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv;
+	Microsoft::WRL::ComPtr<ID3D11Resource> viewResource;
+
+	if (SUCCEEDED(object->QueryInterface(IID_PPV_ARGS(texture.GetAddressOf()))))
+	{
+		D3D11_TEXTURE2D_DESC desc = {};
+		texture->GetDesc(&desc);
+		payload.Write(desc);
+		record.Call = GraphicsCall::CreateTexture2D;
+		record.Height = desc.Height;
+		record.MipLevels = desc.MipLevels;
+	}
+	else if (SUCCEEDED(object->QueryInterface(IID_PPV_ARGS(volume.GetAddressOf()))))
+	{
+		D3D11_TEXTURE3D_DESC desc = {};
+		volume->GetDesc(&desc);
+		payload.Write(desc);
+		record.Call = GraphicsCall::CreateTexture3D;
+		record.Height = desc.Height;
+		record.Depth = desc.Depth;
+		record.MipLevels = desc.MipLevels;
+	}
+	else if (SUCCEEDED(object->QueryInterface(IID_PPV_ARGS(buffer.GetAddressOf()))))
+	{
+		// Contents are unknown at this point, so no initial data
+		D3D11_BUFFER_DESC desc = {};
+		buffer->GetDesc(&desc);
+		payload.Write(desc);
+		payload.Write((unsigned int)0);
+		record.Call = GraphicsCall::CreateBuffer;
+		record.ByteWidth = desc.ByteWidth;
+	}
+	else if (SUCCEEDED(object->QueryInterface(IID_PPV_ARGS(srv.GetAddressOf()))))
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC desc = {};
+		srv->GetDesc(&desc);
+		srv->GetResource(viewResource.GetAddressOf());
+		record.Call = GraphicsCall::CreateShaderResourceView;
+		record.Dependency = FindId(viewResource.Get());
+		payload.Write(record.Dependency);
+		payload.Write((unsigned char)1);
+		payload.Write(desc);
+	}
+	else if (SUCCEEDED(object->QueryInterface(IID_PPV_ARGS(rtv.GetAddressOf()))))
+	{
+		D3D11_RENDER_TARGET_VIEW_DESC desc = {};
+		rtv->GetDesc(&desc);
+		rtv->GetResource(viewResource.GetAddressOf());
+		record.Call = GraphicsCall::CreateRenderTargetView;
+		record.Dependency = FindId(viewResource.Get());
+		payload.Write(record.Dependency);
+		payload.Write((unsigned char)1);
+		payload.Write(desc);
+	}
+	else if (SUCCEEDED(object->QueryInterface(IID_PPV_ARGS(dsv.GetAddressOf()))))
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC desc = {};
+		dsv->GetDesc(&desc);
+		dsv->GetResource(viewResource.GetAddressOf());
+		record.Call = GraphicsCall::CreateDepthStencilView;
+		record.Dependency = FindId(viewResource.Get());
+		payload.Write(record.Dependency);
+		payload.Write((unsigned char)1);
+		payload.Write(desc);
+	}
+	else
+	{
+		// Something we can't describe (e.g. states made by ImGui)
+		return id;
+	}
+
+	record.Payload = payload.Bytes();
+	records[id] = record;
+	return id;
+}
+
+void TraceRecorder::BeginCommand(GraphicsCall call)
+{
+	commands.Write((unsigned char)call);
+	commandCount++;
+}
+
+// --------------------------------------------------------
+// Writes an object's id and marks it as needed by the trace
+// --------------------------------------------------------
+void TraceRecorder::WriteId(IUnknown* object)
+{
+	unsigned int id = FindId(object);
+	commands.Write(id);
+
+	if (id == 0)
+		return;
+	if (id >= referencedFlags.size())
+		referencedFlags.resize(id + 1, false);
+	if (!referencedFlags[id])
+	{
+		referencedFlags[id] = true;
+		referenced.push_back(id);
+	}
+}
+
+unsigned long long TraceRecorder::UpdateSize(IUnknown* resource, UINT subresource, const D3D11_BOX* box, UINT rowPitch, UINT depthPitch)
+{
+	auto record = records.find(FindId(resource));
+	if (record == records.end())
+		return 0;
+
+	// Buffers: the box's X range, or the whole thing
+	const ObjectRecord& info = record->second;
+	if (info.ByteWidth > 0)
+		return box ? (box->right > box->left ? box->right - box->left : 0) : info.ByteWidth;
+
+	// Textures: rows of the given pitch, then slices of the
+	// depth pitch (a box's, or the whole of a 3D texture's mip)
+	UINT mip = subresource % info.MipLevels;
+	unsigned long long rows = box ? box->bottom - box->top : (info.Height >> mip > 0 ? info.Height >> mip : 1);
+	unsigned long long slices = box ? (box->back > box->front ? box->back - box->front : 1) : (info.Depth >> mip > 0 ? info.Depth >> mip : 1);
+	return (slices - 1) * depthPitch + rows * rowPitch;
+}
+
+unsigned long long TraceRecorder::MapSize(IUnknown* resource, UINT rowPitch)
+{
+	auto record = records.find(FindId(resource));
+	if (record == records.end())
+		return 0;
+
+	const ObjectRecord& info = record->second;
+	return info.ByteWidth > 0 ? info.ByteWidth : (unsigned long long)rowPitch * info.Height * info.Depth;
+}
+
+void TraceRecorder::WriteMappedBytes(IUnknown* resource, const unsigned char* data, unsigned long long size, bool wholeResource)
+{
+	// First time this capture, or a discard: send everything
+	std::vector<unsigned char>& mirror = mapMirrors[FindId(resource)];
+	unsigned long long start = 0;
+	unsigned long long end = size;
+	if (!wholeResource && mirror.size() == size)
+	{
+		// Only the span between the first and last changed byte
+		while (start < end && data[start] == mirror[(size_t)start]) start++;
+		while (end > start && data[end - 1] == mirror[(size_t)end - 1]) end--;
+	}
+	mirror.assign(data, data + size);
+
+	commands.Write((unsigned int)start);
+	commands.Write((unsigned int)(end - start));
+	commands.Write(data + start, (size_t)(end - start));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ RECORDING DEVICE ----------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+HRESULT TraceRecordingDevice::CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer)
+{
+	HRESULT hr = device->CreateBuffer(desc, initialData, buffer);
+	if (FAILED(hr) || !buffer || !*buffer)
+		return hr;
+
+	// Keep initial contents - immutable buffers (meshes)
+	// can't be recreated without them
+	unsigned int dataSize = initialData && initialData->pSysMem ? desc->ByteWidth : 0;
+	TraceWriter payload;
+	payload.Write(*desc);
+	payload.Write(dataSize);
+	payload.Write(dataSize ? initialData->pSysMem : 0, dataSize);
+	recorder->RegisterObject(*buffer, GraphicsCall::CreateBuffer, payload, 0, desc->ByteWidth);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture)
+{
+	HRESULT hr = device->CreateTexture2D(desc, initialData, texture);
+	if (FAILED(hr) || !texture || !*texture)
+		return hr;
+
+	// Texture contents aren't kept - too large, and they don't
+	// change how much work a frame submits
+	UINT mipLevels = desc->MipLevels;
+	if (mipLevels == 0)
+	{
+		UINT size = desc->Width > desc->Height ? desc->Width : desc->Height;
+		while (size > 0) { mipLevels++; size >>= 1; }
+	}
+
+	TraceWriter payload;
+	payload.Write(*desc);
+	recorder->RegisterObject(*texture, GraphicsCall::CreateTexture2D, payload, 0, 0, desc->Height, mipLevels);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture)
+{
+	HRESULT hr = device->CreateTexture3D(desc, initialData, texture);
+	if (FAILED(hr) || !texture || !*texture)
+		return hr;
+
+	// Same as 2D, with depth halving down the mips too
+	UINT mipLevels = desc->MipLevels;
+	if (mipLevels == 0)
+	{
+		UINT size = desc->Width > desc->Height ? desc->Width : desc->Height;
+		size = size > desc->Depth ? size : desc->Depth;
+		while (size > 0) { mipLevels++; size >>= 1; }
+	}
+
+	TraceWriter payload;
+	payload.Write(*desc);
+	recorder->RegisterObject(*texture, GraphicsCall::CreateTexture3D, payload, 0, 0, desc->Height, mipLevels, desc->Depth);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** srv)
+{
+	HRESULT hr = device->CreateShaderResourceView(resource, desc, srv);
+	if (FAILED(hr) || !srv || !*srv)
+		return hr;
+
+	unsigned int resourceId = recorder->FindId(resource);
+	TraceWriter payload;
+	payload.Write(resourceId);
+	payload.Write((unsigned char)(desc ? 1 : 0));
+	if (desc) payload.Write(*desc);
+	recorder->RegisterObject(*srv, GraphicsCall::CreateShaderResourceView, payload, resourceId);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** rtv)
+{
+	HRESULT hr = device->CreateRenderTargetView(resource, desc, rtv);
+	if (FAILED(hr) || !rtv || !*rtv)
+		return hr;
+
+	unsigned int resourceId = recorder->FindId(resource);
+	TraceWriter payload;
+	payload.Write(resourceId);
+	payload.Write((unsigned char)(desc ? 1 : 0));
+	if (desc) payload.Write(*desc);
+	recorder->RegisterObject(*rtv, GraphicsCall::CreateRenderTargetView, payload, resourceId);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** dsv)
+{
+	HRESULT hr = device->CreateDepthStencilView(resource, desc, dsv);
+	if (FAILED(hr) || !dsv || !*dsv)
+		return hr;
+
+	unsigned int resourceId = recorder->FindId(resource);
+	TraceWriter payload;
+	payload.Write(resourceId);
+	payload.Write((unsigned char)(desc ? 1 : 0));
+	if (desc) payload.Write(*desc);
+	recorder->RegisterObject(*dsv, GraphicsCall::CreateDepthStencilView, payload, resourceId);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler)
+{
+	HRESULT hr = device->CreateSamplerState(desc, sampler);
+	if (FAILED(hr) || !sampler || !*sampler)
+		return hr;
+
+	TraceWriter payload;
+	payload.Write(*desc);
+	recorder->RegisterObject(*sampler, GraphicsCall::CreateSamplerState, payload);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state)
+{
+	HRESULT hr = device->CreateRasterizerState(desc, state);
+	if (FAILED(hr) || !state || !*state)
+		return hr;
+
+	TraceWriter payload;
+	payload.Write(*desc);
+	recorder->RegisterObject(*state, GraphicsCall::CreateRasterizerState, payload);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state)
+{
+	HRESULT hr = device->CreateDepthStencilState(desc, state);
+	if (FAILED(hr) || !state || !*state)
+		return hr;
+
+	TraceWriter payload;
+	payload.Write(*desc);
+	recorder->RegisterObject(*state, GraphicsCall::CreateDepthStencilState, payload);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state)
+{
+	HRESULT hr = device->CreateBlendState(desc, state);
+	if (FAILED(hr) || !state || !*state)
+		return hr;
+
+	TraceWriter payload;
+	payload.Write(*desc);
+	recorder->RegisterObject(*state, GraphicsCall::CreateBlendState, payload);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const void* bytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout)
+{
+	HRESULT hr = device->CreateInputLayout(elements, elementCount, bytecode, bytecodeLength, inputLayout);
+	if (FAILED(hr) || !inputLayout || !*inputLayout)
+		return hr;
+
+	TraceWriter payload;
+	payload.Write(elementCount);
+	for (UINT i = 0; i < elementCount; i++)
+	{
+		payload.WriteString(elements[i].SemanticName);
+		payload.Write(elements[i].SemanticIndex);
+		payload.Write((UINT)elements[i].Format);
+		payload.Write(elements[i].InputSlot);
+		payload.Write(elements[i].AlignedByteOffset);
+		payload.Write((UINT)elements[i].InputSlotClass);
+		payload.Write(elements[i].InstanceDataStepRate);
+	}
+	payload.Write((unsigned int)bytecodeLength);
+	payload.Write(bytecode, bytecodeLength);
+	recorder->RegisterObject(*inputLayout, GraphicsCall::CreateInputLayout, payload);
+	return hr;
+}
+
+void TraceRecordingDevice::RegisterShader(IUnknown* shader, GraphicsCall call, const void* bytecode, SIZE_T bytecodeLength)
+{
+	TraceWriter payload;
+	payload.Write((unsigned int)bytecodeLength);
+	payload.Write(bytecode, bytecodeLength);
+	recorder->RegisterObject(shader, call, payload);
+}
+
+HRESULT TraceRecordingDevice::CreateVertexShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11VertexShader** shader)
+{
+	HRESULT hr = device->CreateVertexShader(bytecode, bytecodeLength, linkage, shader);
+	if (SUCCEEDED(hr) && shader && *shader)
+		RegisterShader(*shader, GraphicsCall::CreateVertexShader, bytecode, bytecodeLength);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreatePixelShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11PixelShader** shader)
+{
+	HRESULT hr = device->CreatePixelShader(bytecode, bytecodeLength, linkage, shader);
+	if (SUCCEEDED(hr) && shader && *shader)
+		RegisterShader(*shader, GraphicsCall::CreatePixelShader, bytecode, bytecodeLength);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateDomainShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11DomainShader** shader)
+{
+	HRESULT hr = device->CreateDomainShader(bytecode, bytecodeLength, linkage, shader);
+	if (SUCCEEDED(hr) && shader && *shader)
+		RegisterShader(*shader, GraphicsCall::CreateDomainShader, bytecode, bytecodeLength);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateHullShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11HullShader** shader)
+{
+	HRESULT hr = device->CreateHullShader(bytecode, bytecodeLength, linkage, shader);
+	if (SUCCEEDED(hr) && shader && *shader)
+		RegisterShader(*shader, GraphicsCall::CreateHullShader, bytecode, bytecodeLength);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateGeometryShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader)
+{
+	HRESULT hr = device->CreateGeometryShader(bytecode, bytecodeLength, linkage, shader);
+	if (SUCCEEDED(hr) && shader && *shader)
+		RegisterShader(*shader, GraphicsCall::CreateGeometryShader, bytecode, bytecodeLength);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateGeometryShaderWithStreamOutput(const void* bytecode, SIZE_T bytecodeLength,
+	const D3D11_SO_DECLARATION_ENTRY* soDeclaration, UINT numEntries, const UINT* bufferStrides, UINT numStrides,
+	UINT rasterizedStream, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader)
+{
+	HRESULT hr = device->CreateGeometryShaderWithStreamOutput(bytecode, bytecodeLength,
+		soDeclaration, numEntries, bufferStrides, numStrides, rasterizedStream, linkage, shader);
+	if (FAILED(hr) || !shader || !*shader)
+		return hr;
+
+	TraceWriter payload;
+	payload.Write((unsigned int)bytecodeLength);
+	payload.Write(bytecode, bytecodeLength);
+	payload.Write(numEntries);
+	for (UINT i = 0; i < numEntries; i++)
+	{
+		// Null semantic names mark gaps in the output
+		payload.Write(soDeclaration[i].Stream);
+		payload.Write((unsigned char)(soDeclaration[i].SemanticName ? 1 : 0));
+		payload.WriteString(soDeclaration[i].SemanticName);
+		payload.Write(soDeclaration[i].SemanticIndex);
+		payload.Write(soDeclaration[i].StartComponent);
+		payload.Write(soDeclaration[i].ComponentCount);
+		payload.Write(soDeclaration[i].OutputSlot);
+	}
+	payload.Write(numStrides);
+	payload.Write(bufferStrides, sizeof(UINT) * numStrides);
+	payload.Write(rasterizedStream);
+	recorder->RegisterObject(*shader, GraphicsCall::CreateGeometryShaderWithStreamOutput, payload);
+	return hr;
+}
+
+HRESULT TraceRecordingDevice::CreateComputeShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11ComputeShader** shader)
+{
+	HRESULT hr = device->CreateComputeShader(bytecode, bytecodeLength, linkage, shader);
+	if (SUCCEEDED(hr) && shader && *shader)
+		RegisterShader(*shader, GraphicsCall::CreateComputeShader, bytecode, bytecodeLength);
+	return hr;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ RECORDING CONTEXT ---------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+TraceRecordingContext::TraceRecordingContext(std::shared_ptr<IGraphicsContext> context, std::shared_ptr<TraceRecorder> recorder)
+	: context(context), recorder(recorder)
+{
+	// Objects we're handed can only describe themselves if
+	// they came from a real device
+	recorder->SetRealObjects(context->GetD3DContext() != 0);
+}
+
+template<typename T>
+void TraceRecordingContext::RecordSlots(GraphicsCall call, UINT startSlot, UINT count, T* const* objects)
+{
+	if (!recorder->IsCapturing())
+		return;
+
+	recorder->BeginCommand(call);
+	recorder->Commands().Write(startSlot);
+	recorder->Commands().Write(count);
+	for (UINT i = 0; i < count; i++)
+		recorder->WriteId(objects ? objects[i] : 0);
+}
+
+void TraceRecordingContext::RecordConstantBufferRanges(GraphicsCall call, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (!recorder->IsCapturing())
+		return;
+
+	RecordSlots(call, startSlot, count, buffers);
+	recorder->Commands().Write((unsigned char)(firstConstant ? 1 : 0));
+	if (firstConstant)
+		recorder->Commands().Write(firstConstant, sizeof(UINT) * count);
+	recorder->Commands().Write((unsigned char)(numConstants ? 1 : 0));
+	if (numConstants)
+		recorder->Commands().Write(numConstants, sizeof(UINT) * count);
+}
+
+void TraceRecordingContext::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	if (recorder->IsCapturing())
+	{
+		recorder->BeginCommand(GraphicsCall::IASetInputLayout);
+		recorder->WriteId(inputLayout);
+	}
+	context->IASetInputLayout(inputLayout);
+}
+
+void TraceRecordingContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	if (recorder->IsCapturing())
+	{
+		recorder->BeginCommand(GraphicsCall::IASetPrimitiveTopology);
+		recorder->Commands().Write((UINT)topology);
+	}
+	context->IASetPrimitiveTopology(topology);
+}
+
+void TraceRecordingContext::IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	if (recorder->IsCapturing())
+	{
+		recorder->BeginCommand(GraphicsCall::IASetVertexBuffers);
+		recorder->Commands().Write(startSlot);
+		recorder->Commands().Write(numBuffers);
+		for (UINT i = 0; i < numBuffers; i++)
+		{
+			recorder->WriteId(buffers ? buffers[i] : 0);
+			recorder->Commands().Write(strides ? strides[i] : 0u);
+			recorder->Commands().Write(offsets ? offsets[i] : 0u);
+		}
+	}
+	context->IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+}
+
+void TraceRecordingContext::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	if (recorder->IsCapturing())
+	{
+		recorder->BeginCommand(GraphicsCall::IASetIndexBuffer);
+		recorder->WriteId(buffer);
+		recorder->Commands().Write((UINT)format);
+		recorder->Commands().Write(offset);
+	}
+	context->IASetIndexBuffer(buffer, format, offset);
+}
+
+// Shader stages only record the shader; class instances
+// aren't used anywhere in the engine
+void TraceRecordingContext::VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	RecordSlots(GraphicsCall::VSSetShader, 0, 1, &shader);
+	context->VSSetShader(shader, classInstances, numClassInstances);
+}
+
+void TraceRecordingContext::VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	RecordSlots(GraphicsCall::VSSetConstantBuffers, startSlot, numBuffers, buffers);
+	context->VSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void TraceRecordingContext::VSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	RecordConstantBufferRanges(GraphicsCall::VSSetConstantBuffers1, startSlot, numBuffers, buffers, firstConstant, numConstants);
+	context->VSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+}
+
+void TraceRecordingContext::VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	RecordSlots(GraphicsCall::VSSetShaderResources, startSlot, numViews, views);
+	context->VSSetShaderResources(startSlot, numViews, views);
+}
+
+void TraceRecordingContext::VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	RecordSlots(GraphicsCall::VSSetSamplers, startSlot, numSamplers, samplers);
+	context->VSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void TraceRecordingContext::PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	RecordSlots(GraphicsCall::PSSetShader, 0, 1, &shader);
+	context->PSSetShader(shader, classInstances, numClassInstances);
+}
+
+void TraceRecordingContext::PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	RecordSlots(GraphicsCall::PSSetConstantBuffers, startSlot, numBuffers, buffers);
+	context->PSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void TraceRecordingContext::PSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	RecordConstantBufferRanges(GraphicsCall::PSSetConstantBuffers1, startSlot, numBuffers, buffers, firstConstant, numConstants);
+	context->PSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+}
+
+void TraceRecordingContext::PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	RecordSlots(GraphicsCall::PSSetShaderResources, startSlot, numViews, views);
+	context->PSSetShaderResources(startSlot, numViews, views);
+}
+
+void TraceRecordingContext::PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	RecordSlots(GraphicsCall::PSSetSamplers, startSlot, numSamplers, samplers);
+	context->PSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void TraceRecordingContext::DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	RecordSlots(GraphicsCall::DSSetShader, 0, 1, &shader);
+	context->DSSetShader(shader, classInstances, numClassInstances);
+}
+
+void TraceRecordingContext::DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	RecordSlots(GraphicsCall::DSSetConstantBuffers, startSlot, numBuffers, buffers);
+	context->DSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void TraceRecordingContext::DSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	RecordConstantBufferRanges(GraphicsCall::DSSetConstantBuffers1, startSlot, numBuffers, buffers, firstConstant, numConstants);
+	context->DSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+}
+
+void TraceRecordingContext::DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	RecordSlots(GraphicsCall::DSSetShaderResources, startSlot, numViews, views);
+	context->DSSetShaderResources(startSlot, numViews, views);
+}
+
+void TraceRecordingContext::DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	RecordSlots(GraphicsCall::DSSetSamplers, startSlot, numSamplers, samplers);
+	context->DSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void TraceRecordingContext::HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	RecordSlots(GraphicsCall::HSSetShader, 0, 1, &shader);
+	context->HSSetShader(shader, classInstances, numClassInstances);
+}
+
+void TraceRecordingContext::HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	RecordSlots(GraphicsCall::HSSetConstantBuffers, startSlot, numBuffers, buffers);
+	context->HSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void TraceRecordingContext::HSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	RecordConstantBufferRanges(GraphicsCall::HSSetConstantBuffers1, startSlot, numBuffers, buffers, firstConstant, numConstants);
+	context->HSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+}
+
+void TraceRecordingContext::HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	RecordSlots(GraphicsCall::HSSetShaderResources, startSlot, numViews, views);
+	context->HSSetShaderResources(startSlot, numViews, views);
+}
+
+void TraceRecordingContext::HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	RecordSlots(GraphicsCall::HSSetSamplers, startSlot, numSamplers, samplers);
+	context->HSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void TraceRecordingContext::GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	RecordSlots(GraphicsCall::GSSetShader, 0, 1, &shader);
+	context->GSSetShader(shader, classInstances, numClassInstances);
+}
+
+void TraceRecordingContext::GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	RecordSlots(GraphicsCall::GSSetConstantBuffers, startSlot, numBuffers, buffers);
+	context->GSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void TraceRecordingContext::GSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	RecordConstantBufferRanges(GraphicsCall::GSSetConstantBuffers1, startSlot, numBuffers, buffers, firstConstant, numConstants);
+	context->GSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+}
+
+void TraceRecordingContext::GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	RecordSlots(GraphicsCall::GSSetShaderResources, startSlot, numViews, views);
+	context->GSSetShaderResources(startSlot, numViews, views);
+}
+
+void TraceRecordingContext::GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	RecordSlots(GraphicsCall::GSSetSamplers, startSlot, numSamplers, samplers);
+	context->GSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void TraceRecordingContext::CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	RecordSlots(GraphicsCall::CSSetShader, 0, 1, &shader);
+	context->CSSetShader(shader, classInstances, numClassInstances);
+}
+
+void TraceRecordingContext::CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	RecordSlots(GraphicsCall::CSSetConstantBuffers, startSlot, numBuffers, buffers);
+	context->CSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void TraceRecordingContext::CSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	RecordConstantBufferRanges(GraphicsCall::CSSetConstantBuffers1, startSlot, numBuffers, buffers, firstConstant, numConstants);
+	context->CSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+}
+
+void TraceRecordingContext::CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	RecordSlots(GraphicsCall::CSSetShaderResources, startSlot, numViews, views);
+	context->CSSetShaderResources(startSlot, numViews, views);
+}
+
+void TraceRecordingContext::CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	RecordSlots(GraphicsCall::CSSetSamplers, startSlot, numSamplers, samplers);
+	context->CSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void TraceRecordingContext::CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* uavs, const UINT* initialCounts)
+{
+	RecordSlots(GraphicsCall::CSSetUnorderedAccessViews, startSlot, numUAVs, uavs);
+	if (recorder->IsCapturing())
+	{
+		recorder->Commands().Write((unsigned char)(initialCounts ? 1 : 0));
+		if (initialCounts) recorder->Commands().Write(initialCounts, sizeof(UINT) * numUAVs);
+	}
+	context->CSSetUnorderedAccessViews(startSlot, numUAVs, uavs, initialCounts);
+}
+
+void TraceRecordingContext::SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets)
+{
+	RecordSlots(GraphicsCall::SOSetTargets, 0, numBuffers, targets);
+	if (recorder->IsCapturing())
+	{
+		recorder->Commands().Write((unsigned char)(offsets ? 1 : 0));
+		if (offsets) recorder->Commands().Write(offsets, sizeof(UINT) * numBuffers);
+	}
+	context->SOSetTargets(numBuffers, targets, offsets);
+}
+
+void TraceRecordingContext::RSSetState(ID3D11RasterizerState* state)
+{
+	RecordSlots(GraphicsCall::RSSetState, 0, 1, &state);
+	context->RSSetState(state);
+}
+
+void TraceRecordingContext::RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports)
+{
+	if (recorder->IsCapturing())
+	{
+		recorder->BeginCommand(GraphicsCall::RSSetViewports);
+		recorder->Commands().Write(numViewports);
+		recorder->Commands().Write(viewports, sizeof(D3D11_VIEWPORT) * numViewports);
+	}
+	context->RSSetViewports(numViewports, viewports);
+}
+
+void TraceRecordingContext::OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv)
+{
+	RecordSlots(GraphicsCall::OMSetRenderTargets, 0, numViews, rtvs);
+	if (recorder->IsCapturing())
+		recorder->WriteId(dsv);
+	context->OMSetRenderTargets(numViews, rtvs, dsv);
+}
+
+void TraceRecordingContext::OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef)
+{
+	RecordSlots(GraphicsCall::OMSetDepthStencilState, 0, 1, &state);
+	if (recorder->IsCapturing())
+		recorder->Commands().Write(stencilRef);
+	context->OMSetDepthStencilState(state, stencilRef);
+}
+
+void TraceRecordingContext::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+	RecordSlots(GraphicsCall::OMSetBlendState, 0, 1, &state);
+	if (recorder->IsCapturing())
+	{
+		recorder->Commands().Write((unsigned char)(blendFactor ? 1 : 0));
+		if (blendFactor) recorder->Commands().Write(blendFactor, sizeof(FLOAT) * 4);
+		recorder->Commands().Write(sampleMask);
+	}
+	context->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void TraceRecordingContext::ClearRenderTargetView(ID3D11RenderTargetView* rtv, const FLOAT color[4])
+{
+	RecordSlots(GraphicsCall::ClearRenderTargetView, 0, 1, &rtv);
+	if (recorder->IsCapturing())
+		recorder->Commands().Write(color, sizeof(FLOAT) * 4);
+	context->ClearRenderTargetView(rtv, color);
+}
+
+void TraceRecordingContext::ClearDepthStencilView(ID3D11DepthStencilView* dsv, UINT clearFlags, FLOAT depth, UINT8 stencil)
+{
+	RecordSlots(GraphicsCall::ClearDepthStencilView, 0, 1, &dsv);
+	if (recorder->IsCapturing())
+	{
+		recorder->Commands().Write(clearFlags);
+		recorder->Commands().Write(depth);
+		recorder->Commands().Write(stencil);
+	}
+	context->ClearDepthStencilView(dsv, clearFlags, depth, stencil);
+}
+
+void TraceRecordingContext::UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch)
+{
+	if (recorder->IsCapturing())
+	{
+		unsigned int size = data ? (unsigned int)recorder->UpdateSize(resource, subresource, box, rowPitch, depthPitch) : 0;
+
+		recorder->BeginCommand(GraphicsCall::UpdateSubresource);
+		recorder->WriteId(resource);
+		recorder->Commands().Write(subresource);
+		recorder->Commands().Write((unsigned char)(box ? 1 : 0));
+		if (box) recorder->Commands().Write(*box);
+		recorder->Commands().Write(rowPitch);
+		recorder->Commands().Write(depthPitch);
+		recorder->Commands().Write(size);
+		recorder->Commands().Write(data, size);
+	}
+	context->UpdateSubresource(resource, subresource, box, data, rowPitch, depthPitch);
+}
+
+HRESULT TraceRecordingContext::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped)
+{
+	HRESULT hr = context->Map(resource, subresource, mapType, mapFlags, mapped);
+
+	// Reads don't change anything the replay needs
+	if (SUCCEEDED(hr) && mapped && recorder->IsCapturing() && mapType != D3D11_MAP_READ)
+	{
+		recorder->BeginCommand(GraphicsCall::Map);
+		recorder->WriteId(resource);
+		recorder->Commands().Write(subresource);
+		recorder->Commands().Write((UINT)mapType);
+		recorder->Commands().Write(mapFlags);
+
+		PendingMap pending = { resource, subresource, mapped->pData, recorder->MapSize(resource, mapped->RowPitch), mapType };
+		pendingMaps.push_back(pending);
+	}
+	return hr;
+}
+
+void TraceRecordingContext::Unmap(ID3D11Resource* resource, UINT subresource)
+{
+	// The mapped memory is only valid until the real Unmap(),
+	// so copy out whatever was written first
+	for (size_t i = 0; i < pendingMaps.size(); i++)
+	{
+		if (pendingMaps[i].Resource != resource || pendingMaps[i].Subresource != subresource)
+			continue;
+
+		if (recorder->IsCapturing())
+		{
+			recorder->BeginCommand(GraphicsCall::Unmap);
+			recorder->WriteId(resource);
+			recorder->Commands().Write(subresource);
+			recorder->WriteMappedBytes(resource, (const unsigned char*)pendingMaps[i].Data, pendingMaps[i].Size,
+				pendingMaps[i].Type != D3D11_MAP_WRITE_NO_OVERWRITE);
+		}
+
+		pendingMaps.erase(pendingMaps.begin() + i);
+		break;
+	}
+	context->Unmap(resource, subresource);
+}
+
+void TraceRecordingContext::CopySubresourceRegion(ID3D11Resource* dest, UINT destSubresource, UINT destX, UINT destY, UINT destZ,
+	ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox)
+{
+	if (recorder->IsCapturing())
+	{
+		recorder->BeginCommand(GraphicsCall::CopySubresourceRegion);
+		recorder->WriteId(dest);
+		recorder->Commands().Write(destSubresource);
+		recorder->Commands().Write(destX);
+		recorder->Commands().Write(destY);
+		recorder->Commands().Write(destZ);
+		recorder->WriteId(source);
+		recorder->Commands().Write(sourceSubresource);
+		recorder->Commands().Write((unsigned char)(sourceBox ? 1 : 0));
+		if (sourceBox) recorder->Commands().Write(*sourceBox);
+	}
+	context->CopySubresourceRegion(dest, destSubresource, destX, destY, destZ, source, sourceSubresource, sourceBox);
+}
+
+void TraceRecordingContext::Draw(UINT vertexCount, UINT startVertex)
+{
+	if (recorder->IsCapturing())
+	{
+		recorder->BeginCommand(GraphicsCall::Draw);
+		recorder->Commands().Write(vertexCount);
+		recorder->Commands().Write(startVertex);
+	}
+	context->Draw(vertexCount, startVertex);
+}
+
+void TraceRecordingContext::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	if (recorder->IsCapturing())
+	{
+		recorder->BeginCommand(GraphicsCall::DrawIndexed);
+		recorder->Commands().Write(indexCount);
+		recorder->Commands().Write(startIndex);
+		recorder->Commands().Write(baseVertex);
+	}
+	context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void TraceRecordingContext::Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ)
+{
+	if (recorder->IsCapturing())
+	{
+		recorder->BeginCommand(GraphicsCall::Dispatch);
+		recorder->Commands().Write(groupsX);
+		recorder->Commands().Write(groupsY);
+		recorder->Commands().Write(groupsZ);
+	}
+	context->Dispatch(groupsX, groupsY, groupsZ);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ REPLAYER ------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+TraceReplayer::TraceReplayer(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context) :
+	device(device),
+	context(context),
+	header(),
+	commandStart(0),
+	missingObjects(0)
+{
+}
+
+// --------------------------------------------------------
+// Reads a whole trace file and recreates its objects
+// --------------------------------------------------------
+bool TraceReplayer::Load(const std::wstring& path)
+{
+	std::ifstream file(std::filesystem::path(path), std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	std::streamsize size = file.tellg();
+	if (size < (std::streamsize)sizeof(GraphicsTraceHeader))
+		return false;
+
+	fileData.resize((size_t)size);
+	file.seekg(0);
+	file.read((char*)fileData.data(), size);
+
+	memcpy(&header, fileData.data(), sizeof(header));
+	if (memcmp(header.Magic, "GTRC", 4) != 0 || header.Version != GraphicsTraceVersion)
+		return false;
+
+	// Objects first, then everything left is the commands
+	TraceReader reader(fileData.data() + sizeof(header), fileData.size() - sizeof(header));
+	objects.clear();
+	missingObjects = 0;
+	for (unsigned int i = 0; i < header.ObjectCount; i++)
+	{
+		if (!CreateObject(reader))
+			return false;
+	}
+
+	commandStart = reader.Position();
+	return (unsigned long long)(fileData.data() + fileData.size() - commandStart) == header.CommandBytes;
+}
+
+IUnknown* TraceReplayer::Lookup(unsigned int id)
+{
+	return id < objects.size() ? objects[id].Get() : 0;
+}
+
+// --------------------------------------------------------
+// Recreates a single object.  Objects that can't be made
+// (unknown call, missing resource, driver refusal) are left
+// null and counted, the same as D3D would treat unbound slots.
+// --------------------------------------------------------
+bool TraceReplayer::CreateObject(TraceReader& reader)
+{
+	GraphicsCall call = (GraphicsCall)reader.Read<unsigned char>();
+	unsigned int id = reader.Read<unsigned int>();
+	unsigned int payloadSize = reader.Read<unsigned int>();
+	const unsigned char* payloadData = (const unsigned char*)reader.ReadBytes(payloadSize);
+	if (reader.Failed())
+		return false;
+
+	if (id >= objects.size())
+		objects.resize(id + 1);
+
+	TraceReader payload(payloadData, payloadSize);
+	HRESULT hr = E_FAIL;
+	switch (call)
+	{
+	case GraphicsCall::CreateBuffer:
+	{
+		D3D11_BUFFER_DESC desc = payload.Read<D3D11_BUFFER_DESC>();
+		unsigned int dataSize = payload.Read<unsigned int>();
+		D3D11_SUBRESOURCE_DATA data = {};
+		data.pSysMem = payload.ReadBytes(dataSize);
+
+		// Immutable resources need data we may not have
+		if (dataSize == 0 && desc.Usage == D3D11_USAGE_IMMUTABLE)
+			desc.Usage = D3D11_USAGE_DEFAULT;
+
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		hr = device->CreateBuffer(&desc, dataSize ? &data : 0, buffer.GetAddressOf());
+		objects[id] = buffer;
+		break;
+	}
+
+	case GraphicsCall::CreateTexture2D:
+	{
+		D3D11_TEXTURE2D_DESC desc = payload.Read<D3D11_TEXTURE2D_DESC>();
+		if (desc.Usage == D3D11_USAGE_IMMUTABLE)
+			desc.Usage = D3D11_USAGE_DEFAULT;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		hr = device->CreateTexture2D(&desc, 0, texture.GetAddressOf());
+		objects[id] = texture;
+		break;
+	}
+
+	case GraphicsCall::CreateTexture3D:
+	{
+		D3D11_TEXTURE3D_DESC desc = payload.Read<D3D11_TEXTURE3D_DESC>();
+		if (desc.Usage == D3D11_USAGE_IMMUTABLE)
+			desc.Usage = D3D11_USAGE_DEFAULT;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture3D> texture;
+		hr = device->CreateTexture3D(&desc, 0, texture.GetAddressOf());
+		objects[id] = texture;
+		break;
+	}
+
+	case GraphicsCall::CreateShaderResourceView:
+	case GraphicsCall::CreateRenderTargetView:
+	case GraphicsCall::CreateDepthStencilView:
+	{
+		ID3D11Resource* resource = static_cast<ID3D11Resource*>(Lookup(payload.Read<unsigned int>()));
+		bool hasDesc = payload.Read<unsigned char>() != 0;
+		if (!resource)
+			break;
+
+		if (call == GraphicsCall::CreateShaderResourceView)
+		{
+			D3D11_SHADER_RESOURCE_VIEW_DESC desc = payload.Read<D3D11_SHADER_RESOURCE_VIEW_DESC>();
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+			hr = device->CreateShaderResourceView(resource, hasDesc ? &desc : 0, view.GetAddressOf());
+			objects[id] = view;
+		}
+		else if (call == GraphicsCall::CreateRenderTargetView)
+		{
+			D3D11_RENDER_TARGET_VIEW_DESC desc = payload.Read<D3D11_RENDER_TARGET_VIEW_DESC>();
+			Microsoft::WRL::ComPtr<ID3D11RenderTargetView> view;
+			hr = device->CreateRenderTargetView(resource, hasDesc ? &desc : 0, view.GetAddressOf());
+			objects[id] = view;
+		}
+		else
+		{
+			D3D11_DEPTH_STENCIL_VIEW_DESC desc = payload.Read<D3D11_DEPTH_STENCIL_VIEW_DESC>();
+			Microsoft::WRL::ComPtr<ID3D11DepthStencilView> view;
+			hr = device->CreateDepthStencilView(resource, hasDesc ? &desc : 0, view.GetAddressOf());
+			objects[id] = view;
+		}
+		break;
+	}
+
+	case GraphicsCall::CreateSamplerState:
+	{
+		D3D11_SAMPLER_DESC desc = payload.Read<D3D11_SAMPLER_DESC>();
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> state;
+		hr = device->CreateSamplerState(&desc, state.GetAddressOf());
+		objects[id] = state;
+		break;
+	}
+
+	case GraphicsCall::CreateRasterizerState:
+	{
+		D3D11_RASTERIZER_DESC desc = payload.Read<D3D11_RASTERIZER_DESC>();
+		Microsoft::WRL::ComPtr<ID3D11RasterizerState> state;
+		hr = device->CreateRasterizerState(&desc, state.GetAddressOf());
+		objects[id] = state;
+		break;
+	}
+
+	case GraphicsCall::CreateDepthStencilState:
+	{
+		D3D11_DEPTH_STENCIL_DESC desc = payload.Read<D3D11_DEPTH_STENCIL_DESC>();
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilState> state;
+		hr = device->CreateDepthStencilState(&desc, state.GetAddressOf());
+		objects[id] = state;
+		break;
+	}
+
+	case GraphicsCall::CreateBlendState:
+	{
+		D3D11_BLEND_DESC desc = payload.Read<D3D11_BLEND_DESC>();
+		Microsoft::WRL::ComPtr<ID3D11BlendState> state;
+		hr = device->CreateBlendState(&desc, state.GetAddressOf());
+		objects[id] = state;
+		break;
+	}
+
+	case GraphicsCall::CreateInputLayout:
+	{
+		// Semantic names point straight into the file data
+		unsigned int elementCount = payload.Read<unsigned int>();
+		std::vector<D3D11_INPUT_ELEMENT_DESC> elements(elementCount);
+		for (unsigned int i = 0; i < elementCount && !payload.Failed(); i++)
+		{
+			elements[i].SemanticName = payload.ReadString();
+			elements[i].SemanticIndex = payload.Read<UINT>();
+			elements[i].Format = (DXGI_FORMAT)payload.Read<UINT>();
+			elements[i].InputSlot = payload.Read<UINT>();
+			elements[i].AlignedByteOffset = payload.Read<UINT>();
+			elements[i].InputSlotClass = (D3D11_INPUT_CLASSIFICATION)payload.Read<UINT>();
+			elements[i].InstanceDataStepRate = payload.Read<UINT>();
+		}
+		unsigned int bytecodeLength = payload.Read<unsigned int>();
+		const void* bytecode = payload.ReadBytes(bytecodeLength);
+		if (payload.Failed())
+			break;
+
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+		hr = device->CreateInputLayout(elements.data(), elementCount, bytecode, bytecodeLength, inputLayout.GetAddressOf());
+		objects[id] = inputLayout;
+		break;
+	}
+
+	case GraphicsCall::CreateVertexShader:
+	case GraphicsCall::CreatePixelShader:
+	case GraphicsCall::CreateDomainShader:
+	case GraphicsCall::CreateHullShader:
+	case GraphicsCall::CreateGeometryShader:
+	case GraphicsCall::CreateComputeShader:
+	{
+		unsigned int bytecodeLength = payload.Read<unsigned int>();
+		const void* bytecode = payload.ReadBytes(bytecodeLength);
+		if (payload.Failed())
+			break;
+
+		Microsoft::WRL::ComPtr<IUnknown> shader;
+		switch (call)
+		{
+		case GraphicsCall::CreateVertexShader:
+			hr = device->CreateVertexShader(bytecode, bytecodeLength, 0, (ID3D11VertexShader**)shader.GetAddressOf()); break;
+		case GraphicsCall::CreatePixelShader:
+			hr = device->CreatePixelShader(bytecode, bytecodeLength, 0, (ID3D11PixelShader**)shader.GetAddressOf()); break;
+		case GraphicsCall::CreateDomainShader:
+			hr = device->CreateDomainShader(bytecode, bytecodeLength, 0, (ID3D11DomainShader**)shader.GetAddressOf()); break;
+		case GraphicsCall::CreateHullShader:
+			hr = device->CreateHullShader(bytecode, bytecodeLength, 0, (ID3D11HullShader**)shader.GetAddressOf()); break;
+		case GraphicsCall::CreateGeometryShader:
+			hr = device->CreateGeometryShader(bytecode, bytecodeLength, 0, (ID3D11GeometryShader**)shader.GetAddressOf()); break;
+		default:
+			hr = device->CreateComputeShader(bytecode, bytecodeLength, 0, (ID3D11ComputeShader**)shader.GetAddressOf()); break;
+		}
+		objects[id] = shader;
+		break;
+	}
+
+	case GraphicsCall::CreateGeometryShaderWithStreamOutput:
+	{
+		unsigned int bytecodeLength = payload.Read<unsigned int>();
+		const void* bytecode = payload.ReadBytes(bytecodeLength);
+		unsigned int entryCount = payload.Read<unsigned int>();
+		std::vector<D3D11_SO_DECLARATION_ENTRY> entries(entryCount);
+		for (unsigned int i = 0; i < entryCount && !payload.Failed(); i++)
+		{
+			entries[i].Stream = payload.Read<UINT>();
+			bool hasName = payload.Read<unsigned char>() != 0;
+			const char* name = payload.ReadString();
+			entries[i].SemanticName = hasName ? name : 0;
+			entries[i].SemanticIndex = payload.Read<UINT>();
+			entries[i].StartComponent = payload.Read<BYTE>();
+			entries[i].ComponentCount = payload.Read<BYTE>();
+			entries[i].OutputSlot = payload.Read<BYTE>();
+		}
+		unsigned int strideCount = payload.Read<unsigned int>();
+		const UINT* strides = (const UINT*)payload.ReadBytes(sizeof(UINT) * strideCount);
+		UINT rasterizedStream = payload.Read<UINT>();
+		if (payload.Failed())
+			break;
+
+		Microsoft::WRL::ComPtr<ID3D11GeometryShader> shader;
+		hr = device->CreateGeometryShaderWithStreamOutput(bytecode, bytecodeLength,
+			entries.data(), entryCount, strides, strideCount, rasterizedStream, 0, shader.GetAddressOf());
+		objects[id] = shader;
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	if (FAILED(hr))
+		missingObjects++;
+	return true;
+}
+
+// --------------------------------------------------------
+// Runs every recorded context call once, as fast as the
+// backend will take them
+// --------------------------------------------------------
+bool TraceReplayer::Replay()
+{
+	if (!commandStart)
+		return false;
+
+	// Scratch space for slot arrays; D3D11's largest is the
+	// 128 shader resource slots
+	const UINT maxSlots = D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT;
+	IUnknown* slots[maxSlots] = {};
+	UINT strides[maxSlots] = {};
+	UINT offsets[maxSlots] = {};
+
+	// Reads a slot count and that many object ids
+	auto readSlots = [&](TraceReader& reader) -> UINT
+		{
+			UINT count = reader.Read<UINT>();
+			if (count > maxSlots)
+			{
+				count = 0;
+				reader.ReadBytes((size_t)-1); // Force the failure flag
+			}
+			for (UINT i = 0; i < count; i++)
+				slots[i] = Lookup(reader.Read<unsigned int>());
+			return count;
+		};
+
+	// Maps waiting for their Unmap()
+	struct ReplayMap { IUnknown* Resource; UINT Subresource; void* Data; };
+	std::vector<ReplayMap> maps;
+
+	TraceReader reader(commandStart, (size_t)header.CommandBytes);
+	for (unsigned int c = 0; c < header.CommandCount && !reader.Failed(); c++)
+	{
+		GraphicsCall call = (GraphicsCall)reader.Read<unsigned char>();
+		switch (call)
+		{
+		case GraphicsCall::IASetInputLayout:
+			context->IASetInputLayout(static_cast<ID3D11InputLayout*>(Lookup(reader.Read<unsigned int>())));
+			break;
+
+		case GraphicsCall::IASetPrimitiveTopology:
+			context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)reader.Read<UINT>());
+			break;
+
+		case GraphicsCall::IASetVertexBuffers:
+		{
+			UINT start = reader.Read<UINT>();
+			UINT count = reader.Read<UINT>();
+			if (count > maxSlots)
+				return false;
+			for (UINT i = 0; i < count; i++)
+			{
+				slots[i] = Lookup(reader.Read<unsigned int>());
+				strides[i] = reader.Read<UINT>();
+				offsets[i] = reader.Read<UINT>();
+			}
+			context->IASetVertexBuffers(start, count, (ID3D11Buffer* const*)slots, strides, offsets);
+			break;
+		}
+
+		case GraphicsCall::IASetIndexBuffer:
+		{
+			ID3D11Buffer* buffer = static_cast<ID3D11Buffer*>(Lookup(reader.Read<unsigned int>()));
+			DXGI_FORMAT format = (DXGI_FORMAT)reader.Read<UINT>();
+			UINT offset = reader.Read<UINT>();
+			context->IASetIndexBuffer(buffer, format, offset);
+			break;
+		}
+
+		// Everything recorded as { start, count, ids }
+		case GraphicsCall::VSSetShader: case GraphicsCall::VSSetConstantBuffers: case GraphicsCall::VSSetShaderResources: case GraphicsCall::VSSetSamplers:
+		case GraphicsCall::PSSetShader: case GraphicsCall::PSSetConstantBuffers: case GraphicsCall::PSSetShaderResources: case GraphicsCall::PSSetSamplers:
+		case GraphicsCall::DSSetShader: case GraphicsCall::DSSetConstantBuffers: case GraphicsCall::DSSetShaderResources: case GraphicsCall::DSSetSamplers:
+		case GraphicsCall::HSSetShader: case GraphicsCall::HSSetConstantBuffers: case GraphicsCall::HSSetShaderResources: case GraphicsCall::HSSetSamplers:
+		case GraphicsCall::GSSetShader: case GraphicsCall::GSSetConstantBuffers: case GraphicsCall::GSSetShaderResources: case GraphicsCall::GSSetSamplers:
+		case GraphicsCall::CSSetShader: case GraphicsCall::CSSetConstantBuffers: case GraphicsCall::CSSetShaderResources: case GraphicsCall::CSSetSamplers:
+		case GraphicsCall::RSSetState:
+		{
+			UINT start = reader.Read<UINT>();
+			UINT count = readSlots(reader);
+			ID3D11Buffer* const* buffers = (ID3D11Buffer* const*)slots;
+			ID3D11ShaderResourceView* const* srvs = (ID3D11ShaderResourceView* const*)slots;
+			ID3D11SamplerState* const* samplers = (ID3D11SamplerState* const*)slots;
+
+			switch (call)
+			{
+			case GraphicsCall::VSSetShader: context->VSSetShader(static_cast<ID3D11VertexShader*>(slots[0]), 0, 0); break;
+			case GraphicsCall::PSSetShader: context->PSSetShader(static_cast<ID3D11PixelShader*>(slots[0]), 0, 0); break;
+			case GraphicsCall::DSSetShader: context->DSSetShader(static_cast<ID3D11DomainShader*>(slots[0]), 0, 0); break;
+			case GraphicsCall::HSSetShader: context->HSSetShader(static_cast<ID3D11HullShader*>(slots[0]), 0, 0); break;
+			case GraphicsCall::GSSetShader: context->GSSetShader(static_cast<ID3D11GeometryShader*>(slots[0]), 0, 0); break;
+			case GraphicsCall::CSSetShader: context->CSSetShader(static_cast<ID3D11ComputeShader*>(slots[0]), 0, 0); break;
+			case GraphicsCall::RSSetState: context->RSSetState(static_cast<ID3D11RasterizerState*>(slots[0])); break;
+
+			case GraphicsCall::VSSetConstantBuffers: context->VSSetConstantBuffers(start, count, buffers); break;
+			case GraphicsCall::PSSetConstantBuffers: context->PSSetConstantBuffers(start, count, buffers); break;
+			case GraphicsCall::DSSetConstantBuffers: context->DSSetConstantBuffers(start, count, buffers); break;
+			case GraphicsCall::HSSetConstantBuffers: context->HSSetConstantBuffers(start, count, buffers); break;
+			case GraphicsCall::GSSetConstantBuffers: context->GSSetConstantBuffers(start, count, buffers); break;
+			case GraphicsCall::CSSetConstantBuffers: context->CSSetConstantBuffers(start, count, buffers); break;
+
+			case GraphicsCall::VSSetShaderResources: context->VSSetShaderResources(start, count, srvs); break;
+			case GraphicsCall::PSSetShaderResources: context->PSSetShaderResources(start, count, srvs); break;
+			case GraphicsCall::DSSetShaderResources: context->DSSetShaderResources(start, count, srvs); break;
+			case GraphicsCall::HSSetShaderResources: context->HSSetShaderResources(start, count, srvs); break;
+			case GraphicsCall::GSSetShaderResources: context->GSSetShaderResources(start, count, srvs); break;
+			case GraphicsCall::CSSetShaderResources: context->CSSetShaderResources(start, count, srvs); break;
+
+			case GraphicsCall::VSSetSamplers: context->VSSetSamplers(start, count, samplers); break;
+			case GraphicsCall::PSSetSamplers: context->PSSetSamplers(start, count, samplers); break;
+			case GraphicsCall::DSSetSamplers: context->DSSetSamplers(start, count, samplers); break;
+			case GraphicsCall::HSSetSamplers: context->HSSetSamplers(start, count, samplers); break;
+			case GraphicsCall::GSSetSamplers: context->GSSetSamplers(start, count, samplers); break;
+			case GraphicsCall::CSSetSamplers: context->CSSetSamplers(start, count, samplers); break;
+			default: break;
+			}
+			break;
+		}
+
+		case GraphicsCall::VSSetConstantBuffers1: case GraphicsCall::PSSetConstantBuffers1: case GraphicsCall::DSSetConstantBuffers1:
+		case GraphicsCall::HSSetConstantBuffers1: case GraphicsCall::GSSetConstantBuffers1: case GraphicsCall::CSSetConstantBuffers1:
+		{
+			UINT start = reader.Read<UINT>();
+			UINT count = readSlots(reader);
+			bool hasFirst = reader.Read<unsigned char>() != 0;
+			const UINT* first = hasFirst ? (const UINT*)reader.ReadBytes(sizeof(UINT) * count) : 0;
+			bool hasNum = reader.Read<unsigned char>() != 0;
+			const UINT* num = hasNum ? (const UINT*)reader.ReadBytes(sizeof(UINT) * count) : 0;
+			ID3D11Buffer* const* buffers = (ID3D11Buffer* const*)slots;
+
+			switch (call)
+			{
+			case GraphicsCall::VSSetConstantBuffers1: context->VSSetConstantBuffers1(start, count, buffers, first, num); break;
+			case GraphicsCall::PSSetConstantBuffers1: context->PSSetConstantBuffers1(start, count, buffers, first, num); break;
+			case GraphicsCall::DSSetConstantBuffers1: context->DSSetConstantBuffers1(start, count, buffers, first, num); break;
+			case GraphicsCall::HSSetConstantBuffers1: context->HSSetConstantBuffers1(start, count, buffers, first, num); break;
+			case GraphicsCall::GSSetConstantBuffers1: context->GSSetConstantBuffers1(start, count, buffers, first, num); break;
+			case GraphicsCall::CSSetConstantBuffers1: context->CSSetConstantBuffers1(start, count, buffers, first, num); break;
+			default: break;
+			}
+			break;
+		}
+
+		case GraphicsCall::CSSetUnorderedAccessViews:
+		{
+			UINT start = reader.Read<UINT>();
+			UINT count = readSlots(reader);
+			bool hasCounts = reader.Read<unsigned char>() != 0;
+			const UINT* counts = hasCounts ? (const UINT*)reader.ReadBytes(sizeof(UINT) * count) : 0;
+			context->CSSetUnorderedAccessViews(start, count, (ID3D11UnorderedAccessView* const*)slots, counts);
+			break;
+		}
+
+		case GraphicsCall::SOSetTargets:
+		{
+			reader.Read<UINT>(); // Start slot, always 0
+			UINT count = readSlots(reader);
+			bool hasOffsets = reader.Read<unsigned char>() != 0;
+			const UINT* soOffsets = hasOffsets ? (const UINT*)reader.ReadBytes(sizeof(UINT) * count) : 0;
+			context->SOSetTargets(count, (ID3D11Buffer* const*)slots, soOffsets);
+			break;
+		}
+
+		case GraphicsCall::RSSetViewports:
+		{
+			UINT count = reader.Read<UINT>();
+			const D3D11_VIEWPORT* viewports = (const D3D11_VIEWPORT*)reader.ReadBytes(sizeof(D3D11_VIEWPORT) * count);
+			if (viewports)
+				context->RSSetViewports(count, viewports);
+			break;
+		}
+
+		case GraphicsCall::OMSetRenderTargets:
+		{
+			reader.Read<UINT>();
+			UINT count = readSlots(reader);
+			ID3D11DepthStencilView* dsv = static_cast<ID3D11DepthStencilView*>(Lookup(reader.Read<unsigned int>()));
+			context->OMSetRenderTargets(count, (ID3D11RenderTargetView* const*)slots, dsv);
+			break;
+		}
+
+		case GraphicsCall::OMSetDepthStencilState:
+		{
+			reader.Read<UINT>();
+			readSlots(reader);
+			UINT stencilRef = reader.Read<UINT>();
+			context->OMSetDepthStencilState(static_cast<ID3D11DepthStencilState*>(slots[0]), stencilRef);
+			break;
+		}
+
+		case GraphicsCall::OMSetBlendState:
+		{
+			reader.Read<UINT>();
+			readSlots(reader);
+			bool hasFactor = reader.Read<unsigned char>() != 0;
+			const FLOAT* factor = hasFactor ? (const FLOAT*)reader.ReadBytes(sizeof(FLOAT) * 4) : 0;
+			UINT sampleMask = reader.Read<UINT>();
+			context->OMSetBlendState(static_cast<ID3D11BlendState*>(slots[0]), factor, sampleMask);
+			break;
+		}
+
+		case GraphicsCall::ClearRenderTargetView:
+		{
+			reader.Read<UINT>();
+			readSlots(reader);
+			const FLOAT* color = (const FLOAT*)reader.ReadBytes(sizeof(FLOAT) * 4);
+			if (slots[0] && color)
+				context->ClearRenderTargetView(static_cast<ID3D11RenderTargetView*>(slots[0]), color);
+			break;
+		}
+
+		case GraphicsCall::ClearDepthStencilView:
+		{
+			reader.Read<UINT>();
+			readSlots(reader);
+			UINT clearFlags = reader.Read<UINT>();
+			FLOAT depth = reader.Read<FLOAT>();
+			UINT8 stencil = reader.Read<UINT8>();
+			if (slots[0])
+				context->ClearDepthStencilView(static_cast<ID3D11DepthStencilView*>(slots[0]), clearFlags, depth, stencil);
+			break;
+		}
+
+		case GraphicsCall::UpdateSubresource:
+		{
+			ID3D11Resource* resource = static_cast<ID3D11Resource*>(Lookup(reader.Read<unsigned int>()));
+			UINT subresource = reader.Read<UINT>();
+			bool hasBox = reader.Read<unsigned char>() != 0;
+			D3D11_BOX box = hasBox ? reader.Read<D3D11_BOX>() : D3D11_BOX();
+			UINT rowPitch = reader.Read<UINT>();
+			UINT depthPitch = reader.Read<UINT>();
+			unsigned int size = reader.Read<unsigned int>();
+			const void* data = reader.ReadBytes(size);
+
+			// No data means the recorder couldn't size the update
+			if (resource && size > 0 && data)
+				context->UpdateSubresource(resource, subresource, hasBox ? &box : 0, data, rowPitch, depthPitch);
+			break;
+		}
+
+		case GraphicsCall::Map:
+		{
+			IUnknown* resource = Lookup(reader.Read<unsigned int>());
+			UINT subresource = reader.Read<UINT>();
+			D3D11_MAP mapType = (D3D11_MAP)reader.Read<UINT>();
+			UINT mapFlags = reader.Read<UINT>();
+
+			D3D11_MAPPED_SUBRESOURCE mapped = {};
+			if (resource && SUCCEEDED(context->Map(static_cast<ID3D11Resource*>(resource), subresource, mapType, mapFlags, &mapped)))
+				maps.push_back({ resource, subresource, mapped.pData });
+			break;
+		}
+
+		case GraphicsCall::Unmap:
+		{
+			IUnknown* resource = Lookup(reader.Read<unsigned int>());
+			UINT subresource = reader.Read<UINT>();
+			unsigned int offset = reader.Read<unsigned int>();
+			unsigned int size = reader.Read<unsigned int>();
+			const void* data = reader.ReadBytes(size);
+
+			for (size_t i = 0; i < maps.size(); i++)
+			{
+				if (maps[i].Resource != resource || maps[i].Subresource != subresource)
+					continue;
+
+				if (maps[i].Data && data)
+					memcpy((unsigned char*)maps[i].Data + offset, data, size);
+				context->Unmap(static_cast<ID3D11Resource*>(resource), subresource);
+				maps.erase(maps.begin() + i);
+				break;
+			}
+			break;
+		}
+
+		case GraphicsCall::CopySubresourceRegion:
+		{
+			ID3D11Resource* dest = static_cast<ID3D11Resource*>(Lookup(reader.Read<unsigned int>()));
+			UINT destSubresource = reader.Read<UINT>();
+			UINT destX = reader.Read<UINT>();
+			UINT destY = reader.Read<UINT>();
+			UINT destZ = reader.Read<UINT>();
+			ID3D11Resource* source = static_cast<ID3D11Resource*>(Lookup(reader.Read<unsigned int>()));
+			UINT sourceSubresource = reader.Read<UINT>();
+			bool hasBox = reader.Read<unsigned char>() != 0;
+			D3D11_BOX box = hasBox ? reader.Read<D3D11_BOX>() : D3D11_BOX();
+			if (dest && source)
+				context->CopySubresourceRegion(dest, destSubresource, destX, destY, destZ, source, sourceSubresource, hasBox ? &box : 0);
+			break;
+		}
+
+		case GraphicsCall::Draw:
+		{
+			UINT vertexCount = reader.Read<UINT>();
+			UINT startVertex = reader.Read<UINT>();
+			context->Draw(vertexCount, startVertex);
+			break;
+		}
+
+		case GraphicsCall::DrawIndexed:
+		{
+			UINT indexCount = reader.Read<UINT>();
+			UINT startIndex = reader.Read<UINT>();
+			INT baseVertex = reader.Read<INT>();
+			context->DrawIndexed(indexCount, startIndex, baseVertex);
+			break;
+		}
+
+		case GraphicsCall::Dispatch:
+		{
+			UINT groupsX = reader.Read<UINT>();
+			UINT groupsY = reader.Read<UINT>();
+			UINT groupsZ = reader.Read<UINT>();
+			context->Dispatch(groupsX, groupsY, groupsZ);
+			break;
+		}
+
+		default:
+			// Unknown call - the rest of the stream can't be trusted
+			return false;
+		}
+	}
+
+	// Don't leave anything mapped if the trace ended mid-map
+	for (ReplayMap& map : maps)
+		context->Unmap(static_cast<ID3D11Resource*>(map.Resource), map.Subresource);
+
+	return !reader.Failed();
+}
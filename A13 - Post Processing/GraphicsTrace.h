@@ -0,0 +1,362 @@
+#pragma once
+
+#include <memory>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <wrl/client.h>
+#include "GraphicsAPI.h"
+
+// --------------------------------------------------------
+// Binary trace layout (all values little endian, unpadded):
+//
+//  GraphicsTraceHeader
+//  ObjectCount x { u8 call, u32 id, u32 size, payload }  - how to make each object
+//  CommandCount x { u8 call, payload }                   - context calls, in order
+//
+// Objects are referenced by id (0 is null) and a view's
+// resource is always written before the view itself.
+// Payloads are the call's arguments with object pointers
+// swapped for ids; UpdateSubresource and Unmap carry the
+// bytes that were uploaded.  Unmap only carries the range
+// that changed since the last time the buffer was mapped
+// during the capture, as { u32 offset, u32 size, bytes }.
+// --------------------------------------------------------
+struct GraphicsTraceHeader
+{
+	char Magic[4];						// "GTRC"
+	unsigned int Version;
+	unsigned int ObjectCount;
+	unsigned int CommandCount;
+	unsigned long long CommandBytes;
+};
+
+const unsigned int GraphicsTraceVersion = 3;
+
+// --------------------------------------------------------
+// Appends raw values to a growing byte array
+// --------------------------------------------------------
+class TraceWriter
+{
+public:
+	void Write(const void* data, size_t size);
+	template<typename T> void Write(const T& value) { Write(&value, sizeof(T)); }
+	void WriteString(const char* text);
+
+	std::vector<unsigned char>& Bytes() { return bytes; }
+	void Clear() { bytes.clear(); }
+
+private:
+	std::vector<unsigned char> bytes;
+};
+
+// --------------------------------------------------------
+// Reads values back out of a trace without copying.  Any
+// read past the end sets the failed flag and returns zeroes.
+// --------------------------------------------------------
+class TraceReader
+{
+public:
+	TraceReader(const unsigned char* data, size_t size) : cursor(data), end(data + size), failed(false) {}
+
+	const void* ReadBytes(size_t size);
+	template<typename T> T Read()
+	{
+		T value = {};
+		const void* data = ReadBytes(sizeof(T));
+		if (data) memcpy(&value, data, sizeof(T));
+		return value;
+	}
+	const char* ReadString();
+
+	const unsigned char* Position() const { return cursor; }
+	bool AtEnd() const { return cursor >= end; }
+	bool Failed() const { return failed; }
+
+private:
+	const unsigned char* cursor;
+	const unsigned char* end;
+	bool failed;
+};
+
+class TraceObjectTag;
+
+// --------------------------------------------------------
+// Shared state behind the recording device and context.
+// Creation calls are always remembered (objects are usually
+// made long before the frame that gets captured); context
+// calls are only written between BeginCapture/EndCapture.
+//
+// Each object's id lives in its own private data, so the
+// record goes away when the object does, and an address
+// D3D reuses for a new object can't pick up an old record.
+// --------------------------------------------------------
+class TraceRecorder
+{
+public:
+	TraceRecorder();
+	~TraceRecorder();
+
+	void BeginCapture();
+	bool EndCapture(const std::wstring& path);
+	bool IsCapturing() const { return capturing; }
+
+	// Results of the last EndCapture(), for the UI
+	unsigned int GetLastObjectCount() const { return lastObjectCount; }
+	unsigned int GetLastCommandCount() const { return lastCommandCount; }
+	unsigned long long GetLastFileBytes() const { return lastFileBytes; }
+
+	// Called by the recording device after a successful create
+	void RegisterObject(IUnknown* object, GraphicsCall call, TraceWriter& payload,
+		unsigned int dependency = 0, unsigned long long byteWidth = 0, UINT height = 0, UINT mipLevels = 1, UINT depth = 1);
+	unsigned int FindId(IUnknown* object);
+
+	// Called by the recording context while capturing
+	void BeginCommand(GraphicsCall call);
+	void WriteId(IUnknown* object);
+	TraceWriter& Commands() { return commands; }
+
+	// Bytes an UpdateSubresource()/Map() touches, from what
+	// we know about the resource
+	unsigned long long UpdateSize(IUnknown* resource, UINT subresource, const D3D11_BOX* box, UINT rowPitch, UINT depthPitch);
+	unsigned long long MapSize(IUnknown* resource, UINT rowPitch);
+
+	// Writes the part of mapped memory that differs from what
+	// was there the last time this capture saw it unmapped
+	void WriteMappedBytes(IUnknown* resource, const unsigned char* data, unsigned long long size, bool wholeResource);
+
+	// Lets the context describe objects it didn't see created
+	// (swap chain buffers, WIC textures) when they are real
+	void SetRealObjects(bool real) { realObjects = real; }
+
+	// Creation records still held, for the tests
+	size_t GetRecordCount() const { return records.size(); }
+
+private:
+	friend class TraceObjectTag;
+
+	struct ObjectRecord
+	{
+		GraphicsCall Call;
+		std::vector<unsigned char> Payload;
+		unsigned int Dependency;		// Resource a view was made from, or 0
+		unsigned long long ByteWidth;	// Buffers only
+		UINT Height;					// Textures only
+		UINT Depth;						// 3D textures only, 1 for the rest
+		UINT MipLevels;
+	};
+
+	unsigned int AdoptObject(IUnknown* object);
+
+	// The tag this recorder put on an object, if any
+	TraceObjectTag* FindTag(IUnknown* object);
+	unsigned int TagObject(IUnknown* object);
+
+	// Called by a tag as its object is destroyed
+	void ForgetObject(unsigned int id);
+
+	bool capturing;
+	bool realObjects;
+	unsigned int nextId;
+	std::unordered_map<unsigned int, TraceObjectTag*> tags;
+	std::unordered_map<unsigned int, ObjectRecord> records;
+
+	// Objects destroyed mid-capture; their records are still
+	// needed until EndCapture() writes the trace
+	std::vector<unsigned int> retired;
+	std::vector<unsigned int> referenced;
+	std::vector<bool> referencedFlags;
+
+	TraceWriter commands;
+	unsigned int commandCount;
+
+	// Contents of each mapped resource as of its last Unmap(),
+	// by id, so sub-allocated buffers only record new data
+	std::unordered_map<unsigned int, std::vector<unsigned char>> mapMirrors;
+
+	unsigned int lastObjectCount;
+	unsigned int lastCommandCount;
+	unsigned long long lastFileBytes;
+};
+
+// --------------------------------------------------------
+// Device decorator that remembers how objects were created
+// --------------------------------------------------------
+class TraceRecordingDevice : public IGraphicsDevice
+{
+public:
+	TraceRecordingDevice(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<TraceRecorder> recorder)
+		: device(device), recorder(recorder) {}
+
+	ID3D11Device* GetD3DDevice() override { return device->GetD3DDevice(); }
+	bool SupportsConstantBufferOffsets() override { return device->SupportsConstantBufferOffsets(); }
+	bool SupportsPartialConstantBufferUpdates() override { return device->SupportsPartialConstantBufferUpdates(); }
+
+	HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer) override;
+	HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture) override;
+	HRESULT CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture) override;
+	HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** srv) override;
+	HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** rtv) override;
+	HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** dsv) override;
+
+	HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler) override;
+	HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state) override;
+	HRESULT CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state) override;
+	HRESULT CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state) override;
+
+	HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const void* bytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout) override;
+	HRESULT CreateVertexShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11VertexShader** shader) override;
+	HRESULT CreatePixelShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11PixelShader** shader) override;
+	HRESULT CreateDomainShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11DomainShader** shader) override;
+	HRESULT CreateHullShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11HullShader** shader) override;
+	HRESULT CreateGeometryShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader) override;
+	HRESULT CreateGeometryShaderWithStreamOutput(const void* bytecode, SIZE_T bytecodeLength,
+		const D3D11_SO_DECLARATION_ENTRY* soDeclaration, UINT numEntries, const UINT* bufferStrides, UINT numStrides,
+		UINT rasterizedStream, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader) override;
+	HRESULT CreateComputeShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11ComputeShader** shader) override;
+
+private:
+	std::shared_ptr<IGraphicsDevice> device;
+	std::shared_ptr<TraceRecorder> recorder;
+
+	// Shared by all the shader types, which only need their bytecode
+	void RegisterShader(IUnknown* shader, GraphicsCall call, const void* bytecode, SIZE_T bytecodeLength);
+};
+
+// --------------------------------------------------------
+// Context decorator that writes calls to the recorder while
+// a capture is running, and always forwards them
+// --------------------------------------------------------
+class TraceRecordingContext : public IGraphicsContext
+{
+public:
+	TraceRecordingContext(std::shared_ptr<IGraphicsContext> context, std::shared_ptr<TraceRecorder> recorder);
+
+	ID3D11DeviceContext* GetD3DContext() override { return context->GetD3DContext(); }
+
+	void IASetInputLayout(ID3D11InputLayout* inputLayout) override;
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+	void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override;
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override;
+
+	void VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void VSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void PSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void DSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void HSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void GSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void CSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+	void CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* uavs, const UINT* initialCounts) override;
+
+	void SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets) override;
+
+	void RSSetState(ID3D11RasterizerState* state) override;
+	void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports) override;
+
+	void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv) override;
+	void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef) override;
+	void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) override;
+
+	void ClearRenderTargetView(ID3D11RenderTargetView* rtv, const FLOAT color[4]) override;
+	void ClearDepthStencilView(ID3D11DepthStencilView* dsv, UINT clearFlags, FLOAT depth, UINT8 stencil) override;
+
+	void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch) override;
+	HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) override;
+	void Unmap(ID3D11Resource* resource, UINT subresource) override;
+	void CopySubresourceRegion(ID3D11Resource* dest, UINT destSubresource, UINT destX, UINT destY, UINT destZ,
+		ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox) override;
+
+	void Draw(UINT vertexCount, UINT startVertex) override;
+	void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) override;
+	void Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ) override;
+
+private:
+	std::shared_ptr<IGraphicsContext> context;
+	std::shared_ptr<TraceRecorder> recorder;
+
+	// Mapped memory waiting for its Unmap(), so the written
+	// bytes can go into the trace
+	struct PendingMap
+	{
+		ID3D11Resource* Resource;
+		UINT Subresource;
+		void* Data;
+		unsigned long long Size;
+		D3D11_MAP Type;
+	};
+	std::vector<PendingMap> pendingMaps;
+
+	// Most calls are a start slot, a count and that many objects
+	template<typename T>
+	void RecordSlots(GraphicsCall call, UINT startSlot, UINT count, T* const* objects);
+
+	// Slots plus the optional first/num constant arrays
+	void RecordConstantBufferRanges(GraphicsCall call, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants);
+};
+
+// --------------------------------------------------------
+// Loads a trace and re-executes it against any backend.
+// Pair with the null backend to get call/byte counts, or
+// the D3D11 backend to time submission on a real driver.
+// --------------------------------------------------------
+class TraceReplayer
+{
+public:
+	TraceReplayer(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context);
+
+	// Reads the file and creates every object it describes
+	bool Load(const std::wstring& path);
+
+	// Runs the command stream once, returning false if the
+	// trace turns out to be malformed
+	bool Replay();
+
+	unsigned int GetObjectCount() const { return header.ObjectCount; }
+	unsigned int GetCommandCount() const { return header.CommandCount; }
+	unsigned int GetMissingObjectCount() const { return missingObjects; }
+
+private:
+	std::shared_ptr<IGraphicsDevice> device;
+	std::shared_ptr<IGraphicsContext> context;
+
+	GraphicsTraceHeader header;
+	std::vector<unsigned char> fileData;
+	const unsigned char* commandStart;
+
+	// Indexed by trace id; null where creation failed or the
+	// trace didn't know how the object was made
+	std::vector<Microsoft::WRL::ComPtr<IUnknown>> objects;
+	unsigned int missingObjects;
+
+	bool CreateObject(TraceReader& reader);
+	IUnknown* Lookup(unsigned int id);
+};
@@ -0,0 +1,72 @@
+#include "HlslPacking.h"
+
+static unsigned int RoundToRegister(unsigned int bytes)
+{
+	return (bytes + 15) / 16 * 16;
+}
+
+unsigned int HlslArraySize(unsigned int elementSize, unsigned int elements)
+{
+	if (elements == 0)
+		return elementSize;
+	return RoundToRegister(elementSize) * (elements - 1) + elementSize;
+}
+
+// --------------------------------------------------------
+// Every element before the last takes the same whole number
+// of registers, and the last takes the leftover bytes, which
+// have to fit in that many registers too.  Returns 0 if no
+// element size gives that total.
+// --------------------------------------------------------
+unsigned int HlslArrayElementSize(unsigned int arraySize, unsigned int elements)
+{
+	if (elements <= 1)
+		return arraySize;
+
+	for (unsigned int registers = 1; registers * 16 * (elements - 1) < arraySize; registers++)
+	{
+		unsigned int last = arraySize - registers * 16 * (elements - 1);
+		if (last > (registers - 1) * 16 && last <= registers * 16)
+			return last;
+	}
+	return 0;
+}
+
+unsigned int HlslMatrixSize(unsigned int rows, unsigned int columns, bool rowMajor)
+{
+	unsigned int registers = rowMajor ? rows : columns;
+	unsigned int perRegister = rowMajor ? columns : rows;
+	if (registers == 0)
+		return 0;
+	return (registers - 1) * 16 + perRegister * 4;
+}
+
+unsigned int HlslFieldSize(const HlslField& field)
+{
+	return HlslArraySize(field.Size, field.Elements);
+}
+
+unsigned int PackHlslFields(std::vector<HlslField>& fields)
+{
+	unsigned int offset = 0;
+	bool afterStruct = false;
+	for (HlslField& field : fields)
+	{
+		unsigned int size = HlslFieldSize(field);
+		bool newRegister =
+			afterStruct ||
+			field.Struct ||
+			field.Matrix ||
+			field.Elements > 0 ||
+			offset % 16 + size > 16;
+
+		if (newRegister)
+			offset = RoundToRegister(offset);
+
+		field.Offset = offset;
+		offset += size;
+		afterStruct = field.Struct;
+	}
+
+	return RoundToRegister(offset);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// HLSL's constant buffer packing rules, with nothing D3D
+// specific so they can be checked anywhere:
+//
+//  - Data is laid out in 16-byte registers, and a variable
+//    that would straddle two registers starts a new one
+//  - Arrays, structs and matrices always start a register
+//  - Every array element but the last is padded out to a
+//    whole register; what follows may pack into the last
+//  - What follows a struct starts a new register
+//  - The buffer's size is rounded up to whole registers
+// --------------------------------------------------------
+struct HlslField
+{
+	std::string Name;
+	unsigned int Size = 0;			// One element, unpadded
+	unsigned int Elements = 0;		// 0 if not an array
+	bool Struct = false;
+	bool Matrix = false;
+	unsigned int Offset = 0;		// Filled in by PackHlslFields()
+};
+
+// Bytes taken by a whole array: every element is padded to
+// a register except the last
+unsigned int HlslArraySize(unsigned int elementSize, unsigned int elements);
+
+// Works back from an array's reflected total to one element
+unsigned int HlslArrayElementSize(unsigned int arraySize, unsigned int elements);
+
+// Column major matrices take a register per column, row
+// major ones a register per row; the last isn't padded
+unsigned int HlslMatrixSize(unsigned int rows, unsigned int columns, bool rowMajor);
+
+// Bytes taken by the field, arrays included
+unsigned int HlslFieldSize(const HlslField& field);
+
+// Lays the fields out in order, returning the buffer size
+unsigned int PackHlslFields(std::vector<HlslField>& fields);
+
+// --------------------------------------------------------
+// A C++ stand-in for an HLSL array whose elements are
+// smaller than a register (float, float2, ...), which C++
+// arrays can't pad the same way
+// --------------------------------------------------------
+template<typename T, unsigned int N>
+struct HlslArray
+{
+	static const unsigned int Stride = (sizeof(T) + 15) / 16 * 16;
+
+	T& operator[](unsigned int i) { return *(T*)(Bytes + i * Stride); }
+	const T& operator[](unsigned int i) const { return *(const T*)(Bytes + i * Stride); }
+
+	alignas(T) unsigned char Bytes[Stride * (N - 1) + sizeof(T)];
+};
+
+// --------------------------------------------------------
+// Where a generated struct's members are, so a shader's
+// reflected cbuffer can be checked against it at run time
+// --------------------------------------------------------
+struct ShaderStructField
+{
+	const char* Name;
+	unsigned int ByteOffset;
+	unsigned int Size;
+};
@@ -0,0 +1,276 @@
+#include "LightClusters.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+LightClusterGrid::LightClusterGrid(unsigned int tilesX, unsigned int tilesY, unsigned int slices) :
+	tilesX(tilesX),
+	tilesY(tilesY),
+	slices(slices),
+	projection(),
+	nearPlane(0),
+	farPlane(0),
+	sliceScale(0),
+	sliceBias(0),
+	binnedLights(0),
+	maxPerCluster(0)
+{
+}
+
+void LightClusterGrid::SetProjection(const DirectX::XMFLOAT4X4& projection, float nearPlane, float farPlane)
+{
+	if (memcmp(&projection, &this->projection, sizeof(projection)) == 0 &&
+		nearPlane == this->nearPlane &&
+		farPlane == this->farPlane &&
+		!minX.empty())
+		return;
+
+	this->projection = projection;
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+	BuildBounds();
+}
+
+float LightClusterGrid::SliceDepth(unsigned int slice) const
+{
+	return nearPlane * powf(farPlane / nearPlane, (float)slice / slices);
+}
+
+// --------------------------------------------------------
+// Slices touched by a range of view depths, clamped to the
+// grid (first > last if the range misses it entirely)
+// --------------------------------------------------------
+void LightClusterGrid::SliceRange(float zMin, float zMax, unsigned int& first, unsigned int& last) const
+{
+	float firstSlice = logf(zMin > nearPlane ? zMin : nearPlane) * sliceScale + sliceBias;
+	float lastSlice = logf(zMax > nearPlane ? zMax : nearPlane) * sliceScale + sliceBias;
+	first = firstSlice < 0 ? 0 : (unsigned int)firstSlice;
+	last = lastSlice < 0 ? 0 : (unsigned int)lastSlice;
+	if (last >= slices)
+		last = slices - 1;
+}
+
+// --------------------------------------------------------
+// Works out every cluster's box (and a sphere around it) by
+// taking the tile's corners back through the projection at
+// both ends of its slice.  Boxes are grown a hair so pixels
+// right on a boundary, which the shader may round either
+// way, are covered by both clusters.
+// --------------------------------------------------------
+void LightClusterGrid::BuildBounds()
+{
+	float logRange = logf(farPlane / nearPlane);
+	sliceScale = slices / logRange;
+	sliceBias = -sliceScale * logf(nearPlane);
+
+	// Perspective projections put view z in w
+	bool perspective = projection._34 != 0;
+
+	unsigned int count = GetClusterCount();
+	unsigned int padded = (count + 3) / 4 * 4;
+	for (std::vector<float>* bounds : { &minX, &minY, &minZ, &centerX, &centerY, &centerZ })
+		bounds->assign(padded, FLT_MAX);
+	for (std::vector<float>* bounds : { &maxX, &maxY, &maxZ })
+		bounds->assign(padded, -FLT_MAX);
+	radius.assign(padded, -1.0f);
+
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		float z[2] = { SliceDepth(s), SliceDepth(s + 1) };
+		float grow = (z[1] - z[0]) * 0.001f;
+
+		for (unsigned int y = 0; y < tilesY; y++)
+		{
+			// Tile rows go top to bottom, NDC goes bottom to top
+			float ndcY[2] = { 1.0f - 2.0f * y / tilesY, 1.0f - 2.0f * (y + 1) / tilesY };
+
+			for (unsigned int x = 0; x < tilesX; x++)
+			{
+				float ndcX[2] = { -1.0f + 2.0f * x / tilesX, -1.0f + 2.0f * (x + 1) / tilesX };
+				unsigned int c = x + y * tilesX + s * tilesX * tilesY;
+
+				float boxMin[3] = { FLT_MAX, FLT_MAX, z[0] - grow };
+				float boxMax[3] = { -FLT_MAX, -FLT_MAX, z[1] + grow };
+				for (int i = 0; i < 8; i++)
+				{
+					float depth = z[i & 1];
+					float vx = perspective ?
+						(ndcX[i >> 1 & 1] - projection._31) * depth / projection._11 :
+						(ndcX[i >> 1 & 1] - projection._41) / projection._11;
+					float vy = perspective ?
+						(ndcY[i >> 2 & 1] - projection._32) * depth / projection._22 :
+						(ndcY[i >> 2 & 1] - projection._42) / projection._22;
+
+					boxMin[0] = vx < boxMin[0] ? vx : boxMin[0];
+					boxMax[0] = vx > boxMax[0] ? vx : boxMax[0];
+					boxMin[1] = vy < boxMin[1] ? vy : boxMin[1];
+					boxMax[1] = vy > boxMax[1] ? vy : boxMax[1];
+				}
+
+				float growX = (boxMax[0] - boxMin[0]) * 0.001f;
+				float growY = (boxMax[1] - boxMin[1]) * 0.001f;
+				minX[c] = boxMin[0] - growX;
+				maxX[c] = boxMax[0] + growX;
+				minY[c] = boxMin[1] - growY;
+				maxY[c] = boxMax[1] + growY;
+				minZ[c] = boxMin[2];
+				maxZ[c] = boxMax[2];
+
+				float halfX = (maxX[c] - minX[c]) * 0.5f;
+				float halfY = (maxY[c] - minY[c]) * 0.5f;
+				float halfZ = (maxZ[c] - minZ[c]) * 0.5f;
+				centerX[c] = minX[c] + halfX;
+				centerY[c] = minY[c] + halfY;
+				centerZ[c] = minZ[c] + halfZ;
+				radius[c] = sqrtf(halfX * halfX + halfY * halfY + halfZ * halfZ);
+			}
+		}
+	}
+}
+
+unsigned int LightClusterGrid::ClusterAt(float ndcX, float ndcY, float viewZ) const
+{
+	int x = (int)floorf((ndcX * 0.5f + 0.5f) * tilesX);
+	int y = (int)floorf((0.5f - ndcY * 0.5f) * tilesY);
+	int s = (int)floorf(logf(viewZ) * sliceScale + sliceBias);
+	x = x < 0 ? 0 : (x >= (int)tilesX ? tilesX - 1 : x);
+	y = y < 0 ? 0 : (y >= (int)tilesY ? tilesY - 1 : y);
+	s = s < 0 ? 0 : (s >= (int)slices ? slices - 1 : s);
+	return x + y * tilesX + s * tilesX * tilesY;
+}
+
+// --------------------------------------------------------
+// Finds every cluster each light reaches, then sorts the
+// (cluster, light) pairs into one list grouped by cluster.
+// Only slices within a light's depth range are tested, and
+// within a cluster lights keep their original order.
+//
+// lights - Any mix of light types
+// count  - How many
+// view   - Camera view matrix the projection goes with
+// --------------------------------------------------------
+void LightClusterGrid::Assign(const Light* lights, unsigned int count, const DirectX::XMFLOAT4X4& view)
+{
+	pairs.clear();
+	binnedLights = 0;
+
+	unsigned int clusterCount = GetClusterCount();
+	unsigned int tilesPerSlice = tilesX * tilesY;
+	const __m128 zero = _mm_setzero_ps();
+
+	for (unsigned int i = 0; i < count && !minX.empty(); i++)
+	{
+		const Light& light = lights[i];
+		if ((light.Type != LIGHT_TYPE_POINT && light.Type != LIGHT_TYPE_SPOT) || light.Range <= 0)
+			continue;
+
+		// To view space (DirectXMath matrices are row vector)
+		const DirectX::XMFLOAT3& p = light.Position;
+		float px = p.x * view._11 + p.y * view._21 + p.z * view._31 + view._41;
+		float py = p.x * view._12 + p.y * view._22 + p.z * view._32 + view._42;
+		float pz = p.x * view._13 + p.y * view._23 + p.z * view._33 + view._43;
+		float range = light.Range;
+		if (pz + range < nearPlane || pz - range > farPlane)
+			continue;
+
+		unsigned int firstSlice = 0;
+		unsigned int lastSlice = 0;
+		SliceRange(pz - range, pz + range, firstSlice, lastSlice);
+		if (firstSlice > lastSlice)
+			continue;
+
+		// Cones wider than a hemisphere are left as spheres
+		bool cone = light.Type == LIGHT_TYPE_SPOT && light.SpotOuterAngle < 1.5f;
+		float dx = 0, dy = 0, dz = 0;
+		if (cone)
+		{
+			const DirectX::XMFLOAT3& d = light.Direction;
+			dx = d.x * view._11 + d.y * view._21 + d.z * view._31;
+			dy = d.x * view._12 + d.y * view._22 + d.z * view._32;
+			dz = d.x * view._13 + d.y * view._23 + d.z * view._33;
+			float length = sqrtf(dx * dx + dy * dy + dz * dz);
+			cone = length > 0;
+			if (cone)
+			{
+				dx /= length;
+				dy /= length;
+				dz /= length;
+			}
+		}
+
+		const __m128 lightX = _mm_set1_ps(px);
+		const __m128 lightY = _mm_set1_ps(py);
+		const __m128 lightZ = _mm_set1_ps(pz);
+		const __m128 rangeSq = _mm_set1_ps(range * range);
+		const __m128 dirX = _mm_set1_ps(dx);
+		const __m128 dirY = _mm_set1_ps(dy);
+		const __m128 dirZ = _mm_set1_ps(dz);
+		const __m128 cosAngle = _mm_set1_ps(cosf(light.SpotOuterAngle));
+		const __m128 sinAngle = _mm_set1_ps(sinf(light.SpotOuterAngle));
+
+		size_t pairsBefore = pairs.size();
+		unsigned int begin = firstSlice * tilesPerSlice / 4 * 4;
+		unsigned int end = (lastSlice + 1) * tilesPerSlice;
+		for (unsigned int c = begin; c < end; c += 4)
+		{
+			// Sphere vs. box: squared distance from the light
+			// to the closest point of each box
+			__m128 offX = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[c]), lightX), _mm_sub_ps(lightX, _mm_loadu_ps(&maxX[c]))), zero);
+			__m128 offY = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[c]), lightY), _mm_sub_ps(lightY, _mm_loadu_ps(&maxY[c]))), zero);
+			__m128 offZ = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[c]), lightZ), _mm_sub_ps(lightZ, _mm_loadu_ps(&maxZ[c]))), zero);
+			__m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(offX, offX), _mm_mul_ps(offY, offY)), _mm_mul_ps(offZ, offZ));
+			__m128 hit = _mm_cmple_ps(distSq, rangeSq);
+
+			// Cone vs. the box's bounding sphere: how far the
+			// sphere's center is from the cone's surface, and
+			// whether it's behind the light
+			if (cone && _mm_movemask_ps(hit))
+			{
+				__m128 sphereRadius = _mm_loadu_ps(&radius[c]);
+				__m128 toX = _mm_sub_ps(_mm_loadu_ps(&centerX[c]), lightX);
+				__m128 toY = _mm_sub_ps(_mm_loadu_ps(&centerY[c]), lightY);
+				__m128 toZ = _mm_sub_ps(_mm_loadu_ps(&centerZ[c]), lightZ);
+				__m128 toLengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toX, toX), _mm_mul_ps(toY, toY)), _mm_mul_ps(toZ, toZ));
+				__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toX, dirX), _mm_mul_ps(toY, dirY)), _mm_mul_ps(toZ, dirZ));
+				__m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(toLengthSq, _mm_mul_ps(along, along)), zero));
+				__m128 toSurface = _mm_sub_ps(_mm_mul_ps(cosAngle, across), _mm_mul_ps(along, sinAngle));
+
+				hit = _mm_and_ps(hit, _mm_cmple_ps(toSurface, sphereRadius));
+				hit = _mm_and_ps(hit, _mm_cmpge_ps(along, _mm_sub_ps(zero, sphereRadius)));
+			}
+
+			int mask = _mm_movemask_ps(hit);
+			for (unsigned int b = 0; mask && b < 4; b++)
+			{
+				if ((mask & (1 << b)) && c + b < clusterCount)
+					pairs.push_back((unsigned long long)(c + b) << 32 | i);
+			}
+		}
+		if (pairs.size() > pairsBefore)
+			binnedLights++;
+	}
+
+	// Counting sort by cluster
+	ranges.assign(clusterCount, LightClusterRange{ 0, 0 });
+	for (unsigned long long pair : pairs)
+		ranges[pair >> 32].Count++;
+
+	unsigned int offset = 0;
+	maxPerCluster = 0;
+	for (LightClusterRange& range : ranges)
+	{
+		range.Offset = offset;
+		offset += range.Count;
+		maxPerCluster = range.Count > maxPerCluster ? range.Count : maxPerCluster;
+		range.Count = 0;
+	}
+
+	indices.resize(pairs.size());
+	for (unsigned long long pair : pairs)
+	{
+		LightClusterRange& range = ranges[pair >> 32];
+		indices[range.Offset + range.Count++] = (unsigned int)pair;
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Lights.h"
+
+// --------------------------------------------------------
+// Where one cluster's lights are in the index list.  Laid
+// out as a uint2 so the shader can read it directly.
+// --------------------------------------------------------
+struct LightClusterRange
+{
+	unsigned int Offset;
+	unsigned int Count;
+};
+
+// --------------------------------------------------------
+// Bins point and spot lights into a grid of view space
+// "froxels": screen tiles in X and Y, split in depth into
+// slices that grow exponentially from the near plane to the
+// far plane.  A pixel then only lights itself with what's in
+// its own cluster instead of every light in the scene.
+//
+// Bounds are kept structure-of-arrays so each light is
+// tested against four clusters at once with SSE: point
+// lights as spheres against the cluster's box, spot lights
+// additionally as cones against the cluster's bounding
+// sphere.  Tests are conservative, so a cluster may list a
+// light that doesn't quite reach it, but never misses one.
+//
+// Directional lights reach everything and are never binned.
+// Knows nothing about the GPU; see ClusteredLights.
+// --------------------------------------------------------
+class LightClusterGrid
+{
+public:
+	LightClusterGrid(unsigned int tilesX = 16, unsigned int tilesY = 9, unsigned int slices = 24);
+
+	// Rebuilds the cluster bounds, if the projection changed
+	void SetProjection(const DirectX::XMFLOAT4X4& projection, float nearPlane, float farPlane);
+
+	// Bins lights by their index in the array, which is what
+	// the index list refers to
+	void Assign(const Light* lights, unsigned int count, const DirectX::XMFLOAT4X4& view);
+
+	// Results of the last Assign(), ranges indexed by
+	// x + y * tilesX + slice * tilesX * tilesY
+	const std::vector<LightClusterRange>& GetRanges() const { return ranges; }
+	const std::vector<unsigned int>& GetLightIndices() const { return indices; }
+
+	// Which cluster a view space position falls in, the same
+	// way the shader works it out from the pixel
+	unsigned int ClusterAt(float ndcX, float ndcY, float viewZ) const;
+
+	// Maps view depth to a slice: log(z) * scale + bias
+	float GetSliceScale() const { return sliceScale; }
+	float GetSliceBias() const { return sliceBias; }
+
+	unsigned int GetTilesX() const { return tilesX; }
+	unsigned int GetTilesY() const { return tilesY; }
+	unsigned int GetSlices() const { return slices; }
+	unsigned int GetClusterCount() const { return tilesX * tilesY * slices; }
+
+	// Counters for the last Assign(); binned lights are the
+	// ones that reached at least one cluster
+	unsigned int GetBinnedLightCount() const { return binnedLights; }
+	unsigned int GetMaxLightsPerCluster() const { return maxPerCluster; }
+
+private:
+	unsigned int tilesX;
+	unsigned int tilesY;
+	unsigned int slices;
+
+	DirectX::XMFLOAT4X4 projection;
+	float nearPlane;
+	float farPlane;
+	float sliceScale;
+	float sliceBias;
+
+	// Cluster bounds in view space, padded to a multiple of 4
+	// with boxes nothing can touch
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	std::vector<float> centerX, centerY, centerZ, radius;
+
+	// Output, plus (cluster, light) pairs found along the way
+	std::vector<LightClusterRange> ranges;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned long long> pairs;
+
+	unsigned int binnedLights;
+	unsigned int maxPerCluster;
+
+	void BuildBounds();
+	float SliceDepth(unsigned int slice) const;
+	void SliceRange(float zMin, float zMax, unsigned int& first, unsigned int& last) const;
+};
@@ -17,5 +17,6 @@ struct Light {
 	XMFLOAT3 Color;			// All lights need a color
 	float SpotInnerAngle;	// Inner cone angle (in radians)  Inside this, full light!
 	float SpotOuterAngle;	// Outer cone angle (radians)  Outside this, no light!
-	XMFLOAT2 Padding;		// Purposefully padding to hit the 16-byte boundary
+	int ShadowTile;			// First of its tiles in the shadow atlas, or -1 for none
+	float Padding;			// Purposefully padding to hit the 16-byte boundary
 };
\ No newline at end of file
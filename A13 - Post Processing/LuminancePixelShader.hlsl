@@ -0,0 +1,31 @@
+
+Texture2D Pixels : register(t0);
+SamplerState ClampSampler : register(s0);
+
+cbuffer Luminance : register(b0)
+{
+    float2 tapStep;     // A quarter of this pixel's footprint on the scene, in UV
+}
+
+struct VertexToPixel
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+};
+
+// --------------------------------------------------------
+// The scene's average luminance over this pixel's footprint,
+// a 4x4 grid of bilinear samples across it, for the exposure
+// histogram to read back (see AutoExposure.h).  The scene is
+// linear HDR, so nothing's clamped.
+// --------------------------------------------------------
+float main(VertexToPixel input) : SV_TARGET
+{
+    float3 total = 0;
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+            total += Pixels.Sample(ClampSampler, input.uv + (float2(x, y) - 1.5f) * tapStep).rgb;
+    }
+    return dot(total / 16, float3(0.2126f, 0.7152f, 0.0722f));
+}
@@ -1,11 +1,26 @@
 
 #include <Windows.h>
 #include <crtdbg.h>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
 
 #include "Window.h"
 #include "Graphics.h"
+#include "D3D11Backend.h"
+#include "GraphicsTrace.h"
+#include "SimpleShader.h"
+#include "ShaderStructGenerator.h"
 #include "Game.h"
+#include "ClusteredLights.h"
+#include "ShadowAtlas.h"
+#include "ShadowCasterCache.h"
+#include "RenderTargetPool.h"
 #include "Input.h"
+#include "Tests/EngineTests.h"
 
 // Annonymous namespace to hold variables
 // only accessible in this file
@@ -27,6 +42,328 @@ namespace
 		if(game)
 			game->OnResize();
 	}
+
+	// Gets the word following a flag on the command line
+	// (e.g. the file name in "-trace frame.gtrace"), or an
+	// empty string if the flag or the word is missing
+	std::wstring ArgumentAfter(const char* cmdLine, const char* flag)
+	{
+		const char* found = cmdLine ? strstr(cmdLine, flag) : 0;
+		if (!found)
+			return std::wstring();
+
+		const char* start = found + strlen(flag);
+		while (*start == ' ') start++;
+		const char* end = start;
+		while (*end && *end != ' ') end++;
+
+		return std::wstring(start, end);
+	}
+
+	// Runs one of the checks in Tests/, which print as they go
+	int RunInConsole(int (*test)())
+	{
+		Window::CreateConsoleWindow(500, 120, 32, 120);
+		return test();
+	}
+}
+
+// --------------------------------------------------------
+// Runs the game without a window or GPU for a set number of
+// frames, then prints what the null backend recorded
+// 
+// width  - Pretend window width
+// height - Pretend window height
+// frames - Number of Update()/Draw() pairs to run
+// trace  - If not empty, the last frame is captured here
+// extraLights - If not negative, clustered lighting is on
+//          with this many lights on top of the usual ones
+// --------------------------------------------------------
+int RunHeadless(unsigned int width, unsigned int height, int frames, const std::wstring& trace, int extraLights)
+{
+	// Nowhere else to print to
+	Window::CreateConsoleWindow(500, 120, 32, 120);
+
+	HRESULT windowResult = Window::CreateHeadless(width, height);
+	if (FAILED(windowResult))
+		return windowResult;
+
+	HRESULT graphicsResult = Graphics::InitializeHeadless(width, height);
+	if (FAILED(graphicsResult))
+		return graphicsResult;
+
+	Input::Initialize(0);
+
+	// Time the whole run
+	LARGE_INTEGER perfFreq{};
+	__int64 startTime = 0;
+	__int64 initTime = 0;
+	__int64 endTime = 0;
+	QueryPerformanceFrequency(&perfFreq);
+	QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
+
+	game = new Game();
+	game->Initialize();
+	if (extraLights >= 0)
+		game->EnableClusteredLighting(extraLights);
+
+	// No WM_SIZE will ever arrive, so fix up camera aspect ratios here
+	game->OnResize();
+	QueryPerformanceCounter((LARGE_INTEGER*)&initTime);
+
+	// Frame-level counts should not include start up
+	std::shared_ptr<NullGraphicsStats> stats = Graphics::HeadlessStats();
+	std::shared_ptr<StateCacheStats> cacheStats = Graphics::StateCache->GetStats();
+	stats->ResetCalls();
+	cacheStats->Reset();
+	unsigned long long constantsStart = ISimpleShader::UploadedBytes;
+	unsigned long long skipsStart = ISimpleShader::SkippedUploads;
+
+	// Fixed time step so runs are repeatable
+	const float deltaTime = 1.0f / 60.0f;
+	for (int i = 0; i < frames; i++)
+	{
+		bool captureFrame = !trace.empty() && i == frames - 1;
+		if (captureFrame)
+			Graphics::Recorder->BeginCapture();
+
+		Input::Update();
+		game->Update(deltaTime, deltaTime * i);
+		game->Draw(deltaTime, deltaTime * i);
+		Input::EndOfFrame();
+
+		if (captureFrame)
+			Graphics::Recorder->EndCapture(trace);
+	}
+	QueryPerformanceCounter((LARGE_INTEGER*)&endTime);
+
+	// Report
+	double perfSeconds = 1.0 / (double)perfFreq.QuadPart;
+	printf("Headless run: %d frames at %ux%u\n", frames, width, height);
+	printf("  Initialize: %.3f ms\n", (initTime - startTime) * perfSeconds * 1000.0);
+	printf("  Shaders:    %u loaded for %u requests, %u reflected, %u from cache (%.3f ms)\n",
+		Graphics::Shaders->GetShaderCount(), Graphics::Shaders->GetRequestCount(),
+		ISimpleShader::ReflectionCount, ISimpleShader::ReflectionCacheHits,
+		Graphics::Shaders->GetLoadMilliseconds());
+	printf("  Variants:   %u for %u requests, %u compiled, %u from disk, %u failed\n",
+		Graphics::Permutations->GetVariantCount(), Graphics::Permutations->GetRequestCount(),
+		Graphics::Permutations->GetCompileCount(), Graphics::Permutations->GetDiskHitCount(),
+		Graphics::Permutations->GetFailureCount());
+	printf("  Frames:     %.3f ms (%.4f ms/frame)\n",
+		(endTime - initTime) * perfSeconds * 1000.0,
+		(endTime - initTime) * perfSeconds * 1000.0 / frames);
+	printf("  Calls:      %llu (%.1f/frame)\n", stats->TotalCalls(), (double)stats->TotalCalls() / frames);
+	for (size_t c = 0; c < (size_t)GraphicsCall::Count; c++)
+	{
+		if (stats->Calls[c] > 0)
+			printf("    %-36s %llu\n", GraphicsCallName((GraphicsCall)c), stats->Calls[c]);
+	}
+	printf("  Uploaded:   %llu bytes (%.1f/frame)\n", stats->UploadedBytes, (double)stats->UploadedBytes / frames);
+	printf("  Vertices:   %llu\n", stats->VerticesDrawn);
+	printf("  Live:       %llu objects, %llu buffer bytes, %llu texture bytes\n",
+		stats->LiveObjects, stats->BufferBytes, stats->TextureBytes);
+	const RenderTargetPool& renderTargets = game->GetRenderTargets();
+	printf("  Targets:    %u pooled, %llu bytes; %u made, %u reused, %u released\n",
+		renderTargets.GetTargetCount(), renderTargets.GetBytes(), renderTargets.GetCreatedCount(),
+		renderTargets.GetReusedCount(), renderTargets.GetReleasedCount());
+	printf("  State cache: %llu hits, %llu misses, %llu forwarded\n",
+		cacheStats->TotalHits(), cacheStats->TotalMisses(), cacheStats->TotalForwarded());
+	printf("  Constants:  %llu bytes (%.1f/frame)\n", ISimpleShader::UploadedBytes - constantsStart,
+		(double)(ISimpleShader::UploadedBytes - constantsStart) / frames);
+	printf("  Skipped:    %llu unchanged constant buffer copies (%.1f/frame)\n", ISimpleShader::SkippedUploads - skipsStart,
+		(double)(ISimpleShader::SkippedUploads - skipsStart) / frames);
+	if (Graphics::ConstantRing)
+		printf("  CB ring:    %u bytes in %u slices last frame (%u fallbacks, %u wraps)\n",
+			Graphics::ConstantRing->GetFrameBytes(), Graphics::ConstantRing->GetFrameAllocations(),
+			Graphics::ConstantRing->GetFrameFallbacks(), Graphics::ConstantRing->GetWrapCount());
+	const ClusteredLights* clusters = game->GetClusteredLights();
+	if (extraLights >= 0 && clusters)
+		printf("  Clusters:   %u lights, %u binned, %u indices (at most %u per cluster), %.3f ms binning last frame\n",
+			clusters->GetLightCount(), clusters->GetGrid().GetBinnedLightCount(), clusters->GetIndexCount(),
+			clusters->GetGrid().GetMaxLightsPerCluster(), clusters->GetAssignTime());
+	const ShadowCasterCache& shadowCache = game->GetShadowCache();
+	const ShadowCacheStats& shadowStats = shadowCache.GetTotalStats();
+	unsigned int shadowFrames = max(shadowCache.GetFrameCount(), 1u);
+	printf("  Shadows:    %.1f static, %.1f dynamic draws/frame; skipped %.1f cached, %.1f culled; %u cascades redrawn, %u copied\n",
+		(double)shadowStats.StaticDraws / shadowFrames, (double)shadowStats.DynamicDraws / shadowFrames,
+		(double)shadowStats.CachedDraws / shadowFrames, (double)shadowStats.CulledDraws / shadowFrames,
+		shadowStats.Invalidations, shadowStats.Copies);
+	const ShadowAtlasAllocator& shadowAtlas = game->GetShadowAtlas();
+	const ShadowAtlasStats& atlasStats = shadowAtlas.GetTotalStats();
+	unsigned int atlasFrames = max(shadowAtlas.GetFrameCount(), 1u);
+	double atlasTexels = (double)shadowAtlas.GetAtlasSize() * shadowAtlas.GetAtlasSize();
+	printf("  Atlas:      %.1f tiles/frame, %.1f%% used; %u moved, %u shrunk, %u dropped, %u repacks\n",
+		(double)(atlasStats.Kept + atlasStats.Moved + atlasStats.Placed) / atlasFrames,
+		100.0 * atlasStats.UsedTexels / atlasFrames / atlasTexels,
+		atlasStats.Moved, atlasStats.Shrunk, atlasStats.Dropped, atlasStats.Repacks);
+	if (!trace.empty())
+	{
+		printf("  Trace:      %ls (%u objects, %u commands, %llu bytes)\n", trace.c_str(),
+			Graphics::Recorder->GetLastObjectCount(),
+			Graphics::Recorder->GetLastCommandCount(),
+			Graphics::Recorder->GetLastFileBytes());
+	}
+
+	// Clean up
+	delete game;
+	game = 0;
+	Input::ShutDown();
+	Graphics::ShutDown();
+	return 0;
+}
+
+// --------------------------------------------------------
+// Loads every shader the game uses, without a window or
+// GPU, and writes C++ structs for all of their cbuffers
+//
+// output - The header to write (normally ShaderStructs.h)
+// --------------------------------------------------------
+int RunGenerateStructs(unsigned int width, unsigned int height, const std::wstring& output)
+{
+	Window::CreateConsoleWindow(500, 120, 32, 120);
+
+	HRESULT windowResult = Window::CreateHeadless(width, height);
+	if (FAILED(windowResult))
+		return windowResult;
+
+	HRESULT graphicsResult = Graphics::InitializeHeadless(width, height);
+	if (FAILED(graphicsResult))
+		return graphicsResult;
+
+	Input::Initialize(0);
+
+	// The game knows which shaders it needs, and the clustered
+	// lighting variant has cbuffers of its own
+	game = new Game();
+	game->Initialize();
+	game->EnableClusteredLighting(0);
+
+	std::vector<const ShaderReflectionData*> shaders;
+	for (std::shared_ptr<ISimpleShader> shader : Graphics::Shaders->GetShaders())
+		shaders.push_back(&shader->GetReflection());
+
+	std::string header;
+	bool generated = GenerateShaderStructHeader(shaders, { "Lights.h" }, header);
+	if (generated)
+	{
+		std::ofstream file(output, std::ios::binary);
+		file.write(header.c_str(), header.size());
+		generated = file.good();
+		printf("%ls: %s (%u shaders)\n", output.c_str(), generated ? "written" : "could not be written", (unsigned int)shaders.size());
+	}
+
+	delete game;
+	game = 0;
+	Input::ShutDown();
+	Graphics::ShutDown();
+	return generated ? 0 : 1;
+}
+
+// --------------------------------------------------------
+// Replays a trace file as fast as possible, with no game
+// code involved, and prints how long submission took
+// 
+// path       - Trace written by TraceRecorder::EndCapture()
+// iterations - Number of times to run the trace's commands
+// useGPU     - Replay on a real (windowless) D3D11 device
+//              instead of the counting null backend
+// useCache   - Filter the trace through a state cache first
+// --------------------------------------------------------
+int RunReplay(const std::wstring& path, int iterations, bool useGPU, bool useCache)
+{
+	Window::CreateConsoleWindow(500, 120, 32, 120);
+
+	std::shared_ptr<IGraphicsDevice> device;
+	std::shared_ptr<IGraphicsContext> context;
+	std::shared_ptr<NullGraphicsStats> stats;
+	if (useGPU)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Device> d3dDevice;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> d3dContext;
+		HRESULT hr = D3D11CreateDevice(0, D3D_DRIVER_TYPE_HARDWARE, 0, 0, 0, 0, D3D11_SDK_VERSION,
+			d3dDevice.GetAddressOf(), 0, d3dContext.GetAddressOf());
+		if (FAILED(hr))
+			return hr;
+
+		device = std::make_shared<D3D11GraphicsDevice>(d3dDevice);
+		context = std::make_shared<D3D11GraphicsContext>(d3dContext);
+	}
+	else
+	{
+		stats = std::make_shared<NullGraphicsStats>();
+		device = std::make_shared<NullGraphicsDevice>(stats);
+		context = std::make_shared<NullGraphicsContext>(stats);
+	}
+
+	std::shared_ptr<StateCacheStats> cacheStats;
+	if (useCache)
+	{
+		cacheStats = std::make_shared<StateCacheStats>();
+		context = std::make_shared<StateCacheContext>(context, cacheStats);
+	}
+
+	LARGE_INTEGER perfFreq{};
+	__int64 startTime = 0;
+	__int64 loadTime = 0;
+	__int64 endTime = 0;
+	QueryPerformanceFrequency(&perfFreq);
+	QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
+
+	TraceReplayer replayer(device, context);
+	if (!replayer.Load(path))
+	{
+		printf("Could not load trace %ls\n", path.c_str());
+		return E_FAIL;
+	}
+	QueryPerformanceCounter((LARGE_INTEGER*)&loadTime);
+
+	// Only count the replayed frames, not object creation
+	if (stats)
+		stats->ResetCalls();
+	if (cacheStats)
+		cacheStats->Reset();
+
+	for (int i = 0; i < iterations; i++)
+	{
+		if (!replayer.Replay())
+		{
+			printf("Trace %ls is malformed\n", path.c_str());
+			return E_FAIL;
+		}
+
+		// Keep the driver from queuing up unbounded work
+		if (useGPU)
+			context->GetD3DContext()->Flush();
+	}
+	QueryPerformanceCounter((LARGE_INTEGER*)&endTime);
+
+	// Report
+	double perfSeconds = 1.0 / (double)perfFreq.QuadPart;
+	printf("Replay of %ls on %s: %d iterations\n", path.c_str(), useGPU ? "D3D11" : "Null", iterations);
+	printf("  Objects:    %u (%u missing)\n", replayer.GetObjectCount(), replayer.GetMissingObjectCount());
+	printf("  Commands:   %u per iteration\n", replayer.GetCommandCount());
+	printf("  Load:       %.3f ms\n", (loadTime - startTime) * perfSeconds * 1000.0);
+	printf("  Replay:     %.3f ms (%.4f ms/iteration)\n",
+		(endTime - loadTime) * perfSeconds * 1000.0,
+		(endTime - loadTime) * perfSeconds * 1000.0 / iterations);
+	if (stats)
+	{
+		for (size_t c = 0; c < (size_t)GraphicsCall::Count; c++)
+		{
+			if (stats->Calls[c] > 0)
+				printf("    %-36s %llu\n", GraphicsCallName((GraphicsCall)c), stats->Calls[c] / iterations);
+		}
+		printf("  Uploaded:   %llu bytes/iteration\n", stats->UploadedBytes / iterations);
+		printf("  Vertices:   %llu/iteration\n", stats->VerticesDrawn / iterations);
+	}
+	if (cacheStats)
+	{
+		printf("  State cache: %llu hits, %llu misses, %llu forwarded per iteration\n",
+			cacheStats->TotalHits() / iterations,
+			cacheStats->TotalMisses() / iterations,
+			cacheStats->TotalForwarded() / iterations);
+	}
+	return 0;
 }
 
 
@@ -57,6 +394,61 @@ int WINAPI WinMain(
 	bool statsInTitleBar = true;
 	bool vsync = false;
 
+	// Replaying a trace?  "-replay <file> [iterations] [-gpu] [-cache]"
+	// runs a captured frame's calls with no game at all
+	std::wstring replayPath = ArgumentAfter(lpCmdLine, "-replay");
+	if (!replayPath.empty())
+	{
+		const char* replayArg = strstr(lpCmdLine, "-replay") + strlen("-replay");
+		while (*replayArg == ' ') replayArg++;
+		while (*replayArg && *replayArg != ' ') replayArg++;
+
+		int iterations = atoi(replayArg);
+		if (iterations <= 0)
+			iterations = 1;
+
+		return RunReplay(replayPath, iterations, strstr(lpCmdLine, "-gpu") != 0, strstr(lpCmdLine, "-cache") != 0);
+	}
+
+	// Regenerating the cbuffer structs?  "-gen-structs <file>"
+	std::wstring structsPath = ArgumentAfter(lpCmdLine, "-gen-structs");
+	if (!structsPath.empty())
+		return RunGenerateStructs(windowWidth, windowHeight, structsPath);
+
+	// Benchmarking the CPU lighting?  "-pbr-bench [lights]"
+	const char* pbrArg = lpCmdLine ? strstr(lpCmdLine, "-pbr-bench") : 0;
+	if (pbrArg)
+	{
+		int lights = atoi(pbrArg + strlen("-pbr-bench"));
+		Window::CreateConsoleWindow(500, 120, 32, 120);
+		return RunPbrBenchmark(windowWidth, windowHeight, lights > 0 ? lights : 5);
+	}
+
+	// Running one of the checks or benchmarks in Tests/?
+	// Any flag in Tests/TestModes.cpp, e.g. "-null-test"
+	const TestMode* testMode = FindTestMode(lpCmdLine);
+	if (testMode)
+		return RunInConsole(testMode->Run);
+
+	// Running headless?  "-headless <frames>" skips the window
+	// and GPU entirely and runs a fixed number of frames
+	// against the null graphics backend.  Add "-trace <file>"
+	// to capture the last frame, or "-clustered <lights>" to
+	// light it with clusters and that many extra lights.
+	int headlessFrames = 0;
+	const char* headlessArg = lpCmdLine ? strstr(lpCmdLine, "-headless") : 0;
+	if (headlessArg)
+	{
+		headlessFrames = atoi(headlessArg + strlen("-headless"));
+		if (headlessFrames <= 0)
+			headlessFrames = 1;
+
+		const char* clusteredArg = strstr(lpCmdLine, "-clustered");
+		int extraLights = clusteredArg ? atoi(clusteredArg + strlen("-clustered")) : -1;
+
+		return RunHeadless(windowWidth, windowHeight, headlessFrames, ArgumentAfter(lpCmdLine, "-trace"), extraLights);
+	}
+
 	// The main application object
 	game = new Game();
 
@@ -10,9 +10,30 @@ void Material::AddSampler(std::string resName, Microsoft::WRL::ComPtr<ID3D11Samp
 	samplers.insert({ resName, sampler });
 }
 
-// Binds the Textures and Samplers
+// Normal and metalness maps are only worth sampling if the
+// material has them; every material receives shadows
+ShaderPermutationKey Material::GetShaderFeatures() const {
+	ShaderPermutationKey key;
+	key.NormalMap = textureSRVs.count("NormalMap") > 0;
+	key.MetalnessMap = textureSRVs.count("MetalnessMap") > 0;
+	key.Shadows = true;
+	return key;
+}
+
+// Binds the Textures, Samplers and per material constants
 void Material::PrepareMaterial() {
 
+	if (!constants)
+		constants = std::make_shared<SharedConstantBuffer>(Graphics::GfxDevice, Graphics::GfxContext, pixelShader, "PerMaterial");
+
+	// Only sent to the GPU when one of these actually changed
+	constants->SetFloat4("colorTint", colorTint);
+	constants->SetFloat2("scale", { scale.at(0), scale.at(1) });
+	constants->SetFloat2("offset", { offset.at(0), offset.at(1) });
+	constants->SetFloat("roughness", roughness);
+	constants->Upload();
+	constants->BindTo(pixelShader);
+
 	for (auto& t : textureSRVs) {
 		pixelShader->SetShaderResourceView(t.first.c_str(), t.second); 
 	}
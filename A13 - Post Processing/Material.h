@@ -6,6 +6,8 @@
 #include <vector>
 #include <memory>
 #include "Graphics.h"
+#include "SharedConstantBuffer.h"
+#include "ShaderPermutation.h"
 #include <unordered_map>
 
 class Material
@@ -28,6 +30,10 @@ public:
 	void AddSampler(std::string resName, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
 	void PrepareMaterial();
 
+	// Which optional lighting shader features this material
+	// has textures for (light counts are left at zero)
+	ShaderPermutationKey GetShaderFeatures() const;
+
 	// Getters
 	DirectX::XMFLOAT4 GetTint() const {
 		return colorTint;
@@ -72,6 +78,7 @@ public:
 
 	void SetPS(std::shared_ptr<SimplePixelShader> ps) {
 		this->pixelShader = ps;
+		constants.reset();
 	}
 
 	void SetUVScale(std::vector<float> scale) {
@@ -97,4 +104,7 @@ private:
 	std::vector<float> offset;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
+
+	// Per material cbuffer, made from the pixel shader when first needed
+	std::shared_ptr<SharedConstantBuffer> constants;
 };
\ No newline at end of file
@@ -1,6 +1,12 @@
 #include "Mesh.h"
 #include "Vertex.h"
 #include "Graphics.h"
+#include "PathHelpers.h"
+#include "ShaderReflectionCache.h"
+
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
 
 using namespace DirectX;
 
@@ -285,8 +291,13 @@ Mesh::~Mesh() { } // Empty as the smart pointers will take care of themselves
 void Mesh::Draw() {
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
-	Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	Graphics::GfxContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+
+	// Baked occlusion comes from slot 2 (slot 1 is for per
+	// instance data, see SimpleVertexShader::CreateShader())
+	UINT occlusionStride = sizeof(VertexOcclusion);
+	Graphics::GfxContext->IASetVertexBuffers(2, 1, occlusionBuffer.GetAddressOf(), &occlusionStride, &offset);
+	Graphics::GfxContext->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
 
 	// Tell Direct3D to draw
 	//  - Begins the rendering pipeline on the GPU
@@ -295,7 +306,7 @@ void Mesh::Draw() {
 	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 	//     vertices in the currently set VERTEX BUFFER
 	UINT indexCount = GetIndexCount(); // The number of indices to use
-	Graphics::Context->DrawIndexed(
+	Graphics::GfxContext->DrawIndexed(
 		indexCount,     // The number of indices to use (we could draw a subset if we wanted)
 		0,     // Offset to the first index we want to use
 		0);    // Offset to add to each index when looking up vertices
@@ -303,6 +314,14 @@ void Mesh::Draw() {
 
 void Mesh::CreateBuffers(const char* name, unsigned int vertexCount, unsigned int indexCount,
 	struct Vertex vertices[], unsigned int indices[]) {
+	// Bounds, for culling (the shadow pass uses them)
+	boundsMin = boundsMax = vertexCount > 0 ? vertices[0].Position : DirectX::XMFLOAT3(0, 0, 0);
+	for (unsigned int i = 1; i < vertexCount; i++)
+	{
+		DirectX::XMStoreFloat3(&boundsMin, DirectX::XMVectorMin(DirectX::XMLoadFloat3(&boundsMin), DirectX::XMLoadFloat3(&vertices[i].Position)));
+		DirectX::XMStoreFloat3(&boundsMax, DirectX::XMVectorMax(DirectX::XMLoadFloat3(&boundsMax), DirectX::XMLoadFloat3(&vertices[i].Position)));
+	}
+
 	// Create a VERTEX BUFFER
 	// - This holds the vertex data of triangles for a single object
 	// - This buffer is created on the GPU, which is where the data needs to
@@ -326,7 +345,7 @@ void Mesh::CreateBuffers(const char* name, unsigned int vertexCount, unsigned in
 
 	// Actually create the buffer on the GPU with the initial data
 	// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
-	Graphics::Device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
+	Graphics::GfxDevice->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
 
 	// Create an INDEX BUFFER
 	// - This holds indices to elements in the vertex buffer
@@ -351,8 +370,81 @@ void Mesh::CreateBuffers(const char* name, unsigned int vertexCount, unsigned in
 
 		// Actually create the buffer with the initial data
 		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-		Graphics::Device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+		Graphics::GfxDevice->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+	}
+
+	CreateOcclusionBuffer(vertexCount, indexCount, vertices, indices);
+}
+
+double Mesh::GetOcclusionBakeTime() const
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	return occlusionBakeTicks * 1000.0 / (double)freq.QuadPart;
+}
+
+// Bake settings, part of the cache key like the sky's
+static const OcclusionBakeSettings OcclusionSettings = {};
+
+// Overwrites one console line as the bake goes
+static void PrintOcclusionProgress(unsigned int done, unsigned int total, void* context)
+{
+	printf("\rBaking occlusion for %s: %u%%", (const char*)context, (unsigned int)(done * 100ull / total));
+}
+
+// --------------------------------------------------------
+// Bakes the mesh's occlusion stream (see VertexOcclusion.h)
+// and puts it in an immutable vertex buffer.  The result is
+// cached on disk under the mesh's name, keyed on its vertices,
+// indices and the bake settings, so only the first run after
+// a model changes pays for the rays.
+// --------------------------------------------------------
+void Mesh::CreateOcclusionBuffer(unsigned int vertexCount, unsigned int indexCount,
+	struct Vertex vertices[], unsigned int indices[]) {
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+
+	unsigned long long key = HashShaderBytecode(vertices, sizeof(Vertex) * vertexCount);
+	key = key * 31 + HashShaderBytecode(indices, sizeof(unsigned int) * indexCount);
+	key = key * 31 + HashShaderBytecode(&OcclusionSettings, sizeof(OcclusionSettings));
+
+	std::filesystem::path cacheFolder = FixPath(L"BakeCache");
+	std::wstring cachePath = (cacheFolder / (std::wstring(name, name + strlen(name)) + L".vocc")).wstring();
+
+	std::vector<VertexOcclusion> occlusion;
+	OcclusionBakeStats stats;
+	occlusionCached = LoadVertexOcclusion(cachePath, key, vertexCount, occlusion);
+	occlusionBaked = occlusionCached || BakeVertexOcclusion(
+		&vertices[0].Position.x, &vertices[0].Normal.x, sizeof(Vertex), vertexCount,
+		indices, indexCount, OcclusionSettings, occlusion, &stats,
+		0, PrintOcclusionProgress, (void*)name);
+
+	LARGE_INTEGER end;
+	QueryPerformanceCounter(&end);
+	occlusionBakeTicks = end.QuadPart - start.QuadPart;
+
+	if (!occlusionBaked)
+		UnoccludedVertices(&vertices[0].Normal.x, sizeof(Vertex), vertexCount, occlusion);
+	else if (!occlusionCached)
+	{
+		double ms = GetOcclusionBakeTime();
+		printf("\rBaked occlusion for %s: %u of %u vertices traced, %llu rays in %.1f ms (%.1f million/s)\n",
+			name, stats.TracedVertices, vertexCount, stats.Rays, ms, stats.Rays / (ms * 1000.0));
+
+		// Failing to write just means baking again next run
+		std::error_code error;
+		std::filesystem::create_directories(cacheFolder, error);
+		SaveVertexOcclusion(cachePath, key, occlusion);
 	}
+
+	D3D11_BUFFER_DESC obd = {};
+	obd.Usage = D3D11_USAGE_IMMUTABLE;
+	obd.ByteWidth = sizeof(VertexOcclusion) * vertexCount;
+	obd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+	D3D11_SUBRESOURCE_DATA initialOcclusionData = {};
+	initialOcclusionData.pSysMem = occlusion.data();
+	Graphics::GfxDevice->CreateBuffer(&obd, &initialOcclusionData, occlusionBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -5,6 +5,7 @@
 #include <stdexcept>
 #include <vector>
 #include "Vertex.h"
+#include "VertexOcclusion.h"
 
 class Mesh
 {
@@ -24,11 +25,27 @@ public:
 	// Getters
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer() const { return vertexBuffer; }
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer() const { return indexBuffer; }
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetOcclusionBuffer() const { return occlusionBuffer; }
 
 	unsigned int GetIndexCount() const { return indexCount; }
 	unsigned int GetVertexCount() const { return vertexCount; }
 	const char* GetName() const { return name; }
 
+	// Corners of the box around every vertex, in the mesh's space
+	DirectX::XMFLOAT3 GetBoundsMin() const { return boundsMin; }
+	DirectX::XMFLOAT3 GetBoundsMax() const { return boundsMax; }
+
+	// --------------------------------------------------------
+	// Ambient occlusion and bent normals, baked per vertex when
+	// the mesh is made (or loaded from the bake cache if the
+	// vertices haven't changed) and drawn from their own vertex
+	// stream.  Without a bake the stream is still there, just
+	// wide open, so every shader sees the same inputs.
+	// --------------------------------------------------------
+	bool HasBakedOcclusion() const { return occlusionBaked; }
+	bool WasOcclusionCached() const { return occlusionCached; }
+	double GetOcclusionBakeTime() const;	// Milliseconds
+
 	void Draw();
 
 	// Calculate Tangents
@@ -39,12 +56,24 @@ public:
 		struct Vertex vertices[], unsigned int indices[]);
 
 private:
+	// Bakes (or loads) the occlusion stream and its buffer
+	void CreateOcclusionBuffer(unsigned int vertexCount, unsigned int indexCount,
+		struct Vertex vertices[], unsigned int indices[]);
+
 	// Buffers
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> occlusionBuffer;
 
 	// Mesh data
 	unsigned int indexCount;	// Used when drawing
 	unsigned int vertexCount;	// Good for the UI
 	const char* name;			// Name of Mesh
+	DirectX::XMFLOAT3 boundsMin = {};
+	DirectX::XMFLOAT3 boundsMax = {};
+
+	// Occlusion bake results
+	bool occlusionBaked = false;
+	bool occlusionCached = false;
+	long long occlusionBakeTicks = 0;
 };
@@ -17,7 +17,7 @@ struct VertexToPixel
 };
 
 // New constant buffer data for use with SimpleShaders
-cbuffer ExternalData : register(b0)
+cbuffer PerMaterial : register(b1)
 {
     float4 colorTint : Color;
 };
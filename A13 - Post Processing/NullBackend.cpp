@@ -0,0 +1,676 @@
+#include "NullBackend.h"
+
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ STATS ---------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+// --------------------------------------------------------
+// Total number of calls of any kind since the last reset
+// --------------------------------------------------------
+unsigned long long NullGraphicsStats::TotalCalls() const
+{
+	unsigned long long total = 0;
+	for (size_t i = 0; i < (size_t)GraphicsCall::Count; i++)
+		total += Calls[i];
+	return total;
+}
+
+// --------------------------------------------------------
+// Zeroes the per-call counters (but not the live totals),
+// usually once per frame
+// --------------------------------------------------------
+void NullGraphicsStats::ResetCalls()
+{
+	for (size_t i = 0; i < (size_t)GraphicsCall::Count; i++)
+		Calls[i] = 0;
+	UploadedBytes = 0;
+	VerticesDrawn = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ OBJECTS -------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+NullObject::NullObject(std::shared_ptr<NullGraphicsStats> stats, unsigned long long bufferBytes, unsigned long long textureBytes, UINT rowPitch)
+	: stats(stats), bufferBytes(bufferBytes), textureBytes(textureBytes), rowPitch(rowPitch)
+{
+	stats->LiveObjects++;
+	stats->BufferBytes += bufferBytes;
+	stats->TextureBytes += textureBytes;
+}
+
+NullObject::~NullObject()
+{
+	stats->LiveObjects--;
+	stats->BufferBytes -= bufferBytes;
+	stats->TextureBytes -= textureBytes;
+}
+
+// --------------------------------------------------------
+// Gets CPU memory for Map() to hand out, allocated on first
+// use so unmapped resources cost nothing
+// --------------------------------------------------------
+unsigned char* NullObject::GetMappableData()
+{
+	if (cpuData.size() != GetByteSize())
+		cpuData.resize((size_t)GetByteSize());
+	return cpuData.data();
+}
+
+// --------------------------------------------------------
+// Copies out private data like D3D does: the size alone if
+// there's nowhere to copy to, an AddRef()'d pointer for an
+// interface, and an error if the given space is too small
+// --------------------------------------------------------
+HRESULT NullObject::GetData(REFGUID guid, UINT* dataSize, void* data)
+{
+	if (!dataSize)
+		return E_INVALIDARG;
+
+	for (PrivateData& entry : privateData)
+	{
+		if (entry.Guid != guid)
+			continue;
+
+		UINT size = entry.Interface ? (UINT)sizeof(IUnknown*) : (UINT)entry.Bytes.size();
+		if (!data)
+		{
+			*dataSize = size;
+			return S_OK;
+		}
+		if (*dataSize < size)
+		{
+			*dataSize = size;
+			return DXGI_ERROR_MORE_DATA;
+		}
+
+		*dataSize = size;
+		if (entry.Interface)
+		{
+			entry.Interface->AddRef();
+			*(IUnknown**)data = entry.Interface.Get();
+		}
+		else if (size > 0)
+		{
+			memcpy(data, entry.Bytes.data(), size);
+		}
+		return S_OK;
+	}
+
+	*dataSize = 0;
+	return DXGI_ERROR_NOT_FOUND;
+}
+
+// --------------------------------------------------------
+// Sets, replaces or (with no data) removes private data
+// --------------------------------------------------------
+HRESULT NullObject::SetData(REFGUID guid, UINT dataSize, const void* data)
+{
+	for (size_t i = 0; i < privateData.size(); i++)
+	{
+		if (privateData[i].Guid == guid)
+		{
+			privateData.erase(privateData.begin() + i);
+			break;
+		}
+	}
+
+	if (!data || dataSize == 0)
+		return S_OK;
+
+	PrivateData entry;
+	entry.Guid = guid;
+	entry.Bytes.assign((const unsigned char*)data, (const unsigned char*)data + dataSize);
+	privateData.push_back(entry);
+	return S_OK;
+}
+
+// --------------------------------------------------------
+// Same, but holds a reference to the interface until it's
+// replaced or this object goes away
+// --------------------------------------------------------
+HRESULT NullObject::SetDataInterface(REFGUID guid, const IUnknown* data)
+{
+	HRESULT result = SetData(guid, 0, 0);
+	if (FAILED(result) || !data)
+		return result;
+
+	PrivateData entry;
+	entry.Guid = guid;
+	entry.Interface = const_cast<IUnknown*>(data);
+	privateData.push_back(entry);
+	return S_OK;
+}
+
+NullObject* NullObject::From(IUnknown* object)
+{
+	return dynamic_cast<NullObject*>(object);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ DEVICE --------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	typedef NullResource<ID3D11Buffer, D3D11_BUFFER_DESC, D3D11_RESOURCE_DIMENSION_BUFFER> NullBuffer;
+	typedef NullResource<ID3D11Texture2D, D3D11_TEXTURE2D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE2D> NullTexture2D;
+	typedef NullResource<ID3D11Texture3D, D3D11_TEXTURE3D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE3D> NullTexture3D;
+
+	// What D3D fills in for a view made without a desc: the
+	// resource's format, all of it, as the kind of view that
+	// matches the resource
+	template<typename Desc>
+	Desc DefaultViewDesc(ID3D11Resource* resource, int bufferDimension, int texture2DDimension, int texture3DDimension)
+	{
+		Desc desc = {};
+		D3D11_RESOURCE_DIMENSION type = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+		if (resource)
+			resource->GetType(&type);
+
+		if (type == D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+		{
+			D3D11_TEXTURE2D_DESC textureDesc = {};
+			static_cast<ID3D11Texture2D*>(resource)->GetDesc(&textureDesc);
+			desc.Format = textureDesc.Format;
+			desc.ViewDimension = (decltype(desc.ViewDimension))texture2DDimension;
+		}
+		else if (type == D3D11_RESOURCE_DIMENSION_TEXTURE3D)
+		{
+			D3D11_TEXTURE3D_DESC textureDesc = {};
+			static_cast<ID3D11Texture3D*>(resource)->GetDesc(&textureDesc);
+			desc.Format = textureDesc.Format;
+			desc.ViewDimension = (decltype(desc.ViewDimension))texture3DDimension;
+		}
+		else if (type == D3D11_RESOURCE_DIMENSION_BUFFER)
+		{
+			desc.ViewDimension = (decltype(desc.ViewDimension))bufferDimension;
+		}
+		return desc;
+	}
+}
+
+// --------------------------------------------------------
+// Counts the call and creates the object standing in for
+// what was asked for
+// --------------------------------------------------------
+template<typename Object, typename T, typename... Args>
+HRESULT NullGraphicsDevice::MakeObject(GraphicsCall call, T** out, const Args&... args)
+{
+	stats->Calls[(size_t)call]++;
+
+	// Creation calls are allowed to pass null just to validate params
+	if (!out)
+		return S_FALSE;
+
+	*out = new Object(stats, args...);
+	return S_OK;
+}
+
+HRESULT NullGraphicsDevice::CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer)
+{
+	// Buffers are the only resources Map() can hand memory out for
+	if (!desc)
+		return E_INVALIDARG;
+
+	return MakeObject<NullBuffer>(GraphicsCall::CreateBuffer, buffer, *desc, (unsigned long long)desc->ByteWidth, 0ull, desc->ByteWidth);
+}
+
+HRESULT NullGraphicsDevice::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture)
+{
+	if (!desc)
+		return E_INVALIDARG;
+
+	// Sum every mip of every array slice
+	unsigned long long bitsPerPixel = FormatBitsPerPixel(desc->Format);
+	unsigned long long bytes = 0;
+	UINT mipLevels = desc->MipLevels == 0 ? 1 : desc->MipLevels;
+	for (UINT mip = 0; mip < mipLevels; mip++)
+	{
+		unsigned long long w = (desc->Width >> mip) > 0 ? (desc->Width >> mip) : 1;
+		unsigned long long h = (desc->Height >> mip) > 0 ? (desc->Height >> mip) : 1;
+		bytes += w * h * bitsPerPixel / 8;
+	}
+	bytes *= (unsigned long long)desc->ArraySize * (desc->SampleDesc.Count > 0 ? desc->SampleDesc.Count : 1);
+
+	return MakeObject<NullTexture2D>(GraphicsCall::CreateTexture2D, texture, *desc, 0ull, bytes, (UINT)(desc->Width * bitsPerPixel / 8));
+}
+
+HRESULT NullGraphicsDevice::CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture)
+{
+	if (!desc)
+		return E_INVALIDARG;
+
+	// Sum every mip, which halve in depth as well
+	unsigned long long bitsPerPixel = FormatBitsPerPixel(desc->Format);
+	unsigned long long bytes = 0;
+	UINT mipLevels = desc->MipLevels == 0 ? 1 : desc->MipLevels;
+	for (UINT mip = 0; mip < mipLevels; mip++)
+	{
+		unsigned long long w = (desc->Width >> mip) > 0 ? (desc->Width >> mip) : 1;
+		unsigned long long h = (desc->Height >> mip) > 0 ? (desc->Height >> mip) : 1;
+		unsigned long long d = (desc->Depth >> mip) > 0 ? (desc->Depth >> mip) : 1;
+		bytes += w * h * d * bitsPerPixel / 8;
+	}
+
+	return MakeObject<NullTexture3D>(GraphicsCall::CreateTexture3D, texture, *desc, 0ull, bytes, (UINT)(desc->Width * bitsPerPixel / 8));
+}
+
+HRESULT NullGraphicsDevice::CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** srv)
+{
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = desc ? *desc : DefaultViewDesc<D3D11_SHADER_RESOURCE_VIEW_DESC>(resource,
+		D3D11_SRV_DIMENSION_BUFFER, D3D11_SRV_DIMENSION_TEXTURE2D, D3D11_SRV_DIMENSION_TEXTURE3D);
+	return MakeObject<NullView<ID3D11ShaderResourceView, D3D11_SHADER_RESOURCE_VIEW_DESC>>(GraphicsCall::CreateShaderResourceView, srv, resource, viewDesc);
+}
+
+HRESULT NullGraphicsDevice::CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** rtv)
+{
+	D3D11_RENDER_TARGET_VIEW_DESC viewDesc = desc ? *desc : DefaultViewDesc<D3D11_RENDER_TARGET_VIEW_DESC>(resource,
+		D3D11_RTV_DIMENSION_BUFFER, D3D11_RTV_DIMENSION_TEXTURE2D, D3D11_RTV_DIMENSION_TEXTURE3D);
+	return MakeObject<NullView<ID3D11RenderTargetView, D3D11_RENDER_TARGET_VIEW_DESC>>(GraphicsCall::CreateRenderTargetView, rtv, resource, viewDesc);
+}
+
+HRESULT NullGraphicsDevice::CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** dsv)
+{
+	D3D11_DEPTH_STENCIL_VIEW_DESC viewDesc = desc ? *desc : DefaultViewDesc<D3D11_DEPTH_STENCIL_VIEW_DESC>(resource,
+		D3D11_DSV_DIMENSION_UNKNOWN, D3D11_DSV_DIMENSION_TEXTURE2D, D3D11_DSV_DIMENSION_UNKNOWN);
+	return MakeObject<NullView<ID3D11DepthStencilView, D3D11_DEPTH_STENCIL_VIEW_DESC>>(GraphicsCall::CreateDepthStencilView, dsv, resource, viewDesc);
+}
+
+HRESULT NullGraphicsDevice::CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler)
+{
+	return MakeObject<NullState<ID3D11SamplerState, D3D11_SAMPLER_DESC>>(GraphicsCall::CreateSamplerState, sampler, desc ? *desc : D3D11_SAMPLER_DESC{});
+}
+
+HRESULT NullGraphicsDevice::CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state)
+{
+	return MakeObject<NullState<ID3D11RasterizerState, D3D11_RASTERIZER_DESC>>(GraphicsCall::CreateRasterizerState, state, desc ? *desc : D3D11_RASTERIZER_DESC{});
+}
+
+HRESULT NullGraphicsDevice::CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state)
+{
+	return MakeObject<NullState<ID3D11DepthStencilState, D3D11_DEPTH_STENCIL_DESC>>(GraphicsCall::CreateDepthStencilState, state, desc ? *desc : D3D11_DEPTH_STENCIL_DESC{});
+}
+
+HRESULT NullGraphicsDevice::CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state)
+{
+	return MakeObject<NullState<ID3D11BlendState, D3D11_BLEND_DESC>>(GraphicsCall::CreateBlendState, state, desc ? *desc : D3D11_BLEND_DESC{});
+}
+
+HRESULT NullGraphicsDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const void* bytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout)
+{
+	return MakeObject<NullInterface<ID3D11InputLayout>>(GraphicsCall::CreateInputLayout, inputLayout, 0ull, 0ull, 0u);
+}
+
+HRESULT NullGraphicsDevice::CreateVertexShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11VertexShader** shader)
+{
+	return MakeObject<NullInterface<ID3D11VertexShader>>(GraphicsCall::CreateVertexShader, shader, 0ull, 0ull, 0u);
+}
+
+HRESULT NullGraphicsDevice::CreatePixelShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11PixelShader** shader)
+{
+	return MakeObject<NullInterface<ID3D11PixelShader>>(GraphicsCall::CreatePixelShader, shader, 0ull, 0ull, 0u);
+}
+
+HRESULT NullGraphicsDevice::CreateDomainShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11DomainShader** shader)
+{
+	return MakeObject<NullInterface<ID3D11DomainShader>>(GraphicsCall::CreateDomainShader, shader, 0ull, 0ull, 0u);
+}
+
+HRESULT NullGraphicsDevice::CreateHullShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11HullShader** shader)
+{
+	return MakeObject<NullInterface<ID3D11HullShader>>(GraphicsCall::CreateHullShader, shader, 0ull, 0ull, 0u);
+}
+
+HRESULT NullGraphicsDevice::CreateGeometryShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader)
+{
+	return MakeObject<NullInterface<ID3D11GeometryShader>>(GraphicsCall::CreateGeometryShader, shader, 0ull, 0ull, 0u);
+}
+
+HRESULT NullGraphicsDevice::CreateGeometryShaderWithStreamOutput(const void* bytecode, SIZE_T bytecodeLength, const D3D11_SO_DECLARATION_ENTRY* soDeclaration, UINT numEntries, const UINT* bufferStrides, UINT numStrides, UINT rasterizedStream, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader)
+{
+	return MakeObject<NullInterface<ID3D11GeometryShader>>(GraphicsCall::CreateGeometryShaderWithStreamOutput, shader, 0ull, 0ull, 0u);
+}
+
+HRESULT NullGraphicsDevice::CreateComputeShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11ComputeShader** shader)
+{
+	return MakeObject<NullInterface<ID3D11ComputeShader>>(GraphicsCall::CreateComputeShader, shader, 0ull, 0ull, 0u);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ CONTEXT -------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+void NullGraphicsContext::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	this->inputLayout = inputLayout;
+	Count(GraphicsCall::IASetInputLayout);
+}
+
+void NullGraphicsContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	Count(GraphicsCall::IASetPrimitiveTopology);
+}
+
+void NullGraphicsContext::IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	Hold(vertexBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::IASetVertexBuffers);
+}
+
+void NullGraphicsContext::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	indexBuffer = buffer;
+	Count(GraphicsCall::IASetIndexBuffer);
+}
+
+void NullGraphicsContext::VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	vertexStage.Shader = shader;
+	Count(GraphicsCall::VSSetShader);
+}
+
+void NullGraphicsContext::VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	Hold(vertexStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::VSSetConstantBuffers);
+}
+
+void NullGraphicsContext::VSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	Hold(vertexStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::VSSetConstantBuffers1);
+}
+
+void NullGraphicsContext::VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	Hold(vertexStage.ShaderResources, startSlot, numViews, views);
+	Count(GraphicsCall::VSSetShaderResources);
+}
+
+void NullGraphicsContext::VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	Hold(vertexStage.Samplers, startSlot, numSamplers, samplers);
+	Count(GraphicsCall::VSSetSamplers);
+}
+
+void NullGraphicsContext::PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	pixelStage.Shader = shader;
+	Count(GraphicsCall::PSSetShader);
+}
+
+void NullGraphicsContext::PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	Hold(pixelStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::PSSetConstantBuffers);
+}
+
+void NullGraphicsContext::PSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	Hold(pixelStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::PSSetConstantBuffers1);
+}
+
+void NullGraphicsContext::PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	Hold(pixelStage.ShaderResources, startSlot, numViews, views);
+	Count(GraphicsCall::PSSetShaderResources);
+}
+
+void NullGraphicsContext::PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	Hold(pixelStage.Samplers, startSlot, numSamplers, samplers);
+	Count(GraphicsCall::PSSetSamplers);
+}
+
+void NullGraphicsContext::DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	domainStage.Shader = shader;
+	Count(GraphicsCall::DSSetShader);
+}
+
+void NullGraphicsContext::DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	Hold(domainStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::DSSetConstantBuffers);
+}
+
+void NullGraphicsContext::DSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	Hold(domainStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::DSSetConstantBuffers1);
+}
+
+void NullGraphicsContext::DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	Hold(domainStage.ShaderResources, startSlot, numViews, views);
+	Count(GraphicsCall::DSSetShaderResources);
+}
+
+void NullGraphicsContext::DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	Hold(domainStage.Samplers, startSlot, numSamplers, samplers);
+	Count(GraphicsCall::DSSetSamplers);
+}
+
+void NullGraphicsContext::HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	hullStage.Shader = shader;
+	Count(GraphicsCall::HSSetShader);
+}
+
+void NullGraphicsContext::HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	Hold(hullStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::HSSetConstantBuffers);
+}
+
+void NullGraphicsContext::HSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	Hold(hullStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::HSSetConstantBuffers1);
+}
+
+void NullGraphicsContext::HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	Hold(hullStage.ShaderResources, startSlot, numViews, views);
+	Count(GraphicsCall::HSSetShaderResources);
+}
+
+void NullGraphicsContext::HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	Hold(hullStage.Samplers, startSlot, numSamplers, samplers);
+	Count(GraphicsCall::HSSetSamplers);
+}
+
+void NullGraphicsContext::GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	geometryStage.Shader = shader;
+	Count(GraphicsCall::GSSetShader);
+}
+
+void NullGraphicsContext::GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	Hold(geometryStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::GSSetConstantBuffers);
+}
+
+void NullGraphicsContext::GSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	Hold(geometryStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::GSSetConstantBuffers1);
+}
+
+void NullGraphicsContext::GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	Hold(geometryStage.ShaderResources, startSlot, numViews, views);
+	Count(GraphicsCall::GSSetShaderResources);
+}
+
+void NullGraphicsContext::GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	Hold(geometryStage.Samplers, startSlot, numSamplers, samplers);
+	Count(GraphicsCall::GSSetSamplers);
+}
+
+void NullGraphicsContext::CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	computeStage.Shader = shader;
+	Count(GraphicsCall::CSSetShader);
+}
+
+void NullGraphicsContext::CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	Hold(computeStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::CSSetConstantBuffers);
+}
+
+void NullGraphicsContext::CSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	Hold(computeStage.ConstantBuffers, startSlot, numBuffers, buffers);
+	Count(GraphicsCall::CSSetConstantBuffers1);
+}
+
+void NullGraphicsContext::CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	Hold(computeStage.ShaderResources, startSlot, numViews, views);
+	Count(GraphicsCall::CSSetShaderResources);
+}
+
+void NullGraphicsContext::CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	Hold(computeStage.Samplers, startSlot, numSamplers, samplers);
+	Count(GraphicsCall::CSSetSamplers);
+}
+
+void NullGraphicsContext::CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* uavs, const UINT* initialCounts)
+{
+	Hold(unorderedAccessViews, startSlot, numUAVs, uavs);
+	Count(GraphicsCall::CSSetUnorderedAccessViews);
+}
+
+void NullGraphicsContext::SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets)
+{
+	for (UINT i = 0; i < D3D11_SO_BUFFER_SLOT_COUNT; i++)
+		streamOutTargets[i] = targets && i < numBuffers ? targets[i] : 0;
+	Count(GraphicsCall::SOSetTargets);
+}
+
+void NullGraphicsContext::RSSetState(ID3D11RasterizerState* state)
+{
+	rasterizerState = state;
+	Count(GraphicsCall::RSSetState);
+}
+
+void NullGraphicsContext::RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports)
+{
+	Count(GraphicsCall::RSSetViewports);
+}
+
+void NullGraphicsContext::OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv)
+{
+	// Slots past the ones given are unbound
+	for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+		renderTargets[i] = rtvs && i < numViews ? rtvs[i] : 0;
+	depthStencilView = dsv;
+	Count(GraphicsCall::OMSetRenderTargets);
+}
+
+void NullGraphicsContext::OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef)
+{
+	depthStencilState = state;
+	Count(GraphicsCall::OMSetDepthStencilState);
+}
+
+void NullGraphicsContext::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+	blendState = state;
+	Count(GraphicsCall::OMSetBlendState);
+}
+
+void NullGraphicsContext::ClearRenderTargetView(ID3D11RenderTargetView* rtv, const FLOAT color[4])
+{
+	Count(GraphicsCall::ClearRenderTargetView);
+}
+
+void NullGraphicsContext::ClearDepthStencilView(ID3D11DepthStencilView* dsv, UINT clearFlags, FLOAT depth, UINT8 stencil)
+{
+	Count(GraphicsCall::ClearDepthStencilView);
+}
+
+void NullGraphicsContext::UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch)
+{
+	Count(GraphicsCall::UpdateSubresource);
+
+	NullObject* object = NullObject::From(resource);
+	if (!object || !data)
+		return;
+
+	// Buffers only use the box's X range; textures are
+	// counted as a full upload since nothing reads them back
+	unsigned long long size = object->GetByteSize();
+	unsigned long long offset = 0;
+	if (box && object->GetRowPitch() == size)
+	{
+		offset = box->left;
+		size = box->right > box->left ? box->right - box->left : 0;
+	}
+	stats->UploadedBytes += size;
+
+	// Keep buffer contents so a later Map() or trace sees them
+	if (object->GetRowPitch() == object->GetByteSize() && offset + size <= object->GetByteSize())
+		memcpy(object->GetMappableData() + offset, data, (size_t)size);
+}
+
+HRESULT NullGraphicsContext::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped)
+{
+	Count(GraphicsCall::Map);
+
+	NullObject* object = NullObject::From(resource);
+	if (!object || !mapped)
+		return E_INVALIDARG;
+
+	mapped->pData = object->GetMappableData();
+	mapped->RowPitch = object->GetRowPitch();
+	mapped->DepthPitch = (UINT)object->GetByteSize();
+
+	// A NO_OVERWRITE map only fills in part of the buffer, and
+	// whoever sub-allocates from it keeps count of how much.  A
+	// read uploads nothing.
+	if (mapType != D3D11_MAP_WRITE_NO_OVERWRITE && mapType != D3D11_MAP_READ)
+		stats->UploadedBytes += object->GetByteSize();
+	return S_OK;
+}
+
+void NullGraphicsContext::Unmap(ID3D11Resource* resource, UINT subresource)
+{
+	Count(GraphicsCall::Unmap);
+}
+
+void NullGraphicsContext::CopySubresourceRegion(ID3D11Resource* dest, UINT destSubresource, UINT destX, UINT destY, UINT destZ, ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox)
+{
+	Count(GraphicsCall::CopySubresourceRegion);
+}
+
+void NullGraphicsContext::Draw(UINT vertexCount, UINT startVertex)
+{
+	Count(GraphicsCall::Draw);
+	stats->VerticesDrawn += vertexCount;
+}
+
+void NullGraphicsContext::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	Count(GraphicsCall::DrawIndexed);
+	stats->VerticesDrawn += indexCount;
+}
+
+void NullGraphicsContext::Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ)
+{
+	Count(GraphicsCall::Dispatch);
+}
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <wrl/client.h>
+#include "GraphicsAPI.h"
+
+// --------------------------------------------------------
+// Everything the null backend has seen.  Call counts are
+// cumulative until ResetCalls(); the byte/object totals
+// track what is currently alive.
+// --------------------------------------------------------
+struct NullGraphicsStats
+{
+	unsigned long long Calls[(size_t)GraphicsCall::Count] = {};
+
+	unsigned long long LiveObjects = 0;		// Resources, views, states and shaders not yet released
+	unsigned long long BufferBytes = 0;		// Bytes held by live buffers
+	unsigned long long TextureBytes = 0;	// Bytes held by live textures (all mips and slices)
+	unsigned long long UploadedBytes = 0;	// Bytes written through UpdateSubresource and Map
+	unsigned long long VerticesDrawn = 0;	// Vertex/index counts passed to Draw calls
+
+	unsigned long long TotalCalls() const;
+	void ResetCalls();
+};
+
+// --------------------------------------------------------
+// What every object the null device creates keeps track of:
+// the stats it counts towards, its size, CPU memory for Map()
+// and any private data set on it
+// --------------------------------------------------------
+class NullObject
+{
+public:
+	NullObject(std::shared_ptr<NullGraphicsStats> stats, unsigned long long bufferBytes, unsigned long long textureBytes, UINT rowPitch);
+	virtual ~NullObject();
+
+	unsigned long long GetByteSize() const { return bufferBytes + textureBytes; }
+	UINT GetRowPitch() const { return rowPitch; }
+	unsigned char* GetMappableData();
+
+	// The ID3D11DeviceChild private data calls, for whichever
+	// interface this object is
+	HRESULT GetData(REFGUID guid, UINT* dataSize, void* data);
+	HRESULT SetData(REFGUID guid, UINT dataSize, const void* data);
+	HRESULT SetDataInterface(REFGUID guid, const IUnknown* data);
+
+	// Gets the object behind an interface the null device
+	// handed out, or null for anything else
+	static NullObject* From(IUnknown* object);
+
+private:
+	std::shared_ptr<NullGraphicsStats> stats;
+	unsigned long long bufferBytes;
+	unsigned long long textureBytes;
+	UINT rowPitch;
+	std::vector<unsigned char> cpuData; // Backing memory handed out by Map()
+
+	// Released along with the object, as D3D does
+	struct PrivateData
+	{
+		GUID Guid;
+		std::vector<unsigned char> Bytes;
+		Microsoft::WRL::ComPtr<IUnknown> Interface;
+	};
+	std::vector<PrivateData> privateData;
+};
+
+// --------------------------------------------------------
+// A null object as one of the D3D interfaces.  Every method
+// of the interface works: IUnknown and the private data as
+// D3D's do, the rest through the subclasses below.
+// --------------------------------------------------------
+template<typename Interface>
+class NullInterface : public Interface, public NullObject
+{
+public:
+	using NullObject::NullObject;
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override;
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++refCount; }
+	ULONG STDMETHODCALLTYPE Release() override;
+
+	// There's no device to hand back
+	void STDMETHODCALLTYPE GetDevice(ID3D11Device** device) override { if (device) *device = 0; }
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* dataSize, void* data) override { return NullObject::GetData(guid, dataSize, data); }
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT dataSize, const void* data) override { return NullObject::SetData(guid, dataSize, data); }
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* data) override { return NullObject::SetDataInterface(guid, data); }
+
+private:
+	std::atomic<ULONG> refCount{ 1 };
+};
+
+template<typename Interface>
+HRESULT STDMETHODCALLTYPE NullInterface<Interface>::QueryInterface(REFIID riid, void** object)
+{
+	if (!object)
+		return E_POINTER;
+
+	// The interface itself or any it derives from
+	if (riid == __uuidof(Interface) || riid == __uuidof(ID3D11DeviceChild) || riid == __uuidof(IUnknown) ||
+		(std::is_base_of<ID3D11Resource, Interface>::value && riid == __uuidof(ID3D11Resource)) ||
+		(std::is_base_of<ID3D11View, Interface>::value && riid == __uuidof(ID3D11View)))
+	{
+		*object = static_cast<Interface*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*object = 0;
+	return E_NOINTERFACE;
+}
+
+template<typename Interface>
+ULONG STDMETHODCALLTYPE NullInterface<Interface>::Release()
+{
+	ULONG count = --refCount;
+	if (count == 0)
+		delete this;
+	return count;
+}
+
+// --------------------------------------------------------
+// A buffer or texture, which remembers the desc it was made
+// with for GetDesc()
+// --------------------------------------------------------
+template<typename Interface, typename Desc, D3D11_RESOURCE_DIMENSION Dimension>
+class NullResource : public NullInterface<Interface>
+{
+public:
+	NullResource(std::shared_ptr<NullGraphicsStats> stats, const Desc& desc, unsigned long long bufferBytes, unsigned long long textureBytes, UINT rowPitch)
+		: NullInterface<Interface>(stats, bufferBytes, textureBytes, rowPitch), desc(desc) {}
+
+	void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* dimension) override { *dimension = Dimension; }
+	void STDMETHODCALLTYPE SetEvictionPriority(UINT priority) override { evictionPriority = priority; }
+	UINT STDMETHODCALLTYPE GetEvictionPriority() override { return evictionPriority; }
+	void STDMETHODCALLTYPE GetDesc(Desc* out) override { *out = desc; }
+
+private:
+	Desc desc;
+	UINT evictionPriority = 0;
+};
+
+// --------------------------------------------------------
+// A view, which keeps its resource alive like D3D's do
+// --------------------------------------------------------
+template<typename Interface, typename Desc>
+class NullView : public NullInterface<Interface>
+{
+public:
+	NullView(std::shared_ptr<NullGraphicsStats> stats, ID3D11Resource* resource, const Desc& desc)
+		: NullInterface<Interface>(stats, 0, 0, 0), resource(resource), desc(desc) {}
+
+	void STDMETHODCALLTYPE GetResource(ID3D11Resource** out) override { resource.CopyTo(out); }
+	void STDMETHODCALLTYPE GetDesc(Desc* out) override { *out = desc; }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	Desc desc;
+};
+
+// --------------------------------------------------------
+// A sampler, rasterizer, depth stencil or blend state
+// --------------------------------------------------------
+template<typename Interface, typename Desc>
+class NullState : public NullInterface<Interface>
+{
+public:
+	NullState(std::shared_ptr<NullGraphicsStats> stats, const Desc& desc)
+		: NullInterface<Interface>(stats, 0, 0, 0), desc(desc) {}
+
+	void STDMETHODCALLTYPE GetDesc(Desc* out) override { *out = desc; }
+
+private:
+	Desc desc;
+};
+
+// --------------------------------------------------------
+// Device that accepts every creation call without a GPU
+// --------------------------------------------------------
+class NullGraphicsDevice : public IGraphicsDevice
+{
+public:
+	NullGraphicsDevice(std::shared_ptr<NullGraphicsStats> stats) : stats(stats) {}
+
+	ID3D11Device* GetD3DDevice() override { return 0; }
+	bool SupportsConstantBufferOffsets() override { return true; }
+	bool SupportsPartialConstantBufferUpdates() override { return true; }
+	std::shared_ptr<NullGraphicsStats> GetStats() { return stats; }
+
+	HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer) override;
+	HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture) override;
+	HRESULT CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture) override;
+	HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** srv) override;
+	HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** rtv) override;
+	HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** dsv) override;
+
+	HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler) override;
+	HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state) override;
+	HRESULT CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state) override;
+	HRESULT CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state) override;
+
+	HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const void* bytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout) override;
+	HRESULT CreateVertexShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11VertexShader** shader) override;
+	HRESULT CreatePixelShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11PixelShader** shader) override;
+	HRESULT CreateDomainShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11DomainShader** shader) override;
+	HRESULT CreateHullShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11HullShader** shader) override;
+	HRESULT CreateGeometryShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader) override;
+	HRESULT CreateGeometryShaderWithStreamOutput(const void* bytecode, SIZE_T bytecodeLength,
+		const D3D11_SO_DECLARATION_ENTRY* soDeclaration, UINT numEntries, const UINT* bufferStrides, UINT numStrides,
+		UINT rasterizedStream, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader) override;
+	HRESULT CreateComputeShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11ComputeShader** shader) override;
+
+private:
+	std::shared_ptr<NullGraphicsStats> stats;
+
+	// Creates a tracked object and hands it out as the requested interface
+	template<typename Object, typename T, typename... Args>
+	HRESULT MakeObject(GraphicsCall call, T** out, const Args&... args);
+};
+
+// --------------------------------------------------------
+// Context that counts every call and otherwise does nothing
+// but hold what's bound, with a reference each, as D3D11's
+// context does.  Without that a bound object could be freed
+// and its address handed to a new one, which the state cache
+// (it only remembers pointers) would take for the old one.
+// --------------------------------------------------------
+class NullGraphicsContext : public IGraphicsContext
+{
+public:
+	NullGraphicsContext(std::shared_ptr<NullGraphicsStats> stats) : stats(stats) {}
+
+	ID3D11DeviceContext* GetD3DContext() override { return 0; }
+	std::shared_ptr<NullGraphicsStats> GetStats() { return stats; }
+
+	void IASetInputLayout(ID3D11InputLayout* inputLayout) override;
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+	void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override;
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override;
+
+	void VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void VSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void PSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void DSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void HSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void GSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void CSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+	void CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* uavs, const UINT* initialCounts) override;
+
+	void SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets) override;
+
+	void RSSetState(ID3D11RasterizerState* state) override;
+	void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports) override;
+
+	void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv) override;
+	void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef) override;
+	void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) override;
+
+	void ClearRenderTargetView(ID3D11RenderTargetView* rtv, const FLOAT color[4]) override;
+	void ClearDepthStencilView(ID3D11DepthStencilView* dsv, UINT clearFlags, FLOAT depth, UINT8 stencil) override;
+
+	void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch) override;
+	HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) override;
+	void Unmap(ID3D11Resource* resource, UINT subresource) override;
+	void CopySubresourceRegion(ID3D11Resource* dest, UINT destSubresource, UINT destX, UINT destY, UINT destZ,
+		ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox) override;
+
+	void Draw(UINT vertexCount, UINT startVertex) override;
+	void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) override;
+	void Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ) override;
+
+private:
+	std::shared_ptr<NullGraphicsStats> stats;
+
+	// One shader stage's bindings
+	struct BoundStage
+	{
+		Microsoft::WRL::ComPtr<ID3D11DeviceChild> Shader;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ShaderResources[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> Samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+	};
+	BoundStage vertexStage, pixelStage, domainStage, hullStage, geometryStage, computeStage;
+
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> unorderedAccessViews[D3D11_PS_CS_UAV_REGISTER_COUNT];
+	Microsoft::WRL::ComPtr<ID3D11Buffer> streamOutTargets[D3D11_SO_BUFFER_SLOT_COUNT];
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> rasterizerState;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> renderTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthStencilView;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depthStencilState;
+	Microsoft::WRL::ComPtr<ID3D11BlendState> blendState;
+
+	void Count(GraphicsCall call) { stats->Calls[(size_t)call]++; }
+
+	// Holds count objects (or nulls, if objects is null)
+	// from the start slot on, ignoring slots past the end
+	template<typename T, size_t Slots>
+	static void Hold(Microsoft::WRL::ComPtr<T> (&slots)[Slots], UINT startSlot, UINT count, T* const* objects)
+	{
+		for (UINT i = 0; i < count && startSlot + i < Slots; i++)
+			slots[startSlot + i] = objects ? objects[i] : 0;
+	}
+};
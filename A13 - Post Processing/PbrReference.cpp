@@ -0,0 +1,613 @@
+#include "PbrReference.h"
+
+#include <atomic>
+#include <immintrin.h>
+#include <math.h>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2,fma")))
+#endif
+
+// The shader's constants
+#define LIGHT_TYPE_DIRECTION 0
+#define LIGHT_TYPE_POINT 1
+#define LIGHT_TYPE_SPOT 2
+
+static const float F0_NON_METAL = 0.04f;
+static const float MIN_ROUGHNESS = 0.0000001f;
+static const float PI = 3.14159265359f;
+
+namespace PbrReference
+{
+	static_assert(sizeof(Light) == 64, "Light doesn't match HLSL");
+
+	// --------------------------------------------------------
+	// The bits of HLSL's vector math the shader uses
+	// --------------------------------------------------------
+	static float3 operator+(float3 a, float3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	static float3 operator-(float3 a, float3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	static float3 operator*(float3 a, float3 b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+	static float3 operator*(float3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	static float3 operator/(float3 a, float s) { return { a.x / s, a.y / s, a.z / s }; }
+	static float3 operator-(float3 a) { return { -a.x, -a.y, -a.z }; }
+	static float3 Splat(float s) { return { s, s, s }; }
+	static float dot(float3 a, float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	static float3 normalize(float3 a) { return a / sqrtf(dot(a, a)); }
+	static float distance(float3 a, float3 b) { return sqrtf(dot(a - b, a - b)); }
+	static float saturate(float s) { return s < 0 ? 0 : (s > 1 ? 1 : s); }
+	static float3 pow(float3 a, float p) { return { powf(a.x, p), powf(a.y, p), powf(a.z, p) }; }
+
+	float DiffusePBR(float3 normal, float3 dirToLight)
+	{
+		return saturate(dot(normal, dirToLight));
+	}
+
+	float3 DiffuseEnergyConserve(float diffuse, float3 F, float metalness)
+	{
+		return Splat(diffuse) * (Splat(1) - F) * (1 - metalness);
+	}
+
+	float D_GGX(float3 n, float3 h, float roughness)
+	{
+		float NdotH = saturate(dot(n, h));
+		float NdotH2 = NdotH * NdotH;
+		float a = roughness * roughness;
+		float a2 = fmaxf(a * a, MIN_ROUGHNESS);
+
+		float denomToSquare = NdotH2 * (a2 - 1) + 1;
+		return a2 / (PI * denomToSquare * denomToSquare);
+	}
+
+	float3 F_Schlick(float3 v, float3 h, float3 f0)
+	{
+		float VdotH = saturate(dot(v, h));
+		return f0 + (Splat(1) - f0) * powf(1 - VdotH, 5);
+	}
+
+	float G_SchlickGGX(float3 n, float3 v, float roughness)
+	{
+		float k = powf(roughness + 1, 2) / 8.0f;
+		float NdotV = saturate(dot(n, v));
+		return 1 / (NdotV * (1 - k) + k);
+	}
+
+	float3 MicrofacetBRDF(float3 n, float3 l, float3 v, float roughness, float3 f0, float3& F_out)
+	{
+		float3 h = normalize(v + l);
+
+		float D = D_GGX(n, h, roughness);
+		float3 F = F_Schlick(v, h, f0);
+		float G = G_SchlickGGX(n, v, roughness) * G_SchlickGGX(n, l, roughness);
+		F_out = F;
+
+		float3 specularResult = F * D * G / 4;
+		return specularResult * fmaxf(dot(n, l), 0);
+	}
+
+	float CalculateFalloff(const Light& light, float3 worldPosition)
+	{
+		float pixelAngle = saturate(dot(normalize(light.Position - worldPosition), -light.Direction));
+
+		float cosOuter = cosf(light.SpotOuterAngle);
+		float cosInner = cosf(light.SpotInnerAngle);
+		float falloffRange = cosOuter - cosInner;
+		return saturate((cosOuter - pixelAngle) / falloffRange);
+	}
+
+	float CalculateAttenuation(const Light& light, float3 worldPosition)
+	{
+		float dist = distance(light.Position, worldPosition);
+		float att = saturate(1.0f - (dist * dist / (light.Range * light.Range)));
+		return att * att;
+	}
+
+	// What every light type has in common once it knows which
+	// way the light comes from
+	static float3 LightAmount(const Light& light, const Frame& frame, float3 direction, float3 normal, float3 surfaceColor, float3 specularColor, float metalness, float roughness)
+	{
+		float3 F;
+		float diffuse = DiffusePBR(normal, direction);
+		float3 specular = MicrofacetBRDF(normal, direction, frame.CameraPosition, roughness, specularColor, F);
+
+		float3 balancedDiff = DiffuseEnergyConserve(diffuse, F, metalness);
+		return (balancedDiff * surfaceColor + specular) * light.Intensity * light.Color;
+	}
+
+	float3 DirectionalLight(const Light& light, const Frame& frame, float3 normal, float3 surfaceColor, float3 specularColor, float metalness, float roughness)
+	{
+		return LightAmount(light, frame, normalize(light.Direction), normal, surfaceColor, specularColor, metalness, roughness);
+	}
+
+	float3 PointLight(const Light& light, const Frame& frame, float3 worldPosition, float3 normal, float3 surfaceColor, float3 specularColor, float metalness, float roughness)
+	{
+		float3 direction = normalize(worldPosition - light.Position);
+		return LightAmount(light, frame, direction, normal, surfaceColor, specularColor, metalness, roughness) *
+			CalculateAttenuation(light, worldPosition);
+	}
+
+	float3 SpotLight(const Light& light, const Frame& frame, float3 worldPosition, float3 normal, float3 surfaceColor, float3 specularColor, float metalness, float roughness)
+	{
+		return LightAmount(light, frame, normalize(light.Direction), normal, surfaceColor, specularColor, metalness, roughness) *
+			(CalculateAttenuation(light, worldPosition) * CalculateFalloff(light, worldPosition));
+	}
+
+	float3 SkyIrradiance(const Frame& frame, float3 n)
+	{
+		const float3* sh = frame.Irradiance;
+		float3 result =
+			sh[0] * 0.282095f +
+			sh[1] * (0.488603f * n.y) +
+			sh[2] * (0.488603f * n.z) +
+			sh[3] * (0.488603f * n.x) +
+			sh[4] * (1.092548f * n.x * n.y) +
+			sh[5] * (1.092548f * n.y * n.z) +
+			sh[6] * (0.315392f * (3.0f * n.z * n.z - 1.0f)) +
+			sh[7] * (1.092548f * n.x * n.z) +
+			sh[8] * (0.546274f * (n.x * n.x - n.y * n.y));
+		return { fmaxf(result.x, 0), fmaxf(result.y, 0), fmaxf(result.z, 0) };
+	}
+
+	float3 CalculateLightingTotal(const Frame& frame, const Surface& surface, float3 surfaceColor, float3 specularColor)
+	{
+		float3 total = frame.Ambient * SkyIrradiance(frame, surface.Normal);
+		for (size_t i = 0; i < frame.Lights.size(); i++)
+		{
+			const Light& light = frame.Lights[i];
+			float shadow = light.ShadowTile >= 0 ? surface.ShadowAmount : 1.0f;
+			switch (light.Type)
+			{
+			case LIGHT_TYPE_DIRECTION:
+				total = total + DirectionalLight(light, frame, surface.Normal, surfaceColor, specularColor, surface.Metalness, surface.Roughness) * shadow;
+				break;
+
+			case LIGHT_TYPE_POINT:
+				total = total + PointLight(light, frame, surface.WorldPosition, surface.Normal, surfaceColor, specularColor, surface.Metalness, surface.Roughness) * shadow;
+				break;
+
+			case LIGHT_TYPE_SPOT:
+				total = total + SpotLight(light, frame, surface.WorldPosition, surface.Normal, surfaceColor, specularColor, surface.Metalness, surface.Roughness) * shadow;
+				break;
+			}
+		}
+		return total * surfaceColor;
+	}
+
+	float3 Shade(const Frame& frame, const Surface& surface)
+	{
+		float3 albedoColor = pow(surface.Albedo, 2.2f);
+		float3 specularColor = Splat(F0_NON_METAL) + (albedoColor - Splat(F0_NON_METAL)) * surface.Metalness;
+		float3 surfaceColor = surface.ColorTint * albedoColor;
+
+		float3 totalLight = CalculateLightingTotal(frame, surface, surfaceColor, specularColor);
+		return pow(totalLight, 1.0f / 2.2f);
+	}
+
+	bool HasAvx2()
+	{
+		static const bool supported = []()
+		{
+#if defined(_MSC_VER)
+			int info[4] = {};
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return false;
+
+			// AVX and FMA, with the OS saving the wider registers
+			__cpuid(info, 1);
+			bool fma = (info[2] >> 12 & 1) != 0;
+			bool osxsave = (info[2] >> 27 & 1) != 0;
+			bool avx = (info[2] >> 28 & 1) != 0;
+			if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+				return false;
+
+			__cpuidex(info, 7, 0);
+			return (info[1] >> 5 & 1) != 0;
+#else
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+		}();
+		return supported;
+	}
+
+	// --------------------------------------------------------
+	// The same math, 8 lanes at a time
+	// --------------------------------------------------------
+	struct Float3x8
+	{
+		__m256 x, y, z;
+	};
+
+	AVX2_FUNCTION static inline Float3x8 Broadcast8(float3 a) { return { _mm256_set1_ps(a.x), _mm256_set1_ps(a.y), _mm256_set1_ps(a.z) }; }
+	AVX2_FUNCTION static inline Float3x8 Load8(const float* x, const float* y, const float* z) { return { _mm256_loadu_ps(x), _mm256_loadu_ps(y), _mm256_loadu_ps(z) }; }
+	AVX2_FUNCTION static inline Float3x8 Add8(const Float3x8& a, const Float3x8& b) { return { _mm256_add_ps(a.x, b.x), _mm256_add_ps(a.y, b.y), _mm256_add_ps(a.z, b.z) }; }
+	AVX2_FUNCTION static inline Float3x8 Sub8(const Float3x8& a, const Float3x8& b) { return { _mm256_sub_ps(a.x, b.x), _mm256_sub_ps(a.y, b.y), _mm256_sub_ps(a.z, b.z) }; }
+	AVX2_FUNCTION static inline Float3x8 Mul8(const Float3x8& a, const Float3x8& b) { return { _mm256_mul_ps(a.x, b.x), _mm256_mul_ps(a.y, b.y), _mm256_mul_ps(a.z, b.z) }; }
+	AVX2_FUNCTION static inline Float3x8 Scale8(const Float3x8& a, __m256 s) { return { _mm256_mul_ps(a.x, s), _mm256_mul_ps(a.y, s), _mm256_mul_ps(a.z, s) }; }
+	AVX2_FUNCTION static inline __m256 Dot8(const Float3x8& a, const Float3x8& b) { return _mm256_fmadd_ps(a.x, b.x, _mm256_fmadd_ps(a.y, b.y, _mm256_mul_ps(a.z, b.z))); }
+	AVX2_FUNCTION static inline Float3x8 Normalize8(const Float3x8& a) { return Scale8(a, _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(Dot8(a, a)))); }
+	AVX2_FUNCTION static inline __m256 Saturate8(__m256 s) { return _mm256_min_ps(_mm256_max_ps(s, _mm256_setzero_ps()), _mm256_set1_ps(1.0f)); }
+
+	// Natural log and exp, after Cephes (and sse_mathfun)
+	AVX2_FUNCTION static inline __m256 Log8(__m256 x)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		x = _mm256_max_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x00800000)));
+
+		// Split into exponent and a mantissa in [0.5, 1)
+		__m256i bits = _mm256_castps_si256(x);
+		__m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+		x = _mm256_or_ps(_mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(~0x7f800000))), _mm256_set1_ps(0.5f));
+
+		// Then into [sqrt(0.5), sqrt(2)) - 1
+		__m256 small = _mm256_cmp_ps(x, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+		__m256 extra = _mm256_and_ps(x, small);
+		x = _mm256_sub_ps(x, one);
+		e = _mm256_sub_ps(e, _mm256_and_ps(one, small));
+		x = _mm256_add_ps(x, extra);
+
+		__m256 z = _mm256_mul_ps(x, x);
+		__m256 y = _mm256_set1_ps(7.0376836292E-2f);
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(-1.1514610310E-1f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.1676998740E-1f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(-1.2420140846E-1f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.4249322787E-1f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(-1.6668057665E-1f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(2.0000714765E-1f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(-2.4999993993E-1f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(3.3333331174E-1f));
+		y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+
+		y = _mm256_fmadd_ps(e, _mm256_set1_ps(-2.12194440e-4f), y);
+		y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, y);
+		x = _mm256_add_ps(x, y);
+		return _mm256_fmadd_ps(e, _mm256_set1_ps(0.693359375f), x);
+	}
+
+	AVX2_FUNCTION static inline __m256 Exp8(__m256 x)
+	{
+		x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f)), _mm256_set1_ps(88.3762626647949f));
+
+		// exp(x) = 2^n * exp(r), |r| <= ln(2) / 2
+		__m256 n = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f), _mm256_set1_ps(0.5f)));
+		x = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+		x = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), x);
+
+		__m256 z = _mm256_mul_ps(x, x);
+		__m256 y = _mm256_set1_ps(1.9875691500E-4f);
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507E-3f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073E-3f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894E-2f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459E-1f));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201E-1f));
+		y = _mm256_add_ps(_mm256_fmadd_ps(y, z, x), _mm256_set1_ps(1.0f));
+
+		__m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23);
+		return _mm256_mul_ps(y, _mm256_castsi256_ps(exponent));
+	}
+
+	// Only for x >= 0, which is all the shader raises to powers
+	AVX2_FUNCTION static inline __m256 Pow8(__m256 x, float p)
+	{
+		__m256 result = Exp8(_mm256_mul_ps(Log8(x), _mm256_set1_ps(p)));
+		return _mm256_and_ps(result, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ));
+	}
+
+	AVX2_FUNCTION static inline __m256 D_GGX8(const Float3x8& n, const Float3x8& h, __m256 roughness)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		__m256 NdotH = Saturate8(Dot8(n, h));
+		__m256 a = _mm256_mul_ps(roughness, roughness);
+		__m256 a2 = _mm256_max_ps(_mm256_mul_ps(a, a), _mm256_set1_ps(MIN_ROUGHNESS));
+		__m256 denomToSquare = _mm256_fmadd_ps(_mm256_mul_ps(NdotH, NdotH), _mm256_sub_ps(a2, one), one);
+		return _mm256_div_ps(a2, _mm256_mul_ps(_mm256_set1_ps(PI), _mm256_mul_ps(denomToSquare, denomToSquare)));
+	}
+
+	AVX2_FUNCTION static inline Float3x8 F_Schlick8(const Float3x8& v, const Float3x8& h, const Float3x8& f0)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		__m256 t = _mm256_sub_ps(one, Saturate8(Dot8(v, h)));
+		__m256 t5 = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), _mm256_mul_ps(t, t)), t);
+		return {
+			_mm256_fmadd_ps(_mm256_sub_ps(one, f0.x), t5, f0.x),
+			_mm256_fmadd_ps(_mm256_sub_ps(one, f0.y), t5, f0.y),
+			_mm256_fmadd_ps(_mm256_sub_ps(one, f0.z), t5, f0.z) };
+	}
+
+	// Both of G_SchlickGGX()'s uses, for the view and the
+	// light, with one divide between them
+	AVX2_FUNCTION static inline __m256 G_SchlickGGX8(const Float3x8& n, const Float3x8& v, const Float3x8& l, __m256 roughness)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		__m256 k = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(roughness, one), _mm256_add_ps(roughness, one)), _mm256_set1_ps(1.0f / 8.0f));
+		__m256 oneMinusK = _mm256_sub_ps(one, k);
+		__m256 Gv = _mm256_fmadd_ps(Saturate8(Dot8(n, v)), oneMinusK, k);
+		__m256 Gl = _mm256_fmadd_ps(Saturate8(Dot8(n, l)), oneMinusK, k);
+		return _mm256_div_ps(one, _mm256_mul_ps(Gv, Gl));
+	}
+
+	AVX2_FUNCTION static inline Float3x8 MicrofacetBRDF8(const Float3x8& n, const Float3x8& l, const Float3x8& v, __m256 roughness, const Float3x8& f0, Float3x8& F)
+	{
+		Float3x8 h = Normalize8(Add8(v, l));
+		__m256 D = D_GGX8(n, h, roughness);
+		F = F_Schlick8(v, h, f0);
+		__m256 G = G_SchlickGGX8(n, v, l, roughness);
+
+		__m256 scale = _mm256_mul_ps(_mm256_mul_ps(D, G), _mm256_set1_ps(0.25f));
+		scale = _mm256_mul_ps(scale, _mm256_max_ps(Dot8(n, l), _mm256_setzero_ps()));
+		return Scale8(F, scale);
+	}
+
+	AVX2_FUNCTION static inline Float3x8 LightAmount8(const Light& light, const Float3x8& camera, const Float3x8& direction, const Float3x8& normal, const Float3x8& surfaceColor, const Float3x8& specularColor, __m256 metalness, __m256 roughness)
+	{
+		Float3x8 F;
+		__m256 diffuse = Saturate8(Dot8(normal, direction));
+		Float3x8 specular = MicrofacetBRDF8(normal, direction, camera, roughness, specularColor, F);
+
+		const __m256 one = _mm256_set1_ps(1.0f);
+		__m256 diffuseScale = _mm256_mul_ps(diffuse, _mm256_sub_ps(one, metalness));
+		Float3x8 balancedDiff = Scale8(Sub8(Broadcast8({ 1, 1, 1 }), F), diffuseScale);
+
+		float3 color = light.Color * light.Intensity;
+		return Mul8(Add8(Mul8(balancedDiff, surfaceColor), specular), Broadcast8(color));
+	}
+
+	AVX2_FUNCTION static inline __m256 Attenuation8(const Light& light, const Float3x8& position)
+	{
+		Float3x8 offset = Sub8(Broadcast8(light.Position), position);
+		__m256 att = Saturate8(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_div_ps(Dot8(offset, offset), _mm256_set1_ps(light.Range * light.Range))));
+		return _mm256_mul_ps(att, att);
+	}
+
+	AVX2_FUNCTION static inline __m256 Falloff8(const Light& light, const Float3x8& position)
+	{
+		Float3x8 toLight = Normalize8(Sub8(Broadcast8(light.Position), position));
+		__m256 pixelAngle = Saturate8(Dot8(toLight, Broadcast8(-light.Direction)));
+
+		float cosOuter = cosf(light.SpotOuterAngle);
+		float cosInner = cosf(light.SpotInnerAngle);
+		return Saturate8(_mm256_div_ps(_mm256_sub_ps(_mm256_set1_ps(cosOuter), pixelAngle), _mm256_set1_ps(cosOuter - cosInner)));
+	}
+
+	AVX2_FUNCTION static inline Float3x8 SkyIrradiance8(const Frame& frame, const Float3x8& n)
+	{
+		__m256 basis[9] =
+		{
+			_mm256_set1_ps(0.282095f),
+			_mm256_mul_ps(_mm256_set1_ps(0.488603f), n.y),
+			_mm256_mul_ps(_mm256_set1_ps(0.488603f), n.z),
+			_mm256_mul_ps(_mm256_set1_ps(0.488603f), n.x),
+			_mm256_mul_ps(_mm256_set1_ps(1.092548f), _mm256_mul_ps(n.x, n.y)),
+			_mm256_mul_ps(_mm256_set1_ps(1.092548f), _mm256_mul_ps(n.y, n.z)),
+			_mm256_mul_ps(_mm256_set1_ps(0.315392f), _mm256_fmsub_ps(_mm256_set1_ps(3.0f), _mm256_mul_ps(n.z, n.z), _mm256_set1_ps(1.0f))),
+			_mm256_mul_ps(_mm256_set1_ps(1.092548f), _mm256_mul_ps(n.x, n.z)),
+			_mm256_mul_ps(_mm256_set1_ps(0.546274f), _mm256_fmsub_ps(n.x, n.x, _mm256_mul_ps(n.y, n.y))),
+		};
+
+		Float3x8 result = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+		for (int i = 0; i < 9; i++)
+			result = Add8(result, Scale8(Broadcast8(frame.Irradiance[i]), basis[i]));
+
+		__m256 zero = _mm256_setzero_ps();
+		return { _mm256_max_ps(result.x, zero), _mm256_max_ps(result.y, zero), _mm256_max_ps(result.z, zero) };
+	}
+
+	AVX2_FUNCTION static void ShadeBatchAvx2(const Frame& frame, const SurfaceBatch& batch, float3 colors[8])
+	{
+		Float3x8 position = Load8(batch.PositionX, batch.PositionY, batch.PositionZ);
+		Float3x8 normal = Load8(batch.NormalX, batch.NormalY, batch.NormalZ);
+		Float3x8 albedo = Load8(batch.AlbedoX, batch.AlbedoY, batch.AlbedoZ);
+		Float3x8 tint = Load8(batch.TintX, batch.TintY, batch.TintZ);
+		__m256 metalness = _mm256_loadu_ps(batch.Metalness);
+		__m256 roughness = _mm256_loadu_ps(batch.Roughness);
+		__m256 shadowAmount = _mm256_loadu_ps(batch.ShadowAmount);
+
+		Float3x8 albedoColor = { Pow8(albedo.x, 2.2f), Pow8(albedo.y, 2.2f), Pow8(albedo.z, 2.2f) };
+		Float3x8 nonMetal = Broadcast8({ F0_NON_METAL, F0_NON_METAL, F0_NON_METAL });
+		Float3x8 specularColor = Add8(nonMetal, Scale8(Sub8(albedoColor, nonMetal), metalness));
+		Float3x8 surfaceColor = Mul8(tint, albedoColor);
+		Float3x8 camera = Broadcast8(frame.CameraPosition);
+
+		// Every lane sees the same light, so there's no
+		// divergence in switching on its type
+		Float3x8 total = Mul8(Broadcast8(frame.Ambient), SkyIrradiance8(frame, normal));
+		for (size_t i = 0; i < frame.Lights.size(); i++)
+		{
+			const Light& light = frame.Lights[i];
+			__m256 shadow = light.ShadowTile >= 0 ? shadowAmount : _mm256_set1_ps(1.0f);
+			switch (light.Type)
+			{
+			case LIGHT_TYPE_DIRECTION:
+				total = Add8(total, Scale8(LightAmount8(light, camera, Broadcast8(normalize(light.Direction)), normal, surfaceColor, specularColor, metalness, roughness), shadow));
+				break;
+
+			case LIGHT_TYPE_POINT:
+			{
+				Float3x8 direction = Normalize8(Sub8(position, Broadcast8(light.Position)));
+				Float3x8 amount = LightAmount8(light, camera, direction, normal, surfaceColor, specularColor, metalness, roughness);
+				total = Add8(total, Scale8(amount, _mm256_mul_ps(Attenuation8(light, position), shadow)));
+				break;
+			}
+
+			case LIGHT_TYPE_SPOT:
+			{
+				Float3x8 amount = LightAmount8(light, camera, Broadcast8(normalize(light.Direction)), normal, surfaceColor, specularColor, metalness, roughness);
+				total = Add8(total, Scale8(amount, _mm256_mul_ps(_mm256_mul_ps(Attenuation8(light, position), Falloff8(light, position)), shadow)));
+				break;
+			}
+			}
+		}
+		total = Mul8(total, surfaceColor);
+
+		alignas(32) float r[8], g[8], b[8];
+		_mm256_store_ps(r, Pow8(total.x, 1.0f / 2.2f));
+		_mm256_store_ps(g, Pow8(total.y, 1.0f / 2.2f));
+		_mm256_store_ps(b, Pow8(total.z, 1.0f / 2.2f));
+		for (int i = 0; i < 8; i++)
+			colors[i] = { r[i], g[i], b[i] };
+	}
+
+	void ShadeBatch(const Frame& frame, const SurfaceBatch& batch, float3 colors[8], bool allowAvx2)
+	{
+		if (allowAvx2 && HasAvx2())
+		{
+			ShadeBatchAvx2(frame, batch, colors);
+			return;
+		}
+
+		for (int i = 0; i < 8; i++)
+		{
+			Surface surface;
+			surface.WorldPosition = { batch.PositionX[i], batch.PositionY[i], batch.PositionZ[i] };
+			surface.Normal = { batch.NormalX[i], batch.NormalY[i], batch.NormalZ[i] };
+			surface.Albedo = { batch.AlbedoX[i], batch.AlbedoY[i], batch.AlbedoZ[i] };
+			surface.ColorTint = { batch.TintX[i], batch.TintY[i], batch.TintZ[i] };
+			surface.Metalness = batch.Metalness[i];
+			surface.Roughness = batch.Roughness[i];
+			surface.ShadowAmount = batch.ShadowAmount[i];
+			colors[i] = Shade(frame, surface);
+		}
+	}
+
+	AVX2_FUNCTION static void EvaluateBrdfAvx2(const BrdfBatch& batch, BrdfTerms& terms)
+	{
+		Float3x8 n = Load8(batch.NormalX, batch.NormalY, batch.NormalZ);
+		Float3x8 l = Load8(batch.LightX, batch.LightY, batch.LightZ);
+		Float3x8 v = Load8(batch.ViewX, batch.ViewY, batch.ViewZ);
+		Float3x8 f0 = Load8(batch.F0X, batch.F0Y, batch.F0Z);
+		__m256 roughness = _mm256_loadu_ps(batch.Roughness);
+
+		Float3x8 h = Normalize8(Add8(v, l));
+		_mm256_storeu_ps(terms.D, D_GGX8(n, h, roughness));
+		_mm256_storeu_ps(terms.G, G_SchlickGGX8(n, v, l, roughness));
+
+		Float3x8 F;
+		Float3x8 specular = MicrofacetBRDF8(n, l, v, roughness, f0, F);
+		_mm256_storeu_ps(terms.FX, F.x);
+		_mm256_storeu_ps(terms.FY, F.y);
+		_mm256_storeu_ps(terms.FZ, F.z);
+		_mm256_storeu_ps(terms.SpecularX, specular.x);
+		_mm256_storeu_ps(terms.SpecularY, specular.y);
+		_mm256_storeu_ps(terms.SpecularZ, specular.z);
+	}
+
+	void EvaluateBrdf(const BrdfBatch& batch, BrdfTerms& terms, bool allowAvx2)
+	{
+		if (allowAvx2 && HasAvx2())
+		{
+			EvaluateBrdfAvx2(batch, terms);
+			return;
+		}
+
+		for (int i = 0; i < 8; i++)
+		{
+			float3 n = { batch.NormalX[i], batch.NormalY[i], batch.NormalZ[i] };
+			float3 l = { batch.LightX[i], batch.LightY[i], batch.LightZ[i] };
+			float3 v = { batch.ViewX[i], batch.ViewY[i], batch.ViewZ[i] };
+			float3 f0 = { batch.F0X[i], batch.F0Y[i], batch.F0Z[i] };
+			float roughness = batch.Roughness[i];
+
+			float3 h = normalize(v + l);
+			terms.D[i] = D_GGX(n, h, roughness);
+			terms.G[i] = G_SchlickGGX(n, v, roughness) * G_SchlickGGX(n, l, roughness);
+
+			float3 F;
+			float3 specular = MicrofacetBRDF(n, l, v, roughness, f0, F);
+			terms.FX[i] = F.x;
+			terms.FY[i] = F.y;
+			terms.FZ[i] = F.z;
+			terms.SpecularX[i] = specular.x;
+			terms.SpecularY[i] = specular.y;
+			terms.SpecularZ[i] = specular.z;
+		}
+	}
+
+	// --------------------------------------------------------
+	// Transposes up to 8 surfaces into a batch.  Missing lanes
+	// repeat the last surface so they do harmless work.
+	// --------------------------------------------------------
+	static void FillBatch(SurfaceBatch& batch, const Surface* surfaces, unsigned int count)
+	{
+		for (unsigned int i = 0; i < 8; i++)
+		{
+			const Surface& s = surfaces[i < count ? i : count - 1];
+			batch.PositionX[i] = s.WorldPosition.x;
+			batch.PositionY[i] = s.WorldPosition.y;
+			batch.PositionZ[i] = s.WorldPosition.z;
+			batch.NormalX[i] = s.Normal.x;
+			batch.NormalY[i] = s.Normal.y;
+			batch.NormalZ[i] = s.Normal.z;
+			batch.AlbedoX[i] = s.Albedo.x;
+			batch.AlbedoY[i] = s.Albedo.y;
+			batch.AlbedoZ[i] = s.Albedo.z;
+			batch.TintX[i] = s.ColorTint.x;
+			batch.TintY[i] = s.ColorTint.y;
+			batch.TintZ[i] = s.ColorTint.z;
+			batch.Metalness[i] = s.Metalness;
+			batch.Roughness[i] = s.Roughness;
+			batch.ShadowAmount[i] = s.ShadowAmount;
+		}
+	}
+
+	void ShadeImage(
+		const Frame& frame,
+		const std::vector<Surface>& surfaces,
+		unsigned int width,
+		unsigned int height,
+		std::vector<float3>& colors,
+		unsigned int threadCount,
+		bool allowAvx2)
+	{
+		const unsigned int tileSize = 32;
+		colors.resize((size_t)width * height);
+		if (surfaces.size() < colors.size())
+			return;
+
+		unsigned int tilesX = (width + tileSize - 1) / tileSize;
+		unsigned int tileCount = tilesX * ((height + tileSize - 1) / tileSize);
+
+		// Threads take the next tile until there are none left
+		std::atomic<unsigned int> nextTile(0);
+		auto work = [&]()
+		{
+			SurfaceBatch batch;
+			float3 batchColors[8];
+			for (unsigned int tile = nextTile++; tile < tileCount; tile = nextTile++)
+			{
+				unsigned int startX = tile % tilesX * tileSize;
+				unsigned int startY = tile / tilesX * tileSize;
+				unsigned int endX = startX + tileSize < width ? startX + tileSize : width;
+				unsigned int endY = startY + tileSize < height ? startY + tileSize : height;
+
+				for (unsigned int y = startY; y < endY; y++)
+				{
+					for (unsigned int x = startX; x < endX; x += 8)
+					{
+						size_t first = (size_t)y * width + x;
+						unsigned int count = endX - x < 8 ? endX - x : 8;
+						FillBatch(batch, &surfaces[first], count);
+						ShadeBatch(frame, batch, batchColors, allowAvx2);
+						for (unsigned int i = 0; i < count; i++)
+							colors[first + i] = batchColors[i];
+					}
+				}
+			}
+		};
+
+		if (threadCount == 0)
+			threadCount = std::thread::hardware_concurrency();
+		if (threadCount > tileCount)
+			threadCount = tileCount;
+
+		// This thread does its share too
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < threadCount; i++)
+			threads.emplace_back(work);
+		work();
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// A CPU copy of the lighting in PixelShader.hlsl, with
+// nothing D3D specific so it runs anywhere.  Every function
+// mirrors the shader's function of the same name, quirks
+// included (the camera position standing in for the view
+// vector), so shader output can be checked against it without a GPU.
+//
+// Shading starts after the texture reads: a Surface holds
+// what main() has sampled and unpacked for one pixel.  The
+// SPECULAR_IBL reflections are left out, being texture reads
+// themselves (EnvironmentPrefilter.h has their CPU side), and
+// so is BAKED_OCCLUSION, which is the same as a wide open
+// vertex (occlusion 1, bent normal along the normal).
+//
+// ShadeBatch() and ShadeImage() shade 8 pixels at a time
+// with AVX2 when the CPU has it, and fall back to the
+// scalar functions when it doesn't.
+// --------------------------------------------------------
+namespace PbrReference
+{
+	struct float3
+	{
+		float x, y, z;
+	};
+
+	// Same layout as Light in Lights.h and the shaders
+	struct Light
+	{
+		int Type;
+		float3 Direction;
+		float Range;
+		float3 Position;
+		float Intensity;
+		float3 Color;
+		float SpotInnerAngle;
+		float SpotOuterAngle;
+		int ShadowTile;
+		float Padding;
+	};
+
+	// The parts of PerFrame the lighting reads
+	struct Frame
+	{
+		float3 CameraPosition;
+		float3 Ambient;
+		std::vector<Light> Lights;
+
+		// PerFrame's irradianceSH; flat white (ambient as is) by default
+		float3 Irradiance[9] = { { 3.5449077f, 3.5449077f, 3.5449077f } };
+	};
+
+	// One pixel, as main() has it just before lighting
+	struct Surface
+	{
+		float3 WorldPosition;
+		float3 Normal;			// After normal mapping
+		float3 Albedo;			// As sampled, before the 2.2 power
+		float3 ColorTint;
+		float Metalness;
+		float Roughness;
+		float ShadowAmount;		// What every shadowed light's tiles give, 1 is fully lit
+	};
+
+	// 8 surfaces, structure of arrays
+	struct SurfaceBatch
+	{
+		float PositionX[8], PositionY[8], PositionZ[8];
+		float NormalX[8], NormalY[8], NormalZ[8];
+		float AlbedoX[8], AlbedoY[8], AlbedoZ[8];
+		float TintX[8], TintY[8], TintZ[8];
+		float Metalness[8];
+		float Roughness[8];
+		float ShadowAmount[8];
+	};
+
+	// The shader's functions, one pixel at a time
+	float DiffusePBR(float3 normal, float3 dirToLight);
+	float3 DiffuseEnergyConserve(float diffuse, float3 F, float metalness);
+	float D_GGX(float3 n, float3 h, float roughness);
+	float3 F_Schlick(float3 v, float3 h, float3 f0);
+	float G_SchlickGGX(float3 n, float3 v, float roughness);
+	float3 MicrofacetBRDF(float3 n, float3 l, float3 v, float roughness, float3 f0, float3& F_out);
+	float CalculateFalloff(const Light& light, float3 worldPosition);
+	float CalculateAttenuation(const Light& light, float3 worldPosition);
+	float3 DirectionalLight(const Light& light, const Frame& frame, float3 normal, float3 surfaceColor, float3 specularColor, float metalness, float roughness);
+	float3 PointLight(const Light& light, const Frame& frame, float3 worldPosition, float3 normal, float3 surfaceColor, float3 specularColor, float metalness, float roughness);
+	float3 SpotLight(const Light& light, const Frame& frame, float3 worldPosition, float3 normal, float3 surfaceColor, float3 specularColor, float metalness, float roughness);
+	float3 SkyIrradiance(const Frame& frame, float3 n);
+	float3 CalculateLightingTotal(const Frame& frame, const Surface& surface, float3 surfaceColor, float3 specularColor);
+
+	// Everything main() does after sampling, gamma included
+	float3 Shade(const Frame& frame, const Surface& surface);
+
+	// Whether ShadeBatch() can use AVX2 on this CPU
+	bool HasAvx2();
+
+	// Shades 8 surfaces at once into colors[0..7]
+	void ShadeBatch(const Frame& frame, const SurfaceBatch& batch, float3 colors[8], bool allowAvx2 = true);
+
+	// 8 sets of MicrofacetBRDF()'s inputs, structure of arrays
+	struct BrdfBatch
+	{
+		float NormalX[8], NormalY[8], NormalZ[8];
+		float LightX[8], LightY[8], LightZ[8];		// Toward the light
+		float ViewX[8], ViewY[8], ViewZ[8];			// As the shader passes it
+		float Roughness[8];
+		float F0X[8], F0Y[8], F0Z[8];
+	};
+
+	// MicrofacetBRDF()'s pieces for each lane: D and F at the
+	// half vector, G for the view and the light together
+	struct BrdfTerms
+	{
+		float D[8];
+		float G[8];
+		float FX[8], FY[8], FZ[8];
+		float SpecularX[8], SpecularY[8], SpecularZ[8];
+	};
+
+	// Works out the BRDF the way ShadeBatch() does, with AVX2
+	// if allowed and available and the scalar functions if
+	// not, so each term can be checked on both paths
+	void EvaluateBrdf(const BrdfBatch& batch, BrdfTerms& terms, bool allowAvx2 = true);
+
+	// --------------------------------------------------------
+	// Shades a whole image of surfaces (row major) in 32x32
+	// tiles, spread over threadCount threads (0 for one per
+	// core).  colors is resized to match.
+	// --------------------------------------------------------
+	void ShadeImage(
+		const Frame& frame,
+		const std::vector<Surface>& surfaces,
+		unsigned int width,
+		unsigned int height,
+		std::vector<float3>& colors,
+		unsigned int threadCount = 0,
+		bool allowAvx2 = true);
+}
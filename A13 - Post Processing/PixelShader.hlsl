@@ -1,15 +1,91 @@
 
 #include "GGPShadersInclude.hlsli"
 
+// Permutation defines, set when a variant is compiled at run
+// time (see ShaderPermutation.h).  The offline build sets none
+// of them, which gives a shader that handles any mix of up to
+// 5 lights and every feature.
+// - DIRECTIONAL_LIGHTS, POINT_LIGHTS, SPOT_LIGHTS: how many of
+//   each, sorted in that order in the lights array
+// - NORMAL_MAP, METALNESS_MAP: sample those textures or not
+// - SHADOWS: sample each light's tiles of the shadow atlas or
+//   treat everything as lit
+// - CLUSTERED_LIGHTS: ignore the counts and the cbuffer's
+//   lights, and read any number of them from the buffers the
+//   CPU binned for this pixel's cluster (see ClusteredLights.h)
+// - SPECULAR_IBL: add reflections of the sky from the
+//   prefiltered cubemap and BRDF LUT Sky bakes
+// - BAKED_OCCLUSION: darken ambient and reflections by the
+//   mesh's baked vertex occlusion, and light ambient from the
+//   bent normal
+#ifndef NORMAL_MAP
+#define NORMAL_MAP 1
+#endif
+#ifndef METALNESS_MAP
+#define METALNESS_MAP 1
+#endif
+#ifndef SHADOWS
+#define SHADOWS 1
+#endif
+#ifndef CLUSTERED_LIGHTS
+#define CLUSTERED_LIGHTS 0
+#endif
+#ifndef SPECULAR_IBL
+#define SPECULAR_IBL 0
+#endif
+#ifndef BAKED_OCCLUSION
+#define BAKED_OCCLUSION 1
+#endif
+
 // Texture and Sampler Registers
 Texture2D Albedo : register(t0);		// Registers for the Textures
 Texture2D NormalMap : register(t1);		
 Texture2D RoughnessMap : register(t2);
 Texture2D MetalnessMap : register(t3);
-Texture2D ShadowMap : register(t4);     // Shadow Map Texture
+Texture2D ShadowMap : register(t4);     // Shadow atlas, every shadowed light's tiles in it
 SamplerState Sampler : register(s0);		// Registers for Samplers
 SamplerComparisonState ShadowSampler : register(s1); // Shadow Map Sampler
 
+#if CLUSTERED_LIGHTS
+// Every light (directional ones first), the index list, and
+// each cluster's offset and count in it
+StructuredBuffer<Light> Lights : register(t5);
+StructuredBuffer<uint> LightIndices : register(t6);
+StructuredBuffer<uint2> ClusterRanges : register(t7);
+
+// How pixels map to clusters
+// - Tiles: screen position * tileScale
+// - Slices: log(view depth) * sliceScale + sliceBias
+cbuffer ClusterInfo : register(b3)
+{
+    uint3 clusterCounts;
+    uint directionalLights;
+    float2 tileScale;
+    float sliceScale;
+    float sliceBias;
+};
+#endif
+
+#if SPECULAR_IBL
+// The sky prefiltered by roughness, and the split sum's LUT
+// (N dot V across, roughness down), both sampled clamped
+TextureCube SpecularEnvironment : register(t8);
+Texture2D BrdfLut : register(t9);
+SamplerState EnvironmentSampler : register(s2);
+#endif
+
+#if SHADOWS
+// Where each light's tiles are in the shadow atlas (see
+// ShadowAtlas.h).  The first directional light's cascades are
+// the first SHADOW_CASCADES tiles, a point light has one for
+// each cube face (+X, -X, +Y, -Y, +Z, -Z), and others one.
+cbuffer ShadowAtlas : register(b4)
+{
+    matrix shadowTileMatrices[MAX_SHADOW_TILES]; // World to atlas UV (xy) and depth (z), once divided by w
+    float4 shadowTileBounds[MAX_SHADOW_TILES]; // UV range each tile's samples are kept in, min (xy) and max (zw)
+};
+#endif
+
 //Constants
 // A constant Fresnel value for non-metals (glass and plastic have values of about 0.04)
 static const float F0_NON_METAL = 0.04f;
@@ -19,15 +95,13 @@ static const float MIN_ROUGHNESS = 0.0000001f; // 6 zeros after decimal
 static const float PI = 3.14159265359f;
 
 // New constant buffer data for use with SimpleShaders
-cbuffer ExternalData : register(b0)
+// - Camera and lights come from PerFrame in the include
+cbuffer PerMaterial : register(b1)
 {
 	float4 colorTint		: COLOR;
 	float2 scale			: TEXCOORD;
 	float2 offset			: TEXCOOD;
-	float3 cameraPosition	: POSITION;
 	float roughness			: SCALAR;
-    float3 ambient          : COLOR;
-	Light lights[5]			: LIGHT;
 };
 
 // Lambert diffuse BRDF - Same as the basic lighting diffuse calculation!
@@ -158,11 +232,11 @@ float3 CalculateDiffuse(Light light, VertexToPixel input, float3 direction)
 // Calculates the Specularity of the pixel
 float3 CalculateSpecular(Light light, VertexToPixel input, float3 direction)
 {
-    float3 view = normalize(cameraPosition - input.worldPosition);
+    float3 toCamera = normalize(cameraPosition - input.worldPosition);
     float3 reflection = reflect(direction, input.normal);
     float specExponent = (1.0f - roughness) * MAX_SPECULAR_EXPONENT;
 	
-    return pow(max(dot(reflection, view), 0.0f), specExponent);
+    return pow(max(dot(reflection, toCamera), 0.0f), specExponent);
 }
 
 // Calculates the linear falloff of a Spot Light
@@ -188,93 +262,230 @@ float3 CalculateAttenuation(Light light, VertexToPixel input)
     return att * att;
 }
 
+// Light from one directional light
+float3 DirectionalLight(Light light, VertexToPixel input, float4 surfaceColor, float3 specularColor, float metalness, float roughness)
+{
+    float3 F;
+    float3 direction = normalize(light.Direction);
+			
+    // Calculate the light amounts
+    float3 diffuse = DiffusePBR(input.normal, direction);
+    float3 specular = MicrofacetBRDF(input.normal, direction, cameraPosition, roughness, specularColor, F);
+                
+    // Calculate diffuse with energy conservation, including cutting diffuse for metals
+    float3 balancedDiff = DiffuseEnergyConserve(diffuse, F, metalness);
+                
+    // Combine the final diffuse and specular values for this light
+    return (balancedDiff * surfaceColor.rgb + specular) * light.Intensity * light.Color;
+}
+
+// Light from one point light
+float3 PointLight(Light light, VertexToPixel input, float4 surfaceColor, float3 specularColor, float metalness, float roughness)
+{
+    float3 F;
+    float3 direction = normalize(input.worldPosition - light.Position);
+			
+    // Calculate the light amounts
+    float3 diffuse = DiffusePBR(input.normal, direction);
+    float3 specular = MicrofacetBRDF(input.normal, direction, cameraPosition, roughness, specularColor, F);
+                
+    // Calculate diffuse with energy conservation, including cutting diffuse for metals
+    float3 balancedDiff = DiffuseEnergyConserve(diffuse, F, metalness);
+    float3 attenuation = CalculateAttenuation(light, input);
+                
+    // Combine the final diffuse and specular values for this light
+    return (balancedDiff * surfaceColor.rgb + specular) * light.Intensity * light.Color * attenuation;
+}
+
+// Light from one spot light
+float3 SpotLight(Light light, VertexToPixel input, float4 surfaceColor, float3 specularColor, float metalness, float roughness)
+{
+    float3 F;
+    float3 direction = normalize(light.Direction);
+            
+    // Calculate the light amounts
+    float3 diffuse = DiffusePBR(input.normal, direction);
+    float3 specular = MicrofacetBRDF(input.normal, direction, cameraPosition, roughness, specularColor, F);
+                
+    // Calculate diffuse with energy conservation, including cutting diffuse for metals
+    float3 balancedDiff = DiffuseEnergyConserve(diffuse, F, metalness);
+    float3 attenuation = CalculateAttenuation(light, input);
+    float fallOff = CalculateFalloff(light, input);
+                
+    // Combine the final diffuse and specular values for this light
+    return ((balancedDiff * surfaceColor.rgb + specular) * light.Intensity * light.Color * attenuation) * fallOff;
+}
+
+// Light from the sky reaching a surface facing along n, from
+// the nine spherical harmonic coefficients baked by Sky.  A
+// flat environment comes back as 1, so ambient keeps its meaning.
+float3 SkyIrradiance(float3 n)
+{
+    float3 result =
+        irradianceSH[0].rgb * 0.282095f +
+        irradianceSH[1].rgb * 0.488603f * n.y +
+        irradianceSH[2].rgb * 0.488603f * n.z +
+        irradianceSH[3].rgb * 0.488603f * n.x +
+        irradianceSH[4].rgb * 1.092548f * n.x * n.y +
+        irradianceSH[5].rgb * 1.092548f * n.y * n.z +
+        irradianceSH[6].rgb * 0.315392f * (3.0f * n.z * n.z - 1.0f) +
+        irradianceSH[7].rgb * 1.092548f * n.x * n.z +
+        irradianceSH[8].rgb * 0.546274f * (n.x * n.x - n.y * n.y);
+    return max(result, 0.0f);
+}
+
+#if SHADOWS
+// --------------------------------------------------------
+// How lit a point is by one tile of the atlas.  Orthographic
+// tiles have a w of 1, so the divide is only for spot and
+// point lights' perspective ones.
+// --------------------------------------------------------
+float SampleShadowTile(uint tile, float3 worldPosition)
+{
+    float4 position = mul(shadowTileMatrices[tile], float4(worldPosition, 1.0f));
+    position.xyz /= position.w;
+
+    // Stay inside the tile, so filtering can't reach the next one
+    float4 bounds = shadowTileBounds[tile];
+    float2 uv = clamp(position.xy, bounds.xy, bounds.zw);
+    return ShadowMap.SampleCmpLevelZero(ShadowSampler, uv, position.z);
+}
+
+// --------------------------------------------------------
+// Picks the cascade by view depth.  Over the band at the end
+// of each one it fades into the next, which was fitted to
+// cover that band too, and past the last it fades to lit.
+// --------------------------------------------------------
+float CascadedShadow(float3 worldPosition)
+{
+    float depth = mul(view, float4(worldPosition, 1.0f)).z;
+    if (depth >= cascadeSplits[SHADOW_CASCADES - 1])
+        return 1.0f;
+
+    uint cascade = 0;
+    [unroll]
+    for (uint i = 0; i < SHADOW_CASCADES - 1; i++)
+        cascade += depth >= cascadeSplits[i];
+
+    float shadow = SampleShadowTile(cascade, worldPosition);
+    float band = cascadeSplits[cascade] * cascadeBlend;
+    float fade = saturate((depth - cascadeSplits[cascade] + band) / max(band, 0.0001f));
+
+    [branch]
+    if (fade > 0.0f)
+    {
+        float next = SampleShadowTile(min(cascade + 1, SHADOW_CASCADES - 1), worldPosition);
+        shadow = lerp(shadow, cascade + 1 < SHADOW_CASCADES ? next : 1.0f, fade);
+    }
+    return shadow;
+}
+
+// --------------------------------------------------------
+// How lit a point is by one light, from whichever of its
+// tiles it falls in
+// --------------------------------------------------------
+float LightShadow(Light light, float3 worldPosition)
+{
+    if (light.ShadowTile < 0)
+        return 1.0f;
+
+    if (light.Type == LIGHT_TYPE_DIRECTION && light.ShadowTile == 0)
+        return CascadedShadow(worldPosition);
+
+    // Point lights pick a face by the largest axis, the same
+    // way PointShadowFace() does on the CPU
+    uint tile = light.ShadowTile;
+    if (light.Type == LIGHT_TYPE_POINT)
+    {
+        float3 toPoint = worldPosition - light.Position;
+        float3 size = abs(toPoint);
+        if (size.x >= size.y && size.x >= size.z)
+            tile += toPoint.x < 0 ? 1 : 0;
+        else if (size.y >= size.z)
+            tile += toPoint.y < 0 ? 3 : 2;
+        else
+            tile += toPoint.z < 0 ? 5 : 4;
+    }
+    return SampleShadowTile(tile, worldPosition);
+}
+#else
+float LightShadow(Light light, float3 worldPosition)
+{
+    return 1.0f; // Fully lit
+}
+#endif
+
 // Calculates the total light hitting the pixel
-float3 CalculateLightingTotal(VertexToPixel input, float4 surfaceColor, float3 specularColor, float metalness, float roughness, float shadowAmount)
+float3 CalculateLightingTotal(VertexToPixel input, float4 surfaceColor, float3 specularColor, float metalness, float roughness)
 {
-    float3 total = ambient;
-		
+#if BAKED_OCCLUSION
+    // main() has bent the bent normal along with any normal mapping
+    float3 total = ambient * SkyIrradiance(input.occlusion.xyz) * input.occlusion.w;
+#else
+    float3 total = ambient * SkyIrradiance(input.normal);
+#endif
+
+#if CLUSTERED_LIGHTS
+    // Directional lights reach every pixel
+    for (uint d = 0; d < directionalLights; d++)
+        total += DirectionalLight(Lights[d], input, surfaceColor, specularColor, metalness, roughness) * LightShadow(Lights[d], input.worldPosition);
+
+    // Everything else only if it was binned into this cluster
+    float viewDepth = max(mul(view, float4(input.worldPosition, 1.0f)).z, 0.0001f);
+    uint2 tile = min((uint2)(input.screenPosition.xy * tileScale), clusterCounts.xy - 1);
+    uint slice = (uint)clamp(log(viewDepth) * sliceScale + sliceBias, 0, clusterCounts.z - 1);
+    uint2 range = ClusterRanges[tile.x + tile.y * clusterCounts.x + slice * clusterCounts.x * clusterCounts.y];
+
+    for (uint i = 0; i < range.y; i++)
+    {
+        Light light = Lights[LightIndices[range.x + i]];
+        float shadow = LightShadow(light, input.worldPosition);
+        if (light.Type == LIGHT_TYPE_SPOT)
+            total += SpotLight(light, input, surfaceColor, specularColor, metalness, roughness) * shadow;
+        else
+            total += PointLight(light, input, surfaceColor, specularColor, metalness, roughness) * shadow;
+    }
+#elif defined(DIRECTIONAL_LIGHTS)
+    // Specialized variant: the lights are sorted by type and
+    // every count is known, so each loop unrolls completely
+    // and there's no branching on light type
+    [unroll]
+    for (int d = 0; d < DIRECTIONAL_LIGHTS; d++)
+        total += DirectionalLight(lights[d], input, surfaceColor, specularColor, metalness, roughness) * LightShadow(lights[d], input.worldPosition);
+
+    [unroll]
+    for (int p = 0; p < POINT_LIGHTS; p++)
+    {
+        Light light = lights[DIRECTIONAL_LIGHTS + p];
+        total += PointLight(light, input, surfaceColor, specularColor, metalness, roughness) * LightShadow(light, input.worldPosition);
+    }
+
+    [unroll]
+    for (int s = 0; s < SPOT_LIGHTS; s++)
+    {
+        Light light = lights[DIRECTIONAL_LIGHTS + POINT_LIGHTS + s];
+        total += SpotLight(light, input, surfaceColor, specularColor, metalness, roughness) * LightShadow(light, input.worldPosition);
+    }
+#else
     for (int i = 0; i < 5; i++)
     {
-        float3 diffuse = { 0, 0, 0 };
-        float3 specular = { 0, 0, 0 };
-        float3 attenuation = { 0, 0, 0 };
-        float3 result = { 0, 0, 0 };
-        float fallOff = 0;
-        float3 F;
-        float3 direction;
-        float3 balancedDiff;
-			
+        float shadow = LightShadow(lights[i], input.worldPosition);
         switch (lights[i].Type)
         {
-			// Directional Light
             case LIGHT_TYPE_DIRECTION:
-            
-                direction = normalize(lights[i].Direction);
-			
-                // Calculate the light amounts
-                diffuse = DiffusePBR(input.normal, direction);
-                specular = MicrofacetBRDF(input.normal, direction, cameraPosition, roughness, specularColor, F);
-                
-                // Calculate diffuse with energy conservation, including cutting diffuse for metals
-                balancedDiff = DiffuseEnergyConserve(diffuse, F, metalness);
-                
-                // Combine the final diffuse and specular values for this light
-                result = (balancedDiff * surfaceColor.rgb + specular) * lights[i].Intensity * lights[i].Color;
-            
-                if (i == 0)
-                {
-                    result += shadowAmount * 0.1; // Apply shadow amount to the first light
-                                                  // Not sure why shadowAmount does not work when multiplied
-                }
-            
-                total += result;
+                total += DirectionalLight(lights[i], input, surfaceColor, specularColor, metalness, roughness) * shadow;
                 break;
 			
-			// Point Light
             case LIGHT_TYPE_POINT:
-                direction = normalize(input.worldPosition - lights[i].Position);
-			
-                // Calculate the light amounts
-                diffuse = DiffusePBR(input.normal, direction);
-                specular = MicrofacetBRDF(input.normal, direction, cameraPosition, roughness, specularColor, F);
-                
-                // Calculate diffuse with energy conservation, including cutting diffuse for metals
-                balancedDiff = DiffuseEnergyConserve(diffuse, F, metalness);
-                attenuation = CalculateAttenuation(lights[i], input);
-                
-                // Combine the final diffuse and specular values for this light
-                result = (balancedDiff * surfaceColor.rgb + specular) * lights[i].Intensity * lights[i].Color * attenuation;
-                total += result;
+                total += PointLight(lights[i], input, surfaceColor, specularColor, metalness, roughness) * shadow;
                 break;
 			
-			// Spot Light
             case LIGHT_TYPE_SPOT:
-                
-                direction = normalize(lights[i].Direction);
-            
-                // Calculate the light amounts
-                diffuse = DiffusePBR(input.normal, direction);
-                specular = MicrofacetBRDF(input.normal, direction, cameraPosition, roughness, specularColor, F);
-                
-                // Calculate diffuse with energy conservation, including cutting diffuse for metals
-                balancedDiff = DiffuseEnergyConserve(diffuse, F, metalness);
-                attenuation = CalculateAttenuation(lights[i], input);
-                fallOff = CalculateFalloff(lights[i], input);
-                
-                // Combine the final diffuse and specular values for this light
-                result = ((balancedDiff * surfaceColor.rgb + specular) * lights[i].Intensity * lights[i].Color * attenuation) * fallOff;
-                total += result;
+                total += SpotLight(lights[i], input, surfaceColor, specularColor, metalness, roughness) * shadow;
                 break;
         }
-		
-		// Cut the specular if the diffuse contribution is zero
-		// - any() returns 1 if any component of the param is non-zero
-		// - In other words:
-		// - If the diffuse amount is 0, any(diffuse) returns 0
-		// - If the diffuse amount is != 0, any(diffuse) returns 1
-		// - So when diffuse is 0, specular becomes 0
-        specular *= any(diffuse);
     }
+#endif
 	
     return total * surfaceColor.rgb;
 }
@@ -299,37 +510,67 @@ float3 TransformNormal(VertexToPixel input, float3 unpackedNormal)
 //    "put the output of this into the current render target"
 // - Named "main" because that's the default the shader compiler looks for
 // --------------------------------------------------------
+#if SPECULAR_IBL
+// --------------------------------------------------------
+// Split sum reflections: the sky blurred for this roughness
+// (one roughness per mip) times the share of it the BRDF
+// reflects for this angle, as a scale and bias on F0
+// --------------------------------------------------------
+float3 SpecularIBL(float3 n, float3 v, float3 specularColor, float roughness)
+{
+    uint width, height, mips;
+    SpecularEnvironment.GetDimensions(0, width, height, mips);
+
+    float NdotV = saturate(dot(n, v));
+    float3 r = reflect(-v, n);
+    float3 prefiltered = SpecularEnvironment.SampleLevel(EnvironmentSampler, r, roughness * (mips - 1)).rgb;
+    float2 brdf = BrdfLut.SampleLevel(EnvironmentSampler, float2(NdotV, roughness), 0).rg;
+    return prefiltered * (specularColor * brdf.x + brdf.y);
+}
+#endif
+
+#if BAKED_OCCLUSION
+// --------------------------------------------------------
+// How much of the reflection survives ambient occlusion
+// (Lagarde's fit): smooth surfaces seen head on keep the
+// most, since their lobe points away from what's blocking
+// --------------------------------------------------------
+float SpecularOcclusion(float NdotV, float occlusion, float roughness)
+{
+    return saturate(pow(NdotV + occlusion, exp2(-16.0f * roughness - 1.0f)) - 1.0f + occlusion);
+}
+#endif
+
 float4 main(VertexToPixel input) : SV_TARGET
 {	
-    // Check Shadow Map
-	// Perform the perspective divide (divide by W) ourselves
-    input.shadowMapPosition /= input.shadowMapPosition.w;
-    
-    // Convert the normalized device coordinates to UVs for sampling
-    float2 shadowUV = input.shadowMapPosition.xy * 0.5f + 0.5f;
-    shadowUV.y = 1 - shadowUV.y; // Flip the Y
-    
-    // Grab the distances we need: light-to-pixel and closest-surface
-    float distToLight = input.shadowMapPosition.z;
-
-    // Get a ratio of comparison results using SampleCmpLevelZero()
-    float shadowAmount = ShadowMap.SampleCmpLevelZero(
-        ShadowSampler,
-        shadowUV,
-        distToLight);
-    
     // Get UV position of pixel
     input.uv = input.uv * scale + offset;
     
 	// Roughness and Metalness
     float roughness = RoughnessMap.Sample(Sampler, input.uv).r;
+#if METALNESS_MAP
     float metalness = MetalnessMap.Sample(Sampler, input.uv).r;
+#else
+    float metalness = 0.0f;
+#endif
 	
-	//input.normal = normalize(input.normal);	Older normal calculation
+#if BAKED_OCCLUSION
+    // How far the bake bent the normal, to bend the mapped one by
+    float3 bend = normalize(input.occlusion.xyz) - normalize(input.normal);
+#endif
+
+#if NORMAL_MAP
 	// Unpack Normal Map
     float3 unpackedNormal = NormalMap.Sample(Sampler, input.uv).rgb * 2 - 1;
     unpackedNormal = normalize(unpackedNormal);
     input.normal = TransformNormal(input, unpackedNormal);
+#else
+    input.normal = normalize(input.normal);
+#endif
+
+#if BAKED_OCCLUSION
+    input.occlusion.xyz = normalize(input.normal + bend);
+#endif
 	
 	// Calculate Albedo Color
     float3 albedoColor = pow(Albedo.Sample(Sampler, input.uv).rgb, 2.2f);
@@ -340,9 +581,19 @@ float4 main(VertexToPixel input) : SV_TARGET
     float4 surfaceColor = colorTint * float4(albedoColor, 1);
 	
 	// Old Fresnel calculation
-	float3 totalLight = CalculateLightingTotal(input, surfaceColor, specularColor, metalness, roughness, shadowAmount);
+	float3 totalLight = CalculateLightingTotal(input, surfaceColor, specularColor, metalness, roughness);
+
+#if SPECULAR_IBL
+    // After the total, which is tinted by the surface color
+    float3 toCamera = normalize(cameraPosition - input.worldPosition);
+    float3 reflection = SpecularIBL(input.normal, toCamera, specularColor, roughness);
+#if BAKED_OCCLUSION
+    reflection *= SpecularOcclusion(saturate(dot(input.normal, toCamera)), input.occlusion.w, roughness);
+#endif
+    totalLight += reflection;
+#endif
 	
-	// Return pixel color
-    return float4(pow(totalLight, 1.0f / 2.2f), 1);
+	// Return pixel color, linear (the tonemap does the gamma)
+    return float4(totalLight, 1);
 
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+
+// Which effects to draw (PostFused* in Game.cpp)
+#define POST_PIXELATE 1
+#define POST_VIGNETTE 2
+#define POST_GRADE 4
+
+// The grading table's size and how it's indexed (ColorLut*
+// in ColorGrading.h)
+#define LUT_SIZE 32
+#define LUT_RANGE 16.0f
+#define LUT_SHAPER_POWER 2.2f
+
+Texture2D Pixels : register(t0);
+Texture3D GradingLut : register(t1);
+SamplerState ClampSampler : register(s0);
+
+cbuffer PostFused : register(b0)
+{
+    float2 pixelCells;  // Pixelation's grid, across and down
+    float vignette;     // How dark the corners get
+    int postEffects;    // POST_ bits
+    float exposure;     // What the linear color is scaled by before grading
+}
+
+struct VertexToPixel
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+};
+
+// --------------------------------------------------------
+// Every effect of the post process chain that reads no more
+// than one sample, fused into one pass so nothing is written
+// out in between.  With no bits set, it's a plain copy.
+//
+// They're drawn in a fixed order, which has to match their
+// order in the chain.  Everything before the grade is in
+// linear HDR, and the grade takes it to the screen.
+// --------------------------------------------------------
+float4 main(VertexToPixel input) : SV_TARGET
+{
+    float2 uv = input.uv;
+    if (postEffects & POST_PIXELATE)
+        uv = round(uv * pixelCells) / pixelCells;
+    float4 color = Pixels.Sample(ClampSampler, uv);
+
+    if (postEffects & POST_VIGNETTE)
+    {
+        float2 fromCenter = input.uv * 2.0f - 1.0f;
+        color.rgb *= saturate(1.0f - dot(fromCenter, fromCenter) * 0.5f * vignette);
+    }
+
+    // Tonemap, tint, saturation, contrast and gamma, all baked
+    // into the table, indexed through its shaper
+    if (postEffects & POST_GRADE)
+    {
+        float3 shaped = pow(saturate(color.rgb * exposure / LUT_RANGE), 1.0f / LUT_SHAPER_POWER);
+        color = float4(GradingLut.Sample(ClampSampler, shaped * ((LUT_SIZE - 1.0f) / LUT_SIZE) + 0.5f / LUT_SIZE).rgb, 1);
+    }
+    return color;
+}
@@ -0,0 +1,305 @@
+#include "PostProcessChain.h"
+
+namespace
+{
+	// Any effect's output, or the scene
+	const int SceneSource = -1;
+
+}
+
+PostTarget PostTargetSize(unsigned int width, unsigned int height, float scale)
+{
+	unsigned int scaledWidth = (unsigned int)(width * scale + 0.5f);
+	unsigned int scaledHeight = (unsigned int)(height * scale + 0.5f);
+	return { scaledWidth > 0 ? scaledWidth : 1, scaledHeight > 0 ? scaledHeight : 1 };
+}
+
+bool PostEffect::IsActive() const
+{
+	if (!Enabled)
+		return false;
+	if (Required)
+		return true;
+	bool changes = Params.empty();
+	for (const PostEffectParam& param : Params)
+	{
+		if (param.Value != param.Identity)
+			changes = true;
+		else if (param.Strength)
+			return false;
+	}
+	return changes;
+}
+
+bool PlanPostChain(
+	const std::vector<PostEffect>& effects,
+	unsigned int width,
+	unsigned int height,
+	unsigned int bytesPerPixel,
+	PostChainPlan& plan)
+{
+	plan = PostChainPlan();
+	unsigned int count = (unsigned int)effects.size();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const PostEffect& effect = effects[i];
+		for (unsigned int k = 0; k < effect.InputCount && k < MaxPostInputs; k++)
+		{
+			if (effect.Inputs[k] >= (int)i)
+				return false;
+		}
+
+		for (unsigned int n = 0; n < (unsigned int)effect.Passes.size(); n++)
+		{
+			const PostEffectPass& pass = effect.Passes[n];
+			for (unsigned int k = 0; k < pass.InputCount && k < MaxPostInputs; k++)
+			{
+				int input = pass.Inputs[k];
+				if (input >= (int)n || (input < 0 && (unsigned int)(-1 - input) >= effect.InputCount))
+					return false;
+			}
+		}
+	}
+
+	// What each effect reads, once the inactive ones are skipped:
+	// the effect whose output it is, or the scene.  An inactive
+	// effect passes its first input along.
+	std::vector<int> output(count, SceneSource);
+	std::vector<std::vector<int>> sources(count);
+	std::vector<unsigned int> readers(count, 0);
+	int previous = SceneSource;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const PostEffect& effect = effects[i];
+		unsigned int inputCount = effect.InputCount < MaxPostInputs ? effect.InputCount : MaxPostInputs;
+		for (unsigned int k = 0; k < inputCount; k++)
+		{
+			int input = effect.Inputs[k];
+			sources[i].push_back(
+				input == PostInputPrevious ? previous :
+				input == PostInputScene ? SceneSource :
+				output[input]);
+		}
+
+		if (!effect.IsActive())
+		{
+			output[i] = sources[i].empty() ? previous : sources[i][0];
+			continue;
+		}
+
+		output[i] = (int)i;
+		previous = (int)i;
+		plan.ActiveEffects++;
+		for (int source : sources[i])
+		{
+			if (source != SceneSource)
+				readers[source]++;
+		}
+	}
+	if (previous == SceneSource)
+		return true;
+	readers[previous]++;	// The screen reads the last one
+
+	// Passes, fusing per pixel effects into the one before when
+	// nothing else reads what that wrote.  Values are what the
+	// passes write, 0 being the scene and p + 1 pass p's output.
+	std::vector<PostPass> passes;
+	std::vector<bool> passAdditive;
+	std::vector<float> passScales;
+	std::vector<std::vector<int>> passInputs;
+	std::vector<int> value(count, 0);
+	int last = SceneSource;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const PostEffect& effect = effects[i];
+		if (!effect.IsActive())
+			continue;
+
+		bool fuse =
+			effect.Kind == PostEffectKind::PerPixel &&
+			effect.Passes.empty() &&
+			sources[i].size() == 1 &&
+			sources[i][0] == last &&
+			last != SceneSource &&
+			readers[last] == 1 &&
+			effects[passes.back().Effects[0]].Kind != PostEffectKind::Gather &&
+			passScales.back() == effect.Scale;
+		last = (int)i;
+		if (fuse)
+		{
+			passes.back().Effects.push_back(i);
+			value[i] = (int)passes.size();
+			continue;
+		}
+
+		// The effect's inputs as values, then each pass reading
+		// those or the passes before it
+		std::vector<int> effectInputs;
+		for (int source : sources[i])
+			effectInputs.push_back(source == SceneSource ? 0 : value[source]);
+
+		std::vector<PostEffectPass> effectPasses = effect.Passes;
+		if (effectPasses.empty())
+		{
+			effectPasses.push_back(PostEffectPass());
+			effectPasses[0].Scale = effect.Scale;
+			effectPasses[0].InputCount = (unsigned int)effectInputs.size();
+		}
+
+		unsigned int first = (unsigned int)passes.size();
+		for (unsigned int n = 0; n < (unsigned int)effectPasses.size(); n++)
+		{
+			const PostEffectPass& effectPass = effectPasses[n];
+			std::vector<int> inputs;
+			for (unsigned int k = 0; k < effectPass.InputCount && k < MaxPostInputs; k++)
+			{
+				int input = effectPass.Inputs[k];
+				inputs.push_back(input >= 0 ? (int)(first + input) + 1 : effectInputs[-1 - input]);
+			}
+
+			PostPass pass;
+			pass.Effects.push_back(i);
+			pass.Pass = n;
+			passes.push_back(pass);
+			passAdditive.push_back(effectPass.Additive && inputs.size() == 2);
+			passScales.push_back(effectPass.Scale);
+			passInputs.push_back(inputs);
+		}
+		value[i] = (int)passes.size();
+	}
+
+	// Anything smaller than the screen is copied up to it
+	if (passScales.back() != 1.0f)
+	{
+		passes.push_back(PostPass());
+		passAdditive.push_back(false);
+		passScales.push_back(1.0f);
+		passInputs.push_back({ (int)passes.size() - 1 });
+	}
+
+	// Only what leads to the last pass is drawn
+	std::vector<bool> needed(passes.size(), false);
+	needed.back() = true;
+	for (unsigned int p = (unsigned int)passes.size(); p-- > 0;)
+	{
+		if (!needed[p])
+			continue;
+		for (int input : passInputs[p])
+		{
+			if (input > 0)
+				needed[input - 1] = true;
+		}
+	}
+
+	std::vector<int> kept(passes.size() + 1, 0);	// By value, what it becomes
+	for (unsigned int p = 0; p < (unsigned int)passes.size(); p++)
+	{
+		if (!needed[p])
+		{
+			plan.CulledPasses++;
+			continue;
+		}
+
+		for (int& input : passInputs[p])
+			input = kept[input];
+		plan.Passes.push_back(passes[p]);
+		passAdditive[plan.Passes.size() - 1] = passAdditive[p];
+		passInputs[plan.Passes.size() - 1] = passInputs[p];
+		passScales[plan.Passes.size() - 1] = passScales[p];
+		kept[p + 1] = (int)plan.Passes.size();
+	}
+
+	// Targets, taken back after the last pass that reads them
+	unsigned int passCount = (unsigned int)plan.Passes.size();
+	std::vector<unsigned int> lastRead(passCount + 1, 0);
+	for (unsigned int p = 0; p < passCount; p++)
+	{
+		for (int input : passInputs[p])
+			lastRead[input] = p;
+	}
+
+	std::vector<int> held(passCount + 1, PostBackBuffer);	// By value, its target
+	std::vector<bool> free;
+	auto take = [&](PostTarget size)
+	{
+		for (unsigned int t = 0; t < (unsigned int)plan.Targets.size(); t++)
+		{
+			if (free[t] && plan.Targets[t].Width == size.Width && plan.Targets[t].Height == size.Height)
+			{
+				free[t] = false;
+				return (int)t;
+			}
+		}
+		plan.Targets.push_back(size);
+		free.push_back(false);
+		return (int)plan.Targets.size() - 1;
+	};
+
+	held[0] = take({ width, height });
+	plan.SceneTarget = held[0];
+	for (unsigned int p = 0; p < passCount; p++)
+	{
+		PostPass& pass = plan.Passes[p];
+		pass.InputCount = (unsigned int)passInputs[p].size();
+		for (unsigned int k = 0; k < pass.InputCount; k++)
+			pass.Inputs[k] = held[passInputs[p][k]];
+
+		// Onto the second input, if nothing else needs it as it is
+		PostTarget size = PostTargetSize(width, height, passScales[p]);
+		int onto = pass.InputCount == 2 ? passInputs[p][1] : 0;
+		if (p + 1 == passCount)
+			pass.Output = PostBackBuffer;
+		else if (passAdditive[p] && lastRead[onto] == p && held[onto] != PostBackBuffer && passInputs[p][0] != onto &&
+			plan.Targets[held[onto]].Width == size.Width && plan.Targets[held[onto]].Height == size.Height)
+		{
+			held[p + 1] = pass.Output = held[onto];
+			held[onto] = PostBackBuffer;
+			pass.Additive = true;
+		}
+		else
+			held[p + 1] = pass.Output = take(size);
+
+		for (int input : passInputs[p])
+		{
+			if (lastRead[input] == p && held[input] != PostBackBuffer)
+			{
+				free[held[input]] = true;
+				held[input] = PostBackBuffer;
+			}
+		}
+
+		if (pass.Effects.size() > 1)
+			plan.FusedEffects += (unsigned int)pass.Effects.size() - 1;
+	}
+
+	for (const PostTarget& target : plan.Targets)
+		plan.TargetBytes += (unsigned long long)target.Width * target.Height * bytesPerPixel;
+	return true;
+}
+
+unsigned long long PostChainTraffic(
+	const PostChainPlan& plan,
+	unsigned int width,
+	unsigned int height,
+	unsigned int bytesPerPixel,
+	unsigned int screenBytesPerPixel)
+{
+	auto targetBytes = [&](int target)
+	{
+		return target == PostBackBuffer ?
+			(unsigned long long)width * height * screenBytesPerPixel :
+			(unsigned long long)plan.Targets[target].Width * plan.Targets[target].Height * bytesPerPixel;
+	};
+
+	unsigned long long bytes = targetBytes(plan.SceneTarget);
+	for (const PostPass& pass : plan.Passes)
+	{
+		for (unsigned int k = 0; k < pass.InputCount; k++)
+		{
+			if (!pass.Additive || k == 0)
+				bytes += targetBytes(pass.Inputs[k]);
+		}
+		bytes += targetBytes(pass.Output) * (pass.Additive ? 2 : 1);
+	}
+	return bytes;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vector>
+
+// The most textures one effect reads
+const unsigned int MaxPostInputs = 2;
+
+// Where an effect's input comes from, when it isn't the output
+// of an earlier effect (by its index in the chain)
+const int PostInputPrevious = -1;	// The last enabled effect before it, or the scene
+const int PostInputScene = -2;
+
+// A pass's input, when it isn't an earlier pass of the same
+// effect (by its index): one of the effect's own inputs
+const int PostPassInput0 = -1;
+const int PostPassInput1 = -2;
+
+// A pass's output when it's the screen rather than a target
+const int PostBackBuffer = -1;
+
+enum class PostEffectKind
+{
+	PerPixel,	// Reads its input at the pixel's own spot, and nothing else
+	Resample,	// Reads its input once, somewhere else (like pixelation)
+	Gather,		// Reads many texels, in one or more passes of its own
+};
+
+// One pass of an effect that takes more than one
+struct PostEffectPass
+{
+	float Scale = 1.0f;
+	int Inputs[MaxPostInputs] = { PostPassInput0, PostPassInput1 };
+	unsigned int InputCount = 1;
+	bool Additive = false;	// Can blend onto its second input in place, see PostPass
+};
+
+// --------------------------------------------------------
+// One setting of an effect, as the UI shows it.  With every
+// setting at its identity value, or a strength at its, an
+// effect doesn't change the image, so it's left out of the
+// chain like a disabled one.
+// --------------------------------------------------------
+struct PostEffectParam
+{
+	const char* Name;
+	float Value;
+	float Min;
+	float Max;
+	float Identity;
+	bool Integer;			// Shown and used as a whole number
+	bool Strength = false;	// At its identity, nothing else matters
+};
+
+// --------------------------------------------------------
+// An effect in the chain: what it reads, how big its output
+// is and what it can be set to.  What it actually draws is up
+// to whoever runs the chain.
+// --------------------------------------------------------
+struct PostEffect
+{
+	const char* Name = "";
+	PostEffectKind Kind = PostEffectKind::PerPixel;
+	int Inputs[MaxPostInputs] = { PostInputPrevious, PostInputScene };
+	unsigned int InputCount = 1;
+	float Scale = 1.0f;			// Output size, of the screen's
+
+	// Gather only.  With none it's one pass at Scale, reading
+	// Inputs; otherwise the last one's output is the effect's.
+	std::vector<PostEffectPass> Passes;
+	bool Enabled = true;
+	bool Required = false;		// Drawn even with every setting at its identity
+	std::vector<PostEffectParam> Params;
+
+	// Enabled, and required or some setting away from its identity
+	bool IsActive() const;
+};
+
+// --------------------------------------------------------
+// One draw of the chain.  Per pixel effects that follow a
+// pass and only read its output are fused into it: the pass
+// draws each of its effects in turn, in one shader, without
+// writing anything in between.  A pass with no effects is a
+// plain copy.
+// --------------------------------------------------------
+struct PostPass
+{
+	std::vector<unsigned int> Effects;	// By index in the chain
+	unsigned int Pass = 0;				// Which of the effect's passes
+	int Inputs[MaxPostInputs] = {};		// Targets read, for the first effect's inputs
+	unsigned int InputCount = 0;
+	int Output = PostBackBuffer;		// Target written
+
+	// An additive pass whose second input is the same size and
+	// read by nothing after it is drawn onto that input with an
+	// additive blend, rather than reading it: Output is then the
+	// same target as Inputs[1].
+	bool Additive = false;
+};
+
+struct PostTarget
+{
+	unsigned int Width;
+	unsigned int Height;
+};
+
+// The size of a target at a fraction of the screen, never
+// less than a pixel
+PostTarget PostTargetSize(unsigned int width, unsigned int height, float scale);
+
+// --------------------------------------------------------
+// How to run a chain this frame, and what it takes.
+//
+// Targets are handed out as passes need them and taken back
+// after the last pass that reads them, the scene's included,
+// so a straight run of effects ping-pongs between two
+// textures however long it is.  The last pass draws to the
+// back buffer.  With nothing active there are no passes at
+// all, and the scene is drawn straight to the back buffer.
+// --------------------------------------------------------
+struct PostChainPlan
+{
+	std::vector<PostPass> Passes;
+	std::vector<PostTarget> Targets;
+	int SceneTarget = PostBackBuffer;	// Where to draw the scene
+	unsigned long long TargetBytes = 0;	// Every target, the scene's included
+	unsigned int ActiveEffects = 0;
+	unsigned int FusedEffects = 0;		// Active effects that didn't need a pass of their own
+	unsigned int CulledPasses = 0;		// Passes whose output nothing read
+};
+
+// --------------------------------------------------------
+// Plans a chain for a screen of this size.  Returns false
+// (and an empty plan) if an effect reads one after it, or a
+// pass one after it or an input its effect doesn't have.
+// --------------------------------------------------------
+bool PlanPostChain(
+	const std::vector<PostEffect>& effects,
+	unsigned int width,
+	unsigned int height,
+	unsigned int bytesPerPixel,
+	PostChainPlan& plan);
+
+// --------------------------------------------------------
+// Roughly the bytes a plan moves each frame: the scene
+// written once, then every pass reading each of its inputs
+// once and writing its output once (twice when it blends).
+// The screen is counted at screenBytesPerPixel, whatever the
+// targets' format.
+// --------------------------------------------------------
+unsigned long long PostChainTraffic(
+	const PostChainPlan& plan,
+	unsigned int width,
+	unsigned int height,
+	unsigned int bytesPerPixel,
+	unsigned int screenBytesPerPixel);
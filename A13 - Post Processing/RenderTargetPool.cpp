@@ -0,0 +1,105 @@
+#include "RenderTargetPool.h"
+
+#include <stdio.h>
+
+bool RenderTargetDesc::operator==(const RenderTargetDesc& other) const
+{
+	return
+		Width == other.Width &&
+		Height == other.Height &&
+		Format == other.Format &&
+		BindFlags == other.BindFlags &&
+		SampleCount == other.SampleCount;
+}
+
+RenderTargetPool::RenderTargetPool(std::shared_ptr<IGraphicsDevice> device, unsigned int keepFrames) :
+	device(device),
+	keepFrames(keepFrames)
+{
+}
+
+std::shared_ptr<PooledRenderTarget> RenderTargetPool::Acquire(const RenderTargetDesc& desc)
+{
+	for (Entry& entry : targets)
+	{
+		if (!InUse(entry) && entry.Target->Desc == desc)
+		{
+			entry.IdleFrames = 0;
+			reused++;
+			return entry.Target;
+		}
+	}
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = desc.Width;
+	textureDesc.Height = desc.Height;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = desc.Format;
+	textureDesc.SampleDesc.Count = desc.SampleCount;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = desc.BindFlags;
+
+	// Default views, which see the whole texture
+	std::shared_ptr<PooledRenderTarget> target = std::make_shared<PooledRenderTarget>();
+	target->Desc = desc;
+	bool made = SUCCEEDED(device->CreateTexture2D(&textureDesc, 0, target->Texture.GetAddressOf()));
+	if (made && (desc.BindFlags & D3D11_BIND_RENDER_TARGET))
+		made = SUCCEEDED(device->CreateRenderTargetView(target->Texture.Get(), 0, target->RTV.GetAddressOf()));
+	if (made && (desc.BindFlags & D3D11_BIND_SHADER_RESOURCE))
+		made = SUCCEEDED(device->CreateShaderResourceView(target->Texture.Get(), 0, target->SRV.GetAddressOf()));
+	if (made && (desc.BindFlags & D3D11_BIND_DEPTH_STENCIL))
+		made = SUCCEEDED(device->CreateDepthStencilView(target->Texture.Get(), 0, target->DSV.GetAddressOf()));
+	if (!made)
+	{
+		printf("Render target pool could not create a %ux%u target (format %d, %u samples)\n",
+			desc.Width, desc.Height, (int)desc.Format, desc.SampleCount);
+		return 0;
+	}
+
+	target->Bytes = (unsigned long long)desc.Width * desc.Height * desc.SampleCount * FormatBitsPerPixel(desc.Format) / 8;
+	bytes += target->Bytes;
+	created++;
+
+	Entry entry;
+	entry.Target = target;
+	targets.push_back(entry);
+	return target;
+}
+
+void RenderTargetPool::EndFrame()
+{
+	for (unsigned int i = (unsigned int)targets.size(); i-- > 0;)
+	{
+		Entry& entry = targets[i];
+		if (InUse(entry))
+			entry.IdleFrames = 0;
+		else if (++entry.IdleFrames > keepFrames)
+			Release(i);
+	}
+}
+
+void RenderTargetPool::ReleaseUnused()
+{
+	for (unsigned int i = (unsigned int)targets.size(); i-- > 0;)
+	{
+		if (!InUse(targets[i]))
+			Release(i);
+	}
+}
+
+unsigned int RenderTargetPool::GetInUseCount() const
+{
+	unsigned int count = 0;
+	for (const Entry& entry : targets)
+		count += InUse(entry) ? 1 : 0;
+	return count;
+}
+
+void RenderTargetPool::Release(unsigned int index)
+{
+	bytes -= targets[index].Target->Bytes;
+	released++;
+	targets.erase(targets.begin() + index);
+}
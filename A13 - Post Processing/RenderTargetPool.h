@@ -0,0 +1,88 @@
+#pragma once
+
+#include <d3d11.h>
+#include <memory>
+#include <vector>
+#include <wrl/client.h>
+
+#include "GraphicsAPI.h"
+
+// --------------------------------------------------------
+// What a pooled target is made as.  A target is only handed
+// out again for exactly the same description.
+// --------------------------------------------------------
+struct RenderTargetDesc
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	DXGI_FORMAT Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	unsigned int BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	unsigned int SampleCount = 1;	// MSAA
+
+	bool operator==(const RenderTargetDesc& other) const;
+};
+
+// A texture, and a view for each way its bind flags allow
+struct PooledRenderTarget
+{
+	RenderTargetDesc Desc;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> RTV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DSV;
+	unsigned long long Bytes = 0;
+};
+
+// --------------------------------------------------------
+// Render targets, handed out as they're asked for and kept
+// for reuse rather than released.
+//
+// Acquire() gives out a target no one else holds, and only
+// makes one if none of that description is free.  It's in
+// use for as long as a reference to it is kept; dropping the
+// last one returns it to the pool.  A free target nobody has
+// asked for in keepFrames frames is released at EndFrame(),
+// so the sizes a resize leaves behind go on their own.
+// --------------------------------------------------------
+class RenderTargetPool
+{
+public:
+	RenderTargetPool(std::shared_ptr<IGraphicsDevice> device, unsigned int keepFrames = 2);
+
+	// A target of this description, or null if one couldn't be made
+	std::shared_ptr<PooledRenderTarget> Acquire(const RenderTargetDesc& desc);
+
+	// Ages every free target, releasing the ones idle too long
+	void EndFrame();
+
+	// Releases every target no one holds, right away
+	void ReleaseUnused();
+
+	// What the pool holds, free or in use
+	unsigned int GetTargetCount() const { return (unsigned int)targets.size(); }
+	unsigned int GetInUseCount() const;
+	unsigned long long GetBytes() const { return bytes; }
+
+	// Counters since the pool was made
+	unsigned int GetCreatedCount() const { return created; }
+	unsigned int GetReusedCount() const { return reused; }
+	unsigned int GetReleasedCount() const { return released; }
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<PooledRenderTarget> Target;
+		unsigned int IdleFrames = 0;	// EndFrame()s since it was last handed out
+	};
+
+	std::shared_ptr<IGraphicsDevice> device;
+	unsigned int keepFrames;
+	std::vector<Entry> targets;
+	unsigned long long bytes = 0;
+	unsigned int created = 0;
+	unsigned int reused = 0;
+	unsigned int released = 0;
+
+	bool InUse(const Entry& entry) const { return entry.Target.use_count() > 1; }
+	void Release(unsigned int index);
+};
@@ -0,0 +1,241 @@
+#include "ShaderPermutation.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <unordered_set>
+
+#include "ShaderReflectionCache.h"
+
+unsigned int ShaderPermutationKey::Pack() const
+{
+	return
+		(DirectionalLights & 0xF) |
+		(PointLights & 0xF) << 4 |
+		(SpotLights & 0xF) << 8 |
+		(NormalMap ? 1u : 0u) << 12 |
+		(MetalnessMap ? 1u : 0u) << 13 |
+		(Shadows ? 1u : 0u) << 14 |
+		(ClusteredLights ? 1u : 0u) << 15 |
+		(SpecularIBL ? 1u : 0u) << 16 |
+		(BakedOcclusion ? 1u : 0u) << 17;
+}
+
+ShaderPermutationKey ShaderPermutationKey::Unpack(unsigned int bits)
+{
+	ShaderPermutationKey key;
+	key.DirectionalLights = bits & 0xF;
+	key.PointLights = bits >> 4 & 0xF;
+	key.SpotLights = bits >> 8 & 0xF;
+	key.NormalMap = (bits >> 12 & 1) != 0;
+	key.MetalnessMap = (bits >> 13 & 1) != 0;
+	key.Shadows = (bits >> 14 & 1) != 0;
+	key.ClusteredLights = (bits >> 15 & 1) != 0;
+	key.SpecularIBL = (bits >> 16 & 1) != 0;
+	key.BakedOcclusion = (bits >> 17 & 1) != 0;
+	return key;
+}
+
+// --------------------------------------------------------
+// The shadow map only darkens the first directional light,
+// so without one the shadow lookup is dead code anyway.
+// Clustered variants read their lights from buffers, so the
+// counts don't matter to them (and shadows stay on, as the
+// directional lights aren't known until run time).
+// --------------------------------------------------------
+ShaderPermutationKey ShaderPermutationKey::Canonical() const
+{
+	ShaderPermutationKey key = *this;
+	if (key.ClusteredLights)
+	{
+		key.DirectionalLights = 0;
+		key.PointLights = 0;
+		key.SpotLights = 0;
+	}
+	else if (key.DirectionalLights == 0)
+		key.Shadows = false;
+	return key;
+}
+
+std::vector<ShaderDefine> PermutationDefines(const ShaderPermutationKey& key)
+{
+	return {
+		{ "DIRECTIONAL_LIGHTS", std::to_string(key.DirectionalLights) },
+		{ "POINT_LIGHTS", std::to_string(key.PointLights) },
+		{ "SPOT_LIGHTS", std::to_string(key.SpotLights) },
+		{ "NORMAL_MAP", key.NormalMap ? "1" : "0" },
+		{ "METALNESS_MAP", key.MetalnessMap ? "1" : "0" },
+		{ "SHADOWS", key.Shadows ? "1" : "0" },
+		{ "CLUSTERED_LIGHTS", key.ClusteredLights ? "1" : "0" },
+		{ "SPECULAR_IBL", key.SpecularIBL ? "1" : "0" },
+		{ "BAKED_OCCLUSION", key.BakedOcclusion ? "1" : "0" },
+	};
+}
+
+unsigned long long HashPermutation(
+	unsigned long long sourceHash,
+	const char* entryPoint,
+	const char* target,
+	const std::vector<ShaderDefine>& defines)
+{
+	// Zeros separate the pieces so "ab"+"c" isn't "a"+"bc"
+	std::string text((const char*)&sourceHash, sizeof(sourceHash));
+	text += entryPoint;
+	text += '\0';
+	text += target;
+	text += '\0';
+	for (const ShaderDefine& define : defines)
+	{
+		text += define.Name;
+		text += '=';
+		text += define.Value;
+		text += '\0';
+	}
+	return HashShaderBytecode(text.data(), text.size());
+}
+
+// --------------------------------------------------------
+// Appends the file and everything it includes to text.
+// Files already seen (include guards, diamonds) are skipped.
+// --------------------------------------------------------
+static bool AppendShaderSource(const std::filesystem::path& file, std::unordered_set<std::wstring>& seen, std::string& text)
+{
+	if (!seen.insert(file.lexically_normal().wstring()).second)
+		return true;
+
+	std::ifstream in(file, std::ios::binary);
+	if (!in.is_open())
+		return false;
+
+	std::stringstream contents;
+	contents << in.rdbuf();
+	std::string source = contents.str();
+	text += source;
+	text += '\0';
+
+	// Missing includes are left for the compiler to report
+	std::istringstream lines(source);
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+			continue;
+
+		size_t open = line.find('"', start + 8);
+		size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+		if (close == std::string::npos)
+			continue;
+
+		AppendShaderSource(file.parent_path() / line.substr(open + 1, close - open - 1), seen, text);
+	}
+	return true;
+}
+
+bool HashShaderSource(const std::wstring& sourceFile, unsigned long long& hash)
+{
+	std::unordered_set<std::wstring> seen;
+	std::string text;
+	if (!AppendShaderSource(sourceFile, seen, text))
+		return false;
+
+	hash = HashShaderBytecode(text.data(), text.size());
+	return true;
+}
+
+
+ShaderPermutationCache::ShaderPermutationCache(std::shared_ptr<IShaderCompiler> compiler, const std::wstring& directory) :
+	compiler(compiler),
+	directory(directory),
+	requests(0),
+	compiles(0),
+	diskHits(0),
+	failures(0)
+{
+}
+
+// --------------------------------------------------------
+// Looks for the variant in memory, then on disk, and only
+// then compiles it.  Failures are remembered too, so a
+// broken variant is only attempted once per run.
+//
+// sourceFile - The .hlsl file
+// entryPoint - Function to start in, usually "main"
+// target     - Profile, like "ps_5_0"
+// key        - Features to specialize on
+// --------------------------------------------------------
+std::wstring ShaderPermutationCache::GetVariant(
+	const std::wstring& sourceFile,
+	const char* entryPoint,
+	const char* target,
+	const ShaderPermutationKey& key)
+{
+	requests++;
+	if (!key.IsValid())
+		return std::wstring();
+
+	auto source = sourceHashes.find(sourceFile);
+	if (source == sourceHashes.end())
+	{
+		unsigned long long hash = 0;
+		if (!HashShaderSource(sourceFile, hash))
+		{
+			printf("Shader permutations: can't read %ls\n", sourceFile.c_str());
+			failures++;
+			return std::wstring();
+		}
+		source = sourceHashes.insert({ sourceFile, hash }).first;
+	}
+
+	std::vector<ShaderDefine> defines = PermutationDefines(key.Canonical());
+	unsigned long long hash = HashPermutation(source->second, entryPoint, target, defines);
+
+	auto existing = variants.find(hash);
+	if (existing != variants.end())
+		return existing->second;
+
+	// Named after the source so the cache folder is readable
+	wchar_t suffix[24] = {};
+	swprintf(suffix, 24, L"_%016llx.cso", hash);
+	std::filesystem::path path = std::filesystem::path(directory) / (std::filesystem::path(sourceFile).stem().wstring() + suffix);
+
+	std::error_code error;
+	if (std::filesystem::exists(path, error))
+	{
+		diskHits++;
+		return variants[hash] = path.wstring();
+	}
+
+	std::vector<unsigned char> bytecode;
+	compiles++;
+	if (!compiler || !compiler->Compile(sourceFile, entryPoint, target, defines, bytecode))
+	{
+		failures++;
+		return variants[hash] = std::wstring();
+	}
+
+	// Written to a temporary name first so a half written
+	// file is never mistaken for a finished variant
+	std::filesystem::create_directories(directory, error);
+	std::filesystem::path temp = path;
+	temp += L".tmp";
+	{
+		std::ofstream out(temp, std::ios::binary);
+		out.write((const char*)bytecode.data(), bytecode.size());
+		if (!out.good())
+		{
+			printf("Shader permutations: can't write %ls\n", temp.wstring().c_str());
+			failures++;
+			return variants[hash] = std::wstring();
+		}
+	}
+	std::filesystem::rename(temp, path, error);
+	if (error)
+	{
+		failures++;
+		return variants[hash] = std::wstring();
+	}
+
+	return variants[hash] = path.wstring();
+}
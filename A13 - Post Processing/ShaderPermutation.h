@@ -0,0 +1,130 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Matches the size of the lights array in the PerFrame cbuffer
+const unsigned int PermutationMaxLights = 5;
+
+// --------------------------------------------------------
+// The compile time features of one variant of the lighting
+// pixel shader.  Each becomes a define (see
+// PermutationDefines()), so a variant only loops over the
+// lights it's told about, with no switch on light type, and
+// skips texture reads and math for features it doesn't use.
+//
+// Lights must be sorted to match: directional lights first,
+// then point, then spot.  Clustered variants ignore the
+// counts and read any number of lights from ClusteredLights.
+// --------------------------------------------------------
+struct ShaderPermutationKey
+{
+	unsigned int DirectionalLights = 0;
+	unsigned int PointLights = 0;
+	unsigned int SpotLights = 0;
+	bool NormalMap = false;
+	bool MetalnessMap = false;
+	bool Shadows = false;
+	bool ClusteredLights = false;
+	bool SpecularIBL = false;
+	bool BakedOcclusion = false;
+
+	// 4 bits per light count, then a bit per feature
+	unsigned int Pack() const;
+	static ShaderPermutationKey Unpack(unsigned int bits);
+
+	// Clears anything that wouldn't change the compiled code,
+	// so keys that differ only in those share a variant
+	ShaderPermutationKey Canonical() const;
+
+	bool IsValid() const { return ClusteredLights || DirectionalLights + PointLights + SpotLights <= PermutationMaxLights; }
+	bool operator==(const ShaderPermutationKey& other) const { return Pack() == other.Pack(); }
+	bool operator!=(const ShaderPermutationKey& other) const { return Pack() != other.Pack(); }
+};
+
+struct ShaderDefine
+{
+	std::string Name;
+	std::string Value;
+};
+
+// Every define for a key, always in the same order
+std::vector<ShaderDefine> PermutationDefines(const ShaderPermutationKey& key);
+
+// Identifies one compiled variant: the source (and what it
+// includes), where it starts, and how it's specialized
+unsigned long long HashPermutation(
+	unsigned long long sourceHash,
+	const char* entryPoint,
+	const char* target,
+	const std::vector<ShaderDefine>& defines);
+
+// Hashes a shader source file and, recursively, every file
+// it #includes with quotes (relative to the includer).
+// Returns false if the file itself can't be read.
+bool HashShaderSource(const std::wstring& sourceFile, unsigned long long& hash);
+
+// --------------------------------------------------------
+// Whatever turns HLSL into bytecode: fxc at run time, or a
+// stand in where there's no compiler
+// --------------------------------------------------------
+class IShaderCompiler
+{
+public:
+	virtual ~IShaderCompiler() {}
+
+	// Returns false (after printing why) if it didn't compile
+	virtual bool Compile(
+		const std::wstring& sourceFile,
+		const char* entryPoint,
+		const char* target,
+		const std::vector<ShaderDefine>& defines,
+		std::vector<unsigned char>& bytecode) = 0;
+};
+
+// --------------------------------------------------------
+// Compiles shader variants on first use and keeps the
+// bytecode on disk, named by the variant's hash, so later
+// runs (and other materials asking for the same variant)
+// never compile it again.  Editing the source or anything
+// it includes changes the hash, so stale bytecode is never
+// picked up.
+//
+// Variants come back as .cso paths, which go through the
+// ShaderRegistry like any other compiled shader.
+// --------------------------------------------------------
+class ShaderPermutationCache
+{
+public:
+	ShaderPermutationCache(std::shared_ptr<IShaderCompiler> compiler, const std::wstring& directory);
+
+	// The variant's bytecode file, or an empty string if it
+	// can't be built (use the unspecialized shader instead)
+	std::wstring GetVariant(
+		const std::wstring& sourceFile,
+		const char* entryPoint,
+		const char* target,
+		const ShaderPermutationKey& key);
+
+	// Counters since start up
+	unsigned int GetRequestCount() const { return requests; }
+	unsigned int GetVariantCount() const { return (unsigned int)variants.size(); }
+	unsigned int GetCompileCount() const { return compiles; }
+	unsigned int GetDiskHitCount() const { return diskHits; }
+	unsigned int GetFailureCount() const { return failures; }
+
+private:
+	std::shared_ptr<IShaderCompiler> compiler;
+	std::wstring directory;
+
+	// Sources are only read once per run
+	std::unordered_map<std::wstring, unsigned long long> sourceHashes;
+	std::unordered_map<unsigned long long, std::wstring> variants;
+
+	unsigned int requests;
+	unsigned int compiles;
+	unsigned int diskHits;
+	unsigned int failures;
+};
@@ -0,0 +1,185 @@
+#include "ShaderReflectionCache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string.h>
+
+#include "GraphicsTrace.h"
+
+// --------------------------------------------------------
+// FNV-1a over the whole bytecode.  Only has to tell one
+// build of a shader from another, not resist tampering.
+// --------------------------------------------------------
+unsigned long long HashShaderBytecode(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+void SerializeShaderReflection(const ShaderReflectionData& data, unsigned long long bytecodeHash, std::vector<unsigned char>& bytes)
+{
+	TraceWriter writer;
+	writer.Write("SRFL", 4);
+	writer.Write(ShaderReflectionCacheVersion);
+	writer.Write(bytecodeHash);
+
+	writer.Write((unsigned short)data.ConstantBuffers.size());
+	for (const ShaderReflectionData::ConstantBuffer& cb : data.ConstantBuffers)
+	{
+		writer.WriteString(cb.Name.c_str());
+		writer.Write(cb.Type);
+		writer.Write(cb.BindIndex);
+		writer.Write(cb.Size);
+		writer.Write((unsigned short)cb.Variables.size());
+		for (const ShaderReflectionData::Variable& var : cb.Variables)
+		{
+			writer.WriteString(var.Name.c_str());
+			writer.Write(var.ByteOffset);
+			writer.Write(var.Size);
+			writer.WriteString(var.TypeName.c_str());
+			writer.Write(var.Class);
+			writer.Write(var.BaseType);
+			writer.Write(var.Rows);
+			writer.Write(var.Columns);
+			writer.Write(var.Elements);
+		}
+	}
+
+	for (const std::vector<ShaderReflectionData::Resource>* resources : { &data.ShaderResourceViews, &data.Samplers })
+	{
+		writer.Write((unsigned short)resources->size());
+		for (const ShaderReflectionData::Resource& resource : *resources)
+		{
+			writer.WriteString(resource.Name.c_str());
+			writer.Write(resource.BindIndex);
+		}
+	}
+
+	writer.Write((unsigned short)data.InputParameters.size());
+	for (const ShaderReflectionData::InputParameter& input : data.InputParameters)
+	{
+		writer.WriteString(input.SemanticName.c_str());
+		writer.Write(input.SemanticIndex);
+		writer.Write(input.ComponentType);
+		writer.Write(input.Mask);
+	}
+
+	bytes.swap(writer.Bytes());
+}
+
+// --------------------------------------------------------
+// Reads a cache back in.  Fails (leaving data half filled)
+// if the bytes are malformed, from another version, or for
+// different bytecode.
+// --------------------------------------------------------
+bool DeserializeShaderReflection(const unsigned char* bytes, size_t size, unsigned long long bytecodeHash, ShaderReflectionData& data)
+{
+	TraceReader reader(bytes, size);
+	const void* magic = reader.ReadBytes(4);
+	if (!magic || memcmp(magic, "SRFL", 4) != 0)
+		return false;
+	if (reader.Read<unsigned int>() != ShaderReflectionCacheVersion)
+		return false;
+	if (reader.Read<unsigned long long>() != bytecodeHash)
+		return false;
+
+	data = ShaderReflectionData();
+	data.ConstantBuffers.resize(reader.Read<unsigned short>());
+	for (ShaderReflectionData::ConstantBuffer& cb : data.ConstantBuffers)
+	{
+		const char* name = reader.ReadString();
+		cb.Name = name ? name : "";
+		cb.Type = reader.Read<unsigned int>();
+		cb.BindIndex = reader.Read<unsigned int>();
+		cb.Size = reader.Read<unsigned int>();
+		cb.Variables.resize(reader.Read<unsigned short>());
+		for (ShaderReflectionData::Variable& var : cb.Variables)
+		{
+			name = reader.ReadString();
+			var.Name = name ? name : "";
+			var.ByteOffset = reader.Read<unsigned int>();
+			var.Size = reader.Read<unsigned int>();
+			name = reader.ReadString();
+			var.TypeName = name ? name : "";
+			var.Class = reader.Read<unsigned int>();
+			var.BaseType = reader.Read<unsigned int>();
+			var.Rows = reader.Read<unsigned int>();
+			var.Columns = reader.Read<unsigned int>();
+			var.Elements = reader.Read<unsigned int>();
+		}
+		if (reader.Failed())
+			return false;
+	}
+
+	for (std::vector<ShaderReflectionData::Resource>* resources : { &data.ShaderResourceViews, &data.Samplers })
+	{
+		resources->resize(reader.Read<unsigned short>());
+		for (ShaderReflectionData::Resource& resource : *resources)
+		{
+			const char* name = reader.ReadString();
+			resource.Name = name ? name : "";
+			resource.BindIndex = reader.Read<unsigned int>();
+		}
+		if (reader.Failed())
+			return false;
+	}
+
+	data.InputParameters.resize(reader.Read<unsigned short>());
+	for (ShaderReflectionData::InputParameter& input : data.InputParameters)
+	{
+		const char* name = reader.ReadString();
+		input.SemanticName = name ? name : "";
+		input.SemanticIndex = reader.Read<unsigned int>();
+		input.ComponentType = reader.Read<unsigned int>();
+		input.Mask = reader.Read<unsigned int>();
+	}
+
+	return !reader.Failed() && reader.AtEnd();
+}
+
+std::wstring ShaderReflectionCachePath(const std::wstring& shaderFile)
+{
+	return shaderFile + L".refl";
+}
+
+bool LoadShaderReflectionCache(const std::wstring& shaderFile, unsigned long long bytecodeHash, ShaderReflectionData& data)
+{
+	std::ifstream file(std::filesystem::path(ShaderReflectionCachePath(shaderFile)), std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	std::streamsize size = file.tellg();
+	if (size <= 0)
+		return false;
+
+	std::vector<unsigned char> bytes((size_t)size);
+	file.seekg(0);
+	file.read((char*)bytes.data(), size);
+	if (!file.good())
+		return false;
+
+	return DeserializeShaderReflection(bytes.data(), bytes.size(), bytecodeHash, data);
+}
+
+// --------------------------------------------------------
+// Writes the cache beside the shader.  Failing to (say, a
+// read-only install) just means reflecting again next run.
+// --------------------------------------------------------
+bool SaveShaderReflectionCache(const std::wstring& shaderFile, unsigned long long bytecodeHash, const ShaderReflectionData& data)
+{
+	std::vector<unsigned char> bytes;
+	SerializeShaderReflection(data, bytecodeHash, bytes);
+
+	std::ofstream file(std::filesystem::path(ShaderReflectionCachePath(shaderFile)), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write((const char*)bytes.data(), bytes.size());
+	return file.good();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Everything SimpleShader needs out of D3DReflect, in a
+// form that can be saved next to the compiled shader so
+// later runs can skip reflection entirely
+// --------------------------------------------------------
+struct ShaderReflectionData
+{
+	struct Variable
+	{
+		std::string Name;
+		unsigned int ByteOffset = 0;
+		unsigned int Size = 0;		// Whole array, if it is one
+
+		// The variable's type, enough to rebuild it in C++
+		std::string TypeName;		// "float3", "Light", ...
+		unsigned int Class = 0;		// D3D_SHADER_VARIABLE_CLASS
+		unsigned int BaseType = 0;	// D3D_SHADER_VARIABLE_TYPE
+		unsigned int Rows = 0;
+		unsigned int Columns = 0;
+		unsigned int Elements = 0;	// 0 if not an array
+	};
+
+	struct ConstantBuffer
+	{
+		std::string Name;
+		unsigned int Type = 0;		// D3D_CBUFFER_TYPE
+		unsigned int BindIndex = 0;
+		unsigned int Size = 0;
+		std::vector<Variable> Variables;
+	};
+
+	struct Resource
+	{
+		std::string Name;
+		unsigned int BindIndex = 0;
+	};
+
+	struct InputParameter
+	{
+		std::string SemanticName;
+		unsigned int SemanticIndex = 0;
+		unsigned int ComponentType = 0;	// D3D_REGISTER_COMPONENT_TYPE
+		unsigned int Mask = 0;
+	};
+
+	std::vector<ConstantBuffer> ConstantBuffers;
+	std::vector<Resource> ShaderResourceViews;		// Textures and structured buffers
+	std::vector<Resource> Samplers;
+	std::vector<InputParameter> InputParameters;	// What the shader reads from the previous stage
+};
+
+// --------------------------------------------------------
+// Cache layout (little endian, unpadded):
+//
+//  char[4] "SRFL", u32 version, u64 bytecode hash
+//  u16 count x { string name, u32 type, u32 bind, u32 size,
+//                u16 count x { string name, u32 offset, u32 size,
+//                              string type, u32 class, u32 base type,
+//                              u32 rows, u32 columns, u32 elements } }
+//  u16 count x { string name, u32 bind }     - SRVs
+//  u16 count x { string name, u32 bind }     - samplers
+//  u16 count x { string semantic, u32 index, u32 type, u32 mask }
+//
+// Strings are written as in graphics traces.  A cache whose
+// hash doesn't match the .cso it sits next to is ignored.
+// --------------------------------------------------------
+const unsigned int ShaderReflectionCacheVersion = 2;
+
+unsigned long long HashShaderBytecode(const void* data, size_t size);
+
+void SerializeShaderReflection(const ShaderReflectionData& data, unsigned long long bytecodeHash, std::vector<unsigned char>& bytes);
+bool DeserializeShaderReflection(const unsigned char* bytes, size_t size, unsigned long long bytecodeHash, ShaderReflectionData& data);
+
+// Files live beside the shader: VertexShader.cso -> VertexShader.cso.refl
+std::wstring ShaderReflectionCachePath(const std::wstring& shaderFile);
+bool LoadShaderReflectionCache(const std::wstring& shaderFile, unsigned long long bytecodeHash, ShaderReflectionData& data);
+bool SaveShaderReflectionCache(const std::wstring& shaderFile, unsigned long long bytecodeHash, const ShaderReflectionData& data);
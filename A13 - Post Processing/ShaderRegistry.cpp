@@ -0,0 +1,84 @@
+#include "ShaderRegistry.h"
+
+#include <stdio.h>
+
+ShaderRegistry::ShaderRegistry(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context) :
+	device(device),
+	context(context),
+	requests(0),
+	shares(0),
+	loadTicks(0)
+{
+}
+
+std::shared_ptr<SimpleVertexShader> ShaderRegistry::GetVertexShader(const std::wstring& path)
+{
+	return Get<SimpleVertexShader>(path);
+}
+
+std::shared_ptr<SimplePixelShader> ShaderRegistry::GetPixelShader(const std::wstring& path)
+{
+	return Get<SimplePixelShader>(path);
+}
+
+std::vector<std::shared_ptr<ISimpleShader>> ShaderRegistry::GetShaders() const
+{
+	std::vector<std::shared_ptr<ISimpleShader>> loaded;
+	for (const auto& pair : shaders)
+		loaded.push_back(pair.second);
+	return loaded;
+}
+
+// --------------------------------------------------------
+// Total time spent in Get*Shader(), hits included
+// --------------------------------------------------------
+double ShaderRegistry::GetLoadMilliseconds() const
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	return loadTicks * 1000.0 / (double)freq.QuadPart;
+}
+
+// --------------------------------------------------------
+// Finds the shader for this file's current bytecode, loading
+// it on first use.  A miss reads the file twice (once here,
+// once in the shader), which only happens once per shader.
+// --------------------------------------------------------
+template<typename T>
+std::shared_ptr<T> ShaderRegistry::Get(const std::wstring& path)
+{
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+	requests++;
+
+	// Files that can't be read still get a (broken) shader,
+	// just like constructing one directly
+	std::wstring key = path;
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	if (SUCCEEDED(D3DReadFileToBlob(path.c_str(), blob.GetAddressOf())))
+	{
+		wchar_t hash[32];
+		swprintf_s(hash, L"|%016llx", HashShaderBytecode(blob->GetBufferPointer(), blob->GetBufferSize()));
+		key += hash;
+	}
+
+	std::shared_ptr<T> shader;
+	auto existing = shaders.find(key);
+	if (existing != shaders.end())
+		shader = std::dynamic_pointer_cast<T>(existing->second);
+
+	if (shader)
+	{
+		shares++;
+	}
+	else
+	{
+		shader = std::make_shared<T>(device, context, path.c_str());
+		shaders[key] = shader;
+	}
+
+	LARGE_INTEGER end;
+	QueryPerformanceCounter(&end);
+	loadTicks += end.QuadPart - start.QuadPart;
+	return shader;
+}
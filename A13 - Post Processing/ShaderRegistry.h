@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GraphicsAPI.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Hands out one SimpleShader per compiled shader, so every
+// material using the same .cso shares its D3D shader, input
+// layout, reflection tables and constant buffers instead of
+// loading its own copy.  Entries are keyed by path and a
+// hash of the bytecode, so a rebuilt .cso loads fresh
+// instead of matching the old one.
+//
+// Sharing works because nothing per-material lives in the
+// shader itself: per-object data is copied every draw, and
+// per-material and per-frame data are SharedConstantBuffers
+// bound by their owners right before use.
+// --------------------------------------------------------
+class ShaderRegistry
+{
+public:
+	ShaderRegistry(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context);
+
+	std::shared_ptr<SimpleVertexShader> GetVertexShader(const std::wstring& path);
+	std::shared_ptr<SimplePixelShader> GetPixelShader(const std::wstring& path);
+
+	// Everything loaded so far, in no particular order
+	std::vector<std::shared_ptr<ISimpleShader>> GetShaders() const;
+
+	// Start up counters
+	unsigned int GetShaderCount() const { return (unsigned int)shaders.size(); }
+	unsigned int GetRequestCount() const { return requests; }
+	unsigned int GetShareCount() const { return shares; }
+	double GetLoadMilliseconds() const;
+
+private:
+	std::shared_ptr<IGraphicsDevice> device;
+	std::shared_ptr<IGraphicsContext> context;
+
+	std::unordered_map<std::wstring, std::shared_ptr<ISimpleShader>> shaders;
+	unsigned int requests;
+	unsigned int shares;
+	long long loadTicks;
+
+	template<typename T> std::shared_ptr<T> Get(const std::wstring& path);
+};
@@ -0,0 +1,217 @@
+#include "ShaderStructGenerator.h"
+
+#include <d3dcommon.h>
+#include <map>
+#include <stdio.h>
+
+#include "HlslPacking.h"
+
+std::string ShaderStructName(const std::string& bufferName)
+{
+	std::string name = bufferName;
+	if (!name.empty() && name[0] >= 'a' && name[0] <= 'z')
+		name[0] = name[0] - 'a' + 'A';
+	return name + "Constants";
+}
+
+// --------------------------------------------------------
+// Size of one element of a variable, from its type alone
+// where possible.  Structs only know their size from
+// reflection.  Returns 0 for types a cbuffer can't hold.
+// --------------------------------------------------------
+static unsigned int ElementSize(const ShaderReflectionData::Variable& var)
+{
+	switch (var.Class)
+	{
+	case D3D_SVC_SCALAR:
+	case D3D_SVC_VECTOR:
+		return var.Columns * 4;
+
+	case D3D_SVC_MATRIX_ROWS:
+	case D3D_SVC_MATRIX_COLUMNS:
+		return HlslMatrixSize(var.Rows, var.Columns, var.Class == D3D_SVC_MATRIX_ROWS);
+
+	case D3D_SVC_STRUCT:
+		return HlslArrayElementSize(var.Size, var.Elements);
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// The C++ type for one element, or empty if there isn't a
+// matching one (odd sized matrices), in which case the
+// variable is written as raw bytes
+// --------------------------------------------------------
+static std::string CppType(const ShaderReflectionData::Variable& var)
+{
+	if (var.Class == D3D_SVC_STRUCT)
+		return var.TypeName;
+
+	if (var.Class == D3D_SVC_MATRIX_ROWS || var.Class == D3D_SVC_MATRIX_COLUMNS)
+		return var.BaseType == D3D_SVT_FLOAT && var.Rows == 4 && var.Columns == 4 ? "DirectX::XMFLOAT4X4" : "";
+
+	if (var.Columns < 1 || var.Columns > 4)
+		return "";
+
+	std::string count = std::to_string(var.Columns);
+	switch (var.BaseType)
+	{
+	case D3D_SVT_FLOAT: return var.Columns == 1 ? "float" : "DirectX::XMFLOAT" + count;
+	case D3D_SVT_INT:
+	case D3D_SVT_BOOL: return var.Columns == 1 ? "int" : "DirectX::XMINT" + count;
+	case D3D_SVT_UINT: return var.Columns == 1 ? "unsigned int" : "DirectX::XMUINT" + count;
+	}
+	return "";
+}
+
+bool GenerateShaderStruct(const ShaderReflectionData::ConstantBuffer& buffer, std::string& code)
+{
+	// Pack the variables ourselves first
+	std::vector<HlslField> fields;
+	for (const ShaderReflectionData::Variable& var : buffer.Variables)
+	{
+		HlslField field;
+		field.Name = var.Name;
+		field.Size = ElementSize(var);
+		field.Elements = var.Elements;
+		field.Struct = var.Class == D3D_SVC_STRUCT;
+		field.Matrix = var.Class == D3D_SVC_MATRIX_ROWS || var.Class == D3D_SVC_MATRIX_COLUMNS;
+		if (field.Size == 0)
+		{
+			printf("cbuffer %s: can't work out the size of '%s' (%s)\n", buffer.Name.c_str(), var.Name.c_str(), var.TypeName.c_str());
+			return false;
+		}
+		fields.push_back(field);
+	}
+
+	unsigned int packedSize = PackHlslFields(fields);
+	for (size_t i = 0; i < fields.size(); i++)
+	{
+		const ShaderReflectionData::Variable& var = buffer.Variables[i];
+		if (fields[i].Offset != var.ByteOffset || HlslFieldSize(fields[i]) != var.Size)
+		{
+			printf("cbuffer %s: '%s' packs to %u (%u bytes) but reflection says %u (%u bytes)\n",
+				buffer.Name.c_str(), var.Name.c_str(), fields[i].Offset, HlslFieldSize(fields[i]), var.ByteOffset, var.Size);
+			return false;
+		}
+	}
+	if (packedSize != buffer.Size)
+	{
+		printf("cbuffer %s: packs to %u bytes but reflection says %u\n", buffer.Name.c_str(), packedSize, buffer.Size);
+		return false;
+	}
+
+	// Then write it out, padding between members as needed
+	std::string structName = ShaderStructName(buffer.Name);
+	std::string members;
+	std::string asserts;
+	std::string table;
+	unsigned int offset = 0;
+	unsigned int paddingCount = 0;
+	for (size_t i = 0; i < fields.size(); i++)
+	{
+		const ShaderReflectionData::Variable& var = buffer.Variables[i];
+		const HlslField& field = fields[i];
+
+		if (field.Offset > offset)
+			members += "\tunsigned char _padding" + std::to_string(paddingCount++) + "[" + std::to_string(field.Offset - offset) + "];\n";
+
+		std::string type = CppType(var);
+		if (type.empty())
+			members += "\tunsigned char " + var.Name + "[" + std::to_string(var.Size) + "];\t// " + var.TypeName + "\n";
+		else if (var.Elements == 0)
+			members += "\t" + type + " " + var.Name + ";\n";
+		else if (field.Size % 16 == 0)
+			members += "\t" + type + " " + var.Name + "[" + std::to_string(var.Elements) + "];\n";
+		else
+			members += "\tHlslArray<" + type + ", " + std::to_string(var.Elements) + "> " + var.Name + ";\n";
+
+		if (var.Class == D3D_SVC_STRUCT)
+			asserts += "static_assert(sizeof(" + type + ") == " + std::to_string(field.Size) + ", \"" + type + " doesn't match HLSL\");\n";
+		asserts += "static_assert(offsetof(" + structName + ", " + var.Name + ") == " + std::to_string(field.Offset) + ", \"" + buffer.Name + "." + var.Name + " has moved\");\n";
+		table += "\t\t{ \"" + var.Name + "\", " + std::to_string(field.Offset) + ", " + std::to_string(var.Size) + " },\n";
+
+		offset = field.Offset + var.Size;
+	}
+
+	code += "// --------------------------------------------------------\n";
+	code += "// cbuffer " + buffer.Name + " : register(b" + std::to_string(buffer.BindIndex) + "), " + std::to_string(buffer.Size) + " bytes\n";
+	code += "// --------------------------------------------------------\n";
+	code += "struct alignas(16) " + structName + "\n{\n";
+	code += members;
+	code += "\n\tstatic constexpr const char* BufferName = \"" + buffer.Name + "\";\n";
+	code += "\tstatic constexpr ShaderStructField Fields[] =\n\t{\n" + table + "\t};\n";
+	code += "};\n";
+	code += "static_assert(sizeof(" + structName + ") == " + std::to_string(buffer.Size) + ", \"" + buffer.Name + " has changed size\");\n";
+	code += asserts;
+	return true;
+}
+
+// --------------------------------------------------------
+// Whether every variable in the smaller of two same-named
+// cbuffers is also in the bigger one, at the same place
+// --------------------------------------------------------
+static bool BuffersAgree(const ShaderReflectionData::ConstantBuffer& a, const ShaderReflectionData::ConstantBuffer& b)
+{
+	const ShaderReflectionData::ConstantBuffer& small = a.Size <= b.Size ? a : b;
+	const ShaderReflectionData::ConstantBuffer& big = a.Size <= b.Size ? b : a;
+	for (const ShaderReflectionData::Variable& var : small.Variables)
+	{
+		bool found = false;
+		for (const ShaderReflectionData::Variable& other : big.Variables)
+		{
+			if (other.Name == var.Name)
+			{
+				found = other.ByteOffset == var.ByteOffset && other.Size == var.Size && other.TypeName == var.TypeName;
+				break;
+			}
+		}
+		if (!found)
+			return false;
+	}
+	return true;
+}
+
+bool GenerateShaderStructHeader(
+	const std::vector<const ShaderReflectionData*>& shaders,
+	const std::vector<std::string>& includes,
+	std::string& header)
+{
+	// Sorted by name so the output is the same from run to run
+	std::map<std::string, const ShaderReflectionData::ConstantBuffer*> buffers;
+	for (const ShaderReflectionData* shader : shaders)
+	{
+		for (const ShaderReflectionData::ConstantBuffer& cb : shader->ConstantBuffers)
+		{
+			if (cb.Type != D3D_CT_CBUFFER)
+				continue;
+
+			const ShaderReflectionData::ConstantBuffer*& existing = buffers[cb.Name];
+			if (!existing)
+				existing = &cb;
+			else if (!BuffersAgree(*existing, cb))
+			{
+				printf("cbuffer %s is declared differently by two shaders\n", cb.Name.c_str());
+				return false;
+			}
+			else if (cb.Size > existing->Size)
+				existing = &cb;
+		}
+	}
+
+	header = "#pragma once\n\n";
+	header += "// Generated from shader reflection by running with -gen-structs.\n";
+	header += "// Don't edit by hand; regenerate after changing a cbuffer.\n\n";
+	header += "#include <DirectXMath.h>\n#include <stddef.h>\n\n";
+	header += "#include \"HlslPacking.h\"\n";
+	for (const std::string& include : includes)
+		header += "#include \"" + include + "\"\n";
+
+	for (const auto& pair : buffers)
+	{
+		header += "\n";
+		if (!GenerateShaderStruct(*pair.second, header))
+			return false;
+	}
+	return true;
+}
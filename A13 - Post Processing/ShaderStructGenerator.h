@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ShaderReflectionCache.h"
+
+// --------------------------------------------------------
+// Writes C++ structs that match reflected cbuffers byte for
+// byte, so constant data can be filled as a plain struct
+// and copied in one go instead of variable by variable.
+//
+// Each variable's place is worked out again from its type
+// with the HLSL packing rules and must agree with what
+// reflection reported, so a rule the generator gets wrong
+// fails here instead of silently mis-packing.  The output
+// also static_asserts every offset, and carries a field
+// table for ConstantBuffer<T> to check shaders against.
+// --------------------------------------------------------
+
+// One struct for one cbuffer, named after it ("PerFrame"
+// becomes PerFrameConstants)
+bool GenerateShaderStruct(const ShaderReflectionData::ConstantBuffer& buffer, std::string& code);
+
+// A whole header for every cbuffer in the given shaders.
+// cbuffers with the same name must agree wherever they
+// overlap; the biggest one is the one written out.
+//
+// shaders  - Reflection for each shader to include
+// includes - Headers that define any struct types used
+// header   - The generated text
+bool GenerateShaderStructHeader(
+	const std::vector<const ShaderReflectionData*>& shaders,
+	const std::vector<std::string>& includes,
+	std::string& header);
+
+// C++ name of a cbuffer's generated struct
+std::string ShaderStructName(const std::string& bufferName);
@@ -0,0 +1,263 @@
+#pragma once
+
+// Generated from shader reflection by running with -gen-structs.
+// Don't edit by hand; regenerate after changing a cbuffer.
+
+#include <DirectXMath.h>
+#include <stddef.h>
+
+#include "HlslPacking.h"
+#include "Lights.h"
+
+// --------------------------------------------------------
+// cbuffer BloomDownsample : register(b0), 16 bytes
+// --------------------------------------------------------
+struct alignas(16) BloomDownsampleConstants
+{
+	DirectX::XMFLOAT2 sourceTexel;
+	float threshold;
+	int prefilter;
+
+	static constexpr const char* BufferName = "BloomDownsample";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "sourceTexel", 0, 8 },
+		{ "threshold", 8, 4 },
+		{ "prefilter", 12, 4 },
+	};
+};
+static_assert(sizeof(BloomDownsampleConstants) == 16, "BloomDownsample has changed size");
+static_assert(offsetof(BloomDownsampleConstants, sourceTexel) == 0, "BloomDownsample.sourceTexel has moved");
+static_assert(offsetof(BloomDownsampleConstants, threshold) == 8, "BloomDownsample.threshold has moved");
+static_assert(offsetof(BloomDownsampleConstants, prefilter) == 12, "BloomDownsample.prefilter has moved");
+
+// --------------------------------------------------------
+// cbuffer BloomUpsample : register(b0), 16 bytes
+// --------------------------------------------------------
+struct alignas(16) BloomUpsampleConstants
+{
+	DirectX::XMFLOAT2 sourceTexel;
+	float upsampleWeight;
+	int addBase;
+
+	static constexpr const char* BufferName = "BloomUpsample";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "sourceTexel", 0, 8 },
+		{ "upsampleWeight", 8, 4 },
+		{ "addBase", 12, 4 },
+	};
+};
+static_assert(sizeof(BloomUpsampleConstants) == 16, "BloomUpsample has changed size");
+static_assert(offsetof(BloomUpsampleConstants, sourceTexel) == 0, "BloomUpsample.sourceTexel has moved");
+static_assert(offsetof(BloomUpsampleConstants, upsampleWeight) == 8, "BloomUpsample.upsampleWeight has moved");
+static_assert(offsetof(BloomUpsampleConstants, addBase) == 12, "BloomUpsample.addBase has moved");
+
+// --------------------------------------------------------
+// cbuffer BlurPass : register(b0), 288 bytes
+// --------------------------------------------------------
+struct alignas(16) BlurPassConstants
+{
+	DirectX::XMFLOAT4 blurTaps[17];
+	DirectX::XMFLOAT2 texelStep;
+	int tapCount;
+
+	static constexpr const char* BufferName = "BlurPass";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "blurTaps", 0, 272 },
+		{ "texelStep", 272, 8 },
+		{ "tapCount", 280, 4 },
+	};
+};
+static_assert(sizeof(BlurPassConstants) == 288, "BlurPass has changed size");
+static_assert(offsetof(BlurPassConstants, blurTaps) == 0, "BlurPass.blurTaps has moved");
+static_assert(offsetof(BlurPassConstants, texelStep) == 272, "BlurPass.texelStep has moved");
+static_assert(offsetof(BlurPassConstants, tapCount) == 280, "BlurPass.tapCount has moved");
+
+// --------------------------------------------------------
+// cbuffer ClusterInfo : register(b3), 32 bytes
+// --------------------------------------------------------
+struct alignas(16) ClusterInfoConstants
+{
+	DirectX::XMUINT3 clusterCounts;
+	unsigned int directionalLights;
+	DirectX::XMFLOAT2 tileScale;
+	float sliceScale;
+	float sliceBias;
+
+	static constexpr const char* BufferName = "ClusterInfo";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "clusterCounts", 0, 12 },
+		{ "directionalLights", 12, 4 },
+		{ "tileScale", 16, 8 },
+		{ "sliceScale", 24, 4 },
+		{ "sliceBias", 28, 4 },
+	};
+};
+static_assert(sizeof(ClusterInfoConstants) == 32, "ClusterInfo has changed size");
+static_assert(offsetof(ClusterInfoConstants, clusterCounts) == 0, "ClusterInfo.clusterCounts has moved");
+static_assert(offsetof(ClusterInfoConstants, directionalLights) == 12, "ClusterInfo.directionalLights has moved");
+static_assert(offsetof(ClusterInfoConstants, tileScale) == 16, "ClusterInfo.tileScale has moved");
+static_assert(offsetof(ClusterInfoConstants, sliceScale) == 24, "ClusterInfo.sliceScale has moved");
+static_assert(offsetof(ClusterInfoConstants, sliceBias) == 28, "ClusterInfo.sliceBias has moved");
+
+// --------------------------------------------------------
+// cbuffer Luminance : register(b0), 16 bytes
+// --------------------------------------------------------
+struct alignas(16) LuminanceConstants
+{
+	DirectX::XMFLOAT2 tapStep;
+
+	static constexpr const char* BufferName = "Luminance";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "tapStep", 0, 8 },
+	};
+};
+static_assert(sizeof(LuminanceConstants) == 16, "Luminance has changed size");
+static_assert(offsetof(LuminanceConstants, tapStep) == 0, "Luminance.tapStep has moved");
+
+// --------------------------------------------------------
+// cbuffer PerFrame : register(b0), 640 bytes
+// --------------------------------------------------------
+struct alignas(16) PerFrameConstants
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+	DirectX::XMFLOAT4 cascadeSplits;
+	DirectX::XMFLOAT3 cameraPosition;
+	float cascadeBlend;
+	DirectX::XMFLOAT3 ambient;
+	unsigned char _padding0[4];
+	Light lights[5];
+	DirectX::XMFLOAT4 irradianceSH[9];
+
+	static constexpr const char* BufferName = "PerFrame";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "view", 0, 64 },
+		{ "projection", 64, 64 },
+		{ "cascadeSplits", 128, 16 },
+		{ "cameraPosition", 144, 12 },
+		{ "cascadeBlend", 156, 4 },
+		{ "ambient", 160, 12 },
+		{ "lights", 176, 320 },
+		{ "irradianceSH", 496, 144 },
+	};
+};
+static_assert(sizeof(PerFrameConstants) == 640, "PerFrame has changed size");
+static_assert(offsetof(PerFrameConstants, view) == 0, "PerFrame.view has moved");
+static_assert(offsetof(PerFrameConstants, projection) == 64, "PerFrame.projection has moved");
+static_assert(offsetof(PerFrameConstants, cascadeSplits) == 128, "PerFrame.cascadeSplits has moved");
+static_assert(offsetof(PerFrameConstants, cameraPosition) == 144, "PerFrame.cameraPosition has moved");
+static_assert(offsetof(PerFrameConstants, cascadeBlend) == 156, "PerFrame.cascadeBlend has moved");
+static_assert(offsetof(PerFrameConstants, ambient) == 160, "PerFrame.ambient has moved");
+static_assert(sizeof(Light) == 64, "Light doesn't match HLSL");
+static_assert(offsetof(PerFrameConstants, lights) == 176, "PerFrame.lights has moved");
+static_assert(offsetof(PerFrameConstants, irradianceSH) == 496, "PerFrame.irradianceSH has moved");
+
+// --------------------------------------------------------
+// cbuffer PerMaterial : register(b1), 48 bytes
+// --------------------------------------------------------
+struct alignas(16) PerMaterialConstants
+{
+	DirectX::XMFLOAT4 colorTint;
+	DirectX::XMFLOAT2 scale;
+	DirectX::XMFLOAT2 offset;
+	float roughness;
+
+	static constexpr const char* BufferName = "PerMaterial";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "colorTint", 0, 16 },
+		{ "scale", 16, 8 },
+		{ "offset", 24, 8 },
+		{ "roughness", 32, 4 },
+	};
+};
+static_assert(sizeof(PerMaterialConstants) == 48, "PerMaterial has changed size");
+static_assert(offsetof(PerMaterialConstants, colorTint) == 0, "PerMaterial.colorTint has moved");
+static_assert(offsetof(PerMaterialConstants, scale) == 16, "PerMaterial.scale has moved");
+static_assert(offsetof(PerMaterialConstants, offset) == 24, "PerMaterial.offset has moved");
+static_assert(offsetof(PerMaterialConstants, roughness) == 32, "PerMaterial.roughness has moved");
+
+// --------------------------------------------------------
+// cbuffer PerObject : register(b2), 128 bytes
+// --------------------------------------------------------
+struct alignas(16) PerObjectConstants
+{
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInverseTranspose;
+
+	static constexpr const char* BufferName = "PerObject";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "world", 0, 64 },
+		{ "worldInverseTranspose", 64, 64 },
+	};
+};
+static_assert(sizeof(PerObjectConstants) == 128, "PerObject has changed size");
+static_assert(offsetof(PerObjectConstants, world) == 0, "PerObject.world has moved");
+static_assert(offsetof(PerObjectConstants, worldInverseTranspose) == 64, "PerObject.worldInverseTranspose has moved");
+
+// --------------------------------------------------------
+// cbuffer PostFused : register(b0), 32 bytes
+// --------------------------------------------------------
+struct alignas(16) PostFusedConstants
+{
+	DirectX::XMFLOAT2 pixelCells;
+	float vignette;
+	int postEffects;
+	float exposure;
+
+	static constexpr const char* BufferName = "PostFused";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "pixelCells", 0, 8 },
+		{ "vignette", 8, 4 },
+		{ "postEffects", 12, 4 },
+		{ "exposure", 16, 4 },
+	};
+};
+static_assert(sizeof(PostFusedConstants) == 32, "PostFused has changed size");
+static_assert(offsetof(PostFusedConstants, pixelCells) == 0, "PostFused.pixelCells has moved");
+static_assert(offsetof(PostFusedConstants, vignette) == 8, "PostFused.vignette has moved");
+static_assert(offsetof(PostFusedConstants, postEffects) == 12, "PostFused.postEffects has moved");
+static_assert(offsetof(PostFusedConstants, exposure) == 16, "PostFused.exposure has moved");
+
+// --------------------------------------------------------
+// cbuffer ShadowAtlas : register(b4), 1920 bytes
+// --------------------------------------------------------
+struct alignas(16) ShadowAtlasConstants
+{
+	DirectX::XMFLOAT4X4 shadowTileMatrices[24];
+	DirectX::XMFLOAT4 shadowTileBounds[24];
+
+	static constexpr const char* BufferName = "ShadowAtlas";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "shadowTileMatrices", 0, 1536 },
+		{ "shadowTileBounds", 1536, 384 },
+	};
+};
+static_assert(sizeof(ShadowAtlasConstants) == 1920, "ShadowAtlas has changed size");
+static_assert(offsetof(ShadowAtlasConstants, shadowTileMatrices) == 0, "ShadowAtlas.shadowTileMatrices has moved");
+static_assert(offsetof(ShadowAtlasConstants, shadowTileBounds) == 1536, "ShadowAtlas.shadowTileBounds has moved");
+
+// --------------------------------------------------------
+// cbuffer ShadowPass : register(b3), 64 bytes
+// --------------------------------------------------------
+struct alignas(16) ShadowPassConstants
+{
+	DirectX::XMFLOAT4X4 lightViewProjection;
+
+	static constexpr const char* BufferName = "ShadowPass";
+	static constexpr ShaderStructField Fields[] =
+	{
+		{ "lightViewProjection", 0, 64 },
+	};
+};
+static_assert(sizeof(ShadowPassConstants) == 64, "ShadowPass has changed size");
+static_assert(offsetof(ShadowPassConstants, lightViewProjection) == 0, "ShadowPass.lightViewProjection has moved");
@@ -0,0 +1,296 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Texels a placement is short of what was asked for
+	unsigned long long Shortfall(const std::vector<ShadowAtlasRect>& tiles, const std::vector<unsigned int>& sizes)
+	{
+		unsigned long long shortfall = 0;
+		for (size_t i = 0; i < tiles.size(); i++)
+			shortfall += (unsigned long long)sizes[i] * sizes[i] - (unsigned long long)tiles[i].Size * tiles[i].Size;
+		return shortfall;
+	}
+
+	bool SameRect(const ShadowAtlasRect& a, const ShadowAtlasRect& b)
+	{
+		return a.X == b.X && a.Y == b.Y && a.Size == b.Size;
+	}
+}
+
+ShadowAtlasAllocator::ShadowAtlasAllocator(unsigned int atlasSize, unsigned int minTileSize)
+{
+	Reset(atlasSize, minTileSize);
+}
+
+void ShadowAtlasAllocator::Reset(unsigned int atlasSize, unsigned int minTileSize)
+{
+	this->atlasSize = atlasSize;
+	this->minTileSize = std::min(std::max(minTileSize, 1u), atlasSize);
+	Clear(layout);
+	frameStats = ShadowAtlasStats();
+	totalStats = ShadowAtlasStats();
+	frames = 0;
+}
+
+void ShadowAtlasAllocator::Allocate(const std::vector<ShadowTileRequest>& requests, std::vector<ShadowAtlasRect>& tiles)
+{
+	frameStats = ShadowAtlasStats();
+
+	std::vector<unsigned int> sizes(requests.size());
+	for (size_t i = 0; i < requests.size(); i++)
+		sizes[i] = ShadowTileSize((float)requests[i].Size, minTileSize, atlasSize);
+	tiles.assign(requests.size(), ShadowAtlasRect{ 0, 0, 0 });
+
+	// Keep tiles that are the size asked for, or whose request
+	// hasn't changed (even if it was short), and free the rest
+	std::map<unsigned int, Tile> previous = layout.Tiles;
+	std::map<unsigned int, Tile> kept;
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		auto tile = previous.find(requests[i].Key);
+		if (tile == previous.end())
+			continue;
+		if (tile->second.Requested != sizes[i] && tile->second.Rect.Size != sizes[i])
+			continue;
+
+		tiles[i] = tile->second.Rect;
+		kept[requests[i].Key] = { tile->second.Rect, sizes[i] };
+	}
+	for (const auto& tile : previous)
+	{
+		if (kept.find(tile.first) == kept.end())
+			Release(layout, LevelOf(tile.second.Rect.Size), tile.second.Rect);
+	}
+	layout.Tiles = kept;
+	Place(layout, requests, sizes, tiles);
+
+	// Anything short?  Start over if that fits everything, or at
+	// least makes up half of what it could (the shortfall, or the
+	// free space if that's less) and a sixteenth of the atlas,
+	// so it's worth moving everything for.
+	unsigned long long shortfall = Shortfall(tiles, sizes);
+	if (shortfall > 0)
+	{
+		unsigned long long atlasTexels = (unsigned long long)atlasSize * atlasSize;
+		unsigned long long free = atlasTexels;
+		for (const auto& tile : layout.Tiles)
+			free -= (unsigned long long)tile.second.Rect.Size * tile.second.Rect.Size;
+
+		Layout fresh;
+		Clear(fresh);
+		std::vector<ShadowAtlasRect> freshTiles(requests.size(), ShadowAtlasRect{ 0, 0, 0 });
+		Place(fresh, requests, sizes, freshTiles);
+		unsigned long long freshShortfall = Shortfall(freshTiles, sizes);
+		unsigned long long gain = freshShortfall < shortfall ? shortfall - freshShortfall : 0;
+		if (freshShortfall == 0 || (gain * 2 >= std::min(shortfall, free) && gain * 16 >= atlasTexels))
+		{
+			layout = fresh;
+			tiles = freshTiles;
+			frameStats.Repacks++;
+		}
+	}
+
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		if (tiles[i].Size == 0)
+		{
+			frameStats.Dropped++;
+			continue;
+		}
+
+		if (tiles[i].Size < sizes[i])
+			frameStats.Shrunk++;
+		frameStats.UsedTexels += (unsigned long long)tiles[i].Size * tiles[i].Size;
+
+		auto before = previous.find(requests[i].Key);
+		if (before == previous.end())
+			frameStats.Placed++;
+		else if (SameRect(before->second.Rect, tiles[i]))
+			frameStats.Kept++;
+		else
+			frameStats.Moved++;
+	}
+
+	totalStats.Kept += frameStats.Kept;
+	totalStats.Moved += frameStats.Moved;
+	totalStats.Placed += frameStats.Placed;
+	totalStats.Shrunk += frameStats.Shrunk;
+	totalStats.Dropped += frameStats.Dropped;
+	totalStats.Repacks += frameStats.Repacks;
+	totalStats.UsedTexels += frameStats.UsedTexels;
+	frames++;
+}
+
+void ShadowAtlasAllocator::Clear(Layout& layout) const
+{
+	unsigned int levels = 0;
+	while (levels < 32 && (atlasSize >> levels) >= minTileSize)
+		levels++;
+
+	layout.Free.assign(levels, std::vector<ShadowAtlasRect>());
+	layout.Free[0].push_back({ 0, 0, atlasSize });
+	layout.Tiles.clear();
+}
+
+unsigned int ShadowAtlasAllocator::LevelOf(unsigned int size) const
+{
+	unsigned int level = 0;
+	while ((atlasSize >> level) > size)
+		level++;
+	return level;
+}
+
+bool ShadowAtlasAllocator::Take(Layout& layout, unsigned int level, ShadowAtlasRect& rect) const
+{
+	// The top most, then left most, free square of this size,
+	// which keeps the used part of the atlas together
+	std::vector<ShadowAtlasRect>& free = layout.Free[level];
+	if (!free.empty())
+	{
+		size_t best = 0;
+		for (size_t i = 1; i < free.size(); i++)
+		{
+			if (free[i].Y < free[best].Y || (free[i].Y == free[best].Y && free[i].X < free[best].X))
+				best = i;
+		}
+		rect = free[best];
+		free[best] = free.back();
+		free.pop_back();
+		return true;
+	}
+
+	// Otherwise split a bigger one
+	ShadowAtlasRect parent;
+	if (level == 0 || !Take(layout, level - 1, parent))
+		return false;
+
+	unsigned int half = parent.Size / 2;
+	free.push_back({ parent.X + half, parent.Y, half });
+	free.push_back({ parent.X, parent.Y + half, half });
+	free.push_back({ parent.X + half, parent.Y + half, half });
+	rect = { parent.X, parent.Y, half };
+	return true;
+}
+
+void ShadowAtlasAllocator::Release(Layout& layout, unsigned int level, ShadowAtlasRect rect) const
+{
+	std::vector<ShadowAtlasRect>& free = layout.Free[level];
+	if (level > 0)
+	{
+		// With all three siblings free too, the parent is free
+		unsigned int parentSize = rect.Size * 2;
+		ShadowAtlasRect parent = { rect.X - rect.X % parentSize, rect.Y - rect.Y % parentSize, parentSize };
+		size_t siblings[3];
+		unsigned int found = 0;
+		for (size_t i = 0; i < free.size() && found < 3; i++)
+		{
+			if (free[i].X - free[i].X % parentSize == parent.X && free[i].Y - free[i].Y % parentSize == parent.Y)
+				siblings[found++] = i;
+		}
+
+		if (found == 3)
+		{
+			// Back to front, so the indices left are still good
+			for (int i = 2; i >= 0; i--)
+			{
+				free[siblings[i]] = free.back();
+				free.pop_back();
+			}
+			Release(layout, level - 1, parent);
+			return;
+		}
+	}
+	free.push_back(rect);
+}
+
+void ShadowAtlasAllocator::Place(
+	Layout& layout,
+	const std::vector<ShadowTileRequest>& requests,
+	const std::vector<unsigned int>& sizes,
+	std::vector<ShadowAtlasRect>& tiles) const
+{
+	// The most important requests that fit in what's free, by
+	// area, go first at full size.  They're placed largest
+	// first, so nothing small splits a square a large one needed.
+	unsigned long long freeTexels = (unsigned long long)atlasSize * atlasSize;
+	for (const auto& tile : layout.Tiles)
+		freeTexels -= (unsigned long long)tile.second.Rect.Size * tile.second.Rect.Size;
+
+	std::vector<unsigned int> order;
+	std::vector<unsigned int> missed;
+	for (unsigned int i = 0; i < (unsigned int)requests.size(); i++)
+	{
+		if (tiles[i].Size > 0)
+			continue;
+
+		unsigned long long texels = (unsigned long long)sizes[i] * sizes[i];
+		if (missed.empty() && texels <= freeTexels)
+		{
+			order.push_back(i);
+			freeTexels -= texels;
+		}
+		else
+			missed.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return sizes[a] > sizes[b]; });
+
+	for (unsigned int i : order)
+	{
+		if (Take(layout, LevelOf(sizes[i]), tiles[i]))
+			layout.Tiles[requests[i].Key] = { tiles[i], sizes[i] };
+		else
+			missed.push_back(i);
+	}
+
+	// Then everything else, most important first, halving each
+	// until it fits
+	std::sort(missed.begin(), missed.end());
+	for (unsigned int i : missed)
+	{
+		tiles[i] = { 0, 0, 0 };
+		for (unsigned int size = sizes[i]; size >= minTileSize; size /= 2)
+		{
+			if (Take(layout, LevelOf(size), tiles[i]))
+			{
+				layout.Tiles[requests[i].Key] = { tiles[i], sizes[i] };
+				break;
+			}
+			tiles[i] = { 0, 0, 0 };
+		}
+	}
+}
+
+unsigned int ShadowTileSize(float texels, unsigned int minSize, unsigned int maxSize)
+{
+	unsigned int size = minSize;
+	while (size < texels && size < maxSize)
+		size *= 2;
+	return std::min(size, maxSize);
+}
+
+void ShadowTileTransform(const float viewProjection[16], const ShadowAtlasRect& tile, unsigned int atlasSize, float out[16])
+{
+	// Clip space x and y (-1 to 1, y up) to the tile's UVs (y
+	// down), scaled by w so it still works after the divide
+	double scale = 0.5 * tile.Size / atlasSize;
+	double toTile[4][4] = {};
+	toTile[0][0] = scale;
+	toTile[1][1] = -scale;
+	toTile[2][2] = 1;
+	toTile[3][0] = ((double)tile.X + 0.5 * tile.Size) / atlasSize;
+	toTile[3][1] = ((double)tile.Y + 0.5 * tile.Size) / atlasSize;
+	toTile[3][3] = 1;
+
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			double sum = 0;
+			for (int i = 0; i < 4; i++)
+				sum += viewProjection[row * 4 + i] * toTile[i][column];
+			out[row * 4 + column] = (float)sum;
+		}
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+// The most tiles the shaders can read, across every shadowed
+// light (MAX_SHADOW_TILES in GGPShadersInclude.hlsli)
+const unsigned int MaxShadowTiles = 24;
+
+// A square of the shadow atlas, in texels
+struct ShadowAtlasRect
+{
+	unsigned int X;
+	unsigned int Y;
+	unsigned int Size;	// Zero if nothing could be placed
+};
+
+// One tile wanted this frame.  A key only has to stay the same
+// from frame to frame for the same light (and face or cascade).
+struct ShadowTileRequest
+{
+	unsigned int Key;
+	unsigned int Size;	// Rounded up to a power of two, and clamped to the atlas
+};
+
+struct ShadowAtlasStats
+{
+	unsigned int Kept = 0;		// Requests given the same tile as last frame
+	unsigned int Moved = 0;		// Keys that had a tile last frame, given another one
+	unsigned int Placed = 0;	// Keys that had no tile last frame, given one
+	unsigned int Shrunk = 0;	// Given a smaller tile than they asked for
+	unsigned int Dropped = 0;	// Given no tile at all
+	unsigned int Repacks = 0;	// Frames everything was placed again from scratch
+	unsigned long long UsedTexels = 0;
+};
+
+// --------------------------------------------------------
+// Hands out square, power of two tiles of one shadow atlas
+// texture, quadtree style: each size is a quarter of the one
+// above, a free tile is split in four when a smaller one is
+// needed, and four free siblings merge back into their parent.
+//
+// Tiles are kept from frame to frame, so a light asking for
+// the same size as last frame keeps its spot in the atlas
+// (and anything cached there).  New and resized tiles go into
+// what's left, largest first.  If that leaves them short, and
+// a fresh packing would fit everything or make up a good part
+// of the difference, everything is placed again from scratch
+// instead; square power of two tiles placed largest first
+// always fit if their area does.
+//
+// Requests are given most important first.  As many as fit
+// by area, in that order, are placed at full size; the rest
+// are halved until they fit, down to the smallest tile size,
+// and dropped after that.
+// --------------------------------------------------------
+class ShadowAtlasAllocator
+{
+public:
+	ShadowAtlasAllocator(unsigned int atlasSize = 4096, unsigned int minTileSize = 128);
+
+	// Forgets every tile (and the stats), as when the atlas
+	// texture is remade
+	void Reset(unsigned int atlasSize, unsigned int minTileSize);
+
+	// Places this frame's tiles.  tiles gets one rect for each
+	// request, in the same order.  Keys must be unique.
+	void Allocate(const std::vector<ShadowTileRequest>& requests, std::vector<ShadowAtlasRect>& tiles);
+
+	unsigned int GetAtlasSize() const { return atlasSize; }
+	unsigned int GetMinTileSize() const { return minTileSize; }
+	const ShadowAtlasStats& GetFrameStats() const { return frameStats; }
+	const ShadowAtlasStats& GetTotalStats() const { return totalStats; }	// Every frame so far
+	unsigned int GetFrameCount() const { return frames; }
+
+private:
+	struct Tile
+	{
+		ShadowAtlasRect Rect;
+		unsigned int Requested;	// What it asked for, which Rect may be short of
+	};
+
+	// Everything placed, and the free squares at each size
+	struct Layout
+	{
+		std::vector<std::vector<ShadowAtlasRect>> Free;	// By level, the whole atlas being 0
+		std::map<unsigned int, Tile> Tiles;				// By key
+	};
+
+	void Clear(Layout& layout) const;
+	unsigned int LevelOf(unsigned int size) const;
+	bool Take(Layout& layout, unsigned int level, ShadowAtlasRect& rect) const;
+	void Release(Layout& layout, unsigned int level, ShadowAtlasRect rect) const;
+	void Place(
+		Layout& layout,
+		const std::vector<ShadowTileRequest>& requests,
+		const std::vector<unsigned int>& sizes,
+		std::vector<ShadowAtlasRect>& tiles) const;
+
+	unsigned int atlasSize;
+	unsigned int minTileSize;
+	Layout layout;
+
+	ShadowAtlasStats frameStats;
+	ShadowAtlasStats totalStats;
+	unsigned int frames = 0;
+};
+
+// --------------------------------------------------------
+// A tile size for something that covers about this many
+// texels across: the next power of two up, within
+// [minSize, maxSize]
+// --------------------------------------------------------
+unsigned int ShadowTileSize(float texels, unsigned int minSize, unsigned int maxSize);
+
+// --------------------------------------------------------
+// Turns a light's world to clip space matrix into one from
+// world to its tile of the atlas: UV in x and y and depth in
+// z, once divided by w.  Row vectors, like an XMFLOAT4X4.
+// --------------------------------------------------------
+void ShadowTileTransform(const float viewProjection[16], const ShadowAtlasRect& tile, unsigned int atlasSize, float out[16]);
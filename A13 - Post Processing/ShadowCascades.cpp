@@ -0,0 +1,301 @@
+#include "ShadowCascades.h"
+
+#include <math.h>
+
+namespace
+{
+	// Row vector matrices, like an XMFLOAT4X4, in double so
+	// snapping isn't thrown off by rounding
+	struct Matrix
+	{
+		double M[4][4] = {};
+	};
+
+	Matrix Multiply(const Matrix& a, const Matrix& b)
+	{
+		Matrix result;
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				for (int i = 0; i < 4; i++)
+					result.M[row][column] += a.M[row][i] * b.M[i][column];
+			}
+		}
+		return result;
+	}
+
+	void Store(const Matrix& matrix, float out[16])
+	{
+		for (int i = 0; i < 16; i++)
+			out[i] = (float)matrix.M[i / 4][i % 4];
+	}
+
+	void Normalize(double v[3])
+	{
+		double length = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		for (int i = 0; i < 3; i++)
+			v[i] /= length;
+	}
+
+	void Cross(const double a[3], const double b[3], double out[3])
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	// Looking along a direction from a position, with world up
+	// as up unless the direction is nearly straight up or down.
+	// False if the direction is zero.
+	bool LookAlong(const double position[3], const float direction[3], Matrix& view)
+	{
+		double z[3] = { direction[0], direction[1], direction[2] };
+		if (z[0] == 0 && z[1] == 0 && z[2] == 0)
+			return false;
+
+		Normalize(z);
+		double up[3] = { 0, 1, 0 };
+		if (fabs(z[1]) > 0.99)
+		{
+			up[1] = 0;
+			up[2] = 1;
+		}
+		double x[3], y[3];
+		Cross(up, z, x);
+		Normalize(x);
+		Cross(z, x, y);
+
+		view = Matrix();
+		for (int i = 0; i < 3; i++)
+		{
+			view.M[i][0] = x[i];
+			view.M[i][1] = y[i];
+			view.M[i][2] = z[i];
+			view.M[3][0] -= position[i] * x[i];
+			view.M[3][1] -= position[i] * y[i];
+			view.M[3][2] -= position[i] * z[i];
+		}
+		view.M[3][3] = 1;
+		return true;
+	}
+
+	// Where a view matrix's camera is, and which way it faces.
+	// Its columns are the camera's axes, and its last row is
+	// the position run through them.
+	void CameraFromView(const float cameraView[16], double position[3], double forward[3])
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			forward[i] = cameraView[i * 4 + 2];
+			position[i] = 0;
+			for (int axis = 0; axis < 3; axis++)
+				position[i] -= cameraView[12 + axis] * cameraView[i * 4 + axis];
+		}
+	}
+
+	// An orthographic projection around a sphere, as the light
+	// sees it, reaching back toward the light for anything that
+	// could cast into it.  The center is moved onto the texel
+	// grid so the whole map only ever slides by whole texels.
+	// The depth range snaps too, in steps of an eighth of the
+	// radius, so small moves leave the matrix (and any cached
+	// depth drawn with it) exactly as it was.
+	Matrix FitSphere(const Matrix& lightView, const double center[3], double radius, unsigned int resolution, float casterDistance)
+	{
+		double lightCenter[3] = {};
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int i = 0; i < 3; i++)
+				lightCenter[axis] += center[i] * lightView.M[i][axis];
+		}
+		double texel = 2.0 * radius / resolution;
+		double snappedX = floor(lightCenter[0] / texel) * texel;
+		double snappedY = floor(lightCenter[1] / texel) * texel;
+
+		double depthStep = radius * 0.125;
+		double nearZ = floor((lightCenter[2] - radius - casterDistance) / depthStep) * depthStep;
+		double farZ = nearZ + 2.0 * radius + casterDistance + depthStep;
+		Matrix projection;
+		projection.M[0][0] = 1.0 / radius;
+		projection.M[1][1] = 1.0 / radius;
+		projection.M[2][2] = 1.0 / (farZ - nearZ);
+		projection.M[3][0] = -snappedX / radius;
+		projection.M[3][1] = -snappedY / radius;
+		projection.M[3][2] = -nearZ / (farZ - nearZ);
+		projection.M[3][3] = 1;
+		return Multiply(lightView, projection);
+	}
+
+	// A left handed perspective projection, square, from a
+	// light out to its range.  One texel on each side is
+	// margin, so filtering at the edges still finds depth.
+	Matrix LightPerspective(double tanHalfAngle, float range, unsigned int resolution)
+	{
+		double tanHalf = tanHalfAngle * resolution / (resolution > 2 ? resolution - 2.0 : 1.0);
+		double farZ = range;
+		double nearZ = range * 0.5 < 0.1 ? range * 0.5 : 0.1;
+
+		Matrix projection;
+		projection.M[0][0] = 1.0 / tanHalf;
+		projection.M[1][1] = 1.0 / tanHalf;
+		projection.M[2][2] = farZ / (farZ - nearZ);
+		projection.M[2][3] = 1;
+		projection.M[3][2] = -nearZ * farZ / (farZ - nearZ);
+		return projection;
+	}
+}
+
+void ComputeCascadeSplits(float nearDepth, float farDepth, float lambda, float splits[ShadowCascadeCount])
+{
+	for (unsigned int i = 1; i <= ShadowCascadeCount; i++)
+	{
+		double share = (double)i / ShadowCascadeCount;
+		double logarithmic = nearDepth * pow((double)farDepth / nearDepth, share);
+		double even = nearDepth + (farDepth - nearDepth) * share;
+		splits[i - 1] = (float)(lambda * logarithmic + (1.0 - lambda) * even);
+	}
+	splits[ShadowCascadeCount - 1] = farDepth;
+}
+
+void FrustumSliceSphere(float tanHalfFovY, float aspect, float nearDepth, float farDepth, float& centerDepth, float& radius)
+{
+	// Corners at depth z are sqrt(k2) * z from the axis.  The
+	// center is where the near and far corners are the same
+	// distance away, unless that's past the far plane, when the
+	// far corners alone decide it.
+	double tanHalfFovX = (double)tanHalfFovY * aspect;
+	double k2 = (double)tanHalfFovY * tanHalfFovY + tanHalfFovX * tanHalfFovX;
+	double center = 0.5 * ((double)farDepth + nearDepth) * (1.0 + k2);
+	if (center >= farDepth)
+	{
+		centerDepth = farDepth;
+		radius = (float)(sqrt(k2) * farDepth);
+		return;
+	}
+
+	double toFar = farDepth - center;
+	centerDepth = (float)center;
+	radius = (float)sqrt(toFar * toFar + k2 * farDepth * farDepth);
+}
+
+bool FitShadowCascades(
+	const float cameraView[16],
+	float fovY,
+	float aspect,
+	float nearPlane,
+	const float lightDirection[3],
+	const ShadowCascadeSettings& settings,
+	ShadowCascades& result)
+{
+	// Looking along the light from the origin
+	const double origin[3] = {};
+	Matrix lightView;
+	if (!LookAlong(origin, lightDirection, lightView))
+		return false;
+	Store(lightView, result.LightView);
+
+	double forward[3], position[3];
+	CameraFromView(cameraView, position, forward);
+
+	float splits[ShadowCascadeCount];
+	ComputeCascadeSplits(nearPlane, settings.ShadowDistance, settings.SplitLambda, splits);
+	double blend = settings.BlendBand < 0 ? 0 : settings.BlendBand > 0.5f ? 0.5 : settings.BlendBand;
+	float tanHalfFovY = tanf(fovY * 0.5f);
+
+	for (unsigned int c = 0; c < ShadowCascadeCount; c++)
+	{
+		ShadowCascade& cascade = result.Cascades[c];
+		cascade.NearDepth = c == 0 ? nearPlane : (float)(splits[c - 1] * (1.0 - blend));
+		cascade.FarDepth = splits[c];
+
+		float centerDepth, radius;
+		FrustumSliceSphere(tanHalfFovY, aspect, cascade.NearDepth, cascade.FarDepth, centerDepth, radius);
+		double center[3];
+		for (int i = 0; i < 3; i++)
+		{
+			center[i] = position[i] + forward[i] * centerDepth;
+			cascade.Center[i] = (float)center[i];
+		}
+		cascade.Radius = radius;
+		Store(FitSphere(lightView, center, radius, settings.Resolution, settings.CasterDistance), cascade.ViewProjection);
+	}
+	return true;
+}
+
+bool FitDirectionalShadow(
+	const float cameraView[16],
+	float fovY,
+	float aspect,
+	float nearPlane,
+	const float lightDirection[3],
+	const ShadowCascadeSettings& settings,
+	unsigned int resolution,
+	float viewProjection[16])
+{
+	const double origin[3] = {};
+	Matrix lightView;
+	if (!LookAlong(origin, lightDirection, lightView))
+		return false;
+
+	double forward[3], position[3];
+	CameraFromView(cameraView, position, forward);
+
+	float centerDepth, radius;
+	FrustumSliceSphere(tanf(fovY * 0.5f), aspect, nearPlane, settings.ShadowDistance, centerDepth, radius);
+	double center[3];
+	for (int i = 0; i < 3; i++)
+		center[i] = position[i] + forward[i] * centerDepth;
+	Store(FitSphere(lightView, center, radius, resolution, settings.CasterDistance), viewProjection);
+	return true;
+}
+
+bool SpotShadowMatrix(
+	const float position[3],
+	const float direction[3],
+	float outerAngle,
+	float range,
+	unsigned int resolution,
+	float viewProjection[16])
+{
+	const double from[3] = { position[0], position[1], position[2] };
+	Matrix view;
+	if (range <= 0 || !LookAlong(from, direction, view))
+		return false;
+
+	// Wide cones are cut off short of a half sphere
+	double halfAngle = outerAngle < 1.4 ? outerAngle : 1.4;
+	Store(Multiply(view, LightPerspective(tan(halfAngle), range, resolution)), viewProjection);
+	return true;
+}
+
+bool PointShadowMatrix(
+	const float position[3],
+	unsigned int face,
+	float range,
+	unsigned int resolution,
+	float viewProjection[16])
+{
+	if (range <= 0 || face >= 6)
+		return false;
+
+	float direction[3] = {};
+	direction[face / 2] = face % 2 ? -1.0f : 1.0f;
+	const double from[3] = { position[0], position[1], position[2] };
+	Matrix view;
+	LookAlong(from, direction, view);
+	Store(Multiply(view, LightPerspective(1.0, range, resolution)), viewProjection);
+	return true;
+}
+
+unsigned int PointShadowFace(const float toPoint[3])
+{
+	float x = fabsf(toPoint[0]);
+	float y = fabsf(toPoint[1]);
+	float z = fabsf(toPoint[2]);
+	if (x >= y && x >= z)
+		return toPoint[0] < 0 ? 1 : 0;
+	if (y >= z)
+		return toPoint[1] < 0 ? 3 : 2;
+	return toPoint[2] < 0 ? 5 : 4;
+}
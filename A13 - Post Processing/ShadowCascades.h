@@ -0,0 +1,129 @@
+#pragma once
+
+// --------------------------------------------------------
+// Cascaded shadow maps for a directional light, fitted to
+// the camera's frustum, and the projections for every other
+// kind of shadowed light.  Everything here is plain math on
+// the CPU; Game renders and samples what it works out.
+//
+// The camera's view depth, out to a shadow distance, is cut
+// into ShadowCascadeCount slices, each nearer one smaller
+// so texels on screen stay about the same size.  Each slice
+// gets an orthographic projection around its bounding
+// sphere, which is the same size however the camera turns,
+// with its center snapped to whole shadow texels so the map
+// only ever slides by whole texels as the camera moves.  That
+// keeps shadow edges from shimmering.
+//
+// Each cascade gets a tile of the shadow atlas, and matrices
+// here end in clip space; see ShadowAtlas.h for the rest.
+// --------------------------------------------------------
+const unsigned int ShadowCascadeCount = 4;
+
+struct ShadowCascadeSettings
+{
+	unsigned int Resolution = 1024;	// Of each cascade's tile in the atlas
+	float ShadowDistance = 30.0f;	// View depth past which nothing is shadowed
+	float SplitLambda = 0.75f;		// 0 splits evenly, 1 logarithmically, between is a blend
+	float BlendBand = 0.1f;			// Share of each cascade's far depth faded into the next one
+	float CasterDistance = 50.0f;	// How far past each sphere, toward the light, casters are kept
+};
+
+struct ShadowCascade
+{
+	float ViewProjection[16];	// World to the cascade's clip space, row vectors like an XMFLOAT4X4
+	float Center[3];			// Bounding sphere of the slice, in world space, before snapping
+	float Radius;
+	float NearDepth;			// Camera view depths the slice covers, blend band included
+	float FarDepth;
+};
+
+struct ShadowCascades
+{
+	ShadowCascade Cascades[ShadowCascadeCount];
+	float LightView[16];	// Only turns the world to face along the light
+};
+
+// --------------------------------------------------------
+// The "practical" split scheme: each split is a blend of an
+// even and a logarithmic one, by lambda.  splits gets the far
+// view depth of each cascade; the last is farDepth.
+// --------------------------------------------------------
+void ComputeCascadeSplits(float nearDepth, float farDepth, float lambda, float splits[ShadowCascadeCount]);
+
+// --------------------------------------------------------
+// The smallest sphere around the slice of a perspective
+// frustum between two view depths.  Its center is on the
+// view axis at centerDepth.  Nothing here depends on where
+// the camera points, so neither does the sphere's size.
+// --------------------------------------------------------
+void FrustumSliceSphere(float tanHalfFovY, float aspect, float nearDepth, float farDepth, float& centerDepth, float& radius);
+
+// --------------------------------------------------------
+// Fits every cascade to a camera
+//
+// cameraView     - Its view matrix, like Camera::GetViewMatrix()
+// fovY           - Vertical field of view, in radians
+// lightDirection - The way the light travels, any length
+//
+// Each cascade past the first starts its blend band early,
+// so the band at the end of the one before is inside it.
+// Returns false if the light direction is zero.
+// --------------------------------------------------------
+bool FitShadowCascades(
+	const float cameraView[16],
+	float fovY,
+	float aspect,
+	float nearPlane,
+	const float lightDirection[3],
+	const ShadowCascadeSettings& settings,
+	ShadowCascades& result);
+
+// --------------------------------------------------------
+// One orthographic map over the camera's whole shadow
+// distance, snapped like a cascade, for directional lights
+// that don't get cascades of their own
+//
+// resolution - Of the tile it's drawn into
+// --------------------------------------------------------
+bool FitDirectionalShadow(
+	const float cameraView[16],
+	float fovY,
+	float aspect,
+	float nearPlane,
+	const float lightDirection[3],
+	const ShadowCascadeSettings& settings,
+	unsigned int resolution,
+	float viewProjection[16]);
+
+// --------------------------------------------------------
+// A spot light's cone, out to its range, as a perspective
+// projection.  Returns false for a zero direction or range.
+//
+// outerAngle - From the cone's axis to its edge, in radians
+// resolution - Of the tile it's drawn into, which gets a texel
+//              of margin on every side
+// --------------------------------------------------------
+bool SpotShadowMatrix(
+	const float position[3],
+	const float direction[3],
+	float outerAngle,
+	float range,
+	unsigned int resolution,
+	float viewProjection[16]);
+
+// --------------------------------------------------------
+// One of the six cube faces of a point light's shadow: +X,
+// -X, +Y, -Y, +Z, -Z in that order.  Each is a 90 degree
+// perspective projection (plus a texel of margin).
+// --------------------------------------------------------
+bool PointShadowMatrix(
+	const float position[3],
+	unsigned int face,
+	float range,
+	unsigned int resolution,
+	float viewProjection[16]);
+
+// The face a point, relative to the light, falls on: its
+// largest axis, as the shaders pick it
+unsigned int PointShadowFace(const float toPoint[3]);
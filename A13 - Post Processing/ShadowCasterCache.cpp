@@ -0,0 +1,145 @@
+#include "ShadowCasterCache.h"
+
+#include <string.h>
+
+namespace
+{
+	// Whether a caster is in the cached depth at all
+	bool IsCached(const ShadowCaster& caster)
+	{
+		return caster.CastsShadows && caster.Static;
+	}
+
+	bool SameCaster(const ShadowCaster& a, const ShadowCaster& b)
+	{
+		return memcmp(a.World, b.World, sizeof(a.World)) == 0 &&
+			memcmp(a.LocalMin, b.LocalMin, sizeof(a.LocalMin)) == 0 &&
+			memcmp(a.LocalMax, b.LocalMax, sizeof(a.LocalMax)) == 0 &&
+			a.CastsShadows == b.CastsShadows &&
+			a.Static == b.Static;
+	}
+}
+
+bool CasterInFrustum(const ShadowCaster& caster, const float viewProjection[16])
+{
+	// World then clip, in one matrix
+	float toClip[16] = {};
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			for (int i = 0; i < 4; i++)
+				toClip[row * 4 + column] += caster.World[row * 4 + i] * viewProjection[i * 4 + column];
+		}
+	}
+
+	// The bounds are only out if every corner is past the same
+	// clip plane.  That can keep a box that misses a frustum
+	// corner, but never drops one that's in.
+	unsigned int outside = 0x3f;
+	for (int corner = 0; corner < 8 && outside; corner++)
+	{
+		float local[3] = {
+			(corner & 1) ? caster.LocalMax[0] : caster.LocalMin[0],
+			(corner & 2) ? caster.LocalMax[1] : caster.LocalMin[1],
+			(corner & 4) ? caster.LocalMax[2] : caster.LocalMin[2] };
+		float clip[4];
+		for (int axis = 0; axis < 4; axis++)
+			clip[axis] = local[0] * toClip[axis] + local[1] * toClip[4 + axis] + local[2] * toClip[8 + axis] + toClip[12 + axis];
+
+		outside &=
+			(clip[0] < -clip[3] ? 0x01 : 0) | (clip[0] > clip[3] ? 0x02 : 0) |
+			(clip[1] < -clip[3] ? 0x04 : 0) | (clip[1] > clip[3] ? 0x08 : 0) |
+			(clip[2] < 0 ? 0x10 : 0) | (clip[2] > clip[3] ? 0x20 : 0);
+	}
+	return outside == 0;
+}
+
+void ShadowCasterCache::Update(const ShadowCascades& cascades, const std::vector<ShadowCaster>& casters)
+{
+	frameStats = ShadowCacheStats();
+
+	// A cascade whose matrix changed has to start over
+	for (unsigned int c = 0; c < ShadowCascadeCount; c++)
+	{
+		const CascadeState& state = cascadeStates[c];
+		redraw[c] = !state.Valid ||
+			memcmp(state.ViewProjection, cascades.Cascades[c].ViewProjection, sizeof(state.ViewProjection)) != 0;
+	}
+
+	// So does one a changed static caster was in, or is now in.
+	// Where matrices didn't change, last frame's are the same.
+	size_t count = casters.size() > lastCasters.size() ? casters.size() : lastCasters.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		const ShadowCaster* now = i < casters.size() ? &casters[i] : 0;
+		const ShadowCaster* before = i < lastCasters.size() ? &lastCasters[i] : 0;
+		if (now && before && SameCaster(*now, *before))
+			continue;
+
+		for (unsigned int c = 0; c < ShadowCascadeCount; c++)
+		{
+			if (redraw[c])
+				continue;
+
+			const float* viewProjection = cascades.Cascades[c].ViewProjection;
+			redraw[c] = (before && IsCached(*before) && CasterInFrustum(*before, viewProjection)) ||
+				(now && IsCached(*now) && CasterInFrustum(*now, viewProjection));
+		}
+	}
+
+	// Sort what's left into draws
+	for (unsigned int c = 0; c < ShadowCascadeCount; c++)
+	{
+		CascadeState& state = cascadeStates[c];
+		staticDraws[c].clear();
+		dynamicDraws[c].clear();
+		for (unsigned int i = 0; i < (unsigned int)casters.size(); i++)
+		{
+			const ShadowCaster& caster = casters[i];
+			if (!caster.CastsShadows)
+				continue;
+
+			if (!CasterInFrustum(caster, cascades.Cascades[c].ViewProjection))
+				frameStats.CulledDraws++;
+			else if (!caster.Static)
+				dynamicDraws[c].push_back(i);
+			else if (redraw[c])
+				staticDraws[c].push_back(i);
+			else
+				frameStats.CachedDraws++;
+		}
+		frameStats.StaticDraws += (unsigned int)staticDraws[c].size();
+		frameStats.DynamicDraws += (unsigned int)dynamicDraws[c].size();
+
+		// The atlas still has last frame's copy unless something
+		// was drawn over it, or it's out of date
+		bool hasDynamic = !dynamicDraws[c].empty();
+		copy[c] = redraw[c] || hasDynamic || state.HadDynamic;
+		state.HadDynamic = hasDynamic;
+		if (copy[c])
+			frameStats.Copies++;
+
+		if (redraw[c])
+		{
+			frameStats.Invalidations++;
+			memcpy(state.ViewProjection, cascades.Cascades[c].ViewProjection, sizeof(state.ViewProjection));
+			state.Valid = true;
+		}
+	}
+	lastCasters = casters;
+
+	totalStats.StaticDraws += frameStats.StaticDraws;
+	totalStats.DynamicDraws += frameStats.DynamicDraws;
+	totalStats.CachedDraws += frameStats.CachedDraws;
+	totalStats.CulledDraws += frameStats.CulledDraws;
+	totalStats.Invalidations += frameStats.Invalidations;
+	totalStats.Copies += frameStats.Copies;
+	frames++;
+}
+
+void ShadowCasterCache::Invalidate()
+{
+	for (CascadeState& state : cascadeStates)
+		state.Valid = false;
+}
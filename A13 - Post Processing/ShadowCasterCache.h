@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+
+#include "ShadowCascades.h"
+
+// --------------------------------------------------------
+// One entity as the shadow pass sees it.  Entities keep their
+// index from frame to frame, so the cache can tell what moved.
+// --------------------------------------------------------
+struct ShadowCaster
+{
+	float World[16];		// Row vectors, like an XMFLOAT4X4
+	float LocalMin[3];		// The mesh's bounds
+	float LocalMax[3];
+	bool CastsShadows;
+	bool Static;			// Kept in the cached depth rather than drawn every frame
+};
+
+// What the shadow pass drew, and what it got out of drawing
+struct ShadowCacheStats
+{
+	unsigned int StaticDraws = 0;	// Static casters drawn to refill a cascade's cache
+	unsigned int DynamicDraws = 0;	// Drawn over the cached depth
+	unsigned int CachedDraws = 0;	// Static casters skipped since their cascade was still cached
+	unsigned int CulledDraws = 0;	// Casters outside a cascade's volume
+	unsigned int Invalidations = 0;	// Cascades whose cache was redrawn
+	unsigned int Copies = 0;		// Cascades whose cache was copied into the atlas
+};
+
+// --------------------------------------------------------
+// Works out what the shadow pass needs to draw each frame.
+//
+// Each cascade keeps the depth of the static casters in its
+// volume in a texture of its own.  That's only redrawn when
+// the cascade's matrix changes (the camera moved it past a
+// snapping step, or the light turned) or when a static caster
+// it sees, or saw last frame, changes: moves, is added or
+// removed, or stops being static or casting.  Dynamic casters
+// are drawn over a copy of it in the atlas every frame.
+//
+// Casters whose bounds are outside a cascade's volume aren't
+// drawn into it at all.
+// --------------------------------------------------------
+class ShadowCasterCache
+{
+public:
+	// Called once a frame, with every entity in the same order
+	void Update(const ShadowCascades& cascades, const std::vector<ShadowCaster>& casters);
+
+	// Redraw everything next frame, as when the textures are remade
+	void Invalidate();
+
+	// The cascade's static depth has to be redrawn this frame
+	bool NeedsRedraw(unsigned int cascade) const { return redraw[cascade]; }
+
+	// The cascade's tile in the atlas doesn't hold its cached
+	// depth alone (it was redrawn, or has or had dynamic casters
+	// on it), so it has to be copied in again
+	bool NeedsCopy(unsigned int cascade) const { return copy[cascade]; }
+
+	// Indices of casters to draw into the cache (when it's
+	// being redrawn) and over the copy in the atlas
+	const std::vector<unsigned int>& GetStaticDraws(unsigned int cascade) const { return staticDraws[cascade]; }
+	const std::vector<unsigned int>& GetDynamicDraws(unsigned int cascade) const { return dynamicDraws[cascade]; }
+
+	const ShadowCacheStats& GetFrameStats() const { return frameStats; }
+	const ShadowCacheStats& GetTotalStats() const { return totalStats; }	// Every frame so far
+	unsigned int GetFrameCount() const { return frames; }
+
+private:
+	struct CascadeState
+	{
+		float ViewProjection[16] = {};
+		bool Valid = false;
+		bool HadDynamic = false;	// Last frame drew dynamic casters over the copy
+	};
+
+	CascadeState cascadeStates[ShadowCascadeCount];
+	std::vector<ShadowCaster> lastCasters;
+
+	bool redraw[ShadowCascadeCount] = {};
+	bool copy[ShadowCascadeCount] = {};
+	std::vector<unsigned int> staticDraws[ShadowCascadeCount];
+	std::vector<unsigned int> dynamicDraws[ShadowCascadeCount];
+
+	ShadowCacheStats frameStats;
+	ShadowCacheStats totalStats;
+	unsigned int frames = 0;
+};
+
+// Whether a caster's bounds reach into a cascade's volume, or
+// any other light's, given its world to clip space matrix
+bool CasterInFrustum(const ShadowCaster& caster, const float viewProjection[16]);
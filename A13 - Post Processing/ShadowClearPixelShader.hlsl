@@ -0,0 +1,17 @@
+
+struct VertexToPixel
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+};
+
+// --------------------------------------------------------
+// Clears one tile of the shadow atlas to the far plane, drawn
+// with FullscreenVertexShader and the tile as the viewport.
+// Depth clears can't target part of a texture, and the rest
+// of the atlas (the cascades' cached copies) has to be kept.
+// --------------------------------------------------------
+float main(VertexToPixel input) : SV_Depth
+{
+    return 1.0f;
+}
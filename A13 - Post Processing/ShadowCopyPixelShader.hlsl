@@ -0,0 +1,22 @@
+
+// A cascade's cached static depth (see ShadowCasterCache.h)
+Texture2D StaticDepth : register(t0);
+
+struct VertexToPixel
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+};
+
+// --------------------------------------------------------
+// Copies cached depth into a cascade's tile of the shadow
+// atlas, drawn with FullscreenVertexShader and the tile as
+// the viewport.  Depth copies can't target part of a
+// texture, so this writes it out as SV_Depth instead.
+// --------------------------------------------------------
+float main(VertexToPixel input) : SV_Depth
+{
+    uint width, height;
+    StaticDepth.GetDimensions(width, height);
+    return StaticDepth.Load(int3(input.uv * float2(width, height), 0)).r;
+}
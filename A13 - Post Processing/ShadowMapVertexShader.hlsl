@@ -2,11 +2,16 @@
 #include "GGPShadersInclude.hlsli"
 
 // Constant Buffer for external (C++) data
-cbuffer externalData : register(b0)
+cbuffer PerObject : register(b2)
 {
     matrix world;
-    matrix view;
-    matrix projection;
+};
+
+// The cascade or light being rendered, refilled before each
+// tile of the atlas
+cbuffer ShadowPass : register(b3)
+{
+    matrix lightViewProjection;
 };
 
 // --------------------------------------------------------
@@ -14,6 +19,6 @@ cbuffer externalData : register(b0)
 // --------------------------------------------------------
 float4 main(VertexShaderInput input) : SV_POSITION
 {
-    matrix wvp = mul(projection, mul(view, world));
+    matrix wvp = mul(lightViewProjection, world);
     return mul(wvp, float4(input.localPosition, 1.0f));
-}
\ No newline at end of file
+}
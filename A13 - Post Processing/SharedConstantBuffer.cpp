@@ -0,0 +1,130 @@
+#include "SharedConstantBuffer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// --------------------------------------------------------
+// Creates the buffer from the reflected layout of one of
+// the layout shader's cbuffers
+//
+// device  - Used to create the buffer
+// context - Used to fill it
+// layout  - Any shader that declares the cbuffer
+// name    - The cbuffer's name in HLSL
+// --------------------------------------------------------
+SharedConstantBuffer::SharedConstantBuffer(
+	std::shared_ptr<IGraphicsDevice> device,
+	std::shared_ptr<IGraphicsContext> context,
+	std::shared_ptr<ISimpleShader> layout,
+	std::string name) :
+	context(context),
+	layout(layout),
+	name(name),
+	bufferIndex(0),
+	dirty(true)
+{
+	// Find the buffer in the layout shader
+	const SimpleConstantBuffer* info = layout ? layout->GetBufferInfo(name) : 0;
+	if (!info)
+	{
+		printf("Shared constant buffer '%s' not found in its layout shader\n", name.c_str());
+		return;
+	}
+
+	for (unsigned int i = 0; i < layout->GetBufferCount(); i++)
+		if (layout->GetBufferInfo(i) == info)
+			bufferIndex = i;
+	data.resize(info->Size);
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = info->Size;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	if (FAILED(device->CreateBuffer(&desc, 0, buffer.GetAddressOf())))
+		printf("Shared constant buffer '%s' could not create its buffer\n", name.c_str());
+}
+
+// --------------------------------------------------------
+// Copies data into one variable of the buffer, marking it
+// dirty only if the bytes are different
+//
+// name - The variable's name in HLSL
+// data - What to copy
+// size - How many bytes, which must fit in the variable
+//
+// Returns true if the variable was found and big enough
+// --------------------------------------------------------
+bool SharedConstantBuffer::SetData(std::string name, const void* data, unsigned int size)
+{
+	if (!buffer)
+		return false;
+
+	// Variables of other cbuffers in the layout shader don't count
+	const SimpleShaderVariable* var = layout->GetVariableInfo(name);
+	if (!var || var->ConstantBufferIndex != bufferIndex)
+	{
+		if (ISimpleShader::ReportErrors)
+			printf("Shared constant buffer '%s' has no variable named '%s'\n", this->name.c_str(), name.c_str());
+		return false;
+	}
+	if (size > var->Size)
+	{
+		if (ISimpleShader::ReportErrors)
+			printf("Shared constant buffer '%s': %u bytes don't fit in '%s'\n", this->name.c_str(), size, name.c_str());
+		return false;
+	}
+
+	unsigned char* dest = &this->data[var->ByteOffset];
+	if (memcmp(dest, data, size) != 0)
+	{
+		memcpy(dest, data, size);
+		dirty = true;
+	}
+	return true;
+}
+
+bool SharedConstantBuffer::SetFloat(std::string name, float data) { return SetData(name, &data, sizeof(float)); }
+bool SharedConstantBuffer::SetFloat2(std::string name, const DirectX::XMFLOAT2 data) { return SetData(name, &data, sizeof(float) * 2); }
+bool SharedConstantBuffer::SetFloat3(std::string name, const DirectX::XMFLOAT3 data) { return SetData(name, &data, sizeof(float) * 3); }
+bool SharedConstantBuffer::SetFloat4(std::string name, const DirectX::XMFLOAT4 data) { return SetData(name, &data, sizeof(float) * 4); }
+bool SharedConstantBuffer::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data) { return SetData(name, &data, sizeof(float) * 16); }
+
+// --------------------------------------------------------
+// Sends the whole buffer to the GPU if anything changed
+// since the last upload.  Counted in the same total as
+// shaders' own buffers.
+// --------------------------------------------------------
+void SharedConstantBuffer::Upload()
+{
+	if (!buffer || !dirty)
+		return;
+
+	context->UpdateSubresource(buffer.Get(), 0, 0, data.data(), 0, 0);
+	ISimpleShader::UploadedBytes += data.size();
+	dirty = false;
+}
+
+// --------------------------------------------------------
+// Binds this buffer in place of the shader's cbuffer of the
+// same name.  Shaders that don't use the cbuffer (the
+// compiler strips it if nothing reads from it) are skipped.
+//
+// Returns true if the shader now uses this buffer
+// --------------------------------------------------------
+bool SharedConstantBuffer::BindTo(std::shared_ptr<ISimpleShader> shader)
+{
+	if (!buffer || !shader)
+		return false;
+
+	const SimpleConstantBuffer* info = shader->GetBufferInfo(name);
+	if (!info)
+		return false;
+
+	if (info->Size != data.size())
+	{
+		printf("Shared constant buffer '%s' is %u bytes, but a shader expects %u\n", name.c_str(), (unsigned int)data.size(), info->Size);
+		return false;
+	}
+
+	return shader->SetConstantBuffer(name, buffer);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <wrl/client.h>
+
+#include "GraphicsAPI.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// A constant buffer that lives outside any one shader, so
+// data that changes at the same rate can be filled once and
+// bound to every shader that declares the same cbuffer.
+//
+// The layout comes from reflecting one shader that uses it;
+// any other shader it's bound to must declare the cbuffer
+// identically.  Setting a value that didn't change doesn't
+// mark the buffer dirty, so Upload() only costs anything
+// when something actually changed.
+// --------------------------------------------------------
+class SharedConstantBuffer
+{
+public:
+	SharedConstantBuffer(
+		std::shared_ptr<IGraphicsDevice> device,
+		std::shared_ptr<IGraphicsContext> context,
+		std::shared_ptr<ISimpleShader> layout,
+		std::string name);
+
+	// Same names as the variables in the cbuffer
+	bool SetData(std::string name, const void* data, unsigned int size);
+	bool SetFloat(std::string name, float data);
+	bool SetFloat2(std::string name, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(std::string name, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(std::string name, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
+
+	// Sends the data to the GPU, if any of it changed
+	void Upload();
+
+	// Makes the shader use this buffer for its cbuffer of
+	// the same name
+	bool BindTo(std::shared_ptr<ISimpleShader> shader);
+
+	bool IsValid() const { return buffer != 0; }
+	std::string GetName() const { return name; }
+	unsigned int GetSize() const { return (unsigned int)data.size(); }
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetBuffer() const { return buffer; }
+
+private:
+	std::shared_ptr<IGraphicsContext> context;
+	std::shared_ptr<ISimpleShader> layout;
+
+	std::string name;
+	unsigned int bufferIndex;
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	bool dirty;
+};
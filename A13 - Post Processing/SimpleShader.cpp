@@ -1,5 +1,7 @@
 #include "SimpleShader.h"
 
+#include <algorithm>
+
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
@@ -11,6 +13,17 @@ bool ISimpleShader::ReportWarnings = false;
 // ISimpleShader::ReportErrors = true;
 // ISimpleShader::ReportWarnings = true;
 
+// No constant buffer ring until one is provided
+std::shared_ptr<ConstantBufferRing> ISimpleShader::BufferRing;
+ISimpleShader* ISimpleShader::activeShaders[ISimpleShader::StageCount] = {};
+unsigned long long ISimpleShader::UploadedBytes = 0;
+unsigned long long ISimpleShader::SkippedUploads = 0;
+
+// Reflection results are cached beside each .cso by default
+bool ISimpleShader::UseReflectionCache = true;
+unsigned int ISimpleShader::ReflectionCount = 0;
+unsigned int ISimpleShader::ReflectionCacheHits = 0;
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
@@ -19,16 +32,18 @@ bool ISimpleShader::ReportWarnings = false;
 // --------------------------------------------------------
 // Constructor accepts Direct3D device & context
 // --------------------------------------------------------
-ISimpleShader::ISimpleShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+ISimpleShader::ISimpleShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context)
 {
 	// Save the device
 	this->device = device;
 	this->deviceContext = context;
+	this->partialUpdates = device->SupportsPartialConstantBufferUpdates();
 
 	// Set up fields
 	this->constantBufferCount = 0;
 	this->constantBuffers = 0;
 	this->shaderValid = false;
+	this->bytecodeHash = 0;
 }
 
 // --------------------------------------------------------
@@ -37,6 +52,13 @@ ISimpleShader::ISimpleShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Micros
 ISimpleShader::~ISimpleShader()
 {
 	// Derived class destructors will call this class's CleanUp method
+
+	// Don't leave a dangling pointer for later copies to find
+	for (ISimpleShader*& active : activeShaders)
+	{
+		if (active == this)
+			active = 0;
+	}
 }
 
 // --------------------------------------------------------
@@ -65,6 +87,7 @@ void ISimpleShader::CleanUp()
 
 	// Clean up tables
 	varTable.clear();
+	varHashTable.clear();
 	cbTable.clear();
 	samplerTable.clear();
 	textureTable.clear();
@@ -72,7 +95,9 @@ void ISimpleShader::CleanUp()
 
 // --------------------------------------------------------
 // Loads the specified shader and builds the variable table 
-// using shader reflection.
+// using shader reflection.  Reflection data is read from
+// the cache beside the file when it matches this bytecode,
+// and written there when it doesn't.
 //
 // shaderFile - A "wide string" specifying the compiled shader to load
 // 
@@ -93,6 +118,21 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 
 		return false;
 	}
+	bytecodeHash = HashShaderBytecode(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+
+	// Get reflection data before creating the shader, as vertex
+	// shaders build their input layout from it
+	reflection = ShaderReflectionData();
+	if (UseReflectionCache && LoadShaderReflectionCache(shaderFile, bytecodeHash, reflection))
+	{
+		ReflectionCacheHits++;
+	}
+	else
+	{
+		ReflectShader();
+		if (UseReflectionCache)
+			SaveShaderReflectionCache(shaderFile, bytecodeHash, reflection);
+	}
 
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
@@ -109,23 +149,31 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
-	// Set up shader reflection to get information about
-	// this shader and its variables,  buffers, etc.
+	BuildTables();
+	return true;
+}
+
+// --------------------------------------------------------
+// Uses shader reflection to get information about the
+// shader's variables, buffers, resources and inputs
+// --------------------------------------------------------
+void ISimpleShader::ReflectShader()
+{
+	ReflectionCount++;
+
 	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
 	D3DReflect(
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		IID_ID3D11ShaderReflection,
 		(void**)refl.GetAddressOf());
+	if (!refl)
+		return;
 	
 	// Get the description of the shader
 	D3D11_SHADER_DESC shaderDesc;
 	refl->GetDesc(&shaderDesc);
 
-	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
-	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
-	
 	// Handle bound resources (like shaders and samplers)
 	unsigned int resourceCount = shaderDesc.BoundResources;
 	for (unsigned int r = 0; r < resourceCount; r++)
@@ -134,38 +182,26 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
 		refl->GetResourceBindingDesc(r, &resourceDesc);
 
+		ShaderReflectionData::Resource resource;
+		resource.Name = resourceDesc.Name;
+		resource.BindIndex = resourceDesc.BindPoint;
+
 		// Check the type
 		switch (resourceDesc.Type)
 		{
 		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
 		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
+			reflection.ShaderResourceViews.push_back(resource);
 			break;
 
 		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
-
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
+			reflection.Samplers.push_back(resource);
 			break;
 		}
 	}
 
 	// Loop through all constant buffers
-	for (unsigned int b = 0; b < constantBufferCount; b++)
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
 	{
 		// Get this buffer
 		ID3D11ShaderReflectionConstantBuffer* cb =
@@ -175,16 +211,101 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		D3D11_SHADER_BUFFER_DESC bufferDesc;
 		cb->GetDesc(&bufferDesc);
 
-		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
 		// Get the description of the resource binding, so
 		// we know exactly how it's bound in the shader
 		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
 		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+
+		ShaderReflectionData::ConstantBuffer buffer;
+		buffer.Name = bufferDesc.Name;
+		buffer.Type = bufferDesc.Type;
+		buffer.BindIndex = bindDesc.BindPoint;
+		buffer.Size = bufferDesc.Size;
+
+		// Loop through all variables in this buffer
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			// Get the description of the variable and its type
+			ID3D11ShaderReflectionVariable* reflVar = cb->GetVariableByIndex(v);
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			reflVar->GetDesc(&varDesc);
+			D3D11_SHADER_TYPE_DESC typeDesc;
+			reflVar->GetType()->GetDesc(&typeDesc);
+
+			ShaderReflectionData::Variable var;
+			var.Name = varDesc.Name;
+			var.ByteOffset = varDesc.StartOffset;
+			var.Size = varDesc.Size;
+			var.TypeName = typeDesc.Name ? typeDesc.Name : "";
+			var.Class = typeDesc.Class;
+			var.BaseType = typeDesc.Type;
+			var.Rows = typeDesc.Rows;
+			var.Columns = typeDesc.Columns;
+			var.Elements = typeDesc.Elements;
+			buffer.Variables.push_back(var);
+		}
+
+		reflection.ConstantBuffers.push_back(buffer);
+	}
+
+	// Inputs from the previous stage
+	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		ShaderReflectionData::InputParameter input;
+		input.SemanticName = paramDesc.SemanticName;
+		input.SemanticIndex = paramDesc.SemanticIndex;
+		input.ComponentType = paramDesc.ComponentType;
+		input.Mask = paramDesc.Mask;
+		reflection.InputParameters.push_back(input);
+	}
+}
+
+// --------------------------------------------------------
+// Builds the variable, buffer and resource tables (and the
+// constant buffers themselves) from the reflection data
+// --------------------------------------------------------
+void ISimpleShader::BuildTables()
+{
+	// Handle bound resources (like shaders and samplers)
+	for (const ShaderReflectionData::Resource& resource : reflection.ShaderResourceViews)
+	{
+		// Create the SRV wrapper
+		SimpleSRV* srv = new SimpleSRV();
+		srv->BindIndex = resource.BindIndex;						// Shader bind point
+		srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
+
+		textureTable.insert(std::pair<std::string, SimpleSRV*>(resource.Name, srv));
+		shaderResourceViews.push_back(srv);
+	}
+
+	for (const ShaderReflectionData::Resource& resource : reflection.Samplers)
+	{
+		// Create the sampler wrapper
+		SimpleSampler* samp = new SimpleSampler();
+		samp->BindIndex = resource.BindIndex;				// Shader bind point
+		samp->Index = (unsigned int)samplerStates.size();	// Raw index
+
+		samplerTable.insert(std::pair<std::string, SimpleSampler*>(resource.Name, samp));
+		samplerStates.push_back(samp);
+	}
+
+	// Create resource arrays
+	constantBufferCount = (unsigned int)reflection.ConstantBuffers.size();
+	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+
+	// Loop through all constant buffers
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		const ShaderReflectionData::ConstantBuffer& bufferDesc = reflection.ConstantBuffers[b];
+
+		// Save the type, which we reference when setting these buffers
+		constantBuffers[b].Type = (D3D_CBUFFER_TYPE)bufferDesc.Type;
 		
 		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
+		constantBuffers[b].BindIndex = bufferDesc.BindIndex;
 		constantBuffers[b].Name = bufferDesc.Name;
 		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
 
@@ -202,35 +323,34 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		constantBuffers[b].Size = bufferDesc.Size;
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		constantBuffers[b].Dirty.Add(0, bufferDesc.Size);
 
 		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		for (const ShaderReflectionData::Variable& var : bufferDesc.Variables)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
-
 			// Create the variable struct
 			SimpleShaderVariable varStruct = {};
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
+			varStruct.ByteOffset = var.ByteOffset;
+			varStruct.Size = var.Size;
 
 			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			varTable.insert(std::pair<std::string, SimpleShaderVariable>(var.Name, varStruct));
 			constantBuffers[b].Variables.push_back(varStruct);
+
+			// And to the hashed table, for compile time names
+			ShaderVarHandle handle;
+			handle.ConstantBufferIndex = b;
+			handle.ByteOffset = var.ByteOffset;
+			handle.Size = var.Size;
+			varHashTable.push_back({ HashShaderVarName(var.Name.c_str(), var.Name.size()), var.Name, handle });
 		}
 	}
 
-	// All set
-	return true;
+	// Sort the hashes for binary searching.  Names that hash
+	// the same end up next to each other.
+	std::sort(varHashTable.begin(), varHashTable.end(),
+		[](const ShaderVarHashEntry& a, const ShaderVarHashEntry& b) { return a.Hash < b.Hash; });
 }
 
 // --------------------------------------------------------
@@ -261,6 +381,29 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 	return var;
 }
 
+// --------------------------------------------------------
+// Helper for looking up a variable by a precomputed hash of
+// its name.  Returns an invalid handle if there's no such
+// variable.
+//
+// A matching hash is only a candidate: a variable the
+// shader doesn't have can share its hash with one it does,
+// so the name itself is compared before anything is
+// returned.
+// --------------------------------------------------------
+ShaderVarHandle ISimpleShader::FindVariable(ShaderVarName name)
+{
+	auto result = std::lower_bound(varHashTable.begin(), varHashTable.end(), name.Hash,
+		[](const ShaderVarHashEntry& entry, unsigned int hash) { return entry.Hash < hash; });
+
+	for (; result != varHashTable.end() && result->Hash == name.Hash; ++result)
+	{
+		if (result->Name == name.Name)
+			return result->Handle;
+	}
+	return ShaderVarHandle();
+}
+
 // --------------------------------------------------------
 // Helper for looking up a constant buffer by name
 // --------------------------------------------------------
@@ -349,9 +492,7 @@ void ISimpleShader::CopyAllBufferData()
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
 		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		UploadBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -380,9 +521,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -402,11 +541,181 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(cb);
+}
+
+
+// --------------------------------------------------------
+// Sends a buffer's local data to the GPU, either into a new
+// slice of the constant buffer ring or, without one (or if
+// it's full), into the buffer's own D3D buffer.  If this
+// shader is the active one on its stage the buffer is bound
+// again, as its data may have moved.
+//
+// Buffers that haven't been written to since their last
+// upload are skipped, as long as that data is still valid.
+// Updates to the buffer's own D3D buffer only cover the
+// dirty range when the device allows it.
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(SimpleConstantBuffer* cb)
+{
+	// Shared buffers are filled by whoever owns them
+	if (cb->SharedBuffer)
+		return;
+
+	// Ring slices only last a frame; our own buffer keeps
+	// whatever it was last given
+	bool wasInRing = cb->Slice.Buffer != 0;
+	if (cb->Dirty.IsEmpty() && (!wasInRing || (BufferRing && BufferRing->IsCurrent(cb->Slice))))
+	{
+		SkippedUploads++;
+		return;
+	}
+
+	// Only true constant buffers can be bound by offset
+	bool inRing = BufferRing && cb->Type == D3D11_CT_CBUFFER &&
+		BufferRing->Allocate(cb->LocalDataBuffer, cb->Size, cb->Slice);
+
+	if (inRing)
+	{
+		UploadedBytes += cb->Size;
+	}
+	else
+	{
+		// If the last copy went to the ring our own buffer is
+		// out of date everywhere, not just in the dirty range
+		DirtyRange range = cb->Dirty.Aligned(cb->Size);
+		bool partial = !wasInRing && !range.IsEmpty() && range.Size() < cb->Size &&
+			(partialUpdates || cb->Type != D3D11_CT_CBUFFER);
+
+		cb->Slice = ConstantBufferSlice();
+		if (partial)
+		{
+			D3D11_BOX box = {};
+			box.left = range.Start;
+			box.right = range.End;
+			box.bottom = 1;
+			box.back = 1;
+			deviceContext->UpdateSubresource(
+				cb->ConstantBuffer.Get(), 0, &box,
+				cb->LocalDataBuffer + range.Start, 0, 0);
+			UploadedBytes += range.Size();
+		}
+		else
+		{
+			deviceContext->UpdateSubresource(
+				cb->ConstantBuffer.Get(), 0, 0,
+				cb->LocalDataBuffer, 0, 0);
+			UploadedBytes += cb->Size;
+		}
+	}
+	cb->Dirty.Clear();
+
+	if (cb->Type == D3D11_CT_CBUFFER && IsActive())
+		BindConstantBuffer(cb);
+}
+
+// --------------------------------------------------------
+// Binds all of this shader's constant buffers.  Slices
+// from an earlier frame may have been overwritten since, so
+// their data is uploaded again first.
+// --------------------------------------------------------
+void ISimpleShader::BindConstantBuffers()
+{
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		// Skip "buffers" that aren't true constant buffers
+		SimpleConstantBuffer* cb = &constantBuffers[i];
+		if (cb->Type != D3D11_CT_CBUFFER)
+			continue;
+
+		// UploadBuffer() binds as well, since we're active now
+		if (!cb->SharedBuffer && cb->Slice.Buffer && !(BufferRing && BufferRing->IsCurrent(cb->Slice)))
+			UploadBuffer(cb);
+		else
+			BindConstantBuffer(cb);
+	}
 }
 
+// --------------------------------------------------------
+// Binds an outside buffer in place of one of this shader's
+// own constant buffers.  Copying data to that buffer is then
+// left to its owner.  The buffer must be at least as big as
+// the shader's cbuffer.
+//
+// name   - The name of the cbuffer in the shader
+// buffer - The buffer to use instead, or null to go back to
+//          the shader's own buffer
+//
+// Returns true if a cbuffer of the given name was found
+// --------------------------------------------------------
+bool ISimpleShader::SetConstantBuffer(std::string name, Microsoft::WRL::ComPtr<ID3D11Buffer> buffer, std::shared_ptr<const ConstantBufferSlice> slice)
+{
+	SimpleConstantBuffer* cb = FindConstantBuffer(name);
+	if (!cb) return false;
+
+	// Nothing to do if it's already in use
+	if (cb->SharedBuffer == buffer && cb->SharedSlice == slice)
+		return true;
+
+	// Our own buffer may have missed writes in the meantime
+	cb->SharedBuffer = buffer;
+	cb->SharedSlice = buffer ? slice : 0;
+	cb->Slice = ConstantBufferSlice();
+	cb->Dirty.Add(0, cb->Size);
+	if (cb->Type == D3D11_CT_CBUFFER && IsActive())
+		BindConstantBuffer(cb);
+	return true;
+}
+
+// --------------------------------------------------------
+// Binds an outside buffer again wherever it's in use.  Its
+// owner calls this after each upload to the ring, as the
+// new data is at a different offset.
+//
+// buffer - The buffer given to SetConstantBuffer()
+// --------------------------------------------------------
+void ISimpleShader::RebindConstantBuffer(ID3D11Buffer* buffer)
+{
+	for (ISimpleShader* active : activeShaders)
+	{
+		if (!active)
+			continue;
+
+		for (unsigned int i = 0; i < active->constantBufferCount; i++)
+		{
+			SimpleConstantBuffer* cb = &active->constantBuffers[i];
+			if (cb->Type == D3D11_CT_CBUFFER && cb->SharedBuffer.Get() == buffer)
+				active->BindConstantBuffer(cb);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// The slice of the ring to bind a buffer by, or null to bind
+// the buffer itself.  A shared buffer's slice only counts in
+// the frame it was written, after which the data is back in
+// the buffer or the owner hasn't sent any yet.
+// --------------------------------------------------------
+const ConstantBufferSlice* ISimpleShader::RingSlice(SimpleConstantBuffer* cb)
+{
+	if (cb->SharedBuffer)
+		return cb->SharedSlice && BufferRing && BufferRing->IsCurrent(*cb->SharedSlice) ? cb->SharedSlice.get() : 0;
+	return cb->Slice.Buffer ? &cb->Slice : 0;
+}
+
+// --------------------------------------------------------
+// Whether this is the last shader set on its stage
+// --------------------------------------------------------
+bool ISimpleShader::IsActive()
+{
+	for (ISimpleShader* active : activeShaders)
+	{
+		if (active == this)
+			return true;
+	}
+	return false;
+}
 
 // --------------------------------------------------------
 // Sets a variable by name with arbitrary data of the specified size
@@ -445,11 +754,14 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		return false;
 	}
 
-	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	// Set the data in the local data buffer, noting what
+	// changed so the next copy knows what to send
+	SimpleConstantBuffer* cb = &constantBuffers[var->ConstantBufferIndex];
+	if (memcmp(cb->LocalDataBuffer + var->ByteOffset, data, size) != 0)
+	{
+		memcpy(cb->LocalDataBuffer + var->ByteOffset, data, size);
+		cb->Dirty.Add(var->ByteOffset, size);
+	}
 
 	// Success
 	return true;
@@ -535,6 +847,95 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Looks up a variable once, so it can be set repeatedly
+// through the returned handle.  The handle is invalid if
+// the variable doesn't exist.
+// --------------------------------------------------------
+ShaderVarHandle ISimpleShader::GetVariableHandle(std::string name)
+{
+	ShaderVarHandle handle;
+	SimpleShaderVariable* var = FindVariable(name, -1);
+	if (var)
+	{
+		handle.ConstantBufferIndex = var->ConstantBufferIndex;
+		handle.ByteOffset = var->ByteOffset;
+		handle.Size = var->Size;
+	}
+	return handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable through a handle with arbitrary data of
+// the specified size
+//
+// var  - A handle from this shader's GetVariableHandle()
+// data - The data to set in the buffer
+// size - The size of the data (this must be less than or equal to the variable's size)
+//
+// Returns true if data is copied, false if the handle is
+// invalid or the data doesn't fit
+// --------------------------------------------------------
+bool ISimpleShader::SetData(ShaderVarHandle var, const void* data, unsigned int size)
+{
+	// Quietly ignore missing variables, like SetData() does
+	// when warnings are off; the name is long gone by now
+	if (!var.IsValid() || size > var.Size)
+		return false;
+
+	// Catch handles from other shaders going out of bounds
+	if (var.ConstantBufferIndex >= constantBufferCount ||
+		var.ByteOffset + size > constantBuffers[var.ConstantBufferIndex].Size)
+	{
+		if (ReportErrors)
+			LogError("SimpleShader::SetData() - Variable handle does not belong to this shader.\n");
+		return false;
+	}
+
+	SimpleConstantBuffer* cb = &constantBuffers[var.ConstantBufferIndex];
+	if (memcmp(cb->LocalDataBuffer + var.ByteOffset, data, size) != 0)
+	{
+		memcpy(cb->LocalDataBuffer + var.ByteOffset, data, size);
+		cb->Dirty.Add(var.ByteOffset, size);
+	}
+	return true;
+}
+
+bool ISimpleShader::SetInt(ShaderVarHandle var, int data) { return SetData(var, &data, sizeof(int)); }
+bool ISimpleShader::SetFloat(ShaderVarHandle var, float data) { return SetData(var, &data, sizeof(float)); }
+bool ISimpleShader::SetFloat2(ShaderVarHandle var, const DirectX::XMFLOAT2 data) { return SetData(var, &data, sizeof(float) * 2); }
+bool ISimpleShader::SetFloat3(ShaderVarHandle var, const DirectX::XMFLOAT3 data) { return SetData(var, &data, sizeof(float) * 3); }
+bool ISimpleShader::SetFloat4(ShaderVarHandle var, const DirectX::XMFLOAT4 data) { return SetData(var, &data, sizeof(float) * 4); }
+bool ISimpleShader::SetMatrix4x4(ShaderVarHandle var, const DirectX::XMFLOAT4X4 data) { return SetData(var, &data, sizeof(float) * 16); }
+
+// --------------------------------------------------------
+// Sets a variable by a name hashed at compile time (see the
+// _var literal).  A binary search on the hash replaces the
+// string hashing and allocation of the std::string version.
+// --------------------------------------------------------
+bool ISimpleShader::SetData(ShaderVarName name, const void* data, unsigned int size)
+{
+	ShaderVarHandle var = FindVariable(name);
+	if (!var.IsValid())
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::SetData() - Shader variable '");
+			Log(name.Name);
+			LogWarning("' not found. Ensure the name is spelled correctly and that it exists in a constant buffer in the shader.\n");
+		}
+		return false;
+	}
+	return SetData(var, data, size);
+}
+
+bool ISimpleShader::SetInt(ShaderVarName name, int data) { return SetData(name, &data, sizeof(int)); }
+bool ISimpleShader::SetFloat(ShaderVarName name, float data) { return SetData(name, &data, sizeof(float)); }
+bool ISimpleShader::SetFloat2(ShaderVarName name, const DirectX::XMFLOAT2 data) { return SetData(name, &data, sizeof(float) * 2); }
+bool ISimpleShader::SetFloat3(ShaderVarName name, const DirectX::XMFLOAT3 data) { return SetData(name, &data, sizeof(float) * 3); }
+bool ISimpleShader::SetFloat4(ShaderVarName name, const DirectX::XMFLOAT4 data) { return SetData(name, &data, sizeof(float) * 4); }
+bool ISimpleShader::SetMatrix4x4(ShaderVarName name, const DirectX::XMFLOAT4X4 data) { return SetData(name, &data, sizeof(float) * 16); }
+
 // --------------------------------------------------------
 // Determines if the shader contains the specified
 // variable within one of its constant buffers
@@ -691,7 +1092,7 @@ const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(unsigned int index)
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
-SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile)
+SimpleVertexShader::SimpleVertexShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile)
 	: ISimpleShader(device, context) 
 { 
 	// Ensure we set to zero to successfully trigger
@@ -708,7 +1109,7 @@ SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> devi
 // Passing in a valid input layout will stop LoadShaderFile()
 // from creating an input layout from shader reflection
 // --------------------------------------------------------
-SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile, Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout, bool perInstanceCompatible)
+SimpleVertexShader::SimpleVertexShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile, Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout, bool perInstanceCompatible)
 	: ISimpleShader(device, context)
 {
 	// Save the custom input layout
@@ -767,40 +1168,33 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
-	// matches what the vertex shader expects.  Code adapted from:
+	// reflected inputs to create an input layout that matches
+	// what the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
 
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
 	// Read input layout description from shader info
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (const ShaderReflectionData::InputParameter& paramDesc : reflection.InputParameters)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
-
 		// Check the semantic name for "_PER_INSTANCE"
 		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
+		const std::string& sem = paramDesc.SemanticName;
 		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
 		bool isPerInstance = 
 			lenDiff >= 0 &&
 			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
 
+		// And for "_BAKED" (per vertex data baked at load time,
+		// like Mesh's occlusion, kept in a stream of its own)
+		std::string bakedStr = "_BAKED";
+		int bakedLenDiff = (int)sem.size() - (int)bakedStr.size();
+		bool isBaked =
+			bakedLenDiff >= 0 &&
+			sem.compare(bakedLenDiff, bakedStr.size(), bakedStr) == 0;
+
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc = {};
-		elementDesc.SemanticName = paramDesc.SemanticName;
+		elementDesc.SemanticName = paramDesc.SemanticName.c_str();
 		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
@@ -816,31 +1210,36 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 
 			perInstanceCompatible = true;
 		}
+		else if (isBaked)
+		{
+			elementDesc.InputSlot = 2; // Baked streams come after the per instance slot
+		}
 
 		// Determine DXGI format
+		D3D_REGISTER_COMPONENT_TYPE componentType = (D3D_REGISTER_COMPONENT_TYPE)paramDesc.ComponentType;
 		if (paramDesc.Mask == 1)
 		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
+			if (componentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
+			else if (componentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
+			else if (componentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
 		}
 		else if (paramDesc.Mask <= 3)
 		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+			if (componentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
+			else if (componentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
+			else if (componentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
 		}
 		else if (paramDesc.Mask <= 7)
 		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
+			if (componentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
+			else if (componentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
+			else if (componentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
 		}
 		else if (paramDesc.Mask <= 15)
 		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+			if (componentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
+			else if (componentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
+			else if (componentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 		}
 
 		// Save element desc
@@ -873,18 +1272,23 @@ void SimpleVertexShader::SetShaderAndCBs()
 	deviceContext->VSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+	SetActive(StageVertex);
+	BindConstantBuffers();
+}
 
-		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+// --------------------------------------------------------
+// Binds one constant buffer to the vertex shader stage,
+// by offset if its data is in the ring
+// --------------------------------------------------------
+void SimpleVertexShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	const ConstantBufferSlice* slice = RingSlice(cb);
+	if (slice)
+		deviceContext->VSSetConstantBuffers1(cb->BindIndex, 1, &slice->Buffer, &slice->FirstConstant, &slice->NumConstants);
+	else if (cb->SharedBuffer)
+		deviceContext->VSSetConstantBuffers(cb->BindIndex, 1, cb->SharedBuffer.GetAddressOf());
+	else
+		deviceContext->VSSetConstantBuffers(cb->BindIndex, 1, cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -955,7 +1359,7 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
-SimplePixelShader::SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile)
+SimplePixelShader::SimplePixelShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile)
 	: ISimpleShader(device, context) 
 { 
 	// Load the actual compiled shader file
@@ -1015,18 +1419,23 @@ void SimplePixelShader::SetShaderAndCBs()
 	deviceContext->PSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+	SetActive(StagePixel);
+	BindConstantBuffers();
+}
 
-		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+// --------------------------------------------------------
+// Binds one constant buffer to the pixel shader stage,
+// by offset if its data is in the ring
+// --------------------------------------------------------
+void SimplePixelShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	const ConstantBufferSlice* slice = RingSlice(cb);
+	if (slice)
+		deviceContext->PSSetConstantBuffers1(cb->BindIndex, 1, &slice->Buffer, &slice->FirstConstant, &slice->NumConstants);
+	else if (cb->SharedBuffer)
+		deviceContext->PSSetConstantBuffers(cb->BindIndex, 1, cb->SharedBuffer.GetAddressOf());
+	else
+		deviceContext->PSSetConstantBuffers(cb->BindIndex, 1, cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -1099,7 +1508,7 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
-SimpleDomainShader::SimpleDomainShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile)
+SimpleDomainShader::SimpleDomainShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile)
 	: ISimpleShader(device, context) 
 { 
 	// Load the actual compiled shader file
@@ -1159,18 +1568,23 @@ void SimpleDomainShader::SetShaderAndCBs()
 	deviceContext->DSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+	SetActive(StageDomain);
+	BindConstantBuffers();
+}
 
-		// This is a real constant buffer, so set it
-		deviceContext->DSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+// --------------------------------------------------------
+// Binds one constant buffer to the domain shader stage,
+// by offset if its data is in the ring
+// --------------------------------------------------------
+void SimpleDomainShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	const ConstantBufferSlice* slice = RingSlice(cb);
+	if (slice)
+		deviceContext->DSSetConstantBuffers1(cb->BindIndex, 1, &slice->Buffer, &slice->FirstConstant, &slice->NumConstants);
+	else if (cb->SharedBuffer)
+		deviceContext->DSSetConstantBuffers(cb->BindIndex, 1, cb->SharedBuffer.GetAddressOf());
+	else
+		deviceContext->DSSetConstantBuffers(cb->BindIndex, 1, cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -1242,7 +1656,7 @@ bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
-SimpleHullShader::SimpleHullShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile)
+SimpleHullShader::SimpleHullShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile)
 	: ISimpleShader(device, context) 
 { 
 	// Load the actual compiled shader file
@@ -1301,19 +1715,24 @@ void SimpleHullShader::SetShaderAndCBs()
 	// Set the shader
 	deviceContext->HSSetShader(shader.Get(), 0, 0);
 
-	// Set the constant buffers?
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+	// Set the constant buffers
+	SetActive(StageHull);
+	BindConstantBuffers();
+}
 
-		// This is a real constant buffer, so set it
-		deviceContext->HSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+// --------------------------------------------------------
+// Binds one constant buffer to the hull shader stage,
+// by offset if its data is in the ring
+// --------------------------------------------------------
+void SimpleHullShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	const ConstantBufferSlice* slice = RingSlice(cb);
+	if (slice)
+		deviceContext->HSSetConstantBuffers1(cb->BindIndex, 1, &slice->Buffer, &slice->FirstConstant, &slice->NumConstants);
+	else if (cb->SharedBuffer)
+		deviceContext->HSSetConstantBuffers(cb->BindIndex, 1, cb->SharedBuffer.GetAddressOf());
+	else
+		deviceContext->HSSetConstantBuffers(cb->BindIndex, 1, cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -1386,7 +1805,7 @@ bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<
 // --------------------------------------------------------
 // Constructor calls the base and sets up potential stream-out options
 // --------------------------------------------------------
-SimpleGeometryShader::SimpleGeometryShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile, bool useStreamOut, bool allowStreamOutRasterization)
+SimpleGeometryShader::SimpleGeometryShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile, bool useStreamOut, bool allowStreamOutRasterization)
 	: ISimpleShader(device, context) 
 { 
 	this->streamOutVertexSize = 0;
@@ -1556,7 +1975,7 @@ bool SimpleGeometryShader::CreateCompatibleStreamOutBuffer(Microsoft::WRL::ComPt
 // --------------------------------------------------------
 // Helper method to unbind all stream out buffers from the SO stage
 // --------------------------------------------------------
-void SimpleGeometryShader::UnbindStreamOutStage(Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext)
+void SimpleGeometryShader::UnbindStreamOutStage(std::shared_ptr<IGraphicsContext> deviceContext)
 {
 	unsigned int offset = 0;
 	ID3D11Buffer* unset[4] = { 0, 0, 0, 0 }; // Max of 4 output targets according to  Direct3D documentation
@@ -1575,19 +1994,24 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	// Set the shader
 	deviceContext->GSSetShader(shader.Get(), 0, 0);
 
-	// Set the constant buffers?
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+	// Set the constant buffers
+	SetActive(StageGeometry);
+	BindConstantBuffers();
+}
 
-		// This is a real constant buffer, so set it
-		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+// --------------------------------------------------------
+// Binds one constant buffer to the geometry shader stage,
+// by offset if its data is in the ring
+// --------------------------------------------------------
+void SimpleGeometryShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	const ConstantBufferSlice* slice = RingSlice(cb);
+	if (slice)
+		deviceContext->GSSetConstantBuffers1(cb->BindIndex, 1, &slice->Buffer, &slice->FirstConstant, &slice->NumConstants);
+	else if (cb->SharedBuffer)
+		deviceContext->GSSetConstantBuffers(cb->BindIndex, 1, cb->SharedBuffer.GetAddressOf());
+	else
+		deviceContext->GSSetConstantBuffers(cb->BindIndex, 1, cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -1676,7 +2100,7 @@ unsigned int SimpleGeometryShader::CalcComponentCount(unsigned int mask)
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
-SimpleComputeShader::SimpleComputeShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile)
+SimpleComputeShader::SimpleComputeShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile)
 	: ISimpleShader(device, context) 
 { 
 	this->threadsTotal = 0;
@@ -1785,19 +2209,24 @@ void SimpleComputeShader::SetShaderAndCBs()
 	// Set the shader
 	deviceContext->CSSetShader(shader.Get(), 0, 0);
 
-	// Set the constant buffers?
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+	// Set the constant buffers
+	SetActive(StageCompute);
+	BindConstantBuffers();
+}
 
-		// This is a real constant buffer, so set it
-		deviceContext->CSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+// --------------------------------------------------------
+// Binds one constant buffer to the compute shader stage,
+// by offset if its data is in the ring
+// --------------------------------------------------------
+void SimpleComputeShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	const ConstantBufferSlice* slice = RingSlice(cb);
+	if (slice)
+		deviceContext->CSSetConstantBuffers1(cb->BindIndex, 1, &slice->Buffer, &slice->FirstConstant, &slice->NumConstants);
+	else if (cb->SharedBuffer)
+		deviceContext->CSSetConstantBuffers(cb->BindIndex, 1, cb->SharedBuffer.GetAddressOf());
+	else
+		deviceContext->CSSetConstantBuffers(cb->BindIndex, 1, cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
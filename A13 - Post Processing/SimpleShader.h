@@ -7,10 +7,15 @@
 #include <DirectXMath.h>
 #include <wrl/client.h>
 
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include <string>
 
+#include "ConstantBufferRing.h"
+#include "GraphicsAPI.h"
+#include "ShaderReflectionCache.h"
+
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -23,6 +28,101 @@ struct SimpleShaderVariable
 	unsigned int ConstantBufferIndex;
 };
 
+// --------------------------------------------------------
+// Where a variable lives, looked up once by name so it can
+// be set over and over without any string handling.  Only
+// valid for the shader it came from.
+// --------------------------------------------------------
+struct ShaderVarHandle
+{
+	unsigned int ConstantBufferIndex = 0;
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;		// Zero if the variable wasn't found
+	bool IsValid() const { return Size != 0; }
+};
+
+// --------------------------------------------------------
+// FNV-1a hash of a variable name, usable at compile time
+// --------------------------------------------------------
+constexpr unsigned int HashShaderVarName(const char* name, size_t length)
+{
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// A variable name that was hashed when the game was built,
+// made with the _var literal:
+//
+//   shader->SetMatrix4x4("world"_var, world);
+// --------------------------------------------------------
+struct ShaderVarName
+{
+	unsigned int Hash;
+	const char* Name;	// For warnings and hash collisions
+};
+
+consteval ShaderVarName operator""_var(const char* name, size_t length)
+{
+	return { HashShaderVarName(name, length), name };
+}
+
+// --------------------------------------------------------
+// A shader's variable under its hashed name.  The name is
+// kept so a lookup can tell a real hit from another name
+// that happens to hash the same.
+// --------------------------------------------------------
+struct ShaderVarHashEntry
+{
+	unsigned int Hash;
+	std::string Name;
+	ShaderVarHandle Handle;
+};
+
+// --------------------------------------------------------
+// The span of a constant buffer's local data written since
+// it was last sent to the GPU, as [Start, End)
+// --------------------------------------------------------
+struct DirtyRange
+{
+	unsigned int Start = 0;
+	unsigned int End = 0;
+
+	bool IsEmpty() const { return End <= Start; }
+	unsigned int Size() const { return IsEmpty() ? 0 : End - Start; }
+	void Clear() { Start = End = 0; }
+
+	void Add(unsigned int offset, unsigned int size)
+	{
+		if (size == 0) return;
+		if (IsEmpty())
+		{
+			Start = offset;
+			End = offset + size;
+			return;
+		}
+		if (offset < Start) Start = offset;
+		if (offset + size > End) End = offset + size;
+	}
+
+	// Widened to whole 16-byte constants, which is what
+	// partial constant buffer updates work in
+	DirtyRange Aligned(unsigned int bufferSize) const
+	{
+		DirtyRange aligned;
+		if (IsEmpty()) return aligned;
+		aligned.Start = Start / 16 * 16;
+		aligned.End = (End + 15) / 16 * 16;
+		if (aligned.End > bufferSize) aligned.End = bufferSize;
+		return aligned;
+	}
+};
+
 // --------------------------------------------------------
 // Contains information about a specific
 // constant buffer in a shader, as well as
@@ -37,6 +137,10 @@ struct SimpleConstantBuffer
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
 	unsigned char* LocalDataBuffer = 0;
 	std::vector<SimpleShaderVariable> Variables;
+	ConstantBufferSlice Slice;	// Where the data went in the ring, if anywhere
+	Microsoft::WRL::ComPtr<ID3D11Buffer> SharedBuffer = 0; // Bound instead of our own, if set
+	std::shared_ptr<const ConstantBufferSlice> SharedSlice; // Where the shared buffer's owner put its data, if in the ring
+	DirtyRange Dirty;			// Local data the GPU hasn't seen yet
 };
 
 // --------------------------------------------------------
@@ -63,7 +167,7 @@ struct SimpleSampler
 class ISimpleShader
 {
 public:
-	ISimpleShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	ISimpleShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context);
 	virtual ~ISimpleShader();
 
 	// Simple helpers
@@ -75,6 +179,15 @@ public:
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
 
+	// Binds an outside buffer in place of one of this shader's
+	// own (null to go back), for data shared between shaders.
+	// If its owner writes to the ring, slice says where.
+	bool SetConstantBuffer(std::string name, Microsoft::WRL::ComPtr<ID3D11Buffer> buffer, std::shared_ptr<const ConstantBufferSlice> slice = 0);
+
+	// Binds an outside buffer again on every active shader that
+	// uses it, after its owner moved the data to a new slice
+	static void RebindConstantBuffer(ID3D11Buffer* buffer);
+
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
 
@@ -89,6 +202,27 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
+	// Sets shader data through a handle, with no lookup at all
+	ShaderVarHandle GetVariableHandle(std::string name);
+	bool SetData(ShaderVarHandle var, const void* data, unsigned int size);
+
+	bool SetInt(ShaderVarHandle var, int data);
+	bool SetFloat(ShaderVarHandle var, float data);
+	bool SetFloat2(ShaderVarHandle var, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(ShaderVarHandle var, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(ShaderVarHandle var, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(ShaderVarHandle var, const DirectX::XMFLOAT4X4 data);
+
+	// Sets shader data by a name hashed at compile time
+	bool SetData(ShaderVarName name, const void* data, unsigned int size);
+
+	bool SetInt(ShaderVarName name, int data);
+	bool SetFloat(ShaderVarName name, float data);
+	bool SetFloat2(ShaderVarName name, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(ShaderVarName name, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(ShaderVarName name, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(ShaderVarName name, const DirectX::XMFLOAT4X4 data);
+
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
 	virtual bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
@@ -117,17 +251,40 @@ public:
 	
 	// Misc getters
 	Microsoft::WRL::ComPtr<ID3DBlob> GetShaderBlob() { return shaderBlob; }
+	unsigned long long GetBytecodeHash() { return bytecodeHash; }
+	const ShaderReflectionData& GetReflection() { return reflection; }
 
 	// Error reporting
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Optional per-frame allocator shared by all shaders.  When
+	// set, constant buffer data is written into slices of it
+	// instead of each shader's own buffers.
+	static std::shared_ptr<ConstantBufferRing> BufferRing;
+
+	// Instrumentation - bytes of constant data sent to the GPU
+	// by any shader (or shared buffer) since start up, and how
+	// many copies were skipped as nothing had changed
+	static unsigned long long UploadedBytes;
+	static unsigned long long SkippedUploads;
+
+	// Whether reflection results are saved beside each .cso
+	// and reused while the bytecode is unchanged, and how many
+	// shaders were reflected vs. read from those caches
+	static bool UseReflectionCache;
+	static unsigned int ReflectionCount;
+	static unsigned int ReflectionCacheHits;
+
 protected:
 	
 	bool shaderValid;
 	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
-	Microsoft::WRL::ComPtr<ID3D11Device> device;
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
+	unsigned long long bytecodeHash;
+	ShaderReflectionData reflection;
+	std::shared_ptr<IGraphicsDevice> device;
+	std::shared_ptr<IGraphicsContext> deviceContext;
+	bool partialUpdates;	// Constant buffers can be updated with a box
 
 	// Resource counts
 	unsigned int constantBufferCount;
@@ -138,20 +295,37 @@ protected:
 	std::vector<SimpleSampler*>	samplerStates;
 	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
 	std::unordered_map<std::string, SimpleShaderVariable> varTable;
+	std::vector<ShaderVarHashEntry> varHashTable; // Sorted by name hash
 	std::unordered_map<std::string, SimpleSRV*> textureTable;
 	std::unordered_map<std::string, SimpleSampler*> samplerTable;
 
-	// Initialization method
+	// Initialization methods
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	void ReflectShader();
+	void BuildTables();
 
 	// Pure virtual functions for dealing with shader types
 	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob) = 0;
 	virtual void SetShaderAndCBs() = 0;
+	virtual void BindConstantBuffer(SimpleConstantBuffer* cb) = 0;
+
+	// Constant buffer uploading and binding
+	void UploadBuffer(SimpleConstantBuffer* cb);
+	void BindConstantBuffers();
+	const ConstantBufferSlice* RingSlice(SimpleConstantBuffer* cb);
+
+	// Last shader set on each stage, so buffers can be rebound
+	// when a copy moves their data to a new slice of the ring
+	enum ShaderStage { StageVertex, StagePixel, StageDomain, StageHull, StageGeometry, StageCompute, StageCount };
+	static ISimpleShader* activeShaders[StageCount];
+	void SetActive(ShaderStage stage) { activeShaders[stage] = this; }
+	bool IsActive();
 
 	virtual void CleanUp();
 
 	// Helpers for finding data by name
 	SimpleShaderVariable* FindVariable(std::string name, int size);
+	ShaderVarHandle FindVariable(ShaderVarName name);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
 
 	// Error logging
@@ -171,8 +345,8 @@ protected:
 class SimpleVertexShader : public ISimpleShader
 {
 public:
-	SimpleVertexShader( Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
-	SimpleVertexShader( Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile, Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout, bool perInstanceCompatible);
+	SimpleVertexShader( std::shared_ptr<IGraphicsDevice> device,  std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile);
+	SimpleVertexShader( std::shared_ptr<IGraphicsDevice> device,  std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile, Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout, bool perInstanceCompatible);
 	~SimpleVertexShader();
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> GetDirectXShader() { return shader; }
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> GetInputLayout() { return inputLayout; }
@@ -187,6 +361,7 @@ protected:
 	 Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
 
@@ -197,7 +372,7 @@ protected:
 class SimplePixelShader : public ISimpleShader
 {
 public:
-	SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
+	SimplePixelShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile);
 	~SimplePixelShader();
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> GetDirectXShader() { return shader; }
 
@@ -208,6 +383,7 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
 
@@ -217,7 +393,7 @@ protected:
 class SimpleDomainShader : public ISimpleShader
 {
 public:
-	SimpleDomainShader(Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
+	SimpleDomainShader(std::shared_ptr<IGraphicsDevice> device,  std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile);
 	~SimpleDomainShader();
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> GetDirectXShader() { return shader; }
 
@@ -228,6 +404,7 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
 
@@ -237,7 +414,7 @@ protected:
 class SimpleHullShader : public ISimpleShader
 {
 public:
-	SimpleHullShader(Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
+	SimpleHullShader(std::shared_ptr<IGraphicsDevice> device,  std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile);
 	~SimpleHullShader();
 	Microsoft::WRL::ComPtr<ID3D11HullShader> GetDirectXShader() { return shader; }
 
@@ -248,6 +425,7 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11HullShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
 
@@ -257,7 +435,7 @@ protected:
 class SimpleGeometryShader : public ISimpleShader
 {
 public:
-	SimpleGeometryShader(Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile, bool useStreamOut = 0, bool allowStreamOutRasterization = 0);
+	SimpleGeometryShader(std::shared_ptr<IGraphicsDevice> device,  std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile, bool useStreamOut = 0, bool allowStreamOutRasterization = 0);
 	~SimpleGeometryShader();
 	Microsoft::WRL::ComPtr<ID3D11GeometryShader> GetDirectXShader() { return shader; }
 
@@ -266,7 +444,7 @@ public:
 
 	bool CreateCompatibleStreamOutBuffer(Microsoft::WRL::ComPtr<ID3D11Buffer> buffer, int vertexCount);
 
-	static void UnbindStreamOutStage(Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext);
+	static void UnbindStreamOutStage(std::shared_ptr<IGraphicsContext> deviceContext);
 
 protected:
 	// Shader itself
@@ -280,6 +458,7 @@ protected:
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	bool CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 
 	// Helpers
@@ -293,7 +472,7 @@ protected:
 class SimpleComputeShader : public ISimpleShader
 {
 public:
-	SimpleComputeShader(Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
+	SimpleComputeShader(std::shared_ptr<IGraphicsDevice> device,  std::shared_ptr<IGraphicsContext> context, LPCWSTR shaderFile);
 	~SimpleComputeShader();
 	Microsoft::WRL::ComPtr<ID3D11ComputeShader> GetDirectXShader() { return shader; }
 
@@ -319,5 +498,6 @@ protected:
 
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
\ No newline at end of file
@@ -1,5 +1,13 @@
 #include "Sky.h"
 
+#include <filesystem>
+#include <fstream>
+#include <stdio.h>
+#include <vector>
+
+#include "PathHelpers.h"
+#include "ShaderReflectionCache.h"
+
 using namespace DirectX;
 
 Sky::Sky(std::shared_ptr<SimpleVertexShader> vertexShader, std::shared_ptr<SimplePixelShader> pixelShader, 
@@ -21,20 +29,21 @@ Sky::Sky(std::shared_ptr<SimpleVertexShader> vertexShader, std::shared_ptr<Simpl
 	D3D11_RASTERIZER_DESC rastDesc = {};
 	rastDesc.FillMode = D3D11_FILL_SOLID;
 	rastDesc.CullMode = D3D11_CULL_FRONT;
-	Graphics::Device->CreateRasterizerState(&rastDesc, rasterizerOptions.GetAddressOf());
+	Graphics::GfxDevice->CreateRasterizerState(&rastDesc, rasterizerOptions.GetAddressOf());
 
 	// Setup Depth Options
 	D3D11_DEPTH_STENCIL_DESC depthDesc = {};
 	depthDesc.DepthEnable = true;
 	depthDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-	Graphics::Device->CreateDepthStencilState(&depthDesc, depthOptions.GetAddressOf());
+	Graphics::GfxDevice->CreateDepthStencilState(&depthDesc, depthOptions.GetAddressOf());
 }
 
-void Sky::Draw(Camera camera) {
+// View and projection come from the per frame buffer
+void Sky::Draw() {
 
 	// Change the render states
-	Graphics::Context->RSSetState(rasterizerOptions.Get());
-	Graphics::Context->OMSetDepthStencilState(depthOptions.Get(), 0);
+	Graphics::GfxContext->RSSetState(rasterizerOptions.Get());
+	Graphics::GfxContext->OMSetDepthStencilState(depthOptions.Get(), 0);
 
 	// Prepare Shaders
 	vertexShader->SetShader();
@@ -44,20 +53,12 @@ void Sky::Draw(Camera camera) {
 	pixelShader->SetShaderResourceView("SkyTexture", srv);
 	pixelShader->SetSamplerState("BasicSampler", sampler);
 
-	// Set Vertex Shader View and Projection Matrices
-	vertexShader->SetMatrix4x4("view", camera.GetViewMatrix());
-	vertexShader->SetMatrix4x4("projection", camera.GetProjectionMatrix());
-
-	// Finalize
-	pixelShader->CopyAllBufferData();
-	vertexShader->CopyAllBufferData();
-
 	// Draw Mesh
 	skyMesh->Draw();
 
 	// Reset Render States
-	Graphics::Context->RSSetState(nullptr);
-	Graphics::Context->OMSetDepthStencilState(nullptr, 0);
+	Graphics::GfxContext->RSSetState(nullptr);
+	Graphics::GfxContext->OMSetDepthStencilState(nullptr, 0);
 }
 
 // --------------------------------------------------------
@@ -85,6 +86,14 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	CreateWICTextureFromFile(Graphics::Device.Get(), down, (ID3D11Resource**)textures[3].GetAddressOf(), 0);
 	CreateWICTextureFromFile(Graphics::Device.Get(), front, (ID3D11Resource**)textures[4].GetAddressOf(), 0);
 	CreateWICTextureFromFile(Graphics::Device.Get(), back, (ID3D11Resource**)textures[5].GetAddressOf(), 0);
+
+	// Nothing loaded (missing files, or no real device when headless)
+	if (!textures[0])
+		return nullptr;
+
+	const wchar_t* files[6] = { right, left, up, down, front, back };
+	BakeEnvironment(textures, files);
+
 	// We'll assume all of the textures are the same color format and resolution,
 	// so get the description of the first texture
 	D3D11_TEXTURE2D_DESC faceDesc = {};
@@ -107,7 +116,7 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	cubeDesc.SampleDesc.Quality = 0;
 	// Create the final texture resource to hold the cube map
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
-	Graphics::Device->CreateTexture2D(&cubeDesc, 0, cubeMapTexture.GetAddressOf());
+	Graphics::GfxDevice->CreateTexture2D(&cubeDesc, 0, cubeMapTexture.GetAddressOf());
 	// Loop through the individual face textures and copy them,
 	// one at a time, to the cube map texure
 	for (int i = 0; i < 6; i++)
@@ -118,7 +127,7 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 			i, // Which array element?
 			1); // How many mip levels are in the texture?
 		// Copy from one resource (texture) to another
-		Graphics::Context->CopySubresourceRegion(
+		Graphics::GfxContext->CopySubresourceRegion(
 			cubeMapTexture.Get(), // Destination resource
 			subresource, // Dest subresource index (one of the array elements)
 			0, 0, 0, // XYZ location of copy
@@ -135,8 +144,270 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	srvDesc.TextureCube.MostDetailedMip = 0; // Index of the first mip we want to see
 	// Make the SRV
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cubeSRV;
-	Graphics::Device->CreateShaderResourceView(
+	Graphics::GfxDevice->CreateShaderResourceView(
 		cubeMapTexture.Get(), &srvDesc, cubeSRV.GetAddressOf());
 	// Send back the SRV, which is what we need for our shaders
 	return cubeSRV;
+}
+
+double Sky::GetBakeTime() const
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	return bakeTicks * 1000.0 / (double)freq.QuadPart;
+}
+
+// Bake settings.  They're part of the cache keys, so
+// changing one bakes again rather than loading stale data.
+static const unsigned int SpecularSettings[] =
+{
+	128,	// Face size of the prefiltered cubemap
+	6,		// Its mips, roughness 0 to 1 (128 down to 4)
+	256,	// GGX samples per texel
+	256,	// Largest face size the sky is decoded at to filter from
+};
+static const unsigned int BrdfLutSettings[] =
+{
+	128,	// Width and height
+	512,	// GGX samples per texel
+};
+
+// --------------------------------------------------------
+// Copies each face to a staging texture and maps it, so the
+// CPU can read what's already on the GPU.  Faces that did
+// map are filled in even on failure, for UnmapFaces().
+// --------------------------------------------------------
+static bool MapFaces(Microsoft::WRL::ComPtr<ID3D11Texture2D> textures[6], Microsoft::WRL::ComPtr<ID3D11Texture2D> staging[6], CubemapFace faces[6])
+{
+	D3D11_TEXTURE2D_DESC faceDesc = {};
+	textures[0]->GetDesc(&faceDesc);
+
+	bool bgra = false;
+	switch (faceDesc.Format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		break;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		bgra = true;
+		break;
+	default:
+		printf("Sky: can't bake lighting from format %d\n", (int)faceDesc.Format);
+		return false;
+	}
+
+	// One mip, readable by the CPU
+	D3D11_TEXTURE2D_DESC stagingDesc = faceDesc;
+	stagingDesc.MipLevels = 1;
+	stagingDesc.ArraySize = 1;
+	stagingDesc.Usage = D3D11_USAGE_STAGING;
+	stagingDesc.BindFlags = 0;
+	stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	stagingDesc.MiscFlags = 0;
+
+	for (int i = 0; i < 6; i++)
+	{
+		if (!textures[i] || FAILED(Graphics::GfxDevice->CreateTexture2D(&stagingDesc, 0, staging[i].GetAddressOf())))
+			return false;
+
+		Graphics::GfxContext->CopySubresourceRegion(staging[i].Get(), 0, 0, 0, 0, textures[i].Get(), 0, 0);
+
+		D3D11_MAPPED_SUBRESOURCE data = {};
+		if (FAILED(Graphics::GfxContext->Map(staging[i].Get(), 0, D3D11_MAP_READ, 0, &data)))
+			return false;
+
+		faces[i].Pixels = (const unsigned char*)data.pData;
+		faces[i].Width = faceDesc.Width;
+		faces[i].Height = faceDesc.Height;
+		faces[i].RowPitch = data.RowPitch;
+		faces[i].BGRA = bgra;
+	}
+	return true;
+}
+
+static void UnmapFaces(Microsoft::WRL::ComPtr<ID3D11Texture2D> staging[6], CubemapFace faces[6])
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (staging[i] && faces[i].Pixels)
+			Graphics::GfxContext->Unmap(staging[i].Get(), 0);
+		faces[i].Pixels = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Bakes everything the lighting takes from the sky:
+// - Spherical harmonics for the ambient term
+// - A prefiltered cubemap and BRDF LUT for reflections
+//
+// Each is cached on disk, keyed on the contents of all six
+// image files (the LUT only on its settings), so later runs
+// just load them.  Only a miss reads the faces back.
+// --------------------------------------------------------
+bool Sky::BakeEnvironment(Microsoft::WRL::ComPtr<ID3D11Texture2D> textures[6], const wchar_t* files[6])
+{
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+
+	// The same FNV-1a the shader caches use, over every file
+	unsigned long long key = 0;
+	for (int i = 0; i < 6; i++)
+	{
+		std::ifstream file(files[i], std::ios::binary | std::ios::ate);
+		std::streamsize size = file.is_open() ? (std::streamsize)file.tellg() : 0;
+		std::vector<char> bytes(size > 0 ? (size_t)size : 0);
+		file.seekg(0);
+		file.read(bytes.data(), bytes.size());
+		key = key * 31 + HashShaderBytecode(bytes.data(), bytes.size());
+	}
+	unsigned long long specularKey = key * 31 + HashShaderBytecode(SpecularSettings, sizeof(SpecularSettings));
+	unsigned long long lutKey = HashShaderBytecode(BrdfLutSettings, sizeof(BrdfLutSettings));
+
+	std::filesystem::path cacheFolder = FixPath(L"BakeCache");
+	std::wstring radiancePath = (cacheFolder / L"SkyRadiance.shl2").wstring();
+	std::wstring specularPath = (cacheFolder / L"SkySpecular.envc").wstring();
+	std::wstring lutPath = (cacheFolder / L"BrdfLut.brdf").wstring();
+
+	EnvironmentCubemap specular;
+	BrdfLut lut;
+	radianceCached = LoadSH(radiancePath, key, radiance);
+	// Loaded separately so a stale LUT doesn't mean baking
+	// the cubemap again, or the other way around
+	bool cubemapLoaded = LoadEnvironmentCubemap(specularPath, specularKey, specular);
+	bool lutLoaded = LoadBrdfLut(lutPath, lutKey, lut);
+	specularCached = cubemapLoaded && lutLoaded;
+	hasRadiance = radianceCached;
+
+	// Failing to write just means baking again next run
+	std::error_code error;
+	if (!radianceCached || !specularCached)
+		std::filesystem::create_directories(cacheFolder, error);
+
+	if (!radianceCached || specular.Size == 0)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> staging[6];
+		CubemapFace faces[6];
+		if (!MapFaces(textures, staging, faces))
+		{
+			UnmapFaces(staging, faces);
+			printf("Sky: couldn't read the faces back to bake lighting\n");
+			return false;
+		}
+
+		if (!radianceCached)
+		{
+			hasRadiance = ProjectCubemapSH(faces, radiance);
+			if (hasRadiance)
+				SaveSH(radiancePath, key, radiance);
+		}
+
+		EnvironmentCubemap decoded;
+		if (specular.Size == 0 && DecodeCubemap(faces, SpecularSettings[3], decoded) &&
+			PrefilterSpecular(decoded, SpecularSettings[0], SpecularSettings[1], SpecularSettings[2], specular))
+			SaveEnvironmentCubemap(specularPath, specularKey, specular);
+
+		UnmapFaces(staging, faces);
+	}
+
+	if (lut.Size == 0)
+	{
+		IntegrateBrdfLut(BrdfLutSettings[0], BrdfLutSettings[1], lut);
+		SaveBrdfLut(lutPath, lutKey, lut);
+	}
+
+	if (specular.Size > 0)
+		CreateSpecularTextures(specular, lut);
+
+	LARGE_INTEGER end;
+	QueryPerformanceCounter(&end);
+	bakeTicks = end.QuadPart - start.QuadPart;
+	return true;
+}
+
+// --------------------------------------------------------
+// Uploads the prefiltered cubemap (every mip) and the LUT as
+// immutable float textures, plus a clamping sampler so the
+// LUT's edges don't wrap into each other
+// --------------------------------------------------------
+bool Sky::CreateSpecularTextures(const EnvironmentCubemap& specular, const BrdfLut& lut)
+{
+	D3D11_TEXTURE2D_DESC cubeDesc = {};
+	cubeDesc.Width = specular.Size;
+	cubeDesc.Height = specular.Size;
+	cubeDesc.MipLevels = specular.MipCount;
+	cubeDesc.ArraySize = 6;
+	cubeDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	cubeDesc.SampleDesc.Count = 1;
+	cubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+	// Subresources go face by face, each face's mips in order,
+	// which is how EnvironmentCubemap lays them out
+	std::vector<D3D11_SUBRESOURCE_DATA> cubeData;
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int mip = 0; mip < specular.MipCount; mip++)
+		{
+			D3D11_SUBRESOURCE_DATA data = {};
+			data.pSysMem = specular.Texel(face, mip);
+			data.SysMemPitch = specular.MipSize(mip) * 4 * sizeof(float);
+			cubeData.push_back(data);
+		}
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC cubeSRVDesc = {};
+	cubeSRVDesc.Format = cubeDesc.Format;
+	cubeSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	cubeSRVDesc.TextureCube.MipLevels = specular.MipCount;
+
+	D3D11_TEXTURE2D_DESC lutDesc = {};
+	lutDesc.Width = lut.Size;
+	lutDesc.Height = lut.Size;
+	lutDesc.MipLevels = 1;
+	lutDesc.ArraySize = 1;
+	lutDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+	lutDesc.SampleDesc.Count = 1;
+	lutDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	lutDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA lutData = {};
+	lutData.pSysMem = lut.Texels.data();
+	lutData.SysMemPitch = lut.Size * 2 * sizeof(float);
+
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeTexture;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> lutTexture;
+	if (FAILED(Graphics::GfxDevice->CreateTexture2D(&cubeDesc, cubeData.data(), cubeTexture.GetAddressOf())) ||
+		FAILED(Graphics::GfxDevice->CreateShaderResourceView(cubeTexture.Get(), &cubeSRVDesc, specularSRV.GetAddressOf())) ||
+		FAILED(Graphics::GfxDevice->CreateTexture2D(&lutDesc, &lutData, lutTexture.GetAddressOf())) ||
+		FAILED(Graphics::GfxDevice->CreateShaderResourceView(lutTexture.Get(), 0, brdfLutSRV.GetAddressOf())) ||
+		FAILED(Graphics::GfxDevice->CreateSamplerState(&samplerDesc, environmentSampler.GetAddressOf())))
+	{
+		printf("Sky: couldn't create the reflection textures\n");
+		specularSRV.Reset();
+		brdfLutSRV.Reset();
+		return false;
+	}
+
+	specularMips = specular.MipCount;
+	return true;
+}
+
+bool Sky::BindEnvironmentTo(std::shared_ptr<ISimpleShader> shader)
+{
+	if (!shader || !specularSRV)
+		return false;
+
+	shader->SetShaderResourceView("SpecularEnvironment", specularSRV);
+	shader->SetShaderResourceView("BrdfLut", brdfLutSRV);
+	shader->SetSamplerState("EnvironmentSampler", environmentSampler);
+	return true;
 }
\ No newline at end of file
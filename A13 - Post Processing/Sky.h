@@ -8,6 +8,8 @@
 #include "WICTextureLoader.h"
 #include "Graphics.h"
 #include "Camera.h"
+#include "EnvironmentPrefilter.h"
+#include "SphericalHarmonics.h"
 
 class Sky {
 public:
@@ -20,7 +22,7 @@ public:
 		const wchar_t* front,
 		const wchar_t* back);
 
-	void Draw(Camera camera);
+	void Draw();
 
 	// Helper for creating a cubemap from 6 individual textures
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
@@ -31,7 +33,45 @@ public:
 		const wchar_t* front,
 		const wchar_t* back);
 
+	// --------------------------------------------------------
+	// The sky's radiance as spherical harmonics, baked from the
+	// faces when the cubemap was made (or loaded from the bake
+	// cache if the images haven't changed).  Not there when the
+	// faces didn't load or aren't a format the bake reads.
+	// --------------------------------------------------------
+	bool HasRadianceSH() const { return hasRadiance; }
+	const SHL2& GetRadianceSH() const { return radiance; }
+	bool WasRadianceCached() const { return radianceCached; }
+
+	// --------------------------------------------------------
+	// Reflections: the sky prefiltered for each roughness (one
+	// per mip) and the BRDF LUT that goes with it, baked and
+	// cached alongside the harmonics.  BindEnvironmentTo()
+	// hands them to a SPECULAR_IBL variant of the lighting
+	// shader, and returns false if there's nothing to bind.
+	// --------------------------------------------------------
+	bool HasSpecularEnvironment() const { return specularSRV.Get() != 0; }
+	bool WasSpecularCached() const { return specularCached; }
+	unsigned int GetSpecularMipCount() const { return specularMips; }
+	bool BindEnvironmentTo(std::shared_ptr<ISimpleShader> shader);
+
+	double GetBakeTime() const;	// Milliseconds, including the read back
+
 private:
+	bool BakeEnvironment(Microsoft::WRL::ComPtr<ID3D11Texture2D> textures[6], const wchar_t* files[6]);
+	bool CreateSpecularTextures(const EnvironmentCubemap& specular, const BrdfLut& lut);
+
+	SHL2 radiance;
+	bool hasRadiance = false;
+	bool radianceCached = false;
+	bool specularCached = false;
+	unsigned int specularMips = 0;
+	long long bakeTicks = 0;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> specularSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> brdfLutSRV;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> environmentSampler;
+
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depthOptions;
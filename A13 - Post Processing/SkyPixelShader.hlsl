@@ -7,5 +7,6 @@ SamplerState SkySampler : register(s0);
 
 float4 main(SkyVertexToPixel input) : SV_TARGET
 {
-       return SkyTexture.Sample(SkySampler, input.sampleDir);
+       // The faces are gamma corrected, and the scene is linear
+       return float4(pow(SkyTexture.Sample(SkySampler, input.sampleDir).rgb, 2.2f), 1);
 }
\ No newline at end of file
@@ -1,11 +1,7 @@
 
 #include "GGPShadersInclude.hlsli"
 
-cbuffer ExternalData : register(b0)
-{
-    matrix view;
-    matrix projection;
-};
+// View and projection come from PerFrame in the include
 
 SkyVertexToPixel main(VertexShaderInput input)
 {
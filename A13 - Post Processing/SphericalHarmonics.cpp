@@ -0,0 +1,348 @@
+#include "SphericalHarmonics.h"
+
+#include <atomic>
+#include <emmintrin.h>
+#include <filesystem>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	// Basis constants, band by band
+	const float SH0 = 0.282095f;	// 1 / (2 sqrt(pi))
+	const float SH1 = 0.488603f;	// sqrt(3) / (2 sqrt(pi))
+	const float SH2 = 1.092548f;	// sqrt(15) / (2 sqrt(pi))
+	const float SH3 = 0.315392f;	// sqrt(5) / (4 sqrt(pi))
+	const float SH4 = 0.546274f;	// sqrt(15) / (4 sqrt(pi))
+
+	// --------------------------------------------------------
+	// The axes of each face: a texel at (u, v), both -1 to 1
+	// from the top left, points along U * u + V * v + W
+	// --------------------------------------------------------
+	struct FaceAxes
+	{
+		float U[3], V[3], W[3];
+	};
+
+	const FaceAxes Axes[6] =
+	{
+		{ {  0, 0, -1 }, { 0, -1,  0 }, {  1,  0,  0 } },	// +X
+		{ {  0, 0,  1 }, { 0, -1,  0 }, { -1,  0,  0 } },	// -X
+		{ {  1, 0,  0 }, { 0,  0,  1 }, {  0,  1,  0 } },	// +Y
+		{ {  1, 0,  0 }, { 0,  0, -1 }, {  0, -1,  0 } },	// -Y
+		{ {  1, 0,  0 }, { 0, -1,  0 }, {  0,  0,  1 } },	// +Z
+		{ { -1, 0,  0 }, { 0, -1,  0 }, {  0,  0, -1 } },	// -Z
+	};
+
+	// One thread's running totals: 27 coefficients and the
+	// solid angle they were weighted by
+	struct Sums
+	{
+		double Coefficients[9][3] = {};
+		double Weight = 0;
+	};
+
+	float HorizontalSum(__m128 v)
+	{
+		__m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(v, shuffled);
+		shuffled = _mm_movehl_ps(shuffled, sums);
+		return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+	}
+
+	// --------------------------------------------------------
+	// Adds one row of a face, four texels at a time.  Each
+	// texel is weighted by the solid angle it covers, which
+	// shrinks toward the face's edges and corners.
+	// --------------------------------------------------------
+	void ProjectRow(const CubemapFace& face, const FaceAxes& axes, unsigned int y, const float toLinear[256], Sums& sums)
+	{
+		const unsigned char* row = face.Pixels + (size_t)y * face.RowPitch;
+		const int red = face.BGRA ? 2 : 0;
+		const int blue = face.BGRA ? 0 : 2;
+
+		float texelSize = 2.0f / face.Width;
+		float v = (y + 0.5f) * (2.0f / face.Height) - 1.0f;
+		float texelArea = texelSize * (2.0f / face.Height);
+
+		// Everything that's constant along the row
+		__m128 base[3];
+		__m128 uAxis[3];
+		for (int i = 0; i < 3; i++)
+		{
+			base[i] = _mm_set1_ps(axes.V[i] * v + axes.W[i]);
+			uAxis[i] = _mm_set1_ps(axes.U[i]);
+		}
+		__m128 vSquaredPlusOne = _mm_set1_ps(v * v + 1.0f);
+		__m128 area = _mm_set1_ps(texelArea);
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 three = _mm_set1_ps(3.0f);
+
+		__m128 totals[9][3];
+		for (int c = 0; c < 9; c++)
+			for (int ch = 0; ch < 3; ch++)
+				totals[c][ch] = _mm_setzero_ps();
+		__m128 totalWeight = _mm_setzero_ps();
+
+		for (unsigned int x = 0; x < face.Width; x += 4)
+		{
+			// Linear colors and u for the next four texels, with
+			// zero weight for any past the end of the row
+			alignas(16) float r[4], g[4], b[4], u[4], mask[4];
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				unsigned int px = x + i < face.Width ? x + i : face.Width - 1;
+				const unsigned char* texel = row + (size_t)px * 4;
+				r[i] = toLinear[texel[red]];
+				g[i] = toLinear[texel[1]];
+				b[i] = toLinear[texel[blue]];
+				u[i] = (x + i + 0.5f) * texelSize - 1.0f;
+				mask[i] = x + i < face.Width ? 1.0f : 0.0f;
+			}
+			__m128 uu = _mm_load_ps(u);
+
+			// 1 + u^2 + v^2 is the squared distance to the texel
+			__m128 lengthSquared = _mm_add_ps(vSquaredPlusOne, _mm_mul_ps(uu, uu));
+			__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+			__m128 weight = _mm_mul_ps(_mm_mul_ps(area, _mm_load_ps(mask)),
+				_mm_mul_ps(invLength, _mm_div_ps(one, lengthSquared)));
+
+			__m128 dx = _mm_mul_ps(_mm_add_ps(base[0], _mm_mul_ps(uAxis[0], uu)), invLength);
+			__m128 dy = _mm_mul_ps(_mm_add_ps(base[1], _mm_mul_ps(uAxis[1], uu)), invLength);
+			__m128 dz = _mm_mul_ps(_mm_add_ps(base[2], _mm_mul_ps(uAxis[2], uu)), invLength);
+
+			__m128 basis[9];
+			basis[0] = _mm_set1_ps(SH0);
+			basis[1] = _mm_mul_ps(_mm_set1_ps(SH1), dy);
+			basis[2] = _mm_mul_ps(_mm_set1_ps(SH1), dz);
+			basis[3] = _mm_mul_ps(_mm_set1_ps(SH1), dx);
+			basis[4] = _mm_mul_ps(_mm_set1_ps(SH2), _mm_mul_ps(dx, dy));
+			basis[5] = _mm_mul_ps(_mm_set1_ps(SH2), _mm_mul_ps(dy, dz));
+			basis[6] = _mm_mul_ps(_mm_set1_ps(SH3), _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(dz, dz)), one));
+			basis[7] = _mm_mul_ps(_mm_set1_ps(SH2), _mm_mul_ps(dx, dz));
+			basis[8] = _mm_mul_ps(_mm_set1_ps(SH4), _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+			__m128 color[3] =
+			{
+				_mm_mul_ps(_mm_load_ps(r), weight),
+				_mm_mul_ps(_mm_load_ps(g), weight),
+				_mm_mul_ps(_mm_load_ps(b), weight),
+			};
+			for (int c = 0; c < 9; c++)
+				for (int ch = 0; ch < 3; ch++)
+					totals[c][ch] = _mm_add_ps(totals[c][ch], _mm_mul_ps(basis[c], color[ch]));
+			totalWeight = _mm_add_ps(totalWeight, weight);
+		}
+
+		// Rows are short enough for float; faces aren't, so the
+		// running totals are doubles
+		for (int c = 0; c < 9; c++)
+			for (int ch = 0; ch < 3; ch++)
+				sums.Coefficients[c][ch] += HorizontalSum(totals[c][ch]);
+		sums.Weight += HorizontalSum(totalWeight);
+	}
+}
+
+void CubemapDirection(unsigned int face, float u, float v, float dir[3])
+{
+	const FaceAxes& axes = Axes[face];
+	for (int i = 0; i < 3; i++)
+		dir[i] = axes.U[i] * u + axes.V[i] * v + axes.W[i];
+
+	float invLength = 1.0f / sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+	for (int i = 0; i < 3; i++)
+		dir[i] *= invLength;
+}
+
+// --------------------------------------------------------
+// The face is the largest component's; projecting onto that
+// face's axes, over the distance along it, gives u and v
+// --------------------------------------------------------
+unsigned int CubemapFaceUV(const float dir[3], float& u, float& v)
+{
+	float ax = fabsf(dir[0]);
+	float ay = fabsf(dir[1]);
+	float az = fabsf(dir[2]);
+
+	unsigned int face;
+	if (ax >= ay && ax >= az)
+		face = dir[0] >= 0 ? 0 : 1;
+	else if (ay >= az)
+		face = dir[1] >= 0 ? 2 : 3;
+	else
+		face = dir[2] >= 0 ? 4 : 5;
+
+	const FaceAxes& axes = Axes[face];
+	float w = dir[0] * axes.W[0] + dir[1] * axes.W[1] + dir[2] * axes.W[2];
+	u = (dir[0] * axes.U[0] + dir[1] * axes.U[1] + dir[2] * axes.U[2]) / w;
+	v = (dir[0] * axes.V[0] + dir[1] * axes.V[1] + dir[2] * axes.V[2]) / w;
+	return face;
+}
+
+void EvaluateSHBasis(float x, float y, float z, float basis[9])
+{
+	basis[0] = SH0;
+	basis[1] = SH1 * y;
+	basis[2] = SH1 * z;
+	basis[3] = SH1 * x;
+	basis[4] = SH2 * x * y;
+	basis[5] = SH2 * y * z;
+	basis[6] = SH3 * (3.0f * z * z - 1.0f);
+	basis[7] = SH2 * x * z;
+	basis[8] = SH4 * (x * x - y * y);
+}
+
+void EvaluateSH(const SHL2& sh, float x, float y, float z, float rgb[3])
+{
+	float basis[9];
+	EvaluateSHBasis(x, y, z, basis);
+
+	rgb[0] = rgb[1] = rgb[2] = 0.0f;
+	for (int c = 0; c < 9; c++)
+		for (int ch = 0; ch < 3; ch++)
+			rgb[ch] += sh.Coefficients[c][ch] * basis[c];
+}
+
+bool ProjectCubemapSH(const CubemapFace faces[6], SHL2& radiance, unsigned int threadCount)
+{
+	unsigned int size = faces[0].Width;
+	for (int f = 0; f < 6; f++)
+	{
+		if (!faces[f].Pixels || faces[f].Width != size || faces[f].Height != size ||
+			faces[f].RowPitch < size * 4)
+			return false;
+	}
+	if (size == 0)
+		return false;
+
+	float toLinear[256];
+	for (int i = 0; i < 256; i++)
+		toLinear[i] = powf(i / 255.0f, 2.2f);
+
+	// Threads take the next row (of any face) until there are
+	// none left, each keeping its own totals
+	unsigned int rowCount = 6 * size;
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+	if (threadCount > rowCount)
+		threadCount = rowCount;
+
+	std::vector<Sums> threadSums(threadCount);
+	std::atomic<unsigned int> nextRow(0);
+	auto work = [&](unsigned int thread)
+	{
+		Sums& sums = threadSums[thread];
+		for (unsigned int row = nextRow++; row < rowCount; row = nextRow++)
+		{
+			unsigned int face = row / size;
+			ProjectRow(faces[face], Axes[face], row % size, toLinear, sums);
+		}
+	};
+
+	// This thread does its share too
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < threadCount; i++)
+		threads.emplace_back(work, i);
+	work(0);
+	for (std::thread& thread : threads)
+		thread.join();
+
+	Sums total;
+	for (const Sums& sums : threadSums)
+	{
+		for (int c = 0; c < 9; c++)
+			for (int ch = 0; ch < 3; ch++)
+				total.Coefficients[c][ch] += sums.Coefficients[c][ch];
+		total.Weight += sums.Weight;
+	}
+
+	// The texel solid angles only approximately add up to the
+	// whole sphere, so scale them so they do exactly
+	double scale = 4.0 * Pi / total.Weight;
+	for (int c = 0; c < 9; c++)
+		for (int ch = 0; ch < 3; ch++)
+			radiance.Coefficients[c][ch] = (float)(total.Coefficients[c][ch] * scale);
+	return true;
+}
+
+SHL2 ProjectConstantSH(float r, float g, float b)
+{
+	// Only Y00 is non-zero; its integral over the sphere is
+	// 4 pi * SH0, which is 2 sqrt(pi)
+	float scale = 4.0f * Pi * SH0;
+
+	SHL2 sh;
+	sh.Coefficients[0][0] = r * scale;
+	sh.Coefficients[0][1] = g * scale;
+	sh.Coefficients[0][2] = b * scale;
+	return sh;
+}
+
+// --------------------------------------------------------
+// The clamped cosine's own coefficients per band are pi,
+// 2 pi / 3 and pi / 4 (then nothing worth keeping past 2).
+// Dividing by pi for a Lambertian surface leaves these.
+// --------------------------------------------------------
+SHL2 ConvolveIrradianceSH(const SHL2& radiance)
+{
+	const float bandScale[9] =
+	{
+		1.0f,
+		2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f,
+		0.25f, 0.25f, 0.25f, 0.25f, 0.25f,
+	};
+
+	SHL2 irradiance;
+	for (int c = 0; c < 9; c++)
+		for (int ch = 0; ch < 3; ch++)
+			irradiance.Coefficients[c][ch] = radiance.Coefficients[c][ch] * bandScale[c];
+	return irradiance;
+}
+
+// --------------------------------------------------------
+// File layout: "SHL2", a version, the key, then the 27
+// floats.  Anything else (old version, different key, short
+// file) is a miss and the caller bakes again.
+// --------------------------------------------------------
+static const unsigned int SHCacheVersion = 1;
+
+bool SaveSH(const std::wstring& path, unsigned long long key, const SHL2& sh)
+{
+	std::ofstream file(std::filesystem::path(path), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write("SHL2", 4);
+	file.write((const char*)&SHCacheVersion, sizeof(SHCacheVersion));
+	file.write((const char*)&key, sizeof(key));
+	file.write((const char*)sh.Coefficients, sizeof(sh.Coefficients));
+	return file.good();
+}
+
+bool LoadSH(const std::wstring& path, unsigned long long key, SHL2& sh)
+{
+	std::ifstream file(std::filesystem::path(path), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	char magic[4] = {};
+	unsigned int version = 0;
+	unsigned long long fileKey = 0;
+	SHL2 loaded;
+	file.read(magic, 4);
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&fileKey, sizeof(fileKey));
+	file.read((char*)loaded.Coefficients, sizeof(loaded.Coefficients));
+	if (!file.good() || memcmp(magic, "SHL2", 4) != 0 || version != SHCacheVersion || fileKey != key)
+		return false;
+
+	sh = loaded;
+	return true;
+}
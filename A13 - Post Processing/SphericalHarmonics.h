@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+
+// --------------------------------------------------------
+// Nine RGB coefficients of the real spherical harmonics up
+// to band 2, in the usual order:
+//   Y00, Y1-1 (y), Y10 (z), Y11 (x),
+//   Y2-2 (xy), Y2-1 (yz), Y20 (3z^2 - 1), Y21 (xz), Y22 (x^2 - y^2)
+//
+// Enough to hold the diffuse light from an environment to
+// within a few percent, since the cosine lobe it's blurred
+// by is almost entirely in these bands.
+// --------------------------------------------------------
+struct SHL2
+{
+	float Coefficients[9][3] = {};
+};
+
+// --------------------------------------------------------
+// One face of a cubemap as 8-bit RGBA (or BGRA) pixels,
+// gamma encoded with the same 2.2 power the shaders use
+// --------------------------------------------------------
+struct CubemapFace
+{
+	const unsigned char* Pixels = 0;
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	unsigned int RowPitch = 0;	// Bytes from one row to the next
+	bool BGRA = false;
+};
+
+// --------------------------------------------------------
+// Where cubemap texels point.  Faces are numbered +X, -X,
+// +Y, -Y, +Z, -Z, as D3D lays them out, and u and v run
+// from -1 to 1 across a face starting at its top left.
+// --------------------------------------------------------
+void CubemapDirection(unsigned int face, float u, float v, float dir[3]);	// Unit length
+unsigned int CubemapFaceUV(const float dir[3], float& u, float& v);		// Returns the face
+
+// The basis functions for a unit direction
+void EvaluateSHBasis(float x, float y, float z, float basis[9]);
+
+// Radiance from a direction, for coefficients made by
+// ProjectCubemapSH() or ProjectConstantSH()
+void EvaluateSH(const SHL2& sh, float x, float y, float z, float rgb[3]);
+
+// --------------------------------------------------------
+// Projects a cubemap's radiance (linear, after undoing the
+// 2.2 gamma) onto the basis.  Faces are +X, -X, +Y, -Y, +Z,
+// -Z, as D3D lays them out.  Rows are spread over
+// threadCount threads (0 for one per core) and summed four
+// texels at a time with SSE.
+//
+// Returns false if the faces aren't square and the same size
+// --------------------------------------------------------
+bool ProjectCubemapSH(const CubemapFace faces[6], SHL2& radiance, unsigned int threadCount = 0);
+
+// The same color from every direction
+SHL2 ProjectConstantSH(float r, float g, float b);
+
+// --------------------------------------------------------
+// Convolves radiance with the cosine lobe and divides by pi,
+// so evaluating the result for a normal gives the light a
+// white Lambertian surface facing that way reflects.  A
+// constant environment of 1 comes back as 1 everywhere.
+// --------------------------------------------------------
+SHL2 ConvolveIrradianceSH(const SHL2& radiance);
+
+// Coefficients kept on disk under a key (a hash of whatever
+// they were made from); loading fails if the key differs
+bool SaveSH(const std::wstring& path, unsigned long long key, const SHL2& sh);
+bool LoadSH(const std::wstring& path, unsigned long long key, SHL2& sh);
@@ -0,0 +1,765 @@
+#include "StateCache.h"
+
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ STATS ---------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long long StateCacheStats::TotalHits() const
+{
+	unsigned long long total = 0;
+	for (size_t i = 0; i < (size_t)GraphicsCall::Count; i++)
+		total += Hits[i];
+	return total;
+}
+
+unsigned long long StateCacheStats::TotalMisses() const
+{
+	unsigned long long total = 0;
+	for (size_t i = 0; i < (size_t)GraphicsCall::Count; i++)
+		total += Misses[i];
+	return total;
+}
+
+unsigned long long StateCacheStats::TotalForwarded() const
+{
+	unsigned long long total = 0;
+	for (size_t i = 0; i < (size_t)GraphicsCall::Count; i++)
+		total += Forwarded[i];
+	return total;
+}
+
+void StateCacheStats::Reset()
+{
+	for (size_t i = 0; i < (size_t)GraphicsCall::Count; i++)
+	{
+		Hits[i] = 0;
+		Misses[i] = 0;
+		Forwarded[i] = 0;
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ SET UP --------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+StateCacheContext::StateCacheContext(std::shared_ptr<IGraphicsContext> context, std::shared_ptr<StateCacheStats> stats) :
+	context(context),
+	stats(stats),
+	enabled(true),
+	inputLayout(0),
+	topology(D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED),
+	vertexBuffers(),
+	indexBuffer(0),
+	indexFormat(DXGI_FORMAT_UNKNOWN),
+	indexOffset(0),
+	rasterizerState(0),
+	viewports(),
+	viewportCount(0),
+	renderTargets(),
+	renderTargetCount(0),
+	depthStencilView(0),
+	depthStencilState(0),
+	stencilRef(0),
+	blendState(0),
+	blendFactor(),
+	sampleMask(0)
+{
+	Invalidate();
+}
+
+// --------------------------------------------------------
+// Turns filtering on or off.  Anything staged is sent first,
+// and the shadow state is dropped when turning back on since
+// calls went through unchecked in the meantime.
+// --------------------------------------------------------
+void StateCacheContext::SetEnabled(bool enable)
+{
+	if (enable == enabled)
+		return;
+
+	if (enabled)
+		FlushAll();
+	else
+		Invalidate();
+
+	enabled = enable;
+}
+
+// --------------------------------------------------------
+// Forgets all shadowed state.  Staged slots are sent first,
+// so nothing that was asked for gets lost.
+// --------------------------------------------------------
+void StateCacheContext::Invalidate()
+{
+	FlushAll();
+
+	for (StageState& stage : stages)
+	{
+		stage.ShaderKnown = false;
+		stage.ConstantBuffers.Forget();
+		stage.ShaderResources.Forget();
+		stage.Samplers.Forget();
+	}
+
+	for (VertexBufferSlot& slot : vertexBuffers)
+		slot.Known = false;
+
+	inputLayoutKnown = false;
+	topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	indexBufferKnown = false;
+	rasterizerStateKnown = false;
+	viewportsKnown = false;
+	renderTargetsKnown = false;
+	depthStencilStateKnown = false;
+	blendStateKnown = false;
+}
+
+// --------------------------------------------------------
+// Forgets which render targets are bound.  Flip model swap
+// chains unbind the back buffer during Present(), so this
+// must be called after every present.
+// --------------------------------------------------------
+void StateCacheContext::InvalidateRenderTargets()
+{
+	renderTargetsKnown = false;
+}
+
+// --------------------------------------------------------
+// Forgets which constant buffers are bound.  Code that goes
+// around this context and restores buffers with the old
+// calls (ImGui) resets offset bindings to whole buffers.
+// --------------------------------------------------------
+void StateCacheContext::InvalidateConstantBuffers()
+{
+	for (StageState& stage : stages)
+		stage.ConstantBuffers.Forget();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ HELPERS -------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+void StateCacheContext::Record(GraphicsCall call, bool changed)
+{
+	if (changed)
+		stats->Misses[(size_t)call]++;
+	else
+		stats->Hits[(size_t)call]++;
+}
+
+void StateCacheContext::Forwarded(GraphicsCall call)
+{
+	stats->Forwarded[(size_t)call]++;
+}
+
+// --------------------------------------------------------
+// Decides whether a SetShader call needs to go through.
+// Class instances aren't tracked, so calls with any are
+// always forwarded.
+// --------------------------------------------------------
+bool StateCacheContext::SetShader(Stage stage, GraphicsCall call, ID3D11DeviceChild* shader, UINT numClassInstances)
+{
+	StageState& state = stages[stage];
+	bool changed = !state.ShaderKnown || state.Shader != shader || numClassInstances > 0;
+	Record(call, changed);
+
+	if (changed)
+	{
+		state.Shader = shader;
+		state.ShaderKnown = numClassInstances == 0;
+		Forwarded(call);
+	}
+	return changed;
+}
+
+// --------------------------------------------------------
+// Sends one stage's staged constant buffers, SRVs and
+// samplers on to the real context
+// --------------------------------------------------------
+void StateCacheContext::FlushStage(Stage stage)
+{
+	StageState& state = stages[stage];
+
+	state.ConstantBuffers.Flush([&](UINT start, UINT count, ID3D11Buffer* const* buffers, const UINT* first, const UINT* num)
+		{
+			// Whole buffers go out the old way, so a trace or
+			// context without 11.1 support sees nothing new
+			switch (stage)
+			{
+			case StageVS:
+				if (first) { context->VSSetConstantBuffers1(start, count, buffers, first, num); Forwarded(GraphicsCall::VSSetConstantBuffers1); }
+				else { context->VSSetConstantBuffers(start, count, buffers); Forwarded(GraphicsCall::VSSetConstantBuffers); }
+				break;
+			case StagePS:
+				if (first) { context->PSSetConstantBuffers1(start, count, buffers, first, num); Forwarded(GraphicsCall::PSSetConstantBuffers1); }
+				else { context->PSSetConstantBuffers(start, count, buffers); Forwarded(GraphicsCall::PSSetConstantBuffers); }
+				break;
+			case StageDS:
+				if (first) { context->DSSetConstantBuffers1(start, count, buffers, first, num); Forwarded(GraphicsCall::DSSetConstantBuffers1); }
+				else { context->DSSetConstantBuffers(start, count, buffers); Forwarded(GraphicsCall::DSSetConstantBuffers); }
+				break;
+			case StageHS:
+				if (first) { context->HSSetConstantBuffers1(start, count, buffers, first, num); Forwarded(GraphicsCall::HSSetConstantBuffers1); }
+				else { context->HSSetConstantBuffers(start, count, buffers); Forwarded(GraphicsCall::HSSetConstantBuffers); }
+				break;
+			case StageGS:
+				if (first) { context->GSSetConstantBuffers1(start, count, buffers, first, num); Forwarded(GraphicsCall::GSSetConstantBuffers1); }
+				else { context->GSSetConstantBuffers(start, count, buffers); Forwarded(GraphicsCall::GSSetConstantBuffers); }
+				break;
+			case StageCS:
+				if (first) { context->CSSetConstantBuffers1(start, count, buffers, first, num); Forwarded(GraphicsCall::CSSetConstantBuffers1); }
+				else { context->CSSetConstantBuffers(start, count, buffers); Forwarded(GraphicsCall::CSSetConstantBuffers); }
+				break;
+			default: break;
+			}
+		});
+
+	state.ShaderResources.Flush([&](UINT start, UINT count, ID3D11ShaderResourceView* const* views)
+		{
+			switch (stage)
+			{
+			case StageVS: context->VSSetShaderResources(start, count, views); Forwarded(GraphicsCall::VSSetShaderResources); break;
+			case StagePS: context->PSSetShaderResources(start, count, views); Forwarded(GraphicsCall::PSSetShaderResources); break;
+			case StageDS: context->DSSetShaderResources(start, count, views); Forwarded(GraphicsCall::DSSetShaderResources); break;
+			case StageHS: context->HSSetShaderResources(start, count, views); Forwarded(GraphicsCall::HSSetShaderResources); break;
+			case StageGS: context->GSSetShaderResources(start, count, views); Forwarded(GraphicsCall::GSSetShaderResources); break;
+			case StageCS: context->CSSetShaderResources(start, count, views); Forwarded(GraphicsCall::CSSetShaderResources); break;
+			default: break;
+			}
+		});
+
+	state.Samplers.Flush([&](UINT start, UINT count, ID3D11SamplerState* const* samplers)
+		{
+			switch (stage)
+			{
+			case StageVS: context->VSSetSamplers(start, count, samplers); Forwarded(GraphicsCall::VSSetSamplers); break;
+			case StagePS: context->PSSetSamplers(start, count, samplers); Forwarded(GraphicsCall::PSSetSamplers); break;
+			case StageDS: context->DSSetSamplers(start, count, samplers); Forwarded(GraphicsCall::DSSetSamplers); break;
+			case StageHS: context->HSSetSamplers(start, count, samplers); Forwarded(GraphicsCall::HSSetSamplers); break;
+			case StageGS: context->GSSetSamplers(start, count, samplers); Forwarded(GraphicsCall::GSSetSamplers); break;
+			case StageCS: context->CSSetSamplers(start, count, samplers); Forwarded(GraphicsCall::CSSetSamplers); break;
+			default: break;
+			}
+		});
+}
+
+void StateCacheContext::FlushAll()
+{
+	for (int stage = 0; stage < StageCount; stage++)
+		FlushStage((Stage)stage);
+}
+
+// --------------------------------------------------------
+// Binding something as an output makes D3D silently unbind
+// it from every input slot, so any non-null SRV we think is
+// bound might not be anymore
+// --------------------------------------------------------
+void StateCacheContext::ForgetShaderResources()
+{
+	for (StageState& stage : stages)
+		stage.ShaderResources.ForgetBound();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ INPUT ASSEMBLER -----------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+void StateCacheContext::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	if (!enabled) { context->IASetInputLayout(inputLayout); return; }
+
+	bool changed = !inputLayoutKnown || this->inputLayout != inputLayout;
+	Record(GraphicsCall::IASetInputLayout, changed);
+	if (!changed)
+		return;
+
+	this->inputLayout = inputLayout;
+	inputLayoutKnown = true;
+	context->IASetInputLayout(inputLayout);
+	Forwarded(GraphicsCall::IASetInputLayout);
+}
+
+void StateCacheContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	if (!enabled) { context->IASetPrimitiveTopology(topology); return; }
+
+	// Undefined doubles as "unknown"
+	bool changed = this->topology == D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED || this->topology != topology;
+	Record(GraphicsCall::IASetPrimitiveTopology, changed);
+	if (!changed)
+		return;
+
+	this->topology = topology;
+	context->IASetPrimitiveTopology(topology);
+	Forwarded(GraphicsCall::IASetPrimitiveTopology);
+}
+
+// --------------------------------------------------------
+// Vertex buffers are filtered right away (meshes only ever
+// bind one), trimming the call down to the slots that
+// actually changed
+// --------------------------------------------------------
+void StateCacheContext::IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	if (!enabled || startSlot + numBuffers > D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT)
+	{
+		context->IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+		return;
+	}
+
+	UINT first = numBuffers;
+	UINT last = 0;
+	for (UINT i = 0; i < numBuffers; i++)
+	{
+		VertexBufferSlot& slot = vertexBuffers[startSlot + i];
+		ID3D11Buffer* buffer = buffers ? buffers[i] : 0;
+		UINT stride = strides ? strides[i] : 0;
+		UINT offset = offsets ? offsets[i] : 0;
+		if (slot.Known && slot.Buffer == buffer && slot.Stride == stride && slot.Offset == offset)
+			continue;
+
+		slot.Buffer = buffer;
+		slot.Stride = stride;
+		slot.Offset = offset;
+		slot.Known = true;
+		if (i < first) first = i;
+		last = i;
+	}
+
+	bool changed = first < numBuffers;
+	Record(GraphicsCall::IASetVertexBuffers, changed);
+	if (!changed)
+		return;
+
+	context->IASetVertexBuffers(startSlot + first, last - first + 1,
+		buffers ? buffers + first : 0,
+		strides ? strides + first : 0,
+		offsets ? offsets + first : 0);
+	Forwarded(GraphicsCall::IASetVertexBuffers);
+}
+
+void StateCacheContext::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	if (!enabled) { context->IASetIndexBuffer(buffer, format, offset); return; }
+
+	bool changed = !indexBufferKnown || indexBuffer != buffer || indexFormat != format || indexOffset != offset;
+	Record(GraphicsCall::IASetIndexBuffer, changed);
+	if (!changed)
+		return;
+
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	indexBufferKnown = true;
+	context->IASetIndexBuffer(buffer, format, offset);
+	Forwarded(GraphicsCall::IASetIndexBuffer);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ SHADER STAGES -------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+void StateCacheContext::VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	if (!enabled || SetShader(StageVS, GraphicsCall::VSSetShader, shader, numClassInstances))
+		context->VSSetShader(shader, classInstances, numClassInstances);
+}
+
+void StateCacheContext::VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	if (!enabled) { context->VSSetConstantBuffers(startSlot, numBuffers, buffers); return; }
+	Record(GraphicsCall::VSSetConstantBuffers, stages[StageVS].ConstantBuffers.Set(startSlot, numBuffers, buffers));
+}
+
+void StateCacheContext::VSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (!enabled) { context->VSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants); return; }
+	Record(GraphicsCall::VSSetConstantBuffers1, stages[StageVS].ConstantBuffers.Set(startSlot, numBuffers, buffers, firstConstant, numConstants));
+}
+
+void StateCacheContext::VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	if (!enabled) { context->VSSetShaderResources(startSlot, numViews, views); return; }
+	Record(GraphicsCall::VSSetShaderResources, stages[StageVS].ShaderResources.Set(startSlot, numViews, views));
+}
+
+void StateCacheContext::VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	if (!enabled) { context->VSSetSamplers(startSlot, numSamplers, samplers); return; }
+	Record(GraphicsCall::VSSetSamplers, stages[StageVS].Samplers.Set(startSlot, numSamplers, samplers));
+}
+
+void StateCacheContext::PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	if (!enabled || SetShader(StagePS, GraphicsCall::PSSetShader, shader, numClassInstances))
+		context->PSSetShader(shader, classInstances, numClassInstances);
+}
+
+void StateCacheContext::PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	if (!enabled) { context->PSSetConstantBuffers(startSlot, numBuffers, buffers); return; }
+	Record(GraphicsCall::PSSetConstantBuffers, stages[StagePS].ConstantBuffers.Set(startSlot, numBuffers, buffers));
+}
+
+void StateCacheContext::PSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (!enabled) { context->PSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants); return; }
+	Record(GraphicsCall::PSSetConstantBuffers1, stages[StagePS].ConstantBuffers.Set(startSlot, numBuffers, buffers, firstConstant, numConstants));
+}
+
+void StateCacheContext::PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	if (!enabled) { context->PSSetShaderResources(startSlot, numViews, views); return; }
+	Record(GraphicsCall::PSSetShaderResources, stages[StagePS].ShaderResources.Set(startSlot, numViews, views));
+}
+
+void StateCacheContext::PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	if (!enabled) { context->PSSetSamplers(startSlot, numSamplers, samplers); return; }
+	Record(GraphicsCall::PSSetSamplers, stages[StagePS].Samplers.Set(startSlot, numSamplers, samplers));
+}
+
+void StateCacheContext::DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	if (!enabled || SetShader(StageDS, GraphicsCall::DSSetShader, shader, numClassInstances))
+		context->DSSetShader(shader, classInstances, numClassInstances);
+}
+
+void StateCacheContext::DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	if (!enabled) { context->DSSetConstantBuffers(startSlot, numBuffers, buffers); return; }
+	Record(GraphicsCall::DSSetConstantBuffers, stages[StageDS].ConstantBuffers.Set(startSlot, numBuffers, buffers));
+}
+
+void StateCacheContext::DSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (!enabled) { context->DSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants); return; }
+	Record(GraphicsCall::DSSetConstantBuffers1, stages[StageDS].ConstantBuffers.Set(startSlot, numBuffers, buffers, firstConstant, numConstants));
+}
+
+void StateCacheContext::DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	if (!enabled) { context->DSSetShaderResources(startSlot, numViews, views); return; }
+	Record(GraphicsCall::DSSetShaderResources, stages[StageDS].ShaderResources.Set(startSlot, numViews, views));
+}
+
+void StateCacheContext::DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	if (!enabled) { context->DSSetSamplers(startSlot, numSamplers, samplers); return; }
+	Record(GraphicsCall::DSSetSamplers, stages[StageDS].Samplers.Set(startSlot, numSamplers, samplers));
+}
+
+void StateCacheContext::HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	if (!enabled || SetShader(StageHS, GraphicsCall::HSSetShader, shader, numClassInstances))
+		context->HSSetShader(shader, classInstances, numClassInstances);
+}
+
+void StateCacheContext::HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	if (!enabled) { context->HSSetConstantBuffers(startSlot, numBuffers, buffers); return; }
+	Record(GraphicsCall::HSSetConstantBuffers, stages[StageHS].ConstantBuffers.Set(startSlot, numBuffers, buffers));
+}
+
+void StateCacheContext::HSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (!enabled) { context->HSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants); return; }
+	Record(GraphicsCall::HSSetConstantBuffers1, stages[StageHS].ConstantBuffers.Set(startSlot, numBuffers, buffers, firstConstant, numConstants));
+}
+
+void StateCacheContext::HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	if (!enabled) { context->HSSetShaderResources(startSlot, numViews, views); return; }
+	Record(GraphicsCall::HSSetShaderResources, stages[StageHS].ShaderResources.Set(startSlot, numViews, views));
+}
+
+void StateCacheContext::HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	if (!enabled) { context->HSSetSamplers(startSlot, numSamplers, samplers); return; }
+	Record(GraphicsCall::HSSetSamplers, stages[StageHS].Samplers.Set(startSlot, numSamplers, samplers));
+}
+
+void StateCacheContext::GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	if (!enabled || SetShader(StageGS, GraphicsCall::GSSetShader, shader, numClassInstances))
+		context->GSSetShader(shader, classInstances, numClassInstances);
+}
+
+void StateCacheContext::GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	if (!enabled) { context->GSSetConstantBuffers(startSlot, numBuffers, buffers); return; }
+	Record(GraphicsCall::GSSetConstantBuffers, stages[StageGS].ConstantBuffers.Set(startSlot, numBuffers, buffers));
+}
+
+void StateCacheContext::GSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (!enabled) { context->GSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants); return; }
+	Record(GraphicsCall::GSSetConstantBuffers1, stages[StageGS].ConstantBuffers.Set(startSlot, numBuffers, buffers, firstConstant, numConstants));
+}
+
+void StateCacheContext::GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	if (!enabled) { context->GSSetShaderResources(startSlot, numViews, views); return; }
+	Record(GraphicsCall::GSSetShaderResources, stages[StageGS].ShaderResources.Set(startSlot, numViews, views));
+}
+
+void StateCacheContext::GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	if (!enabled) { context->GSSetSamplers(startSlot, numSamplers, samplers); return; }
+	Record(GraphicsCall::GSSetSamplers, stages[StageGS].Samplers.Set(startSlot, numSamplers, samplers));
+}
+
+void StateCacheContext::CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	if (!enabled || SetShader(StageCS, GraphicsCall::CSSetShader, shader, numClassInstances))
+		context->CSSetShader(shader, classInstances, numClassInstances);
+}
+
+void StateCacheContext::CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	if (!enabled) { context->CSSetConstantBuffers(startSlot, numBuffers, buffers); return; }
+	Record(GraphicsCall::CSSetConstantBuffers, stages[StageCS].ConstantBuffers.Set(startSlot, numBuffers, buffers));
+}
+
+void StateCacheContext::CSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants)
+{
+	if (!enabled) { context->CSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants); return; }
+	Record(GraphicsCall::CSSetConstantBuffers1, stages[StageCS].ConstantBuffers.Set(startSlot, numBuffers, buffers, firstConstant, numConstants));
+}
+
+void StateCacheContext::CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	if (!enabled) { context->CSSetShaderResources(startSlot, numViews, views); return; }
+	Record(GraphicsCall::CSSetShaderResources, stages[StageCS].ShaderResources.Set(startSlot, numViews, views));
+}
+
+void StateCacheContext::CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	if (!enabled) { context->CSSetSamplers(startSlot, numSamplers, samplers); return; }
+	Record(GraphicsCall::CSSetSamplers, stages[StageCS].Samplers.Set(startSlot, numSamplers, samplers));
+}
+
+// --------------------------------------------------------
+// UAVs aren't filtered (append/consume counters make a
+// repeat bind meaningful), but they are outputs, so pending
+// inputs go first and SRVs may get unbound
+// --------------------------------------------------------
+void StateCacheContext::CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* uavs, const UINT* initialCounts)
+{
+	if (!enabled) { context->CSSetUnorderedAccessViews(startSlot, numUAVs, uavs, initialCounts); return; }
+
+	Record(GraphicsCall::CSSetUnorderedAccessViews, true);
+	FlushAll();
+	context->CSSetUnorderedAccessViews(startSlot, numUAVs, uavs, initialCounts);
+	Forwarded(GraphicsCall::CSSetUnorderedAccessViews);
+	ForgetShaderResources();
+}
+
+// --------------------------------------------------------
+// Stream output targets are outputs too, and can knock
+// buffers out of the vertex, constant and SRV slots
+// --------------------------------------------------------
+void StateCacheContext::SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets)
+{
+	if (!enabled) { context->SOSetTargets(numBuffers, targets, offsets); return; }
+
+	Record(GraphicsCall::SOSetTargets, true);
+	FlushAll();
+	context->SOSetTargets(numBuffers, targets, offsets);
+	Forwarded(GraphicsCall::SOSetTargets);
+
+	ForgetShaderResources();
+	for (StageState& stage : stages)
+		stage.ConstantBuffers.ForgetBound();
+	for (VertexBufferSlot& slot : vertexBuffers)
+	{
+		if (slot.Buffer)
+			slot.Known = false;
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ RASTERIZER & OUTPUT MERGER ------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+void StateCacheContext::RSSetState(ID3D11RasterizerState* state)
+{
+	if (!enabled) { context->RSSetState(state); return; }
+
+	bool changed = !rasterizerStateKnown || rasterizerState != state;
+	Record(GraphicsCall::RSSetState, changed);
+	if (!changed)
+		return;
+
+	rasterizerState = state;
+	rasterizerStateKnown = true;
+	context->RSSetState(state);
+	Forwarded(GraphicsCall::RSSetState);
+}
+
+void StateCacheContext::RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports)
+{
+	if (!enabled || numViewports > D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE)
+	{
+		context->RSSetViewports(numViewports, viewports);
+		viewportsKnown = false;
+		return;
+	}
+
+	bool changed = !viewportsKnown || viewportCount != numViewports ||
+		memcmp(this->viewports, viewports, sizeof(D3D11_VIEWPORT) * numViewports) != 0;
+	Record(GraphicsCall::RSSetViewports, changed);
+	if (!changed)
+		return;
+
+	memcpy(this->viewports, viewports, sizeof(D3D11_VIEWPORT) * numViewports);
+	viewportCount = numViewports;
+	viewportsKnown = true;
+	context->RSSetViewports(numViewports, viewports);
+	Forwarded(GraphicsCall::RSSetViewports);
+}
+
+// --------------------------------------------------------
+// Changing outputs sends any staged inputs first, so they
+// hit the same hazard checks they would have without the
+// cache, then forgets SRVs the change may have unbound
+// --------------------------------------------------------
+void StateCacheContext::OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv)
+{
+	if (!enabled || numViews > D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT)
+	{
+		context->OMSetRenderTargets(numViews, rtvs, dsv);
+		renderTargetsKnown = false;
+		return;
+	}
+
+	bool changed = !renderTargetsKnown || renderTargetCount != numViews || depthStencilView != dsv;
+	for (UINT i = 0; i < numViews && !changed; i++)
+		changed = renderTargets[i] != (rtvs ? rtvs[i] : 0);
+
+	Record(GraphicsCall::OMSetRenderTargets, changed);
+	if (!changed)
+		return;
+
+	for (UINT i = 0; i < numViews; i++)
+		renderTargets[i] = rtvs ? rtvs[i] : 0;
+	renderTargetCount = numViews;
+	depthStencilView = dsv;
+	renderTargetsKnown = true;
+
+	FlushAll();
+	context->OMSetRenderTargets(numViews, rtvs, dsv);
+	Forwarded(GraphicsCall::OMSetRenderTargets);
+	ForgetShaderResources();
+}
+
+void StateCacheContext::OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef)
+{
+	if (!enabled) { context->OMSetDepthStencilState(state, stencilRef); return; }
+
+	bool changed = !depthStencilStateKnown || depthStencilState != state || this->stencilRef != stencilRef;
+	Record(GraphicsCall::OMSetDepthStencilState, changed);
+	if (!changed)
+		return;
+
+	depthStencilState = state;
+	this->stencilRef = stencilRef;
+	depthStencilStateKnown = true;
+	context->OMSetDepthStencilState(state, stencilRef);
+	Forwarded(GraphicsCall::OMSetDepthStencilState);
+}
+
+void StateCacheContext::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+	if (!enabled) { context->OMSetBlendState(state, blendFactor, sampleMask); return; }
+
+	// A null factor means { 1, 1, 1, 1 }
+	const FLOAT defaultFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const FLOAT* factor = blendFactor ? blendFactor : defaultFactor;
+
+	bool changed = !blendStateKnown || blendState != state || this->sampleMask != sampleMask ||
+		memcmp(this->blendFactor, factor, sizeof(FLOAT) * 4) != 0;
+	Record(GraphicsCall::OMSetBlendState, changed);
+	if (!changed)
+		return;
+
+	blendState = state;
+	memcpy(this->blendFactor, factor, sizeof(FLOAT) * 4);
+	this->sampleMask = sampleMask;
+	blendStateKnown = true;
+	context->OMSetBlendState(state, blendFactor, sampleMask);
+	Forwarded(GraphicsCall::OMSetBlendState);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ PASS THROUGH --------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+// None of these depend on bound state, so they go straight through
+
+void StateCacheContext::ClearRenderTargetView(ID3D11RenderTargetView* rtv, const FLOAT color[4])
+{
+	context->ClearRenderTargetView(rtv, color);
+}
+
+void StateCacheContext::ClearDepthStencilView(ID3D11DepthStencilView* dsv, UINT clearFlags, FLOAT depth, UINT8 stencil)
+{
+	context->ClearDepthStencilView(dsv, clearFlags, depth, stencil);
+}
+
+void StateCacheContext::UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch)
+{
+	context->UpdateSubresource(resource, subresource, box, data, rowPitch, depthPitch);
+}
+
+HRESULT StateCacheContext::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped)
+{
+	return context->Map(resource, subresource, mapType, mapFlags, mapped);
+}
+
+void StateCacheContext::Unmap(ID3D11Resource* resource, UINT subresource)
+{
+	context->Unmap(resource, subresource);
+}
+
+void StateCacheContext::CopySubresourceRegion(ID3D11Resource* dest, UINT destSubresource, UINT destX, UINT destY, UINT destZ,
+	ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox)
+{
+	context->CopySubresourceRegion(dest, destSubresource, destX, destY, destZ, source, sourceSubresource, sourceBox);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ WORK ----------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+// Staged slots only need to be in place by the time
+// something actually reads them
+
+void StateCacheContext::Draw(UINT vertexCount, UINT startVertex)
+{
+	for (int stage = 0; stage < StageCS; stage++)
+		FlushStage((Stage)stage);
+	context->Draw(vertexCount, startVertex);
+}
+
+void StateCacheContext::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	for (int stage = 0; stage < StageCS; stage++)
+		FlushStage((Stage)stage);
+	context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void StateCacheContext::Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ)
+{
+	FlushStage(StageCS);
+	context->Dispatch(groupsX, groupsY, groupsZ);
+}
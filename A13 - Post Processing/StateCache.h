@@ -0,0 +1,366 @@
+#pragma once
+
+#include <memory>
+#include <wrl/client.h>
+#include "GraphicsAPI.h"
+
+// --------------------------------------------------------
+// How well the state cache is doing.  A hit is an incoming
+// call that changed nothing and was dropped; a miss changed
+// at least one piece of state.  Forwarded counts the calls
+// that actually reached the wrapped context, which can be
+// fewer than the misses since slot binds get merged.
+// --------------------------------------------------------
+struct StateCacheStats
+{
+	unsigned long long Hits[(size_t)GraphicsCall::Count] = {};
+	unsigned long long Misses[(size_t)GraphicsCall::Count] = {};
+	unsigned long long Forwarded[(size_t)GraphicsCall::Count] = {};
+
+	unsigned long long TotalHits() const;
+	unsigned long long TotalMisses() const;
+	unsigned long long TotalForwarded() const;
+	void Reset();
+};
+
+// --------------------------------------------------------
+// Shadow copy of one table of slots (constant buffers,
+// SRVs or samplers for a single stage).  New values are
+// staged, then flushed as one call per contiguous run of
+// slots right before they're needed.
+//
+// Staged objects are held with a reference until flushed,
+// just like the real context would, so callers can release
+// things right after binding them.  Bound objects are kept
+// alive by the context itself (the null backend holds them
+// the same way D3D11 does), so a pointer in bound[] can't be
+// reused by a new object while it's still bound.
+//
+// Ranged tables (constant buffers) also remember which part
+// of each buffer is bound, in 16-byte constants.  Binding a
+// whole buffer is stored as the range 0..4096, and runs made
+// only of whole buffers are still sent the old way.
+// --------------------------------------------------------
+template<typename T, UINT Slots, bool Ranged = false>
+class StateSlotCache
+{
+public:
+	static const UINT WholeBuffer = D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT;
+
+	StateSlotCache() : bound(), known(), staged(), isStaged(), boundRange(), stagedRange(), dirtyStart(Slots), dirtyEnd(0) {}
+
+	// Stages a range of slots, returning true if anything
+	// differs from what's bound (or already staged)
+	bool Set(UINT startSlot, UINT count, T* const* objects, const UINT* firstConstant = 0, const UINT* numConstants = 0)
+	{
+		if (startSlot >= Slots)
+			return false;
+		if (count > Slots - startSlot)
+			count = Slots - startSlot;
+
+		bool changed = false;
+		for (UINT i = 0; i < count; i++)
+		{
+			UINT slot = startSlot + i;
+			T* object = objects ? objects[i] : 0;
+			Range range = { firstConstant ? firstConstant[i] : 0, numConstants ? numConstants[i] : WholeBuffer };
+
+			// Already the value this slot will end up with?
+			if (isStaged[slot] ? Same(staged[slot].Get(), stagedRange, object, range, slot) : (known[slot] && Same(bound[slot], boundRange, object, range, slot)))
+				continue;
+
+			// Changed back to what the context already has
+			if (known[slot] && Same(bound[slot], boundRange, object, range, slot))
+			{
+				staged[slot].Reset();
+				isStaged[slot] = false;
+				continue;
+			}
+
+			changed = true;
+			staged[slot] = object;
+			isStaged[slot] = true;
+			if constexpr (Ranged)
+				stagedRange[slot] = range;
+			if (slot < dirtyStart) dirtyStart = slot;
+			if (slot + 1 > dirtyEnd) dirtyEnd = slot + 1;
+		}
+		return changed;
+	}
+
+	// Sends staged slots on with forward(start, count, objects),
+	// returning the number of calls made.  Unchanged slots in
+	// between staged ones are re-sent rather than splitting the
+	// call, unless we don't know what's in them.  Ranged tables
+	// call forward(start, count, objects, firsts, nums) instead,
+	// with null arrays when the whole run is whole buffers.
+	template<typename F>
+	unsigned int Flush(F forward)
+	{
+		if (dirtyStart >= dirtyEnd)
+			return 0;
+
+		unsigned int calls = 0;
+		T* objects[Slots];
+		UINT firsts[Ranged ? Slots : 1];
+		UINT nums[Ranged ? Slots : 1];
+		bool ranged = false;
+		UINT runStart = Slots;
+		for (UINT slot = dirtyStart; slot <= dirtyEnd; slot++)
+		{
+			bool usable = slot < dirtyEnd && (isStaged[slot] || known[slot]);
+			if (usable)
+			{
+				objects[slot] = isStaged[slot] ? staged[slot].Get() : bound[slot];
+				if (runStart == Slots)
+				{
+					runStart = slot;
+					ranged = false;
+				}
+
+				if constexpr (Ranged)
+				{
+					const Range& range = isStaged[slot] ? stagedRange[slot] : boundRange[slot];
+					firsts[slot] = range.First;
+					nums[slot] = range.Count;
+					ranged = ranged || range.First != 0 || range.Count != WholeBuffer;
+				}
+			}
+			else if (runStart != Slots)
+			{
+				if constexpr (Ranged)
+					forward(runStart, slot - runStart, objects + runStart, ranged ? firsts + runStart : 0, ranged ? nums + runStart : 0);
+				else
+					forward(runStart, slot - runStart, objects + runStart);
+				runStart = Slots;
+				calls++;
+			}
+		}
+
+		// The context holds its own references now
+		for (UINT slot = dirtyStart; slot < dirtyEnd; slot++)
+		{
+			if (!isStaged[slot])
+				continue;
+
+			bound[slot] = staged[slot].Get();
+			known[slot] = true;
+			if constexpr (Ranged)
+				boundRange[slot] = stagedRange[slot];
+			staged[slot].Reset();
+			isStaged[slot] = false;
+		}
+
+		dirtyStart = Slots;
+		dirtyEnd = 0;
+		return calls;
+	}
+
+	// Called when the context may have unbound these slots
+	// behind our back (hazard tracking nulls out inputs that
+	// get bound as outputs).  Slots known to be empty stay
+	// known, since that can only ever null things.
+	void ForgetBound()
+	{
+		for (UINT slot = 0; slot < Slots; slot++)
+		{
+			if (bound[slot])
+				known[slot] = false;
+		}
+	}
+
+	// Called when nothing about the context can be trusted
+	void Forget()
+	{
+		for (UINT slot = 0; slot < Slots; slot++)
+			known[slot] = false;
+	}
+
+private:
+	struct Range
+	{
+		UINT First;
+		UINT Count;
+	};
+
+	T* bound[Slots];
+	bool known[Slots];
+	Microsoft::WRL::ComPtr<T> staged[Slots];
+	bool isStaged[Slots];
+	Range boundRange[Ranged ? Slots : 1];
+	Range stagedRange[Ranged ? Slots : 1];
+	UINT dirtyStart;
+	UINT dirtyEnd;
+
+	// Same object, and the same part of it for ranged tables
+	bool Same(T* a, const Range* ranges, T* b, const Range& range, UINT slot) const
+	{
+		if (a != b)
+			return false;
+		if constexpr (Ranged)
+			return !a || (ranges[slot].First == range.First && ranges[slot].Count == range.Count);
+		return true;
+	}
+};
+
+// --------------------------------------------------------
+// Context decorator that drops redundant state changes.
+//
+// Shaders, input assembler, rasterizer and output merger
+// state are compared against a shadow copy and only
+// forwarded when they change.  Constant buffer, SRV and
+// sampler binds are staged and sent right before the next
+// draw/dispatch, merged into one call per stage and table.
+//
+// Anything that bypasses this context (ImGui uses the raw
+// D3D context, but restores what it changes) or that D3D
+// changes on its own must be reported with one of the
+// Invalidate functions.
+// --------------------------------------------------------
+class StateCacheContext : public IGraphicsContext
+{
+public:
+	StateCacheContext(std::shared_ptr<IGraphicsContext> context, std::shared_ptr<StateCacheStats> stats);
+
+	ID3D11DeviceContext* GetD3DContext() override { return context->GetD3DContext(); }
+	std::shared_ptr<StateCacheStats> GetStats() { return stats; }
+
+	// Turning the cache off forwards every call as-is
+	bool IsEnabled() const { return enabled; }
+	void SetEnabled(bool enable);
+
+	// Forget the shadow state, so the next call of each kind
+	// is always forwarded
+	void Invalidate();
+	void InvalidateRenderTargets();
+	void InvalidateConstantBuffers();
+
+	void IASetInputLayout(ID3D11InputLayout* inputLayout) override;
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+	void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override;
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override;
+
+	void VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void VSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void PSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void DSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void HSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void GSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+
+	void CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void CSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override;
+	void CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+	void CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* uavs, const UINT* initialCounts) override;
+
+	void SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets) override;
+
+	void RSSetState(ID3D11RasterizerState* state) override;
+	void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports) override;
+
+	void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv) override;
+	void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef) override;
+	void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) override;
+
+	void ClearRenderTargetView(ID3D11RenderTargetView* rtv, const FLOAT color[4]) override;
+	void ClearDepthStencilView(ID3D11DepthStencilView* dsv, UINT clearFlags, FLOAT depth, UINT8 stencil) override;
+
+	void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch) override;
+	HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) override;
+	void Unmap(ID3D11Resource* resource, UINT subresource) override;
+	void CopySubresourceRegion(ID3D11Resource* dest, UINT destSubresource, UINT destX, UINT destY, UINT destZ,
+		ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox) override;
+
+	void Draw(UINT vertexCount, UINT startVertex) override;
+	void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) override;
+	void Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ) override;
+
+private:
+	enum Stage { StageVS, StagePS, StageDS, StageHS, StageGS, StageCS, StageCount };
+
+	// Everything bindable on a single shader stage
+	struct StageState
+	{
+		ID3D11DeviceChild* Shader = 0;
+		bool ShaderKnown = false;
+		StateSlotCache<ID3D11Buffer, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, true> ConstantBuffers;
+		StateSlotCache<ID3D11ShaderResourceView, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT> ShaderResources;
+		StateSlotCache<ID3D11SamplerState, D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT> Samplers;
+	};
+
+	// Input assembler vertex buffer slots
+	struct VertexBufferSlot
+	{
+		ID3D11Buffer* Buffer;
+		UINT Stride;
+		UINT Offset;
+		bool Known;
+	};
+
+	std::shared_ptr<IGraphicsContext> context;
+	std::shared_ptr<StateCacheStats> stats;
+	bool enabled;
+
+	StageState stages[StageCount];
+
+	ID3D11InputLayout* inputLayout;
+	bool inputLayoutKnown;
+	D3D11_PRIMITIVE_TOPOLOGY topology;
+	VertexBufferSlot vertexBuffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	ID3D11Buffer* indexBuffer;
+	DXGI_FORMAT indexFormat;
+	UINT indexOffset;
+	bool indexBufferKnown;
+
+	ID3D11RasterizerState* rasterizerState;
+	bool rasterizerStateKnown;
+	D3D11_VIEWPORT viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	UINT viewportCount;
+	bool viewportsKnown;
+
+	ID3D11RenderTargetView* renderTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+	UINT renderTargetCount;
+	ID3D11DepthStencilView* depthStencilView;
+	bool renderTargetsKnown;
+	ID3D11DepthStencilState* depthStencilState;
+	UINT stencilRef;
+	bool depthStencilStateKnown;
+	ID3D11BlendState* blendState;
+	FLOAT blendFactor[4];
+	UINT sampleMask;
+	bool blendStateKnown;
+
+	// Counting helpers
+	void Record(GraphicsCall call, bool changed);
+	void Forwarded(GraphicsCall call);
+
+	// Shared shader and slot handling for all six stages
+	bool SetShader(Stage stage, GraphicsCall call, ID3D11DeviceChild* shader, UINT numClassInstances);
+	void FlushStage(Stage stage);
+	void FlushAll();
+	void ForgetShaderResources();
+};
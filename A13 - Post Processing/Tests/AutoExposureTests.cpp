@@ -0,0 +1,189 @@
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "../AutoExposure.h"
+#include "../Bloom.h"
+#include "../ColorGrading.h"
+#include "../GraphicsAPI.h"
+#include "../PostProcessChain.h"
+#include "EngineTests.h"
+
+// --------------------------------------------------------
+// Checks the HDR pipeline's CPU side:
+// - Luminances must land in the bin their log2 is in, with
+//   nothing (zero, negative, NaN) in the first and anything
+//   too bright in the last, and a padded row pitch must skip
+//   the padding
+// - A flat image's average must be within half a bin of its
+//   luminance, and its exposure take it to the key value
+// - Highlights brighter than the high percent must not move
+//   the average
+// - The controller must take its first histogram as it is,
+//   then ease without overshooting, quicker to a brighter
+//   scene than a darker one, and stay within its limits
+// - The default grade must keep black black, never pass
+//   white, and never get darker as its input gets brighter
+// - The grade alone must be one pass, and fuse with the
+//   vignette before it
+// Then prints what the game's chain moves a frame at 1080p
+// in R11G11B10 and in RGBA16F targets.
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunHdrTests()
+{
+	bool passed = true;
+	ExposureSettings settings;
+	const float binWidth = (settings.MaxLogLuminance - settings.MinLogLuminance) / LuminanceHistogramBins;
+
+	// Just inside each bin's bottom edge, and the ones that don't fit
+	bool binsPassed = true;
+	for (unsigned int bin = 0; bin < LuminanceHistogramBins; bin++)
+		binsPassed &= LuminanceBin(exp2f(settings.MinLogLuminance + (bin + 0.01f) * binWidth), settings) == bin;
+	binsPassed &=
+		LuminanceBin(0.0f, settings) == 0 && LuminanceBin(-1.0f, settings) == 0 && LuminanceBin(NAN, settings) == 0 &&
+		LuminanceBin(1e-9f, settings) == 0 && LuminanceBin(1e30f, settings) == LuminanceHistogramBins - 1 &&
+		LuminanceBin(INFINITY, settings) == LuminanceHistogramBins - 1;
+
+	// Three rows of five, each padded out to eight with values
+	// that would land in the last bin if they were read
+	const unsigned int padWidth = 5, padHeight = 3, padPitch = 8;
+	float padded[padHeight * padPitch];
+	for (unsigned int i = 0; i < padHeight * padPitch; i++)
+		padded[i] = i % padPitch < padWidth ? 0.18f : 1e30f;
+	LuminanceHistogram histogram;
+	BuildLuminanceHistogram(padded, padWidth, padHeight, padPitch * sizeof(float), settings, histogram);
+	unsigned int binned = 0;
+	for (unsigned int bin = 0; bin < LuminanceHistogramBins; bin++)
+		binned += histogram.Bins[bin];
+	binsPassed &= histogram.Count == padWidth * padHeight && binned == histogram.Count &&
+		histogram.Bins[LuminanceBin(0.18f, settings)] == histogram.Count;
+	passed &= binsPassed;
+	printf("Bins:       %u, %.2f stops each, edges and padding  %s\n", LuminanceHistogramBins, binWidth, binsPassed ? "ok" : "FAILED");
+
+	// A flat image, and the same with a few highlights in it
+	const unsigned int width = 128, height = 64;
+	std::vector<float> image(width * height, 0.3f);
+	BuildLuminanceHistogram(image.data(), width, height, width * sizeof(float), settings, histogram);
+	float flatLog = HistogramAverageLogLuminance(histogram, settings);
+	float flatExposure = ExposureForLogLuminance(flatLog, settings);
+	bool flatPassed = fabsf(flatLog - log2f(0.3f)) <= binWidth / 2 && fabsf(log2f(flatExposure * 0.3f / settings.KeyValue)) <= binWidth / 2;
+	passed &= flatPassed;
+	printf("Flat:       0.3 averages to %.3f, exposed by %.3f  %s\n", exp2f(flatLog), flatExposure, flatPassed ? "ok" : "FAILED");
+
+	const unsigned int highlights = (unsigned int)(image.size() * 0.04f);
+	double mean = 0;
+	for (unsigned int i = 0; i < image.size(); i++)
+	{
+		image[i] = i < highlights ? 1000.0f : 0.1f;
+		mean += image[i] / image.size();
+	}
+	BuildLuminanceHistogram(image.data(), width, height, width * sizeof(float), settings, histogram);
+	float highlightLog = HistogramAverageLogLuminance(histogram, settings);
+	bool highlightsPassed = fabsf(highlightLog - log2f(0.1f)) <= binWidth / 2;
+	passed &= highlightsPassed;
+	printf("Highlights: 4%% at 1000 over 0.1 averages to %.3f (the mean is %.1f)  %s\n", exp2f(highlightLog), mean,
+		highlightsPassed ? "ok" : "FAILED");
+
+	// A step to a darker scene and back, a frame at a time
+	auto flatHistogram = [&](float luminance)
+	{
+		image.assign(image.size(), luminance);
+		LuminanceHistogram flat;
+		BuildLuminanceHistogram(image.data(), width, height, width * sizeof(float), settings, flat);
+		return flat;
+	};
+	LuminanceHistogram bright = flatHistogram(1.0f);
+	LuminanceHistogram dark = flatHistogram(0.01f);
+	const float frameTime = 1.0f / 60.0f;
+	ExposureController controller;
+	float first = controller.Update(bright, settings, frameTime);
+	bool controllerPassed = first == controller.GetTargetExposure() && controller.Update(LuminanceHistogram(), settings, frameTime) == first;
+
+	// Frames until it's within a tenth of a stop of where it's heading
+	auto settle = [&](const LuminanceHistogram& next)
+	{
+		float last = controller.GetExposure();
+		unsigned int frames = 0;
+		do
+		{
+			float now = controller.Update(next, settings, frameTime);
+			float target = controller.GetTargetExposure();
+			bool rising = target > last;
+			controllerPassed &= rising ? now >= last && now <= target : now <= last && now >= target;
+			last = now;
+			frames++;
+		} while (fabsf(log2f(last / controller.GetTargetExposure())) > 0.1f && frames < 10000);
+		return frames;
+	};
+	unsigned int darkening = settle(dark);
+	unsigned int brightening = settle(bright);
+	controllerPassed &= brightening < darkening;
+
+	ExposureController limited;
+	controllerPassed &=
+		limited.Update(flatHistogram(1e-6f), settings, frameTime) == settings.MaxExposure &&
+		fabsf(limited.Update(flatHistogram(1e5f), settings, 10.0f) - settings.MinExposure) < 1e-4f;
+	passed &= controllerPassed;
+	printf("Controller: %u frames to a darker scene, %u to a brighter one  %s\n", darkening, brightening,
+		controllerPassed ? "ok" : "FAILED");
+
+	// Up through the whole range, on a grey
+	ColorGradeSettings grade;
+	bool gradePassed = true;
+	float previous = 0.0f;
+	for (float x = 0.0f; x < 1000.0f; x = x * 1.1f + 0.001f)
+	{
+		float color[3] = { x, x, x };
+		float mapped[3];
+		GradeColor(color, grade, mapped);
+		gradePassed &= mapped[0] >= previous && mapped[0] <= 1.0f && mapped[0] == mapped[1] && mapped[1] == mapped[2];
+		previous = mapped[0];
+	}
+	float black[3] = {};
+	float blackMapped[3];
+	GradeColor(black, grade, blackMapped);
+	gradePassed &= blackMapped[0] == 0.0f && previous > 0.99f;
+	passed &= gradePassed;
+	printf("Grade:      black stays black, white reached at %.3f  %s\n", previous, gradePassed ? "ok" : "FAILED");
+
+	// The game's chain (see Game::CreatePostEffects()), with
+	// only the grade, then the vignette before it
+	std::vector<PostEffect> chain(3);
+	chain[0].Name = "Bloom";
+	chain[0].Kind = PostEffectKind::Gather;
+	chain[0].Passes = BloomPasses();
+	chain[0].Params = { { "Intensity", 0.0f, 0.0f, 2.0f, 0.0f, false, true } };
+	chain[1].Name = "Vignette";
+	chain[1].Params = { { "Strength", 0.0f, 0.0f, 2.0f, 0.0f, false } };
+	chain[2].Name = "Color Grade";
+	chain[2].Required = true;
+	chain[2].Params = { { "Saturation", 1.0f, 0.0f, 2.0f, 1.0f, false } };
+	PostChainPlan plan;
+	PlanPostChain(chain, 1920, 1080, 4, plan);
+	bool chainPassed = plan.Passes.size() == 1 && plan.SceneTarget != PostBackBuffer && plan.Passes[0].Output == PostBackBuffer;
+	chain[1].Params[0].Value = 0.5f;
+	PlanPostChain(chain, 1920, 1080, 4, plan);
+	chainPassed &= plan.Passes.size() == 1 && plan.FusedEffects == 1;
+	passed &= chainPassed;
+	printf("Chain:      the grade alone, then fused with the vignette, in one pass  %s\n", chainPassed ? "ok" : "FAILED");
+
+	// What each format costs, with bloom on as well
+	chain[0].Params[0].Value = 0.5f;
+	PostChainPlan narrow, wide;
+	PlanPostChain(chain, 1920, 1080, FormatBitsPerPixel(DXGI_FORMAT_R11G11B10_FLOAT) / 8, narrow);
+	PlanPostChain(chain, 1920, 1080, FormatBitsPerPixel(DXGI_FORMAT_R16G16B16A16_FLOAT) / 8, wide);
+	unsigned long long narrowTraffic = PostChainTraffic(narrow, 1920, 1080, FormatBitsPerPixel(DXGI_FORMAT_R11G11B10_FLOAT) / 8, 4);
+	unsigned long long wideTraffic = PostChainTraffic(wide, 1920, 1080, FormatBitsPerPixel(DXGI_FORMAT_R16G16B16A16_FLOAT) / 8, 4);
+	bool formatPassed = narrow.TargetBytes < wide.TargetBytes && narrowTraffic < wideTraffic;
+	passed &= formatPassed;
+	printf("1920x1080, bloom, vignette and grade, %u passes:\n", (unsigned int)narrow.Passes.size());
+	printf("  R11G11B10  %6.1f MB of targets  %6.1f MB moved a frame\n",
+		narrow.TargetBytes / (1024.0 * 1024.0), narrowTraffic / (1024.0 * 1024.0));
+	printf("  RGBA16F    %6.1f MB of targets  %6.1f MB moved a frame  %.2fx  %s\n",
+		wide.TargetBytes / (1024.0 * 1024.0), wideTraffic / (1024.0 * 1024.0),
+		(double)wideTraffic / narrowTraffic, formatPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All HDR checks passed" : "HDR checks FAILED");
+	return passed ? 0 : 1;
+}
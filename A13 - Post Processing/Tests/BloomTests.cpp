@@ -0,0 +1,274 @@
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include "../Bloom.h"
+#include "EngineTests.h"
+
+// --------------------------------------------------------
+// Checks the bloom against its own pieces:
+// - Both filters' weights must add up to one
+// - Halving an even sized image, the 13 taps must be the
+//   texel weights they stand for: each tap a 2x2 box
+// - The tent must leave a ramp as it was, away from the edges
+// - With no threshold a flat image must come out brighter by
+//   exactly the intensity, whatever the spread
+// - More spread must carry more of a bright spot further
+// - The planned passes must cost the same at every spread,
+//   blending up the levels in place
+// Then times it against the separable blur at its widest.
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunBloomTests()
+{
+	bool passed = true;
+	std::mt19937 random(540);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	auto randomImage = [&](unsigned int width, unsigned int height)
+	{
+		BlurImage image;
+		image.Width = width;
+		image.Height = height;
+		image.Pixels.resize((size_t)width * height * 4);
+		for (float& value : image.Pixels)
+			value = unit(random);
+		return image;
+	};
+	auto maxDifference = [](const BlurImage& a, const BlurImage& b)
+	{
+		float worst = 0;
+		for (size_t i = 0; i < a.Pixels.size(); i++)
+			worst = fmaxf(worst, fabsf(a.Pixels[i] - b.Pixels[i]));
+		return worst;
+	};
+
+	float downOffsets[BloomDownsampleTaps][2], downWeights[BloomDownsampleTaps];
+	float upOffsets[BloomUpsampleTaps][2], upWeights[BloomUpsampleTaps];
+	BloomDownsampleKernel(downOffsets, downWeights);
+	BloomUpsampleKernel(upOffsets, upWeights);
+	double downTotal = 0, upTotal = 0;
+	for (unsigned int t = 0; t < BloomDownsampleTaps; t++)
+		downTotal += downWeights[t];
+	for (unsigned int t = 0; t < BloomUpsampleTaps; t++)
+		upTotal += upWeights[t];
+	bool kernelsPassed = fabs(downTotal - 1.0) < 1e-6 && fabs(upTotal - 1.0) < 1e-6;
+	passed &= kernelsPassed;
+	printf("Kernels:    %u and %u taps add up to one  %s\n", BloomDownsampleTaps, BloomUpsampleTaps, kernelsPassed ? "ok" : "FAILED");
+
+	// Each output pixel's center is the corner between texels
+	// 2x and 2x + 1, so every tap lands on a corner too
+	BlurImage image = randomImage(64, 38);
+	BlurImage down, expected;
+	BloomDownsampleImage(image, image.Width / 2, image.Height / 2, false, 0, down);
+	expected.Width = down.Width;
+	expected.Height = down.Height;
+	expected.Pixels.assign(down.Pixels.size(), 0.0f);
+	for (unsigned int y = 0; y < down.Height; y++)
+	{
+		for (unsigned int x = 0; x < down.Width; x++)
+		{
+			for (unsigned int t = 0; t < BloomDownsampleTaps; t++)
+			{
+				for (int texel = 0; texel < 4; texel++)
+				{
+					int tx = (int)(2 * x) + (int)downOffsets[t][0] + (texel & 1);
+					int ty = (int)(2 * y) + (int)downOffsets[t][1] + (texel >> 1);
+					tx = tx < 0 ? 0 : tx >= (int)image.Width ? image.Width - 1 : tx;
+					ty = ty < 0 ? 0 : ty >= (int)image.Height ? image.Height - 1 : ty;
+					for (int i = 0; i < 4; i++)
+						expected.Pixels[((size_t)y * down.Width + x) * 4 + i] +=
+							image.Pixels[((size_t)ty * image.Width + tx) * 4 + i] * downWeights[t] / 4;
+				}
+			}
+		}
+	}
+	float worstDown = maxDifference(down, expected);
+	bool downPassed = worstDown < 1e-5f;
+	passed &= downPassed;
+	printf("Downsample: %.2g from its texel weights  %s\n", worstDown, downPassed ? "ok" : "FAILED");
+
+	// Up from 16x12 to 32x24, onto nothing
+	BlurImage ramp, zero, up;
+	ramp.Width = 16;
+	ramp.Height = 12;
+	ramp.Pixels.resize((size_t)ramp.Width * ramp.Height * 4);
+	for (unsigned int y = 0; y < ramp.Height; y++)
+	{
+		for (unsigned int x = 0; x < ramp.Width; x++)
+		{
+			for (int i = 0; i < 4; i++)
+				ramp.Pixels[((size_t)y * ramp.Width + x) * 4 + i] = 0.05f * x + 0.03f * y + 0.1f * i;
+		}
+	}
+	zero.Width = 32;
+	zero.Height = 24;
+	zero.Pixels.assign((size_t)zero.Width * zero.Height * 4, 0.0f);
+	BloomUpsampleImage(ramp, zero, 1.0f, up);
+	float worstUp = 0;
+	for (unsigned int y = 4; y < up.Height - 4; y++)
+	{
+		for (unsigned int x = 4; x < up.Width - 4; x++)
+		{
+			float sample[4];
+			SampleBlurImage(ramp, (x + 0.5f) / up.Width, (y + 0.5f) / up.Height, sample);
+			for (int i = 0; i < 4; i++)
+				worstUp = fmaxf(worstUp, fabsf(up.Pixels[((size_t)y * up.Width + x) * 4 + i] - sample[i]));
+		}
+	}
+	bool upPassed = worstUp < 1e-5f;
+	passed &= upPassed;
+	printf("Upsample:   %.2g from the ramp it was  %s\n", worstUp, upPassed ? "ok" : "FAILED");
+
+	BlurImage flat = randomImage(97, 61);
+	for (size_t i = 0; i < flat.Pixels.size(); i++)
+		flat.Pixels[i] = (i % 4) * 0.2f + 0.1f;
+	float worstFlat = 0;
+	for (float spread : { 0.0f, 0.5f, 1.0f })
+	{
+		BloomSettings settings;
+		settings.Threshold = 0;
+		settings.Spread = spread;
+		settings.Intensity = 0.75f;
+		BlurImage bloomed, brighter = flat;
+		BloomImage(flat, settings, bloomed);
+		for (float& value : brighter.Pixels)
+			value *= 1 + settings.Intensity;
+		worstFlat = fmaxf(worstFlat, maxDifference(bloomed, brighter));
+	}
+	bool flatPassed = worstFlat < 1e-5f;
+	passed &= flatPassed;
+	printf("Flat:       %.2g from 1 + intensity  %s\n", worstFlat, flatPassed ? "ok" : "FAILED");
+
+	// A bright spot: how much of the glow lands over 16 pixels away
+	BlurImage spot;
+	spot.Width = 128;
+	spot.Height = 128;
+	spot.Pixels.assign((size_t)spot.Width * spot.Height * 4, 0.0f);
+	for (unsigned int y = 62; y < 66; y++)
+	{
+		for (unsigned int x = 62; x < 66; x++)
+			spot.Pixels[((size_t)y * spot.Width + x) * 4] = 1.0f;
+	}
+	bool reachPassed = true;
+	float lastReach = -1;
+	printf("Reach:      glow over 16 pixels out, by spread\n");
+	for (float spread : { 0.25f, 0.5f, 0.75f, 1.0f })
+	{
+		BloomSettings settings;
+		settings.Threshold = 0.5f;
+		settings.Spread = spread;
+		BlurImage bloomed;
+		BloomImage(spot, settings, bloomed);
+		double glow = 0, far = 0;
+		for (unsigned int y = 0; y < spot.Height; y++)
+		{
+			for (unsigned int x = 0; x < spot.Width; x++)
+			{
+				size_t i = ((size_t)y * spot.Width + x) * 4;
+				float added = bloomed.Pixels[i] - spot.Pixels[i];
+				float dx = x - 63.5f, dy = y - 63.5f;
+				glow += added;
+				if (dx * dx + dy * dy > 16 * 16)
+					far += added;
+			}
+		}
+		float reach = (float)(far / glow);
+		reachPassed &= reach > lastReach;
+		lastReach = reach;
+		printf("  %.2f      %5.1f%%\n", spread, reach * 100);
+	}
+	passed &= reachPassed;
+	printf("Reach:      grows with the spread  %s\n", reachPassed ? "ok" : "FAILED");
+
+	// The real passes on a 1080p screen: samples a screen pixel,
+	// counting the base read whenever it couldn't be blended
+	std::vector<PostEffect> chain(2);
+	chain[0].Name = "Bloom";
+	chain[0].Kind = PostEffectKind::Gather;
+	chain[0].Passes = BloomPasses();
+	chain[0].Params = {
+		{ "Intensity", 0.5f, 0.0f, 2.0f, 0.0f, false, true },
+		{ "Threshold", 0.8f, 0.0f, 1.0f, 1.0f, false },
+		{ "Spread", 0.0f, 0.0f, 1.0f, 0.0f, false } };
+	chain[1].Name = "Vignette";
+	chain[1].Params = { { "Strength", 0.0f, 0.0f, 2.0f, 0.0f, false } };
+	auto planCost = [&](PostChainPlan& plan)
+	{
+		PlanPostChain(chain, 1920, 1080, 4, plan);
+		double samples = 0;
+		for (const PostPass& pass : plan.Passes)
+		{
+			PostTarget size = pass.Output == PostBackBuffer ? PostTarget{ 1920, 1080 } : plan.Targets[pass.Output];
+			BloomStep step = BloomPassStep(pass.Pass);
+			unsigned int taps = pass.Effects.empty() || pass.Effects[0] != 0 ? 1 :
+				step == BloomStep::Prefilter || step == BloomStep::Downsample ? BloomDownsampleTaps :
+				BloomUpsampleTaps + (pass.Additive ? 0 : 1);
+			samples += (double)size.Width * size.Height * taps;
+		}
+		return samples / (1920.0 * 1080.0);
+	};
+	auto additiveCount = [](const PostChainPlan& plan)
+	{
+		unsigned int count = 0;
+		for (const PostPass& pass : plan.Passes)
+			count += pass.Additive ? 1 : 0;
+		return count;
+	};
+
+	PostChainPlan plan;
+	double cost = planCost(plan);
+	bool costPassed = true;
+	for (float spread : { 0.25f, 0.5f, 1.0f })
+	{
+		chain[0].Params[2].Value = spread;
+		PostChainPlan spreadPlan;
+		costPassed &= planCost(spreadPlan) == cost && spreadPlan.Passes.size() == plan.Passes.size();
+	}
+	bool planPassed =
+		plan.Passes.size() == 2 * BloomLevels &&
+		plan.Targets.size() == BloomLevels + 1 &&
+		additiveCount(plan) == BloomLevels - 1;
+
+	// Followed by something, the composite blends onto the scene too
+	chain[1].Params[0].Value = 1.0f;
+	PostChainPlan followed;
+	PlanPostChain(chain, 1920, 1080, 4, followed);
+	planPassed &=
+		followed.Passes.size() == 2 * BloomLevels + 1 &&
+		followed.Targets.size() == BloomLevels + 1 &&
+		additiveCount(followed) == BloomLevels;
+	passed &= costPassed && planPassed;
+	printf("Cost:       %.2f samples a pixel at every spread  %s\n", cost, costPassed ? "ok" : "FAILED");
+	printf("Plan:       %u passes, %u blended in place, %u targets, %.1f MB  %s\n", (unsigned int)plan.Passes.size(),
+		additiveCount(plan), (unsigned int)plan.Targets.size(), plan.TargetBytes / (1024.0 * 1024.0), planPassed ? "ok" : "FAILED");
+
+	// Timing, against the blur at its widest, which reaches
+	// half as far as the pyramid's smallest level
+	const unsigned int radius = MaxBlurRadius;
+	BlurImage timed = randomImage(256, 144);
+	BlurKernel kernel;
+	ComputeBlurKernel(radius, kernel);
+
+	BlurImage across, blurred;
+	double start = TestMilliseconds();
+	BlurImagePass(timed, kernel, false, across);
+	BlurImagePass(across, kernel, true, blurred);
+	double separableMs = TestMilliseconds() - start;
+
+	BlurImage bloomed;
+	start = TestMilliseconds();
+	BloomImage(timed, BloomSettings(), bloomed);
+	double bloomMs = TestMilliseconds() - start;
+
+	unsigned int separableSamples = 2 * (2 * kernel.TapCount - 1);
+	bool cheaperPassed = cost < separableSamples;
+	passed &= cheaperPassed;
+	printf("%ux%u:\n", timed.Width, timed.Height);
+	printf("  Separable  %8.2f ms  %5u samples a pixel, %u pixels out\n", separableMs, separableSamples, radius);
+	printf("  Bloom      %8.2f ms  %5.1f samples a pixel, %u pixels out  %s\n", bloomMs, cost, 1u << BloomLevels,
+		cheaperPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All bloom checks passed" : "Bloom checks FAILED");
+	return passed ? 0 : 1;
+}
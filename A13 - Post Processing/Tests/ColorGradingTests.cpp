@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#include "../ColorGrading.h"
+#include "EngineTests.h"
+
+namespace
+{
+	// Makes the second of three default grades warm and the
+	// third harsh, with curves and bends the table has to
+	// follow; the first stays neutral
+	void MakeTestGrades(ColorGradeSettings grades[3])
+	{
+		grades[1].Curve = TonemapCurve::Reinhard;
+		grades[1].WhitePoint = 12.0f;
+		grades[1].Tint[1] = 0.9f;
+		grades[1].Tint[2] = 0.7f;
+		grades[1].Saturation = 1.4f;
+		grades[1].Contrast = 1.3f;
+		grades[1].Gamma = 0.8f;
+		grades[2].Saturation = 0.0f;
+		grades[2].Contrast = 2.0f;
+		grades[2].Gamma = 2.0f;
+	}
+}
+
+// --------------------------------------------------------
+// Checks the color grading table:
+// - The SSE bake must be within one step of baking each
+//   entry through GradeColor()
+// - Looked up with trilinear filtering, as the GPU does, the
+//   table must match grading directly on random exposed
+//   colors: on average within one step for every grade, at
+//   worst within two for the neutral one, and for 99% of
+//   colors within sixteen for the others.  Their sharp bends
+//   (a channel clamped to black, where the display's curve
+//   is steepest) fall between entries.
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunGradingTests()
+{
+	bool passed = true;
+	ColorGradeSettings grades[3];
+	const char* gradeNames[3] = { "Neutral", "Warm", "Harsh" };
+	MakeTestGrades(grades);
+
+	std::mt19937 random(540);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const unsigned int samples = 100000;
+	for (int g = 0; g < 3; g++)
+	{
+		std::vector<unsigned char> lut, reference;
+		BakeColorLut(grades[g], lut);
+		BakeColorLutReference(grades[g], reference);
+		int worstEntry = 0;
+		for (size_t i = 0; i < lut.size(); i++)
+			worstEntry = abs(lut[i] - reference[i]) > worstEntry ? abs(lut[i] - reference[i]) : worstEntry;
+
+		// Exposed colors spread evenly along the table, as the
+		// display's gamma spreads them
+		std::vector<float> errors(samples);
+		double total = 0;
+		for (unsigned int s = 0; s < samples; s++)
+		{
+			float color[3] = { ColorLutUnshaper(unit(random)), ColorLutUnshaper(unit(random)), ColorLutUnshaper(unit(random)) };
+			float direct[3], looked[3];
+			GradeColor(color, grades[g], direct);
+			SampleColorLut(lut, color, looked);
+			errors[s] = fmaxf(fabsf(direct[0] - looked[0]), fmaxf(fabsf(direct[1] - looked[1]), fabsf(direct[2] - looked[2])));
+			total += errors[s];
+		}
+		std::sort(errors.begin(), errors.end());
+		float mean = (float)(total / samples);
+		float p99 = errors[samples * 99 / 100];
+		float worst = errors.back();
+
+		bool gradePassed = worstEntry <= 1 && mean < 1.0f / 255 && p99 < 16.0f / 255 && (g != 0 || worst < 2.0f / 255);
+		passed &= gradePassed;
+		printf("%-8s    bake off by %d, lookup mean %.2f, 99%% %.2f, worst %.2f steps  %s\n", gradeNames[g],
+			worstEntry, mean * 255, p99 * 255, worst * 255, gradePassed ? "ok" : "FAILED");
+	}
+
+	printf("%s\n", passed ? "All grading checks passed" : "Grading checks FAILED");
+	return passed ? 0 : 1;
+}
+
+// --------------------------------------------------------
+// Times baking the warm grade's table, by the reference and
+// by the SSE bake with thread counts doubling from 1 up to
+// one per core.  Best of a few, so a stray context switch
+// doesn't count.
+// --------------------------------------------------------
+int RunGradingBenchmark()
+{
+	ColorGradeSettings grades[3];
+	MakeTestGrades(grades);
+
+	std::vector<unsigned int> threadCounts;
+	unsigned int cores = std::thread::hardware_concurrency();
+	for (unsigned int threads = 1; threads < cores; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(cores > 0 ? cores : 1);
+
+	auto bestOf = [&](auto bake)
+	{
+		double best = 1e30;
+		for (int i = 0; i < 10; i++)
+		{
+			double start = TestMilliseconds();
+			bake();
+			best = fmin(best, TestMilliseconds() - start);
+		}
+		return best;
+	};
+
+	std::vector<unsigned char> lut;
+	double referenceMs = bestOf([&]() { BakeColorLutReference(grades[1], lut); });
+	printf("Bake: %u^3 entries, the warm grade\n", ColorLutSize);
+	printf("  Reference   %6.2f ms\n", referenceMs);
+	for (unsigned int threads : threadCounts)
+	{
+		double ms = bestOf([&]() { BakeColorLut(grades[1], lut, threads); });
+		printf("  %2u thread%s  %6.2f ms  %.1fx\n", threads, threads == 1 ? " " : "s", ms, referenceMs / ms);
+	}
+	return 0;
+}
@@ -0,0 +1,119 @@
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+
+#include "../ConstantBufferRing.h"
+#include "../NullBackend.h"
+#include "EngineTests.h"
+
+namespace
+{
+	// Null context whose Map() can be made to fail
+	class FailingMapContext : public NullGraphicsContext
+	{
+	public:
+		FailingMapContext(std::shared_ptr<NullGraphicsStats> stats) : NullGraphicsContext(stats), Fail(false) {}
+
+		HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) override
+		{
+			if (Fail)
+				return E_OUTOFMEMORY;
+			return NullGraphicsContext::Map(resource, subresource, mapType, mapFlags, mapped);
+		}
+
+		bool Fail;
+	};
+}
+
+// --------------------------------------------------------
+// Checks the ring allocator on its own, and the constant
+// buffer ring over the null backend:
+// - Sizes round up to the alignment (zero included), and
+//   the capacity rounds down to it
+// - An allocation that doesn't fit before the end skips to
+//   the start, with the skipped bytes counted as used
+// - Space only comes back once its frame is retired, oldest
+//   frame first
+// - Undo() puts everything back, wraps included
+// - A ring whose Map() fails keeps no space for it
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunConstantBufferRingTests()
+{
+	bool passed = true;
+
+	// Alignment
+	RingAllocator aligned(1000, 256);
+	unsigned int offsets[3] = {};
+	bool alignPassed = aligned.GetCapacity() == 768;
+	alignPassed &= aligned.Allocate(1, offsets[0]) && aligned.Allocate(0, offsets[1]) && aligned.Allocate(257, offsets[2]) == false;
+	alignPassed &= offsets[0] == 0 && offsets[1] == 256 && aligned.GetUsed() == 512;
+	alignPassed &= !aligned.Allocate(1024, offsets[2]);
+	passed &= alignPassed;
+	printf("Alignment:  sizes round up, capacity rounds down  %s\n", alignPassed ? "ok" : "FAILED");
+
+	// Wraparound
+	RingAllocator ring(1024, 256);
+	unsigned int offset = 0;
+	bool wrapPassed = ring.Allocate(512, offset) && offset == 0;
+	ring.EndFrame();
+	wrapPassed &= ring.Allocate(256, offset) && offset == 512;
+	ring.EndFrame();
+	wrapPassed &= ring.RetireFrame() && ring.GetUsed() == 256;
+
+	// 512 bytes don't fit in the last 256, so they go to the
+	// start and the last 256 are padding
+	wrapPassed &= ring.Allocate(512, offset) && offset == 0 && ring.GetWrapCount() == 1 && ring.GetUsed() == 1024;
+	passed &= wrapPassed;
+	printf("Wrap:       skips the end of the region, padding counted  %s\n", wrapPassed ? "ok" : "FAILED");
+
+	// Retirement
+	bool retirePassed = !ring.Allocate(1, offset);
+	ring.EndFrame();
+	retirePassed &= ring.GetFramesInFlight() == 2 && !ring.Allocate(1, offset);
+
+	// Only the 256 bytes at 512 are free after the oldest goes
+	retirePassed &= ring.RetireFrame() && ring.GetUsed() == 768;
+	retirePassed &= ring.Allocate(256, offset) && offset == 512 && !ring.Allocate(1, offset);
+	ring.EndFrame();
+	retirePassed &= ring.RetireFrame() && ring.GetUsed() == 256;
+	retirePassed &= ring.RetireFrame() && ring.GetUsed() == 0 && !ring.RetireFrame();
+	retirePassed &= ring.Allocate(512, offset) && offset == 0 && ring.GetWrapCount() == 2;
+	passed &= retirePassed;
+	printf("Retire:     space comes back a whole frame at a time  %s\n", retirePassed ? "ok" : "FAILED");
+
+	// Undo
+	RingAllocator undone(1024, 256);
+	undone.Allocate(768, offset);
+	undone.EndFrame();
+	undone.RetireFrame();
+	bool undoPassed = undone.Allocate(512, offset) && offset == 0 && undone.GetWrapCount() == 1;
+	undone.Undo();
+	undoPassed &= undone.GetUsed() == 0 && undone.GetWrapCount() == 0;
+	undoPassed &= undone.Allocate(256, offset) && offset == 768;
+	passed &= undoPassed;
+	printf("Undo:       puts back the head, the bytes and the wrap  %s\n", undoPassed ? "ok" : "FAILED");
+
+	// Failed maps
+	std::shared_ptr<NullGraphicsStats> stats = std::make_shared<NullGraphicsStats>();
+	std::shared_ptr<FailingMapContext> context = std::make_shared<FailingMapContext>(stats);
+	ConstantBufferRing buffers(std::make_shared<NullGraphicsDevice>(stats), context, 1024);
+	unsigned char data[256];
+	memset(data, 3, sizeof(data));
+	ConstantBufferSlice slice;
+	buffers.BeginFrame();
+	context->Fail = true;
+	bool mapPassed = true;
+	for (int i = 0; i < 8; i++)
+		mapPassed &= !buffers.Allocate(data, sizeof(data), slice);
+	context->Fail = false;
+	for (int i = 0; i < 4; i++)
+		mapPassed &= buffers.Allocate(data, sizeof(data), slice) && slice.FirstConstant == (UINT)i * 16;
+	mapPassed &= buffers.GetFrameFallbacks() == 8 && buffers.GetFrameAllocations() == 4 && buffers.GetFrameBytes() == 1024;
+	buffers.EndFrame();
+	passed &= mapPassed;
+	printf("Map:        a failed map gives its space back  %s\n", mapPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All constant buffer ring checks passed" : "Constant buffer ring checks FAILED");
+	return passed ? 0 : 1;
+}
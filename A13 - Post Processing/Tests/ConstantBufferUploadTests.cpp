@@ -0,0 +1,343 @@
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../ConstantBuffer.h"
+#include "../NullBackend.h"
+#include "../ShaderStructs.h"
+#include "../SharedConstantBuffer.h"
+#include "EngineTests.h"
+#include "ReflectedShader.h"
+
+namespace
+{
+	// Null context that remembers each UpdateSubresource(), and
+	// what was last bound to the pixel shader's first slot
+	class UploadRecordingContext : public NullGraphicsContext
+	{
+	public:
+		UploadRecordingContext(std::shared_ptr<NullGraphicsStats> stats) :
+			NullGraphicsContext(stats), Updates(0), Boxed(false), Box(), Bound(0), BoundConstant(0), BoundByOffset(false) {}
+
+		void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch) override
+		{
+			Updates++;
+			Boxed = box != 0;
+			Box = box ? *box : D3D11_BOX();
+			NullGraphicsContext::UpdateSubresource(resource, subresource, box, data, rowPitch, depthPitch);
+		}
+
+		void PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override
+		{
+			if (startSlot == 0 && numBuffers > 0)
+			{
+				Bound = buffers[0];
+				BoundConstant = 0;
+				BoundByOffset = false;
+			}
+			NullGraphicsContext::PSSetConstantBuffers(startSlot, numBuffers, buffers);
+		}
+
+		void PSSetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstant, const UINT* numConstants) override
+		{
+			if (startSlot == 0 && numBuffers > 0)
+			{
+				Bound = buffers[0];
+				BoundConstant = firstConstant[0];
+				BoundByOffset = true;
+			}
+			NullGraphicsContext::PSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstant, numConstants);
+		}
+
+		unsigned int Updates;
+		bool Boxed;
+		D3D11_BOX Box;
+		ID3D11Buffer* Bound;
+		UINT BoundConstant;
+		bool BoundByOffset;
+	};
+
+	// Whether a buffer's memory holds the given bytes
+	bool Holds(IGraphicsContext& context, ID3D11Buffer* buffer, unsigned int offset, const unsigned char* expected, unsigned int size)
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(context.Map(buffer, 0, D3D11_MAP_READ, 0, &mapped)))
+			return false;
+		bool same = memcmp((const unsigned char*)mapped.pData + offset, expected, size) == 0;
+		context.Unmap(buffer, 0);
+		return same;
+	}
+
+	// Reflection for a cbuffer laid out like one of the structs
+	// in ShaderStructs.h
+	ShaderReflectionData ReflectStruct(const char* name, const ShaderStructField* fields, size_t fieldCount)
+	{
+		ShaderReflectionData data;
+		ShaderReflectionData::ConstantBuffer cbuffer;
+		cbuffer.Name = name;
+		for (size_t i = 0; i < fieldCount; i++)
+			AddReflectedVariable(cbuffer, fields[i].Name, fields[i].ByteOffset, fields[i].Size);
+		data.ConstantBuffers.push_back(cbuffer);
+		return data;
+	}
+
+	// Reflection for one ExternalData cbuffer of 64 byte matrices,
+	// as the shaders declared before their constants were split
+	ShaderReflectionData ReflectMatrices(const std::vector<const char*>& names)
+	{
+		ShaderReflectionData data;
+		ShaderReflectionData::ConstantBuffer cbuffer;
+		cbuffer.Name = "ExternalData";
+		for (size_t i = 0; i < names.size(); i++)
+			AddReflectedVariable(cbuffer, names[i], (unsigned int)i * 64, 64);
+		data.ConstantBuffers.push_back(cbuffer);
+		return data;
+	}
+
+	// Sends a shader's whole cbuffer, as CopyAllBufferData() did
+	// every draw before anything was tracked
+	void UploadWhole(ReflectedShader& shader)
+	{
+		SimpleConstantBuffer* cb = shader.GetBuffer(0);
+		cb->Dirty.Add(0, cb->Size);
+		shader.Upload(0);
+	}
+}
+
+// --------------------------------------------------------
+// Checks how SimpleShader sends constant data, through a
+// context that records every upload:
+// - DirtyRange must grow to cover what's added, widen to
+//   whole constants without passing the buffer's end, and
+//   clear
+// - A buffer with nothing new must be skipped
+// - A small change must go out as a boxed update of just
+//   the constants it touched
+// - With a ring, the whole buffer must go into a slice of
+//   it, again each frame, and in full to the shader's own
+//   buffer once the ring is gone
+// - A frame of the game's scene, split by update frequency,
+//   must send only PerObject per draw once its materials
+//   are up to date, and less than the old layout did
+// - A typed buffer must go into a new slice of the ring on
+//   every upload, rebound by offset on the shader it's set
+//   on, and back to its own buffer once the ring is gone
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunConstantBufferUploadTests()
+{
+	bool passed = true;
+
+	// Dirty ranges
+	DirtyRange range;
+	bool rangePassed = range.IsEmpty() && range.Size() == 0;
+	range.Add(100, 0);
+	rangePassed &= range.IsEmpty();
+	range.Add(20, 4);
+	rangePassed &= range.Start == 20 && range.End == 24;
+	range.Add(8, 4);
+	range.Add(40, 8);
+	rangePassed &= range.Start == 8 && range.End == 48 && range.Size() == 40;
+	DirtyRange aligned = range.Aligned(64);
+	rangePassed &= aligned.Start == 0 && aligned.End == 48;
+	aligned = range.Aligned(40);
+	rangePassed &= aligned.Start == 0 && aligned.End == 40;
+	range.Add(17, 1);
+	aligned = range.Aligned(256);
+	rangePassed &= aligned.Start == 0 && aligned.End == 48 && DirtyRange().Aligned(256).IsEmpty();
+	range.Clear();
+	rangePassed &= range.IsEmpty() && range.Size() == 0;
+	passed &= rangePassed;
+	printf("Range:      adds, aligns to constants and clears  %s\n", rangePassed ? "ok" : "FAILED");
+
+	std::shared_ptr<NullGraphicsStats> stats = std::make_shared<NullGraphicsStats>();
+	std::shared_ptr<NullGraphicsDevice> device = std::make_shared<NullGraphicsDevice>(stats);
+	std::shared_ptr<UploadRecordingContext> context = std::make_shared<UploadRecordingContext>(stats);
+
+	ShaderReflectionData data;
+	ShaderReflectionData::ConstantBuffer cbuffer;
+	cbuffer.Name = "ExternalData";
+	AddReflectedVariable(cbuffer, "world", 0, 64);
+	AddReflectedVariable(cbuffer, "colorTint", 64, 16);
+	AddReflectedVariable(cbuffer, "roughness", 84, 4);
+	AddReflectedVariable(cbuffer, "lights", 96, 160);
+	data.ConstantBuffers.push_back(cbuffer);
+	ReflectedShader shader(device, context, data);
+	SimpleConstantBuffer* cb = shader.GetBuffer(0);
+
+	// A new shader's data has never been sent, so it all goes
+	shader.Upload(0);
+	bool skipPassed = context->Updates == 1 && !context->Boxed;
+
+	// Then nothing changes
+	unsigned long long skipped = ISimpleShader::SkippedUploads;
+	shader.Upload(0);
+	shader.SetFloat("roughness", 0.0f);
+	shader.Upload(0);
+	skipPassed &= context->Updates == 1 && ISimpleShader::SkippedUploads == skipped + 2 && cb->Dirty.IsEmpty();
+	passed &= skipPassed;
+	printf("Skip:       unchanged data isn't sent again  %s\n", skipPassed ? "ok" : "FAILED");
+
+	// One float, sent as its whole constant
+	unsigned long long uploaded = stats->UploadedBytes;
+	shader.SetFloat("roughness", 0.5f);
+	shader.Upload(0);
+	bool boxPassed = context->Updates == 2 && context->Boxed && context->Box.left == 80 && context->Box.right == 96 &&
+		context->Box.bottom == 1 && context->Box.back == 1 && stats->UploadedBytes == uploaded + 16 &&
+		Holds(*context, cb->ConstantBuffer.Get(), 0, cb->LocalDataBuffer, cb->Size);
+	passed &= boxPassed;
+	printf("Box:        a small change sends only its constants  %s\n", boxPassed ? "ok" : "FAILED");
+
+	// Through a ring
+	std::shared_ptr<ConstantBufferRing> ring = std::make_shared<ConstantBufferRing>(device, context, 64 * 1024);
+	ISimpleShader::BufferRing = ring;
+	ring->BeginFrame();
+	shader.SetFloat("roughness", 0.25f);
+	shader.Upload(0);
+	ConstantBufferSlice slice = cb->Slice;
+	bool ringPassed = context->Updates == 2 && ring->IsCurrent(slice) && ring->GetFrameAllocations() == 1 &&
+		slice.NumConstants * 16 >= cb->Size && Holds(*context, slice.Buffer, slice.FirstConstant * 16, cb->LocalDataBuffer, cb->Size);
+	shader.Upload(0);
+	ringPassed &= ring->GetFrameAllocations() == 1;
+
+	// Slices only last a frame, so clean data goes again
+	ring->EndFrame();
+	ring->BeginFrame();
+	shader.Upload(0);
+	ringPassed &= ring->GetFrameAllocations() == 1 && ring->IsCurrent(cb->Slice) && cb->Slice.FirstConstant != slice.FirstConstant;
+	ring->EndFrame();
+
+	// The shader's own buffer missed everything the ring got
+	ISimpleShader::BufferRing.reset();
+	shader.Upload(0);
+	ringPassed &= context->Updates == 3 && !context->Boxed && cb->Slice.Buffer == 0 &&
+		Holds(*context, cb->ConstantBuffer.Get(), 0, cb->LocalDataBuffer, cb->Size);
+	passed &= ringPassed;
+	printf("Ring:       whole buffers go to a slice each frame  %s\n", ringPassed ? "ok" : "FAILED");
+
+	// The game's scene: 8 entities in 2 materials, all but the
+	// floor casting shadows.  The sky reads PerFrame.
+	const unsigned int entities = 8;
+	const unsigned int casters = entities - 1;
+	ConstantBuffer<PerFrameConstants> frameConstants(device, context);
+	ConstantBuffer<PerObjectConstants> objectConstants(device, context);
+	std::shared_ptr<ReflectedShader> materialLayout = std::make_shared<ReflectedShader>(device, context,
+		ReflectStruct(PerMaterialConstants::BufferName, PerMaterialConstants::Fields, sizeof(PerMaterialConstants::Fields) / sizeof(PerMaterialConstants::Fields[0])));
+	SharedConstantBuffer materials[] =
+	{
+		SharedConstantBuffer(device, context, materialLayout, PerMaterialConstants::BufferName),
+		SharedConstantBuffer(device, context, materialLayout, PerMaterialConstants::BufferName),
+	};
+
+	// Two frames, as Game::Draw() sends them; materials are new
+	// in the first, so only the second's draws are checked
+	bool framePassed = true;
+	unsigned long long splitBytes = 0;
+	for (int f = 0; f < 2; f++)
+	{
+		unsigned long long frameStart = ISimpleShader::UploadedBytes;
+		frameConstants.Data.cameraPosition.x = (float)f;
+		frameConstants.Upload();
+
+		for (unsigned int i = 0; i < casters; i++)
+		{
+			unsigned long long drawStart = ISimpleShader::UploadedBytes;
+			objectConstants.Data.world._41 = (float)i;
+			objectConstants.Upload();
+			framePassed &= ISimpleShader::UploadedBytes - drawStart == sizeof(PerObjectConstants);
+		}
+
+		for (unsigned int i = 0; i < entities; i++)
+		{
+			unsigned long long drawStart = ISimpleShader::UploadedBytes;
+			SharedConstantBuffer& material = materials[i == entities - 1 ? 1 : 0];
+			material.SetFloat4("colorTint", { 1, 1, 1, 1 });
+			material.SetFloat("roughness", i == entities - 1 ? 1.0f : 0.5f);
+			material.Upload();
+			objectConstants.Data.world._41 = (float)i;
+			objectConstants.Upload();
+			if (f > 0)
+				framePassed &= ISimpleShader::UploadedBytes - drawStart == sizeof(PerObjectConstants);
+		}
+		splitBytes = ISimpleShader::UploadedBytes - frameStart;
+	}
+
+	// The same frame before the split: the shadow, main and sky
+	// vertex shaders each had one cbuffer of matrices, and the
+	// main pixel shader one of material, camera and lights
+	ReflectedShader oldShadowVS(device, context, ReflectMatrices({ "world", "view", "projection" }));
+	ReflectedShader oldSkyVS(device, context, ReflectMatrices({ "view", "projection" }));
+	ReflectedShader oldVS(device, context, ReflectMatrices({ "world", "worldInverseTranspose", "view", "projection", "lightView", "lightProjection" }));
+	ShaderReflectionData oldPSData;
+	ShaderReflectionData::ConstantBuffer oldPSBuffer;
+	oldPSBuffer.Name = "ExternalData";
+	AddReflectedVariable(oldPSBuffer, "colorTint", 0, 16);
+	AddReflectedVariable(oldPSBuffer, "scale", 16, 8);
+	AddReflectedVariable(oldPSBuffer, "offset", 24, 8);
+	AddReflectedVariable(oldPSBuffer, "cameraPosition", 32, 12);
+	AddReflectedVariable(oldPSBuffer, "roughness", 44, 4);
+	AddReflectedVariable(oldPSBuffer, "ambient", 48, 12);
+	AddReflectedVariable(oldPSBuffer, "lights", 64, 320);
+	oldPSData.ConstantBuffers.push_back(oldPSBuffer);
+	ReflectedShader oldPS(device, context, oldPSData);
+
+	unsigned long long frameStart = ISimpleShader::UploadedBytes;
+	for (unsigned int i = 0; i < casters; i++)
+		UploadWhole(oldShadowVS);
+	for (unsigned int i = 0; i < entities; i++)
+	{
+		UploadWhole(oldVS);
+		UploadWhole(oldPS);
+	}
+	UploadWhole(oldSkyVS);
+	unsigned long long oldBytes = ISimpleShader::UploadedBytes - frameStart;
+
+	framePassed &= splitBytes == sizeof(PerFrameConstants) + (casters + entities) * sizeof(PerObjectConstants) && splitBytes < oldBytes;
+	passed &= framePassed;
+	printf("Frame:      draws send only PerObject, %llu bytes a frame (%llu before the split)  %s\n", splitBytes, oldBytes, framePassed ? "ok" : "FAILED");
+
+	// A typed buffer set once, then refilled for each draw as
+	// the shadow casters are
+	std::shared_ptr<ReflectedShader> objectShader = std::make_shared<ReflectedShader>(device, context,
+		ReflectStruct(PerObjectConstants::BufferName, PerObjectConstants::Fields, sizeof(PerObjectConstants::Fields) / sizeof(PerObjectConstants::Fields[0])));
+	ISimpleShader::BufferRing = ring;
+	ring->BeginFrame();
+	bool typedPassed = objectConstants.BindTo(objectShader);
+	objectShader->SetShader();
+	uploaded = ISimpleShader::UploadedBytes;
+	unsigned int lastConstant = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		objectConstants.Data.world._41 = (float)i;
+		objectConstants.Upload();
+		const ConstantBufferSlice& typedSlice = objectConstants.GetSlice();
+		typedPassed &= ring->IsCurrent(typedSlice) && ring->GetFrameAllocations() == (unsigned int)i + 1 &&
+			Holds(*context, typedSlice.Buffer, typedSlice.FirstConstant * 16, (const unsigned char*)&objectConstants.Data, sizeof(PerObjectConstants)) &&
+			context->BoundByOffset && context->Bound == typedSlice.Buffer && context->BoundConstant == typedSlice.FirstConstant &&
+			(i == 0 || typedSlice.FirstConstant != lastConstant);
+		lastConstant = typedSlice.FirstConstant;
+	}
+	typedPassed &= ISimpleShader::UploadedBytes == uploaded + 3 * sizeof(PerObjectConstants);
+
+	// Binding the shader in a later frame can't use the old slice
+	ring->EndFrame();
+	ring->BeginFrame();
+	objectShader->SetShader();
+	typedPassed &= !context->BoundByOffset && context->Bound == objectConstants.GetBuffer().Get();
+	objectConstants.Upload();
+	typedPassed &= context->BoundByOffset && ring->IsCurrent(objectConstants.GetSlice());
+	ring->EndFrame();
+
+	// Without the ring the buffer itself is filled and bound
+	ISimpleShader::BufferRing.reset();
+	objectConstants.Data.world._41 = 10.0f;
+	objectConstants.Upload();
+	typedPassed &= objectConstants.GetSlice().Buffer == 0 && !context->BoundByOffset && context->Bound == objectConstants.GetBuffer().Get() &&
+		Holds(*context, objectConstants.GetBuffer().Get(), 0, (const unsigned char*)&objectConstants.Data, sizeof(PerObjectConstants));
+	passed &= typedPassed;
+	printf("Typed:      typed buffers go to the ring, bound by offset  %s\n", typedPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All constant buffer upload checks passed" : "Constant buffer upload checks FAILED");
+	return passed ? 0 : 1;
+}
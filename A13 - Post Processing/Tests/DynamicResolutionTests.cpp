@@ -0,0 +1,204 @@
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include "../DynamicResolution.h"
+#include "../GpuFrameTimer.h"
+#include "../NullBackend.h"
+#include "EngineTests.h"
+
+// --------------------------------------------------------
+// Checks the dynamic resolution controller against made up
+// frame time traces, where a frame takes a fixed time plus
+// a time for its pixels (the scale squared):
+// - Quantized scales must stay within the min and max, never
+//   go down as the scale goes up, be within half a step of
+//   it, and come in as many steps as RenderScaleSteps() says,
+//   the min included when the steps miss it
+// - A light scene must stay at the max scale, and one too
+//   heavy even at the min must go to the min and stay there
+// - A scene that fits the budget partway must settle on a
+//   step within it and stop moving
+// - With noise on the frame times, the hysteresis must keep
+//   the scale from moving more than once a second, and move
+//   it less often than without it
+// - After the load goes up it must be back under the budget
+//   within a second, and back at the max after it drops
+// - A single long frame must move the scale one step at most
+// - With frame times rounded up to whole vsync intervals, a
+//   light scene must stay at the max and one that fits the
+//   interval partway must settle on a step within it, rather
+//   than falling to the min
+// - The GPU timer must have no time to give without a real
+//   device, so the whole frame's is used
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunResolutionTests()
+{
+	bool passed = true;
+	DynamicResolutionSettings settings;
+
+	// Every scale from below the min to above the max, with
+	// steps that land on the min and steps that don't
+	bool quantizePassed = true;
+	DynamicResolutionSettings uneven = settings;
+	uneven.ScaleStep = 0.15f;
+	unsigned int evenSteps = 0, unevenSteps = 0;
+	for (const DynamicResolutionSettings* s : { &settings, &uneven })
+	{
+		std::vector<float> seen;
+		float previous = 0.0f;
+		for (float scale = 0.0f; scale <= 1.2f; scale += 0.001f)
+		{
+			float clamped = scale < s->MinScale ? s->MinScale : scale > s->MaxScale ? s->MaxScale : scale;
+			float q = QuantizeRenderScale(scale, *s);
+			quantizePassed &= q >= s->MinScale && q <= s->MaxScale && q >= previous &&
+				fabsf(q - clamped) <= s->ScaleStep * 0.5f + 1e-4f;
+			if (seen.empty() || seen.back() != q)
+				seen.push_back(q);
+			previous = q;
+		}
+		quantizePassed &= seen.size() == RenderScaleSteps(*s) && seen.front() == s->MinScale && seen.back() == s->MaxScale;
+		(s == &settings ? evenSteps : unevenSteps) = (unsigned int)seen.size();
+	}
+	passed &= quantizePassed;
+	printf("Quantize:   %u steps of %.2f, %u of %.2f down to %.2f  %s\n", evenSteps, settings.ScaleStep,
+		unevenSteps, uneven.ScaleStep, uneven.MinScale, quantizePassed ? "ok" : "FAILED");
+
+	// A trace: the frame time at each scale, for a number of
+	// frames, fed back through the controller.  With a refresh
+	// interval the frame waits for the next refresh after its
+	// work, and is presented up to half a millisecond off it.
+	std::mt19937 random(540);
+	std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+	struct Run
+	{
+		std::vector<float> Scales;
+		std::vector<float> Times;
+	};
+	auto run = [&](ResolutionController& controller, const DynamicResolutionSettings& s,
+		float fixedMs, float pixelMs, unsigned int frames, float noise, float refreshMs = 0.0f)
+	{
+		Run result;
+		float scale = controller.Update(0.0f, s);
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			float ms = (fixedMs + pixelMs * scale * scale) * (1.0f + noise * jitter(random));
+			if (refreshMs > 0.0f)
+				ms = ceilf(ms / refreshMs) * refreshMs + 0.5f * jitter(random);
+			result.Scales.push_back(scale);
+			result.Times.push_back(ms);
+			scale = controller.Update(ms, s);
+		}
+		return result;
+	};
+	auto changes = [](const Run& r, unsigned int from)
+	{
+		unsigned int count = 0;
+		for (unsigned int f = from + 1; f < r.Scales.size(); f++)
+			count += r.Scales[f] != r.Scales[f - 1];
+		return count;
+	};
+
+	ResolutionController light;
+	Run lightRun = run(light, settings, 2.0f, 8.0f, 600, 0.0f);
+	ResolutionController heavy;
+	Run heavyRun = run(heavy, settings, 10.0f, 40.0f, 600, 0.0f);
+	unsigned int toMin = 0;
+	while (toMin < heavyRun.Scales.size() && heavyRun.Scales[toMin] != settings.MinScale)
+		toMin++;
+	bool limitsPassed = changes(lightRun, 0) == 0 && lightRun.Scales.back() == settings.MaxScale &&
+		toMin < heavyRun.Scales.size() && changes(heavyRun, toMin) == 0;
+	passed &= limitsPassed;
+	printf("Limits:     light stays at %.2f, heavy at %.2f after %u frames  %s\n", lightRun.Scales.back(),
+		heavyRun.Scales.back(), toMin, limitsPassed ? "ok" : "FAILED");
+
+	// 4 ms plus 20 at full size fits 16.6 at 0.75
+	ResolutionController settling;
+	Run settleRun = run(settling, settings, 4.0f, 20.0f, 600, 0.0f);
+	bool settlePassed = changes(settleRun, 300) == 0;
+	for (unsigned int f = 300; f < 600; f++)
+		settlePassed &= settleRun.Times[f] <= settings.BudgetMs;
+	passed &= settlePassed;
+	printf("Settle:     %.2f, %.2f ms a frame, %u changes  %s\n", settleRun.Scales.back(), settleRun.Times.back(),
+		settling.GetChangeCount(), settlePassed ? "ok" : "FAILED");
+
+	// The same with 10% noise, and with no hysteresis at all
+	DynamicResolutionSettings eager = settings;
+	eager.Headroom = 0.0f;
+	eager.StepHysteresis = 0.0f;
+	ResolutionController steady, twitchy;
+	Run steadyRun = run(steady, settings, 4.0f, 20.0f, 1200, 0.1f);
+	Run twitchyRun = run(twitchy, eager, 4.0f, 20.0f, 1200, 0.1f);
+	double steadyMean = 0;
+	for (unsigned int f = 600; f < 1200; f++)
+		steadyMean += steadyRun.Times[f] / 600;
+	bool noisePassed = changes(steadyRun, 600) <= 10 && changes(steadyRun, 600) < changes(twitchyRun, 600) &&
+		steadyMean <= settings.BudgetMs;
+	passed &= noisePassed;
+	printf("Noise:      %u changes in 600 frames (%u without hysteresis), %.2f ms average  %s\n",
+		changes(steadyRun, 600), changes(twitchyRun, 600), steadyMean, noisePassed ? "ok" : "FAILED");
+
+	// Light, then heavier, then light again
+	ResolutionController stepped;
+	run(stepped, settings, 2.0f, 8.0f, 300, 0.0f);
+	Run upRun = run(stepped, settings, 4.0f, 20.0f, 300, 0.0f);
+	Run downRun = run(stepped, settings, 2.0f, 8.0f, 600, 0.0f);
+	unsigned int toBudget = 0, toMax = 0;
+	while (toBudget < upRun.Times.size() && upRun.Times[toBudget] > settings.BudgetMs)
+		toBudget++;
+	while (toMax < downRun.Scales.size() && downRun.Scales[toMax] != settings.MaxScale)
+		toMax++;
+	bool stepPassed = toBudget <= 60 && toMax < downRun.Scales.size();
+	passed &= stepPassed;
+	printf("Step:       under budget %u frames after the load goes up, back at the max %u after it drops  %s\n",
+		toBudget, toMax, stepPassed ? "ok" : "FAILED");
+
+	// One 100 ms frame in the middle of a settled run
+	float before = settling.GetScale();
+	float lowest = settling.Update(100.0f, settings);
+	for (int f = 0; f < 120; f++)
+	{
+		float s = settling.GetScale();
+		float now = settling.Update(4.0f + 20.0f * s * s, settings);
+		lowest = now < lowest ? now : lowest;
+	}
+	bool hitchPassed = before - lowest <= settings.ScaleStep * 1.01f && settling.GetScale() == before;
+	passed &= hitchPassed;
+	printf("Hitch:      %.2f down to %.2f, back to %.2f  %s\n", before, lowest, settling.GetScale(),
+		hitchPassed ? "ok" : "FAILED");
+
+	// At 60 Hz, the light scene and the one that fits at 0.75,
+	// and the light one against a budget just under a refresh
+	// without knowing frames are vsynced
+	const float refreshMs = 1000.0f / 60.0f;
+	DynamicResolutionSettings vsynced = settings;
+	vsynced.RefreshMs = refreshMs;
+	ResolutionController vsyncLight, vsyncSettling, unaware;
+	Run vsyncLightRun = run(vsyncLight, vsynced, 2.0f, 8.0f, 600, 0.1f, refreshMs);
+	Run vsyncSettleRun = run(vsyncSettling, vsynced, 4.0f, 20.0f, 600, 0.0f, refreshMs);
+	Run unawareRun = run(unaware, settings, 2.0f, 8.0f, 600, 0.0f, refreshMs);
+	bool vsyncPassed = changes(vsyncLightRun, 0) == 0 && vsyncLightRun.Scales.back() == settings.MaxScale &&
+		changes(vsyncSettleRun, 300) == 0 && vsyncSettleRun.Scales.back() > settings.MinScale;
+	for (unsigned int f = 300; f < 600; f++)
+		vsyncPassed &= vsyncSettleRun.Times[f] < refreshMs * 1.5f;
+	passed &= vsyncPassed;
+	printf("Vsync:      light stays at %.2f, settles at %.2f, one refresh a frame (%.2f without the interval)  %s\n",
+		vsyncLightRun.Scales.back(), vsyncSettleRun.Scales.back(), unawareRun.Scales.back(), vsyncPassed ? "ok" : "FAILED");
+
+	std::shared_ptr<NullGraphicsStats> stats = std::make_shared<NullGraphicsStats>();
+	GpuFrameTimer timer(std::make_shared<NullGraphicsDevice>(stats), std::make_shared<NullGraphicsContext>(stats));
+	float timedMs = -1.0f;
+	for (unsigned int f = 0; f < GpuTimerFrames * 2; f++)
+	{
+		timer.BeginFrame();
+		timer.EndFrame();
+	}
+	bool timerPassed = !timer.GetFrameMs(timedMs) && timedMs == -1.0f;
+	passed &= timerPassed;
+	printf("Timer:      no GPU time without a device  %s\n", timerPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All resolution checks passed" : "Resolution checks FAILED");
+	return passed ? 0 : 1;
+}
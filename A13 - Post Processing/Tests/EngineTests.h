@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+
+// --------------------------------------------------------
+// The engine's self checks and benchmarks.  None of them
+// need a window or a GPU, so they build into the game (run
+// with a flag, e.g. "-null-test") and into the standalone
+// test target in Tests/CMakeLists.txt, which builds off
+// Windows against the headers in Tests/Shim.
+//
+// Each prints a line per check and returns 0 if all passed.
+// The benchmarks print their timings and return 0 unless
+// something they rely on failed.
+// --------------------------------------------------------
+
+int RunNullBackendTests();
+int RunStateCacheTests();
+int RunConstantBufferRingTests();
+int RunTraceTests();
+int RunShaderVarTests();
+int RunShaderVarBenchmark();
+int RunConstantBufferUploadTests();
+int RunShaderReflectionCacheTests();
+int RunHlslPackingTests();
+int RunShaderPermutationTests();
+int RunLightClusterTests();
+int RunLightClusterBenchmark();
+int RunPbrReferenceTests();
+int RunPbrBenchmark(unsigned int width, unsigned int height, unsigned int lights);
+int RunSphericalHarmonicsTests();
+int RunEnvironmentPrefilterTests();
+int RunIblBenchmark();
+int RunOcclusionTests();
+int RunShadowCascadeTests();
+int RunShadowCacheTests();
+int RunShadowAtlasTests();
+int RunBlurTests();
+int RunPostChainTests();
+int RunBloomTests();
+int RunPoolTests();
+int RunHdrTests();
+int RunGradingTests();
+int RunGradingBenchmark();
+int RunResolutionTests();
+
+// --------------------------------------------------------
+// A check or benchmark and the flag that runs it, for both
+// the game and the test target (the table is in
+// TestModes.cpp)
+// --------------------------------------------------------
+struct TestMode
+{
+	const char* Flag;
+	int (*Run)();
+	bool Timing;	// Only run when asked for by name
+};
+
+extern const TestMode TestModes[];
+extern const unsigned int TestModeCount;
+const TestMode* FindTestMode(const char* commandLine);
+
+// --------------------------------------------------------
+// Wall clock time in milliseconds, for the timing modes
+// --------------------------------------------------------
+inline double TestMilliseconds()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
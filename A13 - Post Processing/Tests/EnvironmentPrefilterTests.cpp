@@ -0,0 +1,328 @@
+#include <filesystem>
+#include <math.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "../EnvironmentPrefilter.h"
+#include "EngineTests.h"
+
+namespace
+{
+	const double Pi = 3.14159265358979;
+
+	// --------------------------------------------------------
+	// A gradient with a sun in it, as 8-bit faces like the
+	// real ones.  The sun is soft enough that a few hundred
+	// samples of the rough mips can't miss it entirely.
+	// --------------------------------------------------------
+	class TestSky
+	{
+	public:
+		TestSky(unsigned int size, float sunPower)
+		{
+			for (unsigned int face = 0; face < 6; face++)
+			{
+				pixels[face].resize((size_t)size * size * 4);
+				for (unsigned int y = 0; y < size; y++)
+				{
+					for (unsigned int x = 0; x < size; x++)
+					{
+						float dir[3];
+						CubemapDirection(face, (x + 0.5f) * 2.0f / size - 1.0f, (y + 0.5f) * 2.0f / size - 1.0f, dir);
+						float sky = 0.2f + 0.5f * fmaxf(dir[1], 0.0f);
+						float sun = powf(fmaxf(0.6f * dir[0] + 0.8f * dir[1], 0.0f), sunPower);
+
+						unsigned char* texel = &pixels[face][((size_t)y * size + x) * 4];
+						texel[0] = (unsigned char)(255.0f * powf(fminf(sky * 0.6f + sun, 1.0f), 1.0f / 2.2f));
+						texel[1] = (unsigned char)(255.0f * powf(fminf(sky * 0.8f + sun, 1.0f), 1.0f / 2.2f));
+						texel[2] = (unsigned char)(255.0f * powf(fminf(sky + sun, 1.0f), 1.0f / 2.2f));
+						texel[3] = 255;
+					}
+				}
+				faces[face].Pixels = pixels[face].data();
+				faces[face].Width = size;
+				faces[face].Height = size;
+				faces[face].RowPitch = size * 4;
+			}
+		}
+
+		const CubemapFace* Faces() const { return faces; }
+
+	private:
+		std::vector<unsigned char> pixels[6];
+		CubemapFace faces[6];
+	};
+
+	double D_GGX(double NdotH, double a2)
+	{
+		double denom = NdotH * NdotH * (a2 - 1.0) + 1.0;
+		return a2 / (Pi * denom * denom);
+	}
+
+	// The solid angle from the cube's center to the part of
+	// a face from (0, 0) to (x, y)
+	double CornerSolidAngle(double x, double y)
+	{
+		return atan2(x * y, sqrt(x * x + y * y + 1.0));
+	}
+
+	// --------------------------------------------------------
+	// What a prefiltered texel should be, summed over every
+	// texel of the source's top mip: the environment weighted
+	// by D(h) * N dot L, with the view along the normal
+	// --------------------------------------------------------
+	void PrefilterReference(const EnvironmentCubemap& source, const float n[3], float roughness, double rgb[3])
+	{
+		double a = (double)roughness * roughness;
+		double a2 = a * a > 0.0000001 ? a * a : 0.0000001;
+		double sum[3] = {};
+		double total = 0;
+		unsigned int size = source.Size;
+		double step = 2.0 / size;
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			const float* texels = source.Texel(face, 0);
+			for (unsigned int y = 0; y < size; y++)
+			{
+				for (unsigned int x = 0; x < size; x++)
+				{
+					double u0 = x * step - 1.0, u1 = u0 + step;
+					double v0 = y * step - 1.0, v1 = v0 + step;
+					double solidAngle = CornerSolidAngle(u1, v1) - CornerSolidAngle(u0, v1) -
+						CornerSolidAngle(u1, v0) + CornerSolidAngle(u0, v0);
+
+					float l[3];
+					CubemapDirection(face, (float)(u0 + u1) * 0.5f, (float)(v0 + v1) * 0.5f, l);
+					double NdotL = n[0] * l[0] + n[1] * l[1] + n[2] * l[2];
+					if (NdotL <= 0)
+						continue;
+
+					// Halfway between the normal (the view) and l
+					double NdotH = sqrt((1.0 + NdotL) * 0.5);
+					double weight = D_GGX(NdotH, a2) * NdotL * solidAngle;
+					const float* texel = texels + ((size_t)y * size + x) * 4;
+					for (int c = 0; c < 3; c++)
+						sum[c] += texel[c] * weight;
+					total += weight;
+				}
+			}
+		}
+
+		for (int c = 0; c < 3; c++)
+			rgb[c] = total > 0 ? sum[c] / total : 0;
+	}
+
+	// --------------------------------------------------------
+	// One LUT texel by quadrature over half vectors, with the
+	// same Smith G (k = alpha / 2) and Fresnel split.  The
+	// half vectors' angle is stepped finely enough to resolve
+	// the GGX peak at the roughnesses checked.
+	// --------------------------------------------------------
+	void BrdfLutReference(double NdotV, double roughness, double& scale, double& bias)
+	{
+		double a = roughness * roughness;
+		double a2 = a * a;
+		double k = a * 0.5;
+		double view[3] = { sqrt(1.0 - NdotV * NdotV), 0.0, NdotV };
+		double G1V = NdotV / (NdotV * (1.0 - k) + k);
+
+		const int thetaSteps = 2048;
+		const int phiSteps = 128;
+		double dTheta = Pi * 0.5 / thetaSteps;
+		double dPhi = 2.0 * Pi / phiSteps;
+		scale = 0;
+		bias = 0;
+		for (int t = 0; t < thetaSteps; t++)
+		{
+			double theta = (t + 0.5) * dTheta;
+			double NdotH = cos(theta);
+			double D = D_GGX(NdotH, a2);
+			for (int p = 0; p < phiSteps; p++)
+			{
+				double phi = (p + 0.5) * dPhi;
+				double h[3] = { sin(theta) * cos(phi), sin(theta) * sin(phi), NdotH };
+				double VdotH = view[0] * h[0] + view[1] * h[1] + view[2] * h[2];
+				double NdotL = 2.0 * VdotH * h[2] - view[2];
+				if (NdotL <= 0 || VdotH <= 0)
+					continue;
+
+				// BRDF * N dot L, over half vectors (dL = 4 V.H dH)
+				double G = G1V * NdotL / (NdotL * (1.0 - k) + k);
+				double integrand = D * G / (4.0 * NdotV) * 4.0 * VdotH * sin(theta) * dTheta * dPhi;
+				double fresnel = pow(1.0 - VdotH, 5.0);
+				scale += (1.0 - fresnel) * integrand;
+				bias += fresnel * integrand;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Checks the reflection bake against reference integrals:
+// - Mip 0 must be the source, box filtered to its size
+// - Each rougher mip must match the environment integrated
+//   against the GGX lobe over every source texel, to within
+//   what a few hundred importance samples allow
+// - The BRDF LUT must match quadrature over the hemisphere
+// - Baked files must load back the same under the same key,
+//   and be refused if the key is wrong or they're cut short
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunEnvironmentPrefilterTests()
+{
+	bool passed = true;
+
+	// 64 pixel faces decoded at 32, so decoding averages too
+	TestSky sky(64, 16.0f);
+	EnvironmentCubemap source;
+	bool decodePassed = DecodeCubemap(sky.Faces(), 32, source) && source.Size == 32 && source.MipCount == 6;
+	CubemapFace uneven[6];
+	for (int f = 0; f < 6; f++)
+		uneven[f] = sky.Faces()[f];
+	uneven[2].Width = 32;
+	EnvironmentCubemap unused;
+	decodePassed &= !DecodeCubemap(uneven, 32, unused);
+	passed &= decodePassed;
+	printf("Decode:     box filtered to the size asked for  %s\n", decodePassed ? "ok" : "FAILED");
+
+	EnvironmentCubemap prefiltered;
+	bool prefilterPassed = PrefilterSpecular(source, 16, 5, 512, prefiltered, 1) && prefiltered.MipCount == 5;
+
+	// A mirror reads the source mip of the same size
+	float mirrorDifference = 0;
+	for (unsigned int face = 0; face < 6 && prefilterPassed; face++)
+	{
+		const float* a = prefiltered.Texel(face, 0);
+		const float* b = source.Texel(face, 1);
+		for (size_t i = 0; i < (size_t)16 * 16 * 4; i++)
+			mirrorDifference = fmaxf(mirrorDifference, fabsf(a[i] - b[i]));
+	}
+	prefilterPassed &= mirrorDifference < 1e-5f;
+
+	// Rougher mips against the integral, relative to its
+	// brightness; every texel of the small mips, and a
+	// spread of the larger ones
+	float worst = 0;
+	for (unsigned int mip = 1; mip < prefiltered.MipCount && prefilterPassed; mip++)
+	{
+		unsigned int mipSize = prefiltered.MipSize(mip);
+		unsigned int stride = mipSize > 4 ? 3 : 1;
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			for (unsigned int y = 0; y < mipSize; y += stride)
+			{
+				for (unsigned int x = 0; x < mipSize; x += stride)
+				{
+					float n[3];
+					CubemapDirection(face, (x + 0.5f) * 2.0f / mipSize - 1.0f, (y + 0.5f) * 2.0f / mipSize - 1.0f, n);
+					double reference[3];
+					PrefilterReference(source, n, SpecularMipRoughness(mip, prefiltered.MipCount), reference);
+
+					const float* texel = prefiltered.Texel(face, mip) + ((size_t)y * mipSize + x) * 4;
+					double brightness = fmax(reference[0], fmax(reference[1], reference[2]));
+					for (int c = 0; c < 3; c++)
+						worst = fmaxf(worst, (float)(fabs(texel[c] - reference[c]) / brightness));
+				}
+			}
+		}
+	}
+	prefilterPassed &= worst < 0.03f;
+	passed &= prefilterPassed;
+	printf("Prefilter:  mirror off by %g, rough mips off the integral by %.2f%% at most  %s\n",
+		mirrorDifference, worst * 100.0f, prefilterPassed ? "ok" : "FAILED");
+
+	// Threads split rows, not sums, so they change nothing
+	EnvironmentCubemap threaded;
+	bool threadPassed = PrefilterSpecular(source, 16, 5, 512, threaded, 4) && threaded.Texels == prefiltered.Texels;
+	passed &= threadPassed;
+	printf("Threads:    4 threads bake the same as 1  %s\n", threadPassed ? "ok" : "FAILED");
+
+	// The LUT, away from the smoothest rows the quadrature
+	// can't resolve
+	const unsigned int lutSize = 32;
+	BrdfLut lut;
+	IntegrateBrdfLut(lutSize, 1024, lut, 1);
+	float worstLut = 0;
+	for (unsigned int y = 8; y < lutSize; y += 5)
+	{
+		for (unsigned int x = 0; x < lutSize; x += 5)
+		{
+			double scale, bias;
+			BrdfLutReference((x + 0.5) / lutSize, (y + 0.5) / lutSize, scale, bias);
+			const float* texel = lut.Texels.data() + ((size_t)y * lutSize + x) * 2;
+			worstLut = fmaxf(worstLut, (float)fmax(fabs(texel[0] - scale), fabs(texel[1] - bias)));
+		}
+	}
+	bool lutPassed = lut.Size == lutSize && worstLut < 0.01f;
+	passed &= lutPassed;
+	printf("BRDF LUT:   off the quadrature by %g at most  %s\n", worstLut, lutPassed ? "ok" : "FAILED");
+
+	// Bake files
+	std::filesystem::path cubePath = std::filesystem::temp_directory_path() / "ibl-test.envc";
+	std::filesystem::path lutPath = std::filesystem::temp_directory_path() / "ibl-test.brdf";
+	EnvironmentCubemap loadedCube;
+	BrdfLut loadedLut;
+	bool cachePassed =
+		SaveEnvironmentCubemap(cubePath.wstring(), 7, prefiltered) && LoadEnvironmentCubemap(cubePath.wstring(), 7, loadedCube) &&
+		loadedCube.Size == prefiltered.Size && loadedCube.MipCount == prefiltered.MipCount && loadedCube.Texels == prefiltered.Texels &&
+		!LoadEnvironmentCubemap(cubePath.wstring(), 8, loadedCube) &&
+		SaveBrdfLut(lutPath.wstring(), 9, lut) && LoadBrdfLut(lutPath.wstring(), 9, loadedLut) && loadedLut.Texels == lut.Texels &&
+		!LoadBrdfLut(lutPath.wstring(), 10, loadedLut) && !LoadBrdfLut(cubePath.wstring(), 7, loadedLut);
+	std::filesystem::resize_file(cubePath, std::filesystem::file_size(cubePath) - 4);
+	std::filesystem::resize_file(lutPath, std::filesystem::file_size(lutPath) + 4);
+	cachePassed &= !LoadEnvironmentCubemap(cubePath.wstring(), 7, loadedCube) && !LoadBrdfLut(lutPath.wstring(), 9, loadedLut);
+	std::error_code ignored;
+	std::filesystem::remove(cubePath, ignored);
+	std::filesystem::remove(lutPath, ignored);
+	passed &= cachePassed;
+	printf("Cache:      loads under the same key, whole files only  %s\n", cachePassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All reflection bake checks passed" : "Reflection bake checks FAILED");
+	return passed ? 0 : 1;
+}
+
+// --------------------------------------------------------
+// Times the reflection bake (prefiltering and the BRDF LUT)
+// at several face sizes and thread counts, on a made up sky
+// so it doesn't need the images or a GPU.  Thread counts
+// double from 1 up to one per core.
+// --------------------------------------------------------
+int RunIblBenchmark()
+{
+	const unsigned int sourceSize = 512;
+	TestSky sky(sourceSize, 256.0f);
+	EnvironmentCubemap source;
+	DecodeCubemap(sky.Faces(), 256, source);
+
+	std::vector<unsigned int> threadCounts;
+	unsigned int cores = std::thread::hardware_concurrency();
+	for (unsigned int threads = 1; threads < cores; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(cores > 0 ? cores : 1);
+
+	printf("Reflection bake: %ux%u sky decoded at %u, 6 roughness mips, 256 samples\n", sourceSize, sourceSize, source.Size);
+	for (unsigned int size : { 64u, 128u, 256u })
+	{
+		printf("  %3u faces:", size);
+		for (unsigned int threads : threadCounts)
+		{
+			double start = TestMilliseconds();
+			EnvironmentCubemap prefiltered;
+			PrefilterSpecular(source, size, 6, 256, prefiltered, threads);
+			printf("  %u thread%s %.1f ms", threads, threads == 1 ? "" : "s", TestMilliseconds() - start);
+		}
+		printf("\n");
+	}
+
+	printf("  BRDF LUT:  ");
+	for (unsigned int threads : threadCounts)
+	{
+		double start = TestMilliseconds();
+		BrdfLut lut;
+		IntegrateBrdfLut(128, 512, lut, threads);
+		printf("  %u thread%s %.1f ms", threads, threads == 1 ? "" : "s", TestMilliseconds() - start);
+	}
+	printf("\n");
+	return 0;
+}
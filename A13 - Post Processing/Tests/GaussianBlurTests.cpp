@@ -0,0 +1,140 @@
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include "../GaussianBlur.h"
+#include "EngineTests.h"
+
+// --------------------------------------------------------
+// Checks the separable blur against the slow ways of doing
+// the same thing:
+// - Every kernel's weights must add up to one, in one tap
+//   for the center plus one for every two texels after it
+// - The two folded passes must match the full 2D Gaussian,
+//   and the SSE path the scalar one
+// - Pixelation alone, then a pass of one tap, must be the old
+//   box blur with a radius of 0
+// - A flat image must come out flat
+// - Pixelating and both passes must take a tenth of the
+//   samples a pixel the old box blur did
+// Then times the two.  Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunBlurTests()
+{
+	bool passed = true;
+	std::mt19937 random(540);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	auto randomImage = [&](unsigned int width, unsigned int height)
+	{
+		BlurImage image;
+		image.Width = width;
+		image.Height = height;
+		image.Pixels.resize((size_t)width * height * 4);
+		for (float& value : image.Pixels)
+			value = unit(random);
+		return image;
+	};
+	auto maxDifference = [](const BlurImage& a, const BlurImage& b)
+	{
+		float worst = 0;
+		for (size_t i = 0; i < a.Pixels.size(); i++)
+			worst = fmaxf(worst, fabsf(a.Pixels[i] - b.Pixels[i]));
+		return worst;
+	};
+
+	bool kernelsPassed = true;
+	for (unsigned int radius = 0; radius <= MaxBlurRadius; radius++)
+	{
+		BlurKernel kernel;
+		ComputeBlurKernel(radius, kernel);
+		double total = kernel.Weights[0];
+		for (unsigned int t = 1; t < kernel.TapCount; t++)
+			total += 2.0 * kernel.Weights[t];
+		kernelsPassed &= fabs(total - 1.0) < 1e-5 && kernel.TapCount == 1 + (radius + 1) / 2;
+	}
+	passed &= kernelsPassed;
+	printf("Kernels:    radius 0 to %u add up to one, 1 + r/2 taps  %s\n", MaxBlurRadius, kernelsPassed ? "ok" : "FAILED");
+
+	// Odd sizes, so nothing lines up by accident
+	BlurImage image = randomImage(97, 61);
+	float worstGaussian = 0;
+	float worstSimd = 0;
+	for (unsigned int radius : { 1u, 2u, 5u, 8u, 13u, 20u })
+	{
+		BlurKernel kernel;
+		ComputeBlurKernel(radius, kernel);
+		BlurImage across, down, scalarAcross, scalarDown, exact;
+		BlurImagePass(image, kernel, false, across);
+		BlurImagePass(across, kernel, true, down);
+		BlurImagePass(image, kernel, false, scalarAcross, false);
+		BlurImagePass(scalarAcross, kernel, true, scalarDown, false);
+		GaussianBlurImage(image, radius, exact);
+		worstGaussian = fmaxf(worstGaussian, maxDifference(down, exact));
+		worstSimd = fmaxf(worstSimd, maxDifference(down, scalarDown));
+	}
+	bool gaussianPassed = worstGaussian < 1e-4f;
+	bool simdPassed = worstSimd < 1e-5f;
+	passed &= gaussianPassed && simdPassed;
+	printf("Separable:  %.2g from the 2D Gaussian  %s\n", worstGaussian, gaussianPassed ? "ok" : "FAILED");
+	printf("SSE:        %.2g from scalar  %s\n", worstSimd, simdPassed ? "ok" : "FAILED");
+
+	bool pixelatePassed = true;
+	BlurKernel copy;
+	ComputeBlurKernel(0, copy);
+	for (int pixelation : { 4, 17, 50 })
+	{
+		BlurImage pixelated, copied, box;
+		PixelateImage(image, pixelation, pixelated);
+		BlurImagePass(pixelated, copy, true, copied);
+		BoxBlurImage(image, 0, pixelation, box);
+		pixelatePassed &= maxDifference(copied, box) == 0;
+	}
+	passed &= pixelatePassed;
+	printf("Pixelate:   same as the box blur's, radius 0  %s\n", pixelatePassed ? "ok" : "FAILED");
+
+	BlurImage flat = image;
+	for (size_t i = 0; i < flat.Pixels.size(); i++)
+		flat.Pixels[i] = (i % 4) * 0.25f + 0.1f;
+	BlurKernel wide;
+	ComputeBlurKernel(MaxBlurRadius, wide);
+	BlurImage flatAcross, flatDown;
+	BlurImagePass(flat, wide, false, flatAcross);
+	BlurImagePass(flatAcross, wide, true, flatDown);
+	bool flatPassed = maxDifference(flat, flatDown) < 1e-5f;
+	passed &= flatPassed;
+	printf("Flat:       unchanged at radius %u  %s\n", MaxBlurRadius, flatPassed ? "ok" : "FAILED");
+
+	// Timing, at the widest the UI goes
+	const unsigned int radius = 20;
+	const int pixelation = 100;
+	BlurImage timed = randomImage(256, 144);
+	BlurKernel kernel;
+	ComputeBlurKernel(radius, kernel);
+
+	BlurImage box;
+	double start = TestMilliseconds();
+	BoxBlurImage(timed, radius, pixelation, box);
+	double boxMs = TestMilliseconds() - start;
+
+	BlurImage pixelated, across, down;
+	start = TestMilliseconds();
+	PixelateImage(timed, pixelation, pixelated);
+	BlurImagePass(pixelated, kernel, false, across);
+	BlurImagePass(across, kernel, true, down);
+	double separableMs = TestMilliseconds() - start;
+
+	// Counted rather than timed, so a slow or busy machine
+	// can't fail it
+	unsigned int boxSamples = (2 * radius + 1) * (2 * radius + 1);
+	unsigned int separableSamples = 1 + 2 * (2 * kernel.TapCount - 1);
+	bool cheaperPassed = separableSamples * 10 < boxSamples;
+	passed &= cheaperPassed;
+	printf("%ux%u, radius %u:\n", timed.Width, timed.Height, radius);
+	printf("  Box        %8.2f ms  %5u samples a pixel\n", boxMs, boxSamples);
+	printf("  Separable  %8.2f ms  %5u samples a pixel  %.1fx  %s\n", separableMs, separableSamples,
+		boxMs / separableMs, cheaperPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All blur checks passed" : "Blur checks FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,271 @@
+#include <d3dcommon.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <stdio.h>
+#include <vector>
+
+#include "../HlslPacking.h"
+#include "../ShaderStructGenerator.h"
+#include "../ShaderStructs.h"
+#include "EngineTests.h"
+
+// Where the shaders and ShaderStructs.h are; the game runs
+// from the project folder, so there it's the current one
+#ifndef ENGINE_SOURCE_DIR
+#define ENGINE_SOURCE_DIR ""
+#endif
+
+namespace
+{
+	HlslField Field(const char* name, unsigned int size, unsigned int elements = 0, bool isStruct = false, bool isMatrix = false)
+	{
+		HlslField field;
+		field.Name = name;
+		field.Size = size;
+		field.Elements = elements;
+		field.Struct = isStruct;
+		field.Matrix = isMatrix;
+		return field;
+	}
+
+	// Whether packing gives each field the expected offset
+	bool PacksTo(std::vector<HlslField> fields, const std::vector<unsigned int>& offsets, unsigned int size)
+	{
+		bool same = PackHlslFields(fields) == size;
+		for (size_t i = 0; i < fields.size(); i++)
+			same &= fields[i].Offset == offsets[i];
+		return same;
+	}
+
+	// The HLSL side of Light, from GGPShadersInclude.hlsli
+	std::vector<HlslField> LightFields()
+	{
+		return {
+			Field("Type", 4), Field("Direction", 12), Field("Range", 4), Field("Position", 12),
+			Field("Intensity", 4), Field("Color", 12), Field("SpotInnerAngle", 4), Field("SpotOuterAngle", 4),
+			Field("ShadowTile", 4), Field("Padding", 4) };
+	}
+
+	std::string ReadText(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream text;
+		text << file.rdbuf();
+		return text.str();
+	}
+
+	// --------------------------------------------------------
+	// Just enough of an HLSL reader to find each cbuffer and
+	// struct in the shader sources and describe them the way
+	// reflection does
+	// --------------------------------------------------------
+	class HlslDeclarations
+	{
+	public:
+		// Defines and structs are shared, as if every file
+		// included every other
+		void Read(const std::string& source)
+		{
+			std::string code = std::regex_replace(source, std::regex("//[^\n]*|/\\*[\\s\\S]*?\\*/"), "");
+
+			std::regex define("#define[ \t]+(\\w+)[ \t]+(\\d+)[ \t\r]*\n");
+			for (std::sregex_iterator i(code.begin(), code.end(), define), end; i != end; ++i)
+				defines[(*i)[1]] = (unsigned int)std::stoul((*i)[2]);
+
+			std::regex structure("struct\\s+(\\w+)\\s*\\{([^}]*)\\}");
+			for (std::sregex_iterator i(code.begin(), code.end(), structure), end; i != end; ++i)
+				structs[(*i)[1]] = (*i)[2];
+
+			std::regex cbuffer("cbuffer\\s+(\\w+)\\s*:\\s*register\\s*\\(\\s*b(\\d+)\\s*\\)\\s*\\{([^}]*)\\}");
+			for (std::sregex_iterator i(code.begin(), code.end(), cbuffer), end; i != end; ++i)
+				cbuffers.push_back({ (*i)[1], (unsigned int)std::stoul((*i)[2]), (*i)[3] });
+		}
+
+		// Reflection for every cbuffer read, or false if one has
+		// a type this doesn't know
+		bool Reflect(std::vector<ShaderReflectionData>& shaders)
+		{
+			for (const Declaration& declaration : cbuffers)
+			{
+				ShaderReflectionData::ConstantBuffer cb;
+				cb.Name = declaration.Name;
+				cb.Type = D3D_CT_CBUFFER;
+				cb.BindIndex = declaration.Register;
+				if (!Members(declaration.Body, false, cb.Variables, cb.Size))
+					return false;
+
+				ShaderReflectionData shader;
+				shader.ConstantBuffers.push_back(cb);
+				shaders.push_back(shader);
+			}
+			return true;
+		}
+
+	private:
+		struct Declaration
+		{
+			std::string Name;
+			unsigned int Register;
+			std::string Body;
+		};
+
+		bool Members(const std::string& body, bool isStruct, std::vector<ShaderReflectionData::Variable>& variables, unsigned int& size)
+		{
+			std::vector<HlslField> fields;
+			std::regex member("(\\w+)\\s+(\\w+)\\s*(?:\\[\\s*(\\w+)\\s*\\])?\\s*(?::\\s*\\w+\\s*)?;");
+			for (std::sregex_iterator i(body.begin(), body.end(), member), end; i != end; ++i)
+			{
+				ShaderReflectionData::Variable var;
+				var.Name = (*i)[2];
+				var.TypeName = (*i)[1];
+				if ((*i)[3].matched)
+				{
+					std::string count = (*i)[3];
+					var.Elements = defines.count(count) ? defines[count] : (unsigned int)std::stoul(count);
+				}
+
+				unsigned int elementSize = 0;
+				if (!Type(var, elementSize))
+				{
+					printf("  Don't know the HLSL type '%s'\n", var.TypeName.c_str());
+					return false;
+				}
+				var.Size = HlslArraySize(elementSize, var.Elements);
+
+				fields.push_back(Field("", elementSize, var.Elements, var.Class == D3D_SVC_STRUCT,
+					var.Class == D3D_SVC_MATRIX_ROWS || var.Class == D3D_SVC_MATRIX_COLUMNS));
+				variables.push_back(var);
+			}
+
+			size = PackHlslFields(fields);
+			for (size_t i = 0; i < fields.size(); i++)
+				variables[i].ByteOffset = fields[i].Offset;
+
+			// A struct's own size isn't rounded up; arrays of it
+			// pad every element but the last
+			if (isStruct && !fields.empty())
+				size = fields.back().Offset + HlslFieldSize(fields.back());
+			return true;
+		}
+
+		bool Type(ShaderReflectionData::Variable& var, unsigned int& elementSize)
+		{
+			if (structs.count(var.TypeName))
+			{
+				std::vector<ShaderReflectionData::Variable> members;
+				var.Class = D3D_SVC_STRUCT;
+				return Members(structs[var.TypeName], true, members, elementSize);
+			}
+
+			std::smatch parts;
+			std::string name = var.TypeName == "matrix" ? "float4x4" : var.TypeName;
+			if (!std::regex_match(name, parts, std::regex("(float|int|uint|bool)([1-4])?(?:x([1-4]))?")))
+				return false;
+
+			const std::map<std::string, unsigned int> baseTypes = {
+				{ "float", D3D_SVT_FLOAT }, { "int", D3D_SVT_INT }, { "uint", D3D_SVT_UINT }, { "bool", D3D_SVT_BOOL } };
+			var.BaseType = baseTypes.at(parts[1]);
+			var.Rows = 1;
+			var.Columns = parts[2].matched ? (unsigned int)std::stoul(parts[2]) : 1;
+			var.Class = var.Columns == 1 ? D3D_SVC_SCALAR : D3D_SVC_VECTOR;
+			if (parts[3].matched)
+			{
+				var.Rows = var.Columns;
+				var.Columns = (unsigned int)std::stoul(parts[3]);
+				var.Class = D3D_SVC_MATRIX_COLUMNS;
+				elementSize = HlslMatrixSize(var.Rows, var.Columns, false);
+			}
+			else
+				elementSize = var.Columns * 4;
+			return true;
+		}
+
+		std::map<std::string, unsigned int> defines;
+		std::map<std::string, std::string> structs;
+		std::vector<Declaration> cbuffers;
+	};
+}
+
+// --------------------------------------------------------
+// Checks the cbuffer packing rules and what's built on them:
+// - A float after a float3 shares its register, but
+//   anything that would cross a 16-byte boundary moves to
+//   the next register
+// - Array elements are padded to whole registers, except
+//   the last, and HlslArray pads the same way
+// - Light and the original ExternalData cbuffer must pack
+//   to the offsets fxc gives them, and C++'s Light must
+//   match
+// - ShaderStructs.h must be exactly what the generator
+//   writes for the cbuffers in the shader sources
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunHlslPackingTests()
+{
+	bool passed = true;
+
+	// Register boundaries
+	bool boundaryPassed =
+		PacksTo({ Field("a", 12), Field("b", 4) }, { 0, 12 }, 16) &&
+		PacksTo({ Field("a", 4), Field("b", 12) }, { 0, 4 }, 16) &&
+		PacksTo({ Field("a", 12), Field("b", 8) }, { 0, 16 }, 32) &&
+		PacksTo({ Field("a", 8), Field("b", 12) }, { 0, 16 }, 32) &&
+		PacksTo({ Field("a", 4), Field("b", 64, 0, false, true), Field("c", 4) }, { 0, 16, 80 }, 96);
+	passed &= boundaryPassed;
+	printf("Boundary:   float3+float share, crossing 16 bytes doesn't  %s\n", boundaryPassed ? "ok" : "FAILED");
+
+	// Arrays
+	bool arrayPassed =
+		PacksTo({ Field("a", 4, 3), Field("b", 4) }, { 0, 36 }, 48) &&
+		PacksTo({ Field("a", 4), Field("b", 8, 2), Field("c", 8) }, { 0, 16, 40 }, 48) &&
+		PacksTo({ Field("a", 64, 2, true), Field("b", 4) }, { 0, 128 }, 144) &&
+		HlslArraySize(12, 4) == 60 && HlslArrayElementSize(60, 4) == 12 && HlslArrayElementSize(36, 3) == 4 &&
+		HlslArrayElementSize(320, 5) == 64 && HlslMatrixSize(3, 4, false) == 60 && HlslMatrixSize(3, 4, true) == 48;
+	HlslArray<float, 3> floats = {};
+	floats[1] = 2.0f;
+	arrayPassed &= sizeof(floats) == 36 && (unsigned char*)&floats[1] - floats.Bytes == 16 && *(float*)(floats.Bytes + 16) == 2.0f;
+	passed &= arrayPassed;
+	printf("Arrays:     elements pad to a register but the last  %s\n", arrayPassed ? "ok" : "FAILED");
+
+	// Light, on both sides
+	std::vector<HlslField> light = LightFields();
+	bool lightPassed = PackHlslFields(light) == 64 && sizeof(Light) == 64 &&
+		light[0].Offset == offsetof(Light, Type) && light[1].Offset == offsetof(Light, Direction) &&
+		light[2].Offset == offsetof(Light, Range) && light[3].Offset == offsetof(Light, Position) &&
+		light[4].Offset == offsetof(Light, Intensity) && light[5].Offset == offsetof(Light, Color) &&
+		light[6].Offset == offsetof(Light, SpotInnerAngle) && light[7].Offset == offsetof(Light, SpotOuterAngle) &&
+		light[8].Offset == offsetof(Light, ShadowTile) && light[9].Offset == offsetof(Light, Padding);
+
+	// The single cbuffer the shaders started with
+	lightPassed &= PacksTo({ Field("colorTint", 16), Field("scale", 8), Field("offset", 8), Field("cameraPosition", 12),
+		Field("roughness", 4), Field("ambient", 12), Field("lights", 64, 5, true) }, { 0, 16, 24, 32, 44, 48, 64 }, 384);
+	passed &= lightPassed;
+	printf("Light:      Light and ExternalData pack like fxc  %s\n", lightPassed ? "ok" : "FAILED");
+
+	// The generated header, from the sources
+	std::filesystem::path sourceDir(ENGINE_SOURCE_DIR);
+	HlslDeclarations declarations;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(sourceDir.empty() ? "." : sourceDir, error))
+	{
+		std::string extension = entry.path().extension().string();
+		if (extension == ".hlsl" || extension == ".hlsli")
+			declarations.Read(ReadText(entry.path()));
+	}
+	std::vector<ShaderReflectionData> shaders;
+	std::vector<const ShaderReflectionData*> shaderPointers;
+	std::string header;
+	bool headerPassed = declarations.Reflect(shaders) && !shaders.empty();
+	for (const ShaderReflectionData& shader : shaders)
+		shaderPointers.push_back(&shader);
+	headerPassed &= GenerateShaderStructHeader(shaderPointers, { "Lights.h" }, header) &&
+		header == ReadText(sourceDir / "ShaderStructs.h");
+	passed &= headerPassed;
+	printf("Header:     ShaderStructs.h matches %zu cbuffers in the shaders  %s\n", shaders.size(), headerPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All HLSL packing checks passed" : "HLSL packing checks FAILED");
+	return passed ? 0 : 1;
+}
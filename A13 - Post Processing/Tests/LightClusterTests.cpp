@@ -0,0 +1,262 @@
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "../LightClusters.h"
+#include "EngineTests.h"
+
+namespace
+{
+	const float ClusterNear = 0.1f;
+	const float ClusterFar = 100.0f;
+
+	// Same numbers every run
+	class TestRandom
+	{
+	public:
+		TestRandom(unsigned int seed) : state(seed) {}
+		float Next() { state = state * 1664525u + 1013904223u; return (state >> 8) / 16777216.0f; }
+		float Range(float low, float high) { return low + (high - low) * Next(); }
+
+	private:
+		unsigned int state;
+	};
+
+	// Like XMMatrixPerspectiveFovLH
+	DirectX::XMFLOAT4X4 Perspective(float fovY, float aspect, float nearZ, float farZ)
+	{
+		DirectX::XMFLOAT4X4 m = {};
+		m._22 = 1.0f / tanf(fovY * 0.5f);
+		m._11 = m._22 / aspect;
+		m._33 = farZ / (farZ - nearZ);
+		m._34 = 1.0f;
+		m._43 = -nearZ * farZ / (farZ - nearZ);
+		return m;
+	}
+
+	// A camera at eye turned about Y, like XMMatrixLookToLH
+	DirectX::XMFLOAT4X4 View(const DirectX::XMFLOAT3& eye, float yaw)
+	{
+		float c = cosf(yaw);
+		float s = sinf(yaw);
+		DirectX::XMFLOAT4X4 m = {};
+		m._11 = c;  m._13 = s;
+		m._22 = 1;
+		m._31 = -s; m._33 = c;
+		m._41 = -(eye.x * c - eye.z * s);
+		m._42 = -eye.y;
+		m._43 = -(eye.x * s + eye.z * c);
+		m._44 = 1;
+		return m;
+	}
+
+	DirectX::XMFLOAT3 ToView(const DirectX::XMFLOAT3& p, const DirectX::XMFLOAT4X4& view)
+	{
+		return DirectX::XMFLOAT3(
+			p.x * view._11 + p.y * view._21 + p.z * view._31 + view._41,
+			p.x * view._12 + p.y * view._22 + p.z * view._32 + view._42,
+			p.x * view._13 + p.y * view._23 + p.z * view._33 + view._43);
+	}
+
+	// Point and spot lights scattered in front of the camera,
+	// plus a directional light that must never be binned
+	std::vector<Light> ScatterLights(unsigned int count, const DirectX::XMFLOAT3& eye, float yaw, TestRandom& random)
+	{
+		std::vector<Light> lights(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			Light& light = lights[i];
+			light.Type = i == 0 ? LIGHT_TYPE_DIRECTION : (i % 3 == 0 ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT);
+			light.Range = random.Range(0.5f, 8.0f);
+
+			// Anywhere from behind the camera to past the far plane
+			float forward = random.Range(-5.0f, ClusterFar + 5.0f);
+			float side = random.Range(-0.8f, 0.8f) * (forward > 1 ? forward : 1);
+			float up = random.Range(-0.5f, 0.5f) * (forward > 1 ? forward : 1);
+			light.Position = DirectX::XMFLOAT3(
+				eye.x + forward * sinf(yaw) + side * cosf(yaw),
+				eye.y + up,
+				eye.z + forward * cosf(yaw) - side * sinf(yaw));
+
+			float length = 0;
+			while (length < 0.1f)
+			{
+				light.Direction = DirectX::XMFLOAT3(random.Range(-1, 1), random.Range(-1, 1), random.Range(-1, 1));
+				length = sqrtf(light.Direction.x * light.Direction.x + light.Direction.y * light.Direction.y + light.Direction.z * light.Direction.z);
+			}
+			light.SpotOuterAngle = random.Range(0.1f, 1.4f);
+			light.SpotInnerAngle = light.SpotOuterAngle * 0.5f;
+			light.Intensity = 1;
+			light.Color = DirectX::XMFLOAT3(1, 1, 1);
+			light.ShadowTile = -1;
+		}
+		return lights;
+	}
+
+	// A random point the light reaches, in world space
+	DirectX::XMFLOAT3 PointInLight(const Light& light, TestRandom& random)
+	{
+		while (true)
+		{
+			float x = random.Range(-1, 1);
+			float y = random.Range(-1, 1);
+			float z = random.Range(-1, 1);
+			float lengthSq = x * x + y * y + z * z;
+			if (lengthSq > 1 || lengthSq == 0)
+				continue;
+
+			if (light.Type == LIGHT_TYPE_SPOT)
+			{
+				const DirectX::XMFLOAT3& d = light.Direction;
+				float along = (x * d.x + y * d.y + z * d.z) / sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+				if (along < sqrtf(lengthSq) * cosf(light.SpotOuterAngle))
+					continue;
+			}
+			return DirectX::XMFLOAT3(
+				light.Position.x + x * light.Range,
+				light.Position.y + y * light.Range,
+				light.Position.z + z * light.Range);
+		}
+	}
+
+	bool ClusterLists(const LightClusterGrid& grid, unsigned int cluster, unsigned int light)
+	{
+		const LightClusterRange& range = grid.GetRanges()[cluster];
+		for (unsigned int i = 0; i < range.Count; i++)
+			if (grid.GetLightIndices()[range.Offset + i] == light)
+				return true;
+		return false;
+	}
+}
+
+// --------------------------------------------------------
+// Checks light binning against brute force:
+// - Every point a light reaches inside the view must land
+//   (by the shader's own ClusterAt()) in a cluster that
+//   lists that light, from more than one camera
+// - Ranges must tile the index list, keep lights in order
+//   within each cluster and only hold point and spot lights
+// - The binned count must be the lights that reached any
+//   cluster
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunLightClusterTests()
+{
+	bool passed = true;
+	TestRandom random(1234);
+	DirectX::XMFLOAT4X4 projection = Perspective(1.0f, 16.0f / 9.0f, ClusterNear, ClusterFar);
+	LightClusterGrid grid;
+	grid.SetProjection(projection, ClusterNear, ClusterFar);
+
+	bool coveredPassed = true;
+	bool listsPassed = true;
+	bool countPassed = true;
+	unsigned int samples = 0;
+	unsigned int missed = 0;
+	DirectX::XMFLOAT3 eyes[] = { DirectX::XMFLOAT3(0, 0, 0), DirectX::XMFLOAT3(3, 2, -7) };
+	float yaws[] = { 0.0f, 2.2f };
+	for (int camera = 0; camera < 2; camera++)
+	{
+		DirectX::XMFLOAT4X4 view = View(eyes[camera], yaws[camera]);
+		std::vector<Light> lights = ScatterLights(300, eyes[camera], yaws[camera], random);
+		grid.Assign(lights.data(), (unsigned int)lights.size(), view);
+
+		// Every point in every light
+		std::vector<bool> reached(lights.size(), false);
+		for (unsigned int i = 0; i < lights.size(); i++)
+		{
+			if (lights[i].Type == LIGHT_TYPE_DIRECTION)
+				continue;
+
+			for (int s = 0; s < 400; s++)
+			{
+				DirectX::XMFLOAT3 p = ToView(PointInLight(lights[i], random), view);
+				if (p.z < ClusterNear || p.z > ClusterFar)
+					continue;
+				float ndcX = p.x * projection._11 / p.z;
+				float ndcY = p.y * projection._22 / p.z;
+				if (ndcX < -1 || ndcX > 1 || ndcY < -1 || ndcY > 1)
+					continue;
+
+				samples++;
+				reached[i] = true;
+				if (!ClusterLists(grid, grid.ClusterAt(ndcX, ndcY, p.z), i))
+				{
+					if (missed++ < 5)
+						printf("  Light %u misses cluster %u at (%.3f, %.3f, %.3f)\n", i, grid.ClusterAt(ndcX, ndcY, p.z), p.x, p.y, p.z);
+					coveredPassed = false;
+				}
+			}
+		}
+
+		// The lists themselves
+		unsigned int offset = 0;
+		std::vector<bool> binned(lights.size(), false);
+		for (const LightClusterRange& range : grid.GetRanges())
+		{
+			listsPassed &= range.Offset == offset;
+			for (unsigned int i = 0; i < range.Count; i++)
+			{
+				unsigned int light = grid.GetLightIndices()[range.Offset + i];
+				listsPassed &= light < lights.size() && lights[light].Type != LIGHT_TYPE_DIRECTION;
+				listsPassed &= i == 0 || grid.GetLightIndices()[range.Offset + i - 1] < light;
+				binned[light < lights.size() ? light : 0] = true;
+			}
+			offset += range.Count;
+		}
+		listsPassed &= offset == grid.GetLightIndices().size() && grid.GetRanges().size() == grid.GetClusterCount();
+
+		// Sampled lights are a subset of binned ones
+		unsigned int binnedCount = 0;
+		for (unsigned int i = 0; i < lights.size(); i++)
+		{
+			binnedCount += binned[i] ? 1 : 0;
+			countPassed &= !reached[i] || binned[i];
+		}
+		countPassed &= binnedCount == grid.GetBinnedLightCount();
+	}
+
+	passed &= coveredPassed;
+	printf("Covered:    %u points in lights, %u in clusters missing them  %s\n", samples, missed, coveredPassed ? "ok" : "FAILED");
+	passed &= listsPassed;
+	printf("Lists:      ranges tile the indices, in light order  %s\n", listsPassed ? "ok" : "FAILED");
+	passed &= countPassed;
+	printf("Counts:     binned lights match the lists  %s\n", countPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All light cluster checks passed" : "Light cluster checks FAILED");
+	return passed ? 0 : 1;
+}
+
+// --------------------------------------------------------
+// Times binning growing numbers of lights into the default
+// 16x9x24 grid
+// --------------------------------------------------------
+int RunLightClusterBenchmark()
+{
+	TestRandom random(99);
+	LightClusterGrid grid;
+	grid.SetProjection(Perspective(1.0f, 16.0f / 9.0f, ClusterNear, ClusterFar), ClusterNear, ClusterFar);
+	DirectX::XMFLOAT3 eye(0, 0, 0);
+	DirectX::XMFLOAT4X4 view = View(eye, 0);
+
+	printf("Binning into %u clusters:\n", grid.GetClusterCount());
+	for (unsigned int count = 64; count <= 4096; count *= 4)
+	{
+		std::vector<Light> lights = ScatterLights(count, eye, 0, random);
+		int iterations = 0;
+		double start = TestMilliseconds();
+		double elapsed = 0;
+		while (elapsed < 250 || iterations < 3)
+		{
+			grid.Assign(lights.data(), count, view);
+			iterations++;
+			elapsed = TestMilliseconds() - start;
+		}
+
+		printf("  %5u lights  %8.3f ms  %4u binned  %7zu indices  %3u max per cluster\n", count, elapsed / iterations,
+			grid.GetBinnedLightCount(), grid.GetLightIndices().size(), grid.GetMaxLightsPerCluster());
+	}
+
+	printf("Light cluster benchmark done\n");
+	return 0;
+}
@@ -0,0 +1,217 @@
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <wrl/client.h>
+
+#include "../NullBackend.h"
+#include "EngineTests.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Private data tags, made up for these checks
+	const GUID tagA = { 0x6a1b3c01, 0x540, 0x13, { 1, 2, 3, 4, 5, 6, 7, 8 } };
+	const GUID tagB = { 0x6a1b3c02, 0x540, 0x13, { 1, 2, 3, 4, 5, 6, 7, 8 } };
+
+	// Whether an object answers QueryInterface() for a type
+	template<typename T>
+	bool Is(IUnknown* object)
+	{
+		ComPtr<T> as;
+		return SUCCEEDED(object->QueryInterface(IID_PPV_ARGS(as.GetAddressOf()))) && as.Get() != 0;
+	}
+}
+
+// --------------------------------------------------------
+// Smoke test of the null backend, with no window or GPU:
+// - Every object must be the interface it was made as (and
+//   the ones that derives from) and nothing else, with the
+//   desc it was made with
+// - A view made without a desc must get the resource's
+//   format, and keep the resource alive
+// - Map() and UpdateSubresource() must share a buffer's
+//   memory and count what they upload
+// - The context must hold what's bound until it's unbound
+// - Private data must round trip, report its size, refuse
+//   too small a space, and hold interfaces until the object
+//   holding them goes
+// - Calls must be counted, and releasing everything must
+//   bring the live totals back to zero
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunNullBackendTests()
+{
+	bool passed = true;
+	std::shared_ptr<NullGraphicsStats> stats = std::make_shared<NullGraphicsStats>();
+	NullGraphicsDevice device(stats);
+	NullGraphicsContext context(stats);
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = 256;
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	ComPtr<ID3D11Buffer> buffer;
+	device.CreateBuffer(&bufferDesc, 0, buffer.GetAddressOf());
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = 64;
+	textureDesc.Height = 32;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	ComPtr<ID3D11Texture2D> texture;
+	device.CreateTexture2D(&textureDesc, 0, texture.GetAddressOf());
+
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
+	samplerDesc.MaxAnisotropy = 16;
+	ComPtr<ID3D11SamplerState> sampler;
+	device.CreateSamplerState(&samplerDesc, sampler.GetAddressOf());
+
+	ComPtr<ID3D11PixelShader> shader;
+	device.CreatePixelShader(0, 0, 0, shader.GetAddressOf());
+
+	// What each one is
+	bool typesPassed = buffer && texture && sampler && shader;
+	if (typesPassed)
+	{
+		typesPassed &= Is<ID3D11Buffer>(buffer.Get()) && Is<ID3D11Resource>(buffer.Get()) && Is<ID3D11DeviceChild>(buffer.Get()) &&
+			Is<IUnknown>(buffer.Get()) && !Is<ID3D11Texture2D>(buffer.Get()) && !Is<ID3D11View>(buffer.Get());
+		typesPassed &= Is<ID3D11Texture2D>(texture.Get()) && Is<ID3D11Resource>(texture.Get()) && !Is<ID3D11Buffer>(texture.Get());
+		typesPassed &= Is<ID3D11SamplerState>(sampler.Get()) && !Is<ID3D11Resource>(sampler.Get());
+		typesPassed &= Is<ID3D11PixelShader>(shader.Get()) && !Is<ID3D11VertexShader>(shader.Get());
+
+		D3D11_BUFFER_DESC gotBuffer = {};
+		buffer->GetDesc(&gotBuffer);
+		D3D11_TEXTURE2D_DESC gotTexture = {};
+		texture->GetDesc(&gotTexture);
+		D3D11_SAMPLER_DESC gotSampler = {};
+		sampler->GetDesc(&gotSampler);
+		D3D11_RESOURCE_DIMENSION bufferType = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+		D3D11_RESOURCE_DIMENSION textureType = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+		buffer->GetType(&bufferType);
+		texture->GetType(&textureType);
+		ID3D11Device* owner = (ID3D11Device*)1;
+		buffer->GetDevice(&owner);
+		typesPassed &= memcmp(&gotBuffer, &bufferDesc, sizeof(bufferDesc)) == 0 &&
+			memcmp(&gotTexture, &textureDesc, sizeof(textureDesc)) == 0 &&
+			memcmp(&gotSampler, &samplerDesc, sizeof(samplerDesc)) == 0 &&
+			bufferType == D3D11_RESOURCE_DIMENSION_BUFFER && textureType == D3D11_RESOURCE_DIMENSION_TEXTURE2D && owner == 0;
+	}
+	passed &= typesPassed;
+	printf("Types:      each object is its interface, with its desc  %s\n", typesPassed ? "ok" : "FAILED");
+	if (!typesPassed)
+	{
+		printf("Null backend checks FAILED\n");
+		return 1;
+	}
+
+	// Views
+	ComPtr<ID3D11RenderTargetView> rtv;
+	ComPtr<ID3D11ShaderResourceView> srv;
+	device.CreateRenderTargetView(texture.Get(), 0, rtv.GetAddressOf());
+	device.CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf());
+	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+	rtv->GetDesc(&rtvDesc);
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srv->GetDesc(&srvDesc);
+	ComPtr<ID3D11Resource> viewed;
+	rtv->GetResource(viewed.GetAddressOf());
+	bool viewsPassed = Is<ID3D11View>(rtv.Get()) && Is<ID3D11RenderTargetView>(rtv.Get()) && !Is<ID3D11ShaderResourceView>(rtv.Get()) &&
+		rtvDesc.Format == textureDesc.Format && rtvDesc.ViewDimension == D3D11_RTV_DIMENSION_TEXTURE2D &&
+		srvDesc.Format == textureDesc.Format && srvDesc.ViewDimension == D3D11_SRV_DIMENSION_TEXTURE2D &&
+		viewed.Get() == static_cast<ID3D11Resource*>(texture.Get());
+	unsigned long long textureBytes = 64 * 32 * 4;
+	viewed.Reset();
+	texture.Reset();
+	viewsPassed &= stats->TextureBytes == textureBytes;
+	passed &= viewsPassed;
+	printf("Views:      resource's format by default, kept alive by its views  %s\n", viewsPassed ? "ok" : "FAILED");
+
+	// Bound, the views live on until they're unbound
+	context.PSSetShaderResources(3, 1, srv.GetAddressOf());
+	context.OMSetRenderTargets(1, rtv.GetAddressOf(), 0);
+	srv.Reset();
+	rtv.Reset();
+	bool boundPassed = stats->TextureBytes == textureBytes;
+	ID3D11ShaderResourceView* noSRV = 0;
+	context.PSSetShaderResources(3, 1, &noSRV);
+	boundPassed &= stats->TextureBytes == textureBytes;
+	context.OMSetRenderTargets(0, 0, 0);
+	boundPassed &= stats->TextureBytes == 0;
+	passed &= boundPassed;
+	printf("Bound:      the context holds what's bound, like D3D11  %s\n", boundPassed ? "ok" : "FAILED");
+
+	// Uploads
+	stats->ResetCalls();
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	bool uploadsPassed = SUCCEEDED(context.Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)) && mapped.pData && mapped.RowPitch == 256;
+	if (uploadsPassed)
+	{
+		memset(mapped.pData, 7, 256);
+		context.Unmap(buffer.Get(), 0);
+		unsigned char patch[16];
+		memset(patch, 9, sizeof(patch));
+		D3D11_BOX box = { 32, 0, 0, 48, 1, 1 };
+		context.UpdateSubresource(buffer.Get(), 0, &box, patch, 0, 0);
+		context.Map(buffer.Get(), 0, D3D11_MAP_READ, 0, &mapped);
+		const unsigned char* bytes = (const unsigned char*)mapped.pData;
+		context.Unmap(buffer.Get(), 0);
+		uploadsPassed = bytes[0] == 7 && bytes[31] == 7 && bytes[32] == 9 && bytes[47] == 9 && bytes[48] == 7 &&
+			stats->UploadedBytes == 256 + 16 && stats->Calls[(size_t)GraphicsCall::Map] == 2;
+	}
+	passed &= uploadsPassed;
+	printf("Uploads:    Map() and UpdateSubresource() share the buffer, %llu bytes counted  %s\n", stats->UploadedBytes,
+		uploadsPassed ? "ok" : "FAILED");
+
+	// Private data
+	unsigned int value = 0x540;
+	UINT size = 0;
+	bool dataPassed = buffer->GetPrivateData(tagA, &size, 0) == DXGI_ERROR_NOT_FOUND;
+	dataPassed &= SUCCEEDED(buffer->SetPrivateData(tagA, sizeof(value), &value));
+	dataPassed &= SUCCEEDED(buffer->GetPrivateData(tagA, &size, 0)) && size == sizeof(value);
+	unsigned char tooSmall = 0;
+	size = 1;
+	dataPassed &= buffer->GetPrivateData(tagA, &size, &tooSmall) == DXGI_ERROR_MORE_DATA && size == sizeof(value);
+	unsigned int read = 0;
+	size = sizeof(read);
+	dataPassed &= SUCCEEDED(buffer->GetPrivateData(tagA, &size, &read)) && read == value;
+	dataPassed &= SUCCEEDED(buffer->SetPrivateData(tagA, 0, 0)) && buffer->GetPrivateData(tagA, &size, 0) == DXGI_ERROR_NOT_FOUND;
+
+	// The buffer now only lives in the sampler's private data
+	unsigned long long liveBefore = stats->LiveObjects;
+	dataPassed &= SUCCEEDED(sampler->SetPrivateDataInterface(tagB, buffer.Get()));
+	buffer.Reset();
+	IUnknown* held = 0;
+	size = sizeof(held);
+	dataPassed &= SUCCEEDED(sampler->GetPrivateData(tagB, &size, &held)) && held && Is<ID3D11Buffer>(held);
+	if (held)
+		held->Release();
+	dataPassed &= stats->LiveObjects == liveBefore && stats->BufferBytes == 256;
+	sampler.Reset();
+	dataPassed &= stats->LiveObjects == liveBefore - 2 && stats->BufferBytes == 0;
+	passed &= dataPassed;
+	printf("Private:    data round trips, interfaces held until their owner goes  %s\n", dataPassed ? "ok" : "FAILED");
+
+	// Calls and totals
+	stats->ResetCalls();
+	bool countsPassed = device.CreateVertexShader(0, 0, 0, 0) == S_FALSE;
+	context.Draw(3, 0);
+	context.DrawIndexed(36, 0, 0);
+	context.PSSetShader(shader.Get(), 0, 0);
+	countsPassed &= stats->Calls[(size_t)GraphicsCall::CreateVertexShader] == 1 && stats->Calls[(size_t)GraphicsCall::Draw] == 1 &&
+		stats->Calls[(size_t)GraphicsCall::DrawIndexed] == 1 && stats->TotalCalls() == 4 && stats->VerticesDrawn == 39;
+	shader.Reset();
+	countsPassed &= stats->LiveObjects == 1;
+	context.PSSetShader(0, 0, 0);
+	countsPassed &= stats->LiveObjects == 0 && stats->BufferBytes == 0 && stats->TextureBytes == 0;
+	passed &= countsPassed;
+	printf("Counts:     every call counted, nothing left alive  %s\n", countsPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All null backend checks passed" : "Null backend checks FAILED");
+	return passed ? 0 : 1;
+}
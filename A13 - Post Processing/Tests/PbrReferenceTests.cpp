@@ -0,0 +1,243 @@
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "../PbrReference.h"
+#include "EngineTests.h"
+
+using PbrReference::float3;
+
+namespace
+{
+	// Relative to the value, as D and highlights can be huge
+	float Difference(float a, float b)
+	{
+		return fabsf(a - b) / (1.0f + fabsf(a));
+	}
+
+	float Difference(float3 a, float3 b)
+	{
+		float x = Difference(a.x, b.x);
+		float y = Difference(a.y, b.y);
+		float z = Difference(a.z, b.z);
+		return x > y ? (x > z ? x : z) : (y > z ? y : z);
+	}
+
+	// Always the same scene, so runs compare
+	class PbrScene
+	{
+	public:
+		PbrScene(unsigned int seed) : random(seed), unit(0.0f, 1.0f), signedUnit(-1.0f, 1.0f) {}
+
+		float Unit() { return unit(random); }
+		float SignedUnit() { return signedUnit(random); }
+
+		float3 Direction()
+		{
+			float3 d = { SignedUnit(), SignedUnit(), SignedUnit() };
+			float length = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+			return { d.x / length, d.y / length, d.z / length };
+		}
+
+		PbrReference::Frame Frame(unsigned int lights)
+		{
+			PbrReference::Frame frame;
+			frame.CameraPosition = { 0.0f, 0.0f, -2.0f };
+			frame.Ambient = { 0.5f, 0.5f, 0.5f };
+			for (unsigned int i = 0; i < lights; i++)
+			{
+				PbrReference::Light light = {};
+				light.Type = i % 3;
+				light.Direction = Direction();
+				light.Range = 1.0f + Unit() * 9.0f;
+				light.Position = { SignedUnit() * 10.0f, SignedUnit() * 5.0f, SignedUnit() * 5.0f };
+				light.Intensity = Unit();
+				light.Color = { Unit(), Unit(), Unit() };
+				light.SpotInnerAngle = 0.2f;
+				light.SpotOuterAngle = 0.5f;
+				light.ShadowTile = i % 2 ? 0 : -1;
+				frame.Lights.push_back(light);
+			}
+			return frame;
+		}
+
+		std::vector<PbrReference::Surface> Surfaces(size_t count)
+		{
+			std::vector<PbrReference::Surface> surfaces(count);
+			for (PbrReference::Surface& surface : surfaces)
+			{
+				surface.WorldPosition = { SignedUnit() * 10.0f, SignedUnit() * 5.0f, SignedUnit() * 5.0f };
+				surface.Normal = Direction();
+				surface.Albedo = { Unit(), Unit(), Unit() };
+				surface.ColorTint = { 1.0f, 1.0f, 1.0f };
+				surface.Metalness = Unit();
+				surface.Roughness = Unit();
+				surface.ShadowAmount = Unit();
+			}
+			return surfaces;
+		}
+
+	private:
+		std::mt19937 random;
+		std::uniform_real_distribution<float> unit;
+		std::uniform_real_distribution<float> signedUnit;
+	};
+
+	float MaxDifference(const std::vector<float3>& a, const std::vector<float3>& b)
+	{
+		float most = 0;
+		for (size_t i = 0; i < a.size() && i < b.size(); i++)
+		{
+			float difference = Difference(a[i], b[i]);
+			most = difference > most ? difference : most;
+		}
+		return a.size() == b.size() ? most : INFINITY;
+	}
+}
+
+// --------------------------------------------------------
+// Checks the AVX2 lighting against the scalar functions it
+// was written from, one term at a time, then as a whole:
+// - D_GGX, G_SchlickGGX (view and light together) and
+//   F_Schlick must each match for random inputs, smooth
+//   and rough surfaces, and light at grazing angles or
+//   behind the surface
+// - The full BRDF must match MicrofacetBRDF()
+// - Shading whole images must match, threaded or not
+// Without AVX2 there's nothing to compare, so only the
+// scalar path runs and the checks say so.
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunPbrReferenceTests()
+{
+	bool passed = true;
+	bool avx2 = PbrReference::HasAvx2();
+	const float tolerance = 0.0001f;
+	PbrScene scene(540);
+
+	float worstD = 0, worstG = 0, worstF = 0, worstBrdf = 0;
+	for (int b = 0; b < 64; b++)
+	{
+		PbrReference::BrdfBatch batch;
+		for (int i = 0; i < 8; i++)
+		{
+			float3 n = scene.Direction();
+			float3 l = scene.Direction();
+			float3 v = { scene.SignedUnit() * 4.0f, scene.SignedUnit() * 4.0f, scene.SignedUnit() * 4.0f };
+			float roughness = scene.Unit();
+
+			// Some lanes at the edges: mirror smooth, fully
+			// rough, grazing and from behind
+			switch ((b + i) % 8)
+			{
+			case 0: roughness = 0; break;
+			case 1: roughness = 1; break;
+			case 2: l = { n.y, -n.x, 0 }; break;
+			case 3: l = { -n.x, -n.y, -n.z }; break;
+			}
+
+			batch.NormalX[i] = n.x; batch.NormalY[i] = n.y; batch.NormalZ[i] = n.z;
+			batch.LightX[i] = l.x; batch.LightY[i] = l.y; batch.LightZ[i] = l.z;
+			batch.ViewX[i] = v.x; batch.ViewY[i] = v.y; batch.ViewZ[i] = v.z;
+			batch.Roughness[i] = roughness;
+			batch.F0X[i] = 0.04f + scene.Unit() * 0.96f;
+			batch.F0Y[i] = 0.04f + scene.Unit() * 0.96f;
+			batch.F0Z[i] = 0.04f + scene.Unit() * 0.96f;
+		}
+
+		PbrReference::BrdfTerms terms;
+		PbrReference::EvaluateBrdf(batch, terms, true);
+		for (int i = 0; i < 8; i++)
+		{
+			float3 n = { batch.NormalX[i], batch.NormalY[i], batch.NormalZ[i] };
+			float3 l = { batch.LightX[i], batch.LightY[i], batch.LightZ[i] };
+			float3 v = { batch.ViewX[i], batch.ViewY[i], batch.ViewZ[i] };
+			float3 f0 = { batch.F0X[i], batch.F0Y[i], batch.F0Z[i] };
+			float roughness = batch.Roughness[i];
+
+			float3 sum = { v.x + l.x, v.y + l.y, v.z + l.z };
+			float length = sqrtf(sum.x * sum.x + sum.y * sum.y + sum.z * sum.z);
+			float3 h = { sum.x / length, sum.y / length, sum.z / length };
+
+			float D = PbrReference::D_GGX(n, h, roughness);
+			float G = PbrReference::G_SchlickGGX(n, v, roughness) * PbrReference::G_SchlickGGX(n, l, roughness);
+			float3 F = PbrReference::F_Schlick(v, h, f0);
+			float3 unused;
+			float3 brdf = PbrReference::MicrofacetBRDF(n, l, v, roughness, f0, unused);
+
+			float d = Difference(D, terms.D[i]);
+			float g = Difference(G, terms.G[i]);
+			float f = Difference(F, { terms.FX[i], terms.FY[i], terms.FZ[i] });
+			float s = Difference(brdf, { terms.SpecularX[i], terms.SpecularY[i], terms.SpecularZ[i] });
+			worstD = d > worstD || d != d ? d : worstD;
+			worstG = g > worstG || g != g ? g : worstG;
+			worstF = f > worstF || f != f ? f : worstF;
+			worstBrdf = s > worstBrdf || s != s ? s : worstBrdf;
+		}
+	}
+
+	const char* path = avx2 ? "AVX2" : "scalar only, no AVX2";
+	const float worst[4] = { worstD, worstG, worstF, worstBrdf };
+	const char* names[4] = { "D_GGX:     ", "G_Schlick: ", "F_Schlick: ", "BRDF:      " };
+	for (int term = 0; term < 4; term++)
+	{
+		bool termPassed = worst[term] <= tolerance;
+		passed &= termPassed;
+		printf("%s %s vs. scalar differ by %g at most  %s\n", names[term], path, worst[term], termPassed ? "ok" : "FAILED");
+	}
+
+	// Whole images, with every light type
+	const unsigned int width = 67;
+	const unsigned int height = 45;
+	PbrReference::Frame frame = scene.Frame(6);
+	std::vector<PbrReference::Surface> surfaces = scene.Surfaces((size_t)width * height);
+	std::vector<float3> scalar, single, threaded;
+	PbrReference::ShadeImage(frame, surfaces, width, height, scalar, 1, false);
+	PbrReference::ShadeImage(frame, surfaces, width, height, single, 1, true);
+	PbrReference::ShadeImage(frame, surfaces, width, height, threaded, 4, true);
+	float imageDifference = MaxDifference(scalar, single);
+	bool imagePassed = imageDifference < 0.001f && MaxDifference(single, threaded) == 0;
+	passed &= imagePassed;
+	printf("Shade:      %s images differ by %g at most  %s\n", path, imageDifference, imagePassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All PBR reference checks passed" : "PBR reference checks FAILED");
+	return passed ? 0 : 1;
+}
+
+// --------------------------------------------------------
+// Shades a screen's worth of random surfaces with the CPU
+// copy of the lighting shader: one thread without SIMD, one
+// with AVX2, then AVX2 on every core.  Prints throughput
+// and how far the fast paths drift from the scalar one.
+//
+// lights - How many lights to shade with
+// --------------------------------------------------------
+int RunPbrBenchmark(unsigned int width, unsigned int height, unsigned int lights)
+{
+	PbrScene scene(540);
+	PbrReference::Frame frame = scene.Frame(lights);
+	std::vector<PbrReference::Surface> surfaces = scene.Surfaces((size_t)width * height);
+
+	auto run = [&](std::vector<float3>& colors, unsigned int threads, bool avx2)
+	{
+		double start = TestMilliseconds();
+		PbrReference::ShadeImage(frame, surfaces, width, height, colors, threads, avx2);
+		return surfaces.size() / (TestMilliseconds() - start) * 1000.0;
+	};
+
+	std::vector<float3> scalar, avx2, threaded;
+	double scalarRate = run(scalar, 1, false);
+	double avx2Rate = run(avx2, 1, true);
+	double threadedRate = run(threaded, 0, true);
+	float maxDifference = MaxDifference(scalar, threaded);
+
+	printf("PBR reference: %ux%u surfaces, %u lights, AVX2 %s\n", width, height, lights,
+		PbrReference::HasAvx2() ? "available" : "not available");
+	printf("  Scalar:     %.2f M samples/s\n", scalarRate / 1000000.0);
+	printf("  AVX2:       %.2f M samples/s\n", avx2Rate / 1000000.0);
+	printf("  Threads:    %.2f M samples/s (%u threads)\n", threadedRate / 1000000.0, std::thread::hardware_concurrency());
+	printf("  Difference: %g at most\n", maxDifference);
+	return maxDifference < 0.001f ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "../PostProcessChain.h"
+#include "EngineTests.h"
+
+// --------------------------------------------------------
+// Checks the post process chain planning.  Every plan is run
+// by name: each target holds a string for what's in it, each
+// pass writes its effects' names around what it read, and
+// what reaches the screen must match the chain evaluated one
+// effect at a time.  A pass that overwrote something still to
+// be read would show up as the wrong string.
+// - With nothing active there must be no passes, and the
+//   scene must go straight to the back buffer
+// - A straight run of effects must use two targets at most
+// - Per pixel effects after a pixelation must be fused into
+//   one pass
+// - A bloom-like chain (half size, then back onto the scene)
+//   must use three
+// - Additive passes must blend onto their second input, when
+//   nothing else reads it
+// - Effects nothing reads must be culled
+// - Then random chains and passes, for the same as above
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunPostChainTests()
+{
+	bool passed = true;
+	const unsigned int width = 1280;
+	const unsigned int height = 720;
+	const unsigned long long screenBytes = (unsigned long long)width * height * 4;
+
+	// Passes in a row, the first reading all of the effect's
+	// inputs, so set those first
+	auto setPasses = [](PostEffect& e, unsigned int passes, float scale)
+	{
+		e.Passes.clear();
+		for (unsigned int n = 0; passes > 1 && n < passes; n++)
+		{
+			PostEffectPass pass;
+			pass.Scale = scale;
+			pass.Inputs[0] = n > 0 ? (int)n - 1 : PostPassInput0;
+			pass.InputCount = n > 0 ? 1 : e.InputCount;
+			e.Passes.push_back(pass);
+		}
+	};
+	auto effect = [&](const char* name, PostEffectKind kind, float scale = 1.0f, unsigned int passes = 1)
+	{
+		PostEffect result;
+		result.Name = name;
+		result.Kind = kind;
+		result.Scale = scale;
+		setPasses(result, passes, scale);
+		return result;
+	};
+
+	// The chain one effect at a time, as a string
+	auto expected = [](const std::vector<PostEffect>& effects)
+	{
+		std::vector<std::string> outputs(effects.size());
+		std::string previous = "scene";
+		for (size_t i = 0; i < effects.size(); i++)
+		{
+			const PostEffect& e = effects[i];
+			std::vector<std::string> inputs;
+			for (unsigned int k = 0; k < e.InputCount; k++)
+			{
+				int input = e.Inputs[k];
+				inputs.push_back(input == PostInputPrevious ? previous : input == PostInputScene ? "scene" : outputs[input]);
+			}
+			if (!e.IsActive())
+			{
+				outputs[i] = inputs.empty() ? previous : inputs[0];
+				continue;
+			}
+
+			std::string joined = inputs.empty() ? "" : inputs[0];
+			for (size_t k = 1; k < inputs.size(); k++)
+				joined += "," + inputs[k];
+			if (e.Kind != PostEffectKind::Gather)
+				outputs[i] = std::string(e.Name) + "(" + joined + ")";
+			else if (e.Passes.empty())
+				outputs[i] = std::string(e.Name) + ".0(" + joined + ")";
+			else
+			{
+				// Each pass around what it reads
+				std::vector<std::string> passes;
+				for (unsigned int n = 0; n < e.Passes.size(); n++)
+				{
+					std::string args;
+					for (unsigned int k = 0; k < e.Passes[n].InputCount; k++)
+					{
+						int input = e.Passes[n].Inputs[k];
+						args += (k > 0 ? "," : "") + (input >= 0 ? passes[input] : inputs[-1 - input]);
+					}
+					passes.push_back(std::string(e.Name) + "." + std::to_string(n) + "(" + args + ")");
+				}
+				outputs[i] = passes.back();
+			}
+			previous = outputs[i];
+		}
+		return previous;
+	};
+
+	// Runs the plan by name, or returns "" if a pass reads
+	// what it writes (other than onto its second input, when
+	// it's additive) or anything's out of range
+	auto run = [](const std::vector<PostEffect>& effects, const PostChainPlan& plan)
+	{
+		std::vector<std::string> targets(plan.Targets.size(), "?");
+		if (plan.SceneTarget == PostBackBuffer)
+			return std::string(plan.Passes.empty() ? "scene" : "");
+		targets[plan.SceneTarget] = "scene";
+
+		std::string screen;
+		for (const PostPass& pass : plan.Passes)
+		{
+			std::string joined;
+			for (unsigned int k = 0; k < pass.InputCount; k++)
+			{
+				bool onto = pass.Additive && k == 1;
+				if (pass.Inputs[k] < 0 || pass.Inputs[k] >= (int)targets.size() || (pass.Inputs[k] == pass.Output) != onto)
+					return std::string();
+				joined += (k > 0 ? "," : "") + targets[pass.Inputs[k]];
+			}
+
+			std::string result = joined;
+			for (size_t e = 0; e < pass.Effects.size(); e++)
+			{
+				const PostEffect& fx = effects[pass.Effects[e]];
+				if (e == 0 && fx.Kind == PostEffectKind::Gather)
+					result = std::string(fx.Name) + "." + std::to_string(pass.Pass) + "(" + result + ")";
+				else
+					result = std::string(fx.Name) + "(" + result + ")";
+			}
+
+			if (pass.Output == PostBackBuffer)
+				screen = result;
+			else if (pass.Output < (int)targets.size())
+				targets[pass.Output] = result;
+			else
+				return std::string();
+		}
+		return screen;
+	};
+
+	auto check = [&](const std::vector<PostEffect>& effects, PostChainPlan& plan)
+	{
+		return PlanPostChain(effects, width, height, 4, plan) && run(effects, plan) == expected(effects) &&
+			(plan.Passes.empty() || plan.Passes.back().Output == PostBackBuffer);
+	};
+
+	// Nothing active: off, or every setting at its identity
+	std::vector<PostEffect> idle = { effect("blur", PostEffectKind::Gather, 1.0f, 2), effect("tint", PostEffectKind::PerPixel) };
+	idle[0].Params.push_back({ "Radius", 0.0f, 0.0f, 20.0f, 0.0f, true });
+	idle[1].Enabled = false;
+	PostChainPlan plan;
+	bool idlePassed = check(idle, plan) && plan.Passes.empty() && plan.SceneTarget == PostBackBuffer && plan.TargetBytes == 0;
+	passed &= idlePassed;
+	printf("Idle:       %u passes, scene to the back buffer  %s\n", (unsigned int)plan.Passes.size(), idlePassed ? "ok" : "FAILED");
+
+	std::vector<PostEffect> straight;
+	const char* names[] = { "a", "b", "c", "d", "e", "f", "g", "h" };
+	for (const char* name : names)
+		straight.push_back(effect(name, PostEffectKind::Gather, 1.0f, 2));
+	bool straightPassed = check(straight, plan) && plan.Passes.size() == 16 && plan.Targets.size() == 2 && plan.TargetBytes == 2 * screenBytes;
+	passed &= straightPassed;
+	printf("Straight:   %u passes, %u targets, %.1f MB  %s\n", (unsigned int)plan.Passes.size(), (unsigned int)plan.Targets.size(),
+		plan.TargetBytes / (1024.0 * 1024.0), straightPassed ? "ok" : "FAILED");
+
+	std::vector<PostEffect> fused = {
+		effect("pixelate", PostEffectKind::Resample),
+		effect("color", PostEffectKind::PerPixel),
+		effect("vignette", PostEffectKind::PerPixel) };
+	bool fusedPassed = check(fused, plan) && plan.Passes.size() == 1 && plan.FusedEffects == 2 && plan.Targets.size() == 1;
+	passed &= fusedPassed;
+	printf("Fused:      %u effects in %u pass, %u targets  %s\n", plan.ActiveEffects, (unsigned int)plan.Passes.size(),
+		(unsigned int)plan.Targets.size(), fusedPassed ? "ok" : "FAILED");
+
+	std::vector<PostEffect> bloom = {
+		effect("bright", PostEffectKind::Resample, 0.5f),
+		effect("blur", PostEffectKind::Gather, 0.5f, 2),
+		effect("composite", PostEffectKind::PerPixel),
+		effect("vignette", PostEffectKind::PerPixel) };
+	bloom[2].InputCount = 2;
+	bool bloomPassed = check(bloom, plan) && plan.Passes.size() == 4 && plan.Targets.size() == 3 &&
+		plan.TargetBytes == screenBytes + 2 * screenBytes / 4;
+	passed &= bloomPassed;
+	printf("Bloom:      %u passes, %u targets, %.1f MB  %s\n", (unsigned int)plan.Passes.size(), (unsigned int)plan.Targets.size(),
+		plan.TargetBytes / (1024.0 * 1024.0), bloomPassed ? "ok" : "FAILED");
+
+	// Reading the scene past the first effect leaves it unread,
+	// and an effect off in the middle passes its input along
+	std::vector<PostEffect> culled = {
+		effect("unread", PostEffectKind::Gather),
+		effect("skipped", PostEffectKind::Gather),
+		effect("sharpen", PostEffectKind::Gather) };
+	culled[1].Inputs[0] = PostInputScene;
+	culled[2].Enabled = false;
+	bool culledPassed = check(culled, plan) && plan.Passes.size() == 1 && plan.CulledPasses == 1;
+	passed &= culledPassed;
+	printf("Culled:     %u pass drawn, %u culled  %s\n", (unsigned int)plan.Passes.size(), plan.CulledPasses, culledPassed ? "ok" : "FAILED");
+
+	// The pyramid of a bloom: down to a sixteenth, back up
+	// adding each level to the one above, then onto the scene
+	std::vector<PostEffect> pyramid = { effect("bloom", PostEffectKind::Gather) };
+	for (unsigned int n = 0; n < 8; n++)
+	{
+		PostEffectPass pass;
+		pass.Scale = n < 4 ? 1.0f / (2 << n) : n < 7 ? 1.0f / (2 << (6 - n)) : 1.0f;
+		pass.Inputs[0] = n == 0 ? PostPassInput0 : (int)n - 1;
+		pass.Inputs[1] = n < 7 ? 6 - (int)n : PostPassInput0;
+		pass.InputCount = n < 4 ? 1 : 2;
+		pass.Additive = true;
+		pyramid[0].Passes.push_back(pass);
+	}
+	pyramid.push_back(effect("vignette", PostEffectKind::PerPixel));
+	unsigned int additive = 0;
+	bool pyramidPassed = check(pyramid, plan);
+	for (const PostPass& pass : plan.Passes)
+		additive += pass.Additive ? 1 : 0;
+	pyramidPassed &= additive == 4 && plan.Targets.size() == 5;
+	passed &= pyramidPassed;
+	printf("Pyramid:    %u passes, %u additive, %u targets, %.1f MB  %s\n", (unsigned int)plan.Passes.size(), additive,
+		(unsigned int)plan.Targets.size(), plan.TargetBytes / (1024.0 * 1024.0), pyramidPassed ? "ok" : "FAILED");
+
+	std::vector<PostEffect> backwards = { effect("a", PostEffectKind::Gather), effect("b", PostEffectKind::Gather, 1.0f, 2) };
+	backwards[0].Inputs[0] = 0;
+	bool backwardsPassed = !PlanPostChain(backwards, width, height, 4, plan) && plan.Passes.empty();
+	backwards[0].Inputs[0] = PostInputPrevious;
+	backwards[1].Passes[0].Inputs[0] = 1;
+	backwardsPassed &= !PlanPostChain(backwards, width, height, 4, plan);
+	backwards[1].Passes[0].Inputs[0] = PostPassInput1;
+	backwardsPassed &= !PlanPostChain(backwards, width, height, 4, plan);
+	passed &= backwardsPassed;
+	printf("Backwards:  refused  %s\n", backwardsPassed ? "ok" : "FAILED");
+
+	// Random chains, mostly straight, some reading the scene or
+	// an effect further back
+	std::mt19937 random(540);
+	const float scales[] = { 1.0f, 0.5f, 0.25f };
+	unsigned int chains = 0;
+	unsigned int failures = 0;
+	unsigned int mostTargets = 0;
+	unsigned int fusedTotal = 0;
+	unsigned int additiveTotal = 0;
+	for (int c = 0; c < 5000; c++)
+	{
+		std::vector<PostEffect> effects;
+		unsigned int count = 1 + random() % 8;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			PostEffect e = effect(names[i], (PostEffectKind)(random() % 3), scales[random() % 8 < 6 ? 0 : 1 + random() % 2]);
+			e.Enabled = random() % 5 != 0;
+			e.InputCount = random() % 4 == 0 ? 2 : 1;
+			for (unsigned int k = 0; k < e.InputCount; k++)
+			{
+				unsigned int pick = random() % 8;
+				e.Inputs[k] = pick < 5 ? PostInputPrevious : pick < 6 || i == 0 ? PostInputScene : (int)(random() % i);
+			}
+
+			// Gathers in a row of passes, or reading any before
+			// them, at any size, sometimes additive
+			if (e.Kind == PostEffectKind::Gather)
+			{
+				setPasses(e, 1 + random() % 3, e.Scale);
+				for (unsigned int n = 0; random() % 3 == 0 && n < 6; n++)
+				{
+					PostEffectPass pass;
+					pass.Scale = scales[random() % 3];
+					pass.InputCount = 1 + random() % 2;
+					for (unsigned int k = 0; k < pass.InputCount; k++)
+					{
+						unsigned int passCount = (unsigned int)e.Passes.size();
+						unsigned int pick = random() % (passCount + e.InputCount);
+						pass.Inputs[k] = pick < passCount ? (int)pick : -1 - (int)(pick - passCount);
+					}
+					pass.Additive = random() % 2 == 0;
+					e.Passes.push_back(pass);
+				}
+			}
+			effects.push_back(e);
+		}
+
+		chains++;
+		if (!check(effects, plan))
+			failures++;
+		mostTargets = plan.Targets.size() > mostTargets ? (unsigned int)plan.Targets.size() : mostTargets;
+		fusedTotal += plan.FusedEffects;
+		for (const PostPass& pass : plan.Passes)
+			additiveTotal += pass.Additive ? 1 : 0;
+	}
+	bool randomPassed = failures == 0;
+	passed &= randomPassed;
+	printf("Random:     %u chains, %u wrong, at most %u targets, %u effects fused, %u passes additive  %s\n", chains, failures,
+		mostTargets, fusedTotal, additiveTotal, randomPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All post chain checks passed" : "Post chain checks FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../SimpleShader.h"
+
+// --------------------------------------------------------
+// A pixel shader built from hand-written reflection data
+// instead of a .cso, so SimpleShader's tables and uploads
+// can be checked without a compiler or a GPU
+// --------------------------------------------------------
+class ReflectedShader : public SimplePixelShader
+{
+public:
+	ReflectedShader(std::shared_ptr<IGraphicsDevice> device, std::shared_ptr<IGraphicsContext> context, const ShaderReflectionData& data)
+		: SimplePixelShader(device, context, L"")
+	{
+		reflection = data;
+		BuildTables();
+		shaderValid = true;
+	}
+
+	SimpleConstantBuffer* GetBuffer(unsigned int index) { return index < constantBufferCount ? &constantBuffers[index] : 0; }
+	void Upload(unsigned int index) { UploadBuffer(&constantBuffers[index]); }
+};
+
+// --------------------------------------------------------
+// Adds a cbuffer variable to reflection data, with no type
+// information (SimpleShader only needs where it is)
+// --------------------------------------------------------
+inline void AddReflectedVariable(ShaderReflectionData::ConstantBuffer& buffer, const char* name, unsigned int offset, unsigned int size)
+{
+	ShaderReflectionData::Variable var;
+	var.Name = name;
+	var.ByteOffset = offset;
+	var.Size = size;
+	buffer.Variables.push_back(var);
+	if (offset + size > buffer.Size)
+		buffer.Size = (offset + size + 15) / 16 * 16;
+}
@@ -0,0 +1,166 @@
+#include <memory>
+#include <stdio.h>
+#include <vector>
+
+#include "../Bloom.h"
+#include "../NullBackend.h"
+#include "../PostProcessChain.h"
+#include "../RenderTargetPool.h"
+#include "EngineTests.h"
+
+// --------------------------------------------------------
+// Checks the render target pool against the null backend,
+// whose counts show every texture it really makes:
+// - Two targets of one description in a frame must be two
+//   textures, and the next frame must get both back
+// - Any difference in size, format, bind flags or samples
+//   must make a new one, and its memory must match what the
+//   backend holds
+// - A target still held must never be released, and a free
+//   one only once it's been idle for more than keepFrames
+// - A window drag, a new size every frame, applied as it
+//   goes and debounced to the end, must both settle back to
+//   one frame's worth of targets
+// - The post chain with bloom and blur must make nothing
+//   after its first frame
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunPoolTests()
+{
+	bool passed = true;
+	std::shared_ptr<NullGraphicsStats> stats = std::make_shared<NullGraphicsStats>();
+	std::shared_ptr<IGraphicsDevice> device = std::make_shared<NullGraphicsDevice>(stats);
+	auto texturesMade = [&]() { return stats->Calls[(size_t)GraphicsCall::CreateTexture2D]; };
+	const unsigned int keepFrames = 2;
+	RenderTargetPool pool(device, keepFrames);
+
+	RenderTargetDesc desc;
+	desc.Width = 640;
+	desc.Height = 360;
+	std::shared_ptr<PooledRenderTarget> a = pool.Acquire(desc);
+	std::shared_ptr<PooledRenderTarget> b = pool.Acquire(desc);
+	bool reusePassed = a && b && a != b && a->RTV && a->SRV && !a->DSV && texturesMade() == 2;
+	a.reset();
+	b.reset();
+	pool.EndFrame();
+	a = pool.Acquire(desc);
+	b = pool.Acquire(desc);
+	reusePassed &= a != b && texturesMade() == 2 && pool.GetReusedCount() == 2 && pool.GetInUseCount() == 2;
+	passed &= reusePassed;
+	printf("Reuse:      two of a kind in a frame, both back the next  %s\n", reusePassed ? "ok" : "FAILED");
+
+	std::vector<RenderTargetDesc> variants(5, desc);
+	variants[0].Width++;
+	variants[1].Height++;
+	variants[2].Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	variants[3].BindFlags = D3D11_BIND_RENDER_TARGET;
+	variants[4].SampleCount = 4;
+	std::vector<std::shared_ptr<PooledRenderTarget>> held;
+	for (const RenderTargetDesc& variant : variants)
+		held.push_back(pool.Acquire(variant));
+	bool keysPassed = texturesMade() == 2 + variants.size() && !held[3]->SRV;
+	held.clear();
+	pool.EndFrame();
+	for (const RenderTargetDesc& variant : variants)
+		held.push_back(pool.Acquire(variant));
+	keysPassed &= texturesMade() == 2 + variants.size();
+	bool memoryPassed = pool.GetBytes() == stats->TextureBytes && pool.GetBytes() > 0;
+	passed &= keysPassed && memoryPassed;
+	printf("Keys:       size, format, bind flags and samples kept apart  %s\n", keysPassed ? "ok" : "FAILED");
+	printf("Memory:     %.1f MB in %u targets, as the backend holds  %s\n", pool.GetBytes() / (1024.0 * 1024.0),
+		pool.GetTargetCount(), memoryPassed ? "ok" : "FAILED");
+
+	// Only a is kept from here on
+	held.clear();
+	b.reset();
+	bool agingPassed = true;
+	for (unsigned int frame = 0; frame < keepFrames; frame++)
+	{
+		pool.EndFrame();
+		agingPassed &= pool.GetTargetCount() == 2 + variants.size();
+	}
+	pool.EndFrame();
+	agingPassed &= pool.GetTargetCount() == 1 && pool.GetInUseCount() == 1 && stats->TextureBytes == a->Bytes;
+	for (unsigned int frame = 0; frame < 10; frame++)
+		pool.EndFrame();
+	agingPassed &= pool.GetTargetCount() == 1;
+	a.reset();
+	pool.ReleaseUnused();
+	agingPassed &= pool.GetTargetCount() == 0 && stats->TextureBytes == 0 && stats->LiveObjects == 0;
+	passed &= agingPassed;
+	printf("Aging:      held ones kept, free ones gone after %u idle frames  %s\n", keepFrames, agingPassed ? "ok" : "FAILED");
+
+	// The game's chain: bloom, a blur and a vignette
+	std::vector<PostEffect> chain(3);
+	chain[0].Name = "Bloom";
+	chain[0].Kind = PostEffectKind::Gather;
+	chain[0].Passes = BloomPasses();
+	chain[0].Params = { { "Intensity", 0.5f, 0.0f, 2.0f, 0.0f, false, true } };
+	chain[1].Name = "Blur";
+	chain[1].Kind = PostEffectKind::Gather;
+	chain[1].Passes.resize(2);
+	chain[1].Params = { { "Radius", 5.0f, 0.0f, 20.0f, 0.0f, true } };
+	chain[2].Name = "Vignette";
+	chain[2].Params = { { "Strength", 0.5f, 0.0f, 2.0f, 0.0f, false } };
+
+	// One frame: take every target the plan needs, then give them back
+	unsigned long long peakBytes = 0;
+	unsigned long long frameBytes = 0;
+	auto drawFrame = [&](RenderTargetPool& framePool, unsigned int width, unsigned int height)
+	{
+		PostChainPlan plan;
+		PlanPostChain(chain, width, height, 4, plan);
+		std::vector<std::shared_ptr<PooledRenderTarget>> targets;
+		for (const PostTarget& size : plan.Targets)
+		{
+			RenderTargetDesc targetDesc;
+			targetDesc.Width = size.Width;
+			targetDesc.Height = size.Height;
+			targets.push_back(framePool.Acquire(targetDesc));
+		}
+		peakBytes = framePool.GetBytes() > peakBytes ? framePool.GetBytes() : peakBytes;
+		frameBytes = plan.TargetBytes;
+		targets.clear();
+		framePool.EndFrame();
+	};
+
+	// Dragged from 1280x720 to 1880x1020 over two seconds
+	const unsigned int dragFrames = 120;
+	bool dragPassed = true;
+	unsigned int made[2] = {};
+	unsigned long long peak[2] = {};
+	for (int debounced = 0; debounced < 2; debounced++)
+	{
+		RenderTargetPool dragPool(device, keepFrames);
+		peakBytes = 0;
+		for (unsigned int frame = 0; frame <= dragFrames; frame++)
+		{
+			unsigned int step = debounced && frame < dragFrames ? 0 : frame;
+			drawFrame(dragPool, 1280 + 5 * step, 720 + step * 5 / 2);
+		}
+		for (unsigned int frame = 0; frame <= keepFrames; frame++)
+			drawFrame(dragPool, 1280 + 5 * dragFrames, 720 + dragFrames * 5 / 2);
+		made[debounced] = dragPool.GetCreatedCount();
+		peak[debounced] = peakBytes;
+		dragPassed &= dragPool.GetBytes() == frameBytes;
+	}
+	dragPassed &= made[1] < made[0] && stats->LiveObjects == 0;
+	passed &= dragPassed;
+	printf("Drag:       %u sizes: %u made, %.1f MB at most as it goes; %u made, %.1f MB debounced  %s\n", dragFrames,
+		made[0], peak[0] / (1024.0 * 1024.0), made[1], peak[1] / (1024.0 * 1024.0), dragPassed ? "ok" : "FAILED");
+
+	RenderTargetPool steadyPool(device, keepFrames);
+	drawFrame(steadyPool, 1920, 1080);
+	unsigned int firstFrame = steadyPool.GetCreatedCount();
+	unsigned long long before = texturesMade();
+	const unsigned int steadyFrames = 300;
+	for (unsigned int frame = 1; frame < steadyFrames; frame++)
+		drawFrame(steadyPool, 1920, 1080);
+	bool steadyPassed = texturesMade() == before && steadyPool.GetCreatedCount() == firstFrame && steadyPool.GetBytes() == frameBytes;
+	passed &= steadyPassed;
+	printf("Steady:     %u frames, %u targets made in the first, none after  %s\n", steadyFrames, firstFrame,
+		steadyPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All pool checks passed" : "Pool checks FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "../ShaderPermutation.h"
+#include "EngineTests.h"
+
+namespace
+{
+	// Stands in for fxc: "compiles" to the defines it was
+	// given, and can be told to fail
+	class StubShaderCompiler : public IShaderCompiler
+	{
+	public:
+		StubShaderCompiler() : Calls(0), Fail(false) {}
+
+		bool Compile(
+			const std::wstring& sourceFile,
+			const char* entryPoint,
+			const char* target,
+			const std::vector<ShaderDefine>& defines,
+			std::vector<unsigned char>& bytecode) override
+		{
+			Calls++;
+			LastDefines = defines;
+			if (Fail)
+				return false;
+
+			std::string text = std::string(entryPoint) + " " + target;
+			for (const ShaderDefine& define : defines)
+				text += " " + define.Name + "=" + define.Value;
+			bytecode.assign(text.begin(), text.end());
+			return true;
+		}
+
+		unsigned int Calls;
+		bool Fail;
+		std::vector<ShaderDefine> LastDefines;
+	};
+
+	void WriteText(const std::filesystem::path& path, const char* text)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << text;
+	}
+
+	std::string ReadText(const std::wstring& path)
+	{
+		std::ifstream file{ std::filesystem::path(path), std::ios::binary };
+		return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	// Which define a name is set to, or "" if it isn't
+	std::string DefineValue(const std::vector<ShaderDefine>& defines, const char* name)
+	{
+		for (const ShaderDefine& define : defines)
+			if (define.Name == name)
+				return define.Value;
+		return "";
+	}
+}
+
+// --------------------------------------------------------
+// Checks shader variants, with a stub standing in for the
+// compiler:
+// - Keys must pack to their documented bits and unpack to
+//   the same key, and keys that compile the same must share
+//   a canonical form
+// - Every define must be present, in order, and the variant
+//   hash must change with anything that changes the code,
+//   including what the source includes
+// - A variant must only be compiled the first time it's
+//   asked for; after that it comes from memory, or from disk
+//   on a later run
+// - A variant that fails to compile must not be retried
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunShaderPermutationTests()
+{
+	bool passed = true;
+
+	// Keys
+	ShaderPermutationKey key;
+	key.DirectionalLights = 1;
+	key.PointLights = 3;
+	key.SpotLights = 1;
+	key.Shadows = true;
+	key.BakedOcclusion = true;
+	bool keysPassed = key.Pack() == (1u | 3u << 4 | 1u << 8 | 1u << 14 | 1u << 17) && key.IsValid();
+	for (unsigned int bits = 0; bits < 1u << 18; bits += 37)
+		keysPassed &= ShaderPermutationKey::Unpack(bits).Pack() == bits;
+
+	ShaderPermutationKey unlit = key;
+	unlit.DirectionalLights = 0;
+	ShaderPermutationKey unshadowed = unlit;
+	unshadowed.Shadows = false;
+	ShaderPermutationKey clustered = key;
+	clustered.ClusteredLights = true;
+	clustered.PointLights = 12;
+	keysPassed &= unlit != unshadowed && unlit.Canonical() == unshadowed && clustered.IsValid() &&
+		clustered.Canonical().PointLights == 0 && clustered.Canonical().Shadows;
+	clustered.ClusteredLights = false;
+	keysPassed &= !clustered.IsValid();
+	passed &= keysPassed;
+	printf("Keys:       pack, unpack and canonicalize  %s\n", keysPassed ? "ok" : "FAILED");
+
+	// Defines and hashes
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "permutation-test";
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+	std::filesystem::create_directories(directory / "source", error);
+	std::filesystem::path source = directory / "source" / "Lit.hlsl";
+	std::filesystem::path include = directory / "source" / "Common.hlsli";
+	// The include includes itself, like a guarded header would
+	WriteText(source, "#include \"Common.hlsli\"\nfloat4 main() : SV_TARGET { return Ambient(); }\n");
+	WriteText(include, "#include \"Common.hlsli\"\nfloat4 Ambient() { return 0; }\n");
+
+	std::vector<ShaderDefine> defines = PermutationDefines(key);
+	const char* names[] = { "DIRECTIONAL_LIGHTS", "POINT_LIGHTS", "SPOT_LIGHTS", "NORMAL_MAP", "METALNESS_MAP",
+		"SHADOWS", "CLUSTERED_LIGHTS", "SPECULAR_IBL", "BAKED_OCCLUSION" };
+	bool hashPassed = defines.size() == 9;
+	for (size_t i = 0; i < defines.size() && hashPassed; i++)
+		hashPassed &= defines[i].Name == names[i];
+	hashPassed &= DefineValue(defines, "POINT_LIGHTS") == "3" && DefineValue(defines, "NORMAL_MAP") == "0";
+
+	unsigned long long sourceHash = 0;
+	hashPassed &= HashShaderSource(source.wstring(), sourceHash) && !HashShaderSource((directory / "Missing.hlsl").wstring(), sourceHash);
+	HashShaderSource(source.wstring(), sourceHash);
+	unsigned long long variantHash = HashPermutation(sourceHash, "main", "ps_5_0", defines);
+	hashPassed &= variantHash == HashPermutation(sourceHash, "main", "ps_5_0", PermutationDefines(key)) &&
+		variantHash != HashPermutation(sourceHash + 1, "main", "ps_5_0", defines) &&
+		variantHash != HashPermutation(sourceHash, "mai", "nps_5_0", defines) &&
+		variantHash != HashPermutation(sourceHash, "main", "ps_5_0", PermutationDefines(unlit));
+	const char* editedInclude = "#include \"Common.hlsli\"\nfloat4 Ambient() { return 1; }\n";
+	WriteText(include, editedInclude);
+	unsigned long long editedHash = 0;
+	hashPassed &= HashShaderSource(source.wstring(), editedHash) && editedHash != sourceHash;
+	WriteText(include, "#include \"Common.hlsli\"\nfloat4 Ambient() { return 0; }\n");
+	passed &= hashPassed;
+	printf("Hashes:     defines in order, includes change the hash  %s\n", hashPassed ? "ok" : "FAILED");
+
+	// Compiling on demand
+	std::shared_ptr<StubShaderCompiler> compiler = std::make_shared<StubShaderCompiler>();
+	std::wstring cacheDirectory = (directory / "cache").wstring();
+	ShaderPermutationCache cache(compiler, cacheDirectory);
+	std::wstring variant = cache.GetVariant(source.wstring(), "main", "ps_5_0", key);
+	bool compilePassed = !variant.empty() && compiler->Calls == 1 && cache.GetCompileCount() == 1 &&
+		ReadText(variant) == "main ps_5_0 DIRECTIONAL_LIGHTS=1 POINT_LIGHTS=3 SPOT_LIGHTS=1 NORMAL_MAP=0 METALNESS_MAP=0 "
+		"SHADOWS=1 CLUSTERED_LIGHTS=0 SPECULAR_IBL=0 BAKED_OCCLUSION=1";
+
+	// Only compiled keys in canonical form
+	std::wstring unlitVariant = cache.GetVariant(source.wstring(), "main", "ps_5_0", unlit);
+	compilePassed &= compiler->Calls == 2 && DefineValue(compiler->LastDefines, "SHADOWS") == "0";
+	compilePassed &= std::filesystem::path(cacheDirectory) == std::filesystem::path(variant).parent_path() &&
+		std::filesystem::path(variant).filename().wstring().rfind(L"Lit_", 0) == 0;
+	passed &= compilePassed;
+	printf("Compile:    a new variant is compiled and saved  %s\n", compilePassed ? "ok" : "FAILED");
+
+	// Memory, then disk
+	bool hitPassed = cache.GetVariant(source.wstring(), "main", "ps_5_0", key) == variant &&
+		cache.GetVariant(source.wstring(), "main", "ps_5_0", unshadowed) == unlitVariant &&
+		compiler->Calls == 2 && cache.GetRequestCount() == 4 && cache.GetVariantCount() == 2;
+	ShaderPermutationCache nextRun(compiler, cacheDirectory);
+	hitPassed &= nextRun.GetVariant(source.wstring(), "main", "ps_5_0", key) == variant &&
+		compiler->Calls == 2 && nextRun.GetDiskHitCount() == 1 && nextRun.GetCompileCount() == 0;
+
+	// The edited include makes it a new variant
+	WriteText(include, editedInclude);
+	ShaderPermutationCache edited(compiler, cacheDirectory);
+	std::wstring editedVariant = edited.GetVariant(source.wstring(), "main", "ps_5_0", key);
+	hitPassed &= !editedVariant.empty() && editedVariant != variant && compiler->Calls == 3 && edited.GetDiskHitCount() == 0;
+	passed &= hitPassed;
+	printf("Hits:       later requests come from memory or disk  %s\n", hitPassed ? "ok" : "FAILED");
+
+	// Failures
+	compiler->Fail = true;
+	ShaderPermutationKey broken = key;
+	broken.NormalMap = true;
+	bool failPassed = cache.GetVariant(source.wstring(), "main", "ps_5_0", broken).empty() &&
+		cache.GetVariant(source.wstring(), "main", "ps_5_0", broken).empty() &&
+		compiler->Calls == 4 && cache.GetFailureCount() == 1;
+	ShaderPermutationKey tooMany;
+	tooMany.PointLights = PermutationMaxLights + 1;
+	failPassed &= cache.GetVariant(source.wstring(), "main", "ps_5_0", tooMany).empty() && compiler->Calls == 4 &&
+		cache.GetVariant((directory / "Missing.hlsl").wstring(), "main", "ps_5_0", key).empty() && compiler->Calls == 4;
+	passed &= failPassed;
+	printf("Failures:   broken variants aren't compiled twice  %s\n", failPassed ? "ok" : "FAILED");
+
+	std::filesystem::remove_all(directory, error);
+	printf("%s\n", passed ? "All shader permutation checks passed" : "Shader permutation checks FAILED");
+	return passed ? 0 : 1;
+}
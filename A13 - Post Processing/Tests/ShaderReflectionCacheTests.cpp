@@ -0,0 +1,175 @@
+#include <filesystem>
+#include <fstream>
+#include <stdio.h>
+#include <vector>
+
+#include "../ShaderReflectionCache.h"
+#include "EngineTests.h"
+
+namespace
+{
+	// Reflection for a shader using every part of the format
+	ShaderReflectionData ExampleReflection()
+	{
+		ShaderReflectionData data;
+		ShaderReflectionData::ConstantBuffer cb;
+		cb.Name = "ExternalData";
+		cb.Type = 0;
+		cb.BindIndex = 1;
+		cb.Size = 288;
+
+		ShaderReflectionData::Variable var;
+		var.Name = "world";
+		var.Size = 64;
+		var.TypeName = "float4x4";
+		var.Class = 3;
+		var.BaseType = 3;
+		var.Rows = var.Columns = 4;
+		cb.Variables.push_back(var);
+
+		var = ShaderReflectionData::Variable();
+		var.Name = "lights";
+		var.ByteOffset = 64;
+		var.Size = 224;
+		var.TypeName = "Light";
+		var.Class = 5;
+		var.Rows = 1;
+		var.Columns = 16;
+		var.Elements = 4;
+		cb.Variables.push_back(var);
+		data.ConstantBuffers.push_back(cb);
+
+		cb = ShaderReflectionData::ConstantBuffer();
+		cb.Name = "Empty";
+		cb.BindIndex = 2;
+		data.ConstantBuffers.push_back(cb);
+
+		ShaderReflectionData::Resource resource;
+		resource.Name = "Albedo";
+		data.ShaderResourceViews.push_back(resource);
+		resource.Name = "ShadowMap";
+		resource.BindIndex = 4;
+		data.ShaderResourceViews.push_back(resource);
+		resource.Name = "BasicSampler";
+		resource.BindIndex = 0;
+		data.Samplers.push_back(resource);
+
+		ShaderReflectionData::InputParameter input;
+		input.SemanticName = "TEXCOORD";
+		input.SemanticIndex = 1;
+		input.ComponentType = 3;
+		input.Mask = 3;
+		data.InputParameters.push_back(input);
+		return data;
+	}
+
+	bool SameResources(const std::vector<ShaderReflectionData::Resource>& a, const std::vector<ShaderReflectionData::Resource>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++)
+			if (a[i].Name != b[i].Name || a[i].BindIndex != b[i].BindIndex)
+				return false;
+		return true;
+	}
+
+	bool SameReflection(const ShaderReflectionData& a, const ShaderReflectionData& b)
+	{
+		if (a.ConstantBuffers.size() != b.ConstantBuffers.size() || a.InputParameters.size() != b.InputParameters.size())
+			return false;
+
+		for (size_t c = 0; c < a.ConstantBuffers.size(); c++)
+		{
+			const ShaderReflectionData::ConstantBuffer& x = a.ConstantBuffers[c];
+			const ShaderReflectionData::ConstantBuffer& y = b.ConstantBuffers[c];
+			if (x.Name != y.Name || x.Type != y.Type || x.BindIndex != y.BindIndex || x.Size != y.Size || x.Variables.size() != y.Variables.size())
+				return false;
+			for (size_t v = 0; v < x.Variables.size(); v++)
+			{
+				const ShaderReflectionData::Variable& p = x.Variables[v];
+				const ShaderReflectionData::Variable& q = y.Variables[v];
+				if (p.Name != q.Name || p.ByteOffset != q.ByteOffset || p.Size != q.Size || p.TypeName != q.TypeName ||
+					p.Class != q.Class || p.BaseType != q.BaseType || p.Rows != q.Rows || p.Columns != q.Columns || p.Elements != q.Elements)
+					return false;
+			}
+		}
+
+		for (size_t i = 0; i < a.InputParameters.size(); i++)
+		{
+			const ShaderReflectionData::InputParameter& p = a.InputParameters[i];
+			const ShaderReflectionData::InputParameter& q = b.InputParameters[i];
+			if (p.SemanticName != q.SemanticName || p.SemanticIndex != q.SemanticIndex || p.ComponentType != q.ComponentType || p.Mask != q.Mask)
+				return false;
+		}
+
+		return SameResources(a.ShaderResourceViews, b.ShaderResourceViews) && SameResources(a.Samplers, b.Samplers);
+	}
+
+	bool WriteFile(const std::filesystem::path& path, const unsigned char* bytes, size_t size)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write((const char*)bytes, size);
+		return file.good();
+	}
+}
+
+// --------------------------------------------------------
+// Checks the .cso.refl cache SimpleShader keeps beside each
+// compiled shader:
+// - Everything saved must load back the same, through the
+//   file next to the shader
+// - A cache cut short anywhere, or with bytes past its end,
+//   must be rejected rather than half read
+// - A cache for other bytecode or another version of the
+//   format must be ignored
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunShaderReflectionCacheTests()
+{
+	bool passed = true;
+	const unsigned long long hash = HashShaderBytecode("DXBC shader", 11);
+	std::filesystem::path shaderPath = std::filesystem::temp_directory_path() / "reflection-test.cso";
+	std::filesystem::path cachePath(ShaderReflectionCachePath(shaderPath.wstring()));
+	ShaderReflectionData original = ExampleReflection();
+
+	// Round trip
+	ShaderReflectionData loaded;
+	bool roundTripPassed = cachePath.filename() == "reflection-test.cso.refl" &&
+		SaveShaderReflectionCache(shaderPath.wstring(), hash, original) &&
+		LoadShaderReflectionCache(shaderPath.wstring(), hash, loaded) && SameReflection(original, loaded);
+	std::vector<unsigned char> bytes;
+	SerializeShaderReflection(original, hash, bytes);
+	roundTripPassed &= std::filesystem::file_size(cachePath) == bytes.size();
+	passed &= roundTripPassed;
+	printf("Round trip: a saved cache loads back unchanged  %s\n", roundTripPassed ? "ok" : "FAILED");
+
+	// Every shorter prefix, and one byte too many
+	bool truncatedPassed = true;
+	for (size_t size = 0; size < bytes.size(); size++)
+	{
+		ShaderReflectionData partial;
+		truncatedPassed &= !DeserializeShaderReflection(bytes.data(), size, hash, partial);
+	}
+	std::vector<unsigned char> padded = bytes;
+	padded.push_back(0);
+	truncatedPassed &= !DeserializeShaderReflection(padded.data(), padded.size(), hash, loaded);
+	truncatedPassed &= WriteFile(cachePath, bytes.data(), bytes.size() / 2) && !LoadShaderReflectionCache(shaderPath.wstring(), hash, loaded);
+	truncatedPassed &= WriteFile(cachePath, bytes.data(), 0) && !LoadShaderReflectionCache(shaderPath.wstring(), hash, loaded);
+	passed &= truncatedPassed;
+	printf("Truncated:  short or overlong caches are rejected  %s\n", truncatedPassed ? "ok" : "FAILED");
+
+	// Stale caches
+	bool stalePassed = WriteFile(cachePath, bytes.data(), bytes.size()) && LoadShaderReflectionCache(shaderPath.wstring(), hash, loaded);
+	stalePassed &= !LoadShaderReflectionCache(shaderPath.wstring(), HashShaderBytecode("DXBC shadeR", 11), loaded);
+	std::vector<unsigned char> otherVersion = bytes;
+	otherVersion[4]++;
+	stalePassed &= !DeserializeShaderReflection(otherVersion.data(), otherVersion.size(), hash, loaded);
+	std::error_code ignored;
+	std::filesystem::remove(cachePath, ignored);
+	stalePassed &= !LoadShaderReflectionCache(shaderPath.wstring(), hash, loaded);
+	passed &= stalePassed;
+	printf("Stale:      other bytecode or versions are ignored  %s\n", stalePassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All shader reflection cache checks passed" : "Shader reflection cache checks FAILED");
+	return passed ? 0 : 1;
+}
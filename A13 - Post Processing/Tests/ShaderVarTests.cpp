@@ -0,0 +1,126 @@
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+
+#include "../NullBackend.h"
+#include "EngineTests.h"
+#include "ReflectedShader.h"
+
+namespace
+{
+	// Two names with the same FNV-1a hash, found by brute force
+	static_assert(HashShaderVarName("glbvs", 5) == HashShaderVarName("yacxa", 5), "Names must collide");
+
+	// A cbuffer laid out like the entity shaders' per-object data
+	ShaderReflectionData EntityReflection(bool withCollision)
+	{
+		ShaderReflectionData data;
+		ShaderReflectionData::ConstantBuffer buffer;
+		buffer.Name = "ExternalData";
+		AddReflectedVariable(buffer, "world", 0, 64);
+		AddReflectedVariable(buffer, "worldInverseTranspose", 64, 64);
+		AddReflectedVariable(buffer, "view", 128, 64);
+		AddReflectedVariable(buffer, "projection", 192, 64);
+		AddReflectedVariable(buffer, "colorTint", 256, 16);
+		AddReflectedVariable(buffer, "glbvs", 272, 4);
+		if (withCollision)
+			AddReflectedVariable(buffer, "yacxa", 276, 4);
+		data.ConstantBuffers.push_back(buffer);
+		return data;
+	}
+
+	float ReadFloat(ReflectedShader& shader, unsigned int offset)
+	{
+		float value = 0;
+		memcpy(&value, shader.GetBuffer(0)->LocalDataBuffer + offset, sizeof(value));
+		return value;
+	}
+}
+
+// --------------------------------------------------------
+// Checks lookups by compile-time hashed name:
+// - Every variable must be found, at the same place a
+//   lookup by string finds it
+// - A name the shader doesn't have must not be found, even
+//   when it hashes the same as one it does
+// - Two variables with the same hash must each find their
+//   own offset
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunShaderVarTests()
+{
+	bool passed = true;
+	std::shared_ptr<NullGraphicsStats> stats = std::make_shared<NullGraphicsStats>();
+	std::shared_ptr<NullGraphicsDevice> device = std::make_shared<NullGraphicsDevice>(stats);
+	std::shared_ptr<NullGraphicsContext> context = std::make_shared<NullGraphicsContext>(stats);
+
+	// Same places as the string lookups
+	ReflectedShader shader(device, context, EntityReflection(false));
+	DirectX::XMFLOAT4 tint(1, 2, 3, 4);
+	bool namesPassed = shader.SetFloat4("colorTint"_var, tint) && memcmp(shader.GetBuffer(0)->LocalDataBuffer + 256, &tint, sizeof(tint)) == 0;
+	namesPassed &= shader.SetFloat("glbvs"_var, 5.0f) && ReadFloat(shader, 272) == 5.0f;
+	DirectX::XMFLOAT4X4 matrix = {};
+	matrix._11 = matrix._22 = matrix._33 = matrix._44 = 1;
+	namesPassed &= shader.SetMatrix4x4("projection"_var, matrix) &&
+		memcmp(shader.GetBuffer(0)->LocalDataBuffer + shader.GetVariableHandle("projection").ByteOffset, &matrix, sizeof(matrix)) == 0;
+	namesPassed &= !shader.SetFloat("missing"_var, 1.0f);
+	passed &= namesPassed;
+	printf("Names:      hashed names find what string names find  %s\n", namesPassed ? "ok" : "FAILED");
+
+	// A colliding name the shader doesn't have
+	bool missPassed = !shader.SetFloat("yacxa"_var, 7.0f) && ReadFloat(shader, 272) == 5.0f;
+	passed &= missPassed;
+	printf("Collision:  a name hashing like a real variable isn't found  %s\n", missPassed ? "ok" : "FAILED");
+
+	// Both colliding names in one shader
+	ReflectedShader both(device, context, EntityReflection(true));
+	bool bothPassed = both.SetFloat("glbvs"_var, 8.0f) && both.SetFloat("yacxa"_var, 9.0f) &&
+		ReadFloat(both, 272) == 8.0f && ReadFloat(both, 276) == 9.0f;
+	passed &= bothPassed;
+	printf("Both:       colliding variables each find their own  %s\n", bothPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All shader variable checks passed" : "Shader variable checks FAILED");
+	return passed ? 0 : 1;
+}
+
+// --------------------------------------------------------
+// Times setting a matrix by std::string, by compile-time
+// hashed name and through a handle, alternating between two
+// values so every set actually copies
+// --------------------------------------------------------
+int RunShaderVarBenchmark()
+{
+	std::shared_ptr<NullGraphicsStats> stats = std::make_shared<NullGraphicsStats>();
+	ReflectedShader shader(std::make_shared<NullGraphicsDevice>(stats), std::make_shared<NullGraphicsContext>(stats), EntityReflection(false));
+
+	DirectX::XMFLOAT4X4 matrices[2] = {};
+	matrices[0]._11 = matrices[0]._22 = matrices[0]._33 = matrices[0]._44 = 1;
+	matrices[1]._11 = matrices[1]._22 = matrices[1]._33 = matrices[1]._44 = 2;
+	const int sets = 4000000;
+	ShaderVarHandle handle = shader.GetVariableHandle("worldInverseTranspose");
+	bool allSet = true;
+
+	printf("Setting a 64 byte matrix %d times:\n", sets);
+	for (int method = 0; method < 3; method++)
+	{
+		double start = TestMilliseconds();
+		for (int i = 0; i < sets; i++)
+		{
+			const DirectX::XMFLOAT4X4& value = matrices[i & 1];
+			switch (method)
+			{
+			case 0: allSet &= shader.SetMatrix4x4(std::string("worldInverseTranspose"), value); break;
+			case 1: allSet &= shader.SetMatrix4x4("worldInverseTranspose"_var, value); break;
+			default: allSet &= shader.SetMatrix4x4(handle, value); break;
+			}
+		}
+		double elapsed = TestMilliseconds() - start;
+
+		const char* names[3] = { "std::string", "_var", "handle" };
+		printf("  %-12s %8.2f ms  %6.2f ns/set  %6.1fM sets/s\n", names[method], elapsed,
+			elapsed * 1000000.0 / sets, sets / elapsed / 1000.0);
+	}
+
+	printf("%s\n", allSet ? "Shader variable benchmark done" : "Shader variable benchmark FAILED to set a variable");
+	return allSet ? 0 : 1;
+}
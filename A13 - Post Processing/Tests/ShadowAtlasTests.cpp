@@ -0,0 +1,236 @@
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include "../ShadowAtlas.h"
+#include "../ShadowCascades.h"
+#include "EngineTests.h"
+
+// --------------------------------------------------------
+// Checks the shadow atlas allocator and the projections
+// for each kind of light, on the CPU alone:
+// - Random sets of tiles that fit by area are all placed at
+//   full size, inside the atlas, on their own grid, without
+//   overlapping, even as they change from set to set
+// - Sets too big for the atlas still fill most of it, and
+//   the most important request keeps its size
+// - Lights that don't change keep their tiles while others
+//   come, go and resize around them, unless the atlas is so
+//   full that repacking it is worth a few moves
+// - Tile matrices land clip space on their tile, and every
+//   point in a light's range lands in the right point light
+//   face, or in a spot light's frustum if it's in the cone
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunShadowAtlasTests()
+{
+	bool passed = true;
+	const unsigned int atlasSize = 4096;
+	const unsigned int minTile = 128;
+	std::mt19937 random(540);
+	auto randomSize = [&](unsigned int smallest, unsigned int largest)
+	{
+		unsigned int size = smallest;
+		while (size < largest && random() % 2)
+			size *= 2;
+		return size;
+	};
+
+	// Inside the atlas, aligned to their size, and apart
+	auto valid = [&](const std::vector<ShadowAtlasRect>& tiles)
+	{
+		for (size_t i = 0; i < tiles.size(); i++)
+		{
+			const ShadowAtlasRect& a = tiles[i];
+			if (a.Size == 0)
+				continue;
+			if (a.X % a.Size || a.Y % a.Size || a.X + a.Size > atlasSize || a.Y + a.Size > atlasSize)
+				return false;
+
+			for (size_t j = i + 1; j < tiles.size(); j++)
+			{
+				const ShadowAtlasRect& b = tiles[j];
+				if (b.Size > 0 && a.X < b.X + b.Size && b.X < a.X + a.Size && a.Y < b.Y + b.Size && b.Y < a.Y + a.Size)
+					return false;
+			}
+		}
+		return true;
+	};
+
+	// Sets that fit, one after another on the same allocator so
+	// kept tiles and repacks are both exercised
+	ShadowAtlasAllocator atlas(atlasSize, minTile);
+	std::vector<ShadowTileRequest> requests;
+	std::vector<ShadowAtlasRect> tiles;
+	unsigned long long requested = 0;
+	unsigned long long placed = 0;
+	bool packingPassed = true;
+	for (int set = 0; set < 300; set++)
+	{
+		requests.clear();
+		unsigned long long area = 0;
+		for (unsigned int key = 0; key < 64; key++)
+		{
+			unsigned int size = randomSize(minTile, 2048);
+			if (random() % 3 == 0 || area + size * size > (unsigned long long)atlasSize * atlasSize)
+				continue;
+			requests.push_back({ key, size });
+			area += size * size;
+		}
+
+		atlas.Allocate(requests, tiles);
+		requested += area;
+		placed += atlas.GetFrameStats().UsedTexels;
+		packingPassed &= valid(tiles) && atlas.GetFrameStats().UsedTexels == area;
+	}
+	passed &= packingPassed;
+	printf("Packing:    %.2f%% of requested texels placed, %u repacks in 300 sets  %s\n",
+		100.0 * placed / requested, atlas.GetTotalStats().Repacks, packingPassed ? "ok" : "FAILED");
+
+	// Too much to fit
+	bool overfullPassed = true;
+	double worstUse = 1.0;
+	for (int set = 0; set < 100; set++)
+	{
+		requests.clear();
+		unsigned long long area = 0;
+		for (unsigned int key = 0; area < 2ull * atlasSize * atlasSize; key++)
+		{
+			unsigned int size = randomSize(minTile, 2048);
+			requests.push_back({ key, size });
+			area += size * size;
+		}
+
+		atlas.Allocate(requests, tiles);
+		double use = (double)atlas.GetFrameStats().UsedTexels / ((double)atlasSize * atlasSize);
+		worstUse = fmin(worstUse, use);
+		overfullPassed &= valid(tiles) && tiles[0].Size == requests[0].Size && use >= 0.9;
+	}
+	passed &= overfullPassed;
+	printf("Overfull:   worst %.1f%% of the atlas used  %s\n", 100.0 * worstUse, overfullPassed ? "ok" : "FAILED");
+
+	// Lights that keep their requests while a couple of others
+	// change each frame.  With room to spare none should move;
+	// with the atlas nearly full, repacks move a few.
+	auto churn = [&](unsigned int lights, unsigned int largest, double& moved, double& used)
+	{
+		atlas.Reset(atlasSize, minTile);
+		requests.clear();
+		for (unsigned int key = 0; key < lights; key++)
+			requests.push_back({ key, randomSize(minTile, largest) });
+		atlas.Allocate(requests, tiles);
+		atlas.Allocate(requests, tiles);
+		bool ok = atlas.GetFrameStats().Kept == requests.size();
+
+		unsigned int unchanged = 0;
+		unsigned int unchangedMoved = 0;
+		unsigned long long wanted = 0;
+		unsigned long long placed = 0;
+		for (int frame = 0; frame < 1000; frame++)
+		{
+			std::vector<ShadowAtlasRect> before = tiles;
+			std::vector<bool> changed(requests.size(), false);
+			for (int change = 0; change < 2; change++)
+			{
+				unsigned int i = random() % requests.size();
+				requests[i].Size = randomSize(minTile, largest);
+				if (random() % 4 == 0)
+					requests[i].Key += 1000;	// Left, and another came
+				changed[i] = true;
+			}
+
+			atlas.Allocate(requests, tiles);
+			ok &= valid(tiles);
+			placed += atlas.GetFrameStats().UsedTexels;
+			for (size_t i = 0; i < requests.size(); i++)
+			{
+				wanted += (unsigned long long)requests[i].Size * requests[i].Size;
+				if (changed[i])
+					continue;
+				unchanged++;
+				if (tiles[i].X != before[i].X || tiles[i].Y != before[i].Y || tiles[i].Size != before[i].Size)
+					unchangedMoved++;
+			}
+		}
+		moved = (double)unchangedMoved / unchanged;
+		used = (double)placed / wanted;
+		return ok;
+	};
+
+	double moved, used;
+	bool roomyPassed = churn(20, 1024, moved, used) && moved == 0.0 && used == 1.0;
+	passed &= roomyPassed;
+	printf("Churn:      20 lights, %.2f%% of unchanged tiles moved, %.1f%% of texels placed  %s\n",
+		100.0 * moved, 100.0 * used, roomyPassed ? "ok" : "FAILED");
+	bool crowdedPassed = churn(32, 2048, moved, used) && moved < 0.1 && used > 0.8;
+	passed &= crowdedPassed;
+	printf("            32 lights, %.2f%% of unchanged tiles moved, %.1f%% of texels placed, %u repacks  %s\n",
+		100.0 * moved, 100.0 * used, atlas.GetTotalStats().Repacks, crowdedPassed ? "ok" : "FAILED");
+
+	// Clip space corners onto the tile's corners
+	const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	const ShadowAtlasRect tile = { 1024, 512, 256 };
+	float toTile[16];
+	ShadowTileTransform(identity, tile, atlasSize, toTile);
+	auto uv = [&](float x, float y, float& u, float& v)
+	{
+		u = x * toTile[0] + y * toTile[4] + toTile[12];
+		v = x * toTile[1] + y * toTile[5] + toTile[13];
+	};
+	float u0, v0, u1, v1;
+	uv(-1, 1, u0, v0);
+	uv(1, -1, u1, v1);
+	bool tilePassed =
+		fabsf(u0 - 1024.0f / atlasSize) < 0.00001f && fabsf(v0 - 512.0f / atlasSize) < 0.00001f &&
+		fabsf(u1 - 1280.0f / atlasSize) < 0.00001f && fabsf(v1 - 768.0f / atlasSize) < 0.00001f;
+	passed &= tilePassed;
+	printf("Tile:       (%.4f, %.4f) to (%.4f, %.4f)  %s\n", u0, v0, u1, v1, tilePassed ? "ok" : "FAILED");
+
+	// Points around lights, in their range
+	const float lightPosition[3] = { 3.0f, 3.0f, 0.0f };
+	const float spotDirection[3] = { 0.2f, -1.0f, 0.1f };
+	const float range = 10.0f;
+	const float outerAngle = 0.5f;
+	float faces[6][16];
+	float spot[16];
+	bool projectionsPassed = SpotShadowMatrix(lightPosition, spotDirection, outerAngle, range, 512, spot);
+	for (unsigned int face = 0; face < 6; face++)
+		projectionsPassed &= PointShadowMatrix(lightPosition, face, range, 512, faces[face]);
+
+	auto inside = [](const float m[16], const float p[3])
+	{
+		float clip[4];
+		for (int i = 0; i < 4; i++)
+			clip[i] = p[0] * m[i] + p[1] * m[4 + i] + p[2] * m[8 + i] + m[12 + i];
+		return fabsf(clip[0]) <= clip[3] && fabsf(clip[1]) <= clip[3] && clip[2] >= 0 && clip[2] <= clip[3];
+	};
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	float spotLength = sqrtf(spotDirection[0] * spotDirection[0] + spotDirection[1] * spotDirection[1] + spotDirection[2] * spotDirection[2]);
+	unsigned int inCone = 0;
+	for (int i = 0; i < 10000; i++)
+	{
+		float offset[3] = { unit(random), unit(random), unit(random) };
+		float length = sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+		if (length < 0.05f || length > 1.0f)
+			continue;
+
+		float distance = 0.2f + (range - 0.3f) * length;
+		float point[3];
+		for (int a = 0; a < 3; a++)
+			point[a] = lightPosition[a] + offset[a] / length * distance;
+		projectionsPassed &= inside(faces[PointShadowFace(offset)], point);
+
+		float cosine = (offset[0] * spotDirection[0] + offset[1] * spotDirection[1] + offset[2] * spotDirection[2]) / (length * spotLength);
+		if (cosine > cosf(outerAngle))
+		{
+			inCone++;
+			projectionsPassed &= inside(spot, point);
+		}
+	}
+	passed &= projectionsPassed;
+	printf("Lights:     point faces and spot cone (%u points in it)  %s\n", inCone, projectionsPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All shadow atlas checks passed" : "Shadow atlas checks FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+#include <DirectXMath.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "../ShadowAtlas.h"
+#include "../ShadowCascades.h"
+#include "EngineTests.h"
+
+using DirectX::XMFLOAT2;
+using DirectX::XMFLOAT3;
+using DirectX::XMFLOAT4X4;
+
+namespace
+{
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	XMFLOAT3 Normalize(const XMFLOAT3& v)
+	{
+		float scale = 1.0f / sqrtf(Dot(v, v));
+		return XMFLOAT3(v.x * scale, v.y * scale, v.z * scale);
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	// Like XMMatrixLookToLH, with Y up
+	XMFLOAT4X4 LookTo(const XMFLOAT3& position, const XMFLOAT3& forward)
+	{
+		XMFLOAT3 z = Normalize(forward);
+		XMFLOAT3 x = Normalize(Cross(XMFLOAT3(0, 1, 0), z));
+		XMFLOAT3 y = Cross(z, x);
+
+		XMFLOAT4X4 m = {};
+		m._11 = x.x; m._12 = y.x; m._13 = z.x;
+		m._21 = x.y; m._22 = y.y; m._23 = z.y;
+		m._31 = x.z; m._32 = y.z; m._33 = z.z;
+		m._41 = -Dot(x, position);
+		m._42 = -Dot(y, position);
+		m._43 = -Dot(z, position);
+		m._44 = 1;
+		return m;
+	}
+
+	// Back out of a view matrix, which only turns and moves
+	XMFLOAT3 ViewToWorld(const XMFLOAT3& p, const XMFLOAT4X4& view)
+	{
+		XMFLOAT3 moved(p.x - view._41, p.y - view._42, p.z - view._43);
+		return XMFLOAT3(
+			moved.x * view._11 + moved.y * view._12 + moved.z * view._13,
+			moved.x * view._21 + moved.y * view._22 + moved.z * view._23,
+			moved.x * view._31 + moved.y * view._32 + moved.z * view._33);
+	}
+
+	// Like XMVector3Transform, row vector times matrix with
+	// w = 1, keeping x, y and z
+	XMFLOAT3 Transform(const XMFLOAT3& p, const float m[16])
+	{
+		return XMFLOAT3(
+			p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12],
+			p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13],
+			p.x * m[2] + p.y * m[6] + p.z * m[10] + m[14]);
+	}
+}
+
+// --------------------------------------------------------
+// Checks the cascade fitting with the scene's first light,
+// turning a camera through 200 directions:
+// - Splits must be even for lambda 0, a constant ratio apart
+//   for lambda 1, and end at the shadow distance
+// - Every corner of each cascade's slice of the frustum must
+//   land inside its clip space and its tile of the atlas
+// - The cascades mustn't change size, and fixed points in
+//   the world must stay at the same spot within a texel, so
+//   the map only ever slides by whole texels
+// - The same must hold while the camera walks along a line
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunShadowCascadeTests()
+{
+	bool passed = true;
+	const float nearPlane = 0.1f;
+	const float farPlane = 30.0f;
+
+	float splits[ShadowCascadeCount];
+	bool splitsPassed = true;
+	ComputeCascadeSplits(nearPlane, farPlane, 0.0f, splits);
+	for (unsigned int i = 0; i < ShadowCascadeCount; i++)
+		splitsPassed &= fabsf(splits[i] - (nearPlane + (farPlane - nearPlane) * (i + 1) / ShadowCascadeCount)) < 0.0001f;
+	ComputeCascadeSplits(nearPlane, farPlane, 1.0f, splits);
+	for (unsigned int i = 1; i < ShadowCascadeCount; i++)
+		splitsPassed &= fabsf(splits[i] / splits[i - 1] - splits[0] / nearPlane) < 0.001f;
+	ComputeCascadeSplits(nearPlane, farPlane, 0.75f, splits);
+	for (unsigned int i = 1; i < ShadowCascadeCount; i++)
+		splitsPassed &= splits[i] > splits[i - 1];
+	splitsPassed &= splits[0] > nearPlane && splits[ShadowCascadeCount - 1] == farPlane;
+	passed &= splitsPassed;
+	printf("Splits:     %.3f %.3f %.3f %.3f  %s\n", splits[0], splits[1], splits[2], splits[3], splitsPassed ? "ok" : "FAILED");
+
+	ShadowCascadeSettings settings;
+	settings.ShadowDistance = farPlane;
+	const float lightDirection[3] = { 0.0f, -0.25f, 1.0f };
+	const float fov = 45.0f * 3.14159265f / 180.0f;
+	const float aspect = 16.0f / 9.0f;
+	const XMFLOAT3 probes[] = { { 0, 0, 0 }, { 3.3f, -1.7f, 2.1f }, { -7.25f, 0.5f, 4.0f }, { 12.0f, -3.0f, -9.0f } };
+
+	// Checks one camera, and compares it to the first one
+	float firstScale[ShadowCascadeCount];
+	const unsigned int probeCount = sizeof(probes) / sizeof(probes[0]);
+	XMFLOAT2 firstTexel[ShadowCascadeCount][probeCount];
+	bool first = true;
+	float worstCorner = 0.0f;
+	float worstDrift = 0.0f;
+	auto check = [&](XMFLOAT3 position, XMFLOAT3 forward)
+	{
+		XMFLOAT4X4 viewFloats = LookTo(position, forward);
+		ShadowCascades cascades;
+		if (!FitShadowCascades(&viewFloats._11, fov, aspect, nearPlane, lightDirection, settings, cascades))
+			return false;
+
+		bool ok = true;
+		for (unsigned int c = 0; c < ShadowCascadeCount; c++)
+		{
+			const ShadowCascade& cascade = cascades.Cascades[c];
+			ShadowAtlasRect rect = { (c % 2) * settings.Resolution, (c / 2) * settings.Resolution, settings.Resolution };
+			XMFLOAT4X4 atlasFloats;
+			ShadowTileTransform(cascade.ViewProjection, rect, settings.Resolution * 2, &atlasFloats._11);
+			XMFLOAT2 tile = XMFLOAT2((c % 2) * 0.5f, (c / 2) * 0.5f);
+
+			for (int corner = 0; corner < 8; corner++)
+			{
+				float depth = (corner & 4) ? cascade.FarDepth : cascade.NearDepth;
+				XMFLOAT3 viewCorner(
+					((corner & 1) ? 1 : -1) * depth * tanf(fov * 0.5f) * aspect,
+					((corner & 2) ? 1 : -1) * depth * tanf(fov * 0.5f),
+					depth);
+				XMFLOAT3 world = ViewToWorld(viewCorner, viewFloats);
+				XMFLOAT3 clip = Transform(world, cascade.ViewProjection);
+				XMFLOAT3 uv = Transform(world, &atlasFloats._11);
+				worstCorner = fmaxf(worstCorner, fmaxf(fabsf(clip.x), fabsf(clip.y)));
+				ok &= fabsf(clip.x) <= 1.0001f && fabsf(clip.y) <= 1.0001f && clip.z >= 0.0f && clip.z <= 1.0f;
+				ok &= uv.x >= tile.x - 0.0001f && uv.x <= tile.x + 0.5001f && uv.y >= tile.y - 0.0001f && uv.y <= tile.y + 0.5001f;
+			}
+
+			// Size comes from the length of the matrix's first column
+			float scale = cascade.ViewProjection[0] * cascade.ViewProjection[0] +
+				cascade.ViewProjection[4] * cascade.ViewProjection[4] +
+				cascade.ViewProjection[8] * cascade.ViewProjection[8];
+			if (first)
+				firstScale[c] = scale;
+			ok &= fabsf(scale - firstScale[c]) <= firstScale[c] * 0.000001f;
+
+			for (unsigned int p = 0; p < probeCount; p++)
+			{
+				XMFLOAT3 clip = Transform(probes[p], cascade.ViewProjection);
+				float u = (clip.x * 0.5f + 0.5f) * settings.Resolution;
+				float v = (0.5f - clip.y * 0.5f) * settings.Resolution;
+				XMFLOAT2 within = XMFLOAT2(u - floorf(u), v - floorf(v));
+				if (first)
+					firstTexel[c][p] = within;
+
+				float driftU = fabsf(within.x - firstTexel[c][p].x);
+				float driftV = fabsf(within.y - firstTexel[c][p].y);
+				worstDrift = fmaxf(worstDrift, fmaxf(fminf(driftU, 1.0f - driftU), fminf(driftV, 1.0f - driftV)));
+			}
+		}
+		first = false;
+		return ok;
+	};
+
+	bool turningPassed = true;
+	for (int step = 0; step < 200; step++)
+	{
+		float yaw = step * 0.137f;
+		float pitch = sinf(step * 0.31f) * 1.2f;
+		turningPassed &= check(XMFLOAT3(3.0f, 2.0f, -2.0f), XMFLOAT3(cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw)));
+	}
+	turningPassed &= worstDrift < 0.01f;
+	passed &= turningPassed;
+	printf("Turning:    worst corner %.4f, worst drift %.5f texels  %s\n", worstCorner, worstDrift, turningPassed ? "ok" : "FAILED");
+
+	bool walkingPassed = true;
+	worstDrift = 0.0f;
+	for (int step = 0; step < 200; step++)
+		walkingPassed &= check(XMFLOAT3(3.0f - step * 0.0371f, 2.0f, -2.0f + step * 0.0537f), XMFLOAT3(0.3f, -0.2f, 1.0f));
+	walkingPassed &= worstDrift < 0.01f;
+	passed &= walkingPassed;
+	printf("Walking:    worst corner %.4f, worst drift %.5f texels  %s\n", worstCorner, worstDrift, walkingPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All cascade checks passed" : "Cascade checks FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+#include <DirectXMath.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../ShadowCasterCache.h"
+#include "EngineTests.h"
+
+using DirectX::XMFLOAT3;
+using DirectX::XMFLOAT4X4;
+
+namespace
+{
+	// Like XMMatrixTranslation
+	XMFLOAT4X4 Translation(float x, float y, float z)
+	{
+		XMFLOAT4X4 m = {};
+		m._11 = m._22 = m._33 = m._44 = 1;
+		m._41 = x;
+		m._42 = y;
+		m._43 = z;
+		return m;
+	}
+}
+
+// --------------------------------------------------------
+// Checks when the shadow caster cache redraws cascades, on
+// the CPU alone:
+// - The first frame, a changed light, and Invalidate() redraw
+//   every cascade; an unchanged frame or a tiny camera move
+//   redraws none
+// - Moving or removing a static caster redraws only the
+//   cascades it's in; moving a dynamic caster, or one that's
+//   culled or doesn't cast, redraws none
+// - Making a static caster dynamic redraws where it was, and
+//   copies stop once nothing dynamic is drawn over them
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunShadowCacheTests()
+{
+	const float lightDirection[3] = { 0.0f, -0.25f, 1.0f };
+	const float fov = 45.0f * 3.14159265f / 180.0f;
+	const float aspect = 16.0f / 9.0f;
+	ShadowCascadeSettings settings;
+	auto fit = [&](XMFLOAT3 position, const float light[3])
+	{
+		// Looking down +Z, so the view only moves the world
+		XMFLOAT4X4 view = Translation(-position.x, -position.y, -position.z);
+		ShadowCascades cascades = {};
+		FitShadowCascades(&view._11, fov, aspect, 0.1f, light, settings, cascades);
+		return cascades;
+	};
+
+	// Unit cubes, some static, one dynamic, one that doesn't cast
+	// and one far off to the side of every cascade
+	auto cube = [](float x, float y, float z, bool isStatic, bool casts)
+	{
+		ShadowCaster caster = {};
+		XMFLOAT4X4 world = Translation(x, y, z);
+		memcpy(caster.World, &world._11, sizeof(caster.World));
+		for (int i = 0; i < 3; i++)
+		{
+			caster.LocalMin[i] = -0.5f;
+			caster.LocalMax[i] = 0.5f;
+		}
+		caster.CastsShadows = casts;
+		caster.Static = isStatic;
+		return caster;
+	};
+	std::vector<ShadowCaster> casters = {
+		cube(0, 0, 1, true, true),
+		cube(0, 0, 20, true, true),
+		cube(2, 0, 3, false, true),
+		cube(0, -3, 0, true, false),
+		cube(200, 0, 0, true, true) };
+	enum { Near, Far, Dynamic, NonCaster, Culled };
+
+	ShadowCascades cascades = fit(XMFLOAT3(0, 0, -2), lightDirection);
+	auto cascadesWith = [&](const ShadowCaster& caster)
+	{
+		unsigned int mask = 0;
+		for (unsigned int c = 0; c < ShadowCascadeCount; c++)
+			mask |= (unsigned int)CasterInFrustum(caster, cascades.Cascades[c].ViewProjection) << c;
+		return mask;
+	};
+
+	ShadowCasterCache cache;
+	auto redrawn = [&](const ShadowCascades& fitted)
+	{
+		cache.Update(fitted, casters);
+		unsigned int mask = 0;
+		for (unsigned int c = 0; c < ShadowCascadeCount; c++)
+			mask |= (unsigned int)cache.NeedsRedraw(c) << c;
+		return mask;
+	};
+
+	bool passed = true;
+	auto report = [&](const char* name, unsigned int mask, unsigned int expected)
+	{
+		bool ok = mask == expected;
+		passed &= ok;
+		printf("%-34s redrew %x, expected %x  %s\n", name, mask, expected, ok ? "ok" : "FAILED");
+	};
+	const unsigned int all = (1u << ShadowCascadeCount) - 1;
+	const unsigned int farMask = cascadesWith(casters[Far]);
+	const unsigned int nearMask = cascadesWith(casters[Near]);
+
+	report("First frame", redrawn(cascades), all);
+	const ShadowCacheStats firstStats = cache.GetFrameStats();
+	report("Nothing changed", redrawn(cascades), 0);
+	const ShadowCacheStats& stats = cache.GetFrameStats();
+	bool statsPassed = stats.CachedDraws == firstStats.StaticDraws && stats.StaticDraws == 0 &&
+		stats.DynamicDraws == firstStats.DynamicDraws && cascadesWith(casters[Culled]) == 0;
+	passed &= statsPassed;
+	printf("%-34s %u cached, %u dynamic, %u culled  %s\n", "Skipped draws", stats.CachedDraws, stats.DynamicDraws, stats.CulledDraws,
+		statsPassed ? "ok" : "FAILED");
+
+	casters[Dynamic].World[12] += 0.5f;
+	report("Dynamic caster moved", redrawn(cascades), 0);
+	casters[Far].World[12] += 0.5f;
+	report("Far static caster moved", redrawn(cascades), farMask);
+	casters[Culled].World[12] += 5.0f;
+	report("Culled caster moved", redrawn(cascades), 0);
+	casters[NonCaster].World[12] += 1.0f;
+	report("Non-caster moved", redrawn(cascades), 0);
+	casters[Near].Static = false;
+	report("Near caster made dynamic", redrawn(cascades), nearMask);
+
+	casters[Near].Static = true;
+	casters[Dynamic].Static = true;
+	redrawn(cascades);
+	redrawn(cascades);
+	bool copiesPassed = cache.GetFrameStats().Copies == 0;
+	passed &= copiesPassed;
+	printf("%-34s %u  %s\n", "Copies with nothing dynamic", cache.GetFrameStats().Copies, copiesPassed ? "ok" : "FAILED");
+
+	const float turnedLight[3] = { 0.1f, -0.25f, 1.0f };
+	report("Light turned", redrawn(fit(XMFLOAT3(0, 0, -2), turnedLight)), all);
+	report("Light turned back", redrawn(cascades), all);
+	ShadowCascades nudged = fit(XMFLOAT3(0.00001f, 0, -2.00001f), lightDirection);
+	report("Camera nudged", redrawn(nudged), 0);
+	cache.Invalidate();
+	report("Invalidated", redrawn(nudged), all);
+
+	casters.pop_back();
+	report("Culled caster removed", redrawn(nudged), 0);
+	casters.erase(casters.begin() + NonCaster);
+	report("Non-caster removed", redrawn(nudged), 0);
+	casters.erase(casters.begin() + Far);
+	report("Far static caster removed", redrawn(nudged) & farMask, farMask);
+
+	printf("%s\n", passed ? "All shadow cache checks passed" : "Shadow cache checks FAILED");
+	return passed ? 0 : 1;
+}
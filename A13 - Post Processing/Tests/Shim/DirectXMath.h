@@ -0,0 +1,55 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// --------------------------------------------------------
+// The DirectXMath storage types, for code that only keeps
+// or copies them.  Same layouts as the real ones.
+// --------------------------------------------------------
+namespace DirectX
+{
+	struct XMFLOAT2
+	{
+		float x, y;
+		XMFLOAT2() = default;
+		constexpr XMFLOAT2(float x, float y) : x(x), y(y) {}
+	};
+
+	struct XMFLOAT3
+	{
+		float x, y, z;
+		XMFLOAT3() = default;
+		constexpr XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+	};
+
+	struct XMFLOAT4
+	{
+		float x, y, z, w;
+		XMFLOAT4() = default;
+		constexpr XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMFLOAT4X4
+	{
+		union
+		{
+			struct
+			{
+				float _11, _12, _13, _14;
+				float _21, _22, _23, _24;
+				float _31, _32, _33, _34;
+				float _41, _42, _43, _44;
+			};
+			float m[4][4];
+		};
+		XMFLOAT4X4() = default;
+	};
+
+	struct XMINT2 { int32_t x, y; };
+	struct XMINT3 { int32_t x, y, z; };
+	struct XMINT4 { int32_t x, y, z, w; };
+	struct XMUINT2 { uint32_t x, y; };
+	struct XMUINT3 { uint32_t x, y, z; };
+	struct XMUINT4 { uint32_t x, y, z, w; };
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+// --------------------------------------------------------
+// Just enough of <Windows.h> for the engine's CPU-side code
+// to build off Windows, for the test target only.  Nothing
+// here talks to an OS: it's the COM basics (types, HRESULTs,
+// GUIDs and IUnknown) that the graphics interfaces sit on,
+// plus console and debugger output that goes to stdout or
+// nowhere.
+//
+// __uuidof() hands out a GUID per interface type, made up
+// here rather than the real IIDs, which only have to differ
+// from each other for QueryInterface() to work.
+// --------------------------------------------------------
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+#include <type_traits>
+
+typedef unsigned char BYTE;
+typedef unsigned char UINT8;
+typedef unsigned short USHORT;
+typedef unsigned short WORD;
+typedef int INT;
+typedef unsigned int UINT;
+typedef int BOOL;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef uint32_t DWORD;
+typedef int64_t INT64;
+typedef uint64_t UINT64;
+typedef float FLOAT;
+typedef size_t SIZE_T;
+typedef const char* LPCSTR;
+typedef const wchar_t* LPCWSTR;
+typedef int32_t HRESULT;
+typedef void* HANDLE;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define S_OK			((HRESULT)0)
+#define S_FALSE			((HRESULT)1)
+#define E_NOTIMPL		((HRESULT)0x80004001L)
+#define E_NOINTERFACE	((HRESULT)0x80004002L)
+#define E_POINTER		((HRESULT)0x80004003L)
+#define E_FAIL			((HRESULT)0x80004005L)
+#define E_OUTOFMEMORY	((HRESULT)0x8007000EL)
+#define E_INVALIDARG	((HRESULT)0x80070057L)
+#define DXGI_ERROR_NOT_FOUND	((HRESULT)0x887A0002L)
+#define DXGI_ERROR_MORE_DATA	((HRESULT)0x887A0003L)
+
+#define SUCCEEDED(hr)	(((HRESULT)(hr)) >= 0)
+#define FAILED(hr)		(((HRESULT)(hr)) < 0)
+
+#define STDMETHODCALLTYPE
+
+// Windows.h's min() and max() macros, as functions so the
+// standard headers that come after still build
+template<typename A, typename B>
+inline auto max(A a, B b) -> decltype(a > b ? a : b) { return a > b ? a : b; }
+template<typename A, typename B>
+inline auto min(A a, B b) -> decltype(a < b ? a : b) { return a < b ? a : b; }
+
+struct GUID
+{
+	uint32_t Data1;
+	uint16_t Data2;
+	uint16_t Data3;
+	uint8_t Data4[8];
+};
+
+inline bool operator==(const GUID& a, const GUID& b) { return memcmp(&a, &b, sizeof(GUID)) == 0; }
+inline bool operator!=(const GUID& a, const GUID& b) { return !(a == b); }
+
+typedef GUID IID;
+typedef const GUID& REFGUID;
+typedef const IID& REFIID;
+
+// Each interface's GUID, filled in by SHIM_UUID() next to its declaration
+template<typename Interface>
+struct ShimUuid;
+
+#define SHIM_UUID(Interface, number) \
+	template<> struct ShimUuid<Interface> { static constexpr GUID Value = { number, 0, 0, { 0, 0, 0, 0, 0, 0, 0, 0 } }; };
+
+// Takes either a type or an expression, like MSVC's
+#define __uuidof(x) (ShimUuid<typename std::remove_cv<typename std::remove_reference<__typeof__(x)>::type>::type>::Value)
+
+#define IID_PPV_ARGS(pp) __uuidof(**(pp)), reinterpret_cast<void**>(pp)
+
+struct IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) = 0;
+	virtual ULONG STDMETHODCALLTYPE AddRef() = 0;
+	virtual ULONG STDMETHODCALLTYPE Release() = 0;
+};
+SHIM_UUID(IUnknown, 1)
+
+// --------------------------------------------------------
+// Console and debugger output
+// --------------------------------------------------------
+#define ZeroMemory(destination, length) memset((destination), 0, (length))
+
+#define printf_s printf
+#define wprintf_s wprintf
+
+#define STD_OUTPUT_HANDLE		((DWORD)-11)
+#define FOREGROUND_BLUE			0x0001
+#define FOREGROUND_GREEN		0x0002
+#define FOREGROUND_RED			0x0004
+#define FOREGROUND_INTENSITY	0x0008
+
+inline HANDLE GetStdHandle(DWORD handle) { return 0; }
+inline BOOL SetConsoleTextAttribute(HANDLE console, WORD attributes) { return TRUE; }
+inline void OutputDebugStringA(LPCSTR text) {}
+inline void OutputDebugStringW(LPCWSTR text) {}
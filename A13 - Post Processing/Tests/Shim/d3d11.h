@@ -0,0 +1,640 @@
+#pragma once
+
+#include <Windows.h>
+#include <d3dcommon.h>
+#include <dxgiformat.h>
+
+// --------------------------------------------------------
+// The part of <d3d11.h> the engine's CPU-side code names,
+// for the test target only.  Enums, limits and structs match
+// the real header (traces write descs out byte for byte).
+//
+// Interfaces the null backend implements are declared with
+// every method the real ones have, so the stand-ins it makes
+// are the objects they claim to be.  The device and context
+// only have what the engine calls on them; nothing here can
+// create a real one.
+// --------------------------------------------------------
+
+// Limits
+#define D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT	14
+#define D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT		128
+#define D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT				16
+#define D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT			32
+#define D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT				8
+#define D3D11_APPEND_ALIGNED_ELEMENT						0xffffffff
+#define D3D11_SO_NO_RASTERIZED_STREAM						0xffffffff
+#define D3D11_SO_BUFFER_SLOT_COUNT							4
+#define D3D11_PS_CS_UAV_REGISTER_COUNT						8
+#define D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE	16
+#define D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT				4096
+#define D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_A_TERM	128
+#define D3D11_DEFAULT_SAMPLE_MASK							0xffffffff
+
+typedef D3D_PRIMITIVE_TOPOLOGY D3D11_PRIMITIVE_TOPOLOGY;
+#define D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED		D3D_PRIMITIVE_TOPOLOGY_UNDEFINED
+#define D3D11_PRIMITIVE_TOPOLOGY_POINTLIST		D3D_PRIMITIVE_TOPOLOGY_POINTLIST
+#define D3D11_PRIMITIVE_TOPOLOGY_LINELIST		D3D_PRIMITIVE_TOPOLOGY_LINELIST
+#define D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP		D3D_PRIMITIVE_TOPOLOGY_LINESTRIP
+#define D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST	D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+#define D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP	D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP
+
+typedef D3D_SRV_DIMENSION D3D11_SRV_DIMENSION;
+#define D3D11_SRV_DIMENSION_UNKNOWN				D3D_SRV_DIMENSION_UNKNOWN
+#define D3D11_SRV_DIMENSION_BUFFER				D3D_SRV_DIMENSION_BUFFER
+#define D3D11_SRV_DIMENSION_TEXTURE2D			D3D_SRV_DIMENSION_TEXTURE2D
+#define D3D11_SRV_DIMENSION_TEXTURE2DARRAY		D3D_SRV_DIMENSION_TEXTURE2DARRAY
+#define D3D11_SRV_DIMENSION_TEXTURE3D			D3D_SRV_DIMENSION_TEXTURE3D
+#define D3D11_SRV_DIMENSION_TEXTURECUBE			D3D_SRV_DIMENSION_TEXTURECUBE
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ ENUMS ---------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+enum D3D11_USAGE
+{
+	D3D11_USAGE_DEFAULT = 0,
+	D3D11_USAGE_IMMUTABLE = 1,
+	D3D11_USAGE_DYNAMIC = 2,
+	D3D11_USAGE_STAGING = 3,
+};
+
+enum D3D11_BIND_FLAG
+{
+	D3D11_BIND_VERTEX_BUFFER = 0x1,
+	D3D11_BIND_INDEX_BUFFER = 0x2,
+	D3D11_BIND_CONSTANT_BUFFER = 0x4,
+	D3D11_BIND_SHADER_RESOURCE = 0x8,
+	D3D11_BIND_STREAM_OUTPUT = 0x10,
+	D3D11_BIND_RENDER_TARGET = 0x20,
+	D3D11_BIND_DEPTH_STENCIL = 0x40,
+	D3D11_BIND_UNORDERED_ACCESS = 0x80,
+};
+
+enum D3D11_CPU_ACCESS_FLAG
+{
+	D3D11_CPU_ACCESS_WRITE = 0x10000,
+	D3D11_CPU_ACCESS_READ = 0x20000,
+};
+
+enum D3D11_RESOURCE_MISC_FLAG
+{
+	D3D11_RESOURCE_MISC_GENERATE_MIPS = 0x1,
+	D3D11_RESOURCE_MISC_TEXTURECUBE = 0x4,
+};
+
+enum D3D11_MAP
+{
+	D3D11_MAP_READ = 1,
+	D3D11_MAP_WRITE = 2,
+	D3D11_MAP_READ_WRITE = 3,
+	D3D11_MAP_WRITE_DISCARD = 4,
+	D3D11_MAP_WRITE_NO_OVERWRITE = 5,
+};
+
+enum D3D11_CLEAR_FLAG
+{
+	D3D11_CLEAR_DEPTH = 0x1,
+	D3D11_CLEAR_STENCIL = 0x2,
+};
+
+enum D3D11_ASYNC_GETDATA_FLAG
+{
+	D3D11_ASYNC_GETDATA_DONOTFLUSH = 0x1,
+};
+
+enum D3D11_QUERY
+{
+	D3D11_QUERY_EVENT = 0,
+	D3D11_QUERY_OCCLUSION = 1,
+	D3D11_QUERY_TIMESTAMP = 2,
+	D3D11_QUERY_TIMESTAMP_DISJOINT = 3,
+};
+
+enum D3D11_RESOURCE_DIMENSION
+{
+	D3D11_RESOURCE_DIMENSION_UNKNOWN = 0,
+	D3D11_RESOURCE_DIMENSION_BUFFER = 1,
+	D3D11_RESOURCE_DIMENSION_TEXTURE1D = 2,
+	D3D11_RESOURCE_DIMENSION_TEXTURE2D = 3,
+	D3D11_RESOURCE_DIMENSION_TEXTURE3D = 4,
+};
+
+enum D3D11_RTV_DIMENSION
+{
+	D3D11_RTV_DIMENSION_UNKNOWN = 0,
+	D3D11_RTV_DIMENSION_BUFFER = 1,
+	D3D11_RTV_DIMENSION_TEXTURE1D = 2,
+	D3D11_RTV_DIMENSION_TEXTURE1DARRAY = 3,
+	D3D11_RTV_DIMENSION_TEXTURE2D = 4,
+	D3D11_RTV_DIMENSION_TEXTURE2DARRAY = 5,
+	D3D11_RTV_DIMENSION_TEXTURE2DMS = 6,
+	D3D11_RTV_DIMENSION_TEXTURE2DMSARRAY = 7,
+	D3D11_RTV_DIMENSION_TEXTURE3D = 8,
+};
+
+enum D3D11_DSV_DIMENSION
+{
+	D3D11_DSV_DIMENSION_UNKNOWN = 0,
+	D3D11_DSV_DIMENSION_TEXTURE1D = 1,
+	D3D11_DSV_DIMENSION_TEXTURE1DARRAY = 2,
+	D3D11_DSV_DIMENSION_TEXTURE2D = 3,
+	D3D11_DSV_DIMENSION_TEXTURE2DARRAY = 4,
+	D3D11_DSV_DIMENSION_TEXTURE2DMS = 5,
+	D3D11_DSV_DIMENSION_TEXTURE2DMSARRAY = 6,
+};
+
+enum D3D11_INPUT_CLASSIFICATION
+{
+	D3D11_INPUT_PER_VERTEX_DATA = 0,
+	D3D11_INPUT_PER_INSTANCE_DATA = 1,
+};
+
+enum D3D11_FILTER
+{
+	D3D11_FILTER_MIN_MAG_MIP_POINT = 0,
+	D3D11_FILTER_MIN_MAG_MIP_LINEAR = 0x15,
+	D3D11_FILTER_ANISOTROPIC = 0x55,
+	D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR = 0x95,
+};
+
+enum D3D11_TEXTURE_ADDRESS_MODE
+{
+	D3D11_TEXTURE_ADDRESS_WRAP = 1,
+	D3D11_TEXTURE_ADDRESS_MIRROR = 2,
+	D3D11_TEXTURE_ADDRESS_CLAMP = 3,
+	D3D11_TEXTURE_ADDRESS_BORDER = 4,
+};
+
+enum D3D11_COMPARISON_FUNC
+{
+	D3D11_COMPARISON_NEVER = 1,
+	D3D11_COMPARISON_LESS = 2,
+	D3D11_COMPARISON_EQUAL = 3,
+	D3D11_COMPARISON_LESS_EQUAL = 4,
+	D3D11_COMPARISON_GREATER = 5,
+	D3D11_COMPARISON_NOT_EQUAL = 6,
+	D3D11_COMPARISON_GREATER_EQUAL = 7,
+	D3D11_COMPARISON_ALWAYS = 8,
+};
+
+enum D3D11_FILL_MODE
+{
+	D3D11_FILL_WIREFRAME = 2,
+	D3D11_FILL_SOLID = 3,
+};
+
+enum D3D11_CULL_MODE
+{
+	D3D11_CULL_NONE = 1,
+	D3D11_CULL_FRONT = 2,
+	D3D11_CULL_BACK = 3,
+};
+
+enum D3D11_DEPTH_WRITE_MASK
+{
+	D3D11_DEPTH_WRITE_MASK_ZERO = 0,
+	D3D11_DEPTH_WRITE_MASK_ALL = 1,
+};
+
+enum D3D11_STENCIL_OP
+{
+	D3D11_STENCIL_OP_KEEP = 1,
+	D3D11_STENCIL_OP_ZERO = 2,
+	D3D11_STENCIL_OP_REPLACE = 3,
+};
+
+enum D3D11_BLEND
+{
+	D3D11_BLEND_ZERO = 1,
+	D3D11_BLEND_ONE = 2,
+	D3D11_BLEND_SRC_ALPHA = 5,
+	D3D11_BLEND_INV_SRC_ALPHA = 6,
+};
+
+enum D3D11_BLEND_OP
+{
+	D3D11_BLEND_OP_ADD = 1,
+	D3D11_BLEND_OP_SUBTRACT = 2,
+	D3D11_BLEND_OP_REV_SUBTRACT = 3,
+	D3D11_BLEND_OP_MIN = 4,
+	D3D11_BLEND_OP_MAX = 5,
+};
+
+enum D3D11_COLOR_WRITE_ENABLE
+{
+	D3D11_COLOR_WRITE_ENABLE_ALL = 0xf,
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ STRUCTS -------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+struct D3D11_BOX
+{
+	UINT left;
+	UINT top;
+	UINT front;
+	UINT right;
+	UINT bottom;
+	UINT back;
+};
+
+struct D3D11_VIEWPORT
+{
+	FLOAT TopLeftX;
+	FLOAT TopLeftY;
+	FLOAT Width;
+	FLOAT Height;
+	FLOAT MinDepth;
+	FLOAT MaxDepth;
+};
+
+struct D3D11_SUBRESOURCE_DATA
+{
+	const void* pSysMem;
+	UINT SysMemPitch;
+	UINT SysMemSlicePitch;
+};
+
+struct D3D11_MAPPED_SUBRESOURCE
+{
+	void* pData;
+	UINT RowPitch;
+	UINT DepthPitch;
+};
+
+struct D3D11_BUFFER_DESC
+{
+	UINT ByteWidth;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+	UINT StructureByteStride;
+};
+
+struct D3D11_TEXTURE2D_DESC
+{
+	UINT Width;
+	UINT Height;
+	UINT MipLevels;
+	UINT ArraySize;
+	DXGI_FORMAT Format;
+	DXGI_SAMPLE_DESC SampleDesc;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+};
+
+struct D3D11_TEXTURE3D_DESC
+{
+	UINT Width;
+	UINT Height;
+	UINT Depth;
+	UINT MipLevels;
+	DXGI_FORMAT Format;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+};
+
+struct D3D11_BUFFER_SRV
+{
+	union { UINT FirstElement; UINT ElementOffset; };
+	union { UINT NumElements; UINT ElementWidth; };
+};
+struct D3D11_BUFFEREX_SRV { UINT FirstElement; UINT NumElements; UINT Flags; };
+struct D3D11_TEX1D_SRV { UINT MostDetailedMip; UINT MipLevels; };
+struct D3D11_TEX1D_ARRAY_SRV { UINT MostDetailedMip; UINT MipLevels; UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX2D_SRV { UINT MostDetailedMip; UINT MipLevels; };
+struct D3D11_TEX2D_ARRAY_SRV { UINT MostDetailedMip; UINT MipLevels; UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX2DMS_SRV { UINT UnusedField_NothingToDefine; };
+struct D3D11_TEX2DMS_ARRAY_SRV { UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX3D_SRV { UINT MostDetailedMip; UINT MipLevels; };
+struct D3D11_TEXCUBE_SRV { UINT MostDetailedMip; UINT MipLevels; };
+struct D3D11_TEXCUBE_ARRAY_SRV { UINT MostDetailedMip; UINT MipLevels; UINT First2DArrayFace; UINT NumCubes; };
+
+struct D3D11_SHADER_RESOURCE_VIEW_DESC
+{
+	DXGI_FORMAT Format;
+	D3D11_SRV_DIMENSION ViewDimension;
+	union
+	{
+		D3D11_BUFFER_SRV Buffer;
+		D3D11_TEX1D_SRV Texture1D;
+		D3D11_TEX1D_ARRAY_SRV Texture1DArray;
+		D3D11_TEX2D_SRV Texture2D;
+		D3D11_TEX2D_ARRAY_SRV Texture2DArray;
+		D3D11_TEX2DMS_SRV Texture2DMS;
+		D3D11_TEX2DMS_ARRAY_SRV Texture2DMSArray;
+		D3D11_TEX3D_SRV Texture3D;
+		D3D11_TEXCUBE_SRV TextureCube;
+		D3D11_TEXCUBE_ARRAY_SRV TextureCubeArray;
+		D3D11_BUFFEREX_SRV BufferEx;
+	};
+};
+
+struct D3D11_BUFFER_RTV
+{
+	union { UINT FirstElement; UINT ElementOffset; };
+	union { UINT NumElements; UINT ElementWidth; };
+};
+struct D3D11_TEX1D_RTV { UINT MipSlice; };
+struct D3D11_TEX1D_ARRAY_RTV { UINT MipSlice; UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX2D_RTV { UINT MipSlice; };
+struct D3D11_TEX2D_ARRAY_RTV { UINT MipSlice; UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX2DMS_RTV { UINT UnusedField_NothingToDefine; };
+struct D3D11_TEX2DMS_ARRAY_RTV { UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX3D_RTV { UINT MipSlice; UINT FirstWSlice; UINT WSize; };
+
+struct D3D11_RENDER_TARGET_VIEW_DESC
+{
+	DXGI_FORMAT Format;
+	D3D11_RTV_DIMENSION ViewDimension;
+	union
+	{
+		D3D11_BUFFER_RTV Buffer;
+		D3D11_TEX1D_RTV Texture1D;
+		D3D11_TEX1D_ARRAY_RTV Texture1DArray;
+		D3D11_TEX2D_RTV Texture2D;
+		D3D11_TEX2D_ARRAY_RTV Texture2DArray;
+		D3D11_TEX2DMS_RTV Texture2DMS;
+		D3D11_TEX2DMS_ARRAY_RTV Texture2DMSArray;
+		D3D11_TEX3D_RTV Texture3D;
+	};
+};
+
+struct D3D11_TEX1D_DSV { UINT MipSlice; };
+struct D3D11_TEX1D_ARRAY_DSV { UINT MipSlice; UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX2D_DSV { UINT MipSlice; };
+struct D3D11_TEX2D_ARRAY_DSV { UINT MipSlice; UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX2DMS_DSV { UINT UnusedField_NothingToDefine; };
+struct D3D11_TEX2DMS_ARRAY_DSV { UINT FirstArraySlice; UINT ArraySize; };
+
+struct D3D11_DEPTH_STENCIL_VIEW_DESC
+{
+	DXGI_FORMAT Format;
+	D3D11_DSV_DIMENSION ViewDimension;
+	UINT Flags;
+	union
+	{
+		D3D11_TEX1D_DSV Texture1D;
+		D3D11_TEX1D_ARRAY_DSV Texture1DArray;
+		D3D11_TEX2D_DSV Texture2D;
+		D3D11_TEX2D_ARRAY_DSV Texture2DArray;
+		D3D11_TEX2DMS_DSV Texture2DMS;
+		D3D11_TEX2DMS_ARRAY_DSV Texture2DMSArray;
+	};
+};
+
+struct D3D11_SAMPLER_DESC
+{
+	D3D11_FILTER Filter;
+	D3D11_TEXTURE_ADDRESS_MODE AddressU;
+	D3D11_TEXTURE_ADDRESS_MODE AddressV;
+	D3D11_TEXTURE_ADDRESS_MODE AddressW;
+	FLOAT MipLODBias;
+	UINT MaxAnisotropy;
+	D3D11_COMPARISON_FUNC ComparisonFunc;
+	FLOAT BorderColor[4];
+	FLOAT MinLOD;
+	FLOAT MaxLOD;
+};
+
+struct D3D11_RASTERIZER_DESC
+{
+	D3D11_FILL_MODE FillMode;
+	D3D11_CULL_MODE CullMode;
+	BOOL FrontCounterClockwise;
+	INT DepthBias;
+	FLOAT DepthBiasClamp;
+	FLOAT SlopeScaledDepthBias;
+	BOOL DepthClipEnable;
+	BOOL ScissorEnable;
+	BOOL MultisampleEnable;
+	BOOL AntialiasedLineEnable;
+};
+
+struct D3D11_DEPTH_STENCILOP_DESC
+{
+	D3D11_STENCIL_OP StencilFailOp;
+	D3D11_STENCIL_OP StencilDepthFailOp;
+	D3D11_STENCIL_OP StencilPassOp;
+	D3D11_COMPARISON_FUNC StencilFunc;
+};
+
+struct D3D11_DEPTH_STENCIL_DESC
+{
+	BOOL DepthEnable;
+	D3D11_DEPTH_WRITE_MASK DepthWriteMask;
+	D3D11_COMPARISON_FUNC DepthFunc;
+	BOOL StencilEnable;
+	UINT8 StencilReadMask;
+	UINT8 StencilWriteMask;
+	D3D11_DEPTH_STENCILOP_DESC FrontFace;
+	D3D11_DEPTH_STENCILOP_DESC BackFace;
+};
+
+struct D3D11_RENDER_TARGET_BLEND_DESC
+{
+	BOOL BlendEnable;
+	D3D11_BLEND SrcBlend;
+	D3D11_BLEND DestBlend;
+	D3D11_BLEND_OP BlendOp;
+	D3D11_BLEND SrcBlendAlpha;
+	D3D11_BLEND DestBlendAlpha;
+	D3D11_BLEND_OP BlendOpAlpha;
+	UINT8 RenderTargetWriteMask;
+};
+
+struct D3D11_BLEND_DESC
+{
+	BOOL AlphaToCoverageEnable;
+	BOOL IndependentBlendEnable;
+	D3D11_RENDER_TARGET_BLEND_DESC RenderTarget[8];
+};
+
+struct D3D11_INPUT_ELEMENT_DESC
+{
+	LPCSTR SemanticName;
+	UINT SemanticIndex;
+	DXGI_FORMAT Format;
+	UINT InputSlot;
+	UINT AlignedByteOffset;
+	D3D11_INPUT_CLASSIFICATION InputSlotClass;
+	UINT InstanceDataStepRate;
+};
+
+struct D3D11_SO_DECLARATION_ENTRY
+{
+	UINT Stream;
+	LPCSTR SemanticName;
+	UINT SemanticIndex;
+	BYTE StartComponent;
+	BYTE ComponentCount;
+	BYTE OutputSlot;
+};
+
+struct D3D11_QUERY_DESC
+{
+	D3D11_QUERY Query;
+	UINT MiscFlags;
+};
+
+struct D3D11_QUERY_DATA_TIMESTAMP_DISJOINT
+{
+	UINT64 Frequency;
+	BOOL Disjoint;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ INTERFACES ----------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+struct ID3D11Device;
+struct ID3D11ClassLinkage;
+struct ID3D11ClassInstance;
+
+struct ID3D11DeviceChild : public IUnknown
+{
+	virtual void STDMETHODCALLTYPE GetDevice(ID3D11Device** device) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* dataSize, void* data) = 0;
+	virtual HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT dataSize, const void* data) = 0;
+	virtual HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* data) = 0;
+};
+
+// Resources
+struct ID3D11Resource : public ID3D11DeviceChild
+{
+	virtual void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* dimension) = 0;
+	virtual void STDMETHODCALLTYPE SetEvictionPriority(UINT priority) = 0;
+	virtual UINT STDMETHODCALLTYPE GetEvictionPriority() = 0;
+};
+
+struct ID3D11Buffer : public ID3D11Resource
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_BUFFER_DESC* desc) = 0;
+};
+
+struct ID3D11Texture2D : public ID3D11Resource
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_TEXTURE2D_DESC* desc) = 0;
+};
+
+struct ID3D11Texture3D : public ID3D11Resource
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_TEXTURE3D_DESC* desc) = 0;
+};
+
+// Views
+struct ID3D11View : public ID3D11DeviceChild
+{
+	virtual void STDMETHODCALLTYPE GetResource(ID3D11Resource** resource) = 0;
+};
+
+struct ID3D11ShaderResourceView : public ID3D11View
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_SHADER_RESOURCE_VIEW_DESC* desc) = 0;
+};
+
+struct ID3D11RenderTargetView : public ID3D11View
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_RENDER_TARGET_VIEW_DESC* desc) = 0;
+};
+
+struct ID3D11DepthStencilView : public ID3D11View
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_DEPTH_STENCIL_VIEW_DESC* desc) = 0;
+};
+
+// Never created off Windows, so only ever passed around
+struct ID3D11UnorderedAccessView : public ID3D11View
+{
+};
+
+// States
+struct ID3D11SamplerState : public ID3D11DeviceChild
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_SAMPLER_DESC* desc) = 0;
+};
+
+struct ID3D11RasterizerState : public ID3D11DeviceChild
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_RASTERIZER_DESC* desc) = 0;
+};
+
+struct ID3D11DepthStencilState : public ID3D11DeviceChild
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_DEPTH_STENCIL_DESC* desc) = 0;
+};
+
+struct ID3D11BlendState : public ID3D11DeviceChild
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_BLEND_DESC* desc) = 0;
+};
+
+// Shaders and input layouts have nothing past DeviceChild
+struct ID3D11InputLayout : public ID3D11DeviceChild {};
+struct ID3D11VertexShader : public ID3D11DeviceChild {};
+struct ID3D11PixelShader : public ID3D11DeviceChild {};
+struct ID3D11DomainShader : public ID3D11DeviceChild {};
+struct ID3D11HullShader : public ID3D11DeviceChild {};
+struct ID3D11GeometryShader : public ID3D11DeviceChild {};
+struct ID3D11ComputeShader : public ID3D11DeviceChild {};
+
+// Queries
+struct ID3D11Asynchronous : public ID3D11DeviceChild
+{
+	virtual UINT STDMETHODCALLTYPE GetDataSize() = 0;
+};
+
+struct ID3D11Query : public ID3D11Asynchronous
+{
+	virtual void STDMETHODCALLTYPE GetDesc(D3D11_QUERY_DESC* desc) = 0;
+};
+
+// Only the calls the engine makes on a real device and context
+struct ID3D11Device : public IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE CreateQuery(const D3D11_QUERY_DESC* desc, ID3D11Query** query) = 0;
+};
+
+struct ID3D11DeviceContext : public ID3D11DeviceChild
+{
+	virtual HRESULT STDMETHODCALLTYPE GetData(ID3D11Asynchronous* async, void* data, UINT dataSize, UINT flags) = 0;
+	virtual void STDMETHODCALLTYPE Begin(ID3D11Asynchronous* async) = 0;
+	virtual void STDMETHODCALLTYPE End(ID3D11Asynchronous* async) = 0;
+	virtual void STDMETHODCALLTYPE Flush() = 0;
+};
+
+SHIM_UUID(ID3D11DeviceChild, 0x100)
+SHIM_UUID(ID3D11Resource, 0x101)
+SHIM_UUID(ID3D11Buffer, 0x102)
+SHIM_UUID(ID3D11Texture2D, 0x103)
+SHIM_UUID(ID3D11Texture3D, 0x104)
+SHIM_UUID(ID3D11View, 0x110)
+SHIM_UUID(ID3D11ShaderResourceView, 0x111)
+SHIM_UUID(ID3D11RenderTargetView, 0x112)
+SHIM_UUID(ID3D11DepthStencilView, 0x113)
+SHIM_UUID(ID3D11UnorderedAccessView, 0x114)
+SHIM_UUID(ID3D11SamplerState, 0x120)
+SHIM_UUID(ID3D11RasterizerState, 0x121)
+SHIM_UUID(ID3D11DepthStencilState, 0x122)
+SHIM_UUID(ID3D11BlendState, 0x123)
+SHIM_UUID(ID3D11InputLayout, 0x130)
+SHIM_UUID(ID3D11VertexShader, 0x131)
+SHIM_UUID(ID3D11PixelShader, 0x132)
+SHIM_UUID(ID3D11DomainShader, 0x133)
+SHIM_UUID(ID3D11HullShader, 0x134)
+SHIM_UUID(ID3D11GeometryShader, 0x135)
+SHIM_UUID(ID3D11ComputeShader, 0x136)
+SHIM_UUID(ID3D11Asynchronous, 0x140)
+SHIM_UUID(ID3D11Query, 0x141)
+SHIM_UUID(ID3D11Device, 0x150)
+SHIM_UUID(ID3D11DeviceContext, 0x151)
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <d3d11.h>
+
+// --------------------------------------------------------
+// The shader reflection interfaces from <d3d11shader.h>.
+// Nothing implements them off Windows (D3DReflect() always
+// fails there), but code that reflects shaders still has
+// to build.
+// --------------------------------------------------------
+
+struct D3D11_SHADER_DESC
+{
+	UINT Version;
+	LPCSTR Creator;
+	UINT Flags;
+	UINT ConstantBuffers;
+	UINT BoundResources;
+	UINT InputParameters;
+	UINT OutputParameters;
+	UINT InstructionCount;
+	UINT TempRegisterCount;
+	UINT TempArrayCount;
+	UINT DefCount;
+	UINT DclCount;
+	UINT TextureNormalInstructions;
+	UINT TextureLoadInstructions;
+	UINT TextureCompInstructions;
+	UINT TextureBiasInstructions;
+	UINT TextureGradientInstructions;
+	UINT FloatInstructionCount;
+	UINT IntInstructionCount;
+	UINT UintInstructionCount;
+	UINT StaticFlowControlCount;
+	UINT DynamicFlowControlCount;
+	UINT MacroInstructionCount;
+	UINT ArrayInstructionCount;
+	UINT CutInstructionCount;
+	UINT EmitInstructionCount;
+	D3D_PRIMITIVE_TOPOLOGY GSOutputTopology;
+	UINT GSMaxOutputVertexCount;
+	UINT InputPrimitive;
+	UINT PatchConstantParameters;
+	UINT cGSInstanceCount;
+	UINT cControlPoints;
+	UINT HSOutputPrimitive;
+	UINT HSPartitioning;
+	UINT TessellatorDomain;
+	UINT cBarrierInstructions;
+	UINT cInterlockedInstructions;
+	UINT cTextureStoreInstructions;
+};
+
+struct D3D11_SHADER_BUFFER_DESC
+{
+	LPCSTR Name;
+	D3D_CBUFFER_TYPE Type;
+	UINT Variables;
+	UINT Size;
+	UINT uFlags;
+};
+
+struct D3D11_SHADER_VARIABLE_DESC
+{
+	LPCSTR Name;
+	UINT StartOffset;
+	UINT Size;
+	UINT uFlags;
+	void* DefaultValue;
+	UINT StartTexture;
+	UINT TextureSize;
+	UINT StartSampler;
+	UINT SamplerSize;
+};
+
+struct D3D11_SHADER_TYPE_DESC
+{
+	D3D_SHADER_VARIABLE_CLASS Class;
+	D3D_SHADER_VARIABLE_TYPE Type;
+	UINT Rows;
+	UINT Columns;
+	UINT Elements;
+	UINT Members;
+	UINT Offset;
+	LPCSTR Name;
+};
+
+struct D3D11_SHADER_INPUT_BIND_DESC
+{
+	LPCSTR Name;
+	D3D_SHADER_INPUT_TYPE Type;
+	UINT BindPoint;
+	UINT BindCount;
+	UINT uFlags;
+	D3D_RESOURCE_RETURN_TYPE ReturnType;
+	D3D_SRV_DIMENSION Dimension;
+	UINT NumSamples;
+};
+
+struct D3D11_SIGNATURE_PARAMETER_DESC
+{
+	LPCSTR SemanticName;
+	UINT SemanticIndex;
+	UINT Register;
+	D3D_NAME SystemValueType;
+	D3D_REGISTER_COMPONENT_TYPE ComponentType;
+	BYTE Mask;
+	BYTE ReadWriteMask;
+	UINT Stream;
+	D3D_MIN_PRECISION MinPrecision;
+};
+
+// Not COM objects: they belong to the reflection interface
+struct ID3D11ShaderReflectionType
+{
+	virtual HRESULT STDMETHODCALLTYPE GetDesc(D3D11_SHADER_TYPE_DESC* desc) = 0;
+	virtual ID3D11ShaderReflectionType* STDMETHODCALLTYPE GetMemberTypeByIndex(UINT index) = 0;
+	virtual ID3D11ShaderReflectionType* STDMETHODCALLTYPE GetMemberTypeByName(LPCSTR name) = 0;
+	virtual LPCSTR STDMETHODCALLTYPE GetMemberTypeName(UINT index) = 0;
+};
+
+struct ID3D11ShaderReflectionVariable
+{
+	virtual HRESULT STDMETHODCALLTYPE GetDesc(D3D11_SHADER_VARIABLE_DESC* desc) = 0;
+	virtual ID3D11ShaderReflectionType* STDMETHODCALLTYPE GetType() = 0;
+};
+
+struct ID3D11ShaderReflectionConstantBuffer
+{
+	virtual HRESULT STDMETHODCALLTYPE GetDesc(D3D11_SHADER_BUFFER_DESC* desc) = 0;
+	virtual ID3D11ShaderReflectionVariable* STDMETHODCALLTYPE GetVariableByIndex(UINT index) = 0;
+	virtual ID3D11ShaderReflectionVariable* STDMETHODCALLTYPE GetVariableByName(LPCSTR name) = 0;
+};
+
+struct ID3D11ShaderReflection : public IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE GetDesc(D3D11_SHADER_DESC* desc) = 0;
+	virtual ID3D11ShaderReflectionConstantBuffer* STDMETHODCALLTYPE GetConstantBufferByIndex(UINT index) = 0;
+	virtual ID3D11ShaderReflectionConstantBuffer* STDMETHODCALLTYPE GetConstantBufferByName(LPCSTR name) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetResourceBindingDesc(UINT resourceIndex, D3D11_SHADER_INPUT_BIND_DESC* desc) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetInputParameterDesc(UINT parameterIndex, D3D11_SIGNATURE_PARAMETER_DESC* desc) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetOutputParameterDesc(UINT parameterIndex, D3D11_SIGNATURE_PARAMETER_DESC* desc) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetPatchConstantParameterDesc(UINT parameterIndex, D3D11_SIGNATURE_PARAMETER_DESC* desc) = 0;
+	virtual ID3D11ShaderReflectionVariable* STDMETHODCALLTYPE GetVariableByName(LPCSTR name) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetResourceBindingDescByName(LPCSTR name, D3D11_SHADER_INPUT_BIND_DESC* desc) = 0;
+	virtual UINT STDMETHODCALLTYPE GetMovInstructionCount() = 0;
+	virtual UINT STDMETHODCALLTYPE GetMovcInstructionCount() = 0;
+	virtual UINT STDMETHODCALLTYPE GetConversionInstructionCount() = 0;
+	virtual UINT STDMETHODCALLTYPE GetBitwiseInstructionCount() = 0;
+	virtual D3D_PRIMITIVE STDMETHODCALLTYPE GetGSInputPrimitive() = 0;
+	virtual BOOL STDMETHODCALLTYPE IsSampleFrequencyShader() = 0;
+	virtual UINT STDMETHODCALLTYPE GetNumInterfaceSlots() = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetMinFeatureLevel(UINT* level) = 0;
+	virtual UINT STDMETHODCALLTYPE GetThreadGroupSize(UINT* sizeX, UINT* sizeY, UINT* sizeZ) = 0;
+	virtual UINT64 STDMETHODCALLTYPE GetRequiresFlags() = 0;
+};
+SHIM_UUID(ID3D11ShaderReflection, 0x160)
+
+#define IID_ID3D11ShaderReflection __uuidof(ID3D11ShaderReflection)
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <Windows.h>
+
+// --------------------------------------------------------
+// The shared D3D enums the engine refers to, with the same
+// values as the real <d3dcommon.h> so files written on one
+// platform read back on the other
+// --------------------------------------------------------
+
+enum D3D_PRIMITIVE_TOPOLOGY
+{
+	D3D_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+	D3D_PRIMITIVE_TOPOLOGY_POINTLIST = 1,
+	D3D_PRIMITIVE_TOPOLOGY_LINELIST = 2,
+	D3D_PRIMITIVE_TOPOLOGY_LINESTRIP = 3,
+	D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+	D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5,
+};
+
+enum D3D_PRIMITIVE
+{
+	D3D_PRIMITIVE_UNDEFINED = 0,
+	D3D_PRIMITIVE_POINT = 1,
+	D3D_PRIMITIVE_LINE = 2,
+	D3D_PRIMITIVE_TRIANGLE = 3,
+};
+
+enum D3D_SRV_DIMENSION
+{
+	D3D_SRV_DIMENSION_UNKNOWN = 0,
+	D3D_SRV_DIMENSION_BUFFER = 1,
+	D3D_SRV_DIMENSION_TEXTURE1D = 2,
+	D3D_SRV_DIMENSION_TEXTURE1DARRAY = 3,
+	D3D_SRV_DIMENSION_TEXTURE2D = 4,
+	D3D_SRV_DIMENSION_TEXTURE2DARRAY = 5,
+	D3D_SRV_DIMENSION_TEXTURE2DMS = 6,
+	D3D_SRV_DIMENSION_TEXTURE2DMSARRAY = 7,
+	D3D_SRV_DIMENSION_TEXTURE3D = 8,
+	D3D_SRV_DIMENSION_TEXTURECUBE = 9,
+	D3D_SRV_DIMENSION_TEXTURECUBEARRAY = 10,
+	D3D_SRV_DIMENSION_BUFFEREX = 11,
+};
+
+enum D3D_SHADER_VARIABLE_CLASS
+{
+	D3D_SVC_SCALAR = 0,
+	D3D_SVC_VECTOR = 1,
+	D3D_SVC_MATRIX_ROWS = 2,
+	D3D_SVC_MATRIX_COLUMNS = 3,
+	D3D_SVC_OBJECT = 4,
+	D3D_SVC_STRUCT = 5,
+	D3D_SVC_INTERFACE_CLASS = 6,
+	D3D_SVC_INTERFACE_POINTER = 7,
+};
+
+enum D3D_SHADER_VARIABLE_TYPE
+{
+	D3D_SVT_VOID = 0,
+	D3D_SVT_BOOL = 1,
+	D3D_SVT_INT = 2,
+	D3D_SVT_FLOAT = 3,
+	D3D_SVT_STRING = 4,
+	D3D_SVT_TEXTURE = 5,
+	D3D_SVT_TEXTURE1D = 6,
+	D3D_SVT_TEXTURE2D = 7,
+	D3D_SVT_TEXTURE3D = 8,
+	D3D_SVT_TEXTURECUBE = 9,
+	D3D_SVT_SAMPLER = 10,
+	D3D_SVT_UINT = 19,
+	D3D_SVT_UINT8 = 20,
+	D3D_SVT_DOUBLE = 39,
+};
+
+enum D3D_CBUFFER_TYPE
+{
+	D3D_CT_CBUFFER = 0,
+	D3D_CT_TBUFFER = 1,
+	D3D_CT_INTERFACE_POINTERS = 2,
+	D3D_CT_RESOURCE_BIND_INFO = 3,
+	D3D11_CT_CBUFFER = D3D_CT_CBUFFER,
+	D3D11_CT_TBUFFER = D3D_CT_TBUFFER,
+	D3D11_CT_INTERFACE_POINTERS = D3D_CT_INTERFACE_POINTERS,
+	D3D11_CT_RESOURCE_BIND_INFO = D3D_CT_RESOURCE_BIND_INFO,
+};
+
+enum D3D_SHADER_INPUT_TYPE
+{
+	D3D_SIT_CBUFFER = 0,
+	D3D_SIT_TBUFFER = 1,
+	D3D_SIT_TEXTURE = 2,
+	D3D_SIT_SAMPLER = 3,
+	D3D_SIT_UAV_RWTYPED = 4,
+	D3D_SIT_STRUCTURED = 5,
+	D3D_SIT_UAV_RWSTRUCTURED = 6,
+	D3D_SIT_BYTEADDRESS = 7,
+	D3D_SIT_UAV_RWBYTEADDRESS = 8,
+	D3D_SIT_UAV_APPEND_STRUCTURED = 9,
+	D3D_SIT_UAV_CONSUME_STRUCTURED = 10,
+	D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER = 11,
+};
+
+enum D3D_REGISTER_COMPONENT_TYPE
+{
+	D3D_REGISTER_COMPONENT_UNKNOWN = 0,
+	D3D_REGISTER_COMPONENT_UINT32 = 1,
+	D3D_REGISTER_COMPONENT_SINT32 = 2,
+	D3D_REGISTER_COMPONENT_FLOAT32 = 3,
+};
+
+enum D3D_NAME
+{
+	D3D_NAME_UNDEFINED = 0,
+	D3D_NAME_POSITION = 1,
+	D3D_NAME_TARGET = 64,
+	D3D_NAME_DEPTH = 65,
+};
+
+enum D3D_MIN_PRECISION
+{
+	D3D_MIN_PRECISION_DEFAULT = 0,
+};
+
+enum D3D_RESOURCE_RETURN_TYPE
+{
+	D3D_RETURN_TYPE_UNORM = 1,
+	D3D_RETURN_TYPE_SNORM = 2,
+	D3D_RETURN_TYPE_SINT = 3,
+	D3D_RETURN_TYPE_UINT = 4,
+	D3D_RETURN_TYPE_FLOAT = 5,
+};
+
+// --------------------------------------------------------
+// Bytes handed out by the compiler and its file helpers
+// --------------------------------------------------------
+struct ID3D10Blob : public IUnknown
+{
+	virtual void* STDMETHODCALLTYPE GetBufferPointer() = 0;
+	virtual SIZE_T STDMETHODCALLTYPE GetBufferSize() = 0;
+};
+SHIM_UUID(ID3D10Blob, 0x20)
+
+typedef ID3D10Blob ID3DBlob;
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <d3dcommon.h>
+#include <d3d11shader.h>
+
+// --------------------------------------------------------
+// The compiler entry points the engine calls.  There's no
+// compiler off Windows, so they all fail the way a missing
+// file or bad bytecode would; the tests hand-build what
+// they need instead.
+// --------------------------------------------------------
+
+#define D3DCOMPILE_DEBUG					(1 << 0)
+#define D3DCOMPILE_SKIP_OPTIMIZATION		(1 << 2)
+#define D3DCOMPILE_ENABLE_STRICTNESS		(1 << 11)
+#define D3DCOMPILE_OPTIMIZATION_LEVEL3		(1 << 15)
+
+struct D3D_SHADER_MACRO
+{
+	LPCSTR Name;
+	LPCSTR Definition;
+};
+
+struct ID3DInclude;
+#define D3D_COMPILE_STANDARD_FILE_INCLUDE ((ID3DInclude*)(size_t)1)
+
+inline HRESULT D3DReadFileToBlob(LPCWSTR fileName, ID3DBlob** contents)
+{
+	if (contents)
+		*contents = 0;
+	return E_FAIL;
+}
+
+inline HRESULT D3DReflect(const void* data, SIZE_T size, REFIID iid, void** reflector)
+{
+	if (reflector)
+		*reflector = 0;
+	return E_NOTIMPL;
+}
+
+inline HRESULT D3DCompileFromFile(LPCWSTR fileName, const D3D_SHADER_MACRO* defines, ID3DInclude* include, LPCSTR entryPoint,
+	LPCSTR target, UINT flags1, UINT flags2, ID3DBlob** code, ID3DBlob** errors)
+{
+	if (code)
+		*code = 0;
+	if (errors)
+		*errors = 0;
+	return E_NOTIMPL;
+}
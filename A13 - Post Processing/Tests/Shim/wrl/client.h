@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Windows.h>
+
+// --------------------------------------------------------
+// Microsoft::WRL::ComPtr, as far as the engine uses it: a
+// smart pointer that AddRef()s what it holds and Release()s
+// it when done.
+// --------------------------------------------------------
+namespace Microsoft
+{
+	namespace WRL
+	{
+		template<typename T>
+		class ComPtr
+		{
+		public:
+			typedef T InterfaceType;
+
+			ComPtr() : ptr(0) {}
+			ComPtr(decltype(nullptr)) : ptr(0) {}
+			template<typename U>
+			ComPtr(U* other) : ptr(other) { InternalAddRef(); }
+			ComPtr(const ComPtr& other) : ptr(other.ptr) { InternalAddRef(); }
+			ComPtr(ComPtr&& other) : ptr(other.ptr) { other.ptr = 0; }
+
+			template<typename U>
+			ComPtr(const ComPtr<U>& other) : ptr(other.Get()) { InternalAddRef(); }
+
+			~ComPtr() { InternalRelease(); }
+
+			ComPtr& operator=(decltype(nullptr)) { InternalRelease(); return *this; }
+			template<typename U>
+			ComPtr& operator=(U* other) { ComPtr(other).Swap(*this); return *this; }
+			ComPtr& operator=(const ComPtr& other) { ComPtr(other).Swap(*this); return *this; }
+			ComPtr& operator=(ComPtr&& other) { ComPtr(static_cast<ComPtr&&>(other)).Swap(*this); return *this; }
+
+			template<typename U>
+			ComPtr& operator=(const ComPtr<U>& other) { ComPtr(other).Swap(*this); return *this; }
+
+			void Swap(ComPtr& other) { T* temp = ptr; ptr = other.ptr; other.ptr = temp; }
+
+			T* Get() const { return ptr; }
+			T* operator->() const { return ptr; }
+			explicit operator bool() const { return ptr != 0; }
+
+			T* const* GetAddressOf() const { return &ptr; }
+			T** GetAddressOf() { return &ptr; }
+			T** ReleaseAndGetAddressOf() { InternalRelease(); return &ptr; }
+			T** operator&() { return ReleaseAndGetAddressOf(); }
+
+			void Attach(T* other) { InternalRelease(); ptr = other; }
+			T* Detach() { T* detached = ptr; ptr = 0; return detached; }
+			unsigned long Reset() { return InternalRelease(); }
+
+			HRESULT CopyTo(T** other) const { InternalAddRef(); *other = ptr; return S_OK; }
+
+			template<typename U>
+			HRESULT As(ComPtr<U>* other) const { return ptr->QueryInterface(__uuidof(U), reinterpret_cast<void**>(other->ReleaseAndGetAddressOf())); }
+
+		private:
+			T* ptr;
+
+			void InternalAddRef() const
+			{
+				if (ptr)
+					ptr->AddRef();
+			}
+
+			unsigned long InternalRelease()
+			{
+				unsigned long count = 0;
+				T* temp = ptr;
+				if (temp)
+				{
+					ptr = 0;
+					count = temp->Release();
+				}
+				return count;
+			}
+		};
+
+		template<typename T, typename U>
+		bool operator==(const ComPtr<T>& a, const ComPtr<U>& b) { return a.Get() == b.Get(); }
+		template<typename T, typename U>
+		bool operator!=(const ComPtr<T>& a, const ComPtr<U>& b) { return a.Get() != b.Get(); }
+		template<typename T>
+		bool operator==(const ComPtr<T>& a, decltype(nullptr)) { return a.Get() == 0; }
+		template<typename T>
+		bool operator!=(const ComPtr<T>& a, decltype(nullptr)) { return a.Get() != 0; }
+	}
+}
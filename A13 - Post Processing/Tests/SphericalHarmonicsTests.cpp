@@ -0,0 +1,273 @@
+#include <filesystem>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "../SphericalHarmonics.h"
+#include "EngineTests.h"
+
+namespace
+{
+	// Same numbers every run
+	class TestRandom
+	{
+	public:
+		TestRandom(unsigned int seed) : state(seed) {}
+		float Next() { state = state * 1664525u + 1013904223u; return (state >> 8) / 16777216.0f; }
+		float Range(float low, float high) { return low + (high - low) * Next(); }
+
+	private:
+		unsigned int state;
+	};
+
+	// --------------------------------------------------------
+	// Six faces of 8-bit pixels, with rows padded past the
+	// width and every other face stored as BGRA
+	// --------------------------------------------------------
+	class TestCubemap
+	{
+	public:
+		TestCubemap(unsigned int size) : pixels(6)
+		{
+			for (unsigned int f = 0; f < 6; f++)
+			{
+				faces[f].Width = size;
+				faces[f].Height = size;
+				faces[f].RowPitch = size * 4 + 12;
+				faces[f].BGRA = f % 2 == 1;
+				pixels[f].assign((size_t)faces[f].RowPitch * size, 0);
+				faces[f].Pixels = pixels[f].data();
+			}
+		}
+
+		void Set(unsigned int face, unsigned int x, unsigned int y, const unsigned char rgb[3])
+		{
+			unsigned char* texel = pixels[face].data() + (size_t)y * faces[face].RowPitch + (size_t)x * 4;
+			texel[faces[face].BGRA ? 2 : 0] = rgb[0];
+			texel[1] = rgb[1];
+			texel[faces[face].BGRA ? 0 : 2] = rgb[2];
+			texel[3] = 255;
+		}
+
+		// The linear color of a texel, undoing the 2.2 gamma
+		void Linear(unsigned int face, unsigned int x, unsigned int y, double rgb[3]) const
+		{
+			const unsigned char* texel = pixels[face].data() + (size_t)y * faces[face].RowPitch + (size_t)x * 4;
+			rgb[0] = pow(texel[faces[face].BGRA ? 2 : 0] / 255.0, 2.2);
+			rgb[1] = pow(texel[1] / 255.0, 2.2);
+			rgb[2] = pow(texel[faces[face].BGRA ? 0 : 2] / 255.0, 2.2);
+		}
+
+		unsigned int Size() const { return faces[0].Width; }
+		CubemapFace* Faces() { return faces; }
+
+	private:
+		CubemapFace faces[6];
+		std::vector<std::vector<unsigned char>> pixels;
+	};
+
+	// A sky: blue above, brown below, a sun off to one side
+	// and some noise so every band has something in it
+	void PaintSky(TestCubemap& cubemap, TestRandom& random)
+	{
+		const float sun[3] = { 0.48f, 0.6f, -0.64f };
+		unsigned int size = cubemap.Size();
+		for (unsigned int f = 0; f < 6; f++)
+		{
+			for (unsigned int y = 0; y < size; y++)
+			{
+				for (unsigned int x = 0; x < size; x++)
+				{
+					float dir[3];
+					CubemapDirection(f, (x + 0.5f) * 2.0f / size - 1.0f, (y + 0.5f) * 2.0f / size - 1.0f, dir);
+					float up = dir[1] * 0.5f + 0.5f;
+					float sunAmount = dir[0] * sun[0] + dir[1] * sun[1] + dir[2] * sun[2] > 0.97f ? 1.0f : 0.0f;
+					float color[3] =
+					{
+						90 + 60 * up + 100 * sunAmount + random.Range(-20, 20),
+						70 + 110 * up + 90 * sunAmount + random.Range(-20, 20),
+						50 + 200 * up * up + 40 * sunAmount + random.Range(-20, 20),
+					};
+
+					unsigned char rgb[3];
+					for (int ch = 0; ch < 3; ch++)
+						rgb[ch] = (unsigned char)(color[ch] < 0 ? 0 : color[ch] > 255 ? 255 : color[ch]);
+					cubemap.Set(f, x, y, rgb);
+				}
+			}
+		}
+	}
+
+	// The solid angle from the cube's center to the part of
+	// a face from (0, 0) to (x, y)
+	double CornerSolidAngle(double x, double y)
+	{
+		return atan2(x * y, sqrt(x * x + y * y + 1.0));
+	}
+
+	// --------------------------------------------------------
+	// The projection the slow way: every texel cut into
+	// pieces, each weighted by its exact solid angle rather
+	// than an estimate that's scaled to cover the sphere
+	// --------------------------------------------------------
+	SHL2 BruteForceSH(const TestCubemap& cubemap, unsigned int pieces)
+	{
+		double sums[9][3] = {};
+		unsigned int size = cubemap.Size();
+		double step = 2.0 / (size * pieces);
+		for (unsigned int f = 0; f < 6; f++)
+		{
+			for (unsigned int y = 0; y < size * pieces; y++)
+			{
+				for (unsigned int x = 0; x < size * pieces; x++)
+				{
+					double u0 = x * step - 1.0, u1 = u0 + step;
+					double v0 = y * step - 1.0, v1 = v0 + step;
+					double solidAngle = CornerSolidAngle(u1, v1) - CornerSolidAngle(u0, v1) -
+						CornerSolidAngle(u1, v0) + CornerSolidAngle(u0, v0);
+
+					float dir[3];
+					float basis[9];
+					CubemapDirection(f, (float)(u0 + u1) * 0.5f, (float)(v0 + v1) * 0.5f, dir);
+					EvaluateSHBasis(dir[0], dir[1], dir[2], basis);
+
+					double rgb[3];
+					cubemap.Linear(f, x / pieces, y / pieces, rgb);
+					for (int c = 0; c < 9; c++)
+						for (int ch = 0; ch < 3; ch++)
+							sums[c][ch] += basis[c] * rgb[ch] * solidAngle;
+				}
+			}
+		}
+
+		SHL2 sh;
+		for (int c = 0; c < 9; c++)
+			for (int ch = 0; ch < 3; ch++)
+				sh.Coefficients[c][ch] = (float)sums[c][ch];
+		return sh;
+	}
+
+	// Largest difference relative to the largest coefficient
+	float Difference(const SHL2& a, const SHL2& b)
+	{
+		float most = 0, largest = 0;
+		for (int c = 0; c < 9; c++)
+		{
+			for (int ch = 0; ch < 3; ch++)
+			{
+				float difference = fabsf(a.Coefficients[c][ch] - b.Coefficients[c][ch]);
+				float magnitude = fabsf(b.Coefficients[c][ch]);
+				most = difference > most || difference != difference ? difference : most;
+				largest = magnitude > largest ? magnitude : largest;
+			}
+		}
+		return most / (largest > 0 ? largest : 1);
+	}
+}
+
+// --------------------------------------------------------
+// Checks the spherical harmonics used for diffuse lighting:
+// - Directions must map to a face and back
+// - Projecting a cubemap must agree with integrating the
+//   basis over every texel by its exact solid angle, for
+//   any number of threads, odd widths, padded rows and BGRA
+// - A constant environment must project to the same as
+//   ProjectConstantSH(), and a white one must convolve to 1
+//   in every direction
+// - Saved coefficients must load under the same key only
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunSphericalHarmonicsTests()
+{
+	bool passed = true;
+	TestRandom random(38);
+
+	// Directions
+	bool directionPassed = true;
+	for (int i = 0; i < 1000; i++)
+	{
+		unsigned int face = i % 6;
+		float u = random.Range(-1, 1);
+		float v = random.Range(-1, 1);
+		float dir[3], backU, backV;
+		CubemapDirection(face, u, v, dir);
+		directionPassed &= CubemapFaceUV(dir, backU, backV) == face && fabsf(backU - u) < 1e-4f && fabsf(backV - v) < 1e-4f &&
+			fabsf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2] - 1.0f) < 1e-5f;
+	}
+	passed &= directionPassed;
+	printf("Direction:  faces and uv round trip  %s\n", directionPassed ? "ok" : "FAILED");
+
+	// Against brute force; 30 isn't a multiple of the four
+	// texels done at once
+	TestCubemap sky(30);
+	PaintSky(sky, random);
+	SHL2 reference = BruteForceSH(sky, 4);
+	SHL2 single, threaded;
+	bool projectPassed = ProjectCubemapSH(sky.Faces(), single, 1) && ProjectCubemapSH(sky.Faces(), threaded, 4);
+	float bruteDifference = Difference(single, reference);
+	float threadDifference = Difference(threaded, single);
+	projectPassed &= bruteDifference < 0.002f && threadDifference < 1e-5f;
+	passed &= projectPassed;
+	printf("Project:    differs from brute force by %g, threads by %g  %s\n", bruteDifference, threadDifference, projectPassed ? "ok" : "FAILED");
+
+	// Faces that don't match are refused
+	CubemapFace uneven[6];
+	for (int f = 0; f < 6; f++)
+		uneven[f] = sky.Faces()[f];
+	uneven[3].Height = 29;
+	SHL2 unused;
+	bool rejectPassed = !ProjectCubemapSH(uneven, unused, 1);
+	uneven[3] = sky.Faces()[3];
+	uneven[5].Pixels = 0;
+	rejectPassed &= !ProjectCubemapSH(uneven, unused, 1);
+	passed &= rejectPassed;
+	printf("Reject:     faces of different sizes  %s\n", rejectPassed ? "ok" : "FAILED");
+
+	// Constant environments
+	TestCubemap white(7);
+	TestCubemap gray(7);
+	const unsigned char whiteTexel[3] = { 255, 255, 255 };
+	const unsigned char grayTexel[3] = { 200, 150, 100 };
+	for (unsigned int f = 0; f < 6; f++)
+	{
+		for (unsigned int y = 0; y < 7; y++)
+		{
+			for (unsigned int x = 0; x < 7; x++)
+			{
+				white.Set(f, x, y, whiteTexel);
+				gray.Set(f, x, y, grayTexel);
+			}
+		}
+	}
+	SHL2 whiteSH, graySH;
+	bool constantPassed = ProjectCubemapSH(white.Faces(), whiteSH) && ProjectCubemapSH(gray.Faces(), graySH);
+	double grayLinear[3];
+	gray.Linear(0, 0, 0, grayLinear);
+	constantPassed &= Difference(graySH, ProjectConstantSH((float)grayLinear[0], (float)grayLinear[1], (float)grayLinear[2])) < 1e-4f;
+	SHL2 irradiance = ConvolveIrradianceSH(whiteSH);
+	for (int i = 0; i < 100; i++)
+	{
+		float dir[3], rgb[3];
+		CubemapDirection(i % 6, random.Range(-1, 1), random.Range(-1, 1), dir);
+		EvaluateSH(irradiance, dir[0], dir[1], dir[2], rgb);
+		constantPassed &= fabsf(rgb[0] - 1) < 1e-4f && fabsf(rgb[1] - 1) < 1e-4f && fabsf(rgb[2] - 1) < 1e-4f;
+	}
+	passed &= constantPassed;
+	printf("Constant:   matches ProjectConstantSH, white irradiance is 1  %s\n", constantPassed ? "ok" : "FAILED");
+
+	// The cache
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "sh-test.sh";
+	SHL2 loaded;
+	bool cachePassed = SaveSH(path.wstring(), 1234, single) && LoadSH(path.wstring(), 1234, loaded) &&
+		Difference(loaded, single) == 0 && !LoadSH(path.wstring(), 1235, loaded);
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+	cachePassed &= !LoadSH(path.wstring(), 1234, loaded);
+	std::error_code ignored;
+	std::filesystem::remove(path, ignored);
+	cachePassed &= !LoadSH(path.wstring(), 1234, loaded);
+	passed &= cachePassed;
+	printf("Cache:      loads under the same key only  %s\n", cachePassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All spherical harmonics checks passed" : "Spherical harmonics checks FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+#include <memory>
+#include <stdio.h>
+#include <wrl/client.h>
+
+#include "../NullBackend.h"
+#include "../StateCache.h"
+#include "EngineTests.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Calls the cache actually let through to the null context
+	unsigned long long Reached(const NullGraphicsStats& stats, GraphicsCall call)
+	{
+		return stats.Calls[(size_t)call];
+	}
+}
+
+// --------------------------------------------------------
+// Checks the state cache against the null backend, which
+// counts what gets past it:
+// - Setting the same shader or state twice must only send
+//   it once, and count a hit and a miss
+// - Separate binds to neighbouring slots must go out as one
+//   call, re-sending known slots in between but never
+//   guessing at unknown ones
+// - Hits, misses and forwarded counts must add up
+// - Binding render targets, UAVs or stream output targets
+//   must make it forget every non-null SRV, since D3D may
+//   have unbound them
+// - A view released while bound must not be mistaken for a
+//   new one made at the same address
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunStateCacheTests()
+{
+	bool passed = true;
+	std::shared_ptr<NullGraphicsStats> nullStats = std::make_shared<NullGraphicsStats>();
+	std::shared_ptr<StateCacheStats> stats = std::make_shared<StateCacheStats>();
+	NullGraphicsDevice device(nullStats);
+	StateCacheContext context(std::make_shared<NullGraphicsContext>(nullStats), stats);
+
+	ComPtr<ID3D11PixelShader> shader;
+	device.CreatePixelShader(0, 0, 0, shader.GetAddressOf());
+	D3D11_RASTERIZER_DESC rasterizerDesc = {};
+	ComPtr<ID3D11RasterizerState> rasterizer;
+	device.CreateRasterizerState(&rasterizerDesc, rasterizer.GetAddressOf());
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = 4;
+	textureDesc.Height = 4;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	ComPtr<ID3D11Texture2D> textures[3];
+	ComPtr<ID3D11ShaderResourceView> srvs[3];
+	for (int i = 0; i < 3; i++)
+	{
+		device.CreateTexture2D(&textureDesc, 0, textures[i].GetAddressOf());
+		device.CreateShaderResourceView(textures[i].Get(), 0, srvs[i].GetAddressOf());
+	}
+	ComPtr<ID3D11RenderTargetView> rtv;
+	device.CreateRenderTargetView(textures[2].Get(), 0, rtv.GetAddressOf());
+
+	// Redundant binds
+	nullStats->ResetCalls();
+	stats->Reset();
+	context.PSSetShader(shader.Get(), 0, 0);
+	context.PSSetShader(shader.Get(), 0, 0);
+	context.RSSetState(rasterizer.Get());
+	context.RSSetState(rasterizer.Get());
+	context.RSSetState(rasterizer.Get());
+	bool redundantPassed = Reached(*nullStats, GraphicsCall::PSSetShader) == 1 && Reached(*nullStats, GraphicsCall::RSSetState) == 1 &&
+		stats->Hits[(size_t)GraphicsCall::PSSetShader] == 1 && stats->Misses[(size_t)GraphicsCall::PSSetShader] == 1 &&
+		stats->Hits[(size_t)GraphicsCall::RSSetState] == 2 && stats->Misses[(size_t)GraphicsCall::RSSetState] == 1;
+	passed &= redundantPassed;
+	printf("Redundant:  repeated shader/state binds are dropped  %s\n", redundantPassed ? "ok" : "FAILED");
+
+	// Coalescing
+	nullStats->ResetCalls();
+	stats->Reset();
+	for (UINT slot = 0; slot < 3; slot++)
+		context.PSSetShaderResources(slot, 1, srvs[slot].GetAddressOf());
+	context.Draw(3, 0);
+	bool coalescePassed = Reached(*nullStats, GraphicsCall::PSSetShaderResources) == 1;
+
+	// Slot 1 is known, so 0..2 still goes as one call
+	context.PSSetShaderResources(0, 1, srvs[2].GetAddressOf());
+	context.PSSetShaderResources(2, 1, srvs[0].GetAddressOf());
+	context.Draw(3, 0);
+	coalescePassed &= Reached(*nullStats, GraphicsCall::PSSetShaderResources) == 2;
+
+	// Slot 3 was never bound, so 2 and 4 can't be merged
+	context.PSSetShaderResources(2, 1, srvs[1].GetAddressOf());
+	context.PSSetShaderResources(4, 1, srvs[1].GetAddressOf());
+	context.Draw(3, 0);
+	coalescePassed &= Reached(*nullStats, GraphicsCall::PSSetShaderResources) == 4;
+	passed &= coalescePassed;
+	printf("Coalesce:   neighbouring slots go out as one call  %s\n", coalescePassed ? "ok" : "FAILED");
+
+	// Counters, for everything so far plus one bind of what's
+	// already there
+	context.PSSetShaderResources(4, 1, srvs[1].GetAddressOf());
+	const StateCacheStats& counts = *stats;
+	bool countersPassed = counts.Misses[(size_t)GraphicsCall::PSSetShaderResources] == 7 &&
+		counts.Hits[(size_t)GraphicsCall::PSSetShaderResources] == 1 &&
+		counts.Forwarded[(size_t)GraphicsCall::PSSetShaderResources] == 4 &&
+		counts.TotalHits() == 1 && counts.TotalMisses() == 7 && counts.TotalForwarded() == 4;
+	passed &= countersPassed;
+	printf("Counters:   %llu hits, %llu misses, %llu forwarded  %s\n", counts.TotalHits(), counts.TotalMisses(), counts.TotalForwarded(),
+		countersPassed ? "ok" : "FAILED");
+
+	// Outputs make bound SRVs unknown, but not empty slots
+	D3D11_BUFFER_DESC streamDesc = {};
+	streamDesc.ByteWidth = 64;
+	streamDesc.BindFlags = D3D11_BIND_STREAM_OUTPUT;
+	ComPtr<ID3D11Buffer> stream;
+	device.CreateBuffer(&streamDesc, 0, stream.GetAddressOf());
+	ID3D11ShaderResourceView* none = 0;
+	context.PSSetShaderResources(3, 1, &none);
+	context.Draw(3, 0);
+
+	bool forgetPassed = true;
+	for (int output = 0; output < 3; output++)
+	{
+		switch (output)
+		{
+		case 0: context.OMSetRenderTargets(1, rtv.GetAddressOf(), 0); break;
+		case 1: { ID3D11UnorderedAccessView* uav = 0; context.CSSetUnorderedAccessViews(0, 1, &uav, 0); break; }
+		default: { UINT offset = 0; context.SOSetTargets(1, stream.GetAddressOf(), &offset); break; }
+		}
+
+		nullStats->ResetCalls();
+		stats->Reset();
+		context.PSSetShaderResources(3, 1, &none);
+		context.PSSetShaderResources(4, 1, srvs[1].GetAddressOf());
+		context.Draw(3, 0);
+		forgetPassed &= stats->Hits[(size_t)GraphicsCall::PSSetShaderResources] == 1 &&
+			stats->Misses[(size_t)GraphicsCall::PSSetShaderResources] == 1 &&
+			Reached(*nullStats, GraphicsCall::PSSetShaderResources) == 1;
+	}
+	passed &= forgetPassed;
+	printf("Forget:     render targets, UAVs and stream output drop known SRVs  %s\n", forgetPassed ? "ok" : "FAILED");
+
+	// A view let go of while bound stays alive in the context,
+	// so a new one can't turn up at its address and be taken
+	// for it
+	bool reusePassed = true;
+	for (int i = 0; i < 8; i++)
+	{
+		ComPtr<ID3D11Texture2D> texture;
+		ComPtr<ID3D11ShaderResourceView> srv;
+		device.CreateTexture2D(&textureDesc, 0, texture.GetAddressOf());
+		device.CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf());
+		nullStats->ResetCalls();
+		context.PSSetShaderResources(5, 1, srv.GetAddressOf());
+		context.Draw(3, 0);
+		reusePassed &= Reached(*nullStats, GraphicsCall::PSSetShaderResources) == 1;
+	}
+	reusePassed &= nullStats->TextureBytes >= 4 * 4 * 4;
+	passed &= reusePassed;
+	printf("Reuse:      views released while bound are never mistaken for new ones  %s\n", reusePassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All state cache checks passed" : "State cache checks FAILED");
+	return passed ? 0 : 1;
+}
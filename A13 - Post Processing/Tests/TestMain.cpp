@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "EngineTests.h"
+
+// --------------------------------------------------------
+// Entry point for the standalone test target, which runs
+// the modes named on the command line (or all the checks,
+// leaving out the timing modes) and returns non-zero if
+// any of them failed
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	int failed = 0;
+	bool ranAny = false;
+	for (unsigned int m = 0; m < TestModeCount; m++)
+	{
+		const TestMode& mode = TestModes[m];
+		bool named = argc <= 1 && !mode.Timing;
+		for (int i = 1; i < argc; i++)
+			named |= strcmp(argv[i], mode.Flag) == 0;
+		if (!named)
+			continue;
+
+		printf("== %s\n", mode.Flag);
+		failed |= mode.Run();
+		ranAny = true;
+	}
+
+	if (!ranAny)
+	{
+		printf("Usage: %s [mode...]\nModes:", argc > 0 ? argv[0] : "EngineTests");
+		for (unsigned int m = 0; m < TestModeCount; m++)
+			printf(" %s", TestModes[m].Flag);
+		printf("\n");
+		return 1;
+	}
+	return failed;
+}
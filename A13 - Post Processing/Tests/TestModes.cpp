@@ -0,0 +1,67 @@
+#include <string.h>
+
+#include "EngineTests.h"
+
+// --------------------------------------------------------
+// Every check and benchmark, by the flag that runs it.  The
+// game (see WinMain()) and the standalone test target both
+// look flags up here, so a new one only goes in this table.
+// --------------------------------------------------------
+const TestMode TestModes[] =
+{
+	{ "-null-test", RunNullBackendTests, false },
+	{ "-state-cache-test", RunStateCacheTests, false },
+	{ "-ring-test", RunConstantBufferRingTests, false },
+	{ "-trace-test", RunTraceTests, false },
+	{ "-shader-var-test", RunShaderVarTests, false },
+	{ "-shader-var-bench", RunShaderVarBenchmark, true },
+	{ "-cb-upload-test", RunConstantBufferUploadTests, false },
+	{ "-reflection-cache-test", RunShaderReflectionCacheTests, false },
+	{ "-packing-test", RunHlslPackingTests, false },
+	{ "-permutation-test", RunShaderPermutationTests, false },
+	{ "-cluster-test", RunLightClusterTests, false },
+	{ "-cluster-bench", RunLightClusterBenchmark, true },
+	{ "-pbr-test", RunPbrReferenceTests, false },
+	{ "-pbr-bench", [] { return RunPbrBenchmark(1280, 720, 5); }, true },
+	{ "-sh-test", RunSphericalHarmonicsTests, false },
+	{ "-ibl-test", RunEnvironmentPrefilterTests, false },
+	{ "-ibl-bench", RunIblBenchmark, true },
+	{ "-ao-test", RunOcclusionTests, false },
+	{ "-csm-test", RunShadowCascadeTests, false },
+	{ "-shadow-cache-test", RunShadowCacheTests, false },
+	{ "-atlas-test", RunShadowAtlasTests, false },
+	{ "-blur-test", RunBlurTests, false },
+	{ "-post-test", RunPostChainTests, false },
+	{ "-bloom-test", RunBloomTests, false },
+	{ "-pool-test", RunPoolTests, false },
+	{ "-hdr-test", RunHdrTests, false },
+	{ "-grading-test", RunGradingTests, false },
+	{ "-grading-bench", RunGradingBenchmark, true },
+	{ "-resolution-test", RunResolutionTests, false },
+};
+
+const unsigned int TestModeCount = sizeof(TestModes) / sizeof(TestModes[0]);
+
+// --------------------------------------------------------
+// Finds the first mode whose flag is a whole word of the
+// given command line, so "-sh-test" doesn't match inside a
+// longer flag.  Returns null if there isn't one.
+// --------------------------------------------------------
+const TestMode* FindTestMode(const char* commandLine)
+{
+	if (!commandLine)
+		return 0;
+
+	for (const TestMode& mode : TestModes)
+	{
+		size_t length = strlen(mode.Flag);
+		for (const char* found = strstr(commandLine, mode.Flag); found; found = strstr(found + 1, mode.Flag))
+		{
+			bool starts = found == commandLine || found[-1] == ' ';
+			bool ends = found[length] == 0 || found[length] == ' ';
+			if (starts && ends)
+				return &mode;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,140 @@
+#include <filesystem>
+#include <memory>
+#include <stdio.h>
+#include <wrl/client.h>
+
+#include "../GraphicsTrace.h"
+#include "../NullBackend.h"
+#include "EngineTests.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	D3D11_BUFFER_DESC ConstantBufferDesc(UINT byteWidth)
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = byteWidth;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		return desc;
+	}
+}
+
+// --------------------------------------------------------
+// Checks the trace recorder's bookkeeping over the null
+// backend:
+// - Releasing an object must drop its creation record
+//   (and the copy of its initial data) right away
+// - A new object must never inherit an old object's id or
+//   record, while an object seen twice keeps its id
+// - An object destroyed in the middle of a capture must
+//   still be written to the trace, and its record dropped
+//   once the capture ends
+// - Objects must be able to outlive the recorder
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunTraceTests()
+{
+	bool passed = true;
+	std::shared_ptr<NullGraphicsStats> stats = std::make_shared<NullGraphicsStats>();
+	std::shared_ptr<NullGraphicsDevice> nullDevice = std::make_shared<NullGraphicsDevice>(stats);
+	std::shared_ptr<NullGraphicsContext> nullContext = std::make_shared<NullGraphicsContext>(stats);
+	std::shared_ptr<TraceRecorder> recorder = std::make_shared<TraceRecorder>();
+	std::unique_ptr<TraceRecordingDevice> device = std::make_unique<TraceRecordingDevice>(nullDevice, recorder);
+	std::unique_ptr<TraceRecordingContext> context = std::make_unique<TraceRecordingContext>(nullContext, recorder);
+
+	// Records go with their objects
+	unsigned char initial[1024] = {};
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = initial;
+	D3D11_BUFFER_DESC meshDesc = ConstantBufferDesc(sizeof(initial));
+	meshDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	meshDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	meshDesc.CPUAccessFlags = 0;
+	ComPtr<ID3D11Buffer> mesh;
+	device->CreateBuffer(&meshDesc, &initialData, mesh.GetAddressOf());
+	bool releasePassed = mesh && recorder->GetRecordCount() == 1;
+	mesh.Reset();
+	releasePassed &= recorder->GetRecordCount() == 0;
+	passed &= releasePassed;
+	printf("Release:    a released object's record is dropped  %s\n", releasePassed ? "ok" : "FAILED");
+
+	// Ids are per object, not per address
+	D3D11_BUFFER_DESC bufferDesc = ConstantBufferDesc(256);
+	ComPtr<ID3D11Buffer> first;
+	device->CreateBuffer(&bufferDesc, 0, first.GetAddressOf());
+	unsigned int firstId = recorder->FindId(first.Get());
+	bool idsPassed = firstId != 0 && recorder->FindId(first.Get()) == firstId;
+	first.Reset();
+	for (int i = 0; i < 8 && idsPassed; i++)
+	{
+		// Same size as the buffer, so the allocator is free to
+		// hand the old address back
+		ComPtr<ID3D11Buffer> next;
+		device->CreateBuffer(&bufferDesc, 0, next.GetAddressOf());
+		D3D11_TEXTURE2D_DESC textureDesc = {};
+		textureDesc.Width = 16;
+		textureDesc.Height = 16;
+		textureDesc.MipLevels = 1;
+		textureDesc.ArraySize = 1;
+		textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		ComPtr<ID3D11Texture2D> texture;
+		device->CreateTexture2D(&textureDesc, 0, texture.GetAddressOf());
+		unsigned int nextId = recorder->FindId(next.Get());
+		unsigned int textureId = recorder->FindId(texture.Get());
+		idsPassed &= nextId > firstId && textureId > firstId && nextId != textureId &&
+			recorder->UpdateSize(texture.Get(), 0, 0, 16 * 4, 0) == 16 * 16 * 4 &&
+			recorder->UpdateSize(next.Get(), 0, 0, 0, 0) == 256;
+	}
+	idsPassed &= recorder->GetRecordCount() == 0;
+	passed &= idsPassed;
+	printf("Ids:        new objects get new ids, seen ones keep theirs  %s\n", idsPassed ? "ok" : "FAILED");
+
+	// Destroyed while capturing
+	std::wstring path = (std::filesystem::temp_directory_path() / "trace-test.gtrc").wstring();
+	ComPtr<ID3D11Buffer> kept;
+	ComPtr<ID3D11Buffer> dropped;
+	device->CreateBuffer(&bufferDesc, 0, kept.GetAddressOf());
+	device->CreateBuffer(&bufferDesc, 0, dropped.GetAddressOf());
+	recorder->BeginCapture();
+	ID3D11Buffer* bound[2] = { kept.Get(), dropped.Get() };
+	context->VSSetConstantBuffers(0, 2, bound);
+	context->Draw(3, 0);
+
+	// Unbound behind the recorder's back, so nothing but the
+	// recorder's capture still knows the buffer
+	ID3D11Buffer* unbound[2] = {};
+	nullContext->VSSetConstantBuffers(0, 2, unbound);
+	dropped.Reset();
+	bool capturePassed = recorder->GetRecordCount() == 2;
+	capturePassed &= recorder->EndCapture(path);
+	capturePassed &= recorder->GetLastObjectCount() == 2 && recorder->GetRecordCount() == 1;
+
+	{
+		TraceReplayer replayer(nullDevice, nullContext);
+		capturePassed &= replayer.Load(path) && replayer.GetObjectCount() == 2 && replayer.GetMissingObjectCount() == 0 &&
+			replayer.GetCommandCount() == 2 && replayer.Replay();
+	}
+	std::error_code ignored;
+	std::filesystem::remove(std::filesystem::path(path), ignored);
+	passed &= capturePassed;
+	printf("Capture:    objects destroyed mid-capture are still written  %s\n", capturePassed ? "ok" : "FAILED");
+
+	// The recorder goes first
+	device.reset();
+	context.reset();
+	recorder.reset();
+	nullContext.reset();
+	bool orderPassed = true;
+	kept.Reset();
+	orderPassed &= stats->BufferBytes == 0;
+	passed &= orderPassed;
+	printf("Order:      objects can outlive the recorder  %s\n", orderPassed ? "ok" : "FAILED");
+
+	printf("%s\n", passed ? "All trace checks passed" : "Trace checks FAILED");
+	return passed ? 0 : 1;
+}
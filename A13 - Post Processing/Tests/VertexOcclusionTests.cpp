@@ -0,0 +1,164 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "../Vertex.h"
+#include "../VertexOcclusion.h"
+#include "EngineTests.h"
+
+using DirectX::XMFLOAT2;
+using DirectX::XMFLOAT3;
+
+namespace
+{
+	// The little vector math the helix needs
+	XMFLOAT3 Add(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+	XMFLOAT3 Scale(const XMFLOAT3& v, float s) { return XMFLOAT3(v.x * s, v.y * s, v.z * s); }
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	XMFLOAT3 Normalize(const XMFLOAT3& v)
+	{
+		return Scale(v, 1.0f / sqrtf(v.x * v.x + v.y * v.y + v.z * v.z));
+	}
+}
+
+// --------------------------------------------------------
+// Checks the occlusion bake on two made up meshes, then times
+// it at thread counts doubling up to one per core:
+// - A flat grid, which nothing can occlude, must come out
+//   exactly 1 with bent normals along the normal
+// - A tube wound into a helix must be darker on its inner
+//   side, which faces the rest of the coil, than its outer
+// - Every thread count must give the same bytes
+// Returns 1 if any check fails.
+// --------------------------------------------------------
+int RunOcclusionTests()
+{
+	auto bake = [](const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		std::vector<VertexOcclusion>& occlusion, OcclusionBakeStats* stats, unsigned int threads)
+	{
+		return BakeVertexOcclusion(&vertices[0].Position.x, &vertices[0].Normal.x, sizeof(Vertex),
+			(unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size(),
+			OcclusionBakeSettings(), occlusion, stats, threads);
+	};
+	bool passed = true;
+
+	// A 1x1 grid of 8x8 cells, facing up
+	const unsigned int cells = 8;
+	std::vector<Vertex> quad;
+	std::vector<unsigned int> quadIndices;
+	for (unsigned int y = 0; y <= cells; y++)
+	{
+		for (unsigned int x = 0; x <= cells; x++)
+			quad.push_back({ XMFLOAT3((float)x / cells - 0.5f, 0.0f, (float)y / cells - 0.5f), XMFLOAT2(0, 0), XMFLOAT3(0, 1, 0), XMFLOAT3(1, 0, 0) });
+	}
+	for (unsigned int y = 0; y < cells; y++)
+	{
+		for (unsigned int x = 0; x < cells; x++)
+		{
+			unsigned int corner = y * (cells + 1) + x;
+			for (unsigned int index : { corner, corner + cells + 1, corner + 1, corner + 1, corner + cells + 1, corner + cells + 2 })
+				quadIndices.push_back(index);
+		}
+	}
+
+	std::vector<VertexOcclusion> quadOcclusion;
+	bake(quad, quadIndices, quadOcclusion, 0, 0);
+	float lowestOcclusion = 1.0f;
+	float lowestBentY = 1.0f;
+	for (const VertexOcclusion& vertex : quadOcclusion)
+	{
+		lowestOcclusion = fminf(lowestOcclusion, vertex.Occlusion);
+		lowestBentY = fminf(lowestBentY, vertex.BentNormal[1]);
+	}
+	bool quadPassed = lowestOcclusion == 1.0f && lowestBentY > 0.999f;
+	passed &= quadPassed;
+	printf("Flat quad:  lowest occlusion %.4f, lowest bent normal y %.4f  %s\n",
+		lowestOcclusion, lowestBentY, quadPassed ? "ok" : "FAILED");
+
+	// Three turns of a 0.15 radius tube, 0.5 from the Y axis,
+	// rising 0.5 a turn; each ring's first vertex faces out
+	const float twoPi = 6.2831853f;
+	const unsigned int ringsPerTurn = 64;
+	const unsigned int ringSides = 16;
+	const unsigned int rings = ringsPerTurn * 3 + 1;
+	std::vector<Vertex> helix;
+	std::vector<unsigned int> helixIndices;
+	for (unsigned int ring = 0; ring < rings; ring++)
+	{
+		float angle = twoPi * ring / ringsPerTurn;
+		XMFLOAT3 center(0.5f * cosf(angle), 0.5f * angle / twoPi, 0.5f * sinf(angle));
+		XMFLOAT3 along = Normalize(XMFLOAT3(-0.5f * sinf(angle), 0.5f / twoPi, 0.5f * cosf(angle)));
+		XMFLOAT3 outward(cosf(angle), 0, sinf(angle));
+		XMFLOAT3 side = Normalize(Cross(along, outward));
+		outward = Cross(side, along);
+
+		for (unsigned int i = 0; i < ringSides; i++)
+		{
+			float around = twoPi * i / ringSides;
+			XMFLOAT3 normal = Add(Scale(outward, cosf(around)), Scale(side, sinf(around)));
+			Vertex vertex = {};
+			vertex.Position = Add(center, Scale(normal, 0.15f));
+			vertex.Normal = normal;
+			helix.push_back(vertex);
+		}
+	}
+	for (unsigned int ring = 0; ring + 1 < rings; ring++)
+	{
+		for (unsigned int i = 0; i < ringSides; i++)
+		{
+			unsigned int a = ring * ringSides + i;
+			unsigned int b = ring * ringSides + (i + 1) % ringSides;
+			for (unsigned int index : { a, a + ringSides, b, b, a + ringSides, b + ringSides })
+				helixIndices.push_back(index);
+		}
+	}
+
+	// Inner and outer sides, leaving out half a turn at each end
+	std::vector<VertexOcclusion> helixOcclusion;
+	bake(helix, helixIndices, helixOcclusion, 0, 0);
+	double inner = 0, outer = 0;
+	unsigned int sides = 0;
+	for (unsigned int ring = ringsPerTurn / 2; ring < rings - ringsPerTurn / 2; ring++)
+	{
+		inner += helixOcclusion[ring * ringSides + ringSides / 2].Occlusion;
+		outer += helixOcclusion[ring * ringSides].Occlusion;
+		sides++;
+	}
+	inner /= sides;
+	outer /= sides;
+	bool helixPassed = inner < 0.75 && inner < outer - 0.15;
+	passed &= helixPassed;
+	printf("Helix:      inner side %.3f, outer side %.3f  %s\n", inner, outer, helixPassed ? "ok" : "FAILED");
+
+	// Timing, and the same bytes from every thread count
+	std::vector<unsigned int> threadCounts;
+	unsigned int cores = std::thread::hardware_concurrency();
+	for (unsigned int threads = 1; threads < cores; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(cores > 0 ? cores : 1);
+
+	printf("Helix bake: %u vertices, %u triangles\n", (unsigned int)helix.size(), (unsigned int)helixIndices.size() / 3);
+	for (unsigned int threads : threadCounts)
+	{
+		std::vector<VertexOcclusion> occlusion;
+		OcclusionBakeStats stats;
+		double start = TestMilliseconds();
+		bake(helix, helixIndices, occlusion, &stats, threads);
+		double ms = TestMilliseconds() - start;
+
+		bool same = memcmp(occlusion.data(), helixOcclusion.data(), occlusion.size() * sizeof(VertexOcclusion)) == 0;
+		passed &= same;
+		printf("  %2u thread%s %8.1f ms  %6.2f M rays/s  %s\n", threads, threads == 1 ? " " : "s", ms,
+			stats.Rays / (ms * 1000.0), same ? "same output" : "DIFFERENT OUTPUT");
+	}
+
+	printf("%s\n", passed ? "All occlusion checks passed" : "Occlusion checks FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,368 @@
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+#include <float.h>
+#include <string.h>
+
+namespace
+{
+	const unsigned int MaxLeafTriangles = 4;
+	const unsigned int BinCount = 12;
+	const unsigned int MaxStack = 128;
+
+	// Past this depth nodes are split in half by count, so a
+	// run of lopsided SAH splits can't overflow the stack
+	const unsigned int MaxSahDepth = 48;
+
+	struct Box
+	{
+		float Min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float Max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const float p[3])
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				if (p[i] < Min[i]) Min[i] = p[i];
+				if (p[i] > Max[i]) Max[i] = p[i];
+			}
+		}
+
+		void Grow(const Box& other)
+		{
+			Grow(other.Min);
+			Grow(other.Max);
+		}
+
+		// Half the surface area, which is all SAH compares
+		float Area() const
+		{
+			if (Min[0] > Max[0])
+				return 0.0f;
+			float x = Max[0] - Min[0];
+			float y = Max[1] - Min[1];
+			float z = Max[2] - Min[2];
+			return x * y + y * z + z * x;
+		}
+	};
+
+	struct Bin
+	{
+		Box Bounds;
+		unsigned int Count = 0;
+	};
+
+	unsigned int BinOf(float centroid, float low, float scale)
+	{
+		unsigned int bin = (unsigned int)((centroid - low) * scale);
+		return bin < BinCount ? bin : BinCount - 1;
+	}
+
+	// A node waiting to be split
+	struct Pending
+	{
+		unsigned int Node;
+		unsigned int Level;
+	};
+}
+
+// --------------------------------------------------------
+// Splits nodes until each leaf has a few triangles.  Every
+// axis is tried with triangles binned by centroid, and the
+// plane with the lowest surface area cost wins, unless
+// testing the triangles directly is cheaper than any split.
+// --------------------------------------------------------
+void TriangleBVH::Build(const float* positions, unsigned int stride, const unsigned int* indices, unsigned int indexCount)
+{
+	nodes.clear();
+	triangles.clear();
+	depth = 0;
+
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	auto position = [&](unsigned int index)
+	{
+		return (const float*)((const char*)positions + (size_t)index * stride);
+	};
+
+	std::vector<Box> bounds(triangleCount);
+	std::vector<float> centroids((size_t)triangleCount * 3);
+	std::vector<unsigned int> order(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+			bounds[t].Grow(position(indices[t * 3 + corner]));
+		for (int i = 0; i < 3; i++)
+			centroids[t * 3 + i] = (bounds[t].Min[i] + bounds[t].Max[i]) * 0.5f;
+		order[t] = t;
+	}
+
+	nodes.reserve((size_t)triangleCount * 2);
+	nodes.push_back({ {}, 0, {}, triangleCount });
+
+	std::vector<Pending> pending;
+	pending.push_back({ 0, 1 });
+	while (!pending.empty())
+	{
+		Pending current = pending.back();
+		pending.pop_back();
+		if (current.Level > depth)
+			depth = current.Level;
+
+		Node& node = nodes[current.Node];
+		Box nodeBounds;
+		Box centroidBounds;
+		for (unsigned int i = node.First; i < node.First + node.Count; i++)
+		{
+			nodeBounds.Grow(bounds[order[i]]);
+			centroidBounds.Grow(&centroids[order[i] * 3]);
+		}
+		memcpy(node.Min, nodeBounds.Min, sizeof(node.Min));
+		memcpy(node.Max, nodeBounds.Max, sizeof(node.Max));
+
+		if (node.Count <= MaxLeafTriangles)
+			continue;
+
+		// Find the cheapest plane
+		int bestAxis = -1;
+		unsigned int bestBin = 0;
+		float bestLow = 0.0f;
+		float bestScale = 0.0f;
+		float bestCost = (float)node.Count * nodeBounds.Area();
+		if (current.Level < MaxSahDepth)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float low = centroidBounds.Min[axis];
+				float extent = centroidBounds.Max[axis] - low;
+				if (extent <= 0.0f)
+					continue;
+
+				Bin bins[BinCount];
+				float scale = BinCount / extent;
+				for (unsigned int i = node.First; i < node.First + node.Count; i++)
+				{
+					Bin& bin = bins[BinOf(centroids[order[i] * 3 + axis], low, scale)];
+					bin.Bounds.Grow(bounds[order[i]]);
+					bin.Count++;
+				}
+
+				// Sweep from the right, then from the left, so each
+				// plane's cost is known without re-summing the bins
+				float rightCost[BinCount] = {};
+				Box right;
+				unsigned int rightCount = 0;
+				for (unsigned int b = BinCount - 1; b > 0; b--)
+				{
+					right.Grow(bins[b].Bounds);
+					rightCount += bins[b].Count;
+					rightCost[b] = rightCount * right.Area();
+				}
+
+				Box left;
+				unsigned int leftCount = 0;
+				for (unsigned int b = 0; b < BinCount - 1; b++)
+				{
+					left.Grow(bins[b].Bounds);
+					leftCount += bins[b].Count;
+					float cost = leftCount * left.Area() + rightCost[b + 1];
+					if (leftCount > 0 && leftCount < node.Count && cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = b;
+						bestLow = low;
+						bestScale = scale;
+					}
+				}
+			}
+		}
+
+		unsigned int middle = node.First;
+		if (bestAxis >= 0)
+		{
+			// Triangles in the bins left of the plane to the front
+			// (binned again rather than compared with the plane, so
+			// rounding can't put one on the other side)
+			unsigned int end = node.First + node.Count;
+			for (unsigned int i = node.First; i < end;)
+			{
+				if (BinOf(centroids[order[i] * 3 + bestAxis], bestLow, bestScale) <= bestBin)
+					i++;
+				else
+				{
+					end--;
+					unsigned int swap = order[i];
+					order[i] = order[end];
+					order[end] = swap;
+				}
+			}
+			middle = end;
+		}
+		else if (node.Count > MaxLeafTriangles * 4 || current.Level >= MaxSahDepth)
+		{
+			// Nothing beats a leaf, but this one's too big to test
+			// every triangle in (or the centroids are all in one
+			// place), so split it in half along its longest side
+			int axis = 0;
+			for (int i = 1; i < 3; i++)
+			{
+				if (nodeBounds.Max[i] - nodeBounds.Min[i] > nodeBounds.Max[axis] - nodeBounds.Min[axis])
+					axis = i;
+			}
+			std::vector<unsigned int>::iterator first = order.begin() + node.First;
+			std::nth_element(first, first + node.Count / 2, first + node.Count, [&](unsigned int a, unsigned int b)
+			{
+				return centroids[a * 3 + axis] < centroids[b * 3 + axis];
+			});
+			middle = node.First + node.Count / 2;
+		}
+		else
+			continue;
+
+		// Children go next to each other, so one index finds both
+		unsigned int first = node.First;
+		unsigned int count = node.Count;
+		unsigned int child = (unsigned int)nodes.size();
+		node.First = child;
+		node.Count = 0;
+		nodes.push_back({ {}, first, {}, middle - first });
+		nodes.push_back({ {}, middle, {}, first + count - middle });
+		pending.push_back({ child, current.Level + 1 });
+		pending.push_back({ child + 1, current.Level + 1 });
+	}
+
+	// Store the triangles in leaf order, ready to intersect
+	triangles.resize(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		const unsigned int* corners = &indices[order[t] * 3];
+		const float* v0 = position(corners[0]);
+		const float* v1 = position(corners[1]);
+		const float* v2 = position(corners[2]);
+		for (int i = 0; i < 3; i++)
+		{
+			triangles[t].V0[i] = v0[i];
+			triangles[t].Edge1[i] = v1[i] - v0[i];
+			triangles[t].Edge2[i] = v2[i] - v0[i];
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Slab tests for the boxes, Moller-Trumbore for the
+// triangles.  With one origin for the whole packet, every
+// term that only involves the origin and the triangle (or
+// box) is worked out once and broadcast.
+// --------------------------------------------------------
+int TriangleBVH::Occluded4(const float origin[3], const float dirX[4], const float dirY[4], const float dirZ[4], float maxDistance) const
+{
+	if (nodes.empty())
+		return 0;
+
+	__m128 dir[3] = { _mm_loadu_ps(dirX), _mm_loadu_ps(dirY), _mm_loadu_ps(dirZ) };
+
+	// Zero components would make 0 * infinity in the slabs
+	__m128 inverse[3];
+	for (int i = 0; i < 3; i++)
+	{
+		__m128 zero = _mm_cmpeq_ps(dir[i], _mm_setzero_ps());
+		__m128 safe = _mm_or_ps(_mm_andnot_ps(zero, dir[i]), _mm_and_ps(zero, _mm_set1_ps(1e-30f)));
+		inverse[i] = _mm_div_ps(_mm_set1_ps(1.0f), safe);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 epsilon = _mm_set1_ps(1e-12f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 tMax = _mm_set1_ps(maxDistance);
+
+	int open = 0xF;
+	unsigned int stack[MaxStack];
+	unsigned int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+
+		__m128 tNear = zero;
+		__m128 tFar = tMax;
+		for (int i = 0; i < 3; i++)
+		{
+			__m128 t0 = _mm_mul_ps(_mm_set1_ps(node.Min[i] - origin[i]), inverse[i]);
+			__m128 t1 = _mm_mul_ps(_mm_set1_ps(node.Max[i] - origin[i]), inverse[i]);
+			tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+			tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+		}
+		if ((_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) & open) == 0)
+			continue;
+
+		if (node.Count == 0)
+		{
+			stack[top++] = node.First + 1;
+			stack[top++] = node.First;
+			continue;
+		}
+
+		for (unsigned int t = node.First; t < node.First + node.Count; t++)
+		{
+			const Triangle& tri = triangles[t];
+			float s[3] = { origin[0] - tri.V0[0], origin[1] - tri.V0[1], origin[2] - tri.V0[2] };
+			float q[3] =
+			{
+				s[1] * tri.Edge1[2] - s[2] * tri.Edge1[1],
+				s[2] * tri.Edge1[0] - s[0] * tri.Edge1[2],
+				s[0] * tri.Edge1[1] - s[1] * tri.Edge1[0],
+			};
+
+			// p = dir x edge2
+			__m128 e2[3] = { _mm_set1_ps(tri.Edge2[0]), _mm_set1_ps(tri.Edge2[1]), _mm_set1_ps(tri.Edge2[2]) };
+			__m128 px = _mm_sub_ps(_mm_mul_ps(dir[1], e2[2]), _mm_mul_ps(dir[2], e2[1]));
+			__m128 py = _mm_sub_ps(_mm_mul_ps(dir[2], e2[0]), _mm_mul_ps(dir[0], e2[2]));
+			__m128 pz = _mm_sub_ps(_mm_mul_ps(dir[0], e2[1]), _mm_mul_ps(dir[1], e2[0]));
+
+			__m128 det = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(px, _mm_set1_ps(tri.Edge1[0])),
+				_mm_mul_ps(py, _mm_set1_ps(tri.Edge1[1]))),
+				_mm_mul_ps(pz, _mm_set1_ps(tri.Edge1[2])));
+			__m128 inverseDet = _mm_div_ps(one, det);
+
+			__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(px, _mm_set1_ps(s[0])),
+				_mm_mul_ps(py, _mm_set1_ps(s[1]))),
+				_mm_mul_ps(pz, _mm_set1_ps(s[2]))), inverseDet);
+			__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(dir[0], _mm_set1_ps(q[0])),
+				_mm_mul_ps(dir[1], _mm_set1_ps(q[1]))),
+				_mm_mul_ps(dir[2], _mm_set1_ps(q[2]))), inverseDet);
+			__m128 distance = _mm_set1_ps(
+				tri.Edge2[0] * q[0] + tri.Edge2[1] * q[1] + tri.Edge2[2] * q[2]);
+			distance = _mm_mul_ps(distance, inverseDet);
+
+			__m128 hit = _mm_cmpgt_ps(_mm_and_ps(det, absMask), epsilon);
+			hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+			hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+			hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+			hit = _mm_and_ps(hit, _mm_cmpgt_ps(distance, zero));
+			hit = _mm_and_ps(hit, _mm_cmplt_ps(distance, tMax));
+
+			open &= ~_mm_movemask_ps(hit);
+			if (open == 0)
+				return 0xF;
+		}
+	}
+
+	return 0xF & ~open;
+}
+
+void TriangleBVH::GetBounds(float min[3], float max[3]) const
+{
+	for (int i = 0; i < 3; i++)
+	{
+		min[i] = nodes.empty() ? 0.0f : nodes[0].Min[i];
+		max[i] = nodes.empty() ? 0.0f : nodes[0].Max[i];
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// A bounding volume hierarchy over a mesh's triangles, for
+// tracing rays on the CPU (see VertexOcclusion.h).  Built
+// with binned SAH splits, so nodes hug the geometry and a
+// ray only tests the handful of triangles near its path.
+//
+// Rays go four at a time from one origin, SSE testing all
+// of them against each box and triangle together.  Only
+// "is anything in the way" is answered: traversal stops as
+// soon as every ray in the packet is blocked.
+// --------------------------------------------------------
+class TriangleBVH
+{
+public:
+	// positions: xyz floats, stride bytes apart (so they can
+	// be read straight out of a Vertex array)
+	void Build(
+		const float* positions,
+		unsigned int stride,
+		const unsigned int* indices,
+		unsigned int indexCount);
+
+	// --------------------------------------------------------
+	// Which of four rays from origin hit a triangle (either
+	// side) closer than maxDistance, as a bit per ray.
+	// Directions don't need to be unit length; maxDistance is
+	// measured in multiples of them.
+	// --------------------------------------------------------
+	int Occluded4(
+		const float origin[3],
+		const float dirX[4],
+		const float dirY[4],
+		const float dirZ[4],
+		float maxDistance) const;
+
+	unsigned int GetTriangleCount() const { return (unsigned int)triangles.size(); }
+	unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+	unsigned int GetDepth() const { return depth; }
+
+	// Corners of the whole mesh
+	void GetBounds(float min[3], float max[3]) const;
+
+private:
+	// Leaves hold Count triangles from First; inner nodes
+	// have Count 0 and their children at First and First + 1
+	struct Node
+	{
+		float Min[3];
+		unsigned int First;
+		float Max[3];
+		unsigned int Count;
+	};
+
+	// A corner and the two edges from it, which is what the
+	// intersection test wants
+	struct Triangle
+	{
+		float V0[3];
+		float Edge1[3];
+		float Edge2[3];
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;	// In leaf order
+	unsigned int depth = 0;
+};
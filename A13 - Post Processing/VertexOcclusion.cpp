@@ -0,0 +1,346 @@
+#include "VertexOcclusion.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+#include <thread>
+#include <unordered_map>
+
+#include "TriangleBVH.h"
+
+namespace
+{
+	const float Pi = 3.14159265f;
+	const unsigned int BlockSize = 64;	// Vertices per work item
+	const unsigned int OcclusionFileVersion = 1;
+
+	// A vertex's position and normal, bit for bit
+	struct VertexKey
+	{
+		unsigned int Bits[6];
+
+		bool operator==(const VertexKey& other) const { return memcmp(Bits, other.Bits, sizeof(Bits)) == 0; }
+	};
+
+	// Mixes words into a well spread 32-bit hash
+	unsigned int Hash(const unsigned int* words, unsigned int count, unsigned int seed)
+	{
+		unsigned int hash = seed * 0x9E3779B9u;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			hash ^= words[i] + 0x7FEB352Du + (hash << 6) + (hash >> 2);
+			hash ^= hash >> 16;
+			hash *= 0x85EBCA6Bu;
+			hash ^= hash >> 13;
+			hash *= 0xC2B2AE35u;
+			hash ^= hash >> 16;
+		}
+		return hash;
+	}
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key) const { return Hash(key.Bits, 6, 0); }
+	};
+
+	const float* Attribute(const float* base, unsigned int stride, unsigned int index)
+	{
+		return (const float*)((const char*)base + (size_t)index * stride);
+	}
+
+	// The i-th of n points spread evenly over the unit square
+	void Hammersley(unsigned int i, unsigned int n, float& x, float& y)
+	{
+		unsigned int bits = i;
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+		bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+		bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+		bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+
+		x = (i + 0.5f) / n;
+		y = bits * 2.3283064365386963e-10f;	// / 2^32
+	}
+
+	// --------------------------------------------------------
+	// Calls work(first, count) for every block of items, with
+	// threads taking the next block until there are none left.
+	// The calling thread does its share, and reports progress
+	// between its blocks.
+	// --------------------------------------------------------
+	template<typename Work>
+	void ForEachBlock(unsigned int itemCount, unsigned int threadCount, OcclusionBakeProgress progress, void* progressContext, const Work& work)
+	{
+		unsigned int blockCount = (itemCount + BlockSize - 1) / BlockSize;
+		if (threadCount == 0)
+			threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0)
+			threadCount = 1;
+		if (threadCount > blockCount)
+			threadCount = blockCount;
+
+		std::atomic<unsigned int> nextBlock(0);
+		std::atomic<unsigned int> itemsDone(0);
+		auto worker = [&](bool report)
+		{
+			for (unsigned int block = nextBlock++; block < blockCount; block = nextBlock++)
+			{
+				unsigned int first = block * BlockSize;
+				unsigned int count = itemCount - first < BlockSize ? itemCount - first : BlockSize;
+				work(first, count);
+				itemsDone += count;
+				if (report && progress)
+					progress(itemsDone, itemCount, progressContext);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < threadCount; i++)
+			threads.emplace_back(worker, false);
+		worker(true);
+		for (std::thread& thread : threads)
+			thread.join();
+
+		if (progress)
+			progress(itemCount, itemCount, progressContext);
+	}
+
+	// --------------------------------------------------------
+	// Traces one vertex's hemisphere.  Samples are a Hammersley
+	// set mapped to the cosine lobe (so the share of rays that
+	// get away is the cosine weighted visibility), shifted by
+	// a per-vertex random offset so neighbors' errors don't
+	// line up into bands.
+	// --------------------------------------------------------
+	VertexOcclusion TraceVertex(
+		const TriangleBVH& bvh,
+		const float position[3],
+		const float normal[3],
+		const std::vector<float>& sampleRadius,
+		const std::vector<float>& sampleCos,
+		const std::vector<float>& sampleSin,
+		unsigned int seed,
+		float bias,
+		float maxDistance)
+	{
+		VertexOcclusion result = { { normal[0], normal[1], normal[2] }, 1.0f };
+
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length <= 0.0f)
+			return result;
+		float n[3] = { normal[0] / length, normal[1] / length, normal[2] / length };
+
+		// A tangent frame around the normal (Duff et al. 2017)
+		float sign = n[2] >= 0.0f ? 1.0f : -1.0f;
+		float a = -1.0f / (sign + n[2]);
+		float b = n[0] * n[1] * a;
+		float tangent[3] = { 1.0f + sign * n[0] * n[0] * a, sign * b, -sign * n[0] };
+		float bitangent[3] = { b, sign + n[1] * n[1] * a, -n[1] };
+
+		// The offset: radially by shifting the first coordinate,
+		// and around the normal by turning the frame
+		unsigned int words[6];
+		memcpy(words, position, sizeof(float) * 3);
+		memcpy(words + 3, normal, sizeof(float) * 3);
+		unsigned int hash = Hash(words, 6, seed);
+		float shift = (hash & 0xFFFF) / 65536.0f;
+		float turn = (hash >> 16) / 65536.0f * 2.0f * Pi;
+		float c = cosf(turn);
+		float s = sinf(turn);
+		for (int i = 0; i < 3; i++)
+		{
+			float t = tangent[i];
+			tangent[i] = t * c + bitangent[i] * s;
+			bitangent[i] = bitangent[i] * c - t * s;
+		}
+
+		float origin[3];
+		for (int i = 0; i < 3; i++)
+			origin[i] = position[i] + n[i] * bias;
+
+		unsigned int rayCount = (unsigned int)sampleCos.size();
+		unsigned int open = 0;
+		float bent[3] = {};
+		for (unsigned int first = 0; first < rayCount; first += 4)
+		{
+			float dir[3][4];
+			for (unsigned int lane = 0; lane < 4; lane++)
+			{
+				unsigned int i = first + lane;
+				float u = sampleRadius[i] + shift;
+				u -= u >= 1.0f ? 1.0f : 0.0f;
+				float r = sqrtf(u);
+				float z = sqrtf(1.0f - u);
+				float x = r * sampleCos[i];
+				float y = r * sampleSin[i];
+				for (int axis = 0; axis < 3; axis++)
+					dir[axis][lane] = tangent[axis] * x + bitangent[axis] * y + n[axis] * z;
+			}
+
+			int blocked = bvh.Occluded4(origin, dir[0], dir[1], dir[2], maxDistance);
+			for (unsigned int lane = 0; lane < 4; lane++)
+			{
+				if (blocked & (1 << lane))
+					continue;
+				open++;
+				for (int axis = 0; axis < 3; axis++)
+					bent[axis] += dir[axis][lane];
+			}
+		}
+
+		result.Occlusion = (float)open / rayCount;
+		float bentLength = sqrtf(bent[0] * bent[0] + bent[1] * bent[1] + bent[2] * bent[2]);
+		for (int i = 0; i < 3; i++)
+			result.BentNormal[i] = bentLength > 0.0f ? bent[i] / bentLength : n[i];
+		return result;
+	}
+}
+
+bool BakeVertexOcclusion(
+	const float* positions,
+	const float* normals,
+	unsigned int stride,
+	unsigned int vertexCount,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	const OcclusionBakeSettings& settings,
+	std::vector<VertexOcclusion>& result,
+	OcclusionBakeStats* stats,
+	unsigned int threadCount,
+	OcclusionBakeProgress progress,
+	void* progressContext)
+{
+	if (vertexCount == 0 || indexCount < 3)
+		return false;
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		if (indices[i] >= vertexCount)
+			return false;
+	}
+
+	// One slot per distinct position and normal
+	std::unordered_map<VertexKey, unsigned int, VertexKeyHash> distinct;
+	std::vector<unsigned int> slotOf(vertexCount);
+	std::vector<unsigned int> traced;
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		VertexKey key;
+		memcpy(key.Bits, Attribute(positions, stride, v), sizeof(float) * 3);
+		memcpy(key.Bits + 3, Attribute(normals, stride, v), sizeof(float) * 3);
+
+		auto inserted = distinct.insert({ key, (unsigned int)traced.size() });
+		if (inserted.second)
+			traced.push_back(v);
+		slotOf[v] = inserted.first->second;
+	}
+
+	TriangleBVH bvh;
+	bvh.Build(positions, stride, indices, indexCount);
+
+	float min[3], max[3];
+	bvh.GetBounds(min, max);
+	float diagonal = sqrtf(
+		(max[0] - min[0]) * (max[0] - min[0]) +
+		(max[1] - min[1]) * (max[1] - min[1]) +
+		(max[2] - min[2]) * (max[2] - min[2]));
+
+	// The sample set, shared by every vertex
+	unsigned int rayCount = (settings.RayCount + 3) / 4 * 4;
+	if (rayCount == 0)
+		rayCount = 4;
+	std::vector<float> sampleRadius(rayCount);
+	std::vector<float> sampleCos(rayCount);
+	std::vector<float> sampleSin(rayCount);
+	for (unsigned int i = 0; i < rayCount; i++)
+	{
+		float x, y;
+		Hammersley(i, rayCount, x, y);
+		sampleRadius[i] = x;
+		sampleCos[i] = cosf(2.0f * Pi * y);
+		sampleSin[i] = sinf(2.0f * Pi * y);
+	}
+
+	std::vector<VertexOcclusion> slots(traced.size());
+	ForEachBlock((unsigned int)traced.size(), threadCount, progress, progressContext, [&](unsigned int first, unsigned int count)
+	{
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			slots[i] = TraceVertex(bvh,
+				Attribute(positions, stride, traced[i]),
+				Attribute(normals, stride, traced[i]),
+				sampleRadius, sampleCos, sampleSin,
+				settings.Seed,
+				settings.Bias * diagonal,
+				settings.MaxDistance * diagonal);
+		}
+	});
+
+	result.resize(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		result[v] = slots[slotOf[v]];
+
+	if (stats)
+	{
+		stats->TracedVertices = (unsigned int)traced.size();
+		stats->Rays = (unsigned long long)traced.size() * rayCount;
+		stats->BvhNodes = bvh.GetNodeCount();
+		stats->BvhDepth = bvh.GetDepth();
+	}
+	return true;
+}
+
+void UnoccludedVertices(const float* normals, unsigned int stride, unsigned int vertexCount, std::vector<VertexOcclusion>& result)
+{
+	result.resize(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		const float* normal = Attribute(normals, stride, v);
+		result[v] = { { normal[0], normal[1], normal[2] }, 1.0f };
+	}
+}
+
+bool SaveVertexOcclusion(const std::wstring& path, unsigned long long key, const std::vector<VertexOcclusion>& occlusion)
+{
+	std::ofstream file(std::filesystem::path(path), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	unsigned int count = (unsigned int)occlusion.size();
+	file.write("VOCC", 4);
+	file.write((const char*)&OcclusionFileVersion, sizeof(OcclusionFileVersion));
+	file.write((const char*)&key, sizeof(key));
+	file.write((const char*)&count, sizeof(count));
+	file.write((const char*)occlusion.data(), occlusion.size() * sizeof(VertexOcclusion));
+	return file.good();
+}
+
+bool LoadVertexOcclusion(const std::wstring& path, unsigned long long key, unsigned int vertexCount, std::vector<VertexOcclusion>& occlusion)
+{
+	std::ifstream file(std::filesystem::path(path), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	char tag[4] = {};
+	unsigned int version = 0;
+	unsigned long long fileKey = 0;
+	unsigned int count = 0;
+	file.read(tag, 4);
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&fileKey, sizeof(fileKey));
+	file.read((char*)&count, sizeof(count));
+	if (!file.good() || memcmp(tag, "VOCC", 4) != 0 || version != OcclusionFileVersion || fileKey != key || count != vertexCount)
+		return false;
+
+	std::vector<VertexOcclusion> loaded(count);
+	file.read((char*)loaded.data(), loaded.size() * sizeof(VertexOcclusion));
+	if (!file.good())
+		return false;
+	file.peek();
+	if (!file.eof())
+		return false;
+
+	occlusion = std::move(loaded);
+	return true;
+}
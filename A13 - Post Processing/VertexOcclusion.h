@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Ambient occlusion and a bent normal for one vertex, laid
+// out as the OCCLUSION_BAKED stream the vertex shader reads
+// (see Mesh::Draw())
+// --------------------------------------------------------
+struct VertexOcclusion
+{
+	float BentNormal[3];	// The average open direction, unit length
+	float Occlusion;		// Share of the hemisphere that's open, so 1 is nothing in the way
+};
+
+struct OcclusionBakeSettings
+{
+	unsigned int RayCount = 256;	// Per vertex, rounded up to a multiple of 4
+	float MaxDistance = 0.5f;		// How far to look, as a fraction of the bounding box's diagonal
+	float Bias = 0.0001f;			// How far off the surface rays start, the same way
+	unsigned int Seed = 1;
+};
+
+struct OcclusionBakeStats
+{
+	unsigned int TracedVertices = 0;	// Distinct position and normal pairs
+	unsigned long long Rays = 0;
+	unsigned int BvhNodes = 0;
+	unsigned int BvhDepth = 0;
+};
+
+// Called on the thread that started the bake, now and then
+// and once at the end, with how many vertices are done
+typedef void (*OcclusionBakeProgress)(unsigned int done, unsigned int total, void* context);
+
+// --------------------------------------------------------
+// Bakes occlusion for every vertex of a triangle list by
+// building a TriangleBVH over it and tracing cosine weighted
+// rays over each vertex's hemisphere, four to a packet.
+// Occlusion is the share that got away, and the bent normal
+// is the average direction they went.
+//
+// Vertices the OBJ loader duplicated for each face share a
+// position and normal, so each distinct pair is traced once.
+// The sample pattern is seeded by that pair and the setting's
+// seed, which makes the output the same from run to run and
+// for any threadCount (0 for one per core).
+//
+// positions and normals: xyz floats, stride bytes apart.
+// Returns false if there are no triangles or an index is out
+// of range.
+// --------------------------------------------------------
+bool BakeVertexOcclusion(
+	const float* positions,
+	const float* normals,
+	unsigned int stride,
+	unsigned int vertexCount,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	const OcclusionBakeSettings& settings,
+	std::vector<VertexOcclusion>& result,
+	OcclusionBakeStats* stats = 0,
+	unsigned int threadCount = 0,
+	OcclusionBakeProgress progress = 0,
+	void* progressContext = 0);
+
+// Nothing in the way of any vertex, for when there's no bake
+void UnoccludedVertices(const float* normals, unsigned int stride, unsigned int vertexCount, std::vector<VertexOcclusion>& result);
+
+// Kept on disk under a key, like SaveSH(); loading fails if
+// the key or the vertex count doesn't match
+bool SaveVertexOcclusion(const std::wstring& path, unsigned long long key, const std::vector<VertexOcclusion>& occlusion);
+bool LoadVertexOcclusion(const std::wstring& path, unsigned long long key, unsigned int vertexCount, std::vector<VertexOcclusion>& occlusion);
@@ -2,14 +2,11 @@
 #include "GGPShadersInclude.hlsli"
 
 // External data to be used with the constant buffer
-cbuffer ExternalData : register(b0)
+// - Camera and light matrices come from PerFrame in the include
+cbuffer PerObject : register(b2)
 {
     matrix world;
     matrix worldInverseTranspose;
-    matrix view;
-    matrix projection;
-    matrix lightView;
-    matrix lightProjection;
 }
 
 // --------------------------------------------------------
@@ -43,9 +40,8 @@ VertexToPixel main( VertexShaderInput input )
     output.worldPosition = mul(world, float4(input.localPosition, 1.0f)).xyz;
     output.tangent = mul((float3x3) world, input.tangent);
 	
-	// Shadow Map WVP Calculation
-    matrix shadowWVP = mul(lightProjection, mul(lightView, world));
-    output.shadowMapPosition = mul(shadowWVP, float4(input.localPosition, 1.0f));
+    // Baked occlusion, the bent normal moved to world space like the normal
+    output.occlusion = float4(mul((float3x3) worldInverseTranspose, input.occlusion.xyz), input.occlusion.w);
 
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
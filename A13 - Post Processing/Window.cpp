@@ -38,10 +38,25 @@ namespace Window
 		// when the window resizes
 		void (*onResize)() = 0;
 
+		// While the user drags the window's edges, the new size
+		// is only remembered; it's applied once they let go
+		bool isSizing = false;
+		unsigned int pendingWidth = 0;
+		unsigned int pendingHeight = 0;
+
 		// Basic FPS tracking
 		float fpsTimeElapsed = 0.0f;
 		__int64 fpsFrameCounter = 0;
 
+		// Takes on the pending size, and lets other systems know
+		void ApplyResize()
+		{
+			windowWidth = pendingWidth;
+			windowHeight = pendingHeight;
+			Graphics::ResizeBuffers(windowWidth, windowHeight);
+			if (onResize)
+				onResize();
+		}
 	}
 }
 
@@ -77,8 +92,8 @@ HRESULT Window::Create(
 		return E_FAIL;
 
 	// Save data
-	windowWidth = width;
-	windowHeight = height;
+	windowWidth = pendingWidth = width;
+	windowHeight = pendingHeight = height;
 	windowTitle = titleBarText;
 	windowStats = statsInTitleBar;
 	onResize = resizeCallback;
@@ -158,6 +173,30 @@ HRESULT Window::Create(
 }
 
 
+// --------------------------------------------------------
+// Sets up window details without an actual OS window, for
+// running headless.  Width(), Height() and AspectRatio()
+// behave as usual; Handle() stays null.
+// 
+// width  - Pretend width of the window
+// height - Pretend height of the window
+// --------------------------------------------------------
+HRESULT Window::CreateHeadless(unsigned int width, unsigned int height)
+{
+	// Verify
+	if (windowCreated)
+		return E_FAIL;
+
+	// Save data
+	windowWidth = width;
+	windowHeight = height;
+	windowStats = false;
+
+	windowCreated = true;
+	return S_OK;
+}
+
+
 // --------------------------------------------------------
 // Updates the window's title bar with several stats once
 // per second, including:
@@ -294,15 +333,23 @@ LRESULT Window::ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
 		if (isMinimized)
 			return 0;
 		
-		// Save the new client area dimensions.
-		windowWidth = LOWORD(lParam);
-		windowHeight = HIWORD(lParam);
-
-		// Let other systems know
-		Graphics::ResizeBuffers(windowWidth, windowHeight);
-		if(onResize)
-			onResize();
+		// Save the new client area dimensions, for
+		// now if the edges are still being dragged
+		pendingWidth = LOWORD(lParam);
+		pendingHeight = HIWORD(lParam);
+		if (isSizing)
+			return 0;
+		ApplyResize();
+		return 0;
 
+		// Dragging the edges (or the title bar) starts and stops
+	case WM_ENTERSIZEMOVE:
+		isSizing = true;
+		return 0;
+	case WM_EXITSIZEMOVE:
+		isSizing = false;
+		if (pendingWidth != windowWidth || pendingHeight != windowHeight)
+			ApplyResize();
 		return 0;
 
 		// Has the mouse wheel been scrolled?
@@ -21,6 +21,7 @@ namespace Window
 		std::wstring titleBarText,
 		bool statsInTitleBar,
 		void (*resizeCallback)());
+	HRESULT CreateHeadless(unsigned int width, unsigned int height);
 	void UpdateStats(float totalTime);
 	void Quit();
 